@@ -0,0 +1,23 @@
+// auto generated by configure
+#ifndef XCODER_AUTO_HEADER_HPP
+#define XCODER_AUTO_HEADER_HPP
+
+
+#define XCODER_AUTO_BUILD_TS "1792378299"
+#define XCODER_AUTO_BUILD_DATE "2026-10-19 02:51:39"
+#define XCODER_AUTO_UNAME "Linux vm 6.18.44-fc-v139 #1 SMP PREEMPT_DYNAMIC @0 x86_64 GNU/Linux"
+#define XCODER_AUTO_USER_CONFIGURE ""
+#define XCODER_AUTO_CONFIGURE "--systemdir=NO --without-win32 --without-android --without-self-kill --without-latency-display --without-tracelog-timestamps --without-data-dump --without-linux-virt-io-driver --with-backtrace-print --without-info-level-ssim-log --disable-cpu-affinity --without-setup-systemd"
+
+
+#undef XCODER_DUMP_DATA
+#undef NI_LOG_TRACE_TIMESTAMPS
+#undef NI_LOG_SSIM_AT_INFO
+#undef XCODER_SELF_KILL_ERR
+#undef MEASURE_LATENCY
+#undef XCODER_LINUX_VIRTIO_DRIVER_ENABLED
+#undef DISABLE_BACKTRACE_PRINT
+#undef XCODER_ENABLE_CPU_AFFINITY
+
+#endif
+
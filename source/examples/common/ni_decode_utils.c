@@ -2223,132 +2223,195 @@ end:
 }
 
 /*!*****************************************************************************
- *  \brief  Send decoder input data
+ *  \brief  Parse the next packet from the cached input file into p_in_pkt.
+ *          Bytes left over from the previous packet are prepended, the
+ *          packet buffer is taken from the packet arena of p_ctx, or
+ *          allocated, here and owned by the caller, who frees it with
+ *          ni_packet_buffer_free().
  *
  *  \param
  *
- *  \return
+ *  \return size of the packet in bytes, 0 at end of input, < 0 on failure
  ******************************************************************************/
-int decoder_send_data(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
-                               ni_session_data_io_t *p_in_data,
-                               int input_video_width, int input_video_height,
-                               void *stream_info)
+int decoder_read_packet(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
+                        ni_packet_t *p_in_pkt, void *stream_info)
 {
     static uint8_t tmp_buf[NI_MAX_TX_SZ];
     uint8_t *tmp_buf_ptr = tmp_buf;
     int packet_size;
     uint32_t frame_pkt_size = 0, nal_size;
     int nal_type = -1;
-    int tx_size = 0;
     uint32_t send_size = 0;
-    int new_packet = 0;
     int32_t frame_num = -1, curr_frame_num;
     unsigned int first_mb_in_slice = 0;
-    ni_packet_t *p_in_pkt = &(p_in_data->data.packet);
+    int arena_slot_size = NI_MAX_TX_SZ + p_dec_ctx->max_nvme_io_size * 2;
 
-    ni_log(NI_LOG_DEBUG, "===> decoder_send_data <===\n");
+    memset(p_in_pkt, 0, sizeof(ni_packet_t));
 
-    if (p_ctx->dec_eos_sent)
+    // parse straight into a packet arena slot, after the bytes left over from
+    // the previous packet, so the packet needs no copy out of tmp_buf; fall
+    // back to tmp_buf and ni_packet_copy() if no slot is available
+    if (!p_ctx->p_pkt_arena)
     {
-        ni_log(NI_LOG_DEBUG, "decoder_send_data: ALL data (incl. eos) sent "
-                       "already!\n");
-        return NI_TEST_RETCODE_SUCCESS;
+        p_ctx->p_pkt_arena = ni_packet_arena_alloc(arena_slot_size,
+                                                   NI_DEMO_PKT_ARENA_SLOTS);
     }
-
-    if (0 == p_in_pkt->data_len)
+    if (p_ctx->p_pkt_arena && p_dec_ctx->prev_size <= arena_slot_size - NI_MAX_TX_SZ &&
+        NI_RETCODE_SUCCESS ==
+            ni_packet_arena_get_buffer(p_ctx->p_pkt_arena, p_in_pkt,
+                                       arena_slot_size))
     {
-        memset(p_in_pkt, 0, sizeof(ni_packet_t));
+        if (p_dec_ctx->prev_size > 0)
+        {
+            memcpy(p_in_pkt->p_data, p_dec_ctx->p_leftover,
+                   p_dec_ctx->prev_size);
+        }
+        tmp_buf_ptr = (uint8_t *)p_in_pkt->p_data + p_dec_ctx->prev_size;
+    }
 
-        if (NI_CODEC_FORMAT_H264 == p_dec_ctx->codec_format)
+    if (NI_CODEC_FORMAT_H264 == p_dec_ctx->codec_format)
+    {
+        ni_h264_sps_t *sps;
+        sps = (ni_h264_sps_t *)stream_info;
+        // send whole encoded packet which ends with a slice NAL
+        while ((nal_size = (uint32_t)find_h264_next_nalu(p_ctx, tmp_buf_ptr, &nal_type)) > 0)
         {
-            ni_h264_sps_t *sps;
-            sps = (ni_h264_sps_t *)stream_info;
-            // send whole encoded packet which ends with a slice NAL
-            while ((nal_size = (uint32_t)find_h264_next_nalu(p_ctx, tmp_buf_ptr, &nal_type)) > 0)
-            {
-                frame_pkt_size += nal_size;
-                tmp_buf_ptr += nal_size;
-                ni_log(NI_LOG_DEBUG, "%s nal %d  nal_size %d\n", __func__,
-                       nal_type, nal_size);
+            frame_pkt_size += nal_size;
+            tmp_buf_ptr += nal_size;
+            ni_log(NI_LOG_DEBUG, "%s nal %d  nal_size %d\n", __func__,
+                   nal_type, nal_size);
 
-                if (H264_NAL_SLICE == nal_type ||
-                    H264_NAL_IDR_SLICE == nal_type)
+            if (H264_NAL_SLICE == nal_type ||
+                H264_NAL_IDR_SLICE == nal_type)
+            {
+                if (!parse_h264_slice_header(tmp_buf_ptr - nal_size,
+                                             nal_size, sps, &curr_frame_num,
+                                             &first_mb_in_slice))
                 {
-                    if (!parse_h264_slice_header(tmp_buf_ptr - nal_size,
-                                                 nal_size, sps, &curr_frame_num,
-                                                 &first_mb_in_slice))
+                    if (-1 == frame_num)
                     {
-                        if (-1 == frame_num)
-                        {
-                            // first slice, continue to check
-                            frame_num = curr_frame_num;
-                        } else if (curr_frame_num != frame_num ||
-                                   0 == first_mb_in_slice)
-                        {
-                            // this slice has diff. frame_num or first_mb_in_slice addr is
-                            // 0: not the same frame and return
-                            rewind_data_buf_pos_by(p_ctx, nal_size);
-                            frame_pkt_size -= nal_size;
-                            break;
-                        }
-                        // this slice is in the same frame, so continue to check and see
-                        // if there is more
-                    } else
+                        // first slice, continue to check
+                        frame_num = curr_frame_num;
+                    } else if (curr_frame_num != frame_num ||
+                               0 == first_mb_in_slice)
                     {
-                        ni_log(NI_LOG_ERROR,
-                               "decoder_send_data: parse_slice_header error "
-                               "NAL type %d size %u, continue\n",
-                               nal_type, nal_size);
+                        // this slice has diff. frame_num or first_mb_in_slice addr is
+                        // 0: not the same frame and return
+                        rewind_data_buf_pos_by(p_ctx, nal_size);
+                        frame_pkt_size -= nal_size;
+                        break;
                     }
-                } else if (-1 != frame_num)
+                    // this slice is in the same frame, so continue to check and see
+                    // if there is more
+                } else
                 {
-                    // already got a slice and this is non-slice NAL: return
-                    rewind_data_buf_pos_by(p_ctx, nal_size);
-                    frame_pkt_size -= nal_size;
-                    break;
+                    ni_log(NI_LOG_ERROR,
+                           "decoder_read_packet: parse_slice_header error "
+                           "NAL type %d size %u, continue\n",
+                           nal_type, nal_size);
                 }
-                // otherwise continue until a slice is found
-            }   // while there is still NAL
-        } else if (NI_CODEC_FORMAT_H265 == p_dec_ctx->codec_format)
-        {
-            while ((nal_size = (uint32_t)find_h265_next_nalu(p_ctx, tmp_buf_ptr, &nal_type)) > 0)
+            } else if (-1 != frame_num)
             {
-                frame_pkt_size += nal_size;
-                tmp_buf_ptr += nal_size;
-                ni_log(NI_LOG_DEBUG, "%s nal_type %d nal_size %d\n", __func__,
-                       nal_type, nal_size);
-
-                if (nal_type >= 0 && nal_type <= 23)   // vcl units
-                {
-                    ni_log(NI_LOG_DEBUG, "%s send vcl_nal %d nal_size %d\n",
-                           __func__, nal_type, nal_size);
-                    break;
-                }
+                // already got a slice and this is non-slice NAL: return
+                rewind_data_buf_pos_by(p_ctx, nal_size);
+                frame_pkt_size -= nal_size;
+                break;
             }
-        } else if (NI_CODEC_FORMAT_VP9 == p_dec_ctx->codec_format)
+            // otherwise continue until a slice is found
+        }   // while there is still NAL
+    } else if (NI_CODEC_FORMAT_H265 == p_dec_ctx->codec_format)
+    {
+        while ((nal_size = (uint32_t)find_h265_next_nalu(p_ctx, tmp_buf_ptr, &nal_type)) > 0)
         {
-            while ((packet_size = (uint32_t)find_vp9_next_packet(p_ctx, tmp_buf_ptr, stream_info)) > 0)
+            frame_pkt_size += nal_size;
+            tmp_buf_ptr += nal_size;
+            ni_log(NI_LOG_DEBUG, "%s nal_type %d nal_size %d\n", __func__,
+                   nal_type, nal_size);
+
+            if (nal_type >= 0 && nal_type <= 23)   // vcl units
             {
-                frame_pkt_size += packet_size;
-                ni_log(NI_LOG_DEBUG, "%s vp9 packet_size %d\n", __func__,
-                       packet_size);
+                ni_log(NI_LOG_DEBUG, "%s send vcl_nal %d nal_size %d\n",
+                       __func__, nal_type, nal_size);
                 break;
             }
-        } else {
-            ni_log(NI_LOG_ERROR, "Error: Unsupported codec format %u", p_dec_ctx->codec_format);
-            return NI_TEST_RETCODE_FAILURE;
         }
-        ni_log(NI_LOG_DEBUG, "decoder_send_data * frame_pkt_size %d\n",
-                       frame_pkt_size);
+    } else if (NI_CODEC_FORMAT_VP9 == p_dec_ctx->codec_format)
+    {
+        while ((packet_size = (uint32_t)find_vp9_next_packet(p_ctx, tmp_buf_ptr, stream_info)) > 0)
+        {
+            frame_pkt_size += packet_size;
+            ni_log(NI_LOG_DEBUG, "%s vp9 packet_size %d\n", __func__,
+                   packet_size);
+            break;
+        }
+    } else {
+        ni_log(NI_LOG_ERROR, "Error: Unsupported codec format %u", p_dec_ctx->codec_format);
+        return -1;
+    }
+    ni_log(NI_LOG_DEBUG, "decoder_read_packet * frame_pkt_size %d\n",
+                   frame_pkt_size);
 
-        p_in_pkt->p_data = NULL;
-        send_size = frame_pkt_size + p_dec_ctx->prev_size;
+    send_size = frame_pkt_size + p_dec_ctx->prev_size;
+    if (p_in_pkt->p_arena)
+    {
+        // the packet is already in place, ni_decoder_session_write() pads it
         if (send_size > 0)
         {
-            ni_packet_buffer_alloc(p_in_pkt, (int)send_size);
+            p_in_pkt->data_len = send_size;
+            p_dec_ctx->prev_size = 0;
+        } else
+        {
+            ni_packet_buffer_free(p_in_pkt);
         }
-        p_in_pkt->data_len = send_size;
-        new_packet = 1;
+        return (int)send_size;
+    }
+
+    p_in_pkt->p_data = NULL;
+    p_in_pkt->data_len = send_size;
+    if (send_size > 0)
+    {
+        ni_packet_buffer_alloc(p_in_pkt, (int)send_size);
+        ni_packet_copy(p_in_pkt->p_data, tmp_buf, frame_pkt_size,
+                       p_dec_ctx->p_leftover, &p_dec_ctx->prev_size);
+    }
+
+    return (int)send_size;
+}
+
+/*!*****************************************************************************
+ *  \brief  Send decoder input data
+ *
+ *  \param
+ *
+ *  \return
+ ******************************************************************************/
+int decoder_send_data(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
+                               ni_session_data_io_t *p_in_data,
+                               int input_video_width, int input_video_height,
+                               void *stream_info)
+{
+    int ret;
+    int tx_size = 0;
+    uint32_t send_size = 0;
+    ni_packet_t *p_in_pkt = &(p_in_data->data.packet);
+
+    ni_log(NI_LOG_DEBUG, "===> decoder_send_data <===\n");
+
+    if (p_ctx->dec_eos_sent)
+    {
+        ni_log(NI_LOG_DEBUG, "decoder_send_data: ALL data (incl. eos) sent "
+                       "already!\n");
+        return NI_TEST_RETCODE_SUCCESS;
+    }
+
+    if (0 == p_in_pkt->data_len)
+    {
+        ret = decoder_read_packet(p_ctx, p_dec_ctx, p_in_pkt, stream_info);
+        if (ret < 0)
+        {
+            return NI_TEST_RETCODE_FAILURE;
+        }
+        send_size = (uint32_t)ret;
     } else
     {
         send_size = p_in_pkt->data_len;
@@ -2364,20 +2427,10 @@ int decoder_send_data(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
     p_in_pkt->video_width = input_video_width;
     p_in_pkt->video_height = input_video_height;
 
-    if (send_size == 0)
-    {
-        if (p_ctx->curr_file_offset)
-        {
-            p_in_pkt->end_of_stream = 1;
-            ni_log(NI_LOG_ERROR, "Sending eos\n");
-        }
-    } else
+    if (send_size == 0 && p_ctx->curr_file_offset)
     {
-        if (new_packet)
-        {
-            ni_packet_copy(p_in_pkt->p_data, tmp_buf, frame_pkt_size,
-                           p_dec_ctx->p_leftover, &p_dec_ctx->prev_size);
-        }
+        p_in_pkt->end_of_stream = 1;
+        ni_log(NI_LOG_ERROR, "Sending eos\n");
     }
 
     tx_size =
@@ -2636,6 +2689,9 @@ void *decoder_send_thread(void *args)
     ni_session_data_io_t in_pkt = {0};
     int retval = 0;
 
+    // runs on a CPU local to the card if enableCpuAffinity is set
+    ni_device_session_pin_thread(p_dec_ctx, NI_SESSION_THREAD_SEND);
+
     ni_log(NI_LOG_INFO, "decoder_send_thread start: decoder_low_delay %d\n",
            p_dec_ctx->decoder_low_delay);
     while (1)
@@ -2695,6 +2751,9 @@ void *decoder_receive_thread(void *args)
     int rx_size = 0;
     uint64_t current_time, previous_time = p_ctx->start_time;
 
+    // runs on a CPU local to the card if enableCpuAffinity is set
+    ni_device_session_pin_thread(p_dec_ctx, NI_SESSION_THREAD_RECV);
+
     ni_log(NI_LOG_INFO, "decoder_receive_thread start\n");
 
     for (;;)
@@ -430,6 +430,8 @@ uint64_t find_vp9_next_packet(ni_demo_context_t *p_ctx, uint8_t *p_dst, ni_vp9_h
 int vp9_parse_header(ni_vp9_header_info_t *vp9_info, uint8_t *buf, int size_bytes);
 int probe_vp9_stream_info(ni_demo_context_t *p_ctx, ni_vp9_header_info_t *vp9_info);
 
+int decoder_read_packet(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
+                        ni_packet_t *p_in_pkt, void *stream_info);
 int decoder_send_data(ni_demo_context_t *p_ctx, ni_session_context_t *p_dec_ctx,
                                ni_session_data_io_t *p_in_data,
                                int input_video_width, int input_video_height,
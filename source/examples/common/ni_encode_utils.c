@@ -2596,6 +2596,9 @@ void *encoder_send_thread(void *args)
     niFrameSurface1_t *p_surface;
     int i, ret = 0;
 
+    // runs on a CPU local to the card if enableCpuAffinity is set
+    ni_device_session_pin_thread(&p_enc_ctx_list[0], NI_SESSION_THREAD_SEND);
+
     ni_log(NI_LOG_INFO, "%s start\n", __func__);
 
     for (;;)
@@ -2686,6 +2689,9 @@ void *encoder_receive_thread(void *args)
     int end_of_all_streams = 0;
     uint64_t current_time, previous_time = p_ctx->start_time;
 
+    // runs on a CPU local to the card if enableCpuAffinity is set
+    ni_device_session_pin_thread(p_enc_ctx, NI_SESSION_THREAD_RECV);
+
     ni_log(NI_LOG_INFO, "encoder_receive_thread start\n");
 
     while (!end_of_all_streams && ret >= 0 && !p_ctx->end_all_threads)
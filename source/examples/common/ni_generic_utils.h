@@ -46,6 +46,8 @@ extern "C" {
 #define FILE_NAME_LEN    256
 #define MAX_INPUT_FILES  3
 #define MAX_OUTPUT_FILES 4
+// decoder input packets in flight, see decoder_read_packet()
+#define NI_DEMO_PKT_ARENA_SLOTS 2
 
 #define NI_TEST_RETCODE_FAILURE -1
 #define NI_TEST_RETCODE_SUCCESS 0
@@ -161,6 +163,9 @@ typedef struct _ni_demo_context
     // pts and dts
     ni_pts_queue *enc_pts_queue[MAX_OUTPUT_FILES];
     int pts[MAX_OUTPUT_FILES];
+
+    // decoder input packet buffers, see decoder_read_packet()
+    ni_packet_arena_t *p_pkt_arena;
 } ni_demo_context_t;
 
 typedef struct uploader_param
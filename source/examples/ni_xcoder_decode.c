@@ -426,6 +426,7 @@ end:
 
     free(p_dec_api_param);
     free(ctx.file_cache);
+    ni_packet_arena_free(ctx.p_pkt_arena);
     for(i = 0; i < MAX_OUTPUT_FILES; ++i)
     {
         free(ctx.enc_pts_queue[i]);
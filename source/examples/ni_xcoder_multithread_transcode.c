@@ -692,6 +692,7 @@ end:
     }
 
     free(ctx.file_cache);
+    ni_packet_arena_free(ctx.p_pkt_arena);
 
     for(i = 0; i < MAX_OUTPUT_FILES; ++i)
     {
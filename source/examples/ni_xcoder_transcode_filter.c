@@ -31,6 +31,7 @@
 #include "ni_encode_utils.h"
 #include "ni_filter_utils.h"
 #include "ni_log.h"
+#include "ni_pipeline.h"
 #include "ni_util.h"
 
 #ifdef _WIN32
@@ -84,9 +85,211 @@ static void print_usage(void)
         "                               ni_quadra_drawbox - supported params [x, y, width, height]\n"
         "                               e.g. ni_quadra_drawbox=x=300:y=150:width=600:height=400\n"
         "                               (Default: \"\")\n"
+        "-p | --pipeline                (No argument) Run decoder, scalers and encoders as a threaded\n"
+        "                               hw frame pipeline (see ni_pipeline.h). Requires out=hw,\n"
+        "                               only the ni_quadra_scale filter and avc/hevc output.\n"
         , NI_XCODER_REVISION, MAX_OUTPUT_FILES, MAX_OUTPUT_FILES);
 }
 
+// state shared by the ni_pipeline callbacks of pipeline mode (-p)
+typedef struct _pipeline_opaque
+{
+    ni_demo_context_t *p_ctx;
+    ni_session_context_t *p_dec_ctx;
+    void *p_stream_info;
+    int input_width;
+    int input_height;
+    ni_session_context_t *enc_ctx;
+    ni_xcoder_params_t *p_enc_api_param;
+    char (*enc_conf_params)[2048];
+    char (*enc_gop_params)[2048];
+    int *output_width;
+    int *output_height;
+    ni_pix_fmt_t *enc_pix_fmt;
+    int fps_num;
+    int fps_den;
+    int bitrate;
+    int enc_codec_format;
+    int xcoder_guid;
+    FILE **output_fp;
+    int node_to_output[NI_PIPELINE_MAX_NODES];
+    // encoders are opened from the pipeline worker threads
+    ni_pthread_mutex_t open_mutex;
+} pipeline_opaque_t;
+
+static int pipeline_read_packet(void *opaque, ni_packet_t *p_packet)
+{
+    pipeline_opaque_t *p_opaque = (pipeline_opaque_t *)opaque;
+    int size;
+
+    size = decoder_read_packet(p_opaque->p_ctx, p_opaque->p_dec_ctx, p_packet,
+                               p_opaque->p_stream_info);
+    if (size < 0)
+    {
+        return -1;
+    }
+
+    p_packet->video_width = p_opaque->input_width;
+    p_packet->video_height = p_opaque->input_height;
+    if (size == 0)
+    {
+        ni_log(NI_LOG_INFO, "Sending eos\n");
+        p_packet->end_of_stream = 1;
+    }
+    return 1;
+}
+
+static int pipeline_open_encoder(void *opaque, int node_id,
+                                 ni_session_context_t *p_enc_ctx,
+                                 const niFrameSurface1_t *p_surface)
+{
+    pipeline_opaque_t *p_opaque = (pipeline_opaque_t *)opaque;
+    niFrameSurface1_t *p_hwframe = (niFrameSurface1_t *)p_surface;
+    int i = p_opaque->node_to_output[node_id];
+    int ret;
+
+    ni_pthread_mutex_lock(&p_opaque->open_mutex);
+    ret = encoder_open2(p_opaque->p_ctx, p_enc_ctx, &p_opaque->p_enc_api_param[i], 1,
+                        &p_opaque->enc_conf_params[i], &p_opaque->enc_gop_params[i],
+                        NULL, &p_opaque->output_width[i], &p_opaque->output_height[i],
+                        p_opaque->fps_num, p_opaque->fps_den, p_opaque->bitrate,
+                        p_opaque->enc_codec_format, &p_opaque->enc_pix_fmt[i], 0,
+                        p_opaque->xcoder_guid, &p_hwframe, 0, false);
+    ni_pthread_mutex_unlock(&p_opaque->open_mutex);
+    return ret;
+}
+
+static int pipeline_write_packet(void *opaque, int node_id,
+                                 ni_packet_t *p_packet, int meta_size)
+{
+    pipeline_opaque_t *p_opaque = (pipeline_opaque_t *)opaque;
+    int i = p_opaque->node_to_output[node_id];
+    int size = p_packet->data_len - meta_size;
+
+    if (p_packet->end_of_stream)
+    {
+        p_opaque->p_ctx->enc_eos_received[i] = 1;
+        return 0;
+    }
+
+    if (p_opaque->output_fp[i] &&
+        fwrite((uint8_t *)p_packet->p_data + meta_size, size, 1,
+               p_opaque->output_fp[i]) != 1)
+    {
+        ni_log(NI_LOG_ERROR, "Error: writing data %d bytes error!\n", size);
+        return -1;
+    }
+    p_opaque->p_ctx->enc_total_bytes_received[i] += size;
+    p_opaque->p_ctx->num_packets_received[i]++;
+    return 0;
+}
+
+/*!*****************************************************************************
+ *  \brief  Transcode with ni_pipeline: every stage runs on the pipeline worker
+ *          threads and hw frames are shared by reference count instead of the
+ *          per-frame ref/unref bookkeeping of the main loop.
+ *
+ *  \return 0 if successful, < 0 otherwise
+ ******************************************************************************/
+static int run_pipeline(pipeline_opaque_t *p_opaque, ni_session_context_t *sca_ctx,
+                        ni_scale_params_t *scale_params, int output_total,
+                        ni_pix_fmt_t dec_pix_fmt)
+{
+    ni_pipeline_t *p_pipeline;
+    ni_pipeline_stats_t stats;
+    ni_scaler_input_params_t sca_params = {0};
+    int enc_node[MAX_OUTPUT_FILES];
+    int dec_node, src_node;
+    int i, ret;
+
+    p_pipeline = ni_pipeline_alloc(0, 0);
+    if (!p_pipeline)
+    {
+        ni_log(NI_LOG_ERROR, "Error: Failed to allocate pipeline\n");
+        return -1;
+    }
+
+    dec_node = ni_pipeline_add_decoder(p_pipeline, p_opaque->p_dec_ctx,
+                                       pipeline_read_packet, p_opaque);
+    ret = dec_node;
+    for (i = 0; ret >= 0 && i < output_total; i++)
+    {
+        src_node = dec_node;
+        p_opaque->enc_pix_fmt[i] = dec_pix_fmt;
+        if (scale_params[i].enabled)
+        {
+            ret = scaler_session_open(&sca_ctx[i], p_opaque->xcoder_guid,
+                                      NI_SCALER_OPCODE_SCALE);
+            if (ret < 0)
+            {
+                break;
+            }
+
+            sca_params.output_format = scale_params[i].format;
+            sca_params.output_width = scale_params[i].width;
+            sca_params.output_height = scale_params[i].height;
+            sca_params.input_format = ni_to_gc620_pix_fmt(dec_pix_fmt);
+            init_scaler_params(&sca_params, NI_SCALER_OPCODE_SCALE, 0, 0, 0, 0, 0, 0);
+            src_node = ret = ni_pipeline_add_scaler(p_pipeline, dec_node,
+                                                    &sca_ctx[i], &sca_params);
+            p_opaque->enc_pix_fmt[i] = gc620_to_ni_pix_fmt(scale_params[i].format);
+        }
+
+        if (ret >= 0)
+        {
+            enc_node[i] = ret = ni_pipeline_add_encoder2(p_pipeline, src_node,
+                                                         &p_opaque->enc_ctx[i],
+                                                         pipeline_open_encoder,
+                                                         pipeline_write_packet,
+                                                         p_opaque);
+        }
+        if (ret >= 0)
+        {
+            p_opaque->node_to_output[ret] = i;
+        }
+    }
+
+    if (ret >= 0)
+    {
+        ret = ni_pipeline_start(p_pipeline);
+    }
+    if (ret >= 0)
+    {
+        ret = ni_pipeline_wait(p_pipeline);
+    }
+    if (ret < 0)
+    {
+        ni_log(NI_LOG_ERROR, "Error: pipeline failed %d\n", ret);
+    } else
+    {
+        ni_pipeline_get_stats(p_pipeline, dec_node, &stats);
+        p_opaque->p_ctx->num_frames_received = stats.frames_out;
+        p_opaque->p_ctx->dec_total_bytes_sent = stats.bytes_in;
+        for (i = 0; i < output_total; i++)
+        {
+            ni_pipeline_get_stats(p_pipeline, enc_node[i], &stats);
+            ni_log(NI_LOG_INFO, "Pipeline encoder %d: %llu frames in, %llu packets out, "
+                   "fps %.2f, busy %llu ms, blocked %llu ms\n", i,
+                   (unsigned long long)stats.frames_in,
+                   (unsigned long long)stats.frames_out, stats.fps,
+                   (unsigned long long)(stats.busy_ns / 1000000),
+                   (unsigned long long)(stats.blocked_ns / 1000000));
+        }
+    }
+
+    ni_pipeline_free(p_pipeline);
+    for (i = 0; i < output_total; i++)
+    {
+        if (scale_params[i].enabled &&
+            sca_ctx[i].session_id != NI_INVALID_SESSION_ID)
+        {
+            ni_device_session_close(&sca_ctx[i], 1, NI_DEVICE_TYPE_SCALER);
+        }
+    }
+
+    return ret < 0 ? -1 : 0;
+}
+
 int main(int argc, char *argv[])
 {
     int i, ret = 0;
@@ -138,10 +341,13 @@ int main(int argc, char *argv[])
     ni_pix_fmt_t enc_pix_fmt[MAX_OUTPUT_FILES];
     int hw_frame_ref_flag = 0;
     int recycle_hw_frame_for_scaler = 0;
+    int pipeline_mode = 0;
+    pipeline_opaque_t pipe_opaque = {0};
+    ni_pix_fmt_t dec_pix_fmt;
 
     int opt;
     int opt_index;
-    const char *opt_string = "hvi:o:m:n:l:c:r:d:e:g:uf:";
+    const char *opt_string = "hvi:o:m:n:l:c:r:d:e:g:uf:p";
     static struct option long_options[] = {
         {"help", no_argument, NULL, 'h'},
         {"version", no_argument, NULL, 'v'},
@@ -157,6 +363,7 @@ int main(int argc, char *argv[])
         {"encoder-gop", required_argument, NULL, 'g'},
         {"user-data-sei-passthru", no_argument, NULL, 'u'},
         {"vf", required_argument, NULL, 'f'},
+        {"pipeline", no_argument, NULL, 'p'},
         {NULL, 0, NULL, 0},
     };
 
@@ -318,6 +525,9 @@ int main(int argc, char *argv[])
                 ni_strcpy(filter_conf_params[f_index], sizeof(filter_conf_params[f_index]), optarg);
                 f_index++;
                 break;
+            case 'p':
+                pipeline_mode = 1;
+                break;
             default:
                 print_usage();
                 ret = -1;
@@ -587,6 +797,54 @@ int main(int argc, char *argv[])
                i, dec_ctx.hw_action, input_width, input_height, output_width[i], output_height[i]);
     }
 
+    if (pipeline_mode)
+    {
+        if (!dec_ctx.hw_action || drawbox_params.enabled ||
+            enc_codec_format == NI_CODEC_FORMAT_AV1)
+        {
+            ni_log(NI_LOG_ERROR, "Error: pipeline mode requires out=hw, no drawbox "
+                   "filter and avc or hevc output\n");
+            ret = -1;
+            goto end;
+        }
+
+        // the decoder output format is only reported with its first frame,
+        // derive it from the config to set up the scaler frame pools
+        bit_depth = p_dec_api_param->dec_input_params.force_8_bit[0] ? 8 : bit_depth;
+        if (p_dec_api_param->dec_input_params.semi_planar[0])
+            dec_pix_fmt = bit_depth == 10 ? NI_PIX_FMT_P010LE : NI_PIX_FMT_NV12;
+        else
+            dec_pix_fmt = bit_depth == 10 ? NI_PIX_FMT_YUV420P10LE : NI_PIX_FMT_YUV420P;
+
+        pipe_opaque.p_ctx = &ctx;
+        pipe_opaque.p_dec_ctx = &dec_ctx;
+        pipe_opaque.p_stream_info = p_stream_info;
+        pipe_opaque.input_width = input_width;
+        pipe_opaque.input_height = input_height;
+        pipe_opaque.enc_ctx = enc_ctx;
+        pipe_opaque.p_enc_api_param = p_enc_api_param;
+        pipe_opaque.enc_conf_params = enc_conf_params;
+        pipe_opaque.enc_gop_params = enc_gop_params;
+        pipe_opaque.output_width = output_width;
+        pipe_opaque.output_height = output_height;
+        pipe_opaque.enc_pix_fmt = enc_pix_fmt;
+        pipe_opaque.fps_num = fps_num;
+        pipe_opaque.fps_den = fps_den;
+        pipe_opaque.bitrate = bitrate;
+        pipe_opaque.enc_codec_format = enc_codec_format;
+        pipe_opaque.xcoder_guid = xcoderGUID;
+        pipe_opaque.output_fp = output_fp;
+        ni_pthread_mutex_init(&pipe_opaque.open_mutex);
+
+        ctx.start_time = ni_gettime_ns();
+        ret = run_pipeline(&pipe_opaque, sca_ctx, scale_params, output_total, dec_pix_fmt);
+        ni_pthread_mutex_destroy(&pipe_opaque.open_mutex);
+
+        decoder_stat_report_and_close(&ctx, &dec_ctx);
+        encoder_stat_report_and_close(&ctx, enc_ctx, output_total);
+        goto end;
+    }
+
     ctx.start_time = ni_gettime_ns();
     previous_time = ctx.start_time;
 
@@ -861,6 +1119,7 @@ end:
     }
 
     free(ctx.file_cache);
+    ni_packet_arena_free(ctx.p_pkt_arena);
 
     for(i = 0; i < MAX_OUTPUT_FILES; ++i)
     {
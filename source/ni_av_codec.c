@@ -683,24 +683,191 @@ void ni_dec_retrieve_aux_data(ni_frame_t *frame)
     }
 }
 
+// State of the last ROI map built by set_roi_map(), kept in
+// p_enc_ctx->p_roi_map_state so that a changed ROI list only repaints the
+// blocks covered by the ROIs that changed.
+typedef struct _ni_roi_map_state
+{
+    uint32_t map_size;       // bytes allocated for p_enc_ctx->roi_map
+    uint32_t unit;           // ROI map block unit size in pixels
+    uint32_t mb_width;       // map size in blocks
+    uint32_t mb_height;
+    int roi_qp_level;        // customize_roi_qp_level the map was built with
+    int nb_steps;            // number of ROIs applied to the map
+    uint32_t sum_qp;         // sum of qp_contrib[]
+    uint32_t *qp_contrib;    // per block qp_info summed over all ROI steps
+} ni_roi_map_state_t;
+
+// ROI rectangle in blocks, inclusive, clipped to the map
+typedef struct _ni_roi_map_rect
+{
+    int x0, x1, y0, y1;
+} ni_roi_map_rect_t;
+
+// Get the map entry of one ROI.
+// return 1 if the ROI is applied to the map, 0 if it is skipped
+static int roi_map_entry(const ni_region_of_interest_t *roi, int roi_qp_level,
+                         ni_enc_quad_roi_custom_map *p_entry)
+{
+    int32_t set_qp;
+
+    if (!roi->qoffset.den)
+    {
+        return 0;
+    }
+    p_entry->field.ipcm_flag = 0;   // don't force skip mode
+    p_entry->field.roiAbsQp_flag = 0;
+    if (roi_qp_level == NI_CUS_ROI_MAPFILE) {
+        // set_qp in range [1, 10] mean it need to reset qp after
+        // rate control in fw when customize_roi_qp_level is 1.
+        // set_qp is the level in customize qp map, it choose dst qp
+        // in customize qp map base on the rate control qp and set_qp
+        set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
+                        (float)roi->qoffset.den * NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL);
+        if (set_qp > 0 && set_qp <= NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL) {
+            p_entry->field.roiAbsQp_flag = roi_qp_level;
+        } else {
+            return 0;
+        }
+    } else {
+        set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
+                        (float)roi->qoffset.den * NI_INTRA_QP_RANGE);
+        set_qp = clip3(NI_MIN_QP_DELTA, NI_MAX_QP_DELTA, set_qp);
+        // Adjust qp delta range (-25 to 25) to (0 to 63): 0 to 0, -1 to 1, -2 to
+        // 2 ... 1 to 63, 2 to 62 ...
+        // Theoretically the possible qp delta range is (-32 to 31)
+        set_qp = (NI_MAX_QP_INFO + 1 - set_qp) % (NI_MAX_QP_INFO + 1);
+    }
+    p_entry->field.qp_info = set_qp;
+    return 1;
+}
+
+// Get the blocks covered by one ROI: the block holding pixel (left - 1) up to
+// the one holding pixel (right - 1), likewise for top and bottom.
+static void roi_map_rect(const ni_region_of_interest_t *roi,
+                         const ni_roi_map_state_t *p_state,
+                         ni_roi_map_rect_t *p_rect)
+{
+    uint32_t unit = p_state->unit;
+
+    p_rect->x0 = ni_max((int)((roi->left + unit - 1) / unit) - 1, 0);
+    p_rect->x1 = ni_min((int)((roi->right + unit - 1) / unit) - 1,
+                        (int)p_state->mb_width - 1);
+    p_rect->y0 = ni_max((int)((roi->top + unit - 1) / unit) - 1, 0);
+    p_rect->y1 = ni_min((int)((roi->bottom + unit - 1) / unit) - 1,
+                        (int)p_state->mb_height - 1);
+}
+
+// Repaint the blocks of p_dirty from scratch, applying the ROIs from the last
+// to the first, and keep sum_qp equal to the sum over all ROI steps of the
+// qp_info of every block: a block set at step s keeps its value for the
+// remaining (nb_steps - s + 1) steps. is_cleared tells the blocks and their
+// contributions are already zero.
+static void roi_map_repaint(ni_session_context_t *p_enc_ctx,
+                            ni_roi_map_state_t *p_state,
+                            const ni_aux_data_t *aux_data, int nb_roi,
+                            uint32_t self_size, const ni_roi_map_rect_t *p_dirty,
+                            int is_cleared)
+{
+    uint8_t *p_map = (uint8_t *)p_enc_ctx->roi_map;
+    uint32_t sub_num_mbs = (p_state->unit / 8) * (p_state->unit / 8);
+    const ni_region_of_interest_t *roi;
+    ni_enc_quad_roi_custom_map entry;
+    ni_roi_map_rect_t rect;
+    uint32_t weight, cur;
+    uint8_t value;
+    int r, x, y, step = 0;
+    size_t k;
+
+    for (y = p_dirty->y0; y <= p_dirty->y1 && !is_cleared; y++)
+    {
+        k = (size_t)y * p_state->mb_width + p_dirty->x0;
+        memset(p_map + k * sub_num_mbs, 0,
+               (size_t)(p_dirty->x1 - p_dirty->x0 + 1) * sub_num_mbs);
+        for (x = p_dirty->x0; x <= p_dirty->x1; x++, k++)
+        {
+            p_state->sum_qp -= p_state->qp_contrib[k];
+            p_state->qp_contrib[k] = 0;
+        }
+    }
+
+    // iterate ROI list from the last as regions are defined in order of
+    // decreasing importance.
+    for (r = nb_roi - 1; r >= 0; r--)
+    {
+        roi = (const ni_region_of_interest_t *)((uint8_t *)aux_data->data +
+                                                self_size * r);
+        if (!roi_map_entry(roi, p_state->roi_qp_level, &entry))
+        {
+            continue;
+        }
+        weight = (uint32_t)(p_state->nb_steps - step);
+        step++;
+
+        roi_map_rect(roi, p_state, &rect);
+        rect.x0 = ni_max(rect.x0, p_dirty->x0);
+        rect.x1 = ni_min(rect.x1, p_dirty->x1);
+        rect.y0 = ni_max(rect.y0, p_dirty->y0);
+        rect.y1 = ni_min(rect.y1, p_dirty->y1);
+        if (rect.x0 > rect.x1 || rect.y0 > rect.y1)
+        {
+            continue;
+        }
+
+        // copy ROI MBs QPs into custom map, one span of blocks per row
+        memcpy(&value, &entry, 1);
+        for (y = rect.y0; y <= rect.y1; y++)
+        {
+            k = (size_t)y * p_state->mb_width + rect.x0;
+            for (x = rect.x0; x <= rect.x1; x++, k++)
+            {
+                cur = ((ni_enc_quad_roi_custom_map *)(p_map + k * sub_num_mbs))
+                          ->field.qp_info;
+                p_state->qp_contrib[k] += (entry.field.qp_info - cur) * weight;
+            }
+            k = (size_t)y * p_state->mb_width + rect.x0;
+            memset(p_map + k * sub_num_mbs, value,
+                   (size_t)(rect.x1 - rect.x0 + 1) * sub_num_mbs);
+        }
+    }
+
+    for (y = p_dirty->y0; y <= p_dirty->y1; y++)
+    {
+        k = (size_t)y * p_state->mb_width + p_dirty->x0;
+        for (x = p_dirty->x0; x <= p_dirty->x1; x++, k++)
+        {
+            p_state->sum_qp += p_state->qp_contrib[k];
+        }
+    }
+}
+
 // Convert struct of ROIs to NetInt ROI map and store them inside the encoder
-// context passed in.
+// context passed in. When the previous ROI list is passed in and has the same
+// layout, only the blocks covered by the ROIs that changed are repainted.
 // return 0 if successful, -1 otherwise
 static int set_roi_map(ni_session_context_t *p_enc_ctx,
                        ni_codec_format_t codec_format,
                        const ni_aux_data_t *aux_data, int nb_roi, int width,
-                       int height, int intra_qp)
+                       int height, int intra_qp, const void *p_prev_rois,
+                       int prev_size)
 {
-    int r;
-    uint32_t i, j, k, m;
+    int r, i;
     const ni_region_of_interest_t *roi =
         (const ni_region_of_interest_t *)aux_data->data;
+    const ni_region_of_interest_t *prev_roi;
     uint32_t self_size = roi->self_size;
-    int32_t set_qp = 0;
-    uint32_t sumQp = 0;
-    uint8_t isAbsQp_flag = 0; // 0 for delta qp, 1 for absolute qp
     ni_xcoder_params_t *api_params =
         (ni_xcoder_params_t *)p_enc_ctx->p_session_config;
+    ni_roi_map_state_t *p_state =
+        (ni_roi_map_state_t *)p_enc_ctx->p_roi_map_state;
+    ni_enc_quad_roi_custom_map entry, prev_entry;
+    ni_roi_map_rect_t *p_dirty = NULL;
+    ni_roi_map_rect_t full;
+    int nb_dirty = 0;
+    int nb_changed;
+    int nb_steps = 0;
+    int valid, prev_valid;
+    uint32_t dirty_mbs = 0;
 
     uint32_t max_cu_size = (codec_format == NI_CODEC_FORMAT_H264) ? 16 : 64;
 
@@ -720,9 +887,6 @@ static int set_roi_map(ni_session_context_t *p_enc_ctx,
     uint32_t mbHeight = ((height + max_cu_size - 1) & (~(max_cu_size - 1))) /
         roiMapBlockUnitSize;
     uint32_t numMbs = mbWidth * mbHeight;
-    uint32_t subMbWidth = roiMapBlockUnitSize / 8;
-    uint32_t subMbHeight = subMbWidth;
-    uint32_t subNumMbs = subMbWidth * subMbHeight;
 
     // (ROI map version >= 1) each QP info takes 8-bit, represent 8x8 pixel
     // block
@@ -731,100 +895,134 @@ static int set_roi_map(ni_session_context_t *p_enc_ctx,
 
     // need to align to 64 bytes
     uint32_t customMapSize = ((block_size + 63) & (~63));
-    if (!p_enc_ctx->roi_map)
+
+    for (r = 0; r < nb_roi; r++)
+    {
+        roi = (const ni_region_of_interest_t *)((uint8_t *)aux_data->data +
+                                                self_size * r);
+        nb_steps += roi_map_entry(
+            roi, api_params->cfg_enc_params.customize_roi_qp_level, &entry);
+    }
+
+    // the map of the previous ROI list can be updated in place only if the
+    // map geometry and the ROIs applied to it are unchanged
+    if (!p_state || !p_enc_ctx->roi_map || p_state->map_size != customMapSize ||
+        p_state->unit != roiMapBlockUnitSize || p_state->mb_width != mbWidth ||
+        p_state->mb_height != mbHeight || p_state->nb_steps != nb_steps ||
+        p_state->roi_qp_level !=
+            api_params->cfg_enc_params.customize_roi_qp_level ||
+        !p_prev_rois || prev_size != aux_data->size ||
+        ((const ni_region_of_interest_t *)p_prev_rois)->self_size != self_size)
+    {
+        nb_dirty = -1;
+    } else
     {
-        p_enc_ctx->roi_map =
-            (ni_enc_quad_roi_custom_map *)calloc(1, customMapSize);
-        if (!p_enc_ctx->roi_map)
+        p_dirty = malloc(sizeof(ni_roi_map_rect_t) * 2 * nb_roi);
+        if (!p_dirty)
         {
-            return -1;
+            nb_dirty = -1;
         }
     }
 
-    // init ipcm_flag to 0, roiAbsQp_falg to 0 (qp delta), and qp_info to 0
-    memset(p_enc_ctx->roi_map, 0, customMapSize);
-
-    // iterate ROI list from the last as regions are defined in order of
-    // decreasing importance.
-    for (r = nb_roi - 1; r >= 0; r--)
+    for (r = 0; r < nb_roi && nb_dirty >= 0; r++)
     {
-        roi = (const ni_region_of_interest_t *)((uint8_t *)aux_data->data + self_size * r);
-        if (!roi->qoffset.den)
+        roi = (const ni_region_of_interest_t *)((uint8_t *)aux_data->data +
+                                                self_size * r);
+        prev_roi = (const ni_region_of_interest_t *)((uint8_t *)p_prev_rois +
+                                                     self_size * r);
+        if (memcmp(roi, prev_roi, self_size) == 0)
         {
-            ni_log2(p_enc_ctx, NI_LOG_DEBUG,  "ni_region_of_interest_t.qoffset.den must not be "
-                           "zero.\n");
             continue;
         }
-        if (api_params->cfg_enc_params.customize_roi_qp_level == NI_CUS_ROI_MAPFILE) {
-            // set_qp in range [1, 10] mean it need to reset qp after
-            // rate control in fw when customize_roi_qp_level is 1.
-            // set_qp is the level in customize qp map, it choose dst qp
-            // in customize qp map base on the rate control qp and set_qp
-            set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
-                            (float)roi->qoffset.den * NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL);
-            if (set_qp > 0 && set_qp <= NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL) {
-                isAbsQp_flag = api_params->cfg_enc_params.customize_roi_qp_level;
-            } else {
-                continue;
+        valid = roi_map_entry(roi, p_state->roi_qp_level, &entry);
+        prev_valid = roi_map_entry(prev_roi, p_state->roi_qp_level, &prev_entry);
+        if (valid != prev_valid)
+        {
+            // the steps of the ROIs after this one are renumbered
+            nb_dirty = -1;
+            break;
+        }
+        if (!valid)
+        {
+            continue;
+        }
+        roi_map_rect(prev_roi, p_state, &p_dirty[nb_dirty]);
+        roi_map_rect(roi, p_state, &p_dirty[nb_dirty + 1]);
+        for (i = nb_dirty, nb_changed = nb_dirty + 2; i < nb_changed; i++)
+        {
+            if (p_dirty[i].x0 <= p_dirty[i].x1 && p_dirty[i].y0 <= p_dirty[i].y1)
+            {
+                dirty_mbs += (uint32_t)(p_dirty[i].x1 - p_dirty[i].x0 + 1) *
+                    (p_dirty[i].y1 - p_dirty[i].y0 + 1);
+                p_dirty[nb_dirty++] = p_dirty[i];
             }
-        } else {
-            set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
-                            (float)roi->qoffset.den * NI_INTRA_QP_RANGE);
-            set_qp = clip3(NI_MIN_QP_DELTA, NI_MAX_QP_DELTA, set_qp);
-            // Adjust qp delta range (-25 to 25) to (0 to 63): 0 to 0, -1 to 1, -2 to
-            // 2 ... 1 to 63, 2 to 62 ...
-            // Theoretically the possible qp delta range is (-32 to 31)
-            set_qp = (NI_MAX_QP_INFO + 1 - set_qp) % (NI_MAX_QP_INFO + 1);
         }
-        ni_log2(p_enc_ctx, NI_LOG_DEBUG,
-            "set_roi_map: left %d right %d top %d bottom %d num %d den"
-            " %d set_qp %d\n",
-            roi->left, roi->right, roi->top, roi->bottom, roi->qoffset.num,
-            roi->qoffset.den, set_qp);
+        if (dirty_mbs >= numMbs)
+        {
+            // cheaper to rebuild the whole map
+            nb_dirty = -1;
+        }
+    }
 
-        // copy ROI MBs QPs into custom map
-        for (j = 0; j < mbHeight; j++)
+    if (nb_dirty < 0)
+    {
+        if (!p_state || !p_enc_ctx->roi_map ||
+            p_state->map_size != customMapSize ||
+            p_state->mb_width * p_state->mb_height != numMbs)
         {
-            for (i = 0; i < mbWidth; i++)
+            ni_memfree(p_enc_ctx->p_roi_map_state);
+            ni_memfree(p_enc_ctx->roi_map);
+            p_state = calloc(1, sizeof(ni_roi_map_state_t) +
+                                 sizeof(uint32_t) * numMbs);
+            p_enc_ctx->roi_map =
+                (ni_enc_quad_roi_custom_map *)calloc(1, customMapSize);
+            if (!p_state || !p_enc_ctx->roi_map)
             {
-                k = j * (int)mbWidth + i;
-
-                for (m = 0; m < subNumMbs; m++)
-                {
-                    if (((int)(i % mbWidth) >=
-                         (int)((roi->left + roiMapBlockUnitSize - 1) /
-                               roiMapBlockUnitSize) -
-                             1) &&
-                        ((int)(i % mbWidth) <=
-                         (int)((roi->right + roiMapBlockUnitSize - 1) /
-                               roiMapBlockUnitSize) -
-                             1) &&
-                        ((int)(j % mbHeight) >=
-                         (int)((roi->top + roiMapBlockUnitSize - 1) /
-                               roiMapBlockUnitSize) -
-                             1) &&
-                        ((int)(j % mbHeight) <=
-                         (int)((roi->bottom + roiMapBlockUnitSize - 1) /
-                               roiMapBlockUnitSize) -
-                             1))
-                    {
-                        p_enc_ctx->roi_map[k * subNumMbs + m].field.ipcm_flag =
-                            0;   // don't force skip mode
-                        p_enc_ctx->roi_map[k * subNumMbs + m]
-                            .field.roiAbsQp_flag = isAbsQp_flag;
-                        p_enc_ctx->roi_map[k * subNumMbs + m].field.qp_info =
-                            set_qp;
-                        // ni_log2(p_enc_ctx, NI_LOG_DEBUG,  "## x %d y %d index %d\n", i,
-                        // j, k*subNumMbs+m);
-                    }
-                }
-                sumQp += p_enc_ctx->roi_map[k * subNumMbs].field.qp_info;
+                free(p_state);
+                ni_memfree(p_enc_ctx->roi_map);
+                free(p_dirty);
+                return -1;
             }
+            p_state->qp_contrib = (uint32_t *)(p_state + 1);
+            p_state->map_size = customMapSize;
+            p_enc_ctx->p_roi_map_state = p_state;
+        }
+        p_state->unit = roiMapBlockUnitSize;
+        p_state->mb_width = mbWidth;
+        p_state->mb_height = mbHeight;
+        p_state->roi_qp_level = api_params->cfg_enc_params.customize_roi_qp_level;
+        p_state->nb_steps = nb_steps;
+        p_state->sum_qp = 0;
+
+        // init ipcm_flag to 0, roiAbsQp_falg to 0 (qp delta), and qp_info to 0
+        memset(p_enc_ctx->roi_map, 0, customMapSize);
+        memset(p_state->qp_contrib, 0, sizeof(uint32_t) * numMbs);
+
+        full.x0 = 0;
+        full.x1 = (int)mbWidth - 1;
+        full.y0 = 0;
+        full.y1 = (int)mbHeight - 1;
+        if (numMbs)
+        {
+            roi_map_repaint(p_enc_ctx, p_state, aux_data, nb_roi, self_size,
+                            &full, 1);
+        }
+    } else
+    {
+        for (i = 0; i < nb_dirty; i++)
+        {
+            roi_map_repaint(p_enc_ctx, p_state, aux_data, nb_roi, self_size,
+                            &p_dirty[i], 0);
         }
     }
+    free(p_dirty);
+
+    ni_log2(p_enc_ctx, NI_LOG_DEBUG,
+            "set_roi_map: %d ROIs %d applied, %s %d dirty rects\n", nb_roi,
+            nb_steps, nb_dirty < 0 ? "rebuilt map," : "repainted", nb_dirty);
 
     p_enc_ctx->roi_len = customMapSize;
-    p_enc_ctx->roi_avg_qp = (numMbs != 0 ? (sumQp + (numMbs >> 1)) / numMbs : 0) + NI_DEFAULT_INTRA_QP;
+    p_enc_ctx->roi_avg_qp = (numMbs != 0 ? (p_state->sum_qp + (numMbs >> 1)) / numMbs : 0) + NI_DEFAULT_INTRA_QP;
 
     return 0;
 }
@@ -1584,6 +1782,8 @@ void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
     if (api_params->cfg_enc_params.roi_enable && aux_data)
     {
         int is_new_rois = 1;
+        ni_region_of_interest_t *p_prev_rois = NULL;
+        int prev_size = 0;
         const ni_region_of_interest_t *roi = NULL;
         uint32_t self_size = 0;
 
@@ -1604,10 +1804,12 @@ void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
                 p_enc_ctx->roi_side_data_size != aux_data->size ||
                 memcmp(p_enc_ctx->av_rois, aux_data->data, aux_data->size) != 0)
             {
+                // keep the last ROIs until the map has been updated from them
+                p_prev_rois = p_enc_ctx->av_rois;
+                prev_size = p_enc_ctx->roi_side_data_size;
                 p_enc_ctx->roi_side_data_size = aux_data->size;
                 p_enc_ctx->nb_rois = nb_roi;
 
-                free(p_enc_ctx->av_rois);
                 p_enc_ctx->av_rois = malloc(aux_data->size);
                 if (!p_enc_ctx->av_rois)
                 {
@@ -1627,11 +1829,13 @@ void ni_enc_prep_aux_data(ni_session_context_t *p_enc_ctx,
                 if (set_roi_map(p_enc_ctx, codec_format, aux_data, nb_roi,
                                 api_params->source_width,
                                 api_params->source_height,
-                                api_params->cfg_enc_params.rc.intra_qp))
+                                api_params->cfg_enc_params.rc.intra_qp,
+                                p_prev_rois, prev_size))
                 {
                     ni_log2(p_enc_ctx, NI_LOG_ERROR,  "set_roi_map failed\n");
                 }
             }
+            free(p_prev_rois);
         }
 
         // ROI data in the frame
@@ -2284,13 +2488,11 @@ void ni_enc_copy_aux_data(ni_session_context_t *p_enc_ctx,
     }
 
     uint32_t frame_metadata_size = NI_APP_ENC_FRAME_META_DATA_SIZE;
-    if (ni_cmp_fw_api_ver((char*) &p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6Q") < 0)
+    if (!ni_fw_api_supports(p_enc_ctx, NI_FW_API_ENC_ZEROCOPY))
     {
         frame_metadata_size = NI_APP_ENC_FRAME_META_DATA_SIZE_UNDER_MAJOR_6_MINOR_Q;
     }
-    else if (ni_cmp_fw_api_ver((char*) &p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6rc") < 0)
+    else if (!ni_fw_api_supports(p_enc_ctx, NI_FW_API_ENC_META_6RC))
     {
         frame_metadata_size = NI_APP_ENC_FRAME_META_DATA_SIZE_UNDER_MAJOR_6_MINOR_rc;
     }
@@ -2943,9 +3145,10 @@ const uint8_t *ni_find_start_code (const uint8_t *p, const uint8_t *end, uint32_
 int ni_extract_custom_sei(uint8_t *pkt_data, int pkt_size, long index,
                           ni_packet_t *p_packet, uint8_t sei_type, int vcl_found)
 {
-  int i, len;
+  int i, len, n;
   uint8_t *udata;
   uint8_t *sei_data;
+  uint8_t *p_ep, *p_end;
   int sei_size;
   int sei_index;
   ni_custom_sei_t *p_custom_sei;
@@ -2954,14 +3157,15 @@ int ni_extract_custom_sei(uint8_t *pkt_data, int pkt_size, long index,
 
   if (p_packet->p_custom_sei_set == NULL)
   {
-    /* max size */
+    /* max size; only the entries in use are ever written, so the pages of
+     * the unused ones are not touched */
     p_packet->p_custom_sei_set = (ni_custom_sei_set_t *)malloc(sizeof(ni_custom_sei_set_t));
     if (p_packet->p_custom_sei_set == NULL)
     {
       ni_log(NI_LOG_ERROR, "failed to allocate all custom sei buffer.\n");
       return NI_RETCODE_ERROR_MEM_ALOC;
     }
-    memset(p_packet->p_custom_sei_set, 0, sizeof(ni_custom_sei_set_t));
+    p_packet->p_custom_sei_set->count = 0;
   }
 
   sei_index = p_packet->p_custom_sei_set->count;
@@ -3008,18 +3212,32 @@ int ni_extract_custom_sei(uint8_t *pkt_data, int pkt_size, long index,
 
   /* extract SEI payload data
    * SEI payload data in NAL is EBSP(Encapsulated Byte Sequence Payload),
-   * need change EBSP to RBSP(Raw Byte Sequence Payload) for exact size
+   * need change EBSP to RBSP(Raw Byte Sequence Payload) for exact size.
+   * The bytes between escaping bytes are copied as whole runs.
    */
-  for (i = 0, len = 0; (i < pkt_size - index) && len < sei_size; i++, len++)
+  for (i = 0, len = 0; (i < pkt_size - index) && len < sei_size;)
   {
-    /* if the latest 3-byte data pattern matchs '00 00 03' which means udata[i] is an escaping byte,
-     * discard udata[i]. */
-    if (i >= 2 && udata[i - 2] == 0 && udata[i - 1] == 0 && udata[i] == 3)
+    n = ni_min(pkt_size - (int)index - i, sei_size - len);
+    p_end = &udata[i + n];
+    /* an escaping byte is a 03 whose latest 2 bytes are '00 00' */
+    p_ep = &udata[i];
+    while ((p_ep = (uint8_t *)memchr(p_ep, 3, p_end - p_ep)) != NULL &&
+           (p_ep - udata < 2 || p_ep[-1] != 0 || p_ep[-2] != 0))
+    {
+      p_ep++;
+    }
+    if (p_ep)
+    {
+      n = (int)(p_ep - &udata[i]);
+    }
+    memcpy(&sei_data[len], &udata[i], n);
+    len += n;
+    i += n;
+    if (p_ep)
     {
-        len--;
-        continue;
+      /* discard the escaping byte */
+      i++;
     }
-    sei_data[len] = udata[i];
   }
 
   if (len != sei_size)
@@ -3345,7 +3563,7 @@ int ni_dec_packet_parse(ni_session_context_t *p_session_ctx, ni_xcoder_params_t
 int ni_expand_frame(ni_frame_t *dst, ni_frame_t *src, int dst_stride[],
                         int raw_width, int raw_height, int ni_fmt, int nb_planes)
 {
-    int i, j, h, tenBit = 0;
+    int i, j, h, len, tenBit = 0;
     int vpad[3], hpad[3], src_height[3], src_width[3], src_stride[3];
     uint8_t *src_line, *dst_line, *sample, *dest, YUVsample;
     uint16_t lastidx;
@@ -3493,14 +3711,16 @@ int ni_expand_frame(ni_frame_t *dst, ni_frame_t *src, int dst_stride[],
 
                 if (tenBit)
                 {
-                    sample = &src_line[(lastidx - 1) * 2];
+                    /* replicate the last two byte sample, doubling the
+                       copied run each pass */
+                    sample = &dst_line[(lastidx - 1) * 2];
                     dest = &dst_line[lastidx * 2];
 
-                    /* two bytes per sample */
-                    for (j = 0; j < hpad[i] / 2; j++)
+                    for (j = 2; j < hpad[i] + 2; j += len)
                     {
-                        memcpy(dest, sample, 2);
-                        dest += 2;
+                        len = ni_min(j, hpad[i] + 2 - j);
+                        memcpy(dest, sample, len);
+                        dest += len;
                     }
                 } else
                 {
@@ -3553,9 +3773,7 @@ int ni_reconfig_ppu_output(ni_session_context_t *p_session_ctx,
     }
 
     // check fw revision
-    if (ni_cmp_fw_api_ver(
-            (char*) &p_session_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6rx") < 0)
+    if (!ni_fw_api_supports(p_session_ctx, NI_FW_API_PPU_RECONFIG))
     {
         ni_log2(p_session_ctx, NI_LOG_ERROR,  "%s: not supported on device with FW API version < 6rx\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
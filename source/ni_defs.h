@@ -104,7 +104,7 @@ extern "C"
 #define MACRO_TO_STR(s) #s
 #define MACROS_TO_VER_STR(a, b) MACRO_TO_STR(a.b)
 #define LIBXCODER_API_VERSION_MAJOR 2
-#define LIBXCODER_API_VERSION_MINOR 82
+#define LIBXCODER_API_VERSION_MINOR 83
 #define LIBXCODER_API_VERSION MACROS_TO_VER_STR(LIBXCODER_API_VERSION_MAJOR, \
                                                 LIBXCODER_API_VERSION_MINOR)
 
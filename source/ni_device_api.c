@@ -45,6 +45,10 @@
 #include <signal.h>
 #include <poll.h>
 #endif
+#if __linux__
+#include <sched.h>
+#include <pthread.h>
+#endif
 
 #include <stdint.h>
 #include <string.h>
@@ -197,6 +201,14 @@ ni_retcode_t ni_device_session_context_init(ni_session_context_t *p_ctx)
         return NI_RETCODE_FAILURE;
     }
     p_ctx->pext_mutex = &p_ctx->mutex; //used exclusively for hwdl
+    if (ni_pthread_mutex_init(&p_ctx->send_mutex) ||
+        ni_pthread_mutex_init(&p_ctx->recv_mutex))
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR %s(): init xcoder_send/recv_mutex fail, return\n",
+               __func__);
+        return NI_RETCODE_FAILURE;
+    }
 
     // low delay send/recv sync init
     if (ni_pthread_mutex_init(&p_ctx->low_delay_sync_mutex))
@@ -265,6 +277,8 @@ void ni_device_session_context_clear(ni_session_context_t *p_ctx)
     {
         p_ctx->mutex_initialized = false;
         ni_pthread_mutex_destroy(&p_ctx->mutex);
+        ni_pthread_mutex_destroy(&p_ctx->send_mutex);
+        ni_pthread_mutex_destroy(&p_ctx->recv_mutex);
         ni_pthread_mutex_destroy(&p_ctx->low_delay_sync_mutex);
         ni_pthread_cond_destroy(&p_ctx->low_delay_sync_cond);
     }
@@ -855,6 +869,85 @@ END:
     return retval;
 }
 
+#ifdef __linux__
+// Max number of CPUs of a card local CPU list that are used
+#define NI_MAX_LOCAL_CPUS 1024
+// next local CPU to suggest, per first CPU of the local CPU list of a card
+static int g_cpu_spread[NI_MAX_LOCAL_CPUS];
+
+// The n-th CPU set in p_mask, which has nb_cpus set
+static int ni_local_cpu_nth(const uint64_t *p_mask, int nb_cpus, int n)
+{
+    int cpu;
+
+    n %= nb_cpus;
+    for (cpu = 0; cpu < NI_MAX_LOCAL_CPUS; cpu++)
+    {
+        if ((p_mask[cpu / 64] & (1ULL << (cpu % 64))) && !n--)
+        {
+            break;
+        }
+    }
+    return cpu;
+}
+#endif
+
+/*!*****************************************************************************
+ *  \brief  Place the threads of a session opened with enableCpuAffinity on
+ *          the CPUs local to its card: pin its keep alive thread to them and
+ *          pick the CPUs suggested to the application's send and receive
+ *          threads, see ni_device_session_cpu_hint()
+ *
+ *  \param[in] p_ctx  session context, with its keep alive thread started
+ *
+ *  \return None
+ ******************************************************************************/
+void ni_session_cpu_placement_init(ni_session_context_t *p_ctx)
+{
+#ifdef __linux__
+    uint64_t cpu_mask[NI_MAX_LOCAL_CPUS / 64];
+    cpu_set_t cpu_set;
+    int i, first, spread, rc;
+
+    p_ctx->nb_local_cpus = ni_rsrc_get_local_cpus(
+        p_ctx->blk_xcoder_name, cpu_mask, NI_MAX_LOCAL_CPUS / 64);
+    if (!p_ctx->nb_local_cpus)
+    {
+        ni_log2(p_ctx, NI_LOG_INFO, "Warning: %s() %s local CPUs not known\n",
+                __func__, p_ctx->blk_xcoder_name);
+        return;
+    }
+
+    // each session takes the next NI_SESSION_THREAD_NB local CPUs, so its
+    // send and receive threads do not compete for the same core
+    first = ni_local_cpu_nth(cpu_mask, p_ctx->nb_local_cpus, 0);
+    spread = __atomic_fetch_add(&g_cpu_spread[first], NI_SESSION_THREAD_NB,
+                                __ATOMIC_RELAXED);
+    for (i = 0; i < NI_SESSION_THREAD_NB; i++)
+    {
+        p_ctx->thread_cpus[i] =
+            ni_local_cpu_nth(cpu_mask, p_ctx->nb_local_cpus, spread + i);
+    }
+
+    // the keep alive thread wakes up rarely, it may use any local CPU
+    CPU_ZERO(&cpu_set);
+    for (i = 0; i < NI_MAX_LOCAL_CPUS && i < CPU_SETSIZE; i++)
+    {
+        if (cpu_mask[i / 64] & (1ULL << (i % 64)))
+        {
+            CPU_SET(i, &cpu_set);
+        }
+    }
+    rc = pthread_setaffinity_np(p_ctx->keep_alive_thread, sizeof(cpu_set),
+                                &cpu_set);
+    ni_log2(p_ctx, NI_LOG_DEBUG,
+            "%s(): %d local CPUs from %d, send %d recv %d, keep alive pinned "
+            "rc %d\n", __func__, p_ctx->nb_local_cpus, first,
+            p_ctx->thread_cpus[NI_SESSION_THREAD_SEND],
+            p_ctx->thread_cpus[NI_SESSION_THREAD_RECV], rc);
+#endif
+}
+
 /*!*****************************************************************************
  *  \brief  Open a new device session depending on the device_type parameter
  *          If device_type is NI_DEVICE_TYPE_DECODER opens decoding session
@@ -935,6 +1028,7 @@ ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
   p_ctx->roi_side_data_size = p_ctx->nb_rois = 0;
   p_ctx->av_rois = NULL;
   p_ctx->roi_map = NULL;
+  p_ctx->p_roi_map_state = NULL;
   p_ctx->avc_roi_map = NULL;
   p_ctx->hevc_roi_map = NULL;
   p_ctx->hevc_sub_ctu_roi_buf = NULL;
@@ -1290,6 +1384,7 @@ ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
   }
 
   memcpy(p_ctx->fw_rev , p_device_context->p_device_info->fw_rev, 8);
+  ni_fw_api_update_flags(p_ctx);
 
   ni_rsrc_free_device_context(p_device_context);
 
@@ -1494,6 +1589,13 @@ ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
   }
   ni_log2(p_ctx, NI_LOG_DEBUG,  "Enabled keep alive thread\n");
 
+  if ((NI_DEVICE_TYPE_DECODER == device_type ||
+       NI_DEVICE_TYPE_ENCODER == device_type) && p_ctx->p_session_config &&
+      ((ni_xcoder_params_t *)p_ctx->p_session_config)->enableCpuAffinity)
+  {
+      ni_session_cpu_placement_init(p_ctx);
+  }
+
   // allocate memory for encoder change data to be reused
   p_ctx->enc_change_params = calloc(1, sizeof(ni_encoder_change_params_t));
   if (!p_ctx->enc_change_params)
@@ -1519,6 +1621,86 @@ END:
     return retval;
 }
 
+/*!*****************************************************************************
+ *  \brief  Get the CPU suggested for a thread that sends to or receives
+ *          from a session. It is one of the CPUs local to the session's
+ *          card, assigned round robin to the threads of the sessions opened
+ *          on that card, so that they are spread over the local cores and
+ *          the send and receive threads of a session run on different
+ *          ones when the card has more than one local CPU. Only available
+ *          when the session was opened with enableCpuAffinity set.
+ *
+ *  \param[in] p_ctx   Pointer to an opened ni_session_context_t struct
+ *  \param[in] thread  NI_SESSION_THREAD_SEND or NI_SESSION_THREAD_RECV
+ *
+ *  \return CPU id, -1 if there is no suggestion
+ ******************************************************************************/
+int ni_device_session_cpu_hint(ni_session_context_t *p_ctx,
+                               ni_session_thread_t thread)
+{
+    if (!p_ctx || p_ctx->nb_local_cpus <= 0 || thread < 0 ||
+        thread >= NI_SESSION_THREAD_NB)
+    {
+        return -1;
+    }
+    return p_ctx->thread_cpus[thread];
+}
+
+/*!*****************************************************************************
+ *  \brief  Pin the calling thread to the CPU suggested by
+ *          ni_device_session_cpu_hint() for its role. Nothing is done if
+ *          there is no suggestion, eg. the session was opened without
+ *          enableCpuAffinity.
+ *
+ *  \param[in] p_ctx   Pointer to an opened ni_session_context_t struct
+ *  \param[in] thread  NI_SESSION_THREAD_SEND or NI_SESSION_THREAD_RECV
+ *
+ *  \return On success
+ *                          NI_RETCODE_SUCCESS
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_FAILURE
+ ******************************************************************************/
+ni_retcode_t ni_device_session_pin_thread(ni_session_context_t *p_ctx,
+                                          ni_session_thread_t thread)
+{
+    int cpu;
+
+    if (!p_ctx || thread < 0 || thread >= NI_SESSION_THREAD_NB)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() passed parameters are invalid!, return\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    cpu = ni_device_session_cpu_hint(p_ctx, thread);
+    if (cpu < 0)
+    {
+        return NI_RETCODE_SUCCESS;
+    }
+#ifdef __linux__
+    cpu_set_t cpu_set;
+
+    if (cpu >= CPU_SETSIZE)
+    {
+        return NI_RETCODE_SUCCESS;
+    }
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0)
+    {
+        char errmsg[NI_ERRNO_LEN] = {0};
+        ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() cpu %d: %s\n", __func__, cpu,
+                errmsg);
+        return NI_RETCODE_FAILURE;
+    }
+    ni_log2(p_ctx, NI_LOG_DEBUG, "%s(): thread %d pinned to cpu %d\n",
+            __func__, thread, cpu);
+#endif
+    return NI_RETCODE_SUCCESS;
+}
+
 /*!*****************************************************************************
  *  \brief  Close device session that was previously opened by calling
  *          ni_device_session_open()
@@ -1553,6 +1735,13 @@ ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx,
         return NI_RETCODE_INVALID_PARAM;
     }
 
+    // wait for the data transfers of both directions to finish
+    if (p_ctx->async_mode)
+    {
+        ni_pthread_mutex_lock(&p_ctx->send_mutex);
+        ni_pthread_mutex_lock(&p_ctx->recv_mutex);
+    }
+
     ni_pthread_mutex_lock(&p_ctx->mutex);
     p_ctx->xcoder_state |= NI_XCODER_CLOSE_STATE;
     ni_pthread_mutex_unlock(&p_ctx->mutex);
@@ -1622,6 +1811,7 @@ ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx,
     ni_memfree(p_ctx->p_hdr_buf);
     ni_memfree(p_ctx->av_rois);
     ni_memfree(p_ctx->roi_map);
+    ni_memfree(p_ctx->p_roi_map_state);
     ni_memfree(p_ctx->avc_roi_map);
     ni_memfree(p_ctx->hevc_roi_map);
     ni_memfree(p_ctx->hevc_sub_ctu_roi_buf);
@@ -1652,6 +1842,16 @@ ni_retcode_t ni_device_session_close(ni_session_context_t *p_ctx,
     p_ctx->xcoder_state &= ~NI_XCODER_CLOSE_STATE;
     ni_pthread_mutex_unlock(&p_ctx->mutex);
 
+    if (p_ctx->async_mode)
+    {
+        ni_pthread_mutex_unlock(&p_ctx->recv_mutex);
+        ni_pthread_mutex_unlock(&p_ctx->send_mutex);
+    }
+
+    // the buffers the session returned stay cached for the next one, drop
+    // those already idle for too long
+    ni_mem_cache_expire();
+
     return retval;
 }
 
@@ -1682,6 +1882,11 @@ ni_retcode_t ni_device_session_flush(ni_session_context_t* p_ctx, ni_device_type
       return NI_RETCODE_INVALID_PARAM;
   }
 
+  // EOS is sent like a packet, after any data transfer still in progress
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_lock(&p_ctx->send_mutex);
+  }
   ni_pthread_mutex_lock(&p_ctx->mutex);
   p_ctx->xcoder_state |= NI_XCODER_FLUSH_STATE;
 
@@ -1708,6 +1913,10 @@ ni_retcode_t ni_device_session_flush(ni_session_context_t* p_ctx, ni_device_type
   p_ctx->ready_to_close = (NI_RETCODE_SUCCESS == retval);
   p_ctx->xcoder_state &= ~NI_XCODER_FLUSH_STATE;
   ni_pthread_mutex_unlock(&p_ctx->mutex);
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_unlock(&p_ctx->send_mutex);
+  }
   return retval;
 }
 
@@ -1790,12 +1999,22 @@ ni_retcode_t ni_device_dec_session_flush(ni_session_context_t *p_ctx)
         ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s ctx null, return\n", __func__);
         return NI_RETCODE_INVALID_PARAM;
     }
+    if (p_ctx->async_mode)
+    {
+        ni_pthread_mutex_lock(&p_ctx->send_mutex);
+        ni_pthread_mutex_lock(&p_ctx->recv_mutex);
+    }
     ni_pthread_mutex_lock(&p_ctx->mutex);
     retval = ni_decoder_session_flush(p_ctx);
     if (NI_RETCODE_SUCCESS == retval) {
         p_ctx->ready_to_close = 0;
     }
     ni_pthread_mutex_unlock(&p_ctx->mutex);
+    if (p_ctx->async_mode)
+    {
+        ni_pthread_mutex_unlock(&p_ctx->recv_mutex);
+        ni_pthread_mutex_unlock(&p_ctx->send_mutex);
+    }
     return retval;
 }
 
@@ -1898,6 +2117,105 @@ int ni_device_session_write(ni_session_context_t *p_ctx, ni_session_data_io_t *p
   return retval;
 }
 
+/*!*****************************************************************************
+ *  \brief  Check whether the frame just read from the decoder reports a new
+ *          resolution or pixel format, and if so reset the active resolution
+ *          so that it is queried again by the next read
+ *
+ *  \return 1 if the sequence changed, 0 otherwise
+ ******************************************************************************/
+static int ni_decoder_resolution_changed(ni_session_context_t *p_ctx,
+                                         ni_frame_t *p_frame)
+{
+    // check resolution change only after initial setting obtained
+    // p_frame->video_width is picture width and will be 32-align
+    // adjusted to frame size; p_frame->video_height is the same as
+    // frame size, then compare them to saved one for resolution checking
+    //
+    uint32_t aligned_width;
+    if(QUADRA)
+    {
+        aligned_width = ((((p_frame->video_width * p_ctx->bit_depth_factor) + 127) / 128) * 128);
+    }
+    else
+    {
+        aligned_width = ((p_frame->video_width + 31) / 32) * 32;
+    }
+
+    // aligned_width may equal to active_video_width if bit depth and width
+    // are changed at the same time. So, check video_width != actual_video_width.
+    if (p_ctx->frame_num && (p_ctx->pixel_format_changed ||
+        (p_frame->video_width && p_frame->video_height &&
+         (aligned_width != p_ctx->active_video_width ||
+          p_frame->video_height != p_ctx->active_video_height))))
+    {
+        ni_log2(
+            p_ctx, NI_LOG_DEBUG,
+            "%s (decoder): resolution change, frame size %ux%u -> %ux%u, "
+            "width %u bit %d, pix_fromat_changed %d, actual_video_width %d, continue read ...\n",
+            __func__, p_ctx->active_video_width, p_ctx->active_video_height,
+            aligned_width, p_frame->video_height,
+            p_frame->video_width, p_ctx->bit_depth_factor,
+            p_ctx->pixel_format_changed, p_ctx->actual_video_width);
+        // get the frame buffers of the new resolution ready while the
+        // sequence change is handled; a bit depth change is not known yet
+        ni_dec_fme_buffer_pool_prewarm(
+            p_ctx, p_frame->video_width, p_frame->video_height,
+            p_ctx->codec_format == NI_CODEC_FORMAT_H264,
+            p_ctx->bit_depth_factor);
+        // reset active video resolution to 0 so it can be queried in the re-read
+        p_ctx->active_video_width = 0;
+        p_ctx->active_video_height = 0;
+        p_ctx->actual_video_width = 0;
+        return 1;
+    }
+    return 0;
+}
+
+/*!*****************************************************************************
+ *  \brief  Read a frame from the decoder, reading again at the new resolution
+ *          as long as the frame read reports a sequence change
+ *
+ *  \param[in] seq_change_read_count  1 if p_frame is re-read after a sequence
+ *                                    change, 0 otherwise
+ *
+ *  \return rx size of the frame or error, as ni_decoder_session_read()
+ ******************************************************************************/
+static int ni_decoder_read_frame(ni_session_context_t *p_ctx,
+                                 ni_frame_t *p_frame, int seq_change_read_count)
+{
+  int retval;
+
+  for (;;)
+  {
+    retval = ni_decoder_session_read(p_ctx, p_frame);
+    if (0 == retval && seq_change_read_count)
+    {
+        ni_log2(p_ctx, NI_LOG_DEBUG,
+               "%s (decoder): seq change NO data, next time.\n", __func__);
+        p_ctx->active_video_width = 0;
+        p_ctx->active_video_height = 0;
+        p_ctx->actual_video_width = 0;
+        break;
+    }
+    else if (retval < 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,  "%s (decoder): failure ret %d, return ..\n",
+               __func__, retval);
+        break;
+    }
+    else if (ni_decoder_resolution_changed(p_ctx, p_frame))
+    {
+        seq_change_read_count++;
+    }
+    else
+    {
+      break;
+    }
+  }
+  return retval;
+}
+
 /*!*****************************************************************************
  *  \brief  Read data from the device
  *          If device_type is NI_DEVICE_TYPE_DECODER reads data packet from
@@ -1971,84 +2289,158 @@ int ni_device_session_read(ni_session_context_t *p_ctx, ni_session_data_io_t *p_
   {
     case NI_DEVICE_TYPE_DECODER:
     {
-      int seq_change_read_count = 0;
       p_data->data.frame.src_codec = p_ctx->codec_format;
-      for (;;)
-      {
-        retval = ni_decoder_session_read(p_ctx, &(p_data->data.frame));
-        // check resolution change only after initial setting obtained
-        // p_data->data.frame.video_width is picture width and will be 32-align
-        // adjusted to frame size; p_data->data.frame.video_height is the same as
-        // frame size, then compare them to saved one for resolution checking
-        //
-        uint32_t aligned_width;
-        if(QUADRA)
-        {
-            aligned_width = ((((p_data->data.frame.video_width * p_ctx->bit_depth_factor) + 127) / 128) * 128);
-        }
-        else
-        {
-            aligned_width = ((p_data->data.frame.video_width + 31) / 32) * 32;
-        }
+      retval = ni_decoder_read_frame(p_ctx, &(p_data->data.frame), 0);
+      break;
+    }
+    case NI_DEVICE_TYPE_ENCODER:
+    {
+      retval = ni_encoder_session_read(p_ctx, &(p_data->data.packet));
+      break;
+    }
+    case NI_DEVICE_TYPE_AI:
+    {
+        retval = ni_ai_session_read(p_ctx, &(p_data->data.packet));
+        break;
+    }
+    default:
+    {
+      retval = NI_RETCODE_INVALID_PARAM;
+      ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() Unrecognized device type: %d",
+             __func__, device_type);
+      break;
+    }
+  }
+
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+  p_ctx->xcoder_state &= ~NI_XCODER_READ_STATE;
+  ni_pthread_mutex_unlock(&p_ctx->mutex);
+  return retval;
+}
+
+/*!*****************************************************************************
+ *  \brief  Read all the data available from the device in one call, up to
+ *          nb_data entries. The first entry is read as ni_device_session_read()
+ *          would; the following ones only if they are ready already.
+ *
+ *  \param[in] p_ctx        Pointer to a caller allocated
+ *                          ni_session_context_t struct
+ *  \param[in] p_data       Array of nb_data caller allocated
+ *                          ni_session_data_io_t structs. For the encoder each
+ *                          has its packet buffer allocated. For the decoder
+ *                          the first one is set up with
+ *                          ni_decoder_frame_buffer_alloc() as for
+ *                          ni_device_session_read(); the others may be left
+ *                          without a buffer, they then get one from the
+ *                          decoder frame buffer pool when they are filled.
+ *                          Frames are released with
+ *                          ni_decoder_frame_buffer_free() as usual.
+ *  \param[in] nb_data      Number of entries in p_data
+ *  \param[in] device_type  NI_DEVICE_TYPE_DECODER or NI_DEVICE_TYPE_ENCODER
+ *
+ *  \return On success
+ *                          Number of entries filled, in output order. An end
+ *                          of stream packet is counted and is the last one.
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ ******************************************************************************/
+int ni_device_session_read_batch(ni_session_context_t *p_ctx,
+                                 ni_session_data_io_t *p_data, int nb_data,
+                                 ni_device_type_t device_type)
+{
+  int retval;
+
+  if (!p_ctx || !p_data || nb_data <= 0)
+  {
+      ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s passed parameters are null, return\n",
+             __func__);
+      return NI_RETCODE_INVALID_PARAM;
+  }
+
+  // Here check if keep alive thread is closed.
+#ifdef _WIN32
+  if (p_ctx->keep_alive_thread.handle && p_ctx->keep_alive_thread_args &&
+      p_ctx->keep_alive_thread_args->close_thread)
+#else
+  if (p_ctx->keep_alive_thread && p_ctx->keep_alive_thread_args &&
+      p_ctx->keep_alive_thread_args->close_thread)
+#endif
+  {
+      ni_log2(p_ctx, NI_LOG_ERROR,
+             "ERROR: %s() keep alive thread has been closed, "
+             "hw:%d, session:%d\n",
+             __func__, p_ctx->hw_id, p_ctx->session_id);
+      return NI_RETCODE_ERROR_INVALID_SESSION;
+  }
+
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+  // In close state, let the close process execute first.
+  if (p_ctx->xcoder_state & NI_XCODER_CLOSE_STATE)
+  {
+      ni_log2(p_ctx, NI_LOG_DEBUG,  "%s close state, return\n", __func__);
+      ni_pthread_mutex_unlock(&p_ctx->mutex);
+      ni_usleep(100);
+      return NI_RETCODE_ERROR_INVALID_SESSION;
+  }
+  p_ctx->xcoder_state |= NI_XCODER_READ_STATE;
+  ni_pthread_mutex_unlock(&p_ctx->mutex);
 
-        if (0 == retval && seq_change_read_count)
+  switch (device_type)
+  {
+    case NI_DEVICE_TYPE_DECODER:
+    {
+      int i;
+      for (i = 0; i < nb_data; i++)
+      {
+        p_data[i].data.frame.src_codec = p_ctx->codec_format;
+      }
+      retval = ni_decoder_session_read_batch(p_ctx, p_data, nb_data);
+      // a frame reporting a new resolution is re-read as by
+      // ni_device_session_read(); the frames read after it in the batch
+      // were laid out for the old resolution and are dropped
+      for (i = 0; i < retval && !p_data[i].data.frame.end_of_stream; i++)
+      {
+        int rx_size;
+
+        if (!ni_decoder_resolution_changed(p_ctx, &(p_data[i].data.frame)))
         {
-            ni_log2(p_ctx, NI_LOG_DEBUG,
-                   "%s (decoder): seq change NO data, next time.\n", __func__);
-            p_ctx->active_video_width = 0;
-            p_ctx->active_video_height = 0;
-            p_ctx->actual_video_width = 0;
-            break;
+          continue;
         }
-        else if (retval < 0)
+        if (retval > i + 1)
         {
-            ni_log2(p_ctx, NI_LOG_ERROR,  "%s (decoder): failure ret %d, return ..\n",
-                   __func__, retval);
-            break;
+          ni_log2(p_ctx, NI_LOG_DEBUG,
+                  "%s(): drop %d frames after resolution change\n", __func__,
+                  retval - i - 1);
         }
-        // aligned_width may equal to active_video_width if bit depth and width
-        // are changed at the same time. So, check video_width != actual_video_width.
-        else if (p_ctx->frame_num && (p_ctx->pixel_format_changed ||
-                 (p_data->data.frame.video_width &&
-                  p_data->data.frame.video_height &&
-                  (aligned_width != p_ctx->active_video_width ||
-                   p_data->data.frame.video_height != p_ctx->active_video_height))))
+        while (retval > i + 1)
         {
-            ni_log2(
-                p_ctx, NI_LOG_DEBUG,
-                "%s (decoder): resolution change, frame size %ux%u -> %ux%u, "
-                "width %u bit %d, pix_fromat_changed %d, actual_video_width %d, continue read ...\n",
-                __func__, p_ctx->active_video_width, p_ctx->active_video_height,
-                aligned_width, p_data->data.frame.video_height,
-                p_data->data.frame.video_width, p_ctx->bit_depth_factor,
-                p_ctx->pixel_format_changed, p_ctx->actual_video_width);
-            // reset active video resolution to 0 so it can be queried in the re-read
-            p_ctx->active_video_width = 0;
-            p_ctx->active_video_height = 0;
-            p_ctx->actual_video_width = 0;
-            seq_change_read_count++;
+          retval--;
+          ni_decoder_frame_buffer_free(&(p_data[retval].data.frame));
         }
-        else
+        rx_size = ni_decoder_read_frame(p_ctx, &(p_data[i].data.frame), 1);
+        if (rx_size <= 0 && i == 0)
         {
-          break;
+          retval = rx_size;
+        } else if (rx_size <= 0)
+        {
+          ni_decoder_frame_buffer_free(&(p_data[i].data.frame));
+          retval = i;
         }
+        break;
       }
       break;
     }
     case NI_DEVICE_TYPE_ENCODER:
     {
-      retval = ni_encoder_session_read(p_ctx, &(p_data->data.packet));
+      retval = ni_encoder_session_read_batch(p_ctx, p_data, nb_data);
       break;
     }
-    case NI_DEVICE_TYPE_AI:
-    {
-        retval = ni_ai_session_read(p_ctx, &(p_data->data.packet));
-        break;
-    }
     default:
     {
       retval = NI_RETCODE_INVALID_PARAM;
-      ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() Unrecognized device type: %d",
+      ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() Unsupported device type: %d",
              __func__, device_type);
       break;
     }
@@ -2289,6 +2681,7 @@ ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
                                    int hw_frame_count, int is_planar)
 {
   void* p_buffer = NULL;
+  size_t alloc_size;
   int metadata_size = 0;
   int retval = NI_RETCODE_SUCCESS;
   int width_aligned = video_width;
@@ -2381,8 +2774,8 @@ ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
   buffer_size = ((buffer_size + (NI_MEM_PAGE_ALIGNMENT - 1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT + NI_MEM_PAGE_ALIGNMENT * 3;
   //ni_log(NI_LOG_DEBUG, "%s: luma_size %d chroma_b_size %d chroma_r_size %d metadata_size %d buffer_size %d\n", __func__, luma_size, chroma_b_size, chroma_r_size, metadata_size, buffer_size);
 
-  //Check if need to free
-  if ((p_frame->buffer_size != buffer_size) && (p_frame->buffer_size > 0))
+  //Check if need to free, a larger buffer is kept
+  if ((p_frame->buffer_size < buffer_size) && (p_frame->buffer_size > 0))
   {
       ni_log(NI_LOG_DEBUG,
              "%s: free current p_frame, p_frame->buffer_size=%u\n", __func__,
@@ -2391,9 +2784,11 @@ ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
   }
 
   //Check if need to realocate
-  if (p_frame->buffer_size != buffer_size)
+  if (p_frame->buffer_size < buffer_size)
   {
-      if (ni_posix_memalign(&p_buffer, sysconf(_SC_PAGESIZE), buffer_size))
+      alloc_size = buffer_size;
+      p_buffer = ni_mem_cache_get(&alloc_size);
+      if (!p_buffer)
       {
           ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate p_frame buffer.\n",
                  NI_ERRNO, __func__);
@@ -2403,7 +2798,7 @@ ni_retcode_t ni_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
 
     // init once after allocation
     //memset(p_buffer, 0, buffer_size);
-    p_frame->buffer_size = buffer_size;
+    p_frame->buffer_size = (uint32_t)alloc_size;
     p_frame->p_buffer = p_buffer;
 
     ni_log(NI_LOG_DEBUG, "%s: Allocate new p_frame buffer\n", __func__);
@@ -2675,7 +3070,7 @@ ni_retcode_t ni_frame_buffer_alloc_dl(ni_frame_t *p_frame, int video_width,
     if (p_frame->buffer_size != buffer_size)
     {
         ni_log(NI_LOG_DEBUG, "%s: Allocate new p_frame buffer\n", __func__);
-        if (ni_posix_memalign(&p_buffer, sysconf(_SC_PAGESIZE), buffer_size))
+        if (ni_frame_memalign(&p_buffer, buffer_size))
         {
             ni_log(NI_LOG_ERROR,
                    "ERROR %d: %s() Cannot allocate p_frame buffer.\n", NI_ERRNO,
@@ -2915,8 +3310,7 @@ ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
 
     // check fw revision (if fw_rev has been populated in open session)
     if (p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX] &&
-        (ni_cmp_fw_api_ver((char*) &p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                           "6Q") < 0))
+        (!ni_fw_api_supports(p_enc_ctx, NI_FW_API_ENC_ZEROCOPY)))
     {
         ni_log2(p_enc_ctx, NI_LOG_DEBUG,  "%s: not supported on device with FW API version < 6.Q\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -2950,8 +3344,7 @@ ni_retcode_t ni_encoder_frame_zerocopy_check(ni_session_context_t *p_enc_ctx,
     // check fw revision (if fw_rev has been populated in open session)
     if (issemiplanar &&
         p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX] &&
-        (ni_cmp_fw_api_ver((char*) &p_enc_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                           "6q") < 0))
+        (!ni_fw_api_supports(p_enc_ctx, NI_FW_API_SEMIPLANAR_ZEROCOPY)))
     {
         ni_log2(p_enc_ctx, NI_LOG_DEBUG,  "%s: semi-planar not supported on device with FW API version < 6.q\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -3209,8 +3602,7 @@ ni_retcode_t ni_uploader_frame_zerocopy_check(ni_session_context_t *p_upl_ctx,
 
     // check fw revision (if fw_rev has been populated in open session)
     if (p_upl_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX] &&
-        (ni_cmp_fw_api_ver((char*) &p_upl_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                           "6S") < 0))
+        (!ni_fw_api_supports(p_upl_ctx, NI_FW_API_UPLOADER_ZEROCOPY)))
     {
         ni_log2(p_upl_ctx, NI_LOG_DEBUG,  "%s: not supported on device with FW API version < 6.S\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -3265,8 +3657,7 @@ ni_retcode_t ni_uploader_frame_zerocopy_check(ni_session_context_t *p_upl_ctx,
     // check fw revision (if fw_rev has been populated in open session)
     if (issemiplanar &&
         p_upl_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX] &&
-        (ni_cmp_fw_api_ver((char*) &p_upl_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                           "6q") < 0))
+        (!ni_fw_api_supports(p_upl_ctx, NI_FW_API_SEMIPLANAR_ZEROCOPY)))
     {
         ni_log2(p_upl_ctx, NI_LOG_DEBUG,  "%s: semi-planar not supported on device with FW API version < 6.q\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -3388,8 +3779,8 @@ ni_retcode_t ni_encoder_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
 
       buffer_size = ((buffer_size + (NI_MEM_PAGE_ALIGNMENT - 1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT + NI_MEM_PAGE_ALIGNMENT;
 
-      //Check if Need to free
-      if ((p_frame->buffer_size != buffer_size) && (p_frame->buffer_size > 0))
+      //Check if Need to free, a larger buffer is kept
+      if ((p_frame->buffer_size < buffer_size) && (p_frame->buffer_size > 0))
       {
           ni_log(NI_LOG_DEBUG,
                  "%s: free current p_frame, "
@@ -3399,9 +3790,12 @@ ni_retcode_t ni_encoder_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
       }
 
       //Check if need to realocate
-      if (p_frame->buffer_size != buffer_size)
+      if (p_frame->buffer_size < buffer_size)
       {
-          if (ni_posix_memalign(&p_buffer, sysconf(_SC_PAGESIZE), buffer_size))
+          size_t alloc_size = buffer_size;
+
+          p_buffer = ni_mem_cache_get(&alloc_size);
+          if (!p_buffer)
           {
               ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate p_frame buffer.\n",
                      NI_ERRNO, __func__);
@@ -3410,8 +3804,8 @@ ni_retcode_t ni_encoder_frame_buffer_alloc(ni_frame_t *p_frame, int video_width,
           }
 
           // init once after allocation
-          memset(p_buffer, 0, buffer_size);
-          p_frame->buffer_size = buffer_size;
+          memset(p_buffer, 0, alloc_size);
+          p_frame->buffer_size = (uint32_t)alloc_size;
           p_frame->p_buffer = p_buffer;
 
           ni_log(NI_LOG_DEBUG, "%s: allocated new p_frame buffer\n", __func__);
@@ -3613,7 +4007,7 @@ ni_retcode_t ni_frame_buffer_alloc_nv(ni_frame_t *p_frame, int video_width,
       //Check if need to realocate
       if (p_frame->buffer_size != buffer_size)
       {
-          if (ni_posix_memalign(&p_buffer, sysconf(_SC_PAGESIZE), buffer_size))
+          if (ni_frame_memalign(&p_buffer, buffer_size))
           {
               ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate p_frame buffer.\n",
                      NI_ERRNO, __func__);
@@ -3760,8 +4154,9 @@ ni_retcode_t ni_frame_buffer_free(ni_frame_t* p_frame)
 
   if (p_frame->buffer_size)
   {
+      ni_mem_cache_put(p_frame->p_buffer, p_frame->buffer_size);
+      p_frame->p_buffer = NULL;
       p_frame->buffer_size = 0;
-      ni_aligned_free(p_frame->p_buffer);
   }
 
   for (i = 0; i < NI_MAX_NUM_DATA_POINTERS; i++)
@@ -3877,6 +4272,7 @@ void ni_decoder_frame_buffer_pool_return_buf(ni_buf_t *buf,
 ni_retcode_t ni_packet_buffer_alloc(ni_packet_t* p_packet, int packet_size)
 {
   void* p_buffer = NULL;
+  size_t alloc_size;
   int metadata_size = 0;
 
   metadata_size = NI_FW_META_DATA_SZ;
@@ -3898,9 +4294,11 @@ ni_retcode_t ni_packet_buffer_alloc(ni_packet_t* p_packet, int packet_size)
     buffer_size = ( (buffer_size / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT ) + NI_MEM_PAGE_ALIGNMENT;
   }
 
-  if (p_packet->buffer_size == buffer_size)
+  if (p_packet->p_buffer && !p_packet->p_arena &&
+      p_packet->buffer_size >= buffer_size)
   {
-      // Already allocated the exact size.
+      // Already allocated, large enough. Arena slots may be shared and are
+      // never written again.
       p_packet->p_data = p_packet->p_buffer;
       ni_log(NI_LOG_DEBUG, "%s: reuse current p_packet buffer\n", __func__);
       ni_log(NI_LOG_TRACE, "%s: exit: p_packet->buffer_size=%u\n", __func__,
@@ -3919,7 +4317,9 @@ ni_retcode_t ni_packet_buffer_alloc(ni_packet_t* p_packet, int packet_size)
   ni_log(NI_LOG_DEBUG, "%s: Allocating p_frame buffer, buffer_size=%d\n",
          __func__, buffer_size);
 
-  if (ni_posix_memalign(&p_buffer, sysconf(_SC_PAGESIZE), buffer_size))
+  alloc_size = buffer_size;
+  p_buffer = ni_mem_cache_get(&alloc_size);
+  if (!p_buffer)
   {
       ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate p_packet buffer.\n",
              NI_ERRNO, __func__);
@@ -3928,7 +4328,7 @@ ni_retcode_t ni_packet_buffer_alloc(ni_packet_t* p_packet, int packet_size)
       return NI_RETCODE_ERROR_MEM_ALOC;
   }
 
-  p_packet->buffer_size = buffer_size;
+  p_packet->buffer_size = (uint32_t)alloc_size;
   p_packet->p_buffer = p_buffer;
   p_packet->p_data = p_packet->p_buffer;
 
@@ -4023,7 +4423,14 @@ ni_retcode_t ni_packet_buffer_free(ni_packet_t* p_packet)
       LRETURN;
   }
 
-  ni_aligned_free(p_packet->p_buffer);
+  if (p_packet->p_arena)
+  {
+      ni_packet_arena_slot_unref(p_packet->p_arena, p_packet->arena_slot);
+      p_packet->p_arena = NULL;
+  } else
+  {
+      ni_mem_cache_put(p_packet->p_buffer, p_packet->buffer_size);
+  }
   p_packet->p_buffer = NULL;
   p_packet->buffer_size = 0;
   p_packet->data_len = 0;
@@ -4158,21 +4565,241 @@ int ni_packet_copy(void* p_destination, const void* const p_source, int cur_size
 }
 
 /*!*****************************************************************************
- *  \brief  Add a new auxiliary data to a frame
+ *  \brief  Allocate a packet arena
  *
- *  \param[in/out] frame  a frame to which the auxiliary data should be added
- *  \param[in]     type   type of the added auxiliary data
- *  \param[in]     data_size size of the added auxiliary data
+ *  \param[in] slot_size  size of each packet buffer, rounded up to
+ *                        NI_MEM_PAGE_ALIGNMENT
+ *  \param[in] nb_slots   number of packet buffers
  *
- *  \return a pointer to the newly added aux data on success, NULL otherwise
+ *  \return pointer to the arena on success, NULL otherwise
  ******************************************************************************/
-ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame, ni_aux_data_type_t type,
-                                     int data_size)
+ni_packet_arena_t *ni_packet_arena_alloc(int slot_size, int nb_slots)
 {
-    ni_aux_data_t *ret;
+    ni_packet_arena_t *p_arena = NULL;
+    void *p_base = NULL;
+    int i;
 
-    if (frame->nb_aux_data >= NI_MAX_NUM_AUX_DATA_PER_FRAME ||
-        !(ret = malloc(sizeof(ni_aux_data_t))))
+    if (slot_size <= 0 || nb_slots <= 0 ||
+        slot_size > INT32_MAX - NI_MEM_PAGE_ALIGNMENT)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid slot_size %d nb_slots %d\n",
+               __func__, slot_size, nb_slots);
+        return NULL;
+    }
+    slot_size = ((slot_size + NI_MEM_PAGE_ALIGNMENT - 1) /
+                 NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+    p_arena = (ni_packet_arena_t *)calloc(1, sizeof(ni_packet_arena_t));
+    if (!p_arena)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() alloc arena failed\n", NI_ERRNO,
+               __func__);
+        return NULL;
+    }
+    p_arena->p_refs = (int *)calloc(nb_slots, sizeof(int));
+    p_arena->p_free = (int *)malloc(sizeof(int) * nb_slots);
+    if (!p_arena->p_refs || !p_arena->p_free ||
+        ni_posix_memalign(&p_base, sysconf(_SC_PAGESIZE),
+                          (size_t)slot_size * nb_slots))
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() alloc %d x %d bytes failed\n",
+               NI_ERRNO, __func__, nb_slots, slot_size);
+        ni_memfree(p_arena->p_refs);
+        ni_memfree(p_arena->p_free);
+        ni_memfree(p_arena);
+        return NULL;
+    }
+
+    p_arena->p_base = (uint8_t *)p_base;
+    p_arena->slot_size = slot_size;
+    p_arena->nb_slots = nb_slots;
+    // hand out the lowest slots first
+    for (i = 0; i < nb_slots; i++)
+    {
+        p_arena->p_free[i] = nb_slots - 1 - i;
+    }
+    p_arena->nb_free = nb_slots;
+    ni_pthread_mutex_init(&p_arena->mutex);
+
+    ni_log(NI_LOG_DEBUG, "%s(): %d slots of %d bytes\n", __func__, nb_slots,
+           slot_size);
+    return p_arena;
+}
+
+static void ni_packet_arena_destroy(ni_packet_arena_t *p_arena)
+{
+    ni_pthread_mutex_destroy(&p_arena->mutex);
+    ni_aligned_free(p_arena->p_base);
+    ni_memfree(p_arena->p_refs);
+    ni_memfree(p_arena->p_free);
+    ni_memfree(p_arena);
+}
+
+/*!*****************************************************************************
+ *  \brief  Take another reference to an arena slot
+ ******************************************************************************/
+void ni_packet_arena_slot_ref(ni_packet_arena_t *p_arena, int slot)
+{
+    ni_pthread_mutex_lock(&p_arena->mutex);
+    p_arena->p_refs[slot]++;
+    ni_pthread_mutex_unlock(&p_arena->mutex);
+}
+
+/*!*****************************************************************************
+ *  \brief  Drop a reference to an arena slot, the slot is recycled when its
+ *          last reference is dropped and the arena is released after its last
+ *          slot if ni_packet_arena_free() was already called
+ ******************************************************************************/
+void ni_packet_arena_slot_unref(ni_packet_arena_t *p_arena, int slot)
+{
+    int destroy = 0;
+
+    ni_pthread_mutex_lock(&p_arena->mutex);
+    if (--p_arena->p_refs[slot] == 0)
+    {
+        p_arena->p_free[p_arena->nb_free++] = slot;
+        destroy = p_arena->closing && p_arena->nb_free == p_arena->nb_slots;
+    }
+    ni_pthread_mutex_unlock(&p_arena->mutex);
+
+    if (destroy)
+    {
+        ni_packet_arena_destroy(p_arena);
+    }
+}
+
+/*!*****************************************************************************
+ *  \brief  Attach a free arena slot to p_packet, releasing the buffer it held
+ *          before. The caller then writes the packet, leftover bytes first,
+ *          at p_packet->p_data and sets p_packet->data_len. The bytes past
+ *          data_len up to the next page boundary are zeroed when the packet
+ *          is sent.
+ *
+ *  \param[in] p_arena      arena to take the slot from
+ *  \param[in] p_packet     packet to attach the slot to
+ *  \param[in] packet_size  bytes the caller will write
+ *
+ *  \return On success
+ *                          NI_RETCODE_SUCCESS
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_MEM_ALOC if packet_size does not
+ *                          fit a slot or no slot is free; the caller can fall
+ *                          back to ni_packet_buffer_alloc()
+ ******************************************************************************/
+ni_retcode_t ni_packet_arena_get_buffer(ni_packet_arena_t *p_arena,
+                                        ni_packet_t *p_packet,
+                                        int packet_size)
+{
+    int slot = -1;
+
+    if (!p_arena || !p_packet || packet_size <= 0)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s(): invalid parameters\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    if (packet_size > p_arena->slot_size)
+    {
+        ni_log(NI_LOG_DEBUG, "%s(): packet_size %d > slot_size %d\n", __func__,
+               packet_size, p_arena->slot_size);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    ni_pthread_mutex_lock(&p_arena->mutex);
+    if (!p_arena->closing && p_arena->nb_free)
+    {
+        slot = p_arena->p_free[--p_arena->nb_free];
+        p_arena->p_refs[slot] = 1;
+    }
+    ni_pthread_mutex_unlock(&p_arena->mutex);
+
+    if (slot < 0)
+    {
+        ni_log(NI_LOG_DEBUG, "%s(): no free slot\n", __func__);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    ni_packet_buffer_free(p_packet);
+    p_packet->p_arena = p_arena;
+    p_packet->arena_slot = slot;
+    p_packet->p_buffer = p_arena->p_base + (size_t)slot * p_arena->slot_size;
+    p_packet->buffer_size = p_arena->slot_size;
+    p_packet->p_data = p_packet->p_buffer;
+    p_packet->data_len = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+/*!*****************************************************************************
+ *  \brief  Make p_dst another reference to the arena slot of p_src, releasing
+ *          the buffer p_dst held before. Both packets must be freed with
+ *          ni_packet_buffer_free().
+ *
+ *  \return On success    NI_RETCODE_SUCCESS
+ *          On failure    NI_RETCODE_INVALID_PARAM
+ ******************************************************************************/
+ni_retcode_t ni_packet_arena_ref(const ni_packet_t *p_src, ni_packet_t *p_dst)
+{
+    if (!p_src || !p_dst || !p_src->p_arena || p_src == p_dst)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s(): invalid parameters\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    ni_packet_arena_slot_ref(p_src->p_arena, p_src->arena_slot);
+    ni_packet_buffer_free(p_dst);
+    p_dst->p_arena = p_src->p_arena;
+    p_dst->arena_slot = p_src->arena_slot;
+    p_dst->p_buffer = p_src->p_buffer;
+    p_dst->buffer_size = p_src->buffer_size;
+    p_dst->p_data = p_src->p_data;
+    p_dst->data_len = p_src->data_len;
+    return NI_RETCODE_SUCCESS;
+}
+
+/*!*****************************************************************************
+ *  \brief  Free a packet arena. Slots still referenced by packets stay valid
+ *          and the memory is released when the last of them is freed.
+ *
+ *  \param[in] p_arena  arena to free
+ *
+ *  \return None
+ ******************************************************************************/
+void ni_packet_arena_free(ni_packet_arena_t *p_arena)
+{
+    int destroy;
+
+    if (!p_arena)
+    {
+        return;
+    }
+
+    ni_pthread_mutex_lock(&p_arena->mutex);
+    p_arena->closing = 1;
+    destroy = (p_arena->nb_free == p_arena->nb_slots);
+    ni_pthread_mutex_unlock(&p_arena->mutex);
+
+    if (destroy)
+    {
+        ni_packet_arena_destroy(p_arena);
+    }
+}
+
+/*!*****************************************************************************
+ *  \brief  Add a new auxiliary data to a frame
+ *
+ *  \param[in/out] frame  a frame to which the auxiliary data should be added
+ *  \param[in]     type   type of the added auxiliary data
+ *  \param[in]     data_size size of the added auxiliary data
+ *
+ *  \return a pointer to the newly added aux data on success, NULL otherwise
+ ******************************************************************************/
+ni_aux_data_t *ni_frame_new_aux_data(ni_frame_t *frame, ni_aux_data_type_t type,
+                                     int data_size)
+{
+    ni_aux_data_t *ret;
+
+    if (frame->nb_aux_data >= NI_MAX_NUM_AUX_DATA_PER_FRAME ||
+        !(ret = malloc(sizeof(ni_aux_data_t))))
     {
         ni_log(NI_LOG_ERROR,
                "ERROR: %s No memory or exceeding max aux_data number !\n",
@@ -8571,7 +9198,7 @@ int ni_device_session_hwdl(ni_session_context_t* p_ctx, ni_session_data_io_t *p_
   }
 
   /* download by frameidx */
-  if ((ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rd") >= 0))
+  if ((ni_fw_api_supports(p_ctx, NI_FW_API_HWDL_BY_FRAME_IDX)))
   {
     if(hwdesc->ui16FrameIdx == 0)
     {
@@ -8600,9 +9227,7 @@ int ni_device_session_hwdl(ni_session_context_t* p_ctx, ni_session_data_io_t *p_
 
     ni_pthread_mutex_t *p_ctx_mutex = &(p_ctx->mutex);
     if ((p_ctx_mutex != p_ctx->pext_mutex) ||
-        ni_cmp_fw_api_ver(
-            (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6r8") < 0)
+        !ni_fw_api_supports(p_ctx, NI_FW_API_HWDL_SESSION_MUTEX))
     {
         use_external_mutex = true;
         p_ctx->session_id = hwdesc->ui16session_ID;
@@ -8657,9 +9282,7 @@ ni_retcode_t ni_device_session_query_buffer_avail(ni_session_context_t *p_ctx,
       return NI_RETCODE_INVALID_PARAM;
   }
 
-  if (ni_cmp_fw_api_ver(
-      (char *) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-      "6rt") < 0)
+  if (!ni_fw_api_supports(p_ctx, NI_FW_API_QUERY_BUFFER_AVAIL))
   {
       ni_log2(p_ctx, NI_LOG_DEBUG,
               "%s function not supported in FW API version < 6rt\n",
@@ -8972,9 +9595,7 @@ ni_retcode_t ni_device_session_update_framepool(ni_session_context_t *p_ctx,
              __func__);
       return NI_RETCODE_INVALID_PARAM;
   }
-  if (ni_cmp_fw_api_ver(
-          (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-          "6r3") < 0)
+  if (!ni_fw_api_supports(p_ctx, NI_FW_API_LOW_DELAY_FRAMEPOOL))
   {
     ni_log2(p_ctx, NI_LOG_ERROR,
            "ERROR: %s function not supported in FW API version < 6r3\n",
@@ -9359,9 +9980,7 @@ ni_retcode_t ni_device_clone_hwframe(ni_session_context_t *p_ctx,
         return NI_RETCODE_INVALID_PARAM;
     }
 
-    if (ni_cmp_fw_api_ver(
-          (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-          "6rL") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_CLONE_HWFRAME))
     {
         ni_log2(p_ctx, NI_LOG_ERROR,
                 "Error: %s function not supported on device with FW API version < 6rL\n",
@@ -9484,6 +10103,166 @@ ni_retcode_t ni_device_multi_config_frame(ni_session_context_t *p_ctx,
     return retval;
 }
 
+/*!*****************************************************************************
+ *  \brief  Allocate a batch of up to max_jobs scaler jobs
+ *
+ *  \param[in]  max_jobs     number of jobs the batch can hold
+ *
+ *  \return         pointer to the batch, NULL on failure
+ ******************************************************************************/
+ni_scaler_batch_t *ni_scaler_batch_alloc(int max_jobs)
+{
+    ni_scaler_batch_t *p_batch;
+
+    if (max_jobs <= 0)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid max_jobs %d\n", __func__,
+               max_jobs);
+        return NULL;
+    }
+
+    p_batch = (ni_scaler_batch_t *)calloc(1, sizeof(ni_scaler_batch_t));
+    if (!p_batch)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate batch\n",
+               NI_ERRNO, __func__);
+        return NULL;
+    }
+    p_batch->p_jobs = (ni_scaler_batch_job_t *)calloc(
+        max_jobs, sizeof(ni_scaler_batch_job_t));
+    if (!p_batch->p_jobs)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate %d jobs\n",
+               NI_ERRNO, __func__, max_jobs);
+        free(p_batch);
+        return NULL;
+    }
+    p_batch->max_jobs = max_jobs;
+    return p_batch;
+}
+
+/*!*****************************************************************************
+ *  \brief  Queue a scaler job, configured as by ni_device_multi_config_frame()
+ *          with the same parameters
+ *
+ *  \param[in]  p_ctx        pointer to the scaler session context the batch
+ *                           will be submitted to
+ *  \param[in]  p_batch      batch to add the job to
+ *  \param[in]  p_cfg_in     input frame config array
+ *  \param[in]  numInCfgs    number of frame config entries in the p_cfg_in array
+ *  \param[in]  p_cfg_out    output frame config, or NULL
+ *
+ *  \return         NI_RETCODE_SUCCESS
+ *                  NI_RETCODE_INVALID_PARAM if the batch is full
+ *                  NI_RETCODE_NVME_SC_INVALID_PARAMETER
+ *                  NI_RETCODE_ERROR_MEM_ALOC
+ ******************************************************************************/
+ni_retcode_t ni_scaler_batch_add(ni_session_context_t *p_ctx,
+                                 ni_scaler_batch_t *p_batch,
+                                 ni_frame_config_t p_cfg_in[],
+                                 int numInCfgs,
+                                 ni_frame_config_t *p_cfg_out)
+{
+    ni_retcode_t retval;
+
+    if (!p_ctx || !p_batch || (!p_cfg_in && numInCfgs) || numInCfgs < 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() passed parameters are null, return\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_batch->nb_jobs >= p_batch->max_jobs)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() batch full, %d jobs\n",
+               __func__, p_batch->nb_jobs);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    retval = ni_scaler_batch_job_set(p_ctx, &p_batch->p_jobs[p_batch->nb_jobs],
+                                     p_cfg_in, numInCfgs, p_cfg_out);
+    if (NI_RETCODE_SUCCESS == retval)
+    {
+        p_batch->nb_jobs++;
+    }
+    return retval;
+}
+
+/*!*****************************************************************************
+ *  \brief  Run all jobs queued in a scaler batch and empty it
+ *
+ *  \param[in]  p_ctx          pointer to scaler session context
+ *  \param[in]  p_batch        batch of jobs
+ *  \param[out] p_out_surface  array of hw descriptors, one per job queued,
+ *                             receiving the output frame of each job. May be
+ *                             NULL.
+ *
+ *  \return On success
+ *                          Number of jobs done
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_FAILURE
+ ******************************************************************************/
+int ni_device_scaler_batch_submit(ni_session_context_t *p_ctx,
+                                  ni_scaler_batch_t *p_batch,
+                                  niFrameSurface1_t p_out_surface[])
+{
+    int retval;
+
+    if (!p_ctx || !p_batch)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() passed parameters are null, return\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_ctx->device_type != NI_DEVICE_TYPE_SCALER)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,  "Bad device type %d\n", p_ctx->device_type);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (!p_batch->nb_jobs)
+    {
+        return 0;
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    p_ctx->xcoder_state |= NI_XCODER_GENERAL_STATE;
+
+    retval = ni_scaler_batch_config_frames(p_ctx, p_batch, p_out_surface);
+
+    p_ctx->xcoder_state &= ~NI_XCODER_GENERAL_STATE;
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+
+    p_batch->nb_jobs = 0;
+    return retval;
+}
+
+/*!*****************************************************************************
+ *  \brief  Free a scaler batch and its job descriptors
+ *
+ *  \param[in]  p_batch      batch to free, may be NULL
+ ******************************************************************************/
+void ni_scaler_batch_free(ni_scaler_batch_t *p_batch)
+{
+    int i;
+
+    if (!p_batch)
+    {
+        return;
+    }
+
+    for (i = 0; i < p_batch->max_jobs; i++)
+    {
+        ni_aligned_free(p_batch->p_jobs[i].p_desc);
+    }
+    free(p_batch->p_jobs);
+    free(p_batch);
+}
+
 /*!*****************************************************************************
  *  \brief   Calculate the total size of a frame based on the upload
  *           context attributes and includes rounding up to the page size
@@ -9912,69 +10691,262 @@ END:
     return retval;
 }
 
-ni_retcode_t ni_ai_config_network_binary(ni_session_context_t *p_ctx,
-                                         ni_network_data_t *p_network,
-                                         const char *file)
+/*
+ * Process wide registry of network binaries. A binary opened by several AI
+ * sessions is hashed once: its SHA-256 is cached under the identity of the
+ * opened file (path, device, inode, size, mtime) for the life of the
+ * process, and the page aligned copy uploaded to the device is shared by all
+ * sessions configuring it concurrently.
+ *
+ * The binary is copied rather than mapped so that a file truncated or
+ * rewritten while in use cannot fault the upload. The hash is only as fresh
+ * as that identity though: a binary rewritten in place with the same size
+ * within the mtime granularity of the file system, or with its mtime reset,
+ * is uploaded with the hash of its previous content. Replace binaries by
+ * renaming a new file over the old one.
+ */
+typedef struct _ni_ai_nb_cache_entry
+{
+    struct _ni_ai_nb_cache_entry *next;
+    char *path;
+    uint64_t dev;
+    uint64_t ino;
+    uint64_t size;
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    uint8_t sha256[32];
+    void *data;         // page aligned upload buffer, NULL while unused
+    int ref_cnt;
+} ni_ai_nb_cache_entry_t;
+
+static ni_ai_nb_cache_entry_t *g_nb_cache = NULL;
+#ifdef _WIN32
+static ni_pthread_mutex_t g_nb_cache_mutex;
+static INIT_ONCE g_nb_cache_init_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK ni_ai_nb_cache_init_once_callback(PINIT_ONCE InitOnce,
+                                                       PVOID Parameter,
+                                                       PVOID *Context)
 {
-    FILE *fp = NULL;
+    ni_pthread_mutex_init(&g_nb_cache_mutex);
+    return true;
+}
+#else
+static ni_pthread_mutex_t g_nb_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void ni_ai_nb_cache_lock(void)
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(&g_nb_cache_init_once,
+                        ni_ai_nb_cache_init_once_callback, NULL, NULL);
+#endif
+    ni_pthread_mutex_lock(&g_nb_cache_mutex);
+}
+
+static ni_retcode_t ni_ai_nb_cache_load_data(ni_ai_nb_cache_entry_t *entry,
+                                             FILE *fp)
+{
+    size_t aligned_size = (entry->size + (NI_MEM_PAGE_ALIGNMENT - 1)) &
+        ~((size_t)NI_MEM_PAGE_ALIGNMENT - 1);
+
+    if (ni_posix_memalign(&entry->data, sysconf(_SC_PAGESIZE), aligned_size))
+    {
+        ni_log(NI_LOG_ERROR, "%s: failed to alloate memory\n", __func__);
+        entry->data = NULL;
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    memset((uint8_t *)entry->data + entry->size, 0,
+           aligned_size - entry->size);
+
+    // a file truncated since fstat() comes up short here
+    if (fread(entry->data, entry->size, 1, fp) != 1)
+    {
+        ni_log(NI_LOG_ERROR, "%s: failed to read network binary\n", __func__);
+        ni_aligned_free(entry->data);
+        return NI_RETCODE_FAILURE;
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+/*!*****************************************************************************
+ *  \brief  Get a referenced registry entry with the upload buffer and hash
+ *          of a network binary file. Release with ni_ai_nb_cache_put().
+ ******************************************************************************/
+static ni_retcode_t ni_ai_nb_cache_get(const char *file,
+                                       ni_ai_nb_cache_entry_t **pp_entry)
+{
+    ni_ai_nb_cache_entry_t **pp;
+    ni_ai_nb_cache_entry_t *entry = NULL;
     struct stat file_stat;
+    FILE *fp = NULL;
+    int64_t mtime_nsec = 0;
+    char errmsg[NI_ERRNO_LEN] = {0};
     ni_retcode_t retval = NI_RETCODE_SUCCESS;
-    unsigned char *buffer = NULL;
+    int hashed = 1;
 
-    if (!p_ctx)
+    // the identity is taken from the opened file so that it describes the
+    // content read below, not whatever the path named a moment earlier
+    ni_fopen(&fp, file, "rb");
+    if (!fp)
     {
-        ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() passed parameters are null, return\n",
-               __func__);
-        return NI_RETCODE_INVALID_PARAM;
+        ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
+        ni_log(NI_LOG_ERROR, "%s: failed to open network binary, %s\n",
+               __func__, errmsg);
+        return NI_RETCODE_FAILURE;
     }
-    ni_pthread_mutex_lock(&p_ctx->mutex);
-    p_ctx->xcoder_state |= NI_XCODER_GENERAL_STATE;
-    ni_pthread_mutex_unlock(&p_ctx->mutex);
 
-    char errmsg[NI_ERRNO_LEN] = {0};
-    if (stat(file, &file_stat) != 0)
+    if (fstat(fileno(fp), &file_stat) != 0)
     {
         ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
-        ni_log2(p_ctx, NI_LOG_ERROR,  "%s: failed to get network binary file stat, %s\n",
+        ni_log(NI_LOG_ERROR, "%s: failed to get network binary file stat, %s\n",
                __func__, errmsg);
-        retval = NI_RETCODE_FAILURE;
-        LRETURN;
+        fclose(fp);
+        return NI_RETCODE_FAILURE;
     }
 
-    if (file_stat.st_size == 0)
+    if (file_stat.st_size == 0 || (uint64_t)file_stat.st_size > UINT32_MAX)
     {
-        ni_log2(p_ctx, NI_LOG_ERROR,  "%s: network binary size is null\n", __func__);
-        retval = NI_RETCODE_FAILURE;
-        LRETURN;
+        ni_log(NI_LOG_ERROR, "%s: network binary size %" PRIu64 " invalid\n",
+               __func__, (uint64_t)file_stat.st_size);
+        fclose(fp);
+        return NI_RETCODE_FAILURE;
     }
+#if __linux__
+    mtime_nsec = file_stat.st_mtim.tv_nsec;
+#elif __APPLE__
+    mtime_nsec = file_stat.st_mtimespec.tv_nsec;
+#endif
 
-    ni_fopen(&fp, file, "rb");
-    if (!fp)
+    ni_ai_nb_cache_lock();
+
+    for (pp = &g_nb_cache; *pp;)
     {
-        ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
-        ni_log2(p_ctx, NI_LOG_ERROR,  "%s: failed to open network binary, %s\n", __func__,
-                       errmsg);
-        retval = NI_RETCODE_FAILURE;
-        LRETURN;
+        ni_ai_nb_cache_entry_t *cur = *pp;
+
+        if (strcmp(cur->path, file) == 0)
+        {
+            if (cur->dev == (uint64_t)file_stat.st_dev &&
+                cur->ino == (uint64_t)file_stat.st_ino &&
+                cur->size == (uint64_t)file_stat.st_size &&
+                cur->mtime_sec == (int64_t)file_stat.st_mtime &&
+                cur->mtime_nsec == mtime_nsec)
+            {
+                entry = cur;
+                break;
+            }
+            if (cur->ref_cnt == 0)
+            {
+                // the file changed, forget the stale hash
+                *pp = cur->next;
+                free(cur->path);
+                free(cur);
+                continue;
+            }
+        }
+        pp = &cur->next;
     }
 
-    buffer = malloc(file_stat.st_size);
-    if (!buffer)
+    if (!entry)
     {
-        ni_log2(p_ctx, NI_LOG_ERROR,  "%s: failed to alloate memory\n", __func__);
-        retval = NI_RETCODE_ERROR_MEM_ALOC;
-        LRETURN;
+        entry = (ni_ai_nb_cache_entry_t *)calloc(1, sizeof(*entry));
+        if (!entry || !(entry->path = strdup(file)))
+        {
+            ni_log(NI_LOG_ERROR, "%s: failed to alloate memory\n", __func__);
+            free(entry);
+            entry = NULL;
+            retval = NI_RETCODE_ERROR_MEM_ALOC;
+            LRETURN;
+        }
+        entry->dev = (uint64_t)file_stat.st_dev;
+        entry->ino = (uint64_t)file_stat.st_ino;
+        entry->size = (uint64_t)file_stat.st_size;
+        entry->mtime_sec = (int64_t)file_stat.st_mtime;
+        entry->mtime_nsec = mtime_nsec;
+        entry->next = g_nb_cache;
+        g_nb_cache = entry;
+        hashed = 0;
     }
 
-    if (fread(buffer, file_stat.st_size, 1, fp) != 1)
+    if (!entry->data)
     {
-        ni_log2(p_ctx, NI_LOG_ERROR,  "%s: failed to read network binary\n", __func__);
-        retval = NI_RETCODE_FAILURE;
+        retval = ni_ai_nb_cache_load_data(entry, fp);
+        if (retval != NI_RETCODE_SUCCESS)
+        {
+            LRETURN;
+        }
+    }
+
+    if (!hashed)
+    {
+        uint64_t start = ni_gettime_ns();
+        ni_calculate_sha256(entry->data, entry->size, entry->sha256);
+        ni_log(NI_LOG_DEBUG, "%s: hashed %s (%" PRIu64 " bytes) in %" PRIu64
+               " us\n", __func__, file, entry->size,
+               (ni_gettime_ns() - start) / 1000);
+    }
+
+    entry->ref_cnt++;
+    *pp_entry = entry;
+
+END:
+    // an entry that failed to load keeps no hash so the next get retries
+    if (retval != NI_RETCODE_SUCCESS && entry && !hashed)
+    {
+        for (pp = &g_nb_cache; *pp; pp = &(*pp)->next)
+        {
+            if (*pp == entry)
+            {
+                *pp = entry->next;
+                break;
+            }
+        }
+        free(entry->path);
+        free(entry);
+    }
+    ni_pthread_mutex_unlock(&g_nb_cache_mutex);
+    fclose(fp);
+    return retval;
+}
+
+static void ni_ai_nb_cache_put(ni_ai_nb_cache_entry_t *entry)
+{
+    ni_ai_nb_cache_lock();
+    if (--entry->ref_cnt == 0)
+    {
+        // keep the hash, release the buffer until the binary is needed again
+        ni_aligned_free(entry->data);
+    }
+    ni_pthread_mutex_unlock(&g_nb_cache_mutex);
+}
+
+ni_retcode_t ni_ai_config_network_binary(ni_session_context_t *p_ctx,
+                                         ni_network_data_t *p_network,
+                                         const char *file)
+{
+    ni_retcode_t retval = NI_RETCODE_SUCCESS;
+    ni_ai_nb_cache_entry_t *entry = NULL;
+
+    if (!p_ctx || !file)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: %s() passed parameters are null, return\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    p_ctx->xcoder_state |= NI_XCODER_GENERAL_STATE;
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+
+    retval = ni_ai_nb_cache_get(file, &entry);
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "%s: failed to load network binary %s\n",
+               __func__, file);
         LRETURN;
     }
 
-    retval =
-        ni_config_instance_network_binary(p_ctx, buffer, file_stat.st_size);
+    retval = ni_config_instance_network_binary_hashed(
+        p_ctx, entry->data, (uint32_t)entry->size, entry->sha256);
     if (retval != NI_RETCODE_SUCCESS)
     {
         ni_log2(p_ctx, NI_LOG_ERROR,  "%s: failed to configure instance, retval %d\n",
@@ -9991,11 +10963,10 @@ ni_retcode_t ni_ai_config_network_binary(ni_session_context_t *p_ctx,
 
 END:
 
-    if (fp)
+    if (entry)
     {
-        fclose(fp);
+        ni_ai_nb_cache_put(entry);
     }
-    free(buffer);
 
     ni_pthread_mutex_lock(&p_ctx->mutex);
     p_ctx->xcoder_state &= ~NI_XCODER_GENERAL_STATE;
@@ -10016,7 +10987,7 @@ ni_retcode_t ni_ai_config_hvsplus(ni_session_context_t *p_ctx,
         return NI_RETCODE_INVALID_PARAM;
     }
 
-    if ((ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6ro") < 0))
+    if ((!ni_fw_api_supports(p_ctx, NI_FW_API_HVSPLUS)))
     {
         ni_log2(p_ctx, NI_LOG_ERROR,  "Error: hvsplus filter not supported on device with FW API version < 6ro\n");
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -11695,8 +12666,7 @@ ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_ctx,
     ni_xcoder_params_t *p_param = NULL;
 
     // requires API version >= 54
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "54") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_SEQ_CHANGE_RESTART))
     {
         ni_log2(p_ctx, NI_LOG_ERROR,  "Error: %s function not supported on device with FW API version < 5.4\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -11764,6 +12734,140 @@ ni_retcode_t ni_ai_session_read_metrics(ni_session_context_t *p_ctx,
     return ni_ai_session_query_metrics(p_ctx, p_metrics);
 }
 
+static ni_retcode_t ni_ai_session_batch_enter(ni_session_context_t *p_ctx,
+                                              uint32_t state)
+{
+    // Here check if keep alive thread is closed.
+#ifdef _WIN32
+    if (p_ctx->keep_alive_thread.handle && p_ctx->keep_alive_thread_args &&
+        p_ctx->keep_alive_thread_args->close_thread)
+#else
+    if (p_ctx->keep_alive_thread && p_ctx->keep_alive_thread_args &&
+        p_ctx->keep_alive_thread_args->close_thread)
+#endif
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR: %s() keep alive thread has been closed, "
+               "hw:%d, session:%d\n",
+               __func__, p_ctx->hw_id, p_ctx->session_id);
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    // In close state, let the close process execute first.
+    if (p_ctx->xcoder_state & NI_XCODER_CLOSE_STATE)
+    {
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s close state, return\n", __func__);
+        ni_pthread_mutex_unlock(&p_ctx->mutex);
+        ni_usleep(100);
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    }
+    p_ctx->xcoder_state |= state;
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+    return NI_RETCODE_SUCCESS;
+}
+
+static void ni_ai_session_batch_leave(ni_session_context_t *p_ctx,
+                                      uint32_t state)
+{
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    p_ctx->xcoder_state &= ~state;
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+}
+
+int ni_ai_session_write_batch(ni_session_context_t *p_ctx,
+                              ni_frame_t *p_frames[], int num)
+{
+    int retval;
+
+    if (!p_ctx || !p_frames || num <= 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR: %s passed parameters are null, return\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_ctx->device_type != NI_DEVICE_TYPE_AI)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() not an AI session: %d\n",
+               __func__, p_ctx->device_type);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    retval = ni_ai_session_batch_enter(p_ctx, NI_XCODER_WRITE_STATE);
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        return retval;
+    }
+
+    retval = ni_ai_session_batch_write(p_ctx, p_frames, num);
+
+    ni_ai_session_batch_leave(p_ctx, NI_XCODER_WRITE_STATE);
+    return retval;
+}
+
+int ni_ai_session_write_hwframe_batch(ni_session_context_t *p_ctx,
+                                      niFrameSurface1_t *p_surfaces[], int num)
+{
+    int retval;
+
+    if (!p_ctx || !p_surfaces || num <= 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR: %s passed parameters are null, return\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_ctx->device_type != NI_DEVICE_TYPE_AI)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() not an AI session: %d\n",
+               __func__, p_ctx->device_type);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    retval = ni_ai_session_batch_enter(p_ctx, NI_XCODER_WRITE_STATE);
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        return retval;
+    }
+
+    retval = ni_ai_session_batch_write_hwframe(p_ctx, p_surfaces, num);
+
+    ni_ai_session_batch_leave(p_ctx, NI_XCODER_WRITE_STATE);
+    return retval;
+}
+
+int ni_ai_session_read_batch(ni_session_context_t *p_ctx,
+                             ni_packet_t *p_packets[], int num)
+{
+    int retval;
+
+    if (!p_ctx || !p_packets || num <= 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR: %s passed parameters are null, return\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_ctx->device_type != NI_DEVICE_TYPE_AI)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() not an AI session: %d\n",
+               __func__, p_ctx->device_type);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    retval = ni_ai_session_batch_enter(p_ctx, NI_XCODER_READ_STATE);
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        return retval;
+    }
+
+    retval = ni_ai_session_batch_read(p_ctx, p_packets, num);
+
+    ni_ai_session_batch_leave(p_ctx, NI_XCODER_READ_STATE);
+    return retval;
+}
+
 ni_retcode_t ni_query_fl_fw_versions(ni_device_handle_t device_handle,
                                      ni_device_info_t *p_dev_info)
 {
@@ -11845,8 +12949,7 @@ ni_retcode_t ni_query_nvme_status(ni_session_context_t *p_ctx,
     return NI_RETCODE_INVALID_PARAM;
   }
 
-  if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                        "6O") < 0)
+  if (!ni_fw_api_supports(p_ctx, NI_FW_API_NVME_STATUS))
   {
     ni_log2(p_ctx, NI_LOG_ERROR,
            "ERROR: %s function not supported on device with FW API version < 6.O\n",
@@ -12186,6 +13289,8 @@ ni_retcode_t ni_set_demo_roi_map(ni_session_context_t *p_enc_ctx)
     {
       return NI_RETCODE_ERROR_MEM_ALOC;
     }
+    // the demo map replaces any map built from ROI side data
+    ni_memfree(p_enc_ctx->p_roi_map_state);
 
     // for H.264, select ROI Map Block Unit Size: 16x16
     // for H.265, select ROI Map Block Unit Size: 64x64
@@ -13218,7 +14323,7 @@ ni_retcode_t ni_p2p_send(ni_session_context_t *pSession,
     }
 
     /* Firmware compatibility check */
-    if (ni_cmp_fw_api_ver((char *) &pSession->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6re") < 0)
+    if (!ni_fw_api_supports(pSession, NI_FW_API_P2P))
     {
         ni_log2(pSession, NI_LOG_ERROR, "%s: FW doesn't support this operation\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -13262,7 +14367,7 @@ ni_retcode_t ni_p2p_recv(ni_session_context_t *pSession,
     }
 
     /* Firmware compatibility check */
-    if (ni_cmp_fw_api_ver((char *) &pSession->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6re") < 0)
+    if (!ni_fw_api_supports(pSession, NI_FW_API_P2P))
     {
         ni_log2(pSession, NI_LOG_ERROR,
                 "%s: FW doesn't support this operation\n", __func__);
@@ -13318,8 +14423,7 @@ ni_retcode_t ni_device_session_restart(ni_session_context_t *p_ctx,
       case NI_DEVICE_TYPE_ENCODER:
         {
             // requires API version >= 54
-            if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                  "54") < 0)
+            if (!ni_fw_api_supports(p_ctx, NI_FW_API_SEQ_CHANGE_RESTART))
             {
                 ni_log2(p_ctx, NI_LOG_ERROR,  "Error: %s function not supported on device with FW API version < 5.4\n", __func__);
                 return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -13405,9 +14509,7 @@ ni_retcode_t ni_dec_reconfig_ppu_params(ni_session_context_t *p_session_ctx,
     }
 
     // check fw revision
-    if (ni_cmp_fw_api_ver(
-            (char*) &p_session_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6sF") < 0)
+    if (!ni_fw_api_supports(p_session_ctx, NI_FW_API_DEC_PPU_RECONFIG))
     {
         ni_log2(p_session_ctx, NI_LOG_ERROR,  "%s: not supported on device with FW API version < 6sF\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -483,6 +483,9 @@ typedef enum
 // If you change this,you should also change NI_QUADRA_MAX_NUM_AUX_DATA_PER_FRAME in ni_quadra_filter_api.h
 #define NI_MAX_NUM_AUX_DATA_PER_FRAME 16
 
+/// Number of 64-bit words of firmware feature flags in a session context
+#define NI_FW_API_FLAG_WORDS 2
+
 ///Max number of lines supported for the bitrate reconfig file
 #define NI_BITRATE_RECONFIG_FILE_MAX_LINES 50000
 ///Max number of entries per line supported for the bitrate reconfig file.
@@ -1291,6 +1294,7 @@ typedef struct _ni_buf_t
   struct  _ni_buf_t *p_next;
   struct  _ni_buf_t *p_previous_buffer;
   struct  _ni_buf_t *p_next_buffer;
+  size_t buf_size;      // allocated size of buf, may exceed the pool buf_size
 } ni_buf_t;
 
 typedef struct _ni_buf_pool_t
@@ -1302,6 +1306,12 @@ typedef struct _ni_buf_pool_t
     ni_buf_t *p_free_tail;
     ni_buf_t *p_used_head;
     ni_buf_t *p_used_tail;
+    // pre-warm of the buffer cache for the next resolution, see
+    // ni_dec_fme_buffer_pool_prewarm()
+    ni_pthread_t prewarm_thread;
+    int prewarm_started;
+    uint32_t prewarm_size;
+    int prewarm_count;
 } ni_buf_pool_t;
 
 typedef struct _ni_queue_node_t
@@ -1432,6 +1442,15 @@ typedef struct _ni_ppu_config{
     uint16_t ppu_h[NI_MAX_NUM_OF_DECODER_OUTPUTS];
 }ni_ppu_config_t;
 
+// Threads of an application that ni_device_session_pin_thread() places on
+// the CPUs local to the card of a session
+typedef enum _ni_session_thread
+{
+    NI_SESSION_THREAD_SEND = 0, // thread sending to the session
+    NI_SESSION_THREAD_RECV,     // thread receiving from the session
+    NI_SESSION_THREAD_NB
+} ni_session_thread_t;
+
 typedef struct _ni_session_context
 {
     /*! MEASURE_LATENCY queue */
@@ -1594,6 +1613,12 @@ typedef struct _ni_session_context
 
     // a mutex for Xcoder API, to keep the thread-safety.
     ni_pthread_mutex_t mutex;
+    // in async_mode the send and the receive direction are each serialized by
+    // their own half, taken before mutex; mutex is released while a half
+    // transfers data so both directions can progress at once. Session close
+    // and decoder flush take both halves, the others only their own.
+    ni_pthread_mutex_t send_mutex;
+    ni_pthread_mutex_t recv_mutex;
 
     // Xcoder running state
     uint32_t xcoder_state;
@@ -1611,6 +1636,8 @@ typedef struct _ni_session_context
     ni_region_of_interest_t *av_rois;
     int nb_rois;
     ni_enc_quad_roi_custom_map *roi_map;   // actual AVC/HEVC QP map
+    // state of the last roi_map built from av_rois, owned by ni_av_codec.c
+    void *p_roi_map_state;
 
     // only for H.264 test roi buffer for up to 8k resolution H.264 - 32 x 32 sub CTUs
     ni_enc_avc_roi_custom_map_t *avc_roi_map;
@@ -1695,6 +1722,9 @@ typedef struct _ni_session_context
     int low_delay_sync_flag;
     ni_pthread_mutex_t low_delay_sync_mutex;
     ni_pthread_cond_t low_delay_sync_cond;
+    uint64_t low_delay_send_ns;   // time of the send the flag waits for
+    uint64_t low_delay_avg_ns;    // average send to output time
+    int low_delay_skip_query_sleep;
 
     // muxtex default from source session
     // required pointer to external if used by hwdl
@@ -1761,6 +1791,15 @@ typedef struct _ni_session_context
 
     uint32_t headers_length;
     uint32_t last_frame_dropped;
+
+    // firmware features of the device, evaluated from fw_rev at session open
+    uint64_t fw_api_flags[NI_FW_API_FLAG_WORDS];
+
+    // number of CPUs local to the card, set at session open when
+    // enableCpuAffinity is set, and the one suggested to each thread of the
+    // session, see ni_device_session_cpu_hint()
+    int nb_local_cpus;
+    int thread_cpus[NI_SESSION_THREAD_NB];
 } ni_session_context_t;
 
 typedef struct _ni_split_context_t
@@ -2926,6 +2965,27 @@ typedef struct _ni_frame_config
     uint8_t orientation; // 0 <= n <= 3, (n * 90°) clockwise rotation
 } ni_frame_config_t;
 
+// one job of a ni_scaler_batch_t, ie. one ni_device_multi_config_frame() call
+typedef struct _ni_scaler_batch_job
+{
+    void *p_desc;       // device descriptor, kept while only frame indexes
+                        // change from one use of the slot to the next
+    uint32_t desc_len;  // bytes of p_desc sent
+    uint32_t desc_size; // bytes allocated for p_desc
+    int nb_in;          // input configs in p_desc, -1 if not valid
+    int has_out;        // p_desc ends with an output config
+    uint64_t reused;    // times p_desc was reused
+} ni_scaler_batch_job_t;
+
+// scaler jobs queued by ni_scaler_batch_add() and run by
+// ni_device_scaler_batch_submit()
+typedef struct _ni_scaler_batch
+{
+    ni_scaler_batch_job_t *p_jobs;
+    int max_jobs;
+    int nb_jobs;
+} ni_scaler_batch_t;
+
 
 // bitstream features related definitions
 typedef enum
@@ -3029,8 +3089,36 @@ typedef struct _ni_packet
   double ssim_v;
   uint8_t still_image_detected;
   uint8_t scene_change_detected;
+
+  // set when p_buffer is a slot of a packet arena, see
+  // ni_packet_arena_get_buffer(). These fields change sizeof(ni_packet_t)
+  // (ABI break since LIBXCODER_API_VERSION 2.83): applications must be
+  // rebuilt against this header.
+  struct _ni_packet_arena *p_arena;
+  int arena_slot;
 } ni_packet_t;
 
+/*!*****************************************************************************
+ *  \brief  Pool of fixed size, page aligned decoder input packet buffers.
+ *
+ *          The caller builds the bitstream of a packet straight into an arena
+ *          slot, so ni_decoder_session_write() sends it without the copy of
+ *          ni_packet_copy(). Slots are reference counted and go back to the
+ *          arena when their last reference is dropped by
+ *          ni_packet_buffer_free().
+ ******************************************************************************/
+typedef struct _ni_packet_arena
+{
+    uint8_t *p_base;          // nb_slots * slot_size bytes, page aligned
+    int slot_size;            // multiple of NI_MEM_PAGE_ALIGNMENT
+    int nb_slots;
+    int *p_refs;              // references held on each slot, 0 when free
+    int *p_free;              // stack of free slot indices
+    int nb_free;
+    int closing;              // ni_packet_arena_free() was called
+    ni_pthread_mutex_t mutex;
+} ni_packet_arena_t;
+
 typedef struct _ni_session_data_io
 {
   union
@@ -3229,6 +3317,41 @@ LIB_API ni_retcode_t ni_device_capability_query2(ni_device_handle_t device_handl
 LIB_API ni_retcode_t ni_device_session_open(ni_session_context_t *p_ctx,
                                             ni_device_type_t device_type);
 
+/*!*****************************************************************************
+ *  \brief  Get the CPU suggested for a thread that sends to or receives
+ *          from a session. It is one of the CPUs local to the session's
+ *          card, assigned round robin to the threads of the sessions opened
+ *          on that card, so that they are spread over the local cores and
+ *          the send and receive threads of a session run on different
+ *          ones when the card has more than one local CPU. Only available
+ *          when the session was opened with enableCpuAffinity set.
+ *
+ *  \param[in] p_ctx   Pointer to an opened ni_session_context_t struct
+ *  \param[in] thread  NI_SESSION_THREAD_SEND or NI_SESSION_THREAD_RECV
+ *
+ *  \return CPU id, -1 if there is no suggestion
+ ******************************************************************************/
+LIB_API int ni_device_session_cpu_hint(ni_session_context_t *p_ctx,
+                                       ni_session_thread_t thread);
+
+/*!*****************************************************************************
+ *  \brief  Pin the calling thread to the CPU suggested by
+ *          ni_device_session_cpu_hint() for its role. Nothing is done if
+ *          there is no suggestion, eg. the session was opened without
+ *          enableCpuAffinity.
+ *
+ *  \param[in] p_ctx   Pointer to an opened ni_session_context_t struct
+ *  \param[in] thread  NI_SESSION_THREAD_SEND or NI_SESSION_THREAD_RECV
+ *
+ *  \return On success
+ *                          NI_RETCODE_SUCCESS
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_FAILURE
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_device_session_pin_thread(ni_session_context_t *p_ctx,
+                                                  ni_session_thread_t thread);
+
 /*!*****************************************************************************
  *  \brief  Close device session that was previously opened by calling
  *          ni_device_session_open()
@@ -3375,6 +3498,49 @@ LIB_API int ni_device_session_read(ni_session_context_t *p_ctx,
                                    ni_session_data_io_t *p_data,
                                    ni_device_type_t device_type);
 
+/*!*****************************************************************************
+ *  \brief  Read all the data available from the device in one call, up to
+ *          nb_data entries. The first entry is read as ni_device_session_read()
+ *          would; the following ones only if they are ready already, without
+ *          waiting. This saves the per call locking, polling delay and low
+ *          delay handoff when an encoder outputs many small packets or a
+ *          decoder many small frames. A decoder batch ends at a sequence
+ *          change, which is returned as its last frame. Any frame reporting
+ *          a new resolution is re-read as by ni_device_session_read() and
+ *          also ends the batch; the frames read after it are freed and not
+ *          counted.
+ *
+ *  \param[in] p_ctx        Pointer to a caller allocated
+ *                          ni_session_context_t struct
+ *  \param[in] p_data       Array of nb_data caller allocated
+ *                          ni_session_data_io_t structs. For the encoder each
+ *                          has its packet buffer allocated. For the decoder
+ *                          the first one is set up with
+ *                          ni_decoder_frame_buffer_alloc() as for
+ *                          ni_device_session_read(); the others may be left
+ *                          without a buffer, they then get one from the
+ *                          decoder frame buffer pool when they are filled.
+ *                          Frames are released with
+ *                          ni_decoder_frame_buffer_free() as usual.
+ *  \param[in] nb_data      Number of entries in p_data
+ *  \param[in] device_type  NI_DEVICE_TYPE_DECODER or NI_DEVICE_TYPE_ENCODER
+ *
+ *  \return On success
+ *                          Number of entries filled, in output order, 0 if
+ *                          no data is available. An end of stream packet is
+ *                          counted and is the last one. If a read fails after
+ *                          some entries were filled they are returned and the
+ *                          failure is left to the next call.
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ ******************************************************************************/
+LIB_API int ni_device_session_read_batch(ni_session_context_t *p_ctx,
+                                         ni_session_data_io_t *p_data,
+                                         int nb_data,
+                                         ni_device_type_t device_type);
+
 /*!*****************************************************************************
  *  \brief  Query session data from the device -
  *          If device_type is valid, will query session data
@@ -3797,6 +3963,61 @@ LIB_API ni_retcode_t ni_packet_buffer_free_av1(ni_packet_t *ppacket);
 LIB_API int ni_packet_copy(void *p_destination, const void *const p_source,
                            int cur_size, void *p_leftover, int *p_prev_size);
 
+/*!*****************************************************************************
+ *  \brief  Allocate a packet arena
+ *
+ *  \param[in] slot_size  size of each packet buffer, rounded up to
+ *                        NI_MEM_PAGE_ALIGNMENT
+ *  \param[in] nb_slots   number of packet buffers
+ *
+ *  \return pointer to the arena on success, NULL otherwise
+ ******************************************************************************/
+LIB_API ni_packet_arena_t *ni_packet_arena_alloc(int slot_size, int nb_slots);
+
+/*!*****************************************************************************
+ *  \brief  Attach a free arena slot to p_packet, releasing the buffer it held
+ *          before. The caller then writes the packet, leftover bytes first,
+ *          at p_packet->p_data and sets p_packet->data_len. The bytes past
+ *          data_len up to the next page boundary are zeroed when the packet
+ *          is sent.
+ *
+ *  \param[in] p_arena      arena to take the slot from
+ *  \param[in] p_packet     packet to attach the slot to
+ *  \param[in] packet_size  bytes the caller will write
+ *
+ *  \return On success
+ *                          NI_RETCODE_SUCCESS
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_MEM_ALOC if packet_size does not
+ *                          fit a slot or no slot is free; the caller can fall
+ *                          back to ni_packet_buffer_alloc()
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_packet_arena_get_buffer(ni_packet_arena_t *p_arena,
+                                                ni_packet_t *p_packet,
+                                                int packet_size);
+
+/*!*****************************************************************************
+ *  \brief  Make p_dst another reference to the arena slot of p_src, releasing
+ *          the buffer p_dst held before. Both packets must be freed with
+ *          ni_packet_buffer_free().
+ *
+ *  \return On success    NI_RETCODE_SUCCESS
+ *          On failure    NI_RETCODE_INVALID_PARAM
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_packet_arena_ref(const ni_packet_t *p_src,
+                                         ni_packet_t *p_dst);
+
+/*!*****************************************************************************
+ *  \brief  Free a packet arena. Slots still referenced by packets stay valid
+ *          and the memory is released when the last of them is freed.
+ *
+ *  \param[in] p_arena  arena to free
+ *
+ *  \return None
+ ******************************************************************************/
+LIB_API void ni_packet_arena_free(ni_packet_arena_t *p_arena);
+
 /*!*****************************************************************************
  *  \brief  Add a new auxiliary data to a frame
  *
@@ -4263,6 +4484,78 @@ LIB_API ni_retcode_t ni_device_multi_config_frame(ni_session_context_t *p_ctx,
                                                   int numInCfgs,
                                                   ni_frame_config_t *p_cfg_out);
 
+/*!*****************************************************************************
+ *  \brief  Allocate a batch of up to max_jobs scaler jobs
+ *
+ *  \param[in]  max_jobs     number of jobs the batch can hold
+ *
+ *  \return         pointer to the batch, NULL on failure
+ ******************************************************************************/
+LIB_API ni_scaler_batch_t *ni_scaler_batch_alloc(int max_jobs);
+
+/*!*****************************************************************************
+ *  \brief  Queue a scaler job, configured as by ni_device_multi_config_frame()
+ *          with the same parameters. Jobs may work on any frames, of any
+ *          session, and are run in the order they are queued. The device
+ *          descriptor of a job slot is built once and only has its frame
+ *          indexes updated while the same job is queued again in that slot,
+ *          eg. the same mosaic tile on the next frame.
+ *
+ *  \param[in]  p_ctx        pointer to the scaler session context the batch
+ *                           will be submitted to
+ *  \param[in]  p_batch      batch to add the job to
+ *  \param[in]  p_cfg_in     input frame config array
+ *  \param[in]  numInCfgs    number of frame config entries in the p_cfg_in array
+ *  \param[in]  p_cfg_out    output frame config, or NULL
+ *
+ *  \return         NI_RETCODE_SUCCESS
+ *                  NI_RETCODE_INVALID_PARAM if the batch is full
+ *                  NI_RETCODE_NVME_SC_INVALID_PARAMETER
+ *                  NI_RETCODE_ERROR_MEM_ALOC
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_scaler_batch_add(ni_session_context_t *p_ctx,
+                                         ni_scaler_batch_t *p_batch,
+                                         ni_frame_config_t p_cfg_in[],
+                                         int numInCfgs,
+                                         ni_frame_config_t *p_cfg_out);
+
+/*!*****************************************************************************
+ *  \brief  Run all jobs queued in a scaler batch and empty it. The session is
+ *          locked once for the whole batch and each job takes one config
+ *          transfer and the check of its completion status, followed by the
+ *          query of its output frame index when it has an output.
+ *
+ *  \param[in]  p_ctx          pointer to scaler session context
+ *  \param[in]  p_batch        batch of jobs
+ *  \param[out] p_out_surface  array of hw descriptors, one per job queued,
+ *                             receiving the output frame of each job, left
+ *                             zeroed for jobs without output. May be NULL
+ *                             only if no job has an output, otherwise
+ *                             NI_RETCODE_INVALID_PARAM is returned and no job
+ *                             is done.
+ *
+ *  \return On success
+ *                          Number of jobs done. If a job fails the jobs before
+ *                          it are counted, and it and those after it are not
+ *                          done; an error is returned only if the first job
+ *                          fails.
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_FAILURE
+ ******************************************************************************/
+LIB_API int ni_device_scaler_batch_submit(ni_session_context_t *p_ctx,
+                                          ni_scaler_batch_t *p_batch,
+                                          niFrameSurface1_t p_out_surface[]);
+
+/*!*****************************************************************************
+ *  \brief  Free a scaler batch and its job descriptors
+ *
+ *  \param[in]  p_batch      batch to free, may be NULL
+ ******************************************************************************/
+LIB_API void ni_scaler_batch_free(ni_scaler_batch_t *p_batch);
+
 /*!*****************************************************************************
  *  \brief   Allocate memory for the frame buffer based on provided parameters
  *           taking into account the pixel format, width, height, stride,
@@ -4763,6 +5056,82 @@ LIB_API ni_retcode_t ni_device_session_sequence_change(ni_session_context_t *p_c
 LIB_API ni_retcode_t ni_ai_session_read_metrics(
     ni_session_context_t *p_ctx, ni_network_perf_metrics_t *p_metrics);
 
+/*!*****************************************************************************
+ *  \brief  Send several input tensors to an AI session in one call
+ *
+ *          An API convenience over ni_device_session_write(): device buffer
+ *          space is queried once for as many frames as it can take, which
+ *          are then written back to back under one lock without a query in
+ *          between. The writes are not coalesced, each frame is still one
+ *          NVMe write. Each frame is prepared as for
+ *          ni_device_session_write() (data_len[0] set, p_buffer or a single
+ *          page aligned iovec); multi-segment iovec frames are not supported
+ *          in a batch.
+ *
+ *  \param[in] p_ctx     Pointer to an opened AI session context
+ *  \param[in] p_frames  Array of num frames to send, in order
+ *  \param[in] num       Number of frames
+ *
+ *  \return On success
+ *                          Number of frames sent, less than num if the device
+ *                          input buffer stayed full
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ ******************************************************************************/
+LIB_API int ni_ai_session_write_batch(ni_session_context_t *p_ctx,
+                                      ni_frame_t *p_frames[], int num);
+
+/*!*****************************************************************************
+ *  \brief  Send several hw frames as inputs of an AI session in one call
+ *
+ *          The hw frame counterpart of ni_ai_session_write_batch(), same as
+ *          calling ni_device_alloc_frame() for NI_DEVICE_TYPE_AI with each
+ *          surface's frame index and size. Device buffer space is checked
+ *          once, and on FW API 6K and later the frame configs are checked
+ *          with one statistics query for the whole batch. Each frame is
+ *          still one NVMe config write.
+ *
+ *  \param[in] p_ctx       Pointer to an opened AI session context
+ *  \param[in] p_surfaces  Array of num hw frame surfaces to send, in order
+ *  \param[in] num         Number of surfaces
+ *
+ *  \return On success
+ *                          Number of frames sent, 0 if the device input
+ *                          buffer stayed full
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_MEM_ALOC
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ ******************************************************************************/
+LIB_API int ni_ai_session_write_hwframe_batch(ni_session_context_t *p_ctx,
+                                              niFrameSurface1_t *p_surfaces[],
+                                              int num);
+
+/*!*****************************************************************************
+ *  \brief  Read several inference outputs from an AI session in one call
+ *
+ *          Device output availability is queried once and every output
+ *          already available, up to num, is read back to back. Each packet
+ *          is prepared as for ni_device_session_read() (p_data allocated,
+ *          data_len set to the output size).
+ *
+ *  \param[in] p_ctx      Pointer to an opened AI session context
+ *  \param[in] p_packets  Array of num packets to fill, in order
+ *  \param[in] num        Number of packets
+ *
+ *  \return On success
+ *                          Number of outputs read, 0 if none is ready yet
+ *          On failure
+ *                          NI_RETCODE_INVALID_PARAM
+ *                          NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                          NI_RETCODE_ERROR_INVALID_SESSION
+ ******************************************************************************/
+LIB_API int ni_ai_session_read_batch(ni_session_context_t *p_ctx,
+                                     ni_packet_t *p_packets[], int num);
+
 /*!*****************************************************************************
  *  \brief  Query firmware loader and firmware versions from the device
  *
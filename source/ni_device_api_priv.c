@@ -64,6 +64,7 @@
 #ifdef __linux__
 #include <stdint.h>
 #include <poll.h>
+#include <linux/futex.h>
 #include "ni_p2p_ioctl.h"
 #endif
 #include "inttypes.h"
@@ -832,6 +833,110 @@ static ni_retcode_t check_err_rc(
 
 // ctx->decoder_low_delay is used as condition wait timeout for both decoder
 // and encoder send/recv multi-thread in low delay mode.
+//
+// On Linux low_delay_sync_flag is itself the completion: the send thread sets
+// it after each send, the recv thread clears it with an atomic exchange and
+// only makes a futex wake syscall when it was set, so neither side takes a
+// lock for the handoff. The recv thread keeps an average of the send to output
+// time; on multi-core hosts the send thread sleeps until shortly before the
+// output is expected and spins around that time, which avoids the wakeup
+// latency of the scheduler.
+#ifdef __linux__
+// half width of the window around the expected output the send thread spins in
+#define NI_LOW_DELAY_SPIN_NS 25000
+
+static void low_delay_mark_sent(ni_session_context_t* p_ctx)
+{
+  __atomic_store_n(&p_ctx->low_delay_send_ns, ni_gettime_ns(),
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&p_ctx->low_delay_sync_flag, 1, __ATOMIC_RELEASE);
+}
+
+static void low_delay_wait(ni_session_context_t* p_ctx)
+{
+  static int nb_cpus = 0;
+  const char *name = p_ctx->device_type == NI_DEVICE_TYPE_DECODER ? \
+                     "decoder" : "encoder";
+  if (p_ctx->async_mode && p_ctx->decoder_low_delay > 0 &&
+      __atomic_load_n(&p_ctx->low_delay_sync_flag, __ATOMIC_ACQUIRE))
+  {
+    uint64_t now_ns = ni_gettime_ns();
+    uint64_t deadline_ns = now_ns + p_ctx->decoder_low_delay * 1000000LL;
+    uint64_t expect_ns =
+        __atomic_load_n(&p_ctx->low_delay_send_ns, __ATOMIC_RELAXED) +
+        __atomic_load_n(&p_ctx->low_delay_avg_ns, __ATOMIC_RELAXED);
+    uint64_t spin_start_ns = 0;
+    uint64_t spin_end_ns = 0;
+    uint64_t until_ns;
+    struct timespec ts;
+
+    if (!nb_cpus)
+    {
+      nb_cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    // spinning only steals the cpu from the recv thread on a single core
+    if (nb_cpus > 1 && p_ctx->low_delay_avg_ns)
+    {
+      spin_start_ns = expect_ns - NI_LOW_DELAY_SPIN_NS;
+      spin_end_ns = expect_ns + NI_LOW_DELAY_SPIN_NS;
+    }
+
+    ni_log2(p_ctx, NI_LOG_DEBUG,  "%s waiting for %s recv thread\n", __FUNCTION__, name);
+
+    // In case of dead lock on waiting for notification from recv thread.
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+    while (__atomic_load_n(&p_ctx->low_delay_sync_flag, __ATOMIC_ACQUIRE))
+    {
+      now_ns = ni_gettime_ns();
+      if (now_ns >= deadline_ns)
+      {
+        __atomic_store_n(&p_ctx->low_delay_sync_flag, 0, __ATOMIC_RELEASE);
+        break;
+      }
+      if (now_ns >= spin_start_ns && now_ns < spin_end_ns)
+      {
+        continue;
+      }
+      until_ns = (now_ns < spin_start_ns) ? spin_start_ns : deadline_ns;
+      until_ns = ni_min(until_ns, deadline_ns);
+      ts.tv_sec = (until_ns - now_ns) / 1000000000LL;
+      ts.tv_nsec = (until_ns - now_ns) % 1000000000LL;
+      syscall(SYS_futex, &p_ctx->low_delay_sync_flag, FUTEX_WAIT_PRIVATE, 1,
+              &ts, NULL, 0);
+    }
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    // the previous output is out, the first buffer query need not back off
+    p_ctx->low_delay_skip_query_sleep = 1;
+  }
+}
+
+static void low_delay_signal(ni_session_context_t* p_ctx)
+{
+  const char *name = p_ctx->device_type == NI_DEVICE_TYPE_DECODER ? \
+                     "decoder" : "encoder";
+  if (p_ctx->async_mode && p_ctx->decoder_low_delay > 0 &&
+      __atomic_exchange_n(&p_ctx->low_delay_sync_flag, 0, __ATOMIC_ACQ_REL))
+  {
+    uint64_t sample_ns = ni_gettime_ns() -
+        __atomic_load_n(&p_ctx->low_delay_send_ns, __ATOMIC_RELAXED);
+    uint64_t avg_ns = __atomic_load_n(&p_ctx->low_delay_avg_ns,
+                                      __ATOMIC_RELAXED);
+
+    // moving average of the send to output time, 1/8 weight per sample
+    avg_ns = avg_ns ? (avg_ns * 7 + sample_ns) / 8 : sample_ns;
+    __atomic_store_n(&p_ctx->low_delay_avg_ns, avg_ns, __ATOMIC_RELAXED);
+
+    ni_log2(p_ctx, NI_LOG_DEBUG,  "%s: wake up %s send thread\n", __FUNCTION__, name);
+    syscall(SYS_futex, &p_ctx->low_delay_sync_flag, FUTEX_WAKE_PRIVATE, 1,
+            NULL, NULL, 0);
+  }
+}
+#else
+static void low_delay_mark_sent(ni_session_context_t* p_ctx)
+{
+  p_ctx->low_delay_sync_flag = 1;
+}
+
 static void low_delay_wait(ni_session_context_t* p_ctx)
 {
   const char *name = p_ctx->device_type == NI_DEVICE_TYPE_DECODER ? \
@@ -879,9 +984,15 @@ static void low_delay_signal(ni_session_context_t* p_ctx)
     ni_pthread_mutex_unlock(&p_ctx->low_delay_sync_mutex);
   }
 }
+#endif
 
 static void query_sleep(ni_session_context_t* p_ctx)
 {
+  if (p_ctx->low_delay_skip_query_sleep)
+  {
+    p_ctx->low_delay_skip_query_sleep = 0;
+    return;
+  }
   if (p_ctx->async_mode)
   {
     // To avoid IO spam on NP core from queries and high volumens on latency.
@@ -891,6 +1002,43 @@ static void query_sleep(ni_session_context_t* p_ctx)
   }
 }
 
+// In async mode a write or read call holds the half mutex of its direction
+// for its whole duration, taken before p_ctx->mutex, and gives up
+// p_ctx->mutex only while its data transfer is in flight. The other
+// direction can then query and transfer meanwhile; all other session state is
+// still only touched under p_ctx->mutex.
+static void duplex_half_lock(ni_session_context_t* p_ctx, ni_pthread_mutex_t* p_half)
+{
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_lock(p_half);
+  }
+}
+
+static void duplex_half_unlock(ni_session_context_t* p_ctx, ni_pthread_mutex_t* p_half)
+{
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_unlock(p_half);
+  }
+}
+
+static void duplex_transfer_begin(ni_session_context_t* p_ctx)
+{
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+  }
+}
+
+static void duplex_transfer_end(ni_session_context_t* p_ctx)
+{
+  if (p_ctx->async_mode)
+  {
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+  }
+}
+
 // create folder bearing the card name (nvmeX) if not existing
 // start working inside this folder: nvmeX
 // find the earliest saved and/or non-existing stream folder and use it as
@@ -1284,8 +1432,8 @@ ni_retcode_t ni_decoder_session_open(ni_session_context_t* p_ctx)
               LRETURN;
           }
 #else
-          ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): not support enableCpuAffinity parameter, "
-                 "enable with [./build.sh -c] on linux\n", __func__);
+          ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): enableCpuAffinity only places threads, NUMA "
+                 "memory binding needs [./build.sh -c] on linux\n", __func__);
 #endif
       }
   }
@@ -1396,8 +1544,7 @@ ni_retcode_t ni_decoder_session_open(ni_session_context_t* p_ctx)
     }
 
     // Send SW version to FW if FW API version is >= 6.2
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "62") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SW_VERSION_SSIM))
     {
         // Send SW version to session manager
         memset(p_buffer, 0, NI_DATA_BUFFER_LEN);
@@ -1503,9 +1650,7 @@ ni_retcode_t ni_decoder_session_open(ni_session_context_t* p_ctx)
 
   if (p_ctx->force_low_delay)
   {
-      if (ni_cmp_fw_api_ver(
-              (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-              "6r3") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_LOW_DELAY_FRAMEPOOL))
       {
           p_ctx->force_low_delay = false; // forceLowDelay not available for fw < 6r3
           ni_log2(p_ctx, NI_LOG_INFO, "Warn %s(): forceLowDelay is not available for fw < 6r3\n",
@@ -1734,8 +1879,7 @@ ni_retcode_t ni_decoder_session_close(ni_session_context_t* p_ctx, int eos_recie
     ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_DECODER, &sessionStatistic);
   }
 
-  if (ni_cmp_fw_api_ver(
-         (char *) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rg") >= 0)
+  if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_COMPLETE_INFO))
   {
     ni_log2(p_ctx, NI_LOG_INFO,
           "Decoder_complete_info:session_id 0x%x, total frames input:%u "
@@ -1878,6 +2022,36 @@ END:
     return retval;
 }
 
+/*!*****************************************************************************
+ *  \brief  Copy a custom SEI set into a new one, copying only the entries in
+ *          use and only the data bytes of each, so that a few small SEI do
+ *          not cost a copy of the whole set. The set is freed with free() by
+ *          the owner of the frame it ends up in.
+ *
+ *  \return  the copy, NULL if it could not be allocated
+ ******************************************************************************/
+ni_custom_sei_set_t *ni_custom_sei_set_dup(const ni_custom_sei_set_t *p_src)
+{
+    ni_custom_sei_set_t *p_dst;
+    int i;
+
+    p_dst = (ni_custom_sei_set_t *)malloc(sizeof(ni_custom_sei_set_t));
+    if (!p_dst)
+    {
+        return NULL;
+    }
+    p_dst->count = ni_min(p_src->count, NI_MAX_CUSTOM_SEI_CNT);
+    for (i = 0; i < p_dst->count; i++)
+    {
+        p_dst->custom_sei[i].type = p_src->custom_sei[i].type;
+        p_dst->custom_sei[i].location = p_src->custom_sei[i].location;
+        p_dst->custom_sei[i].size = p_src->custom_sei[i].size;
+        memcpy(p_dst->custom_sei[i].data, p_src->custom_sei[i].data,
+               ni_min((int)p_src->custom_sei[i].size, NI_MAX_CUSTOM_SEI_DATA));
+    }
+    return p_dst;
+}
+
 /*!******************************************************************************
  *  \brief  Send a video p_packet to decoder
  *
@@ -1906,6 +2080,7 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
     return NI_RETCODE_INVALID_PARAM;
   }
 
+  duplex_half_lock(p_ctx, &p_ctx->send_mutex);
   ni_pthread_mutex_lock(&p_ctx->mutex);
 
   if ((NI_INVALID_SESSION_ID == p_ctx->session_id))
@@ -1946,8 +2121,7 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
     query_retry++;
 
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "65") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
     {
         retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_DECODER,
                                                  &sessionStatistic);
@@ -1981,8 +2155,7 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
         buf_info.buf_avail_size == p_ctx->biggest_bitstream_buffer_allocated)
     {
       // Reallocate decoder bitstream buffers to accomodate
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "66") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_WRITE_LEN))
       {
           retval = ni_config_instance_set_write_len(p_ctx,
                                                     NI_DEVICE_TYPE_DECODER,
@@ -2103,8 +2276,19 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
         packet_size = ( (packet_size / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT) + NI_MEM_PAGE_ALIGNMENT;
     }
 
+    // arena slots are page sized, only the sub-page tail needs padding
+    if (p_packet->p_arena &&
+        p_data + packet_size <=
+            (uint8_t *)p_packet->p_buffer + p_packet->buffer_size)
+    {
+        memset(p_data + p_packet->data_len, 0,
+               packet_size - p_packet->data_len);
+    }
+
+    duplex_transfer_begin(p_ctx);
     retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
                                     p_data, packet_size, ui32LBA);
+    duplex_transfer_end(p_ctx);
     CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write,
                  p_ctx->device_type, p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
     CHECK_VPU_RECOVERY(retval);
@@ -2141,7 +2325,7 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
     }
 
     p_ctx->pkt_num++;
-    p_ctx->low_delay_sync_flag = 1;
+    low_delay_mark_sent(p_ctx);
   }
 
   //Handle end of stream flag
@@ -2218,13 +2402,9 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
 
     if (p_packet->p_custom_sei_set)
     {
-      p_ctx->pkt_custom_sei_set[p_ctx->pkt_index % NI_FIFO_SZ] = malloc(sizeof(ni_custom_sei_set_t));
-      if (p_ctx->pkt_custom_sei_set[p_ctx->pkt_index % NI_FIFO_SZ])
-      {
-        ni_custom_sei_set_t *p_custom_sei_set = p_ctx->pkt_custom_sei_set[p_ctx->pkt_index % NI_FIFO_SZ];
-        memcpy(p_custom_sei_set, p_packet->p_custom_sei_set, sizeof(ni_custom_sei_set_t));
-      }
-      else
+      p_ctx->pkt_custom_sei_set[p_ctx->pkt_index % NI_FIFO_SZ] =
+          ni_custom_sei_set_dup(p_packet->p_custom_sei_set);
+      if (!p_ctx->pkt_custom_sei_set[p_ctx->pkt_index % NI_FIFO_SZ])
       {
         /* warn and lose the sei data. */
         ni_log2(p_ctx, NI_LOG_ERROR,
@@ -2250,6 +2430,7 @@ int ni_decoder_session_write(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
 END:
 
   ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->send_mutex);
 
     if (NI_RETCODE_SUCCESS == retval)
     {
@@ -2374,14 +2555,15 @@ static int rotated_array_binary_search(uint64_t *lefts, uint64_t *rights,
     return -1;
 }
 
-/*!******************************************************************************
- *  \brief  Retrieve a YUV p_frame from decoder
- *
- *  \param
- *
- *  \return
- *******************************************************************************/
-int ni_decoder_session_read(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
+// Read one frame with p_ctx->mutex held. When drain is set a frame has just
+// been read in the same batch: the query is not delayed, and the call returns
+// without reading when no further frame is ready or when the next output is a
+// sequence change, which is left to the next non draining read.
+// *p_sequence_change is set when the read returned a sequence change.
+static int decoder_session_read_locked(ni_session_context_t* p_ctx,
+                                       ni_frame_t* p_frame, int drain,
+                                       int* p_low_delay_notify,
+                                       int* p_sequence_change)
 {
   ni_instance_mgr_stream_info_t data = { 0 };
   int rx_size = 0;
@@ -2408,16 +2590,6 @@ int ni_decoder_session_read(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
   uint8_t get_first_metadata = 0;
   uint8_t sequence_change = 0;
 
-  ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): enter\n", __func__);
-
-  if ((!p_ctx) || (!p_frame))
-  {
-    ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: passed parameters are null!, return\n");
-    return NI_RETCODE_INVALID_PARAM;
-  }
-
-  ni_pthread_mutex_lock(&p_ctx->mutex);
-
 start:
   if (NI_INVALID_SESSION_ID == p_ctx->session_id)
   {
@@ -2455,12 +2627,14 @@ start:
   }
   for (;;)
   {
-    query_sleep(p_ctx);
+    if (!drain)
+    {
+        query_sleep(p_ctx);
+    }
 
     query_retry++;
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "65") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
     {
         retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_DECODER,
                                                  &sessionStatistic);
@@ -2506,6 +2680,11 @@ start:
     }
     else if (buf_info.buf_avail_size == metadata_hdr_size)
     {
+      if (drain)
+      {
+          retval = NI_RETCODE_SUCCESS;
+          LRETURN;
+      }
       ni_log2(p_ctx, NI_LOG_DEBUG,  "Info only metadata hdr is available, seq change?\n");
       total_bytes_to_read = metadata_hdr_size;
       sequence_change = 1;
@@ -2513,6 +2692,25 @@ start:
     }
     else if (0 == buf_info.buf_avail_size)
     {
+      if (drain)
+      {
+          // nothing more ready, only check once whether this was the last one
+          if (p_ctx->ready_to_close)
+          {
+              retval = ni_query_stream_info(p_ctx, NI_DEVICE_TYPE_DECODER,
+                                            &data);
+              CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_query,
+                           p_ctx->device_type, p_ctx->hw_id,
+                           &(p_ctx->session_id), OPT_1);
+              CHECK_VPU_RECOVERY(retval);
+              if (NI_RETCODE_SUCCESS == retval && data.is_flushed)
+              {
+                  p_frame->end_of_stream = 1;
+                  low_delay_notify = 1;
+              }
+          }
+          LRETURN;
+      }
       // query to see if it is eos now, if we have sent it
       if (p_ctx->ready_to_close)
       {
@@ -2747,9 +2945,7 @@ start:
 
   if (buf_info.buf_avail_size == metadata_hdr_size && (!p_ctx->frame_num || !p_data_buffer))
   {
-    if (ni_cmp_fw_api_ver(
-        (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-        "6rE") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FIRST_METADATA))
     {
       // allocate p_data_buffer to read the first metadata
       void *p_metadata_buffer = NULL;
@@ -2786,8 +2982,10 @@ start:
             NI_MEM_PAGE_ALIGNMENT;
     }
 
+    duplex_transfer_begin(p_ctx);
     retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
                                    p_data_buffer, read_size_bytes, ui32LBA);
+    duplex_transfer_end(p_ctx);
     CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read, p_ctx->device_type,
                  p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
     CHECK_VPU_RECOVERY(retval);
@@ -2820,9 +3018,7 @@ start:
         {
             low_delay_notify = 1;
             sei_size = p_meta->sei_size;
-        } else if (ni_cmp_fw_api_ver(
-                (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                "6rE") >= 0)
+        } else if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FIRST_METADATA))
         {
             p_meta =
                 (ni_metadata_dec_frame_t *)((uint8_t *)p_frame->p_buffer);
@@ -2841,8 +3037,7 @@ start:
   // Note: session status is NOT reset but tracked between send
   // and recv to catch and recover from a loop condition
 
-  if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                        "6sP") >= 0)
+  if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FRAME_DROPPED))
   {
       rx_size = ni_create_frame(p_frame, bytes_read_so_far, &frame_offset, &frame_dropped, false);
   }
@@ -2878,8 +3073,7 @@ start:
       int64_t tmp_dts, prev_dts = INT64_MIN, ts_diff = 0;
       int nb_diff = 0;
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6sP") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FRAME_DROPPED))
       {
           if(p_ctx->last_frame_dropped + frame_dropped != p_ctx->session_statistic.ui32FramesDropped)
           {
@@ -3193,10 +3387,12 @@ start:
 
 END:
 
-    ni_pthread_mutex_unlock(&p_ctx->mutex);
-
     if (get_first_metadata && p_data_buffer)
         ni_aligned_free(p_data_buffer);
+    if (sequence_change)
+    {
+        *p_sequence_change = 1;
+    }
     if (sequence_change && p_ctx->frame_num)
     {
         if (p_ctx->actual_video_width ==  p_frame->video_width &&
@@ -3212,7 +3408,7 @@ END:
         ni_log2(p_ctx, NI_LOG_ERROR,  "%s(): bad exit, retval = %d\n", __func__, retval);
         if (retval == NI_RETCODE_ERROR_VPU_RECOVERY)
         {
-            low_delay_signal(p_ctx);
+            *p_low_delay_notify = 1;
         }
         return retval;
     } else
@@ -3220,12 +3416,144 @@ END:
         ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit, rx_size = %d\n", __func__, rx_size);
         if (low_delay_notify)
         {
-            low_delay_signal(p_ctx);
+            *p_low_delay_notify = 1;
         }
         return rx_size;
     }
 }
 
+/*!******************************************************************************
+ *  \brief  Retrieve a YUV p_frame from decoder
+ *
+ *  \param
+ *
+ *  \return
+ *******************************************************************************/
+int ni_decoder_session_read(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
+{
+  int retval;
+  int low_delay_notify = 0;
+  int sequence_change = 0;
+
+  ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): enter\n", __func__);
+
+  if ((!p_ctx) || (!p_frame))
+  {
+    ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR: passed parameters are null!, return\n");
+    return NI_RETCODE_INVALID_PARAM;
+  }
+
+  duplex_half_lock(p_ctx, &p_ctx->recv_mutex);
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+
+  retval = decoder_session_read_locked(p_ctx, p_frame, 0, &low_delay_notify,
+                                       &sequence_change);
+
+  ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->recv_mutex);
+
+  if (low_delay_notify)
+  {
+      low_delay_signal(p_ctx);
+  }
+
+  return retval;
+}
+
+/*!******************************************************************************
+ *  \brief  Read all YUV frames available from a xcoder decoder instance, up to
+ *          nb_data, holding the session lock once for the whole batch. The
+ *          first frame is waited for as by ni_decoder_session_read(). An entry
+ *          after the first one without a frame buffer gets one from the
+ *          decoder frame buffer pool, which is given back if it is not filled.
+ *
+ *  \param
+ *
+ *  \return number of frames read, including the end of stream frame, or an
+ *          error if the first read failed
+ *******************************************************************************/
+int ni_decoder_session_read_batch(ni_session_context_t* p_ctx,
+                                  ni_session_data_io_t* p_data, int nb_data)
+{
+  ni_frame_t* p_frame;
+  int retval = 0;
+  int nb_read = 0;
+  int low_delay_notify = 0;
+  int sequence_change = 0;
+  int from_pool;
+  int is_planar;
+  int i;
+
+  duplex_half_lock(p_ctx, &p_ctx->recv_mutex);
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+
+  for (i = 0; i < nb_data; i++)
+  {
+    p_frame = &p_data[i].data.frame;
+    from_pool = 0;
+    if (i > 0 && !p_frame->p_buffer)
+    {
+      if (!p_ctx->dec_fme_buf_pool || !p_ctx->active_video_width ||
+          !p_ctx->active_video_height)
+      {
+        break;
+      }
+      is_planar = (p_ctx->pixel_format == NI_PIX_FMT_YUV420P) ||
+          (p_ctx->pixel_format == NI_PIX_FMT_YUV420P10LE);
+      if (NI_RETCODE_SUCCESS != ni_decoder_frame_buffer_alloc(
+              p_ctx->dec_fme_buf_pool, p_frame, 1, p_ctx->actual_video_width,
+              p_ctx->active_video_height,
+              p_ctx->codec_format == NI_CODEC_FORMAT_H264,
+              p_ctx->bit_depth_factor, is_planar))
+      {
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s(): no pool buffer for frame %d\n",
+               __func__, i);
+        break;
+      }
+      from_pool = 1;
+    }
+
+    retval = decoder_session_read_locked(p_ctx, p_frame, i > 0,
+                                         &low_delay_notify, &sequence_change);
+    if (retval <= 0 && !p_frame->end_of_stream && from_pool)
+    {
+      ni_decoder_frame_buffer_free(p_frame);
+    }
+    if (retval < 0)
+    {
+      // keep the frames read so far, the error is returned by the next call
+      if (i > 0)
+      {
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s(): stop after %d frames, rc %d\n",
+               __func__, i, retval);
+        retval = 0;
+      }
+      break;
+    }
+    if (retval > 0 || p_frame->end_of_stream)
+    {
+      nb_read++;
+    }
+    // a sequence change is handled by the caller before any further frame
+    // is read
+    if (retval == 0 || p_frame->end_of_stream || sequence_change)
+    {
+      break;
+    }
+  }
+
+  ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->recv_mutex);
+
+  if (low_delay_notify)
+  {
+      low_delay_signal(p_ctx);
+  }
+
+  ni_log2(p_ctx, NI_LOG_TRACE, "%s(): %d frames\n", __func__, nb_read);
+  return (retval < 0) ? retval : nb_read;
+}
+
 /*!******************************************************************************
  *  \brief  Query current xcoder status
  *
@@ -3409,8 +3737,8 @@ ni_retcode_t ni_encoder_session_open(ni_session_context_t* p_ctx)
           LRETURN;
       }
 #else
-      ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): not support enableCpuAffinity parameter, "
-             "enable with [./build.sh -c] on linux\n", __func__);
+      ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): enableCpuAffinity only places threads, NUMA "
+             "memory binding needs [./build.sh -c] on linux\n", __func__);
 #endif
   }
 
@@ -3545,8 +3873,7 @@ ni_retcode_t ni_encoder_session_open(ni_session_context_t* p_ctx)
     }
 
     // Send SW version to FW if FW API version is >= 6.2
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "62") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SW_VERSION_SSIM))
     {
         // Send SW version to session manager
         memset(p_buffer, 0, NI_DATA_BUFFER_LEN);
@@ -3572,18 +3899,17 @@ ni_retcode_t ni_encoder_session_open(ni_session_context_t* p_ctx)
             LRETURN;
         }
 
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6sM") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6SM))
         {
           // For FW API ver 6sM or newer, initialize with the most current size
           p_ctx->meta_size = sizeof(ni_metadata_enc_bstream_t);
         }
-        else if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rc") >= 0)
+        else if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6RC))
         {
           // For FW API ver 6rc or newer, initialize with the most current size
           p_ctx->meta_size = NI_FW_ENC_BITSTREAM_META_DATA_SIZE_UNDER_MAJOR_6_MINOR_sM;
         }
-        else if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6p") >= 0)
+        else if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6P))
           // For FW API ver 6.p or newer, initialize with the most current size
           p_ctx->meta_size = NI_FW_ENC_BITSTREAM_META_DATA_SIZE_UNDER_MAJOR_6_MINOR_rc;
         else
@@ -3746,8 +4072,7 @@ ni_retcode_t ni_encoder_session_open(ni_session_context_t* p_ctx)
           }
           else
           {
-              if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                    "6m") >= 0)
+              if (ni_fw_api_supports(p_ctx, NI_FW_API_VF_NS_ID))
               {
                   ni_device_vf_ns_id_t sender_vf_ns_id = {0};
                   ni_device_vf_ns_id_t curr_vf_ns_id = {0};
@@ -4256,6 +4581,7 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
     }
   }
 
+  duplex_half_lock(p_ctx, &p_ctx->send_mutex);
   ni_pthread_mutex_lock(&p_ctx->mutex);
 
   uint8_t separate_metadata = p_frame->separate_metadata;
@@ -4323,8 +4649,7 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
       {
           query_sleep(p_ctx);
 
-          if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                "65") >= 0)
+          if (ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
           {
               retval = ni_query_session_statistic_info(
                   p_ctx, NI_DEVICE_TYPE_ENCODER, &sessionStatistic);
@@ -4453,8 +4778,7 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
     p_meta->frame_roi_avg_qp = p_ctx->roi_avg_qp;
     p_meta->enc_reconfig_data_size = p_frame->reconf_len;
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6Q") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_ZEROCOPY))
     {
         if (separate_start)
         {
@@ -4551,10 +4875,12 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
           sent_size =
               ((p_frame->metadata_buffer_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
 
+          duplex_transfer_begin(p_ctx);
           retval = ni_nvme_send_write_cmd(
               p_ctx->blk_io_handle, p_ctx->event_handle,
               p_frame->p_metadata_buffer, sent_size,
               ui32LBA_metadata);
+          duplex_transfer_end(p_ctx);
           CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
                        p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
           CHECK_VPU_RECOVERY(retval);
@@ -4567,21 +4893,75 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
           }
       }
 
-      if (separate_start)
       {
+          // the start buffer and the frame data go to the same lba, they are
+          // gathered into a single write command instead of one per buffer
+          ni_nvme_iovec_t iov[1 + NI_MAX_NUM_SW_FRAME_DATA_POINTERS];
+          int iovcnt = 0;
           uint32_t ui32LBA =
               WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
+
+          if (separate_start)
+          {
+              ni_log2(p_ctx, NI_LOG_DEBUG,
+                     "%s: p_start_buffer = %p, p_frame->start_buffer_size "
+                     "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
+                     __func__, p_frame->p_start_buffer, p_frame->start_buffer_size, p_ctx->frame_num,
+                     ui32LBA);
+
+              sent_size =
+                  ((p_frame->start_buffer_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+              iov[iovcnt].p_data = p_frame->p_start_buffer;
+              iov[iovcnt].data_len = sent_size;
+              iovcnt++;
+          }
+
           ni_log2(p_ctx, NI_LOG_DEBUG,
-                 "%s: p_start_buffer = %p, p_frame->start_buffer_size "
+                 "%s: p_data = %p, p_frame->buffer_size "
                  "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
-                 __func__, p_frame->p_start_buffer, p_frame->start_buffer_size, p_ctx->frame_num,
+                 __func__, p_frame->p_data, p_frame->buffer_size, p_ctx->frame_num,
                  ui32LBA);
 
-          sent_size =
-              ((p_frame->start_buffer_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+          if (p_frame->inconsecutive_transfer)
+          {
+              for (i = 0; i < NI_MAX_NUM_SW_FRAME_DATA_POINTERS; i++)
+              {
+                  if (p_frame->data_len[i])
+                  {
+                      sent_size = p_frame->data_len[i];
+                      if (separate_start)
+                        sent_size -= p_frame->start_len[i];
 
-          retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                          p_frame->p_start_buffer, sent_size, ui32LBA);
+                      sent_size =
+                          ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+                      iov[iovcnt].p_data = p_frame->p_data[i] + p_frame->start_len[i];
+                      iov[iovcnt].data_len = sent_size;
+                      iovcnt++;
+                  }
+              }
+          }
+          else
+          {
+              sent_size = frame_size_bytes;
+              if (separate_metadata)
+                sent_size -= p_frame->extra_data_len;
+              if (separate_start)
+                sent_size -= p_frame->total_start_len;
+
+              sent_size =
+                  ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+              iov[iovcnt].p_data = p_frame->p_buffer + p_frame->total_start_len;
+              iov[iovcnt].data_len = sent_size;
+              iovcnt++;
+          }
+
+          duplex_transfer_begin(p_ctx);
+          retval = ni_nvme_send_writev_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
+                                           iov, iovcnt, ui32LBA);
+          duplex_transfer_end(p_ctx);
           CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
                        p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
           CHECK_VPU_RECOVERY(retval);
@@ -4593,81 +4973,13 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
           }
       }
 
-      if (p_frame->inconsecutive_transfer)
+      //Save input frame data used for calculate PSNR
+      if ((ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6RC)) &&
+          (p_ctx->frame_num == 0 || ((p_ctx->frame_num  % ((ni_xcoder_params_t *)(p_ctx->p_session_config))->interval_of_psnr) == 0)) &&
+          (((ni_xcoder_params_t *)(p_ctx->p_session_config))->cfg_enc_params.get_psnr_mode < 3) &&
+          (!(((ni_xcoder_params_t *)(p_ctx->p_session_config))->cfg_enc_params.get_psnr_mode == 2 && p_ctx->codec_format == NI_CODEC_FORMAT_H265)))
       {
-          uint32_t ui32LBA =
-              WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
-
-          for (i = 0; i < NI_MAX_NUM_SW_FRAME_DATA_POINTERS; i++)
-          {
-              ni_log2(p_ctx, NI_LOG_DEBUG,
-                     "%s: p_data = %p, p_frame->buffer_size "
-                     "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
-                     __func__, p_frame->p_data, p_frame->buffer_size, p_ctx->frame_num,
-                     ui32LBA);
-
-              if (p_frame->data_len[i])
-              {
-                  sent_size = p_frame->data_len[i];
-                  if (separate_start)
-                    sent_size -= p_frame->start_len[i];
-
-                  sent_size =
-                      ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
-
-                  retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                                  p_frame->p_data[i]+p_frame->start_len[i], sent_size, ui32LBA);
-                  CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
-                               p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-                  CHECK_VPU_RECOVERY(retval);
-                  if (retval < 0)
-                  {
-                      ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR %s(): nvme command failed\n", __func__);
-                      retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-                      LRETURN;
-                  }
-              }
-          }
-      }
-      else
-      {
-          uint32_t ui32LBA =
-              WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
-          ni_log2(p_ctx, NI_LOG_DEBUG,
-                 "%s: p_data = %p, p_frame->buffer_size "
-                 "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
-                 __func__, p_frame->p_data, p_frame->buffer_size, p_ctx->frame_num,
-                 ui32LBA);
-
-          sent_size = frame_size_bytes;
-          if (separate_metadata)
-            sent_size -= p_frame->extra_data_len;
-          if (separate_start)
-            sent_size -= p_frame->total_start_len;
-
-          sent_size =
-              ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
-
-          retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                          p_frame->p_buffer+p_frame->total_start_len, sent_size, ui32LBA);
-          CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
-                       p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-          CHECK_VPU_RECOVERY(retval);
-          if (retval < 0)
-          {
-              ni_log2(p_ctx, NI_LOG_ERROR,  "ERROR %s(): nvme command failed\n", __func__);
-              retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-              LRETURN;
-          }
-      }
-
-      //Save input frame data used for calculate PSNR
-      if ((ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rc") >= 0) &&
-          (p_ctx->frame_num == 0 || ((p_ctx->frame_num  % ((ni_xcoder_params_t *)(p_ctx->p_session_config))->interval_of_psnr) == 0)) &&
-          (((ni_xcoder_params_t *)(p_ctx->p_session_config))->cfg_enc_params.get_psnr_mode < 3) &&
-          (!(((ni_xcoder_params_t *)(p_ctx->p_session_config))->cfg_enc_params.get_psnr_mode == 2 && p_ctx->codec_format == NI_CODEC_FORMAT_H265)))
-      {
-          if (ishwframe && !p_frame->end_of_stream)
+          if (ishwframe && !p_frame->end_of_stream)
           {
             // uint16_t input_frame_idx = ((niFrameSurface1_t*)(p_frame->p_data[3]))->ui16FrameIdx;
             // use hwdownload to download hw frame, but donot recycle hwframe buffer
@@ -4678,7 +4990,8 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
             if (ret <= 0)
             {
               ni_frame_buffer_free(&(hwdl_session_data.data.frame));
-              return ret;
+              retval = ret;
+              LRETURN;
             }
 
             hwdl_session_data.data.frame.pts = p_frame->pts;
@@ -4703,7 +5016,7 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
       p_ctx->status = 0;
       p_ctx->frame_num++;
       size = frame_size_bytes;
-      p_ctx->low_delay_sync_flag = 1;
+      low_delay_mark_sent(p_ctx);
 
 #ifdef XCODER_DUMP_DATA
       char dump_file[256];
@@ -4725,12 +5038,18 @@ int ni_encoder_session_write(ni_session_context_t* p_ctx, ni_frame_t* p_frame)
 END:
 
   ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->send_mutex);
 
     ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
     return retval;
 }
 
-int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
+// Read one packet with p_ctx->mutex held. When drain is set a packet has
+// just been read in the same batch: the query is not delayed and the call
+// returns as soon as no further packet is available, without waiting for one.
+static int encoder_session_read_locked(ni_session_context_t* p_ctx,
+                                       ni_packet_t* p_packet, int drain,
+                                       int* p_low_delay_notify)
 {
   ni_instance_mgr_stream_info_t data = { 0 };
   uint32_t actual_read_size = 0;
@@ -4746,19 +5065,6 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
   ni_instance_buf_info_t buf_info = { 0 };
   ni_session_statistic_t sessionStatistic = {0};
   int low_delay_notify = 0;
-  ni_log2(p_ctx, NI_LOG_TRACE, "%s(): enter\n", __func__);
-
-  if (!p_ctx || !p_packet || !p_packet->p_data)
-  {
-    ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() passed parameters are null!, return\n",
-           __func__);
-    retval = NI_RETCODE_INVALID_PARAM;
-    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): exit\n", __func__);
-
-    return retval;
-  }
-
-  ni_pthread_mutex_lock(&p_ctx->mutex);
 
   if (NI_INVALID_SESSION_ID == p_ctx->session_id)
   {
@@ -4788,12 +5094,14 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
   }
   for (;;)
   {
-      query_sleep(p_ctx);
+      if (!drain)
+      {
+          query_sleep(p_ctx);
+      }
 
       query_retry++;
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "65") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
       {
           retval = ni_query_session_statistic_info(
               p_ctx, NI_DEVICE_TYPE_ENCODER, &sessionStatistic);
@@ -4806,8 +5114,7 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
 
           if (((ni_xcoder_params_t *)p_ctx->p_session_config)->cfg_enc_params.lookAheadDepth)
           {
-            if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                  "6rX") >= 0)
+            if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_ADDITIONAL_DELAY))
             {
               if (p_ctx->current_frame_delay < (int)sessionStatistic.ui8AdditionalFramesDelay + p_ctx->initial_frame_delay)
               {
@@ -4861,7 +5168,8 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
       ni_log2(p_ctx, NI_LOG_DEBUG,  "Info enc read available buf size %u, eos %u !\n",
                      buf_info.buf_avail_size, p_packet->end_of_stream);
 
-      if ((((ni_xcoder_params_t *)p_ctx->p_session_config)->low_delay_mode ||
+      if (!drain &&
+          (((ni_xcoder_params_t *)p_ctx->p_session_config)->low_delay_mode ||
            (NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL == p_ctx->status)) &&
           !p_packet->end_of_stream && p_ctx->frame_num >= p_ctx->pkt_num)
       {
@@ -4883,7 +5191,8 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
             continue;
           }
       }
-      else if (((ni_xcoder_params_t *)p_ctx->p_session_config)->minFramesDelay)
+      else if (!drain &&
+               ((ni_xcoder_params_t *)p_ctx->p_session_config)->minFramesDelay)
       {
           if (p_ctx->pkt_num) // do not busy read until header is received
           {
@@ -4943,8 +5252,10 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
       }
   }
 
+  duplex_transfer_begin(p_ctx);
   retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
                                  p_packet->p_data, actual_read_size, ui32LBA);
+  duplex_transfer_end(p_ctx);
   CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read, p_ctx->device_type,
                p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
   CHECK_VPU_RECOVERY(retval);
@@ -4956,8 +5267,7 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
   }
 
   // SSIM is supported if fw_rev is >= 6.2
-  if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                        "62") >= 0)
+  if (ni_fw_api_supports(p_ctx, NI_FW_API_SW_VERSION_SSIM))
   {
       p_meta = (ni_metadata_enc_bstream_t *)p_packet->p_data;
       p_packet->pts = (int64_t)(p_meta->frame_tstamp);
@@ -4969,13 +5279,11 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
       ni_log2(p_ctx, NI_LOG_DEBUG,  "%s MetaDataSize %d FrameType %d AvgFrameQp %d ssim %d %d %d\n",
         __FUNCTION__, p_meta->metadata_size, p_meta->frame_type, p_meta->avg_frame_qp, p_meta->ssimY, p_meta->ssimU, p_meta->ssimV);
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6r2") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_ADAPTIVE_GOP_SIZE))
       {
         if (((ni_xcoder_params_t *)p_ctx->p_session_config)->cfg_enc_params.lookAheadDepth)
         {
-          if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                "6rX") < 0)
+          if (!ni_fw_api_supports(p_ctx, NI_FW_API_ENC_ADDITIONAL_DELAY))
           {
             if (p_meta->gop_size) // ignore frame 0 gop size 0 (other I-frame gop size 1)
             {
@@ -4993,10 +5301,9 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
         __FUNCTION__, p_meta->gop_size);
       }
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6p") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6P))
       {
-          if (ni_cmp_fw_api_ver((char*)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rm") >= 0)
+          if (ni_fw_api_supports(p_ctx, NI_FW_API_STILL_IMAGE_DETECT))
           {
             p_packet->still_image_detected  = p_meta->ui8StillImage;
             p_packet->scene_change_detected = p_meta->ui8SceneChange;
@@ -5016,8 +5323,7 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
               p_meta->ui8StillImage, p_meta->ui8SceneChange);
       }
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6sC") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_PASS1_COST))
       {
         if (p_meta->pass1Cost)
           ni_log2(p_ctx, NI_LOG_DEBUG,  "pkt_num %d pass1Cost %f\n", p_ctx->pkt_num, p_meta->pass1Cost);
@@ -5064,8 +5370,7 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
   if (size > 0)
   {
     if (p_ctx->pkt_num >= 1 &&
-        ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6sM") >= 0)
+        ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6SM))
     {
       p_meta = (ni_metadata_enc_bstream_t *)p_packet->p_data;
 
@@ -5079,8 +5384,7 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
     }
 
     if (p_ctx->pkt_num >= 1 &&
-        ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6rc") >= 0)
+        ni_fw_api_supports(p_ctx, NI_FW_API_ENC_META_6RC))
     {
       calculate_psnr(p_ctx, p_packet);
     }
@@ -5177,7 +5481,37 @@ int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
 
 END:
 
+  if (low_delay_notify)
+  {
+      *p_low_delay_notify = 1;
+  }
+
+  return retval;
+}
+
+int ni_encoder_session_read(ni_session_context_t* p_ctx, ni_packet_t* p_packet)
+{
+  int retval;
+  int low_delay_notify = 0;
+  ni_log2(p_ctx, NI_LOG_TRACE, "%s(): enter\n", __func__);
+
+  if (!p_ctx || !p_packet || !p_packet->p_data)
+  {
+    ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() passed parameters are null!, return\n",
+           __func__);
+    retval = NI_RETCODE_INVALID_PARAM;
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): exit\n", __func__);
+
+    return retval;
+  }
+
+  duplex_half_lock(p_ctx, &p_ctx->recv_mutex);
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+
+  retval = encoder_session_read_locked(p_ctx, p_packet, 0, &low_delay_notify);
+
   ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->recv_mutex);
 
   if (low_delay_notify)
   {
@@ -5189,6 +5523,76 @@ END:
     return retval;
 }
 
+/*!******************************************************************************
+ *  \brief  Read all packets available from a xcoder encoder instance, up to
+ *          nb_data, holding the session lock once for the whole batch. The
+ *          first packet is waited for as by ni_encoder_session_read().
+ *
+ *  \param
+ *
+ *  \return number of packets read, including the end of stream packet, or
+ *          an error if the first read failed
+ *******************************************************************************/
+int ni_encoder_session_read_batch(ni_session_context_t* p_ctx,
+                                  ni_session_data_io_t* p_data, int nb_data)
+{
+  ni_packet_t* p_packet;
+  int retval = 0;
+  int nb_read = 0;
+  int low_delay_notify = 0;
+  int i;
+
+  for (i = 0; i < nb_data; i++)
+  {
+    if (!p_data[i].data.packet.p_data)
+    {
+      ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() packet %d is not allocated\n",
+             __func__, i);
+      return NI_RETCODE_INVALID_PARAM;
+    }
+  }
+
+  duplex_half_lock(p_ctx, &p_ctx->recv_mutex);
+  ni_pthread_mutex_lock(&p_ctx->mutex);
+
+  for (i = 0; i < nb_data; i++)
+  {
+    p_packet = &p_data[i].data.packet;
+    retval = encoder_session_read_locked(p_ctx, p_packet, i > 0,
+                                         &low_delay_notify);
+    if (retval < 0)
+    {
+      // keep the packets read so far, the error is returned by the next call
+      if (i > 0)
+      {
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s(): stop after %d packets, rc %d\n",
+               __func__, i, retval);
+        retval = 0;
+      }
+      break;
+    }
+    if (retval > 0 || p_packet->end_of_stream)
+    {
+      nb_read++;
+    }
+    if (retval == 0 || p_packet->end_of_stream)
+    {
+      break;
+    }
+  }
+
+  ni_pthread_mutex_unlock(&p_ctx->mutex);
+  duplex_half_unlock(p_ctx, &p_ctx->recv_mutex);
+
+  if (low_delay_notify)
+  {
+      low_delay_signal(p_ctx);
+  }
+
+  ni_log2(p_ctx, NI_LOG_TRACE, "%s(): %d packets\n", __func__, nb_read);
+  return (retval < 0) ? retval : nb_read;
+}
+
 /*!******************************************************************************
  *  \brief  Send sequnce change to a xcoder encoder instance
  *
@@ -5256,8 +5660,7 @@ int ni_scaler_session_open(ni_session_context_t* p_ctx)
 
   if (p_ctx->scaler_operation == NI_SCALER_OPCODE_STACK)
   {
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "64") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_STACK_FILTER))
     {
       ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot use stack filter on device with FW API version < 6.4\n");
       return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -5266,8 +5669,7 @@ int ni_scaler_session_open(ni_session_context_t* p_ctx)
 
   if (p_ctx->scaler_operation == NI_SCALER_OPCODE_ROTATE)
   {
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "67") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_ROTATE_FILTER))
     {
       ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot use rotate filter on device with FW API version < 6.7\n");
       return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -5276,8 +5678,7 @@ int ni_scaler_session_open(ni_session_context_t* p_ctx)
 
   if (p_ctx->scaler_operation == NI_SCALER_OPCODE_IPOVLY)
   {
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6L") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_INPLACE_OVERLAY))
     {
       ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot use in-place overlay filter on device with FW API version < 6.L\n");
       return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -5286,8 +5687,7 @@ int ni_scaler_session_open(ni_session_context_t* p_ctx)
 
   if (p_ctx->scaler_operation == NI_SCALER_OPCODE_AI_ALIGN)
   {
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6sI") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_AI_ALIGN_FILTER))
     {
       ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot use ai align filter on device with FW API version < 6.sI\n");
       return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -5395,8 +5795,7 @@ int ni_scaler_session_open(ni_session_context_t* p_ctx)
     }
 
     // Send SW version to FW if FW API version is >= 6.2
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "62") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SW_VERSION_SSIM))
     {
         // Send SW version to session manager
         memset(p_buffer, 0, NI_DATA_BUFFER_LEN);
@@ -5597,9 +5996,7 @@ ni_retcode_t ni_config_instance_set_scaler_params(ni_session_context_t *p_ctx,
     if (p_cfg->filterblit == 5)
     {
       // check fw revision
-      if (ni_cmp_fw_api_ver(
-              (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-              "6sL") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_FILTERBLIT_5))
       {
         ni_log2(p_ctx, NI_LOG_ERROR,  "%s: not supported config filterblit 5 "
                       "on device with FW API version < 6rL\n", __func__);
@@ -5631,9 +6028,7 @@ ni_retcode_t ni_config_instance_set_scaler_params(ni_session_context_t *p_ctx,
     if (p_params->enable_scaler_params)
     {
       // check fw revision
-      if (ni_cmp_fw_api_ver(
-              (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-              "6s2") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_SCALER_PARAMS_BC))
       {
         ni_log2(p_ctx, NI_LOG_ERROR,  "%s: not supported config scaler params B and C "
                       "on device with FW API version < 6s1\n", __func__);
@@ -5771,9 +6166,7 @@ ni_retcode_t ni_scaler_alloc_frame(ni_session_context_t* p_ctx,
         // this operation is to free/allocate scaler frame pool
         if (rgba_color == 0)
         {
-            if (ni_cmp_fw_api_ver(
-                    (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                    "6r3") < 0)
+            if (!ni_fw_api_supports(p_ctx, NI_FW_API_LOW_DELAY_FRAMEPOOL))
             {
               ni_log2(p_ctx, NI_LOG_INFO,
                     "WARNING: Allocate framepool size 0 for session 0x%x\n", p_ctx->session_id);
@@ -5804,9 +6197,7 @@ ni_retcode_t ni_scaler_alloc_frame(ni_session_context_t* p_ctx,
           if (p_ctx->pool_type != NI_POOL_TYPE_NONE)
           {
             // try to expand the framepool
-            if (ni_cmp_fw_api_ver(
-                    (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                    "6r3") < 0)
+            if (!ni_fw_api_supports(p_ctx, NI_FW_API_LOW_DELAY_FRAMEPOOL))
             {
               ni_log2(p_ctx, NI_LOG_ERROR,
                     "ERROR: allocate framepool multiple times for session 0x%x "
@@ -6077,58 +6468,14 @@ END:
     return retval;
 }
 
-/*!******************************************************************************
- *  \brief  config multiple frames in the scaler
- *
- *  \param[in]  p_ctx               pointer to session context
- *  \param[in]  p_cfg_in            pointer to input frame config array
- *  \param[in]  numInCfgs           number of input frame configs in the p_cfg array
- *  \param[in]  p_cfg_out           pointer to output frame config
- *
- *  \return         NI_RETCODE_INVALID_PARAM
- *                  NI_RETCODE_ERROR_INVALID_SESSION
- *                  NI_RETCODE_ERROR_NVME_CMD_FAILED
- *                  NI_RETCODE_ERROR_MEM_ALOC
- *******************************************************************************/
-ni_retcode_t ni_scaler_multi_config_frame(ni_session_context_t *p_ctx,
-                                          ni_frame_config_t p_cfg_in[],
-                                          int numInCfgs,
-                                          ni_frame_config_t *p_cfg_out)
+// Fill the descriptors of a multi frame config, the inputs first and then
+// the output. Returns the output descriptor, left zeroed if p_cfg_out is NULL.
+static ni_instance_mgr_allocation_info_t *scaler_fill_multi_config(
+    ni_session_context_t *p_ctx, ni_instance_mgr_allocation_info_t *p_data,
+    ni_frame_config_t p_cfg_in[], int numInCfgs, ni_frame_config_t *p_cfg_out)
 {
-    ni_retcode_t retval = NI_RETCODE_SUCCESS;
-    ni_instance_mgr_allocation_info_t *p_data, *p_data_orig;
-    uint32_t dataLen;
-    uint32_t ui32LBA = 0;
     int i;
 
-    /* Round up to nearest 4096 bytes */
-    dataLen =
-        sizeof(ni_instance_mgr_allocation_info_t) * (numInCfgs + 1) + NI_MEM_PAGE_ALIGNMENT - 1;
-    dataLen = dataLen & 0xFFFFF000;
-
-    if (!p_ctx || (!p_cfg_in && numInCfgs))
-    {
-        return NI_RETCODE_INVALID_PARAM;
-    }
-
-    if (p_ctx->session_id == NI_INVALID_SESSION_ID)
-    {
-        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
-               __func__);
-        return NI_RETCODE_ERROR_INVALID_SESSION;
-    }
-
-    if (ni_posix_memalign((void **)&p_data, sysconf(_SC_PAGESIZE), dataLen))
-    {
-        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate buffer\n",
-               NI_ERRNO, __func__);
-        return NI_RETCODE_ERROR_MEM_ALOC;
-    }
-
-    memset(p_data, 0x00, dataLen);
-
-    p_data_orig = p_data;
-
     for (i = 0; i < numInCfgs; i++)
     {
         p_data->picture_width = p_cfg_in[i].picture_width;
@@ -6178,10 +6525,67 @@ ni_retcode_t ni_scaler_multi_config_frame(ni_session_context_t *p_ctx,
                p_data->rectangle_height, p_data->rectangle_x,
                p_data->rectangle_y);
     }
+
+    return p_data;
+}
+
+/*!******************************************************************************
+ *  \brief  config multiple frames in the scaler
+ *
+ *  \param[in]  p_ctx               pointer to session context
+ *  \param[in]  p_cfg_in            pointer to input frame config array
+ *  \param[in]  numInCfgs           number of input frame configs in the p_cfg array
+ *  \param[in]  p_cfg_out           pointer to output frame config
+ *
+ *  \return         NI_RETCODE_INVALID_PARAM
+ *                  NI_RETCODE_ERROR_INVALID_SESSION
+ *                  NI_RETCODE_ERROR_NVME_CMD_FAILED
+ *                  NI_RETCODE_ERROR_MEM_ALOC
+ *******************************************************************************/
+ni_retcode_t ni_scaler_multi_config_frame(ni_session_context_t *p_ctx,
+                                          ni_frame_config_t p_cfg_in[],
+                                          int numInCfgs,
+                                          ni_frame_config_t *p_cfg_out)
+{
+    ni_retcode_t retval = NI_RETCODE_SUCCESS;
+    ni_instance_mgr_allocation_info_t *p_data, *p_data_orig;
+    uint32_t dataLen;
+    uint32_t ui32LBA = 0;
+
+    /* Round up to nearest 4096 bytes */
+    dataLen =
+        sizeof(ni_instance_mgr_allocation_info_t) * (numInCfgs + 1) + NI_MEM_PAGE_ALIGNMENT - 1;
+    dataLen = dataLen & 0xFFFFF000;
+
+    if (!p_ctx || (!p_cfg_in && numInCfgs))
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (p_ctx->session_id == NI_INVALID_SESSION_ID)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
+               __func__);
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    }
+
+    if (ni_posix_memalign((void **)&p_data, sysconf(_SC_PAGESIZE), dataLen))
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate buffer\n",
+               NI_ERRNO, __func__);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    memset(p_data, 0x00, dataLen);
+
+    p_data_orig = p_data;
+    p_data = scaler_fill_multi_config(p_ctx, p_data, p_cfg_in, numInCfgs,
+                                      p_cfg_out);
+
     if(p_data->picture_width > NI_MAX_RESOLUTION_WIDTH || p_data->picture_height > NI_MAX_RESOLUTION_HEIGHT || ((p_data->picture_width > NI_MAX_RESOLUTION_RGBA_WIDTH || p_data->picture_height> NI_MAX_RESOLUTION_RGBA_HEIGHT) && ((GC620_RGBA8888 == p_data->picture_format) || (GC620_BGRX8888 == p_data->picture_format) || (GC620_ARGB8888 == p_data->picture_format) || (GC620_ABGR8888 == p_data->picture_format))))
     {
         ni_log2(p_ctx, NI_LOG_ERROR, "Resolution %d x %d not supported for %d format!\n", p_data->picture_width, p_data->picture_height, p_data->picture_format);
-        ni_aligned_free(p_data);
+        ni_aligned_free(p_data_orig);
         return NI_RETCODE_NVME_SC_INVALID_PARAMETER;
     }
 
@@ -6210,22 +6614,310 @@ END:
     return retval;
 }
 
-/*!******************************************************************************
- *  \brief  Query a particular xcoder instance to get GeneralStatus data
- *
- *  \param   ni_session_context_t p_ctx - xcoder Context
- *  \param   ni_device_type_t device_type - xcoder type Encoder or Decoder
- *  \param   ni_instance_mgr_general_status_t *out - Struct preallocated from the caller where the
- *  resulting data will be placed
- *
- *  \return - NI_RETCODE_SUCCESS on success, NI_RETCODE_ERROR_MEM_ALOC or NI_RETCODE_ERROR_NVME_CMD_FAILED on failure
- *******************************************************************************/
-int ni_query_general_status(ni_session_context_t* p_ctx, ni_device_type_t device_type, ni_instance_mgr_general_status_t* p_gen_status)
+// Query the output frame index of the last scaler operation into
+// pFrameSurface, with p_ctx->mutex held
+static ni_retcode_t scaler_read_hwdesc_locked(ni_session_context_t *p_ctx,
+                                              niFrameSurface1_t *pFrameSurface)
 {
-  void* p_buffer = NULL;
-  int retval = NI_RETCODE_SUCCESS;
-  uint32_t ui32LBA = 0;
-  uint32_t dataLen = ((sizeof(ni_instance_mgr_general_status_t) + (NI_MEM_PAGE_ALIGNMENT - 1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+    ni_retcode_t retval;
+    ni_instance_buf_info_t sInstanceBuf = {0};
+    int query_retry = 0;
+
+    for (;;)
+    {
+        query_retry++;
+
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s: query by ni_query_instance_buf_info INST_BUF_INFO_RW_UPLOAD\n",
+                __func__);
+        retval = ni_query_instance_buf_info(p_ctx, INST_BUF_INFO_RW_UPLOAD,
+                                            NI_DEVICE_TYPE_SCALER, &sInstanceBuf);
+
+        CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_query,
+            p_ctx->device_type, p_ctx->hw_id,
+            &(p_ctx->session_id), OPT_3);
+
+        if (retval == NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE)
+        {
+            if (query_retry >= 1000)
+            {
+                ni_log2(p_ctx, NI_LOG_DEBUG,  "Warning hwdesc read fail rc %d\n", retval);
+                LRETURN;
+            }
+        }
+        else if (retval != NI_RETCODE_SUCCESS)
+        {
+            LRETURN;
+        }
+        else
+        {
+            pFrameSurface->ui16FrameIdx = sInstanceBuf.hw_inst_ind.frame_index;
+            pFrameSurface->ui16session_ID = p_ctx->session_id;
+            pFrameSurface->device_handle =
+                (int32_t)((int64_t)p_ctx->blk_io_handle & 0xFFFFFFFF);
+            pFrameSurface->src_cpu = (uint8_t) NI_DEVICE_TYPE_SCALER;
+            pFrameSurface->output_idx = 0;
+
+            /* A frame index of zero is invalid, the memory acquisition failed */
+            if (pFrameSurface->ui16FrameIdx == 0)
+            {
+                if (query_retry >= 1000)
+                {
+                    ni_log2(p_ctx, NI_LOG_ERROR, "Error: 2D could not acquire frame\n");
+                    retval = NI_RETCODE_FAILURE;
+                    LRETURN;
+                }
+                ni_usleep(100);
+                continue;
+            }
+
+            ni_log2(p_ctx, NI_LOG_DEBUG,
+                   "Session=0x%x: %s got FrameIndex=%u\n",
+                   p_ctx->session_id,
+                   __func__,
+                   pFrameSurface->ui16FrameIdx);
+
+            LRETURN;
+        }
+    }
+
+END:
+
+    return retval;
+}
+
+// Whether a descriptor built by scaler_fill_multi_config() is the one p_cfg
+// would build, apart from its frame index
+static int scaler_desc_matches(const ni_instance_mgr_allocation_info_t *p_data,
+                               const ni_frame_config_t *p_cfg, int is_output)
+{
+    uint16_t options = is_output ? (p_cfg->options | NI_SCALER_FLAG_IO) :
+                                   (p_cfg->options & ~NI_SCALER_FLAG_IO);
+
+    return p_data->picture_width == p_cfg->picture_width &&
+        p_data->picture_height == p_cfg->picture_height &&
+        p_data->picture_format == p_cfg->picture_format &&
+        p_data->options == options &&
+        p_data->rectangle_width == p_cfg->rectangle_width &&
+        p_data->rectangle_height == p_cfg->rectangle_height &&
+        p_data->rectangle_x == p_cfg->rectangle_x &&
+        p_data->rectangle_y == p_cfg->rectangle_y &&
+        p_data->rgba_color == p_cfg->rgba_color &&
+        (is_output || (p_data->session_id == p_cfg->session_id &&
+                       p_data->output_index == p_cfg->output_index));
+}
+
+/*!******************************************************************************
+ *  \brief  Set the device descriptor of a scaler batch job. The descriptor of
+ *          the previous job queued in the same slot is reused, with only its
+ *          frame indexes updated, if the rest of the configs are unchanged.
+ *
+ *  \param[in]  p_ctx               pointer to session context
+ *  \param[in]  p_job               batch job slot
+ *  \param[in]  p_cfg_in            pointer to input frame config array
+ *  \param[in]  numInCfgs           number of input frame configs
+ *  \param[in]  p_cfg_out           pointer to output frame config, or NULL
+ *
+ *  \return         NI_RETCODE_SUCCESS
+ *                  NI_RETCODE_NVME_SC_INVALID_PARAMETER
+ *                  NI_RETCODE_ERROR_MEM_ALOC
+ *******************************************************************************/
+ni_retcode_t ni_scaler_batch_job_set(ni_session_context_t *p_ctx,
+                                     ni_scaler_batch_job_t *p_job,
+                                     ni_frame_config_t p_cfg_in[],
+                                     int numInCfgs,
+                                     ni_frame_config_t *p_cfg_out)
+{
+    ni_instance_mgr_allocation_info_t *p_data;
+    uint32_t dataLen;
+    int i;
+
+    p_data = (ni_instance_mgr_allocation_info_t *)p_job->p_desc;
+    if (p_data && p_job->nb_in == numInCfgs &&
+        p_job->has_out == (p_cfg_out != NULL))
+    {
+        for (i = 0; i < numInCfgs; i++)
+        {
+            if (!scaler_desc_matches(&p_data[i], &p_cfg_in[i], 0))
+            {
+                break;
+            }
+        }
+        if (i == numInCfgs &&
+            (!p_cfg_out || scaler_desc_matches(&p_data[i], p_cfg_out, 1)))
+        {
+            for (i = 0; i < numInCfgs; i++)
+            {
+                p_data[i].frame_index = p_cfg_in[i].frame_index;
+            }
+            if (p_cfg_out)
+            {
+                p_data[i].frame_index = p_cfg_out->frame_index;
+            }
+            p_job->reused++;
+            return NI_RETCODE_SUCCESS;
+        }
+    }
+
+    /* Round up to nearest 4096 bytes */
+    dataLen =
+        sizeof(ni_instance_mgr_allocation_info_t) * (numInCfgs + 1) + NI_MEM_PAGE_ALIGNMENT - 1;
+    dataLen = dataLen & 0xFFFFF000;
+
+    if (dataLen > p_job->desc_size)
+    {
+        ni_aligned_free(p_job->p_desc);
+        p_job->desc_size = 0;
+        if (ni_posix_memalign(&p_job->p_desc, sysconf(_SC_PAGESIZE), dataLen))
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate buffer\n",
+                   NI_ERRNO, __func__);
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+        p_job->desc_size = dataLen;
+    }
+    p_job->desc_len = dataLen;
+    // invalid until fully set
+    p_job->nb_in = -1;
+
+    memset(p_job->p_desc, 0x00, dataLen);
+    p_data = scaler_fill_multi_config(
+        p_ctx, (ni_instance_mgr_allocation_info_t *)p_job->p_desc, p_cfg_in,
+        numInCfgs, p_cfg_out);
+
+    if(p_data->picture_width > NI_MAX_RESOLUTION_WIDTH || p_data->picture_height > NI_MAX_RESOLUTION_HEIGHT || ((p_data->picture_width > NI_MAX_RESOLUTION_RGBA_WIDTH || p_data->picture_height> NI_MAX_RESOLUTION_RGBA_HEIGHT) && ((GC620_RGBA8888 == p_data->picture_format) || (GC620_BGRX8888 == p_data->picture_format) || (GC620_ARGB8888 == p_data->picture_format) || (GC620_ABGR8888 == p_data->picture_format))))
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "Resolution %d x %d not supported for %d format!\n", p_data->picture_width, p_data->picture_height, p_data->picture_format);
+        return NI_RETCODE_NVME_SC_INVALID_PARAMETER;
+    }
+
+    p_job->nb_in = numInCfgs;
+    p_job->has_out = (p_cfg_out != NULL);
+    return NI_RETCODE_SUCCESS;
+}
+
+/*!******************************************************************************
+ *  \brief  Run the jobs of a scaler batch in order, with p_ctx->mutex held.
+ *          Each job is one config transfer and the check of its completion
+ *          status, followed by the query of its output frame index if it has
+ *          an output. The batch stops at the first job that fails.
+ *
+ *  \param[in]  p_ctx               pointer to session context
+ *  \param[in]  p_batch             batch of jobs
+ *  \param[out] p_out_surface       array of p_batch->nb_jobs hw descriptors
+ *                                  receiving the job outputs, or NULL if no
+ *                                  job has an output
+ *
+ *  \return number of jobs done, or an error if the first job failed
+ *******************************************************************************/
+int ni_scaler_batch_config_frames(ni_session_context_t *p_ctx,
+                                  ni_scaler_batch_t *p_batch,
+                                  niFrameSurface1_t p_out_surface[])
+{
+    ni_scaler_batch_job_t *p_job;
+    ni_retcode_t retval = NI_RETCODE_SUCCESS;
+    uint32_t ui32LBA;
+    int nb_done;
+
+    if (p_ctx->session_id == NI_INVALID_SESSION_ID)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
+               __func__);
+        return NI_RETCODE_ERROR_INVALID_SESSION;
+    }
+
+    if (!p_out_surface)
+    {
+        for (nb_done = 0; nb_done < p_batch->nb_jobs; nb_done++)
+        {
+            if (p_batch->p_jobs[nb_done].has_out)
+            {
+                ni_log2(p_ctx, NI_LOG_ERROR,
+                       "ERROR %s(): job %d has an output but no hw "
+                       "descriptor to return it in\n", __func__, nb_done);
+                return NI_RETCODE_INVALID_PARAM;
+            }
+        }
+    }
+
+    ui32LBA = CONFIG_INSTANCE_SetScalerAlloc_W(p_ctx->session_id,
+                                               NI_DEVICE_TYPE_SCALER);
+
+    for (nb_done = 0; nb_done < p_batch->nb_jobs; nb_done++)
+    {
+        p_job = &p_batch->p_jobs[nb_done];
+
+        retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle,
+                                        p_ctx->event_handle, p_job->p_desc,
+                                        p_job->desc_len, ui32LBA);
+        // the output of a job that failed would be another job's frame
+        CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_config,
+                     p_ctx->device_type, p_ctx->hw_id, &(p_ctx->session_id),
+                     OPT_1);
+        if (NI_RETCODE_SUCCESS != retval)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR %s(): job %d nvme command failed\n", __func__,
+                   nb_done);
+            retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+            LRETURN;
+        }
+
+        if (p_out_surface)
+        {
+            memset(&p_out_surface[nb_done], 0, sizeof(niFrameSurface1_t));
+            if (p_job->has_out)
+            {
+                retval = scaler_read_hwdesc_locked(p_ctx,
+                                                   &p_out_surface[nb_done]);
+                if (NI_RETCODE_SUCCESS != retval)
+                {
+                    ni_log2(p_ctx, NI_LOG_ERROR,
+                           "ERROR %s(): job %d read hwdesc fail rc %d\n",
+                           __func__, nb_done, retval);
+                    retval = NI_RETCODE_FAILURE;
+                    LRETURN;
+                }
+            }
+        }
+    }
+
+END:
+
+    // the jobs done before a failed one are returned, the failure shows in
+    // the count
+    if (NI_RETCODE_SUCCESS != retval)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR %s(): job %d of %d failed, rc %d\n", __func__, nb_done,
+               p_batch->nb_jobs, retval);
+        if (!nb_done)
+        {
+            return (retval == NI_RETCODE_FAILURE) ? retval :
+                NI_RETCODE_ERROR_NVME_CMD_FAILED;
+        }
+    }
+
+    ni_log2(p_ctx, NI_LOG_DEBUG, "%s(): %d of %d jobs done\n", __func__, nb_done,
+           p_batch->nb_jobs);
+    return nb_done;
+}
+
+/*!******************************************************************************
+ *  \brief  Query a particular xcoder instance to get GeneralStatus data
+ *
+ *  \param   ni_session_context_t p_ctx - xcoder Context
+ *  \param   ni_device_type_t device_type - xcoder type Encoder or Decoder
+ *  \param   ni_instance_mgr_general_status_t *out - Struct preallocated from the caller where the
+ *  resulting data will be placed
+ *
+ *  \return - NI_RETCODE_SUCCESS on success, NI_RETCODE_ERROR_MEM_ALOC or NI_RETCODE_ERROR_NVME_CMD_FAILED on failure
+ *******************************************************************************/
+int ni_query_general_status(ni_session_context_t* p_ctx, ni_device_type_t device_type, ni_instance_mgr_general_status_t* p_gen_status)
+{
+  void* p_buffer = NULL;
+  int retval = NI_RETCODE_SUCCESS;
+  uint32_t ui32LBA = 0;
+  uint32_t dataLen = ((sizeof(ni_instance_mgr_general_status_t) + (NI_MEM_PAGE_ALIGNMENT - 1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
 
   ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): enter\n", __func__);
 
@@ -6817,8 +7509,7 @@ ni_query_session_statistic_info(ni_session_context_t *p_ctx,
         LRETURN;
     }
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "65") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
     {
         ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() not supported on device with FW api version < 6.5\n", __func__);
         return NI_RETCODE_ERROR_UNSUPPORTED_FW_VERSION;
@@ -6952,8 +7643,7 @@ ni_retcode_t ni_query_instance_buf_info(ni_session_context_t *p_ctx,
   }
   else if(INST_BUF_INFO_RW_WRITE_BY_EP == rw_type)
   {
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "65") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_SESSION_STATISTIC))
     {
       ui32LBA = QUERY_INSTANCE_WBUFF_SIZE_R_BY_EP(p_ctx->session_id, device_type);
     }
@@ -7457,7 +8147,7 @@ ni_retcode_t ni_config_instance_set_encoder_params(ni_session_context_t* p_ctx)
     LRETURN;
   }
 
-  if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rh") >= 0)
+  if (ni_fw_api_supports(p_ctx, NI_FW_API_ROI_QP_MAP_EXT))
   {
     buffer_size = NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL * NI_CUSTOMIZE_ROI_QP_NUM;
     ni_xcoder_params_t *session_config = (ni_xcoder_params_t *)p_ctx->p_session_config;
@@ -8616,7 +9306,7 @@ void ni_set_custom_dec_template(ni_session_context_t *p_ctx,
 
   p_cfg->ui8MaxExtraHwFrameCnt = p_dec->max_extra_hwframe_cnt;
   if (p_cfg->ui8MaxExtraHwFrameCnt != 255 &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rB") < 0)
+      !ni_fw_api_supports(p_ctx, NI_FW_API_MAX_EXTRA_HW_FRAME))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): maxExtraHwFrameCnt is not support for FW < 6rB\n", __func__);
   }
@@ -8624,28 +9314,28 @@ void ni_set_custom_dec_template(ni_session_context_t *p_ctx,
   p_cfg->ui8EnableAdvancedEc = p_dec->enable_advanced_ec;
   p_cfg->ui32ErrRatioThreshold = p_dec->error_ratio_threshold;
   if (p_cfg->ui8EnableAdvancedEc == 2 &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rO") < 0)
+      !ni_fw_api_supports(p_ctx, NI_FW_API_ADVANCED_EC_2))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): (enableAdvancedEc == 2) is not support for FW < 6rO\n", __func__);
     p_cfg->ui8EnableAdvancedEc = 1;
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): reset enableAdvancedEc to %d\n", __func__, p_cfg->ui8EnableAdvancedEc);
   }
   if (p_cfg->ui8EcPolicy == NI_EC_POLICY_LIMITED_ERROR &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6ri") < 0)
+      !ni_fw_api_supports(p_ctx, NI_FW_API_EC_LIMITED_ERROR))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): (EcPolicy == limited_error) not supported for FW < 6ri\n", __func__);
     p_cfg->ui8EcPolicy = NI_EC_POLICY_DEFAULT;
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): reset EcPolicy to %d\n", __func__, p_cfg->ui8EcPolicy);
   }
   if (p_cfg->ui32ErrRatioThreshold != NI_EC_ERR_THRESHOLD_DEFAULT &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6ri") < 0)
+      !ni_fw_api_supports(p_ctx, NI_FW_API_EC_LIMITED_ERROR))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): setting ecErrThreshold not supported for FW < 6ri\n", __func__);
     p_cfg->ui32ErrRatioThreshold = NI_EC_ERR_THRESHOLD_DEFAULT;
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): reset ecErrThreshold to %d\n", __func__, NI_EC_ERR_THRESHOLD_DEFAULT);
   }
   if (p_cfg->ui8EcPolicy == NI_EC_POLICY_BEST_EFFORT_OUT_DC &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6s1") < 0)
+      !ni_fw_api_supports(p_ctx, NI_FW_API_EC_BEST_EFFORT_OUT_DC))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): (EcPolicy == best_effort_out_dc) not supported for FW < 6s1\n", __func__);
     p_cfg->ui8EcPolicy = NI_EC_POLICY_DEFAULT;
@@ -8654,13 +9344,13 @@ void ni_set_custom_dec_template(ni_session_context_t *p_ctx,
   p_cfg->ui8DisableAdaptiveBuffers = p_dec->disable_adaptive_buffers;
   p_cfg->ui8SurviveStreamErr = p_dec->survive_stream_err;
   if (p_cfg->ui8SurviveStreamErr != 0 &&
-      ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rl") < 0) {
+      !ni_fw_api_supports(p_ctx, NI_FW_API_SURVIVE_STREAM_ERR)) {
     ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): surviveStreamErr is not supported for FW < 6rl\n", __func__);
   }
   if (p_dec->reduce_dpb_delay)
   {
     if (p_ctx->codec_format == NI_CODEC_FORMAT_H264 &&
-        ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rs") >= 0)
+        ni_fw_api_supports(p_ctx, NI_FW_API_REDUCE_DPB_DELAY))
       p_cfg->ui8ReduceDpbDelay = p_dec->reduce_dpb_delay;
     else
     {
@@ -9381,7 +10071,7 @@ void ni_set_custom_template(ni_session_context_t *p_ctx,
   if (p_enc->spatial_layers > 1)
   {
       p_cfg->ui8spatialLayersMinusOne = p_enc->spatial_layers - 1;
-      if (ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rw") < 0) {
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_SPATIAL_LAYERS)) {
         ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): spatialLayers is not supported for FW < 6rw\n", __func__);
       }
   }
@@ -9389,7 +10079,7 @@ void ni_set_custom_template(ni_session_context_t *p_ctx,
   if (p_enc->spatial_layers_ref_base_layer != 0)
   {
       p_cfg->ui8spatialLayersRefBaseLayer = p_enc->spatial_layers_ref_base_layer;
-      if (ni_cmp_fw_api_ver((char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6s0") < 0) {
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_SPATIAL_LAYERS_REF_BASE)) {
         ni_log2(p_ctx, NI_LOG_INFO, "Warning %s(): spatialLayers is not supported for FW < 6s0\n", __func__);
       }
   }
@@ -9452,8 +10142,7 @@ void ni_set_custom_template(ni_session_context_t *p_ctx,
                             p_ctx->pixel_format == NI_PIX_FMT_ARGB ||
                             p_ctx->pixel_format == NI_PIX_FMT_ABGR)  ? true : false;
       if (is_rgba ||
-          ((ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6Q") >= 0) &&
+          ((ni_fw_api_supports(p_ctx, NI_FW_API_ENC_ZEROCOPY)) &&
            p_src->source_width*p_src->source_height >= NI_NUM_OF_PIXELS_1080P))
         p_src->zerocopy_mode = 1;
       else
@@ -9495,12 +10184,10 @@ void ni_set_custom_template(ni_session_context_t *p_ctx,
 
     p_ctx->initial_frame_delay = initialDelayNum + (mulitcoreDelay ? 4 : 0); // for multicore pass-2, need to add 4 more frames before pass-2 could output frame
     p_ctx->max_frame_delay = ((maxDelayNum > maxLookaheadQueue) ?  maxDelayNum : maxLookaheadQueue) + (mulitcoreDelay ? 4 : 0); // for multicore pass-2, need to add 4 more frames before pass-2 could output frame
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6r2") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_ADAPTIVE_GOP_SIZE))
     {
         p_ctx->last_gop_size = gopSize; // for adaptive gop, gop size change can happen in pass-1, causing the first non-IDR output to carrry gop size 4 insetad of 8 and increase lookahead queue
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6rX") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_ENC_ADDITIONAL_DELAY))
         {
             if (p_t408->gop_preset_index == GOP_PRESET_IDX_DEFAULT || mulitcoreDelay) // for adaptive gop or multicore, just set max frame delay to workaround encoding stuck
                 p_ctx->current_frame_delay = p_ctx->max_frame_delay;
@@ -10488,8 +11175,7 @@ ni_retcode_t ni_validate_custom_dec_template(ni_xcoder_params_t *p_src,
 
   if (p_src->ddr_priority_mode >= 0)
   {
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6e") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_DDR_PRIORITY))
       {
           ni_strncpy(p_param_err, max_err_len, "ddr_priority_mode not supported on device with FW api version < 6.e",
                   max_err_len - 1);
@@ -10980,8 +11666,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
   }
   else if (p_cfg->ui8planarFormat == NI_PIXEL_PLANAR_FORMAT_TILED4X4)
   {
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "68") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_TILED4X4_INPUT))
       {
           ni_strncpy(p_param_err, max_err_len, "Invalid input planar format for device with FW api version < 6.8",
                   max_err_len - 1);
@@ -11029,8 +11714,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
       if (p_cfg->ui8PixelFormat == NI_PIX_FMT_RGBA ||
           p_cfg->ui8PixelFormat == NI_PIX_FMT_BGRA)
       {
-          if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                "6Y") < 0)
+          if (!ni_fw_api_supports(p_ctx, NI_FW_API_RGBA_INPUT))
           {
               ni_strncpy(p_param_err, max_err_len, "RGBA / BGRA pixel formats not supported on device with FW api version < 6.Y",
                       max_err_len - 1);
@@ -11053,8 +11737,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
 
   if (p_src->ddr_priority_mode >= 0)
   {
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6e") < 0)
+      if (!ni_fw_api_supports(p_ctx, NI_FW_API_DDR_PRIORITY))
       {
           ni_strncpy(p_param_err, max_err_len, "ddr_priority_mode not supported on device with FW api version < 6.e",
                   max_err_len - 1);
@@ -11207,8 +11890,8 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
 
     if(p_cfg->ui8enableSSIM != 0)
     {
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "62") < 0 || NI_CODEC_FORMAT_AV1 == p_ctx->codec_format)
+        if (!ni_fw_api_supports(p_ctx, NI_FW_API_SW_VERSION_SSIM) ||
+            NI_CODEC_FORMAT_AV1 == p_ctx->codec_format)
         {
             p_cfg->ui8enableSSIM = 0;
             ni_strncpy(p_param_warn, max_err_len, "enableSSIM only supported on device with FW api version < 6.2 "
@@ -11254,7 +11937,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
 
     if(p_cfg->ui8enableCompensateQp != 0)
     {
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6ru") < 0 ||
+        if (!ni_fw_api_supports(p_ctx, NI_FW_API_COMPENSATE_QP) ||
             NI_CODEC_FORMAT_AV1 == p_ctx->codec_format || p_cfg->ui16maxFrameSize == 0)
         {
             p_cfg->ui8enableCompensateQp = 0;
@@ -11470,7 +12153,8 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
       }
 
       if ((p_cfg->ui8stillImageDetectLevel != 0 || p_cfg->ui8sceneChangeDetectLevel != 0) &&
-          (p_cfg->niParamT408.gop_preset_index != 9 || ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rm") < 0))
+          (p_cfg->niParamT408.gop_preset_index != 9 ||
+           !ni_fw_api_supports(p_ctx, NI_FW_API_STILL_IMAGE_DETECT)))
       {
         ni_strncpy(p_param_warn, max_err_len, "StillImageDetect or SceneChangeDetect only support gopPresetIdx=9 with FW > 6rm\n", max_err_len - 1);
         warning = NI_RETCODE_PARAM_WARN;
@@ -11521,9 +12205,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
         }
         if (p_cfg->ui8multicoreJointMode != 0)
         {
-          if (ni_cmp_fw_api_ver(
-                  (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                  "6sD") < 0)
+          if (!ni_fw_api_supports(p_ctx, NI_FW_API_MULTICORE_LAYER_BITRATE))
           {
               ni_strncpy(p_param_err, max_err_len, "spatialLayerBitrate is not supported in multicoreJointMode for FW api version < 6sD", max_err_len - 1);
               param_ret = NI_RETCODE_ERROR_UNSUPPORTED_FEATURE;
@@ -12963,8 +13645,7 @@ ni_retcode_t ni_validate_custom_template(ni_session_context_t *p_ctx,
     {
       if (p_cfg->ui8LookAheadDepth < 4 || p_cfg->ui8LookAheadDepth > 40)
       {
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6X") < 0)
+        if (!ni_fw_api_supports(p_ctx, NI_FW_API_CRF_ANY_LOOKAHEAD))
         {
           ni_strncpy(p_param_err, max_err_len, "CRF requres LookAheadDepth <[4-40]>", max_err_len - 1);
           param_ret = NI_RETCODE_PARAM_ERROR_LOOK_AHEAD_DEPTH;
@@ -13889,8 +14570,7 @@ ni_retcode_t ni_uploader_session_open(ni_session_context_t* p_ctx)
     }
 
     // only update firmware with pixel rate if firmware >= 6rf
-    if (ni_cmp_fw_api_ver(
-         (char *) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rf") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_UPLOADER_MODEL_LOAD))
     {
       /* Add the modelled load of the hwuploader */
       if (p_ctx->framerate.framerate_denom == 0)
@@ -13967,6 +14647,61 @@ END:
   return retval;
 }
 
+// oldest FW API revision of each ni_fw_api_feature_t
+static const char *const g_fw_api_feature_ver[NI_FW_API_FEATURE_NUM] = {
+    NULL, // NI_FW_API_FLAGS_VALID
+#define NI_FW_API_FEATURE_VER(name, ver) ver,
+    NI_FW_API_FEATURES(NI_FW_API_FEATURE_VER)
+#undef NI_FW_API_FEATURE_VER
+};
+
+// fails to compile when the features outgrow fw_api_flags
+typedef char ni_fw_api_flags_size_check
+    [(NI_FW_API_FEATURE_NUM <= 64 * NI_FW_API_FLAG_WORDS) ? 1 : -1];
+
+/*!******************************************************************************
+*  \brief  Evaluate the firmware feature flags of a session from its fw_rev
+*
+*  \param[in] p_ctx  session context with fw_rev set
+*
+*  \return None
+*******************************************************************************/
+void ni_fw_api_update_flags(ni_session_context_t *p_ctx)
+{
+  int i;
+
+  memset(p_ctx->fw_api_flags, 0, sizeof(p_ctx->fw_api_flags));
+  for (i = NI_FW_API_FLAGS_VALID + 1; i < NI_FW_API_FEATURE_NUM; i++)
+  {
+    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
+                          g_fw_api_feature_ver[i]) >= 0)
+    {
+      p_ctx->fw_api_flags[i >> 6] |= 1ULL << (i & 63);
+    }
+  }
+  p_ctx->fw_api_flags[0] |= 1ULL << NI_FW_API_FLAGS_VALID;
+}
+
+/*!******************************************************************************
+*  \brief  Check a firmware feature of a session whose flags were not
+*          evaluated, by comparing its fw_rev directly
+*
+*  \param[in] p_ctx    session context with fw_rev set
+*  \param[in] feature  feature to check
+*
+*  \return 1 if supported, 0 otherwise
+*******************************************************************************/
+int ni_fw_api_supports_slow(const ni_session_context_t *p_ctx,
+                            ni_fw_api_feature_t feature)
+{
+  if (feature <= NI_FW_API_FLAGS_VALID || feature >= NI_FW_API_FEATURE_NUM)
+  {
+    return 0;
+  }
+  return ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
+                           g_fw_api_feature_ver[feature]) >= 0;
+}
+
 /*!******************************************************************************
 *  \brief  Copy a xcoder decoder worker thread info
 *
@@ -13989,6 +14724,8 @@ ni_retcode_t ni_decoder_session_copy_internal(ni_session_context_t *src_p_ctx, n
   dst_p_ctx->hw_id = src_p_ctx->hw_id;
   dst_p_ctx->session_timestamp = src_p_ctx->session_timestamp;
   memcpy(dst_p_ctx->fw_rev, src_p_ctx->fw_rev, sizeof(src_p_ctx->fw_rev));
+  memcpy(dst_p_ctx->fw_api_flags, src_p_ctx->fw_api_flags,
+         sizeof(src_p_ctx->fw_api_flags));
   if (src_p_ctx->isP2P)
   {
       dst_p_ctx->isP2P = src_p_ctx->isP2P;
@@ -14339,8 +15076,7 @@ int ni_hwupload_session_write(ni_session_context_t *p_ctx, ni_frame_t *p_frame,
 
       if (separate_metadata)
       {
-          if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                                "6S") < 0)
+          if (!ni_fw_api_supports(p_ctx, NI_FW_API_UPLOADER_ZEROCOPY))
           {
               ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): uploader separated metadata not supported on device with FW api version < 6.S\n",
                      __func__);
@@ -14409,95 +15145,79 @@ int ni_hwupload_session_write(ni_session_context_t *p_ctx, ni_frame_t *p_frame,
           }
       }
 
-      if (separate_start)
       {
-          if (!p_frame->p_start_buffer)
-          {
-              ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): p_start_buffer is NULL, allocation failed?\n",
-                     __func__);
-              retval = NI_RETCODE_ERROR_MEM_ALOC;
-              LRETURN;
-          }
-
+          // the start buffer and the frame data go to the same lba, they are
+          // gathered into a single write command instead of one per buffer
+          ni_nvme_iovec_t iov[1 + NI_MAX_NUM_SW_FRAME_DATA_POINTERS];
+          int iovcnt = 0;
           uint32_t ui32LBA =
               WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
-          ni_log2(p_ctx, NI_LOG_DEBUG,
-                 "%s: p_start_buffer = %p, p_frame->start_buffer_size "
-                 "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
-                 __func__, p_frame->p_start_buffer, p_frame->start_buffer_size, p_ctx->frame_num,
-                 ui32LBA);
-
-          sent_size =
-              ((p_frame->start_buffer_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
 
-          retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                          p_frame->p_start_buffer, sent_size, ui32LBA);
-          CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
-                       p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-          CHECK_VPU_RECOVERY(retval);
-          if (retval < 0)
+          if (separate_start)
           {
-              ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
-              retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-              LRETURN;
-          }
-      }
-
-      if (p_frame->inconsecutive_transfer)
-      {
-          uint32_t ui32LBA =
-              WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
+              if (!p_frame->p_start_buffer)
+              {
+                  ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): p_start_buffer is NULL, allocation failed?\n",
+                         __func__);
+                  retval = NI_RETCODE_ERROR_MEM_ALOC;
+                  LRETURN;
+              }
 
-          for (i = 0; i < NI_MAX_NUM_SW_FRAME_DATA_POINTERS; i++)
-          {
               ni_log2(p_ctx, NI_LOG_DEBUG,
-                     "%s: p_data = %p, p_frame->buffer_size "
+                     "%s: p_start_buffer = %p, p_frame->start_buffer_size "
                      "= %u, p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
-                     __func__, p_frame->p_data, p_frame->buffer_size, p_ctx->frame_num,
+                     __func__, p_frame->p_start_buffer, p_frame->start_buffer_size, p_ctx->frame_num,
                      ui32LBA);
 
-              if (p_frame->data_len[i])
-              {
-                  sent_size = p_frame->data_len[i];
-                  if (separate_start)
-                    sent_size -= p_frame->start_len[i];
-
-                  sent_size =
-                      ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
-
-                  retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                                  p_frame->p_data[i]+p_frame->start_len[i], sent_size, ui32LBA);
-                  CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
-                               p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-                  CHECK_VPU_RECOVERY(retval);
-                  if (retval < 0)
-                  {
-                      ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
-                      retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-                      LRETURN;
-                  }
-              }
+              sent_size =
+                  ((p_frame->start_buffer_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+              iov[iovcnt].p_data = p_frame->p_start_buffer;
+              iov[iovcnt].data_len = sent_size;
+              iovcnt++;
           }
-      }
-      else
-      {
-          uint32_t ui32LBA =
-              WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_ENCODER);
+
           ni_log2(p_ctx, NI_LOG_DEBUG,
                  "%s: p_data = %p, p_frame->buffer_size = %u, "
                  "p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
                  __func__, p_frame->p_data, p_frame->buffer_size, p_ctx->frame_num,
                  ui32LBA);
 
-          sent_size = frame_size_bytes;
-          if (separate_start)
-            sent_size -= p_frame->total_start_len;
+          if (p_frame->inconsecutive_transfer)
+          {
+              for (i = 0; i < NI_MAX_NUM_SW_FRAME_DATA_POINTERS; i++)
+              {
+                  if (p_frame->data_len[i])
+                  {
+                      sent_size = p_frame->data_len[i];
+                      if (separate_start)
+                        sent_size -= p_frame->start_len[i];
 
-          sent_size =
-              ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+                      sent_size =
+                          ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
+
+                      iov[iovcnt].p_data = p_frame->p_data[i] + p_frame->start_len[i];
+                      iov[iovcnt].data_len = sent_size;
+                      iovcnt++;
+                  }
+              }
+          }
+          else
+          {
+              sent_size = frame_size_bytes;
+              if (separate_start)
+                sent_size -= p_frame->total_start_len;
+
+              sent_size =
+                  ((sent_size + (NI_MEM_PAGE_ALIGNMENT-1)) / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT;
 
-          retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                          p_frame->p_buffer+p_frame->total_start_len, sent_size, ui32LBA);
+              iov[iovcnt].p_data = p_frame->p_buffer + p_frame->total_start_len;
+              iov[iovcnt].data_len = sent_size;
+              iovcnt++;
+          }
+
+          retval = ni_nvme_send_writev_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
+                                           iov, iovcnt, ui32LBA);
           CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
                        p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
           CHECK_VPU_RECOVERY(retval);
@@ -14745,6 +15465,7 @@ ni_retcode_t ni_decoder_session_read_desc(ni_session_context_t* p_ctx, ni_frame_
         return NI_RETCODE_INVALID_PARAM;
     }
 
+    duplex_half_lock(p_ctx, &p_ctx->recv_mutex);
     ni_pthread_mutex_lock(&p_ctx->mutex);
 
 start:
@@ -14790,9 +15511,7 @@ start:
 
     query_retry++;
 
-    if (ni_cmp_fw_api_ver(
-            (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6r3") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_LOW_DELAY_FRAMEPOOL))
     {
         retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_DECODER,
                                                  &sessionStatistic);
@@ -15055,9 +15774,7 @@ start:
       abort();
   } else if (total_bytes_to_read == metadata_hdr_size && !p_ctx->frame_num)
   {
-      if (ni_cmp_fw_api_ver(
-          (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-          "6rE") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FIRST_METADATA))
       {
         // allocate p_data_buffer to read the first metadata
         void *p_metadata_buffer = NULL;
@@ -15090,8 +15807,10 @@ start:
       read_size_bytes = ( (read_size_bytes / NI_MEM_PAGE_ALIGNMENT) * NI_MEM_PAGE_ALIGNMENT) + NI_MEM_PAGE_ALIGNMENT;
   }
 
+  duplex_transfer_begin(p_ctx);
   retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
                                  p_data_buffer, read_size_bytes, ui32LBA);
+  duplex_transfer_end(p_ctx);
   CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read, p_ctx->device_type,
                p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
   CHECK_VPU_RECOVERY(retval);
@@ -15193,9 +15912,7 @@ start:
                  "planar=%d bd=%d\n",
                  __func__, p_ctx->session_id, p_data3->ui16FrameIdx, p_data3->ui32nodeAddress,
                  p_data3->encoding_type, p_data3->bit_depth);
-      } else if (ni_cmp_fw_api_ver(
-                (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                "6rE") >= 0)
+      } else if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FIRST_METADATA))
       {
         p_meta =
             (ni_metadata_dec_frame_t *)((uint8_t *)p_frame->p_buffer);
@@ -15225,8 +15942,7 @@ start:
   //total_bytes_to_read = p_frame->data_len[0] + p_frame->data_len[1] + p_frame->data_len[2] + p_frame->data_len[3] + metadata_hdr_size + sei_size; //since only HW desc
   bytes_read_so_far = total_bytes_to_read;
   //bytes_read_so_far = p_frame->data_len[0] + p_frame->data_len[1] + p_frame->data_len[2] + p_frame->data_len[3] + metadata_hdr_size + sei_size; //since only HW desc
-  if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                        "6sP") >= 0)
+  if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FRAME_DROPPED))
   {
       rx_size = ni_create_frame(p_frame, bytes_read_so_far, &frame_offset, &frame_dropped, true);
   }
@@ -15262,8 +15978,7 @@ start:
       int64_t tmp_dts, prev_dts = INT64_MIN, ts_diff = 0;
       int nb_diff = 0;
 
-      if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                            "6sP") >= 0)
+      if (ni_fw_api_supports(p_ctx, NI_FW_API_DEC_FRAME_DROPPED))
       {
           if(p_ctx->last_frame_dropped + frame_dropped != p_ctx->session_statistic.ui32FramesDropped)
           {
@@ -15570,6 +16285,7 @@ start:
 END:
 
     ni_pthread_mutex_unlock(&p_ctx->mutex);
+    duplex_half_unlock(p_ctx, &p_ctx->recv_mutex);
 
     if (get_first_metadata && p_data_buffer)
         ni_aligned_free(p_data_buffer);
@@ -16138,7 +16854,7 @@ ni_retcode_t ni_config_instance_set_decoder_params(ni_session_context_t* p_ctx,
     LRETURN;
   }
 
-  if (ni_cmp_fw_api_ver((char*)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rT") < 0)
+  if (!ni_fw_api_supports(p_ctx, NI_FW_API_DEC_LOAD_BALANCE))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "%s() FW rev %s < 6rT-- load balancing might be affected\n", __func__,
             (char*)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX]);
@@ -16266,7 +16982,7 @@ ni_retcode_t ni_config_instance_set_decoder_ppu_params(ni_session_context_t* p_c
 
   ni_pthread_mutex_lock(&p_ctx->mutex);
 
-  if (ni_cmp_fw_api_ver((char*)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6rT") < 0)
+  if (!ni_fw_api_supports(p_ctx, NI_FW_API_DEC_LOAD_BALANCE))
   {
     ni_log2(p_ctx, NI_LOG_INFO, "%s() FW rev %s < 6rT-- load balancing might be affected\n", __func__,
             (char*)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX]);
@@ -16330,9 +17046,7 @@ ni_retcode_t ni_scaler_session_read_hwdesc(
     ni_frame_t *p_frame)
 {
     ni_retcode_t retval;
-    ni_instance_buf_info_t sInstanceBuf = {0};
     niFrameSurface1_t *pFrameSurface;
-    int query_retry = 0;
 
     if (!p_ctx || !p_frame || !p_frame->p_data[3])
     {
@@ -16364,65 +17078,8 @@ ni_retcode_t ni_scaler_session_read_hwdesc(
 
     ni_pthread_mutex_lock(&p_ctx->mutex);
 
-    for (;;)
-    {
-        query_retry++;
-
-        ni_log2(p_ctx, NI_LOG_DEBUG, "%s: query by ni_query_instance_buf_info INST_BUF_INFO_RW_UPLOAD\n",
-                __func__);
-        retval = ni_query_instance_buf_info(p_ctx, INST_BUF_INFO_RW_UPLOAD,
-                                            NI_DEVICE_TYPE_SCALER, &sInstanceBuf);
-
-        CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_query,
-            p_ctx->device_type, p_ctx->hw_id,
-            &(p_ctx->session_id), OPT_3);
-
-        if (retval == NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE)
-        {
-            if (query_retry >= 1000)
-            {
-                ni_log2(p_ctx, NI_LOG_DEBUG,  "Warning hwdesc read fail rc %d\n", retval);
-                LRETURN;
-            }
-        }
-        else if (retval != NI_RETCODE_SUCCESS)
-        {
-            LRETURN;
-        }
-        else
-        {
-            pFrameSurface = (niFrameSurface1_t *) p_frame->p_data[3];
-            pFrameSurface->ui16FrameIdx = sInstanceBuf.hw_inst_ind.frame_index;
-            pFrameSurface->ui16session_ID = p_ctx->session_id;
-            pFrameSurface->device_handle =
-                (int32_t)((int64_t)p_ctx->blk_io_handle & 0xFFFFFFFF);
-            pFrameSurface->src_cpu = (uint8_t) NI_DEVICE_TYPE_SCALER;
-            pFrameSurface->output_idx = 0;
-
-            /* A frame index of zero is invalid, the memory acquisition failed */
-            if (pFrameSurface->ui16FrameIdx == 0)
-            {
-                if (query_retry >= 1000)
-                {
-                    ni_log2(p_ctx, NI_LOG_ERROR, "Error: 2D could not acquire frame\n");
-                    retval = NI_RETCODE_FAILURE;
-                    LRETURN;
-                }
-                ni_usleep(100);
-                continue;
-            }
-
-            ni_log2(p_ctx, NI_LOG_DEBUG,
-                   "Session=0x%x: %s got FrameIndex=%u\n",
-                   p_ctx->session_id,
-                   __func__,
-                   pFrameSurface->ui16FrameIdx);
-
-            LRETURN;
-        }
-    }
-
-END:
+    retval = scaler_read_hwdesc_locked(p_ctx,
+                                       (niFrameSurface1_t *)p_frame->p_data[3]);
 
     ni_pthread_mutex_unlock(&p_ctx->mutex);
 
@@ -16537,8 +17194,16 @@ ni_retcode_t ni_get_memory_offset(ni_session_context_t *p_ctx, const niFrameSurf
 #endif
 
 /* AI functions */
-ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
-                                               void *nb_data, uint32_t nb_size)
+/*!*****************************************************************************
+ *  \brief  Configure the network binary of an AI session from a buffer that
+ *          is already page aligned, readable up to nb_size rounded up to
+ *          NI_MEM_PAGE_ALIGNMENT, and whose SHA-256 is already known. The
+ *          binary is only transferred if the device does not have it yet.
+ ******************************************************************************/
+ni_retcode_t ni_config_instance_network_binary_hashed(ni_session_context_t *p_ctx,
+                                                      void *nb_data,
+                                                      uint32_t nb_size,
+                                                      const uint8_t *nb_sha256)
 {
     void *p_ai_config = NULL;
     void *p_nb_data = NULL;
@@ -16562,11 +17227,13 @@ ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
         return NI_RETCODE_INVALID_PARAM;
     }
 
-    if (!nb_data || nb_size == 0) {
+    if (!nb_data || nb_size == 0 || !nb_sha256 ||
+        ((uintptr_t)nb_data & (NI_MEM_PAGE_ALIGNMENT - 1))) {
          ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() invalid nb_data %p nb_size %u\n",
                 __func__, nb_data, nb_size);
         return NI_RETCODE_INVALID_PARAM;
     }
+    p_nb_data = nb_data;
 
     ni_pthread_mutex_lock(&p_ctx->mutex);
 
@@ -16588,19 +17255,11 @@ ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
     }
 
     ((ni_ai_config_t *)p_ai_config)->ui32NetworkBinarySize = nb_size;
-    ni_calculate_sha256(nb_data, nb_size,
-                        ((ni_ai_config_t *)p_ai_config)->ui8Sha256);
+    memcpy(((ni_ai_config_t *)p_ai_config)->ui8Sha256, nb_sha256,
+           sizeof(((ni_ai_config_t *)p_ai_config)->ui8Sha256));
 
     buffer_size =
         (nb_size + (NI_MEM_PAGE_ALIGNMENT - 1)) & ~(NI_MEM_PAGE_ALIGNMENT - 1);
-    if (ni_posix_memalign(&p_nb_data, sysconf(_SC_PAGESIZE), buffer_size))
-    {
-        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot allocate encConf buffer.\n");
-        retval = NI_RETCODE_ERROR_MEM_ALOC;
-        LRETURN;
-    }
-
-    memcpy(p_nb_data, nb_data, nb_size);
 
     /* configure network binary size to be written */
     ui32LBA = CONFIG_INSTANCE_SetAiPara_W(p_ctx->session_id, NI_DEVICE_TYPE_AI);
@@ -16645,8 +17304,7 @@ ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
     {
         /* test if the model is already exist. if not, then continue to write binary data */
         memset(p_buffer, 0, dataLen);
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6J") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_NETWORK_LAYER_V2))
         {
             ui32LBA = QUERY_INSTANCE_NL_SIZE_V2_R(p_ctx->session_id,
                                                   NI_DEVICE_TYPE_AI);
@@ -16801,7 +17459,6 @@ END:
     ni_pthread_mutex_unlock(&p_ctx->mutex);
 
     ni_aligned_free(p_ai_config);
-    ni_aligned_free(p_nb_data);
     ni_aligned_free(p_buffer);
 
     ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
@@ -16809,6 +17466,38 @@ END:
     return retval;
 }
 
+ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
+                                               void *nb_data, uint32_t nb_size)
+{
+    void *p_nb_data = NULL;
+    uint8_t sha256[32];
+    uint32_t buffer_size;
+    ni_retcode_t retval;
+
+    if (!nb_data || nb_size == 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() invalid nb_data %p nb_size %u\n",
+               __func__, nb_data, nb_size);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    buffer_size =
+        (nb_size + (NI_MEM_PAGE_ALIGNMENT - 1)) & ~(NI_MEM_PAGE_ALIGNMENT - 1);
+    if (ni_posix_memalign(&p_nb_data, sysconf(_SC_PAGESIZE), buffer_size))
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: Cannot allocate encConf buffer.\n");
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    memcpy(p_nb_data, nb_data, nb_size);
+    memset((uint8_t *)p_nb_data + nb_size, 0, buffer_size - nb_size);
+
+    ni_calculate_sha256(nb_data, nb_size, sha256);
+    retval = ni_config_instance_network_binary_hashed(p_ctx, p_nb_data, nb_size,
+                                                      sha256);
+    ni_aligned_free(p_nb_data);
+    return retval;
+}
+
 ni_retcode_t ni_config_instance_hvsplus(ni_session_context_t *p_ctx)
 {
     void *p_stream_info = NULL;
@@ -17015,8 +17704,7 @@ ni_retcode_t ni_ai_session_write(ni_session_context_t *p_ctx,
             break;
         }
 
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6K") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC))
         {
             retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
                                                      &p_ctx->session_statistic);
@@ -17056,8 +17744,7 @@ ni_retcode_t ni_ai_session_write(ni_session_context_t *p_ctx,
         }
     }
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6s6")
-            < 0 || p_frame->iovec_num <= 1) {
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_AI_IOVEC) || p_frame->iovec_num <= 1) {
         void *p_data;
         if (p_frame->iovec_num == 1) {
             if (!p_frame->iovec) {
@@ -17091,8 +17778,7 @@ ni_retcode_t ni_ai_session_write(ni_session_context_t *p_ctx,
 
         retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
                 p_data, sent_size, ui32LBA);
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                    "6K") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC))
         {
             if (retval != NI_RETCODE_SUCCESS)
             {
@@ -17223,80 +17909,425 @@ ni_retcode_t ni_ai_session_write(ni_session_context_t *p_ctx,
                         iovec->ptr, iovec->size, p_ctx->frame_num,
                         ui32LBA);
 
-                sent_size = (iovec->size + NI_MEM_PAGE_ALIGNMENT - 1) &
-                    ~(NI_MEM_PAGE_ALIGNMENT - 1);
-                retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                        iovec->ptr, sent_size, ui32LBA);
-                if (retval != NI_RETCODE_SUCCESS) {
-                    ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
-                    LRETURN;
+                sent_size = (iovec->size + NI_MEM_PAGE_ALIGNMENT - 1) &
+                    ~(NI_MEM_PAGE_ALIGNMENT - 1);
+                retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
+                        iovec->ptr, sent_size, ui32LBA);
+                if (retval != NI_RETCODE_SUCCESS) {
+                    ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+                    LRETURN;
+                }
+                rel_lba = (((iovec->size + NI_MEM_PAGE_ALIGNMENT - 1) &
+                            ~(NI_MEM_PAGE_ALIGNMENT - 1)) >> LBA_BIT_OFFSET) + 1;
+            }
+#endif
+            iovec_index += iovec_batch;
+            iovec_left -= iovec_batch;
+        } while (iovec_left);
+
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC))
+        {
+            if (retval != NI_RETCODE_SUCCESS)
+            {
+                ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+                retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+                LRETURN;
+            }
+            retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
+                    &p_ctx->session_statistic);
+            CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                    nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                    p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+        } else
+        {
+            CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
+                    p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
+            if (retval < 0)
+            {
+                ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+                retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+                LRETURN;
+            }
+        }
+    }
+
+    p_ctx->frame_num++;
+
+    retval = frame_size_bytes;
+
+END:
+
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+
+    free(buffer_info);
+
+    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
+
+    return retval;
+}
+
+ni_retcode_t ni_ai_session_read(ni_session_context_t *p_ctx,
+                                ni_packet_t *p_packet)
+{
+    uint32_t actual_read_size = 0;
+    int retval = NI_RETCODE_SUCCESS;
+    uint32_t ui32LBA = 0;
+    ni_instance_buf_info_t buf_info = {0};
+
+    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): enter\n", __func__);
+
+    if (!p_ctx || !p_packet || !p_packet->p_data)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() passed parameters are null!, return\n",
+               __func__);
+        retval = NI_RETCODE_INVALID_PARAM;
+        return retval;
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+
+    if (NI_INVALID_SESSION_ID == p_ctx->session_id)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
+               __func__);
+        retval = NI_RETCODE_ERROR_INVALID_SESSION;
+        LRETURN;
+    }
+
+    for (;;)
+    {
+        if (p_ctx->session_statistic.ui32RdBufAvailSize >= p_packet->data_len)
+        {
+            buf_info.buf_avail_size =
+                p_ctx->session_statistic.ui32RdBufAvailSize;
+            ni_log2(p_ctx, NI_LOG_DEBUG,
+                   "Info ai read query success, available buf "
+                   "size %u >= frame size %u !\n",
+                   buf_info.buf_avail_size, p_packet->data_len);
+            break;
+        }
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC))
+        {
+            retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
+                                                     &p_ctx->session_statistic);
+            CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                          nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                          p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+            buf_info.buf_avail_size =
+                p_ctx->session_statistic.ui32RdBufAvailSize;
+        } else
+        {
+            retval = ni_query_instance_buf_info(p_ctx, INST_BUF_INFO_RW_READ,
+                                                NI_DEVICE_TYPE_AI, &buf_info);
+            CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_query,
+                         p_ctx->device_type, p_ctx->hw_id,
+                         &(p_ctx->session_id), OPT_1);
+        }
+        ni_log2(p_ctx, NI_LOG_TRACE,
+               "Info ai read query rc %d, available buf size %u, "
+               "frame_num=%" PRIu64 ", pkt_num=%" PRIu64 "\n",
+               retval, buf_info.buf_avail_size, p_ctx->frame_num,
+               p_ctx->pkt_num);
+
+        if (NI_RETCODE_SUCCESS != retval)
+        {
+            ni_log2(p_ctx, NI_LOG_DEBUG,  "Buffer info query failed in ai read!!!!\n");
+            LRETURN;
+        } else if (0 == buf_info.buf_avail_size)
+        {
+            ni_log2(p_ctx, NI_LOG_DEBUG,  "Info ai read available buf size %u, eos %u !\n",
+                           buf_info.buf_avail_size, p_packet->end_of_stream);
+            retval = NI_RETCODE_SUCCESS;
+            LRETURN;
+        }
+    }
+    ni_log2(p_ctx, NI_LOG_DEBUG,  "Ai read buf_avail_size %u\n", buf_info.buf_avail_size);
+
+    assert(buf_info.buf_avail_size >= p_packet->data_len);
+
+    ui32LBA = READ_INSTANCE_R(p_ctx->session_id, NI_DEVICE_TYPE_AI);
+    actual_read_size = p_packet->data_len;
+    if (actual_read_size & (NI_MEM_PAGE_ALIGNMENT - 1))
+    {
+        actual_read_size = (actual_read_size + (NI_MEM_PAGE_ALIGNMENT - 1)) &
+            ~(NI_MEM_PAGE_ALIGNMENT - 1);
+    }
+
+    retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
+                                   p_packet->p_data, actual_read_size, ui32LBA);
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC))
+    {
+        if (retval != NI_RETCODE_SUCCESS)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+            retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+            LRETURN;
+        }
+        retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
+                                                 &p_ctx->session_statistic);
+        CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                      nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                      p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+    } else
+    {
+        CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read, p_ctx->device_type,
+                     p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
+        if (retval < 0)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+            retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+            LRETURN;
+        }
+    }
+
+    retval = p_packet->data_len;
+
+END:
+
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+
+    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
+
+    return retval;
+}
+
+/*!*****************************************************************************
+ *  \brief  Send a batch of input tensors to an AI session
+ *
+ *          The write buffer is queried once for as many frames as it can
+ *          hold, those frames are written back to back and the session
+ *          statistics are refreshed once per run instead of once per frame.
+ *          This saves the per-frame buffer queries and mutex round trips
+ *          only: the firmware takes one tensor per write to the instance
+ *          LBA, so every frame is still its own NVMe write. Multi-segment
+ *          iovec frames are not accepted since their segments are
+ *          configured through the instance config LBA one frame at a time.
+ *
+ *  \return number of frames written, fewer than num when the device write
+ *          buffer stayed full, or negative ni_retcode_t on error
+ ******************************************************************************/
+int ni_ai_session_batch_write(ni_session_context_t *p_ctx,
+                              ni_frame_t *p_frames[], int num)
+{
+    int retval = NI_RETCODE_SUCCESS;
+    ni_instance_buf_info_t buf_info = {0};
+    uint32_t frame_size_bytes;
+    uint32_t sent_size;
+    uint32_t ui32LBA;
+    int32_t query_retry = 0;
+    int written = 0;
+    int is_6k;
+    int i;
+
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): enter\n", __func__);
+
+    if (!p_ctx || !p_frames || num <= 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s(): passed parameters is null\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        if (!p_frames[i] || p_frames[i]->data_len[0] == 0 ||
+            p_frames[i]->iovec_num > 1)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR: %s() invalid frame %d in batch\n", __func__, i);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+        if (p_frames[i]->iovec_num == 1 &&
+            (!p_frames[i]->iovec || !p_frames[i]->iovec[0].ptr ||
+             ((int64_t)p_frames[i]->iovec[0].ptr &
+              (NI_MEM_PAGE_ALIGNMENT - 1))))
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR: %s() invalid iovec of frame %d in batch\n",
+                   __func__, i);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+
+    if (NI_INVALID_SESSION_ID == p_ctx->session_id)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
+               __func__);
+        retval = NI_RETCODE_ERROR_INVALID_SESSION;
+        LRETURN;
+    }
+
+    is_6k = (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC));
+    buf_info.buf_avail_size = p_ctx->session_statistic.ui32WrBufAvailSize;
+
+    while (written < num)
+    {
+        frame_size_bytes = p_frames[written]->data_len[0];
+
+        if (buf_info.buf_avail_size < frame_size_bytes)
+        {
+            if (is_6k)
+            {
+                retval = ni_query_session_statistic_info(
+                    p_ctx, NI_DEVICE_TYPE_AI, &p_ctx->session_statistic);
+                CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                             nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                             p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+                buf_info.buf_avail_size =
+                    p_ctx->session_statistic.ui32WrBufAvailSize;
+            } else
+            {
+                retval = ni_query_instance_buf_info(
+                    p_ctx, INST_BUF_INFO_RW_WRITE, NI_DEVICE_TYPE_AI, &buf_info);
+                CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_query,
+                             p_ctx->device_type, p_ctx->hw_id,
+                             &(p_ctx->session_id), OPT_1);
+            }
+
+            if (NI_RETCODE_SUCCESS != retval ||
+                buf_info.buf_avail_size < frame_size_bytes)
+            {
+                ni_log2(p_ctx, NI_LOG_TRACE,
+                       "AI batch write query failed or buf_size < frame_size. "
+                       "Retry %d\n", query_retry);
+                if (query_retry >= NI_MAX_ENCODER_QUERY_RETRIES)
+                {
+                    ni_log2(p_ctx, NI_LOG_DEBUG,
+                           "AI batch write query exceeded max retries: %d, "
+                           "%d of %d frames written\n",
+                           NI_MAX_ENCODER_QUERY_RETRIES, written, num);
+                    p_ctx->status = NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL;
+                    retval = NI_RETCODE_SUCCESS;
+                    break;
                 }
-                rel_lba = (((iovec->size + NI_MEM_PAGE_ALIGNMENT - 1) &
-                            ~(NI_MEM_PAGE_ALIGNMENT - 1)) >> LBA_BIT_OFFSET) + 1;
+                buf_info.buf_avail_size = 0;
+                ni_pthread_mutex_unlock(&p_ctx->mutex);
+                ni_usleep(NI_RETRY_INTERVAL_100US);
+                ni_pthread_mutex_lock(&p_ctx->mutex);
+                query_retry++;
+                continue;
             }
-#endif
-            iovec_index += iovec_batch;
-            iovec_left -= iovec_batch;
-        } while (iovec_left);
+        }
+        query_retry = 0;
 
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                    "6K") >= 0)
+        // write every frame the queried buffer space can take
+        while (written < num &&
+               buf_info.buf_avail_size >= p_frames[written]->data_len[0])
         {
+            ni_frame_t *p_frame = p_frames[written];
+            void *p_data = (p_frame->iovec_num == 1) ? p_frame->iovec[0].ptr :
+                                                       p_frame->p_buffer;
+
+            frame_size_bytes = p_frame->data_len[0];
+            sent_size = (frame_size_bytes + NI_MEM_PAGE_ALIGNMENT - 1) &
+                ~(NI_MEM_PAGE_ALIGNMENT - 1);
+            ui32LBA = WRITE_INSTANCE_W(p_ctx->session_id, NI_DEVICE_TYPE_AI);
+            ni_log2(p_ctx, NI_LOG_DEBUG,
+                   "Ai batch write: p_data = %p, size = %u, "
+                   "p_ctx->frame_num = %" PRIu64 ", LBA = 0x%x\n",
+                   p_data, frame_size_bytes, p_ctx->frame_num, ui32LBA);
+
+            retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle,
+                                            p_ctx->event_handle, p_data,
+                                            sent_size, ui32LBA);
+            if (!is_6k)
+            {
+                CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write,
+                             p_ctx->device_type, p_ctx->hw_id,
+                             &(p_ctx->session_id), OPT_1);
+            }
             if (retval != NI_RETCODE_SUCCESS)
             {
-                ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+                ni_log2(p_ctx, NI_LOG_ERROR,
+                       "ERROR %s(): nvme command failed, frame %d\n", __func__,
+                       written);
                 retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
                 LRETURN;
             }
+
+            buf_info.buf_avail_size -= frame_size_bytes;
+            p_ctx->frame_num++;
+            written++;
+        }
+
+        if (is_6k)
+        {
             retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
-                    &p_ctx->session_statistic);
+                                                     &p_ctx->session_statistic);
             CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
-                    nvme_admin_cmd_xcoder_query, p_ctx->device_type,
-                    p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
-        } else
-        {
-            CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_write, p_ctx->device_type,
-                    p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-            if (retval < 0)
-            {
-                ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
-                retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-                LRETURN;
-            }
+                         nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                         p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+            buf_info.buf_avail_size =
+                p_ctx->session_statistic.ui32WrBufAvailSize;
         }
     }
 
-    p_ctx->frame_num++;
-
-    retval = frame_size_bytes;
+    retval = written;
 
 END:
 
     ni_pthread_mutex_unlock(&p_ctx->mutex);
 
-    free(buffer_info);
-
-    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): exit, %d of %d frames written\n",
+           __func__, written, num);
 
     return retval;
 }
 
-ni_retcode_t ni_ai_session_read(ni_session_context_t *p_ctx,
-                                ni_packet_t *p_packet)
+/*!*****************************************************************************
+ *  \brief  Send a batch of hw frames as inputs of an AI session
+ *
+ *          Same as num calls of ni_ai_alloc_hwframe() with options 0 and
+ *          pool size 0, but the write buffer is checked once and, on 6K+
+ *          firmware, the completion of the frame configs is checked with a
+ *          single statistics query after the last one instead of a session
+ *          stats query after each. ui8MultiIn of the frame config describes
+ *          the inputs of one multi-input network, not several inferences, so
+ *          every frame still takes its own config write.
+ *
+ *  \return number of frames sent, 0 when the device write buffer stayed
+ *          full, or negative ni_retcode_t on error
+ ******************************************************************************/
+int ni_ai_session_batch_write_hwframe(ni_session_context_t *p_ctx,
+                                      niFrameSurface1_t *p_surfaces[], int num)
 {
-    uint32_t actual_read_size = 0;
     int retval = NI_RETCODE_SUCCESS;
-    uint32_t ui32LBA = 0;
-    ni_instance_buf_info_t buf_info = {0};
+    ni_network_buffer_info_t *p_data = NULL;
+    uint32_t dataLen;
+    uint32_t ui32LBA;
+    int32_t query_retry = 0;
+    int written = 0;
+    int is_6k;
+    int i;
 
-    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): enter\n", __func__);
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): enter\n", __func__);
 
-    if (!p_ctx || !p_packet || !p_packet->p_data)
+    if (!p_ctx || !p_surfaces || num <= 0)
     {
-        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s() passed parameters are null!, return\n",
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR: %s(): passed parameters is null\n",
                __func__);
-        retval = NI_RETCODE_INVALID_PARAM;
-        return retval;
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        if (!p_surfaces[i])
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR: %s() invalid surface %d in batch\n", __func__, i);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+    }
+
+    dataLen = (sizeof(ni_network_buffer_info_t) + NI_MEM_PAGE_ALIGNMENT - 1) &
+        ~(NI_MEM_PAGE_ALIGNMENT - 1);
+    if (ni_posix_memalign((void **)&p_data, sysconf(_SC_PAGESIZE), dataLen))
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %d: %s() Cannot allocate buffer\n",
+               NI_ERRNO, __func__);
+        return NI_RETCODE_ERROR_MEM_ALOC;
     }
 
     ni_pthread_mutex_lock(&p_ctx->mutex);
@@ -17309,26 +18340,152 @@ ni_retcode_t ni_ai_session_read(ni_session_context_t *p_ctx,
         LRETURN;
     }
 
-    for (;;)
+    is_6k = ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC);
+
+    while (p_ctx->session_statistic.ui32WrBufAvailSize == 0)
     {
-        if (p_ctx->session_statistic.ui32RdBufAvailSize >= p_packet->data_len)
+        retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
+                                                 &p_ctx->session_statistic);
+        CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                     nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                     p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+        if (p_ctx->session_statistic.ui32WrBufAvailSize > 0)
         {
-            buf_info.buf_avail_size =
-                p_ctx->session_statistic.ui32RdBufAvailSize;
-            ni_log2(p_ctx, NI_LOG_DEBUG,
-                   "Info ai read query success, available buf "
-                   "size %u >= frame size %u !\n",
-                   buf_info.buf_avail_size, p_packet->data_len);
             break;
         }
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6K") >= 0)
+        ni_log2(p_ctx, NI_LOG_TRACE,
+               "AI hwframe batch write query buf_size 0. Retry %d\n",
+               query_retry);
+        if (query_retry >= NI_MAX_ENCODER_QUERY_RETRIES)
+        {
+            ni_log2(p_ctx, NI_LOG_TRACE,
+                   "AI hwframe batch write query exceeded max retries: %d\n",
+                   NI_MAX_ENCODER_QUERY_RETRIES);
+            p_ctx->status = NI_RETCODE_NVME_SC_WRITE_BUFFER_FULL;
+            retval = NI_RETCODE_SUCCESS;
+            LRETURN;
+        }
+        ni_pthread_mutex_unlock(&p_ctx->mutex);
+        ni_usleep(NI_RETRY_INTERVAL_100US);
+        ni_pthread_mutex_lock(&p_ctx->mutex);
+        query_retry++;
+    }
+
+    ui32LBA = CONFIG_INSTANCE_SetAiFrm_W(p_ctx->session_id, NI_DEVICE_TYPE_AI);
+    for (written = 0; written < num; written++)
+    {
+        memset(p_data, 0x00, dataLen);
+        p_data->ui16FrameIdx[0] = p_surfaces[written]->ui16FrameIdx;
+        p_data->ui16Width = p_surfaces[written]->ui16width;
+        p_data->ui16Height = p_surfaces[written]->ui16height;
+        ni_log2(p_ctx, NI_LOG_DEBUG, "Ai hwframe batch write: frame_index %u\n",
+               p_data->ui16FrameIdx[0]);
+
+        retval = ni_nvme_send_write_cmd(p_ctx->blk_io_handle,
+                                        p_ctx->event_handle, p_data, dataLen,
+                                        ui32LBA);
+        if (!is_6k)
+        {
+            CHECK_ERR_RC(p_ctx, retval, 0, nvme_admin_cmd_xcoder_config,
+                         p_ctx->device_type, p_ctx->hw_id,
+                         &(p_ctx->session_id), OPT_1);
+        }
+        if (NI_RETCODE_SUCCESS != retval)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR %s(): nvme command failed, frame %d\n", __func__,
+                   written);
+            retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+            LRETURN;
+        }
+    }
+
+    if (is_6k)
+    {
+        retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
+                                                 &p_ctx->session_statistic);
+        CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
+                     nvme_admin_cmd_xcoder_config, p_ctx->device_type,
+                     p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+    }
+
+    retval = written;
+
+END:
+
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+    ni_aligned_free(p_data);
+
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): exit, %d of %d frames written\n",
+           __func__, written, num);
+
+    return retval;
+}
+
+/*!*****************************************************************************
+ *  \brief  Read a batch of inference outputs from an AI session
+ *
+ *          The read buffer is queried once and every output already
+ *          available is read back to back, followed by a single statistics
+ *          refresh. Every packet must have p_data allocated and data_len set
+ *          to the output size, as for ni_ai_session_read().
+ *
+ *  \return number of outputs read (0 if none is ready yet), or negative
+ *          ni_retcode_t on error
+ ******************************************************************************/
+int ni_ai_session_batch_read(ni_session_context_t *p_ctx,
+                             ni_packet_t *p_packets[], int num)
+{
+    int retval = NI_RETCODE_SUCCESS;
+    ni_instance_buf_info_t buf_info = {0};
+    uint32_t actual_read_size;
+    uint32_t ui32LBA;
+    int nb_read = 0;
+    int is_6k;
+    int i;
+
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): enter\n", __func__);
+
+    if (!p_ctx || !p_packets || num <= 0)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR,
+               "ERROR: %s() passed parameters are null!, return\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < num; i++)
+    {
+        if (!p_packets[i] || !p_packets[i]->p_data ||
+            p_packets[i]->data_len == 0)
+        {
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR: %s() invalid packet %d in batch\n", __func__, i);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+
+    if (NI_INVALID_SESSION_ID == p_ctx->session_id)
+    {
+        ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): Invalid session ID, return.\n",
+               __func__);
+        retval = NI_RETCODE_ERROR_INVALID_SESSION;
+        LRETURN;
+    }
+
+    is_6k = (ni_fw_api_supports(p_ctx, NI_FW_API_AI_SESSION_STATISTIC));
+    buf_info.buf_avail_size = p_ctx->session_statistic.ui32RdBufAvailSize;
+
+    if (buf_info.buf_avail_size < p_packets[0]->data_len)
+    {
+        if (is_6k)
         {
             retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
                                                      &p_ctx->session_statistic);
             CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
-                          nvme_admin_cmd_xcoder_query, p_ctx->device_type,
-                          p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
+                         nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                         p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
             buf_info.buf_avail_size =
                 p_ctx->session_statistic.ui32RdBufAvailSize;
         } else
@@ -17339,71 +18496,64 @@ ni_retcode_t ni_ai_session_read(ni_session_context_t *p_ctx,
                          p_ctx->device_type, p_ctx->hw_id,
                          &(p_ctx->session_id), OPT_1);
         }
-        ni_log2(p_ctx, NI_LOG_TRACE,
-               "Info ai read query rc %d, available buf size %u, "
-               "frame_num=%" PRIu64 ", pkt_num=%" PRIu64 "\n",
-               retval, buf_info.buf_avail_size, p_ctx->frame_num,
-               p_ctx->pkt_num);
-
         if (NI_RETCODE_SUCCESS != retval)
         {
-            ni_log2(p_ctx, NI_LOG_DEBUG,  "Buffer info query failed in ai read!!!!\n");
-            LRETURN;
-        } else if (0 == buf_info.buf_avail_size)
-        {
-            ni_log2(p_ctx, NI_LOG_DEBUG,  "Info ai read available buf size %u, eos %u !\n",
-                           buf_info.buf_avail_size, p_packet->end_of_stream);
-            retval = NI_RETCODE_SUCCESS;
+            ni_log2(p_ctx, NI_LOG_DEBUG,
+                   "Buffer info query failed in ai batch read!\n");
             LRETURN;
         }
     }
-    ni_log2(p_ctx, NI_LOG_DEBUG,  "Ai read buf_avail_size %u\n", buf_info.buf_avail_size);
-
-    assert(buf_info.buf_avail_size >= p_packet->data_len);
+    ni_log2(p_ctx, NI_LOG_DEBUG, "Ai batch read buf_avail_size %u\n",
+           buf_info.buf_avail_size);
 
-    ui32LBA = READ_INSTANCE_R(p_ctx->session_id, NI_DEVICE_TYPE_AI);
-    actual_read_size = p_packet->data_len;
-    if (actual_read_size & (NI_MEM_PAGE_ALIGNMENT - 1))
+    while (nb_read < num &&
+           buf_info.buf_avail_size >= p_packets[nb_read]->data_len)
     {
-        actual_read_size = (actual_read_size + (NI_MEM_PAGE_ALIGNMENT - 1)) &
+        ni_packet_t *p_packet = p_packets[nb_read];
+
+        ui32LBA = READ_INSTANCE_R(p_ctx->session_id, NI_DEVICE_TYPE_AI);
+        actual_read_size = (p_packet->data_len + NI_MEM_PAGE_ALIGNMENT - 1) &
             ~(NI_MEM_PAGE_ALIGNMENT - 1);
-    }
 
-    retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle, p_ctx->event_handle,
-                                   p_packet->p_data, actual_read_size, ui32LBA);
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6K") >= 0)
-    {
+        retval = ni_nvme_send_read_cmd(p_ctx->blk_io_handle,
+                                       p_ctx->event_handle, p_packet->p_data,
+                                       actual_read_size, ui32LBA);
+        if (!is_6k)
+        {
+            CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read,
+                         p_ctx->device_type, p_ctx->hw_id,
+                         &(p_ctx->session_id), OPT_1);
+        }
         if (retval != NI_RETCODE_SUCCESS)
         {
-            ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
+            ni_log2(p_ctx, NI_LOG_ERROR,
+                   "ERROR %s(): nvme command failed, output %d\n", __func__,
+                   nb_read);
             retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
             LRETURN;
         }
+
+        buf_info.buf_avail_size -= p_packet->data_len;
+        nb_read++;
+    }
+
+    if (is_6k && nb_read)
+    {
         retval = ni_query_session_statistic_info(p_ctx, NI_DEVICE_TYPE_AI,
                                                  &p_ctx->session_statistic);
         CHECK_ERR_RC(p_ctx, retval, &p_ctx->session_statistic,
-                      nvme_admin_cmd_xcoder_query, p_ctx->device_type,
-                      p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
-    } else
-    {
-        CHECK_ERR_RC(p_ctx, retval, 0, nvme_cmd_xcoder_read, p_ctx->device_type,
-                     p_ctx->hw_id, &(p_ctx->session_id), OPT_1);
-        if (retval < 0)
-        {
-            ni_log2(p_ctx, NI_LOG_ERROR, "ERROR %s(): nvme command failed\n", __func__);
-            retval = NI_RETCODE_ERROR_NVME_CMD_FAILED;
-            LRETURN;
-        }
+                     nvme_admin_cmd_xcoder_query, p_ctx->device_type,
+                     p_ctx->hw_id, &(p_ctx->session_id), OPT_2);
     }
 
-    retval = p_packet->data_len;
+    retval = nb_read;
 
 END:
 
     ni_pthread_mutex_unlock(&p_ctx->mutex);
 
-    ni_log2(p_ctx, NI_LOG_TRACE,  "%s(): exit\n", __func__);
+    ni_log2(p_ctx, NI_LOG_TRACE, "%s(): exit, %d of %d outputs read\n",
+           __func__, nb_read, num);
 
     return retval;
 }
@@ -17477,8 +18627,7 @@ ni_retcode_t ni_config_read_inout_layers(ni_session_context_t *p_ctx,
 
     for (;;)
     {
-        if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                              "6J") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_NETWORK_LAYER_V2))
         {
             ui32LBA = QUERY_INSTANCE_NL_SIZE_V2_R(p_ctx->session_id,
                                                   NI_DEVICE_TYPE_AI);
@@ -17524,8 +18673,7 @@ ni_retcode_t ni_config_read_inout_layers(ni_session_context_t *p_ctx,
         LRETURN;
     }
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6J") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_NETWORK_LAYER_V2))
     {
         network_data->input_num =
             ((ni_instance_buf_info_t *)p_buffer)->buf_avail_size >> 16;
@@ -17562,8 +18710,7 @@ ni_retcode_t ni_config_read_inout_layers(ni_session_context_t *p_ctx,
     }
     network_data->outset = network_data->inset + network_data->input_num;
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6J") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_NETWORK_LAYER_V2))
     {
         /* query the real network layer data */
         this_size = sizeof(ni_network_layer_params_t) * total_io_num;
@@ -18147,9 +19294,7 @@ ni_retcode_t ni_ai_alloc_dst_frame(ni_session_context_t *p_ctx,
         return NI_RETCODE_ERROR_INVALID_SESSION;
     }
 
-    if (ni_cmp_fw_api_ver(
-          (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-          "6rL") < 0)
+    if (!ni_fw_api_supports(p_ctx, NI_FW_API_CLONE_HWFRAME))
     {
         ni_log2(p_ctx, NI_LOG_ERROR,
                 "Error: %s function not supported on device with FW API version < 6rL\n",
@@ -18561,16 +19706,12 @@ ni_retcode_t ni_device_get_ddr_configuration(ni_session_context_t *p_ctx)
     }
     else
     {
-        if (ni_cmp_fw_api_ver(
-            (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6rJ") >= 0)
+        if (ni_fw_api_supports(p_ctx, NI_FW_API_DDR_CONFIG_6RJ))
         {
             p_ctx->ddr_config = (p_id_data->memory_cfg == NI_QUADRA_MEMORY_CONFIG_SR)
                 ? 3 : ((p_id_data->memory_cfg == NI_QUADRA_MEMORY_CONFIG_DR)? 4 : 5);
         }
-        else if (ni_cmp_fw_api_ver(
-            (char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-            "6rD") >= 0)
+        else if (ni_fw_api_supports(p_ctx, NI_FW_API_DDR_CONFIG_6RD))
         {
             p_ctx->ddr_config = (p_id_data->memory_cfg == NI_QUADRA_MEMORY_CONFIG_SR)
                 ? 3 : 4;
@@ -18821,8 +19962,7 @@ ni_retcode_t ni_ai_session_query_metrics(ni_session_context_t *p_ctx,
         LRETURN;
     }
 
-    if (ni_cmp_fw_api_ver((char*) &p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
-                          "6N") >= 0)
+    if (ni_fw_api_supports(p_ctx, NI_FW_API_AI_PERF_METRICS))
     {
         dataLen =
             (sizeof(ni_network_perf_metrics_t) + (NI_MEM_PAGE_ALIGNMENT - 1)) &
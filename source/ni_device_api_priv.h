@@ -37,6 +37,96 @@ extern "C"
 #include "ni_defs.h"
 #include "ni_rsrc_api.h"
 
+/*!*****************************************************************************
+ *  Firmware features gated on the FW API revision of the device, each with
+ *  the oldest FW API revision (as compared by ni_cmp_fw_api_ver()) that
+ *  supports it. A session evaluates the table once when its fw_rev is set;
+ *  test a feature with ni_fw_api_supports().
+ ******************************************************************************/
+#define NI_FW_API_FEATURES(X)                                                                 \
+    X(SEQ_CHANGE_RESTART,      "54")  /* sequence change, session restart */                  \
+    X(SW_VERSION_SSIM,         "62")  /* SW version sent at open, SSIM in encoder metadata */ \
+    X(STACK_FILTER,            "64")  /* stack filter */                                      \
+    X(SESSION_STATISTIC,       "65")  /* session statistic query, buffer info by EP */        \
+    X(DEC_WRITE_LEN,           "66")  /* decoder write length config */                       \
+    X(ROTATE_FILTER,           "67")  /* rotate filter */                                     \
+    X(TILED4X4_INPUT,          "68")  /* tiled 4x4 encoder input */                           \
+    X(AI_NETWORK_LAYER_V2,     "6J")  /* AI network layer query v2 */                         \
+    X(AI_SESSION_STATISTIC,    "6K")  /* AI session statistic query */                        \
+    X(INPLACE_OVERLAY,         "6L")  /* in-place overlay filter */                           \
+    X(AI_PERF_METRICS,         "6N")  /* AI performance metrics */                            \
+    X(NVME_STATUS,             "6O")  /* NVMe status query */                                 \
+    X(ENC_ZEROCOPY,            "6Q")  /* encoder zero copy, separate frame metadata */        \
+    X(UPLOADER_ZEROCOPY,       "6S")  /* uploader zero copy, separate metadata */             \
+    X(CRF_ANY_LOOKAHEAD,       "6X")  /* CRF with any lookahead depth */                      \
+    X(RGBA_INPUT,              "6Y")  /* RGBA / BGRA encoder input */                         \
+    X(DDR_PRIORITY,            "6e")  /* ddr_priority_mode */                                 \
+    X(VF_NS_ID,                "6m")  /* VF / namespace id query */                           \
+    X(ENC_META_6P,             "6p")  /* encoder bitstream metadata of 6p */                  \
+    X(SEMIPLANAR_ZEROCOPY,     "6q")  /* semi-planar zero copy */                             \
+    X(ADAPTIVE_GOP_SIZE,       "6r2") /* gop size in encoder metadata */                      \
+    X(LOW_DELAY_FRAMEPOOL,     "6r3") /* forceLowDelay, framepool update */                   \
+    X(HWDL_SESSION_MUTEX,      "6r8") /* hwdownload on its own session mutex */               \
+    X(MAX_EXTRA_HW_FRAME,      "6rB") /* maxExtraHwFrameCnt */                                \
+    X(DDR_CONFIG_6RD,          "6rD") /* DDR configuration query */                           \
+    X(DEC_FIRST_METADATA,      "6rE") /* decoder frame metadata read first */                 \
+    X(DDR_CONFIG_6RJ,          "6rJ") /* DDR configuration with 5 configs */                  \
+    X(CLONE_HWFRAME,           "6rL") /* hwframe clone, AI destination frame */               \
+    X(ADVANCED_EC_2,           "6rO") /* enableAdvancedEc 2 */                                \
+    X(DEC_LOAD_BALANCE,        "6rT") /* decoder load balancing params */                     \
+    X(ENC_ADDITIONAL_DELAY,    "6rX") /* FW estimated additional frame delay */               \
+    X(ENC_META_6RC,            "6rc") /* encoder bitstream metadata of 6rc, PSNR */           \
+    X(HWDL_BY_FRAME_IDX,       "6rd") /* hwdownload by frame index */                         \
+    X(P2P,                     "6re") /* P2P send / receive */                                \
+    X(UPLOADER_MODEL_LOAD,     "6rf") /* uploader modelled load */                            \
+    X(DEC_COMPLETE_INFO,       "6rg") /* decoder completion info at close */                  \
+    X(ROI_QP_MAP_EXT,          "6rh") /* extended ROI QP offset map */                        \
+    X(EC_LIMITED_ERROR,        "6ri") /* EcPolicy limited_error, ecErrThreshold */            \
+    X(SURVIVE_STREAM_ERR,      "6rl") /* surviveStreamErr */                                  \
+    X(STILL_IMAGE_DETECT,      "6rm") /* still image / scene change detection */              \
+    X(HVSPLUS,                 "6ro") /* hvsplus filter */                                    \
+    X(REDUCE_DPB_DELAY,        "6rs") /* reduceDpbDelay */                                    \
+    X(QUERY_BUFFER_AVAIL,      "6rt") /* buffer availability query */                         \
+    X(COMPENSATE_QP,           "6ru") /* enableCompensateQp */                                \
+    X(SPATIAL_LAYERS,          "6rw") /* spatialLayers */                                     \
+    X(PPU_RECONFIG,            "6rx") /* PPU output reconfig */                               \
+    X(SPATIAL_LAYERS_REF_BASE, "6s0") /* spatialLayersRefBaseLayer */                         \
+    X(EC_BEST_EFFORT_OUT_DC,   "6s1") /* EcPolicy best_effort_out_dc */                       \
+    X(SCALER_PARAMS_BC,        "6s2") /* scaler params B and C */                             \
+    X(AI_IOVEC,                "6s6") /* AI frame write from iovec */                         \
+    X(PASS1_COST,              "6sC") /* pass-1 cost in encoder metadata */                   \
+    X(MULTICORE_LAYER_BITRATE, "6sD") /* spatialLayerBitrate in multicoreJointMode */         \
+    X(DEC_PPU_RECONFIG,        "6sF") /* decoder PPU params reconfig */                       \
+    X(AI_ALIGN_FILTER,         "6sI") /* ai align filter */                                   \
+    X(FILTERBLIT_5,            "6sL") /* filterblit 5 */                                      \
+    X(ENC_META_6SM,            "6sM") /* encoder bitstream metadata of 6sM */                 \
+    X(DEC_FRAME_DROPPED,       "6sP") /* decoder dropped frame count */
+
+typedef enum _ni_fw_api_feature
+{
+    NI_FW_API_FLAGS_VALID = 0,  // fw_api_flags evaluated from fw_rev
+#define NI_FW_API_FEATURE_ENUM(name, ver) NI_FW_API_##name,
+    NI_FW_API_FEATURES(NI_FW_API_FEATURE_ENUM)
+#undef NI_FW_API_FEATURE_ENUM
+    NI_FW_API_FEATURE_NUM
+} ni_fw_api_feature_t;
+
+void ni_fw_api_update_flags(ni_session_context_t *p_ctx);
+int ni_fw_api_supports_slow(const ni_session_context_t *p_ctx,
+                            ni_fw_api_feature_t feature);
+
+// 1 if the firmware of the session supports the feature, 0 otherwise
+static inline int ni_fw_api_supports(const ni_session_context_t *p_ctx,
+                                     ni_fw_api_feature_t feature)
+{
+    // contexts whose fw_rev was filled in by the caller fall back to compare
+    if (p_ctx->fw_api_flags[0] & 1)
+    {
+        return (int)((p_ctx->fw_api_flags[feature >> 6] >> (feature & 63)) & 1);
+    }
+    return ni_fw_api_supports_slow(p_ctx, feature);
+}
+
 typedef enum
 {
   SESSION_READ_CONFIG = 0,
@@ -1115,12 +1205,16 @@ ni_retcode_t ni_decoder_session_flush(ni_session_context_t *p_ctx);
 
 int ni_decoder_session_write(ni_session_context_t *p_ctx, ni_packet_t *p_packet);
 int ni_decoder_session_read(ni_session_context_t *p_ctx, ni_frame_t *p_frame);
+int ni_decoder_session_read_batch(ni_session_context_t *p_ctx,
+                                  ni_session_data_io_t *p_data, int nb_data);
 
 ni_retcode_t ni_encoder_session_open(ni_session_context_t *p_ctx);
 ni_retcode_t ni_encoder_session_close(ni_session_context_t *p_ctx, int eos_recieved);
 ni_retcode_t ni_encoder_session_send_eos(ni_session_context_t *p_ctx);
 int ni_encoder_session_write(ni_session_context_t *p_ctx, ni_frame_t *p_frame);
 int ni_encoder_session_read(ni_session_context_t *p_ctx, ni_packet_t *p_packet);
+int ni_encoder_session_read_batch(ni_session_context_t *p_ctx,
+                                  ni_session_data_io_t *p_data, int nb_data);
 ni_retcode_t ni_encoder_session_sequence_change(ni_session_context_t *p_ctx, ni_resolution_t *p_resoluion);
 //int ni_encoder_session_reconfig(ni_session_context_t *p_ctx, ni_session_config_t *p_config, ni_param_change_flags_t change_flags);
 
@@ -1364,6 +1458,16 @@ ni_retcode_t ni_scaler_multi_config_frame(ni_session_context_t *p_ctx,
                                           int numInCfgs,
                                           ni_frame_config_t *p_cfg_out);
 
+ni_retcode_t ni_scaler_batch_job_set(ni_session_context_t *p_ctx,
+                                     ni_scaler_batch_job_t *p_job,
+                                     ni_frame_config_t p_cfg_in[],
+                                     int numInCfgs,
+                                     ni_frame_config_t *p_cfg_out);
+
+int ni_scaler_batch_config_frames(ni_session_context_t *p_ctx,
+                                  ni_scaler_batch_t *p_batch,
+                                  niFrameSurface1_t p_out_surface[]);
+
 /*!******************************************************************************
  *  \brief  Open a xcoder scaler instance
  *
@@ -1486,12 +1590,22 @@ ni_retcode_t ni_ai_session_open(ni_session_context_t *p_ctx);
 ni_retcode_t ni_ai_session_close(ni_session_context_t *p_ctx, int eos_received);
 ni_retcode_t ni_config_instance_network_binary(ni_session_context_t *p_ctx,
                                                void *nb_data, uint32_t nb_size);
+ni_retcode_t ni_config_instance_network_binary_hashed(ni_session_context_t *p_ctx,
+                                                      void *nb_data,
+                                                      uint32_t nb_size,
+                                                      const uint8_t *nb_sha256);
 ni_retcode_t ni_config_instance_hvsplus(ni_session_context_t *p_ctx);
 ni_retcode_t ni_ai_query_network_ready(ni_session_context_t *p_ctx);
 ni_retcode_t ni_ai_session_write(ni_session_context_t *p_ctx,
                                  ni_frame_t *p_frame);
 ni_retcode_t ni_ai_session_read(ni_session_context_t *p_ctx,
                                 ni_packet_t *p_packet);
+int ni_ai_session_batch_write(ni_session_context_t *p_ctx,
+                              ni_frame_t *p_frames[], int num);
+int ni_ai_session_batch_read(ni_session_context_t *p_ctx,
+                             ni_packet_t *p_packets[], int num);
+int ni_ai_session_batch_write_hwframe(ni_session_context_t *p_ctx,
+                                      niFrameSurface1_t *p_surfaces[], int num);
 ni_retcode_t ni_config_read_inout_layers(ni_session_context_t *p_ctx,
                                          ni_network_data_t *p_network);
 ni_retcode_t ni_ai_alloc_hwframe(ni_session_context_t *p_ctx, int width,
@@ -1564,6 +1678,23 @@ ni_retcode_t ni_config_instance_set_decoder_ppu_params(ni_session_context_t* p_c
  *******************************************************************************/
 ni_retcode_t ni_set_cpu_affinity(ni_session_context_t *p_ctx);
 
+// page aligned packet and frame buffers and their cache, see ni_util.c
+int ni_frame_memalign(void **memptr, size_t size);
+void *ni_mem_cache_get(size_t *p_size);
+void ni_mem_cache_put(void *p_buf, size_t size);
+int ni_mem_cache_prewarm(size_t size, int count);
+void ni_mem_cache_expire(void);
+
+// reference counting of ni_packet_arena_t slots, see ni_device_api.c
+void ni_packet_arena_slot_ref(ni_packet_arena_t *p_arena, int slot);
+void ni_packet_arena_slot_unref(ni_packet_arena_t *p_arena, int slot);
+
+// placement of a session's threads on its card's CPUs, see ni_device_api.c
+void ni_session_cpu_placement_init(ni_session_context_t *p_ctx);
+
+// copy of the entries in use of a custom SEI set, see ni_device_api_priv.c
+ni_custom_sei_set_t *ni_custom_sei_set_dup(const ni_custom_sei_set_t *p_src);
+
 #ifdef __cplusplus
 }
 #endif
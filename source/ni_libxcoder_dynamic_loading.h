@@ -129,6 +129,12 @@ typedef int (LIB_API* PNIPTHREADCONDTIMEDWAIT) (ni_pthread_cond_t *cond, ni_pthr
 typedef int (LIB_API* PNIPTHREADSIGMASK) (int how, const ni_sigset_t *set, ni_sigset_t *oldset);
 typedef int (LIB_API* PNIPOSIXMEMALIGN) (void **memptr, size_t alignment, size_t size);
 typedef const char * (LIB_API* PNIAIERRNOTOSTR) (int rc);
+typedef ni_retcode_t (LIB_API* PNINETWORKWRITETENSORFILE) (const char *tensor_file, const float *src, uint32_t num);
+typedef void (LIB_API* PNINETWORKSETCONVERTTHREADS) (int nb_threads);
+typedef ni_retcode_t (LIB_API* PNICONVERTYUV444PTO420P) (uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS], const int dst_stride[NI_MAX_NUM_DATA_POINTERS], int dst_width, int dst_height, ni_pix_fmt_t dst_fmt, uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS], const int src_stride[NI_MAX_NUM_DATA_POINTERS], int width, int height, ni_chroma_filter_t filter);
+typedef void (LIB_API* PNIYUVSETCONVERTTHREADS) (int nb_threads);
+typedef void (LIB_API* PNIMEMCACHETRIM) (size_t max_idle_bytes);
+typedef void (LIB_API* PNISETHUGEPAGES) (int enable);
 //
 
 //
@@ -263,10 +269,28 @@ typedef ni_retcode_t (LIB_API* PNIRECONFIGSLICEARG) (ni_session_context_t *p_ctx
 typedef ni_retcode_t (LIB_API* PNIP2PRECV) (ni_session_context_t *pSession, const ni_p2p_sgl_t *dmaAddrs, ni_frame_t *pDstFrame);
 typedef ni_retcode_t (LIB_API* PNIDEVICESESSIONRESTART) (ni_session_context_t *p_ctx, int video_width, int video_height, ni_device_type_t device_type);
 typedef ni_retcode_t (LIB_API* PNIDECRECONFIGPPUPARAMS) (ni_session_context_t *p_session_ctx, ni_xcoder_params_t *p_param, ni_ppu_config_t *p_ppu_config);
+typedef int (LIB_API* PNIAISESSIONWRITEBATCH) (ni_session_context_t *p_ctx, ni_frame_t *p_frames[], int num);
+typedef int (LIB_API* PNIAISESSIONREADBATCH) (ni_session_context_t *p_ctx, ni_packet_t *p_packets[], int num);
+typedef ni_packet_arena_t * (LIB_API* PNIPACKETARENAALLOC) (int slot_size, int nb_slots);
+typedef ni_retcode_t (LIB_API* PNIPACKETARENAGETBUFFER) (ni_packet_arena_t *p_arena, ni_packet_t *p_packet, int packet_size);
+typedef ni_retcode_t (LIB_API* PNIPACKETARENAREF) (const ni_packet_t *p_src, ni_packet_t *p_dst);
+typedef void (LIB_API* PNIPACKETARENAFREE) (ni_packet_arena_t *p_arena);
+typedef int (LIB_API* PNIDEVICESESSIONREADBATCH) (ni_session_context_t *p_ctx, ni_session_data_io_t *p_data, int nb_data, ni_device_type_t device_type);
+typedef ni_scaler_batch_t * (LIB_API* PNISCALERBATCHALLOC) (int max_jobs);
+typedef ni_retcode_t (LIB_API* PNISCALERBATCHADD) (ni_session_context_t *p_ctx, ni_scaler_batch_t *p_batch, ni_frame_config_t p_cfg_in[], int numInCfgs, ni_frame_config_t *p_cfg_out);
+typedef int (LIB_API* PNIDEVICESCALERBATCHSUBMIT) (ni_session_context_t *p_ctx, ni_scaler_batch_t *p_batch, niFrameSurface1_t p_out_surface[]);
+typedef void (LIB_API* PNISCALERBATCHFREE) (ni_scaler_batch_t *p_batch);
+typedef int (LIB_API* PNIDEVICESESSIONCPUHINT) (ni_session_context_t *p_ctx, ni_session_thread_t thread);
+typedef ni_retcode_t (LIB_API* PNIDEVICESESSIONPINTHREAD) (ni_session_context_t *p_ctx, ni_session_thread_t thread);
+typedef int (LIB_API* PNIAISESSIONWRITEHWFRAMEBATCH) (ni_session_context_t *p_ctx, niFrameSurface1_t *p_surfaces[], int num);
 //
 // Function pointers for ni_quadraprobe.h
 //
 typedef int (LIB_API* PNIRSRCLOGDUMP) (const char *outdir, bool core_reset_log);
+typedef ni_fw_log_tail_t * (LIB_API* PNIFWLOGTAILOPEN) (const char *bar_path, bool core_reset_log);
+typedef int (LIB_API* PNIFWLOGTAILSETWINDOW) (ni_fw_log_tail_t *p_tail, uint32_t window);
+typedef int (LIB_API* PNIFWLOGTAILPOLL) (ni_fw_log_tail_t *p_tail, ni_fw_log_record_cb cb, void *opaque);
+typedef void (LIB_API* PNIFWLOGTAILCLOSE) (ni_fw_log_tail_t *p_tail);
 
 /* End API function pointers */
 
@@ -347,6 +371,12 @@ typedef struct _NETINT_LIBXCODER_API_FUNCTION_LIST
     PNIPTHREADSIGMASK                    niPthreadSigmask;                     /** Client should access ::ni_pthread_sigmask API through this pointer */
     PNIPOSIXMEMALIGN                     niPosixMemalign;                      /** Client should access ::ni_posix_memalign API through this pointer */
     PNIAIERRNOTOSTR                      niAiErrnoToStr;                       /** Client should access ::ni_ai_errno_to_str API through this pointer */
+    PNINETWORKWRITETENSORFILE            niNetworkWriteTensorFile;             /** Client should access ::ni_network_write_tensor_file API through this pointer */
+    PNINETWORKSETCONVERTTHREADS          niNetworkSetConvertThreads;           /** Client should access ::ni_network_set_convert_threads API through this pointer */
+    PNICONVERTYUV444PTO420P              niConvertYuv444PTo420P;               /** Client should access ::ni_convert_yuv_444p_to_420p API through this pointer */
+    PNIYUVSETCONVERTTHREADS              niYuvSetConvertThreads;               /** Client should access ::ni_yuv_set_convert_threads API through this pointer */
+    PNIMEMCACHETRIM                      niMemCacheTrim;                       /** Client should access ::ni_mem_cache_trim API through this pointer */
+    PNISETHUGEPAGES                      niSetHugePages;                       /** Client should access ::ni_set_huge_pages API through this pointer */
     //
     // API function list for ni_device_api.h
     //
@@ -482,10 +512,28 @@ typedef struct _NETINT_LIBXCODER_API_FUNCTION_LIST
     PNIDEVICESESSIONRESTART              niDeviceSessionRestart;               /** Client should access ::ni_device_session_restart API through this pointer */
     PNIDEVICESESSIONQUERYBUFFERAVAIL     niDeviceSessionQueryBufferAvail;      /** Client should access ::ni_device_session_query_buffer_avail API through this pointer */
     PNIDECRECONFIGPPUPARAMS              niDecReconfigPpuParams;               /** Client should access ::ni_dec_reconfig_ppu_params API through this pointer */
+    PNIAISESSIONWRITEBATCH               niAiSessionWriteBatch;                /** Client should access ::ni_ai_session_write_batch API through this pointer */
+    PNIAISESSIONREADBATCH                niAiSessionReadBatch;                 /** Client should access ::ni_ai_session_read_batch API through this pointer */
+    PNIPACKETARENAALLOC                  niPacketArenaAlloc;                   /** Client should access ::ni_packet_arena_alloc API through this pointer */
+    PNIPACKETARENAGETBUFFER              niPacketArenaGetBuffer;               /** Client should access ::ni_packet_arena_get_buffer API through this pointer */
+    PNIPACKETARENAREF                    niPacketArenaRef;                     /** Client should access ::ni_packet_arena_ref API through this pointer */
+    PNIPACKETARENAFREE                   niPacketArenaFree;                    /** Client should access ::ni_packet_arena_free API through this pointer */
+    PNIDEVICESESSIONREADBATCH            niDeviceSessionReadBatch;             /** Client should access ::ni_device_session_read_batch API through this pointer */
+    PNISCALERBATCHALLOC                  niScalerBatchAlloc;                   /** Client should access ::ni_scaler_batch_alloc API through this pointer */
+    PNISCALERBATCHADD                    niScalerBatchAdd;                     /** Client should access ::ni_scaler_batch_add API through this pointer */
+    PNIDEVICESCALERBATCHSUBMIT           niDeviceScalerBatchSubmit;            /** Client should access ::ni_device_scaler_batch_submit API through this pointer */
+    PNISCALERBATCHFREE                   niScalerBatchFree;                    /** Client should access ::ni_scaler_batch_free API through this pointer */
+    PNIDEVICESESSIONCPUHINT              niDeviceSessionCpuHint;               /** Client should access ::ni_device_session_cpu_hint API through this pointer */
+    PNIDEVICESESSIONPINTHREAD            niDeviceSessionPinThread;             /** Client should access ::ni_device_session_pin_thread API through this pointer */
+    PNIAISESSIONWRITEHWFRAMEBATCH        niAiSessionWriteHwframeBatch;         /** Client should access ::ni_ai_session_write_hwframe_batch API through this pointer */
 //
 // Function pointers for ni_quadraprobe.h
 //
     PNIRSRCLOGDUMP                       niRsrcLogDump;                        /** Client should access ::ni_rsrc_log_dump API through this pointer */
+    PNIFWLOGTAILOPEN                     niFwLogTailOpen;                      /** Client should access ::ni_fw_log_tail_open API through this pointer */
+    PNIFWLOGTAILSETWINDOW                niFwLogTailSetWindow;                 /** Client should access ::ni_fw_log_tail_set_window API through this pointer */
+    PNIFWLOGTAILPOLL                     niFwLogTailPoll;                      /** Client should access ::ni_fw_log_tail_poll API through this pointer */
+    PNIFWLOGTAILCLOSE                    niFwLogTailClose;                     /** Client should access ::ni_fw_log_tail_close API through this pointer */
 } NETINT_LIBXCODER_API_FUNCTION_LIST;
 
 class NETINTLibxcoderAPI {
@@ -568,6 +616,12 @@ public:
         functionList->niPthreadSigmask = reinterpret_cast<decltype(ni_pthread_sigmask)*>(dlsym(lib,"ni_pthread_sigmask"));
         functionList->niPosixMemalign = reinterpret_cast<decltype(ni_posix_memalign)*>(dlsym(lib,"ni_posix_memalign"));
         functionList->niAiErrnoToStr = reinterpret_cast<decltype(ni_ai_errno_to_str)*>(dlsym(lib,"ni_ai_errno_to_str"));
+        functionList->niNetworkWriteTensorFile = reinterpret_cast<decltype(ni_network_write_tensor_file)*>(dlsym(lib,"ni_network_write_tensor_file"));
+        functionList->niNetworkSetConvertThreads = reinterpret_cast<decltype(ni_network_set_convert_threads)*>(dlsym(lib,"ni_network_set_convert_threads"));
+        functionList->niConvertYuv444PTo420P = reinterpret_cast<decltype(ni_convert_yuv_444p_to_420p)*>(dlsym(lib,"ni_convert_yuv_444p_to_420p"));
+        functionList->niYuvSetConvertThreads = reinterpret_cast<decltype(ni_yuv_set_convert_threads)*>(dlsym(lib,"ni_yuv_set_convert_threads"));
+        functionList->niMemCacheTrim = reinterpret_cast<decltype(ni_mem_cache_trim)*>(dlsym(lib,"ni_mem_cache_trim"));
+        functionList->niSetHugePages = reinterpret_cast<decltype(ni_set_huge_pages)*>(dlsym(lib,"ni_set_huge_pages"));
         //
         // Function/symbol loading for ni_device_api.h
         //
@@ -703,10 +757,28 @@ public:
         functionList->niP2PRecv = reinterpret_cast<decltype(ni_p2p_recv)*>(dlsym(lib,"ni_p2p_recv"));
         functionList->niDeviceSessionRestart = reinterpret_cast<decltype(ni_device_session_restart)*>(dlsym(lib,"ni_device_session_restart"));
         functionList->niDecReconfigPpuParams = reinterpret_cast<decltype(ni_dec_reconfig_ppu_params)*>(dlsym(lib,"ni_dec_reconfig_ppu_params"));
+        functionList->niAiSessionWriteBatch = reinterpret_cast<decltype(ni_ai_session_write_batch)*>(dlsym(lib,"ni_ai_session_write_batch"));
+        functionList->niAiSessionReadBatch = reinterpret_cast<decltype(ni_ai_session_read_batch)*>(dlsym(lib,"ni_ai_session_read_batch"));
+        functionList->niPacketArenaAlloc = reinterpret_cast<decltype(ni_packet_arena_alloc)*>(dlsym(lib,"ni_packet_arena_alloc"));
+        functionList->niPacketArenaGetBuffer = reinterpret_cast<decltype(ni_packet_arena_get_buffer)*>(dlsym(lib,"ni_packet_arena_get_buffer"));
+        functionList->niPacketArenaRef = reinterpret_cast<decltype(ni_packet_arena_ref)*>(dlsym(lib,"ni_packet_arena_ref"));
+        functionList->niPacketArenaFree = reinterpret_cast<decltype(ni_packet_arena_free)*>(dlsym(lib,"ni_packet_arena_free"));
+        functionList->niDeviceSessionReadBatch = reinterpret_cast<decltype(ni_device_session_read_batch)*>(dlsym(lib,"ni_device_session_read_batch"));
+        functionList->niScalerBatchAlloc = reinterpret_cast<decltype(ni_scaler_batch_alloc)*>(dlsym(lib,"ni_scaler_batch_alloc"));
+        functionList->niScalerBatchAdd = reinterpret_cast<decltype(ni_scaler_batch_add)*>(dlsym(lib,"ni_scaler_batch_add"));
+        functionList->niDeviceScalerBatchSubmit = reinterpret_cast<decltype(ni_device_scaler_batch_submit)*>(dlsym(lib,"ni_device_scaler_batch_submit"));
+        functionList->niScalerBatchFree = reinterpret_cast<decltype(ni_scaler_batch_free)*>(dlsym(lib,"ni_scaler_batch_free"));
+        functionList->niDeviceSessionCpuHint = reinterpret_cast<decltype(ni_device_session_cpu_hint)*>(dlsym(lib,"ni_device_session_cpu_hint"));
+        functionList->niDeviceSessionPinThread = reinterpret_cast<decltype(ni_device_session_pin_thread)*>(dlsym(lib,"ni_device_session_pin_thread"));
+        functionList->niAiSessionWriteHwframeBatch = reinterpret_cast<decltype(ni_ai_session_write_hwframe_batch)*>(dlsym(lib,"ni_ai_session_write_hwframe_batch"));
         //
         // Function pointers for ni_quadraprobe.h
         //
         functionList->niRsrcLogDump = reinterpret_cast<decltype(ni_rsrc_log_dump)*>(dlsym(lib,"ni_rsrc_log_dump"));
+        functionList->niFwLogTailOpen = reinterpret_cast<decltype(ni_fw_log_tail_open)*>(dlsym(lib,"ni_fw_log_tail_open"));
+        functionList->niFwLogTailSetWindow = reinterpret_cast<decltype(ni_fw_log_tail_set_window)*>(dlsym(lib,"ni_fw_log_tail_set_window"));
+        functionList->niFwLogTailPoll = reinterpret_cast<decltype(ni_fw_log_tail_poll)*>(dlsym(lib,"ni_fw_log_tail_poll"));
+        functionList->niFwLogTailClose = reinterpret_cast<decltype(ni_fw_log_tail_close)*>(dlsym(lib,"ni_fw_log_tail_close"));
 
     }
 };
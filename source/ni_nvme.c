@@ -42,6 +42,7 @@
 #endif
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -752,6 +753,137 @@ int32_t ni_nvme_send_write_cmd(ni_device_handle_t handle,
     return rc;
 }
 
+/*!******************************************************************************
+ *  \brief  Compose a io write command gathering several buffers, the device
+ *          receives the same data as from one ni_nvme_send_write_cmd() per
+ *          segment at the same lba but with a single command.
+ *
+ *          The device is opened with O_DIRECT and has 4K logical blocks, so
+ *          every segment must start at a NI_MEM_PAGE_ALIGNMENT aligned address
+ *          and be a multiple of NI_MEM_PAGE_ALIGNMENT long. Otherwise all the
+ *          segments are copied into one aligned buffer first.
+ *
+ *  \param[in] handle        device handle
+ *  \param[in] event_handle  event handle, Windows only
+ *  \param[in] p_iov         segments, written in order
+ *  \param[in] iovcnt        number of segments, at most NI_NVME_MAX_IOVEC
+ *  \param[in] lba           lba of the write
+ *
+ *  \return value < 0, failed, return failure code.
+ *          value >= 0, success
+ *******************************************************************************/
+int32_t ni_nvme_send_writev_cmd(ni_device_handle_t handle,
+                                ni_event_handle_t event_handle,
+                                const ni_nvme_iovec_t *p_iov, int iovcnt,
+                                uint32_t lba)
+{
+    int32_t rc = NI_RETCODE_SUCCESS;
+    int i;
+
+    if (!p_iov || iovcnt <= 0 || iovcnt > NI_NVME_MAX_IOVEC)
+    {
+        ni_log(NI_LOG_ERROR, "%s: ERROR: invalid parameter: p_iov=%p, iovcnt=%d\n",
+               __func__, p_iov, iovcnt);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (iovcnt == 1)
+    {
+        return ni_nvme_send_write_cmd(handle, event_handle, p_iov[0].p_data,
+                                      p_iov[0].data_len, lba);
+    }
+
+#ifdef _WIN32
+    for (i = 0; i < iovcnt; i++)
+    {
+        rc = ni_nvme_send_write_cmd(handle, event_handle, p_iov[i].p_data,
+                                    p_iov[i].data_len, lba);
+        if (rc < 0)
+        {
+            break;
+        }
+    }
+#else
+    struct iovec iov[NI_NVME_MAX_IOVEC];
+    uint64_t offset = (uint64_t)lba << LBA_BIT_OFFSET;
+    uint64_t total_len = 0;
+    int aligned = 1;
+    ssize_t written;
+
+    if (!handle || handle == NI_INVALID_DEVICE_HANDLE)
+    {
+        ni_log(NI_LOG_ERROR, "%s: ERROR: invalid parameters: handle=%" PRId32 "\n", __func__, handle);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < iovcnt; i++)
+    {
+        if (!p_iov[i].p_data)
+        {
+            ni_log(NI_LOG_ERROR, "%s: ERROR: invalid parameter: segment %d p_data=%p\n",
+                   __func__, i, p_iov[i].p_data);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+        if ((((uintptr_t)p_iov[i].p_data) % NI_MEM_PAGE_ALIGNMENT) ||
+            (p_iov[i].data_len % NI_MEM_PAGE_ALIGNMENT))
+        {
+            aligned = 0;
+        }
+        iov[i].iov_base = p_iov[i].p_data;
+        iov[i].iov_len = p_iov[i].data_len;
+        total_len += p_iov[i].data_len;
+    }
+
+    if (total_len > UINT32_MAX)
+    {
+        ni_log(NI_LOG_ERROR, "%s: ERROR: invalid parameter: len=%" PRIu64 "\n",
+               __func__, total_len);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (aligned)
+    {
+        written = pwritev(handle, iov, iovcnt, (off_t)offset);
+    } else
+    {
+        void *p_buf = NULL;
+        uint8_t *p_dst;
+
+        ni_log(NI_LOG_DEBUG,
+               "%s: segments not %d aligned, copying to aligned memory and "
+               "writing.\n", __func__, NI_MEM_PAGE_ALIGNMENT);
+        if (ni_posix_memalign(&p_buf, sysconf(_SC_PAGESIZE), total_len))
+        {
+            ni_log(NI_LOG_ERROR, "ERROR %d: %s() alloc data buffer failed\n",
+                   NI_ERRNO, __func__);
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+        p_dst = (uint8_t *)p_buf;
+        for (i = 0; i < iovcnt; i++)
+        {
+            memcpy(p_dst, p_iov[i].p_data, p_iov[i].data_len);
+            p_dst += p_iov[i].data_len;
+        }
+        written = pwrite(handle, p_buf, total_len, (off_t)offset);
+        ni_aligned_free(p_buf);
+    }
+    ni_log(NI_LOG_TRACE,
+           "%s: handle=%" PRIx64 ", lba=0x%lx, iovcnt=%d, len=%" PRIu64
+           ", rc=%zd\n", __func__, (int64_t)handle, ((uint64_t)lba << 3),
+           iovcnt, total_len, written);
+    if (written < 0 || (uint64_t)written != total_len)
+    {
+        ni_log(NI_LOG_ERROR,
+               "ERROR %d: %s failed, lba=0x%lx, len=%" PRIu64 ", rc=%zd, error=%d\n",
+               NI_ERRNO, __func__, ((uint64_t)lba << 3), total_len, written,
+               NI_ERRNO);
+        ni_parse_lba(lba);
+        rc = NI_RETCODE_ERROR_NVME_CMD_FAILED;
+    }
+#endif
+    return rc;
+}
+
 //linux aio
 #ifdef __linux__
 void ni_nvme_setup_aio_iocb(ni_device_handle_t handle, ni_iocb_t *iocb,
@@ -918,6 +918,18 @@ int32_t ni_nvme_send_io_pass_through_command(ni_device_handle_t fd, ni_nvme_pass
 int32_t ni_nvme_send_read_cmd(ni_device_handle_t handle, ni_event_handle_t event_handle, void *p_data, uint32_t data_len, uint32_t lba);
 int32_t ni_nvme_send_write_cmd(ni_device_handle_t handle, ni_event_handle_t event_handle, void *p_data, uint32_t data_len, uint32_t lba);
 
+// max segments of one ni_nvme_send_writev_cmd()
+#define NI_NVME_MAX_IOVEC 8
+
+// one segment of a gather write, see ni_nvme_send_writev_cmd()
+typedef struct _ni_nvme_iovec
+{
+    void *p_data;
+    uint32_t data_len;
+} ni_nvme_iovec_t;
+
+int32_t ni_nvme_send_writev_cmd(ni_device_handle_t handle, ni_event_handle_t event_handle, const ni_nvme_iovec_t *p_iov, int iovcnt, uint32_t lba);
+
 #ifdef __linux__
 static inline int32_t ni_aio_setup(unsigned nr, aio_context_t *ctxp)
 {
@@ -0,0 +1,1090 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_pipeline.c
+ *
+ *  \brief  In-process pipeline graph that wires decoder, scaler and encoder
+ *          sessions together over hw frame descriptors
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "ni_device_api.h"
+#include "ni_log.h"
+#include "ni_util.h"
+#include "ni_pipeline_priv.h"
+
+// ----------------------------------------------------------------------------
+// bounded link operations
+// ----------------------------------------------------------------------------
+
+static void ni_pipeline_queue_init(ni_pipeline_queue_t *p_queue, int capacity)
+{
+    memset(p_queue->entries, 0, sizeof(p_queue->entries));
+    p_queue->head = 0;
+    p_queue->tail = 0;
+    p_queue->count = 0;
+    p_queue->capacity = capacity;
+    ni_pthread_mutex_init(&p_queue->mutex);
+}
+
+static int ni_pipeline_queue_space(ni_pipeline_queue_t *p_queue)
+{
+    int space;
+
+    ni_pthread_mutex_lock(&p_queue->mutex);
+    space = p_queue->capacity - p_queue->count;
+    ni_pthread_mutex_unlock(&p_queue->mutex);
+    return space;
+}
+
+static void ni_pipeline_queue_push(ni_pipeline_queue_t *p_queue,
+                                   const ni_pipeline_frame_t *p_entry)
+{
+    ni_pthread_mutex_lock(&p_queue->mutex);
+    p_queue->entries[p_queue->tail] = *p_entry;
+    p_queue->tail = (p_queue->tail + 1) % p_queue->capacity;
+    p_queue->count++;
+    ni_pthread_mutex_unlock(&p_queue->mutex);
+}
+
+static int ni_pipeline_queue_peek(ni_pipeline_queue_t *p_queue,
+                                  ni_pipeline_frame_t *p_entry)
+{
+    int found = 0;
+
+    ni_pthread_mutex_lock(&p_queue->mutex);
+    if (p_queue->count > 0)
+    {
+        *p_entry = p_queue->entries[p_queue->head];
+        found = 1;
+    }
+    ni_pthread_mutex_unlock(&p_queue->mutex);
+    return found;
+}
+
+static void ni_pipeline_queue_pop(ni_pipeline_queue_t *p_queue)
+{
+    ni_pthread_mutex_lock(&p_queue->mutex);
+    if (p_queue->count > 0)
+    {
+        p_queue->head = (p_queue->head + 1) % p_queue->capacity;
+        p_queue->count--;
+    }
+    ni_pthread_mutex_unlock(&p_queue->mutex);
+}
+
+// ----------------------------------------------------------------------------
+// shared hw frame references
+// ----------------------------------------------------------------------------
+
+// caller holds p_pipeline->mutex
+static ni_pipeline_hwframe_ref_t *
+ni_pipeline_hwframe_find(ni_pipeline_t *p_pipeline, int32_t device_handle,
+                         uint16_t session_id, uint16_t frame_idx)
+{
+    ni_pipeline_hwframe_ref_t *p_ref;
+    int i;
+
+    for (i = 0; i < p_pipeline->nb_hwframe_refs; i++)
+    {
+        p_ref = &p_pipeline->hwframe_refs[i];
+        if (p_ref->ref_cnt > 0 && p_ref->surface.ui16FrameIdx == frame_idx &&
+            p_ref->surface.ui16session_ID == session_id &&
+            p_ref->surface.device_handle == device_handle)
+        {
+            return p_ref;
+        }
+    }
+    return NULL;
+}
+
+static int ni_pipeline_hwframe_ref(ni_pipeline_t *p_pipeline,
+                                   const niFrameSurface1_t *p_surface,
+                                   int count)
+{
+    ni_pipeline_hwframe_ref_t *p_ref;
+    int i;
+
+    ni_pthread_mutex_lock(&p_pipeline->mutex);
+    p_ref = ni_pipeline_hwframe_find(p_pipeline, p_surface->device_handle,
+                                     p_surface->ui16session_ID,
+                                     p_surface->ui16FrameIdx);
+    if (!p_ref)
+    {
+        for (i = 0; i < NI_PIPELINE_MAX_HWFRAME_REFS; i++)
+        {
+            if (0 == p_pipeline->hwframe_refs[i].ref_cnt)
+            {
+                p_ref = &p_pipeline->hwframe_refs[i];
+                p_ref->surface = *p_surface;
+                if (i >= p_pipeline->nb_hwframe_refs)
+                {
+                    p_pipeline->nb_hwframe_refs = i + 1;
+                }
+                break;
+            }
+        }
+    }
+    if (p_ref)
+    {
+        p_ref->ref_cnt += count;
+    }
+    ni_pthread_mutex_unlock(&p_pipeline->mutex);
+
+    if (!p_ref)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() more than %d hw frames in flight\n",
+               __func__, NI_PIPELINE_MAX_HWFRAME_REFS);
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+static void ni_pipeline_hwframe_unref(ni_pipeline_t *p_pipeline,
+                                      int32_t device_handle,
+                                      uint16_t session_id, uint16_t frame_idx)
+{
+    ni_pipeline_hwframe_ref_t *p_ref;
+    niFrameSurface1_t surface;
+    int recycle = 0;
+
+    ni_pthread_mutex_lock(&p_pipeline->mutex);
+    p_ref = ni_pipeline_hwframe_find(p_pipeline, device_handle, session_id,
+                                     frame_idx);
+    if (p_ref && 0 == --p_ref->ref_cnt)
+    {
+        surface = p_ref->surface;
+        recycle = 1;
+    }
+    ni_pthread_mutex_unlock(&p_pipeline->mutex);
+
+    // recycle outside of the lock, it is a device command
+    if (recycle && surface.ui16FrameIdx)
+    {
+        ni_log(NI_LOG_TRACE, "%s: recycle frame idx %u\n", __func__,
+               surface.ui16FrameIdx);
+        ni_hwframe_buffer_recycle2(&surface);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// node helpers
+// ----------------------------------------------------------------------------
+
+static void ni_pipeline_wake(ni_pipeline_t *p_pipeline)
+{
+    ni_pthread_cond_broadcast(&p_pipeline->cond);
+}
+
+static void ni_pipeline_node_finish(ni_pipeline_node_t *p_node)
+{
+    ni_pipeline_t *p_pipeline = p_node->p_pipeline;
+    int nb_active;
+
+    ni_pthread_mutex_lock(&p_pipeline->mutex);
+    nb_active = --p_pipeline->nb_active;
+    ni_pthread_mutex_unlock(&p_pipeline->mutex);
+    ni_log(NI_LOG_DEBUG, "%s: node %d done, %d active\n", __func__, p_node->id,
+           nb_active);
+    ni_pipeline_wake(p_pipeline);
+}
+
+// Check that every downstream link can take one more frame. Only this node
+// pushes into its output links so the answer stays valid until it pushes.
+static int ni_pipeline_outputs_ready(ni_pipeline_node_t *p_node,
+                                     ni_pipeline_stats_t *p_delta)
+{
+    int i;
+
+    for (i = 0; i < p_node->nb_outputs; i++)
+    {
+        if (ni_pipeline_queue_space(&p_node->out_queues[i]) <= 0)
+        {
+            if (!p_node->blocked_since)
+            {
+                p_node->blocked_since = ni_gettime_ns();
+            }
+            return 0;
+        }
+    }
+
+    if (p_node->blocked_since)
+    {
+        p_delta->blocked_ns += ni_gettime_ns() - p_node->blocked_since;
+        p_node->blocked_since = 0;
+    }
+    return 1;
+}
+
+// Fan a frame out to all downstream links; the hw frame is referenced once
+// per consumer and never duplicated on the device.
+static int ni_pipeline_fanout(ni_pipeline_node_t *p_node,
+                              const ni_pipeline_frame_t *p_entry)
+{
+    int i;
+
+    if (!p_entry->end_of_stream)
+    {
+        if (0 == p_node->nb_outputs)
+        {
+            niFrameSurface1_t surface = p_entry->surface;
+            ni_hwframe_buffer_recycle2(&surface);
+            return NI_RETCODE_SUCCESS;
+        }
+        if (ni_pipeline_hwframe_ref(p_node->p_pipeline, &p_entry->surface,
+                                    p_node->nb_outputs))
+        {
+            niFrameSurface1_t surface = p_entry->surface;
+            ni_hwframe_buffer_recycle2(&surface);
+            return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+        }
+    }
+
+    for (i = 0; i < p_node->nb_outputs; i++)
+    {
+        ni_pipeline_queue_push(&p_node->out_queues[i], p_entry);
+    }
+    ni_pipeline_wake(p_node->p_pipeline);
+    return NI_RETCODE_SUCCESS;
+}
+
+// ----------------------------------------------------------------------------
+// per node type step functions: return number of units of progress, <0 error.
+// Counters are collected in p_delta and folded into the node stats by
+// ni_pipeline_node_step().
+// ----------------------------------------------------------------------------
+
+static int ni_pipeline_decoder_step(ni_pipeline_node_t *p_node,
+                                    ni_pipeline_stats_t *p_delta)
+{
+    ni_session_context_t *p_ctx = p_node->p_ctx;
+    ni_packet_t *p_packet = &p_node->in_data.data.packet;
+    ni_frame_t *p_frame = &p_node->out_data.data.frame;
+    ni_pipeline_frame_t entry;
+    int progress = 0;
+    int width, height;
+    int ret;
+    uint64_t t0;
+
+    // send side
+    if (!p_node->eos_sent)
+    {
+        if (!p_node->pending_send)
+        {
+            p_packet->start_of_stream = 0;
+            p_packet->end_of_stream = 0;
+            ret = p_node->read_packet(p_node->opaque, p_packet);
+            if (ret < 0)
+            {
+                ni_log(NI_LOG_ERROR, "ERROR: %s() read packet failed %d\n",
+                       __func__, ret);
+                return ret;
+            } else if (ret > 0)
+            {
+                p_packet->start_of_stream = !p_node->sos_sent;
+                p_node->sos_sent = 1;
+                p_node->pending_send = 1;
+            }
+        }
+
+        if (p_node->pending_send)
+        {
+            t0 = ni_gettime_ns();
+            ret = ni_device_session_write(p_ctx, &p_node->in_data,
+                                          NI_DEVICE_TYPE_DECODER);
+            if (ret < 0)
+            {
+                ni_log(NI_LOG_ERROR, "ERROR: %s() decoder write failed %d\n",
+                       __func__, ret);
+                return ret;
+            } else if (ret > 0 || p_ctx->ready_to_close)
+            {
+                p_delta->busy_ns += ni_gettime_ns() - t0;
+                p_delta->bytes_in += ret;
+                if (ret > 0)
+                {
+                    p_delta->frames_in++;
+                    ni_packet_buffer_free(p_packet);
+                }
+                p_node->eos_sent = p_ctx->ready_to_close;
+                p_node->pending_send = 0;
+                progress++;
+            }
+        }
+    }
+
+    // receive side, held back while any downstream link is full
+    if (!p_node->eos_received && ni_pipeline_outputs_ready(p_node, p_delta))
+    {
+        width = p_ctx->active_video_width > 0 ? (int)p_ctx->active_video_width :
+                                                 XCODER_MIN_ENC_PIC_WIDTH;
+        height = p_ctx->active_video_height > 0 ?
+            (int)p_ctx->active_video_height : XCODER_MIN_ENC_PIC_HEIGHT;
+        ret = ni_frame_buffer_alloc(p_frame, width, height,
+                                    p_ctx->codec_format == NI_CODEC_FORMAT_H264,
+                                    1, p_ctx->bit_depth_factor, 3, 1);
+        if (NI_RETCODE_SUCCESS != ret)
+        {
+            return ret;
+        }
+
+        t0 = ni_gettime_ns();
+        ret = ni_device_session_read_hwdesc(p_ctx, &p_node->out_data,
+                                            NI_DEVICE_TYPE_DECODER);
+        if (ret < 0)
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() decoder read failed %d\n",
+                   __func__, ret);
+            return ret;
+        }
+
+        memset(&entry, 0, sizeof(entry));
+        if (ret > 0)
+        {
+            p_delta->busy_ns += ni_gettime_ns() - t0;
+            p_delta->frames_out++;
+            entry.surface = *(niFrameSurface1_t *)p_frame->p_data[3];
+            entry.pts = p_frame->pts;
+            ni_frame_wipe_aux_data(p_frame);
+            ret = ni_pipeline_fanout(p_node, &entry);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            progress++;
+        } else if (p_frame->end_of_stream)
+        {
+            entry.end_of_stream = 1;
+            ni_pipeline_fanout(p_node, &entry);
+            p_node->eos_received = 1;
+            ni_pipeline_node_finish(p_node);
+            progress++;
+        }
+    }
+
+    return progress;
+}
+
+static int ni_pipeline_scaler_step(ni_pipeline_node_t *p_node,
+                                   ni_pipeline_stats_t *p_delta)
+{
+    ni_session_context_t *p_ctx = p_node->p_ctx;
+    ni_frame_t *p_frame = &p_node->out_data.data.frame;
+    ni_scaler_input_params_t params = p_node->scaler_params;
+    ni_pipeline_frame_t in, out;
+    int ret;
+    uint64_t t0;
+
+    if (p_node->eos_received || !ni_pipeline_queue_peek(p_node->p_in_queue, &in))
+    {
+        return 0;
+    }
+
+    if (!ni_pipeline_outputs_ready(p_node, p_delta))
+    {
+        return 0;
+    }
+
+    ni_pipeline_queue_pop(p_node->p_in_queue);
+    if (in.end_of_stream)
+    {
+        ni_pipeline_fanout(p_node, &in);
+        p_node->eos_received = 1;
+        ni_pipeline_node_finish(p_node);
+        return 1;
+    }
+
+    params.input_width = in.surface.ui16width;
+    params.input_height = in.surface.ui16height;
+
+    t0 = ni_gettime_ns();
+    ret = ni_frame_buffer_alloc_hwenc(p_frame, params.output_width,
+                                      params.output_height, 0);
+    if (NI_RETCODE_SUCCESS == ret)
+    {
+        ret = ni_scaler_input_frame_alloc(p_ctx, params, &in.surface);
+    }
+    if (NI_RETCODE_SUCCESS == ret)
+    {
+        ret = ni_scaler_dest_frame_alloc(p_ctx, params, &in.surface);
+    }
+    if (NI_RETCODE_SUCCESS == ret)
+    {
+        ret = ni_device_session_read_hwdesc(p_ctx, &p_node->out_data,
+                                            NI_DEVICE_TYPE_SCALER);
+    }
+
+    // the scaler has consumed its input whatever the outcome
+    ni_pipeline_hwframe_unref(p_node->p_pipeline, in.surface.device_handle,
+                              in.surface.ui16session_ID,
+                              in.surface.ui16FrameIdx);
+    p_delta->frames_in++;
+
+    if (ret < 0)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() scaler op %d failed %d\n", __func__,
+               params.op, ret);
+        return ret;
+    }
+
+    p_delta->busy_ns += ni_gettime_ns() - t0;
+    p_delta->frames_out++;
+
+    memset(&out, 0, sizeof(out));
+    out.surface = *(niFrameSurface1_t *)p_frame->p_data[3];
+    out.pts = in.pts;
+    ret = ni_pipeline_fanout(p_node, &out);
+    return ret < 0 ? ret : 1;
+}
+
+// Open a deferred encoder on its first frame. An encoder that gets end of
+// stream before any frame is never opened and only reports end of stream.
+static int ni_pipeline_encoder_open(ni_pipeline_node_t *p_node,
+                                    const ni_pipeline_frame_t *p_in)
+{
+    ni_session_context_t *p_ctx = p_node->p_ctx;
+    ni_packet_t *p_packet = &p_node->out_data.data.packet;
+    int ret;
+
+    if (p_in->end_of_stream)
+    {
+        p_packet->data_len = 0;
+        p_packet->end_of_stream = 1;
+        p_node->write_packet(p_node->opaque, p_node->id, p_packet, 0);
+        ni_pipeline_queue_pop(p_node->p_in_queue);
+        p_node->eos_sent = 1;
+        p_node->eos_received = 1;
+        ni_pipeline_node_finish(p_node);
+        return 1;
+    }
+
+    ret = p_node->open_encoder(p_node->opaque, p_node->id, p_ctx,
+                               &p_in->surface);
+    if (ret < 0 || !p_ctx->hw_action)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() node %d open failed %d\n", __func__,
+               p_node->id, ret);
+        return ret < 0 ? ret : NI_RETCODE_INVALID_PARAM;
+    }
+    p_node->opened = 1;
+    return 0;
+}
+
+static int ni_pipeline_encoder_step(ni_pipeline_node_t *p_node,
+                                    ni_pipeline_stats_t *p_delta)
+{
+    ni_session_context_t *p_ctx = p_node->p_ctx;
+    ni_xcoder_params_t *p_param = (ni_xcoder_params_t *)p_ctx->p_session_config;
+    ni_frame_t *p_frame = &p_node->in_data.data.frame;
+    ni_packet_t *p_packet = &p_node->out_data.data.packet;
+    ni_pipeline_frame_t in;
+    int progress = 0;
+    int recycle_index;
+    int width, height;
+    int ret;
+    uint64_t t0;
+
+    if (!p_node->opened)
+    {
+        if (!ni_pipeline_queue_peek(p_node->p_in_queue, &in))
+        {
+            return 0;
+        }
+        ret = ni_pipeline_encoder_open(p_node, &in);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        p_param = (ni_xcoder_params_t *)p_ctx->p_session_config;
+    }
+
+    // send side
+    if (!p_node->eos_sent && ni_pipeline_queue_peek(p_node->p_in_queue, &in))
+    {
+        if (!p_node->pending_send)
+        {
+            if (in.end_of_stream)
+            {
+                // the end of stream frame carries no surface, it has the
+                // resolution the session was opened with
+                width = p_param ? p_param->source_width : 0;
+                height = p_param ? p_param->source_height : 0;
+                if (width <= 0 || height <= 0)
+                {
+                    width = XCODER_MIN_ENC_PIC_WIDTH;
+                    height = XCODER_MIN_ENC_PIC_HEIGHT;
+                }
+            } else
+            {
+                width = in.surface.ui16width;
+                height = in.surface.ui16height;
+                p_node->in_device_handle = in.surface.device_handle;
+                p_node->in_session_id = in.surface.ui16session_ID;
+            }
+            ret = ni_frame_buffer_alloc_hwenc(p_frame, width, height,
+                                              NI_APP_ENC_FRAME_META_DATA_SIZE);
+            if (NI_RETCODE_SUCCESS != ret)
+            {
+                return ret;
+            }
+            if (!in.end_of_stream)
+            {
+                memcpy(p_frame->p_data[3], &in.surface, sizeof(niFrameSurface1_t));
+            }
+            p_frame->start_of_stream = !p_node->sos_sent;
+            p_frame->end_of_stream = in.end_of_stream;
+            p_frame->force_key_frame = 0;
+            p_frame->pts = in.pts;
+            // only metadata header, aux data is not carried over hw links
+            p_frame->extra_data_len = NI_APP_ENC_FRAME_META_DATA_SIZE;
+            p_node->sos_sent = 1;
+            p_node->pending_send = 1;
+        }
+
+        t0 = ni_gettime_ns();
+        ret = ni_device_session_write(p_ctx, &p_node->in_data,
+                                      NI_DEVICE_TYPE_ENCODER);
+        if (ret < 0)
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() encoder write failed %d\n",
+                   __func__, ret);
+            return ret;
+        } else if (ret > 0 || p_ctx->ready_to_close)
+        {
+            // the frame reference is dropped when the encoder hands back
+            // its index through the packet recycle_index
+            p_delta->busy_ns += ni_gettime_ns() - t0;
+            if (!in.end_of_stream)
+            {
+                p_delta->frames_in++;
+            }
+            p_node->eos_sent = p_ctx->ready_to_close;
+            p_node->pending_send = 0;
+            ni_pipeline_queue_pop(p_node->p_in_queue);
+            ni_pipeline_wake(p_node->p_pipeline);
+            progress++;
+        }
+    }
+
+    // receive side
+    if (!p_node->eos_received && p_node->sos_sent)
+    {
+        ret = ni_packet_buffer_alloc(p_packet, NI_MAX_TX_SZ);
+        if (NI_RETCODE_SUCCESS != ret)
+        {
+            return ret;
+        }
+
+        t0 = ni_gettime_ns();
+        ret = ni_device_session_read(p_ctx, &p_node->out_data,
+                                     NI_DEVICE_TYPE_ENCODER);
+        if (ret < 0)
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() encoder read failed %d\n",
+                   __func__, ret);
+            return ret;
+        }
+
+        recycle_index = p_packet->recycle_index;
+        if (recycle_index > 0 &&
+            recycle_index < NI_GET_MAX_HWDESC_FRAME_INDEX(p_ctx->ddr_config))
+        {
+            ni_pipeline_hwframe_unref(p_node->p_pipeline,
+                                      p_node->in_device_handle,
+                                      p_node->in_session_id,
+                                      (uint16_t)recycle_index);
+            p_packet->recycle_index = 0;
+        }
+
+        if (ret > (int)p_ctx->meta_size)
+        {
+            p_delta->busy_ns += ni_gettime_ns() - t0;
+            p_delta->frames_out++;
+            p_delta->bytes_out += ret - p_ctx->meta_size;
+            if (p_node->write_packet(p_node->opaque, p_node->id, p_packet,
+                                     p_ctx->meta_size) < 0)
+            {
+                return NI_RETCODE_FAILURE;
+            }
+            progress++;
+        }
+
+        if (p_packet->end_of_stream)
+        {
+            p_packet->data_len = 0;
+            p_node->write_packet(p_node->opaque, p_node->id, p_packet,
+                                 p_ctx->meta_size);
+            p_node->eos_received = 1;
+            ni_pipeline_node_finish(p_node);
+            progress++;
+        }
+    }
+
+    return progress;
+}
+
+static int ni_pipeline_node_step(ni_pipeline_node_t *p_node)
+{
+    ni_pipeline_t *p_pipeline = p_node->p_pipeline;
+    ni_pipeline_stats_t delta;
+    ni_pipeline_stats_t *p_stats = &p_node->stats;
+    int ret;
+
+    memset(&delta, 0, sizeof(delta));
+    switch (p_node->type)
+    {
+        case NI_PIPELINE_NODE_DECODER:
+            ret = ni_pipeline_decoder_step(p_node, &delta);
+            break;
+        case NI_PIPELINE_NODE_SCALER:
+            ret = ni_pipeline_scaler_step(p_node, &delta);
+            break;
+        case NI_PIPELINE_NODE_ENCODER:
+            ret = ni_pipeline_encoder_step(p_node, &delta);
+            break;
+        default:
+            return NI_RETCODE_INVALID_PARAM;
+    }
+
+    if (ret || delta.blocked_ns)
+    {
+        ni_pthread_mutex_lock(&p_pipeline->mutex);
+        p_stats->frames_in += delta.frames_in;
+        p_stats->frames_out += delta.frames_out;
+        p_stats->bytes_in += delta.bytes_in;
+        p_stats->bytes_out += delta.bytes_out;
+        p_stats->busy_ns += delta.busy_ns;
+        p_stats->blocked_ns += delta.blocked_ns;
+        ni_pthread_mutex_unlock(&p_pipeline->mutex);
+    }
+    return ret;
+}
+
+static int ni_pipeline_node_done(const ni_pipeline_node_t *p_node)
+{
+    return p_node->eos_received;
+}
+
+// ----------------------------------------------------------------------------
+// worker pool
+// ----------------------------------------------------------------------------
+
+static void *ni_pipeline_worker(void *arg)
+{
+    ni_pipeline_worker_t *p_worker = (ni_pipeline_worker_t *)arg;
+    ni_pipeline_t *p_pipeline = p_worker->p_pipeline;
+    int index = p_worker->index;
+    int i, ret, progress;
+    uint64_t abs_time_ns;
+    struct timespec ts;
+
+    ni_log(NI_LOG_DEBUG, "%s: worker %d start\n", __func__, index);
+
+    while (!p_pipeline->stop && !p_pipeline->error && p_pipeline->nb_active > 0)
+    {
+        progress = 0;
+        for (i = 0; i < p_pipeline->nb_nodes; i++)
+        {
+            ni_pipeline_node_t *p_node = &p_pipeline->nodes[i];
+            if (p_node->worker != index || ni_pipeline_node_done(p_node))
+            {
+                continue;
+            }
+
+            ret = ni_pipeline_node_step(p_node);
+            if (ret < 0)
+            {
+                ni_log(NI_LOG_ERROR, "ERROR: %s() node %d failed %d, abort\n",
+                       __func__, p_node->id, ret);
+                p_pipeline->error = 1;
+                ni_pipeline_wake(p_pipeline);
+                break;
+            }
+            progress += ret;
+        }
+
+        if (!progress)
+        {
+            abs_time_ns = ni_gettime_ns() + NI_PIPELINE_IDLE_WAIT_US * 1000LL;
+            ts.tv_sec = abs_time_ns / 1000000000LL;
+            ts.tv_nsec = abs_time_ns % 1000000000LL;
+            ni_pthread_mutex_lock(&p_pipeline->mutex);
+            ni_pthread_cond_timedwait(&p_pipeline->cond, &p_pipeline->mutex,
+                                      &ts);
+            ni_pthread_mutex_unlock(&p_pipeline->mutex);
+        }
+    }
+
+    ni_log(NI_LOG_DEBUG, "%s: worker %d exit\n", __func__, index);
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// public API
+// ----------------------------------------------------------------------------
+
+ni_pipeline_t *ni_pipeline_alloc(int nb_workers, int queue_depth)
+{
+    ni_pipeline_t *p_pipeline;
+
+    if (nb_workers <= 0)
+    {
+        nb_workers = NI_PIPELINE_DEFAULT_WORKERS;
+    }
+    if (queue_depth <= 0)
+    {
+        queue_depth = NI_PIPELINE_DEFAULT_QDEPTH;
+    }
+    if (nb_workers > NI_PIPELINE_MAX_WORKERS ||
+        queue_depth > NI_PIPELINE_MAX_QDEPTH)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid workers %d / depth %d\n",
+               __func__, nb_workers, queue_depth);
+        return NULL;
+    }
+
+    p_pipeline = (ni_pipeline_t *)calloc(1, sizeof(ni_pipeline_t));
+    if (!p_pipeline)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() alloc failed\n", NI_ERRNO,
+               __func__);
+        return NULL;
+    }
+
+    p_pipeline->nb_workers = nb_workers;
+    p_pipeline->queue_depth = queue_depth;
+    ni_pthread_mutex_init(&p_pipeline->mutex);
+    ni_pthread_cond_init(&p_pipeline->cond, NULL);
+    return p_pipeline;
+}
+
+static ni_pipeline_node_t *ni_pipeline_new_node(ni_pipeline_t *p_pipeline,
+                                                ni_pipeline_node_type_t type,
+                                                int src_node,
+                                                ni_session_context_t *p_ctx)
+{
+    ni_pipeline_node_t *p_node;
+    ni_pipeline_node_t *p_src = NULL;
+
+    if (!p_pipeline || !p_ctx || p_pipeline->started ||
+        p_pipeline->nb_nodes >= NI_PIPELINE_MAX_NODES)
+    {
+        return NULL;
+    }
+
+    if (NI_PIPELINE_NODE_DECODER == type)
+    {
+        // the decoder is the root of the tree
+        if (p_pipeline->nb_nodes)
+        {
+            return NULL;
+        }
+    } else
+    {
+        if (src_node < 0 || src_node >= p_pipeline->nb_nodes)
+        {
+            return NULL;
+        }
+        p_src = &p_pipeline->nodes[src_node];
+        if (NI_PIPELINE_NODE_ENCODER == p_src->type ||
+            p_src->nb_outputs >= NI_PIPELINE_MAX_OUTPUTS)
+        {
+            return NULL;
+        }
+    }
+
+    p_node = &p_pipeline->nodes[p_pipeline->nb_nodes];
+    memset(p_node, 0, sizeof(ni_pipeline_node_t));
+    p_node->p_pipeline = p_pipeline;
+    p_node->type = type;
+    p_node->id = p_pipeline->nb_nodes;
+    p_node->worker = p_node->id % p_pipeline->nb_workers;
+    p_node->p_ctx = p_ctx;
+    p_node->opened = 1;
+
+    if (p_src)
+    {
+        p_node->p_in_queue = &p_src->out_queues[p_src->nb_outputs];
+        ni_pipeline_queue_init(p_node->p_in_queue, p_pipeline->queue_depth);
+        p_src->nb_outputs++;
+    }
+
+    p_pipeline->nb_nodes++;
+    return p_node;
+}
+
+int ni_pipeline_add_decoder(ni_pipeline_t *p_pipeline,
+                            ni_session_context_t *p_dec_ctx,
+                            ni_pipeline_read_packet_cb read_packet,
+                            void *opaque)
+{
+    ni_pipeline_node_t *p_node;
+
+    if (!read_packet || !p_dec_ctx || !p_dec_ctx->hw_action)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() decoder must output hw frames\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    p_node = ni_pipeline_new_node(p_pipeline, NI_PIPELINE_NODE_DECODER, -1,
+                                  p_dec_ctx);
+    if (!p_node)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    p_node->read_packet = read_packet;
+    p_node->opaque = opaque;
+    return p_node->id;
+}
+
+int ni_pipeline_add_scaler(ni_pipeline_t *p_pipeline, int src_node,
+                           ni_session_context_t *p_sca_ctx,
+                           const ni_scaler_input_params_t *p_params)
+{
+    ni_pipeline_node_t *p_node;
+
+    if (!p_params)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    p_node = ni_pipeline_new_node(p_pipeline, NI_PIPELINE_NODE_SCALER,
+                                  src_node, p_sca_ctx);
+    if (!p_node)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    p_node->scaler_params = *p_params;
+    return p_node->id;
+}
+
+int ni_pipeline_add_encoder(ni_pipeline_t *p_pipeline, int src_node,
+                            ni_session_context_t *p_enc_ctx,
+                            ni_pipeline_write_packet_cb write_packet,
+                            void *opaque)
+{
+    return ni_pipeline_add_encoder2(p_pipeline, src_node, p_enc_ctx, NULL,
+                                    write_packet, opaque);
+}
+
+int ni_pipeline_add_encoder2(ni_pipeline_t *p_pipeline, int src_node,
+                             ni_session_context_t *p_enc_ctx,
+                             ni_pipeline_open_encoder_cb open_encoder,
+                             ni_pipeline_write_packet_cb write_packet,
+                             void *opaque)
+{
+    ni_pipeline_node_t *p_node;
+
+    if (!write_packet || !p_enc_ctx || (!open_encoder && !p_enc_ctx->hw_action))
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() encoder must take hw frames\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    p_node = ni_pipeline_new_node(p_pipeline, NI_PIPELINE_NODE_ENCODER,
+                                  src_node, p_enc_ctx);
+    if (!p_node)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    p_node->write_packet = write_packet;
+    p_node->open_encoder = open_encoder;
+    p_node->opened = !open_encoder;
+    p_node->opaque = opaque;
+    return p_node->id;
+}
+
+ni_retcode_t ni_pipeline_start(ni_pipeline_t *p_pipeline)
+{
+    int i;
+
+    if (!p_pipeline || p_pipeline->started || !p_pipeline->nb_nodes ||
+        NI_PIPELINE_NODE_DECODER != p_pipeline->nodes[0].type)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < p_pipeline->nb_nodes; i++)
+    {
+        ni_pipeline_node_t *p_node = &p_pipeline->nodes[i];
+        if (NI_PIPELINE_NODE_SCALER == p_node->type &&
+            ni_scaler_frame_pool_alloc(p_node->p_ctx, p_node->scaler_params))
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() node %d pool alloc failed\n",
+                   __func__, i);
+            return NI_RETCODE_ERROR_MEM_ALOC;
+        }
+    }
+
+    p_pipeline->nb_active = p_pipeline->nb_nodes;
+    p_pipeline->start_time = ni_gettime_ns();
+    p_pipeline->started = 1;
+
+    for (i = 0; i < p_pipeline->nb_workers; i++)
+    {
+        p_pipeline->workers[i].p_pipeline = p_pipeline;
+        p_pipeline->workers[i].index = i;
+        if (ni_pthread_create(&p_pipeline->workers[i].thread, NULL,
+                              ni_pipeline_worker, &p_pipeline->workers[i]))
+        {
+            ni_log(NI_LOG_ERROR, "ERROR %d: %s() failed to create worker %d\n",
+                   NI_ERRNO, __func__, i);
+            p_pipeline->stop = 1;
+            p_pipeline->nb_workers = i;
+            return NI_RETCODE_FAILURE;
+        }
+    }
+
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_pipeline_wait(ni_pipeline_t *p_pipeline)
+{
+    ni_pipeline_frame_t entry;
+    int i, j;
+
+    if (!p_pipeline || !p_pipeline->started)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < p_pipeline->nb_workers; i++)
+    {
+        ni_pthread_join(p_pipeline->workers[i].thread, NULL);
+    }
+    p_pipeline->nb_workers = 0;
+
+    // release frames still sitting in links, then whatever the devices did
+    // not hand back
+    for (i = 0; i < p_pipeline->nb_nodes; i++)
+    {
+        ni_pipeline_node_t *p_node = &p_pipeline->nodes[i];
+        for (j = 0; j < p_node->nb_outputs; j++)
+        {
+            while (ni_pipeline_queue_peek(&p_node->out_queues[j], &entry))
+            {
+                if (!entry.end_of_stream)
+                {
+                    ni_pipeline_hwframe_unref(p_pipeline,
+                                              entry.surface.device_handle,
+                                              entry.surface.ui16session_ID,
+                                              entry.surface.ui16FrameIdx);
+                }
+                ni_pipeline_queue_pop(&p_node->out_queues[j]);
+            }
+        }
+    }
+
+    for (i = 0; i < p_pipeline->nb_hwframe_refs; i++)
+    {
+        if (p_pipeline->hwframe_refs[i].ref_cnt &&
+            p_pipeline->hwframe_refs[i].surface.ui16FrameIdx)
+        {
+            ni_log(NI_LOG_DEBUG, "%s: clean frame idx %u ref_cnt %d\n",
+                   __func__, p_pipeline->hwframe_refs[i].surface.ui16FrameIdx,
+                   p_pipeline->hwframe_refs[i].ref_cnt);
+            ni_hwframe_buffer_recycle2(&p_pipeline->hwframe_refs[i].surface);
+        }
+        p_pipeline->hwframe_refs[i].ref_cnt = 0;
+    }
+    p_pipeline->nb_hwframe_refs = 0;
+
+    return (p_pipeline->error || p_pipeline->nb_active) ? NI_RETCODE_FAILURE :
+                                                          NI_RETCODE_SUCCESS;
+}
+
+void ni_pipeline_stop(ni_pipeline_t *p_pipeline)
+{
+    if (p_pipeline)
+    {
+        p_pipeline->stop = 1;
+        ni_pipeline_wake(p_pipeline);
+    }
+}
+
+ni_retcode_t ni_pipeline_get_stats(ni_pipeline_t *p_pipeline, int node_id,
+                                   ni_pipeline_stats_t *p_stats)
+{
+    if (!p_pipeline || !p_stats || node_id < 0 ||
+        node_id >= p_pipeline->nb_nodes)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    ni_pthread_mutex_lock(&p_pipeline->mutex);
+    *p_stats = p_pipeline->nodes[node_id].stats;
+    ni_pthread_mutex_unlock(&p_pipeline->mutex);
+    if (p_pipeline->start_time)
+    {
+        p_stats->elapsed_ns = ni_gettime_ns() - p_pipeline->start_time;
+    }
+    p_stats->fps = p_stats->elapsed_ns ?
+        (double)p_stats->frames_out * 1000000000.0 / (double)p_stats->elapsed_ns :
+        0.0;
+    return NI_RETCODE_SUCCESS;
+}
+
+void ni_pipeline_free(ni_pipeline_t *p_pipeline)
+{
+    int i, j;
+
+    if (!p_pipeline)
+    {
+        return;
+    }
+
+    if (p_pipeline->started && p_pipeline->nb_workers)
+    {
+        ni_pipeline_stop(p_pipeline);
+        ni_pipeline_wait(p_pipeline);
+    }
+
+    for (i = 0; i < p_pipeline->nb_nodes; i++)
+    {
+        ni_pipeline_node_t *p_node = &p_pipeline->nodes[i];
+        if (NI_PIPELINE_NODE_DECODER == p_node->type)
+        {
+            ni_packet_buffer_free(&p_node->in_data.data.packet);
+            ni_frame_buffer_free(&p_node->out_data.data.frame);
+        } else if (NI_PIPELINE_NODE_SCALER == p_node->type)
+        {
+            ni_frame_buffer_free(&p_node->out_data.data.frame);
+        } else
+        {
+            ni_frame_buffer_free(&p_node->in_data.data.frame);
+            ni_packet_buffer_free(&p_node->out_data.data.packet);
+        }
+        for (j = 0; j < p_node->nb_outputs; j++)
+        {
+            ni_pthread_mutex_destroy(&p_node->out_queues[j].mutex);
+        }
+    }
+
+    ni_pthread_mutex_destroy(&p_pipeline->mutex);
+    ni_pthread_cond_destroy(&p_pipeline->cond);
+    free(p_pipeline);
+}
@@ -0,0 +1,230 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_pipeline.h
+ *
+ *  \brief  In-process pipeline graph that wires decoder, scaler and encoder
+ *          sessions together over hw frame descriptors
+ *
+ *          A pipeline is a tree rooted at one decoder. Every node may feed up
+ *          to NI_PIPELINE_MAX_OUTPUTS downstream nodes; a decoded or scaled hw
+ *          frame is shared by all of them through a reference count and is
+ *          recycled back to the device once the last consumer released it.
+ *          Nodes are stepped by a small pool of worker threads, links between
+ *          nodes are bounded queues so a slow encoder throttles the stages
+ *          upstream of it instead of exhausting the device frame pools.
+ ******************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ni_device_api.h"
+
+#ifdef _WIN32
+  #ifdef XCODER_DLL
+    #ifdef LIB_EXPORTS
+      #define LIB_API_PIPELINE __declspec(dllexport)
+    #else
+      #define LIB_API_PIPELINE __declspec(dllimport)
+    #endif
+  #else
+    #define LIB_API_PIPELINE
+  #endif
+#elif __linux__ || __APPLE__
+  #define LIB_API_PIPELINE
+#endif
+
+#define NI_PIPELINE_MAX_NODES       32
+#define NI_PIPELINE_MAX_OUTPUTS     8
+#define NI_PIPELINE_MAX_WORKERS     8
+#define NI_PIPELINE_DEFAULT_WORKERS 2
+#define NI_PIPELINE_DEFAULT_QDEPTH  4
+#define NI_PIPELINE_MAX_QDEPTH      32
+// idle wait of a worker when none of its nodes made progress
+#define NI_PIPELINE_IDLE_WAIT_US    100
+
+typedef enum _ni_pipeline_node_type
+{
+    NI_PIPELINE_NODE_DECODER = 0,
+    NI_PIPELINE_NODE_SCALER,
+    NI_PIPELINE_NODE_ENCODER,
+} ni_pipeline_node_type_t;
+
+/*!*****************************************************************************
+ *  \brief  Supply the next compressed packet to the pipeline decoder.
+ *
+ *          The callback owns bitstream parsing: it has to allocate and fill
+ *          p_packet (eg. with ni_packet_buffer_alloc()/ni_packet_copy()), or
+ *          set p_packet->end_of_stream when the input is exhausted.
+ *          start_of_stream is managed by the pipeline.
+ *
+ *  \return >0 packet (or EOS) supplied, 0 nothing available yet, <0 error
+ ******************************************************************************/
+typedef int (*ni_pipeline_read_packet_cb)(void *opaque, ni_packet_t *p_packet);
+
+/*!*****************************************************************************
+ *  \brief  Deliver an encoded packet produced by a pipeline encoder node.
+ *
+ *          p_packet->p_data starts with meta_size bytes of encoder metadata;
+ *          the packet buffer is reused by the pipeline after the call returns.
+ *          Called once more with p_packet->end_of_stream set and no payload.
+ *
+ *  \return 0 on success, <0 to abort the whole pipeline
+ ******************************************************************************/
+typedef int (*ni_pipeline_write_packet_cb)(void *opaque, int node_id,
+                                           ni_packet_t *p_packet,
+                                           int meta_size);
+
+/*!*****************************************************************************
+ *  \brief  Open a pipeline encoder node on its first input frame.
+ *
+ *          A hw frame encoder can only be opened once the first frame it will
+ *          take is known (eg. for ni_xcoder_params_t rootBufId and the
+ *          sender_handle of p_enc_ctx), so encoders added with
+ *          ni_pipeline_add_encoder2() are opened by the pipeline through this
+ *          callback when their first frame arrives.
+ *
+ *  \return 0 on success, <0 to abort the whole pipeline
+ ******************************************************************************/
+typedef int (*ni_pipeline_open_encoder_cb)(void *opaque, int node_id,
+                                           ni_session_context_t *p_enc_ctx,
+                                           const niFrameSurface1_t *p_surface);
+
+// per node throughput counters, see ni_pipeline_get_stats()
+typedef struct _ni_pipeline_stats
+{
+    uint64_t frames_in;      // frames (packets for decoder) accepted
+    uint64_t frames_out;     // frames (packets for encoder) produced
+    uint64_t bytes_in;       // compressed bytes sent to decoder
+    uint64_t bytes_out;      // compressed bytes received from encoder
+    uint64_t busy_ns;        // time spent in device calls that made progress
+    uint64_t blocked_ns;     // time output was held back by full queues
+    uint64_t elapsed_ns;     // time since ni_pipeline_start()
+    double   fps;            // frames_out / elapsed
+} ni_pipeline_stats_t;
+
+// opaque, see ni_pipeline_priv.h
+typedef struct _ni_pipeline ni_pipeline_t;
+
+/*!*****************************************************************************
+ *  \brief  Allocate an empty pipeline
+ *
+ *  \param[in] nb_workers   number of worker threads, 0 for default
+ *  \param[in] queue_depth  capacity of every link, 0 for default
+ *
+ *  \return pointer to the pipeline on success, NULL otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE ni_pipeline_t *ni_pipeline_alloc(int nb_workers,
+                                                  int queue_depth);
+
+/*!*****************************************************************************
+ *  \brief  Add the root decoder node. p_dec_ctx must already be opened with
+ *          hw_action = NI_CODEC_HW_ENABLE so that it outputs hw descriptors.
+ *
+ *  \return node id (>= 0) on success, negative ni_retcode_t otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE int ni_pipeline_add_decoder(ni_pipeline_t *p_pipeline,
+                                             ni_session_context_t *p_dec_ctx,
+                                             ni_pipeline_read_packet_cb read_packet,
+                                             void *opaque);
+
+/*!*****************************************************************************
+ *  \brief  Add a scaler node fed by src_node. p_sca_ctx must already be
+ *          opened; its output frame pool is allocated by ni_pipeline_start()
+ *          from p_params. input_width/input_height are taken per frame.
+ *
+ *  \return node id (>= 0) on success, negative ni_retcode_t otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE int ni_pipeline_add_scaler(ni_pipeline_t *p_pipeline,
+                                            int src_node,
+                                            ni_session_context_t *p_sca_ctx,
+                                            const ni_scaler_input_params_t *p_params);
+
+/*!*****************************************************************************
+ *  \brief  Add an encoder node fed by src_node. p_enc_ctx must already be
+ *          opened with hw frame input (hw_action = NI_CODEC_HW_ENABLE).
+ *
+ *  \return node id (>= 0) on success, negative ni_retcode_t otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE int ni_pipeline_add_encoder(ni_pipeline_t *p_pipeline,
+                                             int src_node,
+                                             ni_session_context_t *p_enc_ctx,
+                                             ni_pipeline_write_packet_cb write_packet,
+                                             void *opaque);
+
+/*!*****************************************************************************
+ *  \brief  Add an encoder node fed by src_node that is opened by open_encoder
+ *          when its first frame arrives. p_enc_ctx must be initialized with
+ *          ni_device_session_context_init() but not opened. open_encoder may
+ *          be NULL, this is then the same as ni_pipeline_add_encoder().
+ *
+ *  \return node id (>= 0) on success, negative ni_retcode_t otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE int ni_pipeline_add_encoder2(ni_pipeline_t *p_pipeline,
+                                              int src_node,
+                                              ni_session_context_t *p_enc_ctx,
+                                              ni_pipeline_open_encoder_cb open_encoder,
+                                              ni_pipeline_write_packet_cb write_packet,
+                                              void *opaque);
+
+/*!*****************************************************************************
+ *  \brief  Spawn the worker threads and start moving data
+ *
+ *  \return NI_RETCODE_SUCCESS on success, ni_retcode_t error otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE ni_retcode_t ni_pipeline_start(ni_pipeline_t *p_pipeline);
+
+/*!*****************************************************************************
+ *  \brief  Block until every encoder reached end of stream, or an error
+ *          occurred, then join the worker threads. Frames still referenced
+ *          by the pipeline are recycled.
+ *
+ *  \return NI_RETCODE_SUCCESS if the pipeline drained, error otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE ni_retcode_t ni_pipeline_wait(ni_pipeline_t *p_pipeline);
+
+/*!*****************************************************************************
+ *  \brief  Request the workers to stop without draining
+ ******************************************************************************/
+LIB_API_PIPELINE void ni_pipeline_stop(ni_pipeline_t *p_pipeline);
+
+/*!*****************************************************************************
+ *  \brief  Snapshot the throughput counters of a node
+ *
+ *  \return NI_RETCODE_SUCCESS on success, NI_RETCODE_INVALID_PARAM otherwise
+ ******************************************************************************/
+LIB_API_PIPELINE ni_retcode_t ni_pipeline_get_stats(ni_pipeline_t *p_pipeline,
+                                                    int node_id,
+                                                    ni_pipeline_stats_t *p_stats);
+
+/*!*****************************************************************************
+ *  \brief  Stop the pipeline if still running and free it. Sessions wired
+ *          into the pipeline are not closed.
+ ******************************************************************************/
+LIB_API_PIPELINE void ni_pipeline_free(ni_pipeline_t *p_pipeline);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,138 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_pipeline_priv.h
+ *
+ *  \brief  Private definitions used by ni_pipeline.c
+ ******************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ni_pipeline.h"
+
+// hw frames referenced by the pipeline at the same time, across all nodes
+#define NI_PIPELINE_MAX_HWFRAME_REFS 1024
+
+// entry carried on a link between two nodes
+typedef struct _ni_pipeline_frame
+{
+    niFrameSurface1_t surface;
+    int64_t pts;
+    int end_of_stream;
+} ni_pipeline_frame_t;
+
+// bounded single-producer/single-consumer link
+typedef struct _ni_pipeline_queue
+{
+    ni_pipeline_frame_t entries[NI_PIPELINE_MAX_QDEPTH];
+    int head;
+    int tail;
+    int count;
+    int capacity;
+    ni_pthread_mutex_t mutex;
+} ni_pipeline_queue_t;
+
+typedef struct _ni_pipeline_worker
+{
+    ni_pipeline_t *p_pipeline;
+    ni_pthread_t thread;
+    int index;
+} ni_pipeline_worker_t;
+
+typedef struct _ni_pipeline_node
+{
+    ni_pipeline_t *p_pipeline;
+    ni_pipeline_node_type_t type;
+    int id;
+    int worker;
+    ni_session_context_t *p_ctx;
+
+    // topology: one input link and the links feeding downstream nodes
+    ni_pipeline_queue_t *p_in_queue;
+    ni_pipeline_queue_t out_queues[NI_PIPELINE_MAX_OUTPUTS];
+    int nb_outputs;
+
+    // decoder source
+    ni_pipeline_read_packet_cb read_packet;
+    // encoder sink, and its deferred open
+    ni_pipeline_write_packet_cb write_packet;
+    ni_pipeline_open_encoder_cb open_encoder;
+    void *opaque;
+
+    // scaler operation applied to every input frame
+    ni_scaler_input_params_t scaler_params;
+
+    // owner of the frames on the input link, they all come from one session
+    int32_t in_device_handle;
+    uint16_t in_session_id;
+
+    ni_session_data_io_t in_data;
+    ni_session_data_io_t out_data;
+    int opened;
+    int pending_send;
+    int sos_sent;
+    int eos_sent;
+    int eos_received;
+    uint64_t blocked_since;
+
+    // protected by the pipeline mutex
+    ni_pipeline_stats_t stats;
+} ni_pipeline_node_t;
+
+// hw frame reference shared by all consumers of a fanned out frame, looked up
+// by device handle, session id and frame index of its surface: frame indices
+// are only unique within the session that allocated them
+typedef struct _ni_pipeline_hwframe_ref
+{
+    int ref_cnt;
+    niFrameSurface1_t surface;
+} ni_pipeline_hwframe_ref_t;
+
+struct _ni_pipeline
+{
+    ni_pipeline_node_t nodes[NI_PIPELINE_MAX_NODES];
+    int nb_nodes;
+
+    ni_pipeline_worker_t workers[NI_PIPELINE_MAX_WORKERS];
+    int nb_workers;
+    int queue_depth;
+    int started;
+    volatile int stop;
+    volatile int error;
+    volatile int nb_active;
+    uint64_t start_time;
+
+    ni_pthread_mutex_t mutex;
+    ni_pthread_cond_t cond;
+
+    // protected by mutex, slots with ref_cnt 0 are free
+    ni_pipeline_hwframe_ref_t hwframe_refs[NI_PIPELINE_MAX_HWFRAME_REFS];
+    int nb_hwframe_refs;       // high water mark of the used slots
+};
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,8 @@
 #include <dirent.h>
 #include <sys/mman.h>
 #include <stdbool.h>
+#include "ni_util.h"
+#include "ni_quadraprobe.h"
 
 #define LOG_SIZE     (1024 * 1024)
 #define NUM_CORES    5
@@ -288,4 +290,276 @@ int ni_rsrc_log_dump(const char *outdir, bool core_reset_log)
     free(devs);
     return (fail_count == 0) ? 0 : 2;
 }
+
+#define CORE_LOG_OFFSET_TABLE       0xf8f5000
+#define CORE_RESET_LOG_OFFSET_TABLE 0xf8fd0c0
+// changes closer than this are reported as one record
+#define LOG_TAIL_MERGE_GAP          64
+// the patrol compares 1/LOG_TAIL_PATROL_DIV of the window per poll
+#define LOG_TAIL_PATROL_DIV         8
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+} LogRun;
+
+struct _ni_fw_log_tail {
+    QuadraDevice qd;
+    bool core_reset_log;
+    bool primed;
+    uint64_t last_ns;
+    uint32_t window;                   // bytes compared after the cursor
+    uint32_t patrol_len;               // bytes compared at the patrol
+    uint8_t *snap[NUM_CORES];          // ring contents at the previous poll
+    uint32_t snap_offset[NUM_CORES];   // ring offset the snapshot was taken at
+    uint32_t cursor[NUM_CORES];        // end of the last data seen
+    uint32_t patrol[NUM_CORES];        // sweeps the rest of the ring
+    LogRun *runs;
+    int max_runs;
+};
+
+static int log_tail_read_offsets(ni_fw_log_tail_t *p_tail)
+{
+    QuadraDevice *qd = &p_tail->qd;
+    off_t table = p_tail->core_reset_log ? CORE_RESET_LOG_OFFSET_TABLE :
+                                           CORE_LOG_OFFSET_TABLE;
+    if (qd->barsize < table + 4 * NUM_CORES)
+    {
+        (void)fprintf(stderr, "BAR4 too small for log offsets: %lld bytes\n",
+                      (long long)qd->barsize);
+        return -1;
+    }
+    if (p_tail->core_reset_log)
+    {
+        fill_core_reset_log_offsets(qd);
+    }
+    else
+    {
+        fill_core_log_offsets(qd);
+    }
+    return 0;
+}
+
+static bool log_tail_ring_valid(const ni_fw_log_tail_t *p_tail, int core)
+{
+    const QuadraDevice *qd = &p_tail->qd;
+    return (off_t)qd->core_log_offsets[core] + qd->log_size <= qd->barsize;
+}
+
+ni_fw_log_tail_t *ni_fw_log_tail_open(const char *bar_path, bool core_reset_log)
+{
+    char bar4path[PATH_MAX];
+    struct stat bar4stat;
+    ni_fw_log_tail_t *p_tail;
+
+    if (bar_path)
+    {
+        if (snprintf(bar4path, sizeof(bar4path), "%s", bar_path) >= (int)sizeof(bar4path))
+            return NULL;
+    }
+    else
+    {
+        QuadraDevice *devs = NULL;
+        int ndev = quadra_device_find(&devs);
+        if (ndev <= 0)
+        {
+            free(devs);
+            (void)fprintf(stderr, "[WARN] No Quadra devices found in sysfs (vendor 1d82).\n");
+            return NULL;
+        }
+        int rc = snprintf(bar4path, sizeof(bar4path), "%s/resource4", devs[0].sysfs_path);
+        free(devs);
+        if (rc < 0 || rc >= (int)sizeof(bar4path))
+            return NULL;
+    }
+
+    p_tail = calloc(1, sizeof(*p_tail));
+    if (!p_tail)
+        return NULL;
+    p_tail->core_reset_log = core_reset_log;
+    p_tail->qd.bar4_fd = -1;
+    p_tail->qd.bar4_base = MAP_FAILED;
+    // read only: polling the logs must never disturb the card
+    p_tail->qd.bar4_fd = open(bar4path, O_RDONLY | O_SYNC);
+    if (p_tail->qd.bar4_fd == -1)
+    {
+        (void)fprintf(stderr, "Failed to open %s: %s\n", bar4path, strerror(errno));
+        goto fail;
+    }
+    if (fstat(p_tail->qd.bar4_fd, &bar4stat) != 0)
+    {
+        perror("fstat(bar4)");
+        goto fail;
+    }
+    p_tail->qd.barsize = bar4stat.st_size;
+    p_tail->qd.bar4_base = mmap(NULL, p_tail->qd.barsize, PROT_READ, MAP_SHARED,
+                                p_tail->qd.bar4_fd, 0);
+    if (p_tail->qd.bar4_base == MAP_FAILED)
+    {
+        (void)fprintf(stderr, "Failed to mmap BAR4 at %s: %s\n", bar4path, strerror(errno));
+        goto fail;
+    }
+    if (log_tail_read_offsets(p_tail) != 0)
+        goto fail;
+
+    for (int i = 0; i < NUM_CORES; ++i)
+    {
+        p_tail->snap[i] = malloc((size_t)p_tail->qd.log_size);
+        if (!p_tail->snap[i])
+            goto fail;
+    }
+    ni_fw_log_tail_set_window(p_tail, NI_FW_LOG_TAIL_DEFAULT_WINDOW);
+    // runs are separated by at least LOG_TAIL_MERGE_GAP unchanged bytes, or
+    // by the end of the ring
+    p_tail->max_runs = p_tail->qd.log_size / LOG_TAIL_MERGE_GAP + 2;
+    p_tail->runs = malloc(sizeof(LogRun) * (size_t)p_tail->max_runs);
+    if (!p_tail->runs)
+        goto fail;
+    return p_tail;
+
+fail:
+    ni_fw_log_tail_close(p_tail);
+    return NULL;
+}
+
+int ni_fw_log_tail_set_window(ni_fw_log_tail_t *p_tail, uint32_t window)
+{
+    uint32_t log_size;
+
+    if (!p_tail)
+        return -1;
+
+    log_size = (uint32_t)p_tail->qd.log_size;
+    if (!window || window > log_size)
+        window = log_size;
+    p_tail->window = (window + 7) & ~7u;
+    p_tail->patrol_len = (p_tail->window < log_size) ?
+        (((p_tail->window / LOG_TAIL_PATROL_DIV) + 7) & ~7u) : 0;
+    return 0;
+}
+
+// Compare len bytes of a ring from start with its snapshot, a word at a time
+// so that each word is read from the BAR only once, and add the changes to
+// the runs of p_tail after the nb_runs already found. Returns the new number
+// of runs.
+static int log_tail_scan(ni_fw_log_tail_t *p_tail, const uint8_t *ring,
+                         uint8_t *snap, uint32_t start, uint32_t len,
+                         int nb_runs)
+{
+    uint32_t log_size = (uint32_t)p_tail->qd.log_size;
+
+    for (uint32_t rel = 0; rel < len; rel += 8)
+    {
+        uint32_t pos = (start + rel) % log_size;
+        uint64_t word;
+        memcpy(&word, ring + pos, 8);
+        if (memcmp(&word, snap + pos, 8) == 0)
+            continue;
+        memcpy(snap + pos, &word, 8);
+        // a record never wraps around the end of the ring
+        if (nb_runs && pos &&
+            pos - p_tail->runs[nb_runs - 1].end < LOG_TAIL_MERGE_GAP)
+        {
+            p_tail->runs[nb_runs - 1].end = pos + 8;
+        }
+        else if (nb_runs < p_tail->max_runs)
+        {
+            p_tail->runs[nb_runs].start = pos;
+            p_tail->runs[nb_runs].end = pos + 8;
+            nb_runs++;
+        }
+    }
+    return nb_runs;
+}
+
+int ni_fw_log_tail_poll(ni_fw_log_tail_t *p_tail, ni_fw_log_record_cb cb,
+                        void *opaque)
+{
+    if (!p_tail)
+        return -1;
+
+    uint64_t now_ns = ni_gettime_ns();
+    uint32_t log_size = (uint32_t)p_tail->qd.log_size;
+    int nb_records = 0;
+
+    if (log_tail_read_offsets(p_tail) != 0)
+        return -1;
+
+    for (int core = 0; core < NUM_CORES; ++core)
+    {
+        uint32_t ring_offset = p_tail->qd.core_log_offsets[core];
+        const uint8_t *ring = p_tail->qd.bar4_base + ring_offset;
+        uint8_t *snap = p_tail->snap[core];
+
+        if (!log_tail_ring_valid(p_tail, core))
+        {
+            continue;
+        }
+        if (!p_tail->primed || ring_offset != p_tail->snap_offset[core])
+        {
+            // first poll, or the firmware moved the ring: start over from
+            // here. Until a ring wraps around the firmware writes after its
+            // last non zero data.
+            uint32_t end = log_size;
+            memcpy(snap, ring, log_size);
+            while (end && !snap[end - 1])
+                end--;
+            p_tail->snap_offset[core] = ring_offset;
+            p_tail->cursor[core] = ((end + 7) & ~7u) % log_size;
+            p_tail->patrol[core] = p_tail->cursor[core];
+            continue;
+        }
+
+        // the firmware goes on writing after the last data seen. When there
+        // is none, the patrol looks for data written anywhere else, eg. by a
+        // ring that had wrapped around when the tailer was opened; it waits
+        // otherwise so that data is reported in order.
+        int nb_runs = log_tail_scan(p_tail, ring, snap, p_tail->cursor[core],
+                                    p_tail->window, 0);
+        if (!nb_runs && p_tail->patrol_len)
+        {
+            p_tail->patrol[core] =
+                (p_tail->patrol[core] + p_tail->patrol_len) % log_size;
+            nb_runs = log_tail_scan(p_tail, ring, snap, p_tail->patrol[core],
+                                    p_tail->patrol_len, 0);
+        }
+        if (!nb_runs)
+            continue;
+
+        for (int i = 0; i < nb_runs; ++i)
+        {
+            const LogRun *run = &p_tail->runs[i];
+            ni_fw_log_record_t record;
+            record.core = core;
+            record.core_name = core_names[core];
+            record.ring_offset = run->start;
+            record.data = snap + run->start;
+            record.len = run->end - run->start;
+            record.seen_after_ns = p_tail->last_ns;
+            record.seen_before_ns = now_ns;
+            if (cb)
+                cb(opaque, &record);
+            nb_records++;
+        }
+        p_tail->cursor[core] = p_tail->runs[nb_runs - 1].end % log_size;
+    }
+
+    p_tail->primed = true;
+    p_tail->last_ns = now_ns;
+    return nb_records;
+}
+
+void ni_fw_log_tail_close(ni_fw_log_tail_t *p_tail)
+{
+    if (!p_tail)
+        return;
+    if (p_tail->qd.bar4_base != MAP_FAILED && p_tail->qd.bar4_base)
+        munmap(p_tail->qd.bar4_base, p_tail->qd.barsize);
+    if (p_tail->qd.bar4_fd >= 0)
+        close(p_tail->qd.bar4_fd);
+    for (int i = 0; i < NUM_CORES; ++i)
+        free(p_tail->snap[i]);
+    free(p_tail->runs);
+    free(p_tail);
+}
 #endif
@@ -48,6 +48,93 @@ extern "C"
  ******************************************************************************/
 #if defined(__linux__)
 LIB_API int ni_rsrc_log_dump(const char *outdir, bool core_reset_log);
+
+/*!*****************************************************************************
+ *  \brief  Firmware log data that appeared in a core log ring between two
+ *          polls of a log tailer, see ni_fw_log_tail_poll()
+ *
+ *  The firmware does not timestamp its records in host time; the data was
+ *  written between seen_after_ns and seen_before_ns, both taken with
+ *  ni_gettime_ns(), so it can be placed among host side session events
+ *  stamped with the same clock.
+ ******************************************************************************/
+typedef struct _ni_fw_log_record
+{
+    int core;                 // core index, in np, dp, ep, tp, fp order
+    const char *core_name;    // "np", "dp", "ep", "tp" or "fp"
+    uint32_t ring_offset;     // offset of data in the core log ring
+    const uint8_t *data;      // valid during the callback only
+    uint32_t len;
+    uint64_t seen_after_ns;   // time of the previous poll
+    uint64_t seen_before_ns;  // time of this poll
+} ni_fw_log_record_t;
+
+typedef void (*ni_fw_log_record_cb)(void *opaque,
+                                    const ni_fw_log_record_t *p_record);
+
+typedef struct _ni_fw_log_tail ni_fw_log_tail_t;
+
+/// Bytes of each core log ring a poll compares by default, see
+/// ni_fw_log_tail_set_window()
+#define NI_FW_LOG_TAIL_DEFAULT_WINDOW (64 * 1024)
+
+/*!*****************************************************************************
+ *  \brief  Start tailing the firmware core logs of a card through its mapped
+ *          BAR4, without sending any command to the card
+ *
+ *  The log rings are mapped read only. The first ni_fw_log_tail_poll() only
+ *  takes a snapshot of them, use ni_rsrc_log_dump() for the history.
+ *
+ *  \param[in] bar_path        BAR4 resource of the card, eg.
+ *                             "/sys/bus/pci/devices/0000:01:00.0/resource4",
+ *                             or a file of the same layout. NULL for the
+ *                             first Quadra card found.
+ *  \param[in] core_reset_log  tail the core reset logs instead
+ *
+ *  \return tailer on success, NULL otherwise
+ ******************************************************************************/
+LIB_API ni_fw_log_tail_t *ni_fw_log_tail_open(const char *bar_path,
+                                              bool core_reset_log);
+
+/*!*****************************************************************************
+ *  \brief  Set how many bytes of each core log ring a poll compares with
+ *          its snapshot, NI_FW_LOG_TAIL_DEFAULT_WINDOW by default. The
+ *          window starts after the last data seen of the core, where the
+ *          firmware goes on writing. A poll that finds nothing there
+ *          compares an eighth of the window at a position that sweeps the
+ *          rest of the ring, to find data written elsewhere, eg. after the
+ *          ring wrapped around. Data written past the window is reported by
+ *          the following polls.
+ *
+ *  \param[in] p_tail     tailer
+ *  \param[in] window     bytes per ring and poll, 0 for the whole ring
+ *
+ *  \return 0 on success, -1 if p_tail is NULL
+ ******************************************************************************/
+LIB_API int ni_fw_log_tail_set_window(ni_fw_log_tail_t *p_tail,
+                                      uint32_t window);
+
+/*!*****************************************************************************
+ *  \brief  Report the log data written since the previous poll. The rings
+ *          are compared with a snapshot of the previous poll over a window
+ *          following the last data seen, see ni_fw_log_tail_set_window(), so
+ *          a poll reads a bounded part of the BAR. Data is lost only if a
+ *          ring wraps around entirely before the polls reach it. Data of a
+ *          core is reported in ring order, one record per contiguous change.
+ *
+ *  \param[in] p_tail     tailer
+ *  \param[in] cb         called for each record, may be NULL
+ *  \param[in] opaque     passed to cb
+ *
+ *  \return number of records, negative on error
+ ******************************************************************************/
+LIB_API int ni_fw_log_tail_poll(ni_fw_log_tail_t *p_tail, ni_fw_log_record_cb cb,
+                                void *opaque);
+
+/*!*****************************************************************************
+ *  \brief  Unmap the BAR and free a tailer
+ ******************************************************************************/
+LIB_API void ni_fw_log_tail_close(ni_fw_log_tail_t *p_tail);
 #endif
 
 #ifdef __cplusplus
@@ -46,6 +46,10 @@
 #include <sys/syslimits.h>
 #endif
 
+#if (__linux__ || __APPLE__) && !defined(_ANDROID) && !defined(__OPENHARMONY__)
+#define NI_RSRC_CONTEXT_CACHE
+#endif
+
 #include "ni_rsrc_api.h"
 #include "ni_rsrc_priv.h"
 #include "ni_util.h"
@@ -881,6 +885,114 @@ NI_DEPRECATED int ni_rsrc_get_local_device_list(char ni_devices[][NI_MAX_DEVICE_
 }
 #endif
 
+#define NI_RSRC_MAX_NVME_DEV_CNT 200
+#define NI_RSRC_MAX_PROBE_THREADS 16
+
+typedef struct _ni_rsrc_probe_job
+{
+    char (*dev_names)[NI_MAX_DEVICE_NAME_LEN];
+    int *is_xcoder;
+    int dev_cnt;
+    int next;                 // next device to probe, taken atomically
+    char **xcoder_refresh_dev_names;
+    int xcoder_refresh_dev_count;
+} ni_rsrc_probe_job_t;
+
+/*!*****************************************************************************
+ *  \brief  Identify one device: precheck it, then open it and query its
+ *          capability
+ *
+ *  \param[in]  dev_name        device name, eg. "/dev/nvme0n1"
+ *  \param[in]  device_in_ctxt  the device is in the current resource pool
+ *
+ *  \return  1 if the device is a supported NETINT transcoder, 0 otherwise
+ ******************************************************************************/
+static int ni_rsrc_probe_device(const char *dev_name, bool device_in_ctxt)
+{
+  ni_device_capability_t device_capabilites;
+  ni_device_handle_t dev_handle;
+  int is_xcoder = 0;
+
+  if (ni_quadra_card_identify_precheck(dev_name) != NI_RETCODE_SUCCESS)
+  {
+      return 0;
+  }
+
+  dev_handle = ni_device_open2(dev_name, NI_DEVICE_READ_ONLY);
+  if (NI_INVALID_DEVICE_HANDLE != dev_handle)
+  {
+      memset(&device_capabilites, 0, sizeof(ni_device_capability_t));
+      if (NI_RETCODE_SUCCESS ==
+              ni_device_capability_query2(dev_handle, &device_capabilites,
+                                          device_in_ctxt) &&
+          is_supported_xcoder(device_capabilites.device_is_xcoder))
+      {
+          is_xcoder = 1;
+      }
+      ni_device_close(dev_handle);
+  }
+  return is_xcoder;
+}
+
+static void *ni_rsrc_probe_worker(void *arg)
+{
+  ni_rsrc_probe_job_t *p_job = (ni_rsrc_probe_job_t *)arg;
+  bool device_in_ctxt;
+  int i, j;
+
+  while ((i = __atomic_fetch_add(&p_job->next, 1, __ATOMIC_RELAXED)) <
+         p_job->dev_cnt)
+  {
+      device_in_ctxt = false;
+      for (j = 0; j < p_job->xcoder_refresh_dev_count; j++)
+      {
+          if (0 == strcmp(p_job->dev_names[i],
+                          p_job->xcoder_refresh_dev_names[j]))
+          {
+              device_in_ctxt = true;
+              break;
+          }
+      }
+      p_job->is_xcoder[i] = ni_rsrc_probe_device(p_job->dev_names[i],
+                                                 device_in_ctxt);
+  }
+  return NULL;
+}
+
+/*!*****************************************************************************
+ *  \brief  Probe all devices of a job. Each identify command blocks on its
+ *          own device, so they are spread over up to
+ *          NI_RSRC_MAX_PROBE_THREADS threads. The calling thread takes part
+ *          and probes everything itself if no thread can be created.
+ *
+ *  \param[in,out]  p_job  devices to probe and their results
+ *
+ *  \return  None
+ ******************************************************************************/
+static void ni_rsrc_probe_devices(ni_rsrc_probe_job_t *p_job)
+{
+  ni_pthread_t threads[NI_RSRC_MAX_PROBE_THREADS];
+  int nb_threads = 0;
+  int i;
+
+  for (i = 1; i < ni_min(p_job->dev_cnt, NI_RSRC_MAX_PROBE_THREADS); i++)
+  {
+      if (ni_pthread_create(&threads[nb_threads], NULL, ni_rsrc_probe_worker,
+                            p_job) != 0)
+      {
+          break;
+      }
+      nb_threads++;
+  }
+
+  ni_rsrc_probe_worker(p_job);
+
+  for (i = 0; i < nb_threads; i++)
+  {
+      ni_pthread_join(threads[i], NULL);
+  }
+}
+
 /*!*****************************************************************************
  *  \brief  Scans system for all NVMe devices and returns the system device
  *          names to the user which were identified as NETINT transcoder
@@ -914,11 +1026,7 @@ int ni_rsrc_get_local_device_list2(char ni_devices[][NI_MAX_DEVICE_NAME_LEN],
   int i, xcoder_device_cnt = 0;
   DIR* FD;
   struct dirent* in_file;
-  ni_device_info_t device_info;
-  ni_device_capability_t device_capabilites;
-  ni_device_handle_t dev_handle = NI_INVALID_DEVICE_HANDLE;
-  ni_retcode_t rc;
-  bool device_in_ctxt = false;
+  ni_rsrc_probe_job_t probe_job;
 
   if ((ni_devices == NULL)||(max_handles == 0))
   {
@@ -928,6 +1036,9 @@ int ni_rsrc_get_local_device_list2(char ni_devices[][NI_MAX_DEVICE_NAME_LEN],
 
   int nvme_dev_cnt = 0;
   char nvme_devices[200][NI_MAX_DEVICE_NAME_LEN];
+  int probe_dev_cnt = 0;
+  char probe_dev_names[NI_RSRC_MAX_NVME_DEV_CNT][NI_MAX_DEVICE_NAME_LEN];
+  int probe_is_xcoder[NI_RSRC_MAX_NVME_DEV_CNT];
 
   regex_t regex;
   // GNU ERE not support /d, use [0-9] or [[:digit:]] instead
@@ -953,8 +1064,7 @@ int ni_rsrc_get_local_device_list2(char ni_devices[][NI_MAX_DEVICE_NAME_LEN],
   ++android_dir_num;
 
   nvme_dev_cnt = 0;
-  device_in_ctxt = false;
-  dev_handle = NI_INVALID_DEVICE_HANDLE;
+  probe_dev_cnt = 0;
   // g_dev_handle = NI_INVALID_DEVICE_HANDLE;
   size_t size_of_nvme_devices_x = sizeof(nvme_devices)/sizeof(nvme_devices[0]);
   for(size_t dimx = 0; dimx < size_of_nvme_devices_x; ++dimx)
@@ -1008,66 +1118,56 @@ int ni_rsrc_get_local_device_list2(char ni_devices[][NI_MAX_DEVICE_NAME_LEN],
             }
             nvme_dev_cnt++;
         }
-          int skip_this = 0;
-          skip_this = regexec(&regex, in_file->d_name, 0, NULL, 0);
-          ni_log(NI_LOG_TRACE, "name: %s skip %d\n", in_file->d_name, skip_this);
-
-          if (!skip_this)
+          if (!regexec(&regex, in_file->d_name, 0, NULL, 0))
           {
-              memset(&device_info, 0, sizeof(ni_device_info_t));
-              if (snprintf(device_info.dev_name, NI_MAX_DEVICE_NAME_LEN - 6,
-                           "%s/%s", dir_name, in_file->d_name) < 0)
+              ni_log(NI_LOG_TRACE, "name: %s candidate\n", in_file->d_name);
+              if (probe_dev_cnt >= NI_RSRC_MAX_NVME_DEV_CNT)
               {
                   ni_log(NI_LOG_ERROR,
-                         "ERROR: failed an snprintf() in "
-                         "ni_rsrc_get_local_device_list2()\n");
+                         "Disregarding %s over limit of %d candidates\n",
+                         in_file->d_name, NI_RSRC_MAX_NVME_DEV_CNT);
                   continue;
               }
-              ni_strncpy(device_info.blk_name, NI_MAX_DEVICE_NAME_LEN, device_info.dev_name,
-                      (NI_MAX_DEVICE_NAME_LEN-1));
-              memset(&device_capabilites, 0, sizeof(ni_device_capability_t));
-
-              device_in_ctxt = false;
-              for (int j = 0; j < xcoder_refresh_dev_count; j++)
-              {
-                  if (0 ==
-                      strcmp(device_info.dev_name,
-                             xcoder_refresh_dev_names[j]))
-                  {
-                      device_in_ctxt = true;
-                      break;
-                  }
-              }
-              if (NI_RETCODE_SUCCESS != ni_check_dev_name(device_info.dev_name))
+              if (snprintf(probe_dev_names[probe_dev_cnt],
+                           NI_MAX_DEVICE_NAME_LEN - 6, "%s/%s", dir_name,
+                           in_file->d_name) < 0)
               {
+                  ni_log(NI_LOG_ERROR,
+                         "ERROR: failed an snprintf() in "
+                         "ni_rsrc_get_local_device_list2()\n");
                   continue;
               }
-              if (ni_quadra_card_identify_precheck(device_info.dev_name) != NI_RETCODE_SUCCESS)
+              // drop devices sysfs reports as non NETINT before opening them
+              if (NI_RETCODE_SUCCESS !=
+                  ni_check_dev_name(probe_dev_names[probe_dev_cnt]) ||
+                  NI_RETCODE_SUCCESS !=
+                  ni_quadra_card_vendor_precheck(probe_dev_names[probe_dev_cnt]))
               {
                   continue;
               }
-              dev_handle = ni_device_open2(device_info.dev_name, NI_DEVICE_READ_ONLY);
-
-              if (NI_INVALID_DEVICE_HANDLE != dev_handle)
-              {
-                rc = ni_device_capability_query2(dev_handle,
-                                                &device_capabilites, device_in_ctxt);
-                if (NI_RETCODE_SUCCESS == rc)
-                {
-                    if (is_supported_xcoder(
-                            device_capabilites.device_is_xcoder))
-                    {
-                        ni_devices[xcoder_device_cnt][0] = '\0';
-                        ni_strcat(ni_devices[xcoder_device_cnt], NI_MAX_DEVICE_NAME_LEN,
-                                device_info.dev_name);
-                        xcoder_device_cnt++;
-                    }
-                }
-
-                ni_device_close(dev_handle);
-              }
+              probe_dev_cnt++;
           }
       }
+  }
+  closedir(FD);
+
+  // identify the candidates in parallel, they are independent devices
+  qsort(probe_dev_names, probe_dev_cnt, (size_t)NI_MAX_DEVICE_NAME_LEN,
+        ni_rsrc_strcmp);
+  probe_job.dev_names = probe_dev_names;
+  probe_job.is_xcoder = probe_is_xcoder;
+  probe_job.dev_cnt = probe_dev_cnt;
+  probe_job.next = 0;
+  probe_job.xcoder_refresh_dev_names = xcoder_refresh_dev_names;
+  probe_job.xcoder_refresh_dev_count = xcoder_refresh_dev_count;
+  ni_rsrc_probe_devices(&probe_job);
+
+  for (i = 0; i < probe_dev_cnt; i++)
+  {
+      if (!probe_is_xcoder[i])
+      {
+          continue;
+      }
       if ((NI_MAX_DEVICE_CNT <= xcoder_device_cnt) ||
           (max_handles <= xcoder_device_cnt))
       {
@@ -1077,17 +1177,17 @@ int ni_rsrc_get_local_device_list2(char ni_devices[][NI_MAX_DEVICE_NAME_LEN],
                  NI_MAX_DEVICE_CNT, max_handles);
           break;
       }
+      ni_devices[xcoder_device_cnt][0] = '\0';
+      ni_strcat(ni_devices[xcoder_device_cnt], NI_MAX_DEVICE_NAME_LEN,
+                probe_dev_names[i]);
+      xcoder_device_cnt++;
   }
-  closedir(FD);
 
 #ifdef _ANDROID
  }//while brace
 #endif
 
   regfree(&regex);
-
-  qsort(ni_devices, xcoder_device_cnt, (size_t)NI_MAX_DEVICE_NAME_LEN,
-        ni_rsrc_strcmp);
   if (0 == xcoder_device_cnt)
   {
       ni_log(NI_LOG_INFO, "Found %d NVMe devices on system, none of them xcoder\n", nvme_dev_cnt);
@@ -1152,7 +1252,7 @@ ni_device_pool_t* ni_rsrc_get_device_pool(void)
   }
 
 END:
-  lockf(lock, F_ULOCK, 0);
+  ni_rsrc_unlock_fd(lock);
 
   if (NULL == p_device_pool) {
     close(lock);
@@ -1248,21 +1348,10 @@ int ni_rsrc_init(int should_match_rev, int timeout_seconds)
 }
 
 /*!******************************************************************************
-* \brief      Allocates and returns a pointer to ni_device_context_t struct
-*             based on provided device_type and guid.
-*             To be used for load update and codec query.
-*
- *  \param[in]  device_type  NI_DEVICE_TYPE_DECODER or NI_DEVICE_TYPE_ENCODER
- *  \param[in]  guid         GUID of the encoder or decoder device
-*
-* \return     pointer to ni_device_context_t if found, NULL otherwise
-*
-*  Note:     The returned ni_device_context_t content is not supposed to be used by
-*            caller directly: should only be passed to API in the subsequent
-*            calls; also after its use, the context should be released by
-*            calling ni_rsrc_free_device_context.
+* \brief      Lock, open and map the shared device info of device_type and guid
+*             into a newly allocated ni_device_context_t, bypassing the cache.
 *******************************************************************************/
-ni_device_context_t* ni_rsrc_get_device_context(ni_device_type_t device_type, int guid)
+static ni_device_context_t *ni_rsrc_open_device_context(ni_device_type_t device_type, int guid)
 {
     /*! get names of shared mem and lock by GUID */
   int shm_fd = -1;
@@ -1314,7 +1403,7 @@ ni_device_context_t* ni_rsrc_get_device_context(ni_device_type_t device_type, in
   p_device_context->p_device_info = p_device_queue;
 
 END:
-  lockf(lock, F_ULOCK, 0);
+  ni_rsrc_unlock_fd(lock);
 
 #ifndef __OPENHARMONY__
   if (shm_fd >= 0) {
@@ -1324,6 +1413,202 @@ END:
 
   return p_device_context;
 }
+
+#ifdef NI_RSRC_CONTEXT_CACHE
+/*
+ * Process wide cache of device contexts. Mapping a device info segment takes
+ * a lock file open, shm_open, mmap and their teardown, and the least-load
+ * scans do that for every card on every session start. Contexts are kept
+ * mapped instead and only rebuilt when the generation of the device queue
+ * changes, ie. when a device was added or removed by any process.
+ */
+typedef struct _ni_rsrc_cached_context
+{
+  struct _ni_rsrc_cached_context *next;
+  ni_device_type_t device_type;
+  int guid;
+  int ref_cnt;
+  ni_device_context_t *p_context;
+} ni_rsrc_cached_context_t;
+
+static ni_pthread_mutex_t g_rsrc_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ni_rsrc_cached_context_t *g_rsrc_cache = NULL;
+// contexts dropped from the cache while still handed out
+static ni_rsrc_cached_context_t *g_rsrc_cache_stale = NULL;
+static ni_device_queue_t *g_rsrc_cache_queue = NULL;
+static uint32_t g_rsrc_cache_generation = 0;
+
+static void ni_rsrc_close_device_context(ni_device_context_t *p_device_context)
+{
+  close(p_device_context->lock);
+  ni_rsrc_munmap_shm((void *)p_device_context->p_device_info, sizeof(ni_device_info_t));
+  ni_log(NI_LOG_DEBUG, "in %s do munmap for %s\n", __func__, p_device_context->shm_name);
+  free(p_device_context);
+}
+
+// map the device queue without creating it, NULL if not available
+static ni_device_queue_t *ni_rsrc_cache_map_queue(void)
+{
+  ni_device_queue_t *p_device_queue = NULL;
+  struct stat shm_stat;
+  int shm_fd;
+
+  shm_fd = shm_open(CODERS_SHM_NAME, O_RDWR, 0);
+  if (shm_fd < 0) {
+    return NULL;
+  }
+
+  // a segment of an older layout has no generation to check
+  if (fstat(shm_fd, &shm_stat) == 0 &&
+      shm_stat.st_size >= (off_t)sizeof(ni_device_queue_t) &&
+      ni_rsrc_mmap_shm(CODERS_SHM_NAME, shm_fd, sizeof(ni_device_queue_t),
+                       (void **)&p_device_queue) < 0) {
+    p_device_queue = NULL;
+  }
+
+  close(shm_fd);
+  return p_device_queue;
+}
+
+// drop every cached context if the device queue changed, called locked
+static bool ni_rsrc_cache_validate(void)
+{
+  ni_rsrc_cached_context_t *p_entry, *p_next;
+
+  if (g_rsrc_cache_queue &&
+      *(volatile uint32_t *)&g_rsrc_cache_queue->generation ==
+      g_rsrc_cache_generation) {
+    return true;
+  }
+
+  for (p_entry = g_rsrc_cache; p_entry; p_entry = p_next) {
+    p_next = p_entry->next;
+    if (p_entry->ref_cnt) {
+      p_entry->next = g_rsrc_cache_stale;
+      g_rsrc_cache_stale = p_entry;
+    } else {
+      ni_rsrc_close_device_context(p_entry->p_context);
+      free(p_entry);
+    }
+  }
+  g_rsrc_cache = NULL;
+
+  // the queue itself may have been removed and recreated, map it again
+  if (g_rsrc_cache_queue) {
+    ni_rsrc_munmap_shm((void *)g_rsrc_cache_queue, sizeof(ni_device_queue_t));
+  }
+  g_rsrc_cache_queue = ni_rsrc_cache_map_queue();
+  if (!g_rsrc_cache_queue) {
+    return false;
+  }
+
+  g_rsrc_cache_generation = *(volatile uint32_t *)&g_rsrc_cache_queue->generation;
+  ni_log(NI_LOG_DEBUG, "%s: device queue generation %u\n", __func__,
+         g_rsrc_cache_generation);
+  return true;
+}
+
+// release a context handed out from the cache, false if it is not cached
+static bool ni_rsrc_cache_release(ni_device_context_t *p_device_context)
+{
+  ni_rsrc_cached_context_t **pp_entry, *p_entry;
+  bool found = false;
+
+  ni_pthread_mutex_lock(&g_rsrc_cache_mutex);
+  for (p_entry = g_rsrc_cache; p_entry; p_entry = p_entry->next) {
+    if (p_entry->p_context->p_device_info == p_device_context->p_device_info) {
+      p_entry->ref_cnt--;
+      found = true;
+      break;
+    }
+  }
+
+  for (pp_entry = &g_rsrc_cache_stale; !found && *pp_entry;
+       pp_entry = &(*pp_entry)->next) {
+    p_entry = *pp_entry;
+    if (p_entry->p_context->p_device_info == p_device_context->p_device_info) {
+      if (--p_entry->ref_cnt == 0) {
+        *pp_entry = p_entry->next;
+        ni_rsrc_close_device_context(p_entry->p_context);
+        free(p_entry);
+      }
+      found = true;
+      break;
+    }
+  }
+  ni_pthread_mutex_unlock(&g_rsrc_cache_mutex);
+
+  return found;
+}
+#endif
+
+/*!******************************************************************************
+* \brief      Allocates and returns a pointer to ni_device_context_t struct
+*             based on provided device_type and guid.
+*             To be used for load update and codec query.
+*
+ *  \param[in]  device_type  NI_DEVICE_TYPE_DECODER or NI_DEVICE_TYPE_ENCODER
+ *  \param[in]  guid         GUID of the encoder or decoder device
+*
+* \return     pointer to ni_device_context_t if found, NULL otherwise
+*
+*  Note:     The returned ni_device_context_t content is not supposed to be used by
+*            caller directly: should only be passed to API in the subsequent
+*            calls; also after its use, the context should be released by
+*            calling ni_rsrc_free_device_context.
+*******************************************************************************/
+ni_device_context_t* ni_rsrc_get_device_context(ni_device_type_t device_type, int guid)
+{
+#ifdef NI_RSRC_CONTEXT_CACHE
+  ni_rsrc_cached_context_t *p_entry = NULL;
+  ni_device_context_t *p_device_context = NULL;
+
+  ni_pthread_mutex_lock(&g_rsrc_cache_mutex);
+  if (!ni_rsrc_cache_validate()) {
+    ni_pthread_mutex_unlock(&g_rsrc_cache_mutex);
+    return ni_rsrc_open_device_context(device_type, guid);
+  }
+
+  for (p_entry = g_rsrc_cache; p_entry; p_entry = p_entry->next) {
+    if (p_entry->device_type == device_type && p_entry->guid == guid) {
+      break;
+    }
+  }
+
+  if (!p_entry) {
+    p_entry = (ni_rsrc_cached_context_t *)calloc(1, sizeof(ni_rsrc_cached_context_t));
+    if (p_entry) {
+      p_entry->p_context = ni_rsrc_open_device_context(device_type, guid);
+    }
+    if (!p_entry || !p_entry->p_context) {
+      free(p_entry);
+      LRETURN;
+    }
+    p_entry->device_type = device_type;
+    p_entry->guid = guid;
+    p_entry->next = g_rsrc_cache;
+    g_rsrc_cache = p_entry;
+  }
+
+  // callers own the returned struct, the lock and mapping stay with the cache
+  p_device_context = (ni_device_context_t *)malloc(sizeof(ni_device_context_t));
+  if (!p_device_context) {
+    char errmsg[NI_ERRNO_LEN] = {0};
+    ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
+    ni_log(NI_LOG_ERROR, "ERROR %s() malloc() ni_device_context_t: %s\n",
+           __func__, errmsg);
+    LRETURN;
+  }
+  memcpy(p_device_context, p_entry->p_context, sizeof(ni_device_context_t));
+  p_entry->ref_cnt++;
+
+END:
+  ni_pthread_mutex_unlock(&g_rsrc_cache_mutex);
+  return p_device_context;
+#else
+  return ni_rsrc_open_device_context(device_type, guid);
+#endif
+}
 #endif
 
 /*!******************************************************************************
@@ -1341,6 +1626,13 @@ void ni_rsrc_free_device_context(ni_device_context_t *p_device_context)
     UnmapViewOfFile(p_device_context->p_device_info);
     ReleaseMutex(p_device_context->lock);
 #elif __linux__ || __APPLE__
+#ifdef NI_RSRC_CONTEXT_CACHE
+    if (ni_rsrc_cache_release(p_device_context))
+    {
+      free(p_device_context);
+      return;
+    }
+#endif
     close(p_device_context->lock);
     ni_rsrc_munmap_shm((void *)p_device_context->p_device_info, sizeof(ni_device_info_t));
     ni_log(NI_LOG_DEBUG, "in %s do munmap for %s\n", __func__, p_device_context->shm_name);
@@ -1395,7 +1687,7 @@ ni_retcode_t ni_rsrc_list_devices(ni_device_type_t device_type,
     LRETURN;
   }
 #elif __linux__ || __APPLE__
-  lockf(p_device_pool->lock, F_LOCK, 0);
+  ni_rsrc_lock_fd(p_device_pool->lock, -1);
 #endif
 
   b_release_pool_mtx = true;
@@ -1424,9 +1716,9 @@ ni_retcode_t ni_rsrc_list_devices(ni_device_type_t device_type,
       memcpy(&p_device_info[i], p_device_context->p_device_info, sizeof(ni_device_info_t));
       ReleaseMutex(p_device_context->lock);
 #elif __linux__ || __APPLE__
-      lockf(p_device_context->lock, F_LOCK, 0);
+      ni_rsrc_lock_fd(p_device_context->lock, -1);
       memcpy(&p_device_info[i], p_device_context->p_device_info, sizeof(ni_device_info_t));
-      lockf(p_device_context->lock, F_ULOCK, 0);
+      ni_rsrc_unlock_fd(p_device_context->lock);
 #endif
 
       ni_rsrc_free_device_context(p_device_context);
@@ -1446,7 +1738,7 @@ END:
 #ifdef _WIN32
       ReleaseMutex(p_device_pool->lock);
 #elif __linux__ || __APPLE__
-      lockf(p_device_pool->lock, F_ULOCK, 0);
+      ni_rsrc_unlock_fd(p_device_pool->lock);
 #endif
     }
 
@@ -1803,11 +2095,11 @@ ni_device_info_t *ni_rsrc_get_device_info(ni_device_type_t device_type, int guid
   memcpy(p_device_info, p_device_context->p_device_info, sizeof(ni_device_info_t));
   ReleaseMutex(p_device_context->lock);
 #elif __linux
-  lockf(p_device_context->lock, F_LOCK, 0);
+  ni_rsrc_lock_fd(p_device_context->lock, -1);
 
   memcpy(p_device_info, p_device_context->p_device_info, sizeof(ni_device_info_t));
 
-  lockf(p_device_context->lock, F_ULOCK, 0);
+  ni_rsrc_unlock_fd(p_device_context->lock);
 #endif
 
 END:
@@ -1857,7 +2149,7 @@ int ni_rsrc_get_device_by_block_name(const char *blk_name,
         return NI_RETCODE_FAILURE;
     }
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_LOCK, 0);
+    ni_rsrc_lock_fd(p_device_pool->lock, -1);
 #endif
 
     num_coders = p_device_pool->p_device_queue->xcoder_cnt[device_type];
@@ -1881,7 +2173,7 @@ int ni_rsrc_get_device_by_block_name(const char *blk_name,
 #ifdef _WIN32
     ReleaseMutex(p_device_pool->lock);
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_ULOCK, 0);
+    ni_rsrc_unlock_fd(p_device_pool->lock);
 #endif
 
     ni_rsrc_free_device_pool(p_device_pool);
@@ -1922,7 +2214,7 @@ int ni_rsrc_update_device_load(ni_device_context_t *p_device_context, int load,
       return NI_RETCODE_FAILURE;
   }
 #elif __linux__ || __APPLE__
-  lockf(p_device_context->lock, F_LOCK, 0);
+  ni_rsrc_lock_fd(p_device_context->lock, -1);
 #endif
 
   p_device_context->p_device_info->load = load;
@@ -1935,7 +2227,8 @@ int ni_rsrc_update_device_load(ni_device_context_t *p_device_context, int load,
 #ifdef _WIN32
   ReleaseMutex(p_device_context->lock);
 #elif __linux__ || __APPLE__
-  lockf(p_device_context->lock, F_ULOCK, 0);
+  ni_rsrc_publish_device_load(p_device_context->p_device_info);
+  ni_rsrc_unlock_fd(p_device_context->lock);
 #endif
 
   return NI_RETCODE_SUCCESS;
@@ -2002,7 +2295,7 @@ void ni_rsrc_release_resource(ni_device_context_t *p_device_context,
              __func__, p_device_context->lock);
   }
 #elif __linux__ || __APPLE__
-  lockf(p_device_context->lock, F_LOCK, 0);
+  ni_rsrc_lock_fd(p_device_context->lock, -1);
 #endif
 
   if (p_device_context->p_device_info->xcode_load_pixel < load)
@@ -2029,7 +2322,7 @@ void ni_rsrc_release_resource(ni_device_context_t *p_device_context,
 #ifdef _WIN32
   ReleaseMutex(p_device_context->lock);
 #elif __linux__ || __APPLE__
-  lockf(p_device_context->lock, F_ULOCK, 0);
+  ni_rsrc_unlock_fd(p_device_context->lock);
 #endif
 
 #endif
@@ -2119,7 +2412,7 @@ int ni_rsrc_check_hw_available(int guid, ni_device_type_t device_type)
         LRETURN;
     }
 #elif __linux__
-    lockf(p_device_pool->lock, F_LOCK, 0);
+    ni_rsrc_lock_fd(p_device_pool->lock, -1);
 #endif
     b_release_pool_mtx = true;
 
@@ -2207,7 +2500,7 @@ END:
 #ifdef _WIN32
         ReleaseMutex(p_device_pool->lock);
 #elif __linux__
-        lockf(p_device_pool->lock, F_ULOCK, 0);
+        ni_rsrc_unlock_fd(p_device_pool->lock);
 #endif
     }
 
@@ -2274,7 +2567,7 @@ int ni_rsrc_remove_device(const char* dev)
         LRETURN;
     }
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_LOCK, 0);
+    ni_rsrc_lock_fd(p_device_pool->lock, -1);
 #endif
 
     p_device_queue = p_device_pool->p_device_queue;
@@ -2375,6 +2668,9 @@ int ni_rsrc_remove_device(const char* dev)
 
             p_device_queue->xcoders[ui_device_type][guid_index_i] = -1;
             p_device_queue->xcoder_cnt[ui_device_type]--;
+#if __linux__ || __APPLE__
+            ni_rsrc_clear_device_load(device_type, guid);
+#endif
         }
     }
 
@@ -2402,6 +2698,7 @@ int ni_rsrc_remove_device(const char* dev)
         }
         memcpy(p_device_queue->xcoders[ui_device_type], guids, sizeof(guids));
     }
+    p_device_queue->generation++;
 
 #if __linux__ || __APPLE__
 #ifndef _ANDROID
@@ -2427,7 +2724,7 @@ int ni_rsrc_remove_device(const char* dev)
 #ifdef _WIN32
     ReleaseMutex(p_device_pool->lock);
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_ULOCK, 0);
+    ni_rsrc_unlock_fd(p_device_pool->lock);
 #endif
 
 end:
@@ -2451,6 +2748,9 @@ int ni_rsrc_remove_all_devices(void)
     int xcoder_dev_count = 0;
     int i = 0;
     ni_device_t *saved_coders = NULL;
+#if __linux__ || __APPLE__
+    ni_device_pool_t *p_device_pool = NULL;
+#endif
     saved_coders = (ni_device_t *)malloc(sizeof(ni_device_t));
     if (!saved_coders)
     {
@@ -2514,6 +2814,16 @@ int ni_rsrc_remove_all_devices(void)
     }
 
 #if __linux__ || __APPLE__
+    // processes still mapping the queue must not trust their cached contexts
+    p_device_pool = ni_rsrc_get_device_pool();
+    if (p_device_pool)
+    {
+        ni_rsrc_lock_fd(p_device_pool->lock, -1);
+        p_device_pool->p_device_queue->generation++;
+        ni_rsrc_unlock_fd(p_device_pool->lock);
+        ni_rsrc_free_device_pool(p_device_pool);
+    }
+
     if (!ni_rsrc_remove_shm(CODERS_SHM_NAME, sizeof(ni_device_queue_t)))
     {
         ni_log(NI_LOG_INFO, "%s deleted.\n", CODERS_SHM_NAME);
@@ -2595,7 +2905,7 @@ int ni_rsrc_add_device(const char* dev, int should_match_rev)
         return NI_RETCODE_FAILURE;
     }
 #elif __linux__ || __APPLE__
-    lockf(device_pool->lock, F_LOCK, 0);
+    ni_rsrc_lock_fd(device_pool->lock, -1);
 #endif
 
     retcode = NI_RETCODE_SUCCESS;
@@ -2648,7 +2958,7 @@ end:
 #ifdef _WIN32
     ReleaseMutex(device_pool->lock);
 #elif __linux__ || __APPLE__
-    lockf(device_pool->lock, F_ULOCK, 0);
+    ni_rsrc_unlock_fd(device_pool->lock);
 #endif
     ni_rsrc_free_device_pool(device_pool);
     return retcode;
@@ -2747,7 +3057,7 @@ int ni_rsrc_lock_and_open(int device_type, ni_lock_handle_t* lock)
                __func__, errmsg);
     }
 #else
-    status = lockf(*lock, F_LOCK, 0);
+    status = ni_rsrc_lock_fd(*lock, -1);
 #endif
     if (status != 0)
     {
@@ -2798,7 +3108,7 @@ int ni_rsrc_unlock(int device_type, ni_lock_handle_t lock)
           status = (ni_lock_handle_t)(0);
       }
 #else
-      status = lockf(lock, F_ULOCK, 0);
+      status = ni_rsrc_unlock_fd(lock);
 #endif
       count++;
       if (count > MAX_LOCK_RETRY)
@@ -2881,6 +3191,89 @@ get_numa_node_ret:
 #endif
 }
 
+/*!******************************************************************************
+ *  \brief     Get the CPUs local to a device, read from the local_cpulist of
+ *             its PCIe function in sysfs
+ *
+ *  \param[in]  device_name  block device name, eg. "/dev/nvme0n1"
+ *  \param[out] p_cpu_mask   bitmap of the local CPUs, CPU n is bit n % 64
+ *                           of word n / 64
+ *  \param[in]  mask_words   number of words of p_cpu_mask, CPUs past it
+ *                           are left out
+ *
+ *  \return    number of CPUs set in p_cpu_mask, 0 if they are not known
+ *******************************************************************************/
+int ni_rsrc_get_local_cpus(char *device_name, uint64_t *p_cpu_mask,
+                           int mask_words)
+{
+#ifndef __linux__
+    return 0;
+#else
+  char pcie[64] = {0};
+  char path[PATH_MAX];
+  char cpulist[1024] = {0};
+  char *ptr, *end;
+  FILE *fp;
+  long first, last, cpu;
+  int nb_cpus = 0;
+
+  if (!device_name || !p_cpu_mask || mask_words <= 0)
+  {
+    return 0;
+  }
+  memset(p_cpu_mask, 0, sizeof(uint64_t) * mask_words);
+
+  get_dev_pcie_addr(device_name, pcie, NULL, NULL, NULL, NULL);
+  if (!pcie[0])
+  {
+    return 0;
+  }
+  snprintf(path, sizeof(path), "/sys/bus/pci/devices/%s/local_cpulist", pcie);
+  fp = fopen(path, "r");
+  if (!fp)
+  {
+    return 0;
+  }
+  if (!fgets(cpulist, sizeof(cpulist), fp))
+  {
+    cpulist[0] = '\0';
+  }
+  fclose(fp);
+
+  // eg. "0-15,32-47"
+  ptr = cpulist;
+  while (*ptr)
+  {
+    first = strtol(ptr, &end, 10);
+    if (end == ptr || first < 0)
+    {
+      break;
+    }
+    last = first;
+    ptr = end;
+    if (*ptr == '-')
+    {
+      last = strtol(ptr + 1, &end, 10);
+      ptr = end;
+    }
+    for (cpu = first; cpu <= last && cpu < 64L * mask_words; cpu++)
+    {
+      if (!(p_cpu_mask[cpu / 64] & (1ULL << (cpu % 64))))
+      {
+        p_cpu_mask[cpu / 64] |= 1ULL << (cpu % 64);
+        nb_cpus++;
+      }
+    }
+    if (*ptr != ',')
+    {
+      break;
+    }
+    ptr++;
+  }
+  return nb_cpus;
+#endif
+}
+
 static int int_cmp(const void *a, const void *b)
 {
   const int *ia = (const int *)a;
@@ -3683,9 +4076,9 @@ int ni_check_hw_info(ni_hw_device_info_quadra_t **pointer_to_p_hw_device_info,
       LRETURN;
     }
 #elif defined(__linux__)
-    if (lockf(p_device_pool->lock, F_LOCK, 0))
+    if (ni_rsrc_lock_fd(p_device_pool->lock, -1))
     {
-        ni_log(NI_LOG_ERROR, "Error lockf() failed\n");
+        ni_log(NI_LOG_ERROR, "Error %s() lock failed\n", __func__);
         if(b_valid)
         {
             p_hw_device_info->err_code = NI_RETCODE_ERROR_LOCK_DOWN_DEVICE;
@@ -4127,9 +4520,9 @@ END:
   ReleaseMutex((HANDLE)p_device_pool->lock);
 
 #elif defined(__linux__)
-  if (lockf(p_device_pool->lock, F_ULOCK,0))
+  if (ni_rsrc_unlock_fd(p_device_pool->lock))
   {
-    ni_log(NI_LOG_ERROR, "Error lockf() failed\n");
+    ni_log(NI_LOG_ERROR, "Error %s() unlock failed\n", __func__);
     if(p_hw_device_info)
     {
       p_hw_device_info->err_code = NI_RETCODE_ERROR_UNLOCK_DEVICE;
@@ -4180,6 +4573,18 @@ END:
 }
 
 
+// load field ni_rsrc_allocate_auto() compares for a device type and rule
+static ni_load_key_t ni_rsrc_alloc_load_key(ni_device_type_t device_type,
+                                            ni_alloc_rule_t rule)
+{
+    if (EN_ALLOC_LEAST_INSTANCE == rule)
+    {
+        return NI_LOAD_KEY_INST;
+    }
+    return NI_DEVICE_TYPE_ENCODER == device_type ? NI_LOAD_KEY_MODEL_LOAD :
+                                                   NI_LOAD_KEY_LOAD;
+}
+
 /*!*****************************************************************************
 *   \brief      Allocate resources for decoding/encoding, based on the provided rule
 *
@@ -4244,7 +4649,7 @@ ni_device_context_t *ni_rsrc_allocate_auto(
         ni_log(NI_LOG_ERROR, "ERROR: %s() failed to obtain mutex: %p\n", __func__, p_device_pool->lock);
     }
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_LOCK, 0);
+    ni_rsrc_lock_fd(p_device_pool->lock, -1);
 #endif
 
     coders = p_device_pool->p_device_queue->xcoders[device_type];
@@ -4299,7 +4704,7 @@ ni_device_context_t *ni_rsrc_allocate_auto(
                    __func__, p_device_context->lock);
         }
 #elif __linux__ || __APPLE__
-        lockf(p_device_context->lock, F_LOCK, 0);
+        ni_rsrc_lock_fd(p_device_context->lock, -1);
 #endif
         ni_rsrc_update_record(p_device_context, &p_session_context);
 
@@ -4351,7 +4756,7 @@ ni_device_context_t *ni_rsrc_allocate_auto(
 #ifdef _WIN32
         ReleaseMutex(p_device_context->lock);
 #elif __linux__ || __APPLE__
-        lockf(p_device_context->lock, F_ULOCK, 0);
+        ni_rsrc_unlock_fd(p_device_context->lock);
 #endif
         ni_rsrc_free_device_context(p_device_context);
     }
@@ -4381,7 +4786,7 @@ END:
 #ifdef _WIN32
     ReleaseMutex(p_device_pool->lock);
 #elif __linux__ || __APPLE__
-    lockf(p_device_pool->lock, F_ULOCK, 0);
+    ni_rsrc_unlock_fd(p_device_pool->lock);
 #endif
     ni_device_session_context_clear(&p_session_context);
     ni_rsrc_free_device_pool(p_device_pool);
@@ -4392,3 +4797,180 @@ END:
     }
     return p_device_context;
 }
+
+/*!*****************************************************************************
+*   \brief      Get a read only view of the load records of one device type
+*
+*   \param[in]  device_type  device type, NI_DEVICE_TYPE_DECODER etc.
+*
+*   \return     pointer to NI_MAX_DEVICE_CNT records indexed by guid, NULL on
+*               failure or if not supported on this platform
+*******************************************************************************/
+const ni_device_load_record_t *ni_rsrc_get_load_table(ni_device_type_t device_type)
+{
+#if __linux__ || __APPLE__
+    ni_device_load_table_t *p_table;
+
+    if (!IS_XCODER_DEVICE_TYPE(device_type))
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid device type %d\n", __func__,
+               device_type);
+        return NULL;
+    }
+
+    p_table = ni_rsrc_get_load_table_priv();
+    return p_table ? p_table->records[device_type] : NULL;
+#else
+    (void)device_type;
+    return NULL;
+#endif
+}
+
+/*!*****************************************************************************
+*   \brief      Take a consistent snapshot of a load record without locking
+*
+*   \param[in]  p_record    record from ni_rsrc_get_load_table()
+*   \param[out] p_snapshot  copy of the record
+*
+*   \return     NI_RETCODE_SUCCESS if the device is in the resource pool,
+*               NI_RETCODE_FAILURE otherwise,
+*               NI_RETCODE_INVALID_PARAM on NULL pointers
+*******************************************************************************/
+ni_retcode_t ni_rsrc_read_device_load(const ni_device_load_record_t *p_record,
+                                      ni_device_load_record_t *p_snapshot)
+{
+#if __linux__ || __APPLE__
+    ni_device_load_record_t copy;
+    uint32_t seq0, seq1;
+    int retry;
+
+    if (!p_record || !p_snapshot)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid input pointers\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    // a writer only holds the record odd for a few stores, a record that
+    // stays odd was left by a writer that died and is treated as absent
+    for (retry = 0; retry < NI_LOAD_READ_RETRY; retry++)
+    {
+        seq0 = __atomic_load_n(&p_record->seq, __ATOMIC_ACQUIRE);
+        if (seq0 & 1)
+        {
+            continue;
+        }
+
+        memset(&copy, 0, sizeof(copy));
+        copy.valid = __atomic_load_n(&p_record->valid, __ATOMIC_RELAXED);
+        copy.load = __atomic_load_n(&p_record->load, __ATOMIC_RELAXED);
+        copy.model_load = __atomic_load_n(&p_record->model_load, __ATOMIC_RELAXED);
+        copy.active_num_inst =
+            __atomic_load_n(&p_record->active_num_inst, __ATOMIC_RELAXED);
+        copy.max_instance_cnt =
+            __atomic_load_n(&p_record->max_instance_cnt, __ATOMIC_RELAXED);
+        copy.xcode_load_pixel =
+            __atomic_load_n(&p_record->xcode_load_pixel, __ATOMIC_RELAXED);
+        copy.update_cnt = __atomic_load_n(&p_record->update_cnt, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        seq1 = __atomic_load_n(&p_record->seq, __ATOMIC_RELAXED);
+        if (seq0 == seq1)
+        {
+            copy.seq = seq0;
+            *p_snapshot = copy;
+            return copy.valid ? NI_RETCODE_SUCCESS : NI_RETCODE_FAILURE;
+        }
+    }
+    return NI_RETCODE_FAILURE;
+#else
+    (void)p_record;
+    (void)p_snapshot;
+    return NI_RETCODE_FAILURE;
+#endif
+}
+
+/*!*****************************************************************************
+*   \brief      Pick the least loaded device among candidates from the load
+*               table
+*
+*   Decides from the last published loads without querying the devices. On
+*   equal loads the earlier candidate wins.
+*
+*   \param[in]  device_type     device type, NI_DEVICE_TYPE_DECODER etc.
+*   \param[in]  key             load field to compare
+*   \param[in]  inst_tie_break  on equal loads prefer fewer active instances
+*   \param[in]  p_guids         candidate guids, NULL for every guid
+*   \param[in]  count           number of entries in p_guids
+*
+*   \return     guid of the selected device, -1 if no candidate has a record
+*               or the load table is not available
+*******************************************************************************/
+int ni_rsrc_pick_least_loaded(ni_device_type_t device_type, ni_load_key_t key,
+                              bool inst_tie_break, const int *p_guids,
+                              int count)
+{
+    const ni_device_load_record_t *p_records = ni_rsrc_get_load_table(device_type);
+    ni_device_load_record_t record;
+    uint32_t best_inst = 0;
+    int guid = -1;
+    int best = 0;
+    int value;
+    int i, cur;
+
+    if (!p_records)
+    {
+        return -1;
+    }
+    if (!p_guids)
+    {
+        count = NI_MAX_DEVICE_CNT;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        cur = p_guids ? p_guids[i] : i;
+        if (cur < 0 || cur >= NI_MAX_DEVICE_CNT ||
+            ni_rsrc_read_device_load(&p_records[cur], &record) != NI_RETCODE_SUCCESS)
+        {
+            continue;
+        }
+
+        if (NI_LOAD_KEY_INST == key)
+        {
+            value = (int)record.active_num_inst;
+        } else if (NI_LOAD_KEY_MODEL_LOAD == key)
+        {
+            value = record.model_load;
+        } else
+        {
+            value = record.load;
+        }
+
+        if (guid < 0 || value < best ||
+            (inst_tie_break && value == best &&
+             record.active_num_inst < best_inst))
+        {
+            guid = cur;
+            best = value;
+            best_inst = record.active_num_inst;
+        }
+    }
+
+    return guid;
+}
+
+/*!*****************************************************************************
+*   \brief      Pick a device from the last published loads without querying
+*               the devices or taking any lock
+*
+*   \param[in]  device_type  device type, NI_DEVICE_TYPE_DECODER etc.
+*   \param[in]  rule         allocation rule
+*
+*   \return     guid of the selected device, -1 if none is known
+*******************************************************************************/
+int ni_rsrc_get_least_loaded(ni_device_type_t device_type, ni_alloc_rule_t rule)
+{
+    // same ordering as ni_rsrc_allocate_auto()
+    return ni_rsrc_pick_least_loaded(device_type, ni_rsrc_alloc_load_key(device_type, rule),
+                                     false, NULL, 0);
+}
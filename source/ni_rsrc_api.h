@@ -68,6 +68,9 @@ typedef struct _ni_device_queue
 {
     uint32_t xcoder_cnt[NI_DEVICE_TYPE_XCODER_MAX];
     int32_t xcoders[NI_DEVICE_TYPE_XCODER_MAX][NI_MAX_DEVICE_CNT];
+    // bumped whenever devices are added to or removed from the queue so
+    // processes can drop device contexts they cached from an older layout
+    uint32_t generation;
 } ni_device_queue_t;
 
 typedef struct _ni_device_video_capability
@@ -149,6 +152,24 @@ typedef struct _ni_device_context
   ni_device_info_t * p_device_info;
 } ni_device_context_t;
 
+/*! Per device load record, one cache line each. The records live in their
+ *  own shared memory table indexed by device type and guid, apart from the
+ *  large ni_device_info_t capability data, and are updated under a seqlock
+ *  every time the load of a device is refreshed. Use
+ *  ni_rsrc_read_device_load() to get a consistent snapshot. */
+typedef struct _ni_device_load_record
+{
+  uint32_t seq;              /*! seqlock sequence, odd while being updated */
+  uint32_t valid;            /*! device is in the resource pool */
+  int      load;             /*! same as ni_device_info_t.load */
+  int      model_load;       /*! same as ni_device_info_t.model_load */
+  uint32_t active_num_inst;  /*! same as ni_device_info_t.active_num_inst */
+  int      max_instance_cnt; /*! same as ni_device_info_t.max_instance_cnt */
+  uint64_t xcode_load_pixel; /*! same as ni_device_info_t.xcode_load_pixel */
+  uint64_t update_cnt;       /*! number of updates published */
+  uint8_t  reserved[24];
+} ni_device_load_record_t;
+
 typedef struct _ni_card_info_quadra
 {
   int card_idx;
@@ -585,6 +606,9 @@ LIB_API void ni_rsrc_print_device_info(const ni_device_info_t* p_device_info);
 /*!*****************************************************************************
  *  \brief  lock a file lock and open a session on a device
  *
+ *  On Linux the lock is owned by the calling thread and must be released
+ *  with ni_rsrc_unlock() on that same thread.
+ *
  *  \param device_type
  *  \param lock
  *
@@ -620,6 +644,21 @@ LIB_API int ni_rsrc_is_fw_compat(uint8_t fw_rev[8]);
  *******************************************************************************/
 LIB_API int ni_rsrc_get_numa_node(char *device_name);
 
+/*!******************************************************************************
+ *  \brief     Get the CPUs local to a device, read from the local_cpulist of
+ *             its PCIe function in sysfs
+ *
+ *  \param[in]  device_name  block device name, eg. "/dev/nvme0n1"
+ *  \param[out] p_cpu_mask   bitmap of the local CPUs, CPU n is bit n % 64
+ *                           of word n / 64
+ *  \param[in]  mask_words   number of words of p_cpu_mask, CPUs past it
+ *                           are left out
+ *
+ *  \return    number of CPUs set in p_cpu_mask, 0 if they are not known
+ *******************************************************************************/
+LIB_API int ni_rsrc_get_local_cpus(char *device_name, uint64_t *p_cpu_mask,
+                                   int mask_words);
+
 
 /*!******************************************************************************
  *  \brief  Create a pointer to  hw_device_info_coder_param_t instance .This instance will be created and
@@ -732,6 +771,46 @@ LIB_API ni_device_context_t* ni_rsrc_allocate_auto( ni_device_type_t device_type
                                                     int frame_rate,
                                                     uint64_t *p_load);
 
+/*!*****************************************************************************
+*   \brief      Get a read only view of the load records of one device type
+*
+*   \param[in]  device_type  device type, NI_DEVICE_TYPE_DECODER etc.
+*
+*   \return     pointer to NI_MAX_DEVICE_CNT records indexed by guid, NULL on
+*               failure or if not supported on this platform. The view stays
+*               mapped for the life of the process; read a record with
+*               ni_rsrc_read_device_load(). The pointer changes when the
+*               resource pool is recreated, get it again for each decision.
+*******************************************************************************/
+LIB_API const ni_device_load_record_t *ni_rsrc_get_load_table(ni_device_type_t device_type);
+
+/*!*****************************************************************************
+*   \brief      Take a consistent snapshot of a load record without locking
+*
+*   \param[in]  p_record    record from ni_rsrc_get_load_table()
+*   \param[out] p_snapshot  copy of the record
+*
+*   \return     NI_RETCODE_SUCCESS if the device is in the resource pool,
+*               NI_RETCODE_FAILURE if not, or if the record is left half
+*               updated by a writer that died,
+*               NI_RETCODE_INVALID_PARAM on NULL pointers
+*******************************************************************************/
+LIB_API ni_retcode_t ni_rsrc_read_device_load(const ni_device_load_record_t *p_record,
+                                              ni_device_load_record_t *p_snapshot);
+
+/*!*****************************************************************************
+*   \brief      Pick a device from the last published loads, following the
+*               same rule as ni_rsrc_allocate_auto() but without querying the
+*               devices or taking any lock
+*
+*   \param[in]  device_type  device type, NI_DEVICE_TYPE_DECODER etc.
+*   \param[in]  rule         allocation rule
+*
+*   \return     guid of the selected device, -1 if none is known
+*******************************************************************************/
+LIB_API int ni_rsrc_get_least_loaded(ni_device_type_t device_type,
+                                     ni_alloc_rule_t rule);
+
 #ifdef __cplusplus
 }
 #endif
@@ -2845,9 +2845,9 @@ int main(int argc, char *argv[])
       LRETURN;
     }
 #elif __linux__
-    if ( lockf(p_device_pool->lock, F_LOCK, 0) )
+    if (ni_rsrc_lock_fd(p_device_pool->lock, -1) != NI_RETCODE_SUCCESS)
     {
-        perror("ERROR: cannot lock p_device_pool");
+        fprintf(stderr, "ERROR: cannot lock p_device_pool\n");
     }
 #endif
 
@@ -2856,9 +2856,9 @@ int main(int argc, char *argv[])
 #ifdef _WIN32
     ReleaseMutex((HANDLE)p_device_pool->lock);
 #elif __linux__
-    if ( lockf(p_device_pool->lock, F_ULOCK, 0) )
+    if (ni_rsrc_unlock_fd(p_device_pool->lock) != NI_RETCODE_SUCCESS)
     {
-        perror("ERROR: cannot unlock p_device_pool");
+        fprintf(stderr, "ERROR: cannot unlock p_device_pool\n");
     }
 #endif
 
@@ -2930,18 +2930,18 @@ int main(int argc, char *argv[])
       LRETURN;
     }
 #elif __linux__
-    if ( lockf(p_device_pool->lock, F_LOCK, 0) )
+    if (ni_rsrc_lock_fd(p_device_pool->lock, -1) != NI_RETCODE_SUCCESS)
     {
-        perror("ERROR: cannot lock p_device_pool");
+        fprintf(stderr, "ERROR: cannot lock p_device_pool\n");
     }
 #endif
     coders = p_device_pool->p_device_queue;
 #ifdef _WIN32
     ReleaseMutex((HANDLE)p_device_pool->lock);
 #elif __linux__
-    if ( lockf(p_device_pool->lock, F_ULOCK, 0) )
+    if (ni_rsrc_unlock_fd(p_device_pool->lock) != NI_RETCODE_SUCCESS)
     {
-        perror("ERROR: cannot unlock p_device_pool");
+        fprintf(stderr, "ERROR: cannot unlock p_device_pool\n");
     }
 #endif
 #if defined(__linux__)
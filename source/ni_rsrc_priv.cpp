@@ -47,12 +47,18 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <limits.h>
+#include <pthread.h>
 #endif
 
 #if __APPLE__
 #include <sys/syslimits.h>
 #endif
 
+#if __linux__ && !defined(_ANDROID) && !defined(__OPENHARMONY__)
+#include <time.h>
+#define NI_RSRC_ROBUST_LOCK
+#endif
+
 #ifdef _ANDROID
 #include "ni_rsrc_api_android.h"
 #endif
@@ -341,6 +347,7 @@ static void fill_shared_memory(ni_device_queue_t *device_queue,
 {
     int i, j, compatible_device_counter;
 
+    device_queue->generation++;
     memset(device_queue->xcoder_cnt, 0, sizeof(device_queue->xcoder_cnt));
     for (i = NI_DEVICE_TYPE_DECODER; i < NI_DEVICE_TYPE_XCODER_MAX; i++)
     {
@@ -498,6 +505,8 @@ bool add_to_shared_memory(const char device_name[NI_MAX_DEVICE_NAME_LEN],
         ni_rsrc_get_one_device_info(&device_info);
     }
 
+    device_queue->generation++;
+
     if (fw_compat_cmp < 0) {
         ni_log(NI_LOG_INFO, "Initialized %s with FW API v%s that is older than "
                "Libxcoder supported FW API version\n", device_name,
@@ -1080,10 +1089,12 @@ int ni_rsrc_init_priv(const int should_match_rev,
             LRETURN;
         }
 
+        // the queue is recreated below, invalidate contexts cached from it
+        p_device_queue->generation++;
         ni_rsrc_munmap_shm((void *)p_device_queue, sizeof(ni_device_queue_t));
         ni_log(NI_LOG_DEBUG, "in %s do munmap for %s, shm_flag is O_RDWR\n", __func__, CODERS_SHM_NAME);
 
-        if (lockf(lck_fd, F_ULOCK, 0) < 0) {
+        if (ni_rsrc_unlock_fd(lck_fd) < 0) {
           ni_log(NI_LOG_ERROR, "%s(): Failed to unlock lck_fd for %s\n", __func__, CODERS_SHM_NAME);
         }
 
@@ -1117,7 +1128,7 @@ end:
     }
 
     if (lck_fd != -1) {
-      if (lockf(lck_fd, F_ULOCK, 0) < 0) {
+      if (ni_rsrc_unlock_fd(lck_fd) < 0) {
         ni_log(NI_LOG_ERROR, "Will exit from %s(), but failed to unlock lck_fd for %s\n", __func__, CODERS_SHM_NAME);
       }
 
@@ -1182,6 +1193,7 @@ void ni_rsrc_get_one_device_info (ni_device_info_t * p_device_info)
   }
 
   memcpy(p_coder_info_dst, p_device_info, sizeof(ni_device_info_t));
+  ni_rsrc_publish_device_load(p_coder_info_dst);
 
 #ifndef __OPENHARMONY__
   if (msync((void*)p_coder_info_dst, sizeof(ni_device_info_t), MS_SYNC | MS_INVALIDATE)) {
@@ -1207,7 +1219,7 @@ END:
   }
 #endif
 
-  if (lockf(lock, F_ULOCK, 0) < 0) {
+  if (ni_rsrc_unlock_fd(lock) < 0) {
     ni_log(NI_LOG_ERROR, "Will exit from %s(), but failed to unlock lck_fd for %s\n", __func__, shm_name);
   }
 
@@ -1264,6 +1276,7 @@ void ni_rsrc_update_record(ni_device_context_t *p_device_context, ni_session_con
       ni_log(NI_LOG_ERROR, "ERROR %s() msync() p_device_context->"
              "p_device_info: %s\n", __func__, errmsg);
   }
+  ni_rsrc_publish_device_load(p_device_context->p_device_info);
 }
 
 
@@ -1394,25 +1407,406 @@ ni_retcode_t ni_rsrc_try_get_shm_lock(const char *lck_name,
     return NI_RETCODE_FAILURE;
   }
 
-  int retry_cnt = 0;
-  //use non blocking F_TLOCK in case broken instance has indefinitely locked it
-  while (lockf(lock, F_TLOCK, 0) != 0)
+  //bounded wait in case broken instance has indefinitely locked it
+  if (ni_rsrc_lock_fd(lock, 900 * LOCK_WAIT / 1000) != NI_RETCODE_SUCCESS)
+  {
+    ni_log(NI_LOG_ERROR, "ERROR %s() lock %s fail\n", __func__, lck_name);
+    ni_log(NI_LOG_ERROR, "ERROR %s() If persists, stop traffic and run rm /dev/shm/NI_*\n", __func__);
+    close(lock);
+    return NI_RETCODE_FAILURE;
+  }
+
+  *lck_fd = lock;
+
+  return NI_RETCODE_SUCCESS;
+}
+
+// take the lockf() region of a lock file until deadline_ns, 0 for no limit
+static int ni_rsrc_lockf_until(int lck_fd, uint64_t deadline_ns)
+{
+  uint64_t now_ns;
+
+  if (!deadline_ns)
   {
-    retry_cnt++;
-    ni_usleep(LOCK_WAIT);    //10ms
-    if (retry_cnt >= 900)   //10s
+    while (lockf(lck_fd, F_LOCK, 0) != 0)
     {
-      ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
-      ni_log(NI_LOG_ERROR, "ERROR %s() lockf() %s fail: %s\n", __func__, lck_name, errmsg);
-      ni_log(NI_LOG_ERROR, "ERROR %s() If persists, stop traffic and run rm /dev/shm/NI_*\n", __func__);
-      close(lock);
+      if (NI_ERRNO != EINTR)
+      {
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  //non blocking F_TLOCK, only a tool using lockf() alone can hold it here
+  while (lockf(lck_fd, F_TLOCK, 0) != 0)
+  {
+    now_ns = ni_gettime_ns();
+    if (now_ns >= deadline_ns)
+    {
+      return -1;
+    }
+    if (deadline_ns - now_ns < (uint64_t)LOCK_WAIT * 1000)
+    {
+      ni_usleep((int64_t)((deadline_ns - now_ns) / 1000));
+    } else
+    {
+      ni_usleep(LOCK_WAIT);
+    }
+  }
+  return 0;
+}
+
+#ifdef NI_RSRC_ROBUST_LOCK
+#define NI_RSRC_LOCK_MAGIC 0x4E494C4BU  // "NILK"
+
+// Lock word kept at the start of every lock file under LOCK_DIR. The robust
+// process-shared mutex hands the lock over between libxcoder processes
+// without polling and is recovered when its owner dies; the lockf() region
+// taken under it keeps tools that only use lockf() on the file excluded.
+typedef struct _ni_rsrc_lock_word
+{
+  uint32_t magic;
+  uint32_t reserved;
+  pthread_mutex_t mutex;
+} ni_rsrc_lock_word_t;
+
+// per process mapping of a lock file, the mapping pins the inode so that its
+// number can not be reused by a recreated lock file while it is listed here
+typedef struct _ni_rsrc_lock_map
+{
+  dev_t dev;
+  ino_t ino;
+  ni_rsrc_lock_word_t *p_word;
+  int depth;  // nesting of the mutex owner, only touched while holding it
+  struct _ni_rsrc_lock_map *p_next;
+} ni_rsrc_lock_map_t;
+
+static pthread_mutex_t g_rsrc_lock_map_mutex = PTHREAD_MUTEX_INITIALIZER;
+// serializes the init of lock words within the process, so that a thread
+// never takes and drops the lockf() region while another thread of the
+// process holds it after its own init
+static pthread_mutex_t g_rsrc_lock_init_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ni_rsrc_lock_map_t *g_rsrc_lock_map = NULL;
+
+// wait for a pthread mutex until deadline_ns (CLOCK_REALTIME), 0 for no limit
+static int ni_rsrc_mutex_lock_until(pthread_mutex_t *p_mutex,
+                                    uint64_t deadline_ns)
+{
+  struct timespec ts;
+
+  if (!deadline_ns)
+  {
+    return pthread_mutex_lock(p_mutex);
+  }
+  ts.tv_sec = (time_t)(deadline_ns / 1000000000ULL);
+  ts.tv_nsec = (long)(deadline_ns % 1000000000ULL);
+  return pthread_mutex_timedlock(p_mutex, &ts);
+}
+
+// returns 0 when the word is ready, ETIMEDOUT when deadline_ns passed first,
+// -1 when the mutex could not be initialized
+static int ni_rsrc_init_lock_word(int lck_fd, ni_rsrc_lock_word_t *p_word,
+                                  uint64_t deadline_ns)
+{
+  pthread_mutexattr_t attr;
+  int ret = 0;
+
+  if (ni_rsrc_mutex_lock_until(&g_rsrc_lock_init_mutex, deadline_ns) != 0)
+  {
+    return ETIMEDOUT;
+  }
+  if (__atomic_load_n(&p_word->magic, __ATOMIC_ACQUIRE) == NI_RSRC_LOCK_MAGIC)
+  {
+    LRETURN;
+  }
+
+  // serialize first use of the file between processes, a process dying
+  // half way drops its lockf() and the next one redoes the init
+  if (ni_rsrc_lockf_until(lck_fd, deadline_ns) != 0)
+  {
+    ret = ETIMEDOUT;
+    LRETURN;
+  }
+
+  if (__atomic_load_n(&p_word->magic, __ATOMIC_ACQUIRE) != NI_RSRC_LOCK_MAGIC)
+  {
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    // lockf() never blocked its own process, keep nesting working
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    ret = pthread_mutex_init(&p_word->mutex, &attr) ? -1 : 0;
+    pthread_mutexattr_destroy(&attr);
+    if (ret == 0)
+    {
+      __atomic_store_n(&p_word->magic, NI_RSRC_LOCK_MAGIC, __ATOMIC_RELEASE);
+    }
+  }
+
+  lockf(lck_fd, F_ULOCK, 0);
+
+END:
+  pthread_mutex_unlock(&g_rsrc_lock_init_mutex);
+  return ret;
+}
+
+static ni_rsrc_lock_map_t *ni_rsrc_find_lock_map(const struct stat *p_st)
+{
+  ni_rsrc_lock_map_t *p_map;
+
+  for (p_map = g_rsrc_lock_map; p_map; p_map = p_map->p_next)
+  {
+    if (p_map->dev == p_st->st_dev && p_map->ino == p_st->st_ino)
+    {
+      return p_map;
+    }
+  }
+  return NULL;
+}
+
+// Look up the mapping of a lock file, and with create map and init it when
+// missing. The init waits for the lockf() region until deadline_ns (0 for no
+// limit) without holding g_rsrc_lock_map_mutex, so it stalls no other lock.
+// Returns 0 with *pp_map NULL when the file can not be mapped, ETIMEDOUT
+// when the init ran out of time.
+static int ni_rsrc_get_lock_map(int lck_fd, bool create, uint64_t deadline_ns,
+                                ni_rsrc_lock_map_t **pp_map)
+{
+  ni_rsrc_lock_map_t *p_map;
+  struct stat st;
+  void *p_addr;
+  int ret;
+
+  *pp_map = NULL;
+  if (fstat(lck_fd, &st) != 0)
+  {
+    return 0;
+  }
+
+  pthread_mutex_lock(&g_rsrc_lock_map_mutex);
+  *pp_map = ni_rsrc_find_lock_map(&st);
+  pthread_mutex_unlock(&g_rsrc_lock_map_mutex);
+  if (*pp_map || !create)
+  {
+    return 0;
+  }
+
+  // growing a zero sized file is idempotent so racing processes are fine
+  if (st.st_size < (off_t)sizeof(ni_rsrc_lock_word_t) &&
+      ftruncate(lck_fd, sizeof(ni_rsrc_lock_word_t)) != 0)
+  {
+    return 0;
+  }
+  p_addr = mmap(NULL, sizeof(ni_rsrc_lock_word_t), PROT_READ | PROT_WRITE,
+                MAP_SHARED, lck_fd, 0);
+  if (p_addr == MAP_FAILED)
+  {
+    return 0;
+  }
+  ret = ni_rsrc_init_lock_word(lck_fd, (ni_rsrc_lock_word_t *)p_addr,
+                               deadline_ns);
+  p_map = ret ? NULL : (ni_rsrc_lock_map_t *)malloc(sizeof(ni_rsrc_lock_map_t));
+  if (!p_map)
+  {
+    munmap(p_addr, sizeof(ni_rsrc_lock_word_t));
+    return ret == ETIMEDOUT ? ETIMEDOUT : 0;
+  }
+  p_map->dev = st.st_dev;
+  p_map->ino = st.st_ino;
+  p_map->p_word = (ni_rsrc_lock_word_t *)p_addr;
+  p_map->depth = 0;
+
+  // another thread may have mapped the same file meanwhile, keep one entry
+  pthread_mutex_lock(&g_rsrc_lock_map_mutex);
+  *pp_map = ni_rsrc_find_lock_map(&st);
+  if (!*pp_map)
+  {
+    p_map->p_next = g_rsrc_lock_map;
+    g_rsrc_lock_map = p_map;
+    *pp_map = p_map;
+    p_map = NULL;
+  }
+  pthread_mutex_unlock(&g_rsrc_lock_map_mutex);
+  if (p_map)
+  {
+    munmap(p_addr, sizeof(ni_rsrc_lock_word_t));
+    free(p_map);
+  }
+  return 0;
+}
+#endif
+
+/*!*****************************************************************************
+ *  \brief  lock a lock file under LOCK_DIR
+ *
+ *  On Linux the lock is a robust process-shared mutex stored in the lock
+ *  file itself, so waiters are woken as soon as it is released instead of
+ *  polling, and a lock left behind by a crashed process is recovered. The
+ *  lockf() region is still taken under the mutex for tools using only lockf().
+ *  Other platforms, and files that can not be mapped, use lockf() alone.
+ *
+ *  Unlike a bare lockf() lock, which belongs to the process, the mutex
+ *  belongs to the calling thread: other threads of the same process are
+ *  excluded as well, the lock nests on its owner thread, and it must be
+ *  released by ni_rsrc_unlock_fd() on that same thread. A lock whose owner
+ *  thread exits is recovered by the next locker.
+ *
+ *  \param[in] int lck_fd, opened (O_RDWR) lock file
+ *  \param[in] int timeout_ms, maximum total wait in milliseconds for both the
+ *                             mutex and the lockf() region, < 0 to wait
+ *                             without a limit
+ *
+ *  \return On success
+ *                     NI_RETCODE_SUCCESS
+ *          On failure
+ *                     NI_RETCODE_INVALID_PARAM
+ *                     NI_RETCODE_FAILURE
+ *******************************************************************************/
+ni_retcode_t ni_rsrc_lock_fd(int lck_fd, int timeout_ms)
+{
+  char errmsg[NI_ERRNO_LEN] = {0};
+  uint64_t deadline_ns = 0;
+
+  if (lck_fd < 0)
+  {
+    ni_log(NI_LOG_ERROR, "ERROR: %s() input params is invalid\n", __func__);
+    return NI_RETCODE_INVALID_PARAM;
+  }
+
+  // one deadline shared by the mutex and the lockf() waits
+  if (timeout_ms >= 0)
+  {
+    deadline_ns = ni_gettime_ns() + (uint64_t)timeout_ms * 1000000ULL;
+  }
+
+#ifdef NI_RSRC_ROBUST_LOCK
+  ni_rsrc_lock_map_t *p_map = NULL;
+  int ret = ni_rsrc_get_lock_map(lck_fd, true, deadline_ns, &p_map);
+
+  if (ret != 0)
+  {
+    ni_log(NI_LOG_ERROR, "ERROR: %s() lock file init timed out\n", __func__);
+    return NI_RETCODE_FAILURE;
+  }
+  if (p_map)
+  {
+    // ni_gettime_ns() reads CLOCK_REALTIME, the timedlock clock
+    ret = ni_rsrc_mutex_lock_until(&p_map->p_word->mutex, deadline_ns);
+
+    if (ret == EOWNERDEAD)
+    {
+      ni_log(NI_LOG_INFO, "%s(): previous lock owner died, recovering\n",
+             __func__);
+      // the owner may have been a thread of this process that left it nested
+      p_map->depth = 0;
+      ret = pthread_mutex_consistent(&p_map->p_word->mutex);
+    }
+    if (ret != 0)
+    {
+      ni_strerror(errmsg, NI_ERRNO_LEN, ret);
+      ni_log(NI_LOG_ERROR, "ERROR: %s() pthread_mutex_lock() fail: %s\n",
+             __func__, errmsg);
+      return NI_RETCODE_FAILURE;
+    }
+
+    // the lockf() region is held once for the outermost lock only
+    if (p_map->depth++ > 0)
+    {
+      return NI_RETCODE_SUCCESS;
+    }
+  }
+#endif
+
+  if (ni_rsrc_lockf_until(lck_fd, deadline_ns) == 0)
+  {
+    return NI_RETCODE_SUCCESS;
+  }
+
+  ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
+  ni_log(NI_LOG_ERROR, "ERROR: %s() lockf() fail: %s\n", __func__, errmsg);
+#ifdef NI_RSRC_ROBUST_LOCK
+  if (p_map)
+  {
+    p_map->depth--;
+    pthread_mutex_unlock(&p_map->p_word->mutex);
+  }
+#endif
+  return NI_RETCODE_FAILURE;
+}
+
+/*!*****************************************************************************
+ *  \brief  unlock a lock file locked by ni_rsrc_lock_fd()
+ *
+ *  Must be called on the thread that took the lock, see ni_rsrc_lock_fd().
+ *
+ *  \param[in] int lck_fd, lock file passed to ni_rsrc_lock_fd()
+ *
+ *  \return On success
+ *                     NI_RETCODE_SUCCESS
+ *          On failure
+ *                     NI_RETCODE_INVALID_PARAM
+ *                     NI_RETCODE_FAILURE
+ *******************************************************************************/
+ni_retcode_t ni_rsrc_unlock_fd(int lck_fd)
+{
+  ni_retcode_t retval = NI_RETCODE_SUCCESS;
+
+  if (lck_fd < 0)
+  {
+    ni_log(NI_LOG_ERROR, "ERROR: %s() input params is invalid\n", __func__);
+    return NI_RETCODE_INVALID_PARAM;
+  }
+
+#ifdef NI_RSRC_ROBUST_LOCK
+  ni_rsrc_lock_map_t *p_map = NULL;
+
+  ni_rsrc_get_lock_map(lck_fd, false, 0, &p_map);
+
+  if (p_map)
+  {
+    // the owner's nesting is only read after the trylock proved ownership,
+    // a recursive mutex already held by this thread always re-locks
+    int ret = pthread_mutex_trylock(&p_map->p_word->mutex);
+    if (ret == EOWNERDEAD)
+    {
+      p_map->depth = 0;
+      pthread_mutex_consistent(&p_map->p_word->mutex);
+      ret = 0;
+    }
+    if (ret != 0 || p_map->depth == 0)
+    {
+      if (ret == 0)
+      {
+        pthread_mutex_unlock(&p_map->p_word->mutex);
+      }
+      ni_log(NI_LOG_ERROR, "ERROR: %s() lock not held by calling thread\n",
+             __func__);
       return NI_RETCODE_FAILURE;
     }
+    pthread_mutex_unlock(&p_map->p_word->mutex);
+
+    if (--p_map->depth > 0)
+    {
+      pthread_mutex_unlock(&p_map->p_word->mutex);
+      return NI_RETCODE_SUCCESS;
+    }
   }
+#endif
 
-  *lck_fd = lock;
+  if (lockf(lck_fd, F_ULOCK, 0) != 0)
+  {
+    retval = NI_RETCODE_FAILURE;
+  }
 
-  return NI_RETCODE_SUCCESS;
+#ifdef NI_RSRC_ROBUST_LOCK
+  if (p_map)
+  {
+    pthread_mutex_unlock(&p_map->p_word->mutex);
+  }
+#endif
+
+  return retval;
 }
 
 #if defined(__OPENHARMONY__)
@@ -1666,6 +2060,19 @@ static ni_retcode_t linux_open_shm(const char *shm_name,
     return NI_RETCODE_FAILURE;
   }
 
+  //grow a segment created by an older version with a smaller layout, so the
+  //appended fields can be accessed without SIGBUS
+  if (skip_ftruncate) {
+    struct stat shm_stat;
+    if (fstat(shm_fd_tmp, &shm_stat) == 0 && shm_stat.st_size < shm_size &&
+        ftruncate(shm_fd_tmp, shm_size) < 0) {
+      ni_log(NI_LOG_ERROR, "ERROR: %s() %s failed to grow to %d bytes\n",
+             __func__, shm_name, shm_size);
+      close(shm_fd_tmp);
+      return NI_RETCODE_FAILURE;
+    }
+  }
+
   *shm_fd = shm_fd_tmp;
 
   return NI_RETCODE_SUCCESS;
@@ -1823,6 +2230,8 @@ ni_retcode_t ni_rsrc_remove_all_shm()
 
   ni_log(NI_LOG_ERROR, "Deleting shared memory files in %s\n", LOCK_DIR);
 
+  ni_rsrc_retire_load_table();
+
   char errmsg[NI_ERRNO_LEN] = {0};
   dir = opendir(LOCK_DIR);
   if (!dir) {
@@ -1868,4 +2277,161 @@ ni_retcode_t ni_rsrc_remove_all_shm()
   return NI_RETCODE_SUCCESS;
 }
 
+static pthread_mutex_t g_load_table_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ni_device_load_table_t *g_load_table = NULL;
+
+/*!******************************************************************************
+ *  \brief   map the device load table, creating it if needed
+ *
+ *  The table is mapped once per process. When the resource pool is recreated
+ *  the old table is marked retired before it is unlinked and the new one is
+ *  mapped on next use; the retired mapping is kept since lock-free readers
+ *  may still be looking at it.
+ *
+ *  \return  pointer to the table, NULL on failure
+ *******************************************************************************/
+ni_device_load_table_t *ni_rsrc_get_load_table_priv(void)
+{
+  ni_device_load_table_t *p_table = __atomic_load_n(&g_load_table, __ATOMIC_ACQUIRE);
+  ni_rsrc_shm_state state = NI_RSRC_SHM_IS_INVALID;
+  int shm_fd = -1;
+  void *p_addr = NULL;
+
+  if (p_table && !__atomic_load_n(&p_table->retired, __ATOMIC_ACQUIRE))
+  {
+    return p_table;
+  }
+
+  pthread_mutex_lock(&g_load_table_mutex);
+  p_table = g_load_table;
+  if (p_table && !__atomic_load_n(&p_table->retired, __ATOMIC_ACQUIRE))
+  {
+    LRETURN;
+  }
+  p_table = NULL;
+
+  if (ni_rsrc_open_shm(LOAD_SHM_NAME, sizeof(ni_device_load_table_t), &state,
+                       &shm_fd) < 0)
+  {
+    ni_log(NI_LOG_ERROR, "%s(): Failed to ni_rsrc_open_shm\n", __func__);
+    LRETURN;
+  }
+  if (ni_rsrc_mmap_shm(LOAD_SHM_NAME, shm_fd, sizeof(ni_device_load_table_t),
+                       &p_addr) < 0)
+  {
+    ni_log(NI_LOG_ERROR, "%s(): Failed to ni_rsrc_mmap_shm\n", __func__);
+    p_addr = NULL;
+  }
+#ifndef __OPENHARMONY__
+  close(shm_fd);
+#endif
+  if (p_addr)
+  {
+    p_table = (ni_device_load_table_t *)p_addr;
+    __atomic_store_n(&g_load_table, p_table, __ATOMIC_RELEASE);
+  }
+
+END:
+  pthread_mutex_unlock(&g_load_table_mutex);
+  return p_table;
+}
+
+/*!******************************************************************************
+ *  \brief   publish the load fields of a device record to the load table
+ *
+ *  Callers hold the lock of the device, which serializes the writers of the
+ *  record; readers use the sequence number and never block.
+ *
+ *  \param[in] p_device_info  device record whose load was just updated
+ *
+ *  \return  None
+ *******************************************************************************/
+void ni_rsrc_publish_device_load(const ni_device_info_t *p_device_info)
+{
+  ni_device_load_table_t *p_table;
+  ni_device_load_record_t *p_record;
+  uint32_t seq;
+
+  if (!p_device_info || !IS_XCODER_DEVICE_TYPE(p_device_info->device_type) ||
+      p_device_info->module_id < 0 ||
+      p_device_info->module_id >= NI_MAX_DEVICE_CNT)
+  {
+    return;
+  }
+
+  p_table = ni_rsrc_get_load_table_priv();
+  if (!p_table)
+  {
+    return;
+  }
+  p_record = &p_table->records[p_device_info->device_type][p_device_info->module_id];
+
+  // odd while updating, also recovers the parity left by a writer that died
+  seq = (__atomic_load_n(&p_record->seq, __ATOMIC_RELAXED) + 1) | 1;
+  __atomic_store_n(&p_record->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  __atomic_store_n(&p_record->load, p_device_info->load, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->model_load, p_device_info->model_load, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->active_num_inst, p_device_info->active_num_inst,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->max_instance_cnt, p_device_info->max_instance_cnt,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->xcode_load_pixel, p_device_info->xcode_load_pixel,
+                   __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->update_cnt, p_record->update_cnt + 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->valid, 1, __ATOMIC_RELAXED);
+
+  __atomic_store_n(&p_record->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/*!******************************************************************************
+ *  \brief   mark a device as no longer in the resource pool in the load table
+ *
+ *  \param[in] device_type  device type
+ *  \param[in] guid         device guid
+ *
+ *  \return  None
+ *******************************************************************************/
+void ni_rsrc_clear_device_load(ni_device_type_t device_type, int32_t guid)
+{
+  ni_device_load_table_t *p_table;
+  ni_device_load_record_t *p_record;
+  uint32_t seq;
+
+  if (!IS_XCODER_DEVICE_TYPE(device_type) || guid < 0 || guid >= NI_MAX_DEVICE_CNT)
+  {
+    return;
+  }
+
+  p_table = ni_rsrc_get_load_table_priv();
+  if (!p_table)
+  {
+    return;
+  }
+  p_record = &p_table->records[device_type][guid];
+
+  seq = (__atomic_load_n(&p_record->seq, __ATOMIC_RELAXED) + 1) | 1;
+  __atomic_store_n(&p_record->seq, seq, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  __atomic_store_n(&p_record->valid, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&p_record->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/*!******************************************************************************
+ *  \brief   mark the load table retired so that every process remaps it once
+ *           the resource pool is recreated
+ *
+ *  \return  None
+ *******************************************************************************/
+void ni_rsrc_retire_load_table(void)
+{
+  ni_device_load_table_t *p_table = ni_rsrc_get_load_table_priv();
+
+  if (p_table)
+  {
+    __atomic_store_n(&p_table->retired, 1, __ATOMIC_RELEASE);
+  }
+}
+
 #endif
@@ -44,6 +44,7 @@ extern "C" {
 
 #define CODERS_LCK_NAME LOCK_DIR "/NI_LCK_CODERS"
 #define CODERS_SHM_NAME "NI_SHM_CODERS"
+#define LOAD_SHM_NAME   "NI_SHM_LOAD"
 
 #ifdef __OPENHARMONY__
 #define PROJ_ID         818565  //the ascii value for "QUA": 81 85 65
@@ -92,6 +93,18 @@ void get_dev_pcie_addr(char *device_name,
 
 ni_retcode_t ni_rsrc_create_retry_lck();
 
+// load record field compared by ni_rsrc_pick_least_loaded()
+typedef enum _ni_load_key
+{
+  NI_LOAD_KEY_LOAD,        // ni_device_load_record_t.load
+  NI_LOAD_KEY_MODEL_LOAD,  // ni_device_load_record_t.model_load
+  NI_LOAD_KEY_INST,        // ni_device_load_record_t.active_num_inst
+} ni_load_key_t;
+
+int ni_rsrc_pick_least_loaded(ni_device_type_t device_type, ni_load_key_t key,
+                              bool inst_tie_break, const int *p_guids,
+                              int count);
+
 #if __linux__ || __APPLE__
 typedef enum _ni_rsrc_shm_state
 {
@@ -106,6 +119,10 @@ ni_retcode_t ni_rsrc_try_get_shm_lock(const char *lck_name,
                                       const mode_t mode,
                                       int *lck_fd);
 
+ni_retcode_t ni_rsrc_lock_fd(int lck_fd, int timeout_ms);
+
+ni_retcode_t ni_rsrc_unlock_fd(int lck_fd);
+
 ni_retcode_t ni_rsrc_open_shm(const char *shm_name,
                               int shm_size,
                               ni_rsrc_shm_state *state,
@@ -123,6 +140,21 @@ ni_retcode_t ni_rsrc_remove_shm(const char *shm_name,
                                 int shm_size);
 
 ni_retcode_t ni_rsrc_remove_all_shm();
+
+#define NI_LOAD_READ_RETRY 1000  // seqlock read attempts before giving up
+
+// layout of LOAD_SHM_NAME, the header keeps the records cache line aligned
+typedef struct _ni_device_load_table
+{
+  uint32_t retired;       // set before the table is unlinked, remap on read
+  uint8_t reserved[60];
+  ni_device_load_record_t records[NI_DEVICE_TYPE_XCODER_MAX][NI_MAX_DEVICE_CNT];
+} ni_device_load_table_t;
+
+ni_device_load_table_t *ni_rsrc_get_load_table_priv(void);
+void ni_rsrc_publish_device_load(const ni_device_info_t *p_device_info);
+void ni_rsrc_clear_device_load(ni_device_type_t device_type, int32_t guid);
+void ni_rsrc_retire_load_table(void);
 #endif
 
 #ifdef __cplusplus
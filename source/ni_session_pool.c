@@ -0,0 +1,580 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_session_pool.c
+ *
+ *  \brief  Pool of warm decoder, encoder and scaler sessions that are reused
+ *          across short jobs instead of being opened and closed every time
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+#include "ni_session_pool.h"
+
+// ----------------------------------------------------------------------------
+// helpers, called with the pool mutex held unless noted
+// ----------------------------------------------------------------------------
+
+static int ni_session_pool_key_match(const ni_session_pool_key_t *p_entry_key,
+                                     const ni_session_pool_key_t *p_key)
+{
+    return p_entry_key->device_type == p_key->device_type &&
+        (p_key->hw_id < 0 || p_entry_key->hw_id == p_key->hw_id) &&
+        p_entry_key->codec_format == p_key->codec_format &&
+        p_entry_key->config_tag == p_key->config_tag;
+}
+
+// an encoder that was never fed keeps its resolution, a drained one was put
+// in SESSION_RUN_STATE_FLUSHING on release and can be restarted at any
+// resolution
+static int ni_session_pool_can_reuse(const ni_session_pool_entry_t *p_entry,
+                                     const ni_session_pool_key_t *p_key,
+                                     int width, int height)
+{
+    if (NI_SESSION_POOL_ENTRY_IDLE != p_entry->state ||
+        !ni_session_pool_key_match(&p_entry->key, p_key))
+    {
+        return 0;
+    }
+    if (NI_DEVICE_TYPE_ENCODER == p_key->device_type &&
+        SESSION_RUN_STATE_FLUSHING != p_entry->p_ctx->session_run_state)
+    {
+        return p_entry->width == width && p_entry->height == height;
+    }
+    return 1;
+}
+
+static ni_session_pool_entry_t *ni_session_pool_find(ni_session_pool_t *p_pool,
+                                                     const ni_session_context_t *p_ctx)
+{
+    int i;
+
+    for (i = 0; i < NI_SESSION_POOL_MAX_SESSIONS; i++)
+    {
+        if (NI_SESSION_POOL_ENTRY_FREE != p_pool->entries[i].state &&
+            p_pool->entries[i].p_ctx == p_ctx)
+        {
+            return &p_pool->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static ni_session_pool_entry_t *ni_session_pool_new_entry(ni_session_pool_t *p_pool)
+{
+    int i;
+
+    for (i = 0; i < NI_SESSION_POOL_MAX_SESSIONS; i++)
+    {
+        if (NI_SESSION_POOL_ENTRY_FREE == p_pool->entries[i].state)
+        {
+            return &p_pool->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// close a session that left the pool, called without the pool mutex
+static void ni_session_pool_close(ni_session_pool_t *p_pool,
+                                  const ni_session_pool_key_t *p_key,
+                                  ni_session_context_t *p_ctx)
+{
+    ni_log(NI_LOG_DEBUG, "%s: close %s session %u on card %d\n", __func__,
+           GET_XCODER_DEVICE_TYPE_STR(p_key->device_type), p_ctx->session_id,
+           p_ctx->hw_id);
+
+    if (p_pool->close_session)
+    {
+        p_pool->close_session(p_pool->opaque, p_key, p_ctx);
+    } else
+    {
+        ni_device_session_close(p_ctx, 1, p_key->device_type);
+        ni_device_close(p_ctx->device_handle);
+        if (p_ctx->blk_io_handle != p_ctx->device_handle)
+        {
+            ni_device_close(p_ctx->blk_io_handle);
+        }
+        ni_device_session_context_free(p_ctx);
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    p_pool->stats.closed++;
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+}
+
+// whether an encoder released by its job can be kept: either it was never fed,
+// or its end of stream was sent (ready_to_close) and the device reports it
+// fully flushed, ie. the caller received the end of stream packet. A drained
+// encoder is put in SESSION_RUN_STATE_FLUSHING, the state
+// ni_device_session_restart() expects, unless the caller did so already.
+// Called without the pool mutex.
+static int ni_session_pool_encoder_keep(ni_session_context_t *p_ctx)
+{
+    ni_instance_mgr_stream_info_t data = {0};
+    ni_retcode_t retval;
+
+    if (SESSION_RUN_STATE_FLUSHING == p_ctx->session_run_state)
+    {
+        return 1;
+    }
+    if (SESSION_RUN_STATE_NORMAL != p_ctx->session_run_state)
+    {
+        return 0;
+    }
+    if (!p_ctx->ready_to_close)
+    {
+        return 0 == p_ctx->frame_num;
+    }
+
+    ni_pthread_mutex_lock(&p_ctx->mutex);
+    retval = ni_query_stream_info(p_ctx, NI_DEVICE_TYPE_ENCODER, &data);
+    ni_pthread_mutex_unlock(&p_ctx->mutex);
+    if (NI_RETCODE_SUCCESS != retval || !data.is_flushed)
+    {
+        // still mid stream, the packets left would leak into the next job
+        return 0;
+    }
+    p_ctx->session_run_state = SESSION_RUN_STATE_FLUSHING;
+    return 1;
+}
+
+// bring a warm session to a ready state, called without the pool mutex
+static ni_retcode_t ni_session_pool_reconfig(ni_session_pool_entry_t *p_entry,
+                                             int width, int height)
+{
+    ni_session_context_t *p_ctx = p_entry->p_ctx;
+    ni_retcode_t retval;
+
+    if (NI_DEVICE_TYPE_ENCODER != p_entry->key.device_type ||
+        SESSION_RUN_STATE_FLUSHING != p_ctx->session_run_state)
+    {
+        // decoders were flushed on release, scalers are stateless
+        return NI_RETCODE_SUCCESS;
+    }
+
+    retval = ni_device_session_restart(p_ctx, width, height,
+                                       NI_DEVICE_TYPE_ENCODER);
+    if (NI_RETCODE_SUCCESS != retval)
+    {
+        return retval;
+    }
+    p_ctx->session_run_state = SESSION_RUN_STATE_NORMAL;
+    p_entry->width = width;
+    p_entry->height = height;
+    return NI_RETCODE_SUCCESS;
+}
+
+static void *ni_session_pool_reaper(void *arg)
+{
+    ni_session_pool_t *p_pool = (ni_session_pool_t *)arg;
+    uint64_t abs_time_ns;
+    struct timespec ts;
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    while (!p_pool->stop)
+    {
+        abs_time_ns = ni_gettime_ns() +
+            p_pool->ttl_ns / NI_SESSION_POOL_REAP_DIVISOR;
+        ts.tv_sec = abs_time_ns / 1000000000LL;
+        ts.tv_nsec = abs_time_ns % 1000000000LL;
+        ni_pthread_cond_timedwait(&p_pool->cond, &p_pool->mutex, &ts);
+        if (p_pool->stop)
+        {
+            break;
+        }
+        ni_pthread_mutex_unlock(&p_pool->mutex);
+        ni_session_pool_reap(p_pool);
+        ni_pthread_mutex_lock(&p_pool->mutex);
+    }
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+    return NULL;
+}
+
+// ----------------------------------------------------------------------------
+// public API
+// ----------------------------------------------------------------------------
+
+ni_session_pool_t *ni_session_pool_alloc(int max_idle, int idle_ttl_ms,
+                                         ni_session_pool_open_cb open_session,
+                                         ni_session_pool_close_cb close_session,
+                                         void *opaque)
+{
+    ni_session_pool_t *p_pool;
+
+    if (max_idle <= 0)
+    {
+        max_idle = NI_SESSION_POOL_MAX_SESSIONS;
+    }
+    if (idle_ttl_ms <= 0)
+    {
+        idle_ttl_ms = NI_SESSION_POOL_DEFAULT_TTL_MS;
+    }
+    if (max_idle > NI_SESSION_POOL_MAX_SESSIONS)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid max idle sessions %d\n",
+               __func__, max_idle);
+        return NULL;
+    }
+
+    p_pool = (ni_session_pool_t *)calloc(1, sizeof(ni_session_pool_t));
+    if (!p_pool)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() alloc failed\n", NI_ERRNO,
+               __func__);
+        return NULL;
+    }
+
+    p_pool->max_idle = max_idle;
+    p_pool->ttl_ns = (uint64_t)idle_ttl_ms * 1000000LL;
+    p_pool->open_session = open_session;
+    p_pool->close_session = close_session;
+    p_pool->opaque = opaque;
+    ni_pthread_mutex_init(&p_pool->mutex);
+    ni_pthread_cond_init(&p_pool->cond, NULL);
+
+    if (ni_pthread_create(&p_pool->reaper, NULL, ni_session_pool_reaper,
+                          p_pool) == 0)
+    {
+        p_pool->reaper_started = 1;
+    } else
+    {
+        // idle sessions are still reaped by explicit ni_session_pool_reap()
+        ni_log(NI_LOG_ERROR, "ERROR %d: %s() failed to start reaper\n",
+               NI_ERRNO, __func__);
+    }
+    return p_pool;
+}
+
+int ni_session_pool_prewarm(ni_session_pool_t *p_pool,
+                            const ni_session_pool_key_t *p_key, int width,
+                            int height, int count)
+{
+    ni_session_context_t *p_ctx = NULL;
+    ni_retcode_t retval;
+    int added = 0;
+
+    if (!p_pool || !p_key || !p_pool->open_session || count < 0)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    while (added < count)
+    {
+        retval = p_pool->open_session(p_pool->opaque, p_key, width, height,
+                                      &p_ctx);
+        if (NI_RETCODE_SUCCESS != retval || !p_ctx)
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() open failed %d\n", __func__,
+                   retval);
+            return added ? added : retval;
+        }
+        if (NI_RETCODE_SUCCESS != ni_session_pool_release(p_pool, p_key, p_ctx))
+        {
+            // pool full, the session was closed
+            break;
+        }
+        added++;
+    }
+    return added;
+}
+
+ni_retcode_t ni_session_pool_acquire(ni_session_pool_t *p_pool,
+                                     const ni_session_pool_key_t *p_key,
+                                     int width, int height,
+                                     ni_session_context_t **pp_ctx)
+{
+    ni_session_pool_entry_t *p_entry;
+    ni_session_pool_key_t key;
+    ni_session_context_t *p_ctx = NULL;
+    ni_retcode_t retval;
+    uint64_t start = ni_gettime_ns();
+    int i;
+
+    if (!p_pool || !p_key || !pp_ctx)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    *pp_ctx = NULL;
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    for (;;)
+    {
+        // most recently released first, its device state is the warmest
+        p_entry = NULL;
+        for (i = 0; i < NI_SESSION_POOL_MAX_SESSIONS; i++)
+        {
+            if (ni_session_pool_can_reuse(&p_pool->entries[i], p_key, width,
+                                          height) &&
+                (!p_entry || p_pool->entries[i].idle_since > p_entry->idle_since))
+            {
+                p_entry = &p_pool->entries[i];
+            }
+        }
+        if (!p_entry)
+        {
+            break;
+        }
+
+        p_entry->state = NI_SESSION_POOL_ENTRY_IN_USE;
+        p_pool->stats.nb_idle--;
+        p_pool->stats.nb_in_use++;
+        ni_pthread_mutex_unlock(&p_pool->mutex);
+
+        retval = ni_session_pool_reconfig(p_entry, width, height);
+        if (NI_RETCODE_SUCCESS == retval)
+        {
+            *pp_ctx = p_entry->p_ctx;
+            ni_pthread_mutex_lock(&p_pool->mutex);
+            p_pool->stats.hits++;
+            p_pool->stats.hit_ns += ni_gettime_ns() - start;
+            ni_pthread_mutex_unlock(&p_pool->mutex);
+            return NI_RETCODE_SUCCESS;
+        }
+
+        ni_log(NI_LOG_INFO, "%s: warm %s session %u failed to reconfigure "
+               "(%d), closing it\n", __func__,
+               GET_XCODER_DEVICE_TYPE_STR(p_key->device_type),
+               p_entry->p_ctx->session_id, retval);
+        ni_pthread_mutex_lock(&p_pool->mutex);
+        key = p_entry->key;
+        p_ctx = p_entry->p_ctx;
+        p_entry->state = NI_SESSION_POOL_ENTRY_FREE;
+        p_pool->stats.nb_in_use--;
+        p_pool->stats.reconfig_fail++;
+        ni_pthread_mutex_unlock(&p_pool->mutex);
+        ni_session_pool_close(p_pool, &key, p_ctx);
+        ni_pthread_mutex_lock(&p_pool->mutex);
+    }
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+
+    if (!p_pool->open_session)
+    {
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+
+    retval = p_pool->open_session(p_pool->opaque, p_key, width, height, &p_ctx);
+    if (NI_RETCODE_SUCCESS != retval || !p_ctx)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() open failed %d\n", __func__, retval);
+        return (NI_RETCODE_SUCCESS != retval) ? retval : NI_RETCODE_FAILURE;
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    p_entry = ni_session_pool_new_entry(p_pool);
+    if (p_entry)
+    {
+        p_entry->state = NI_SESSION_POOL_ENTRY_IN_USE;
+        p_entry->key = *p_key;
+        p_entry->key.hw_id = p_ctx->hw_id;
+        p_entry->p_ctx = p_ctx;
+        p_entry->width = width;
+        p_entry->height = height;
+        p_pool->stats.nb_in_use++;
+    }
+    p_pool->stats.misses++;
+    p_pool->stats.miss_ns += ni_gettime_ns() - start;
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+
+    if (!p_entry)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() more than %d sessions in use\n",
+               __func__, NI_SESSION_POOL_MAX_SESSIONS);
+        ni_session_pool_close(p_pool, p_key, p_ctx);
+        return NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE;
+    }
+
+    *pp_ctx = p_ctx;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t ni_session_pool_release(ni_session_pool_t *p_pool,
+                                     const ni_session_pool_key_t *p_key,
+                                     ni_session_context_t *p_ctx)
+{
+    ni_session_pool_entry_t *p_entry;
+    ni_session_pool_key_t key;
+    ni_xcoder_params_t *p_param;
+    int keep = 1;
+
+    if (!p_pool || !p_ctx)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    p_entry = ni_session_pool_find(p_pool, p_ctx);
+    if (p_entry && NI_SESSION_POOL_ENTRY_IN_USE != p_entry->state)
+    {
+        ni_pthread_mutex_unlock(&p_pool->mutex);
+        ni_log(NI_LOG_ERROR, "ERROR: %s() session released twice\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+    if (!p_entry)
+    {
+        if (!p_key)
+        {
+            ni_pthread_mutex_unlock(&p_pool->mutex);
+            ni_log(NI_LOG_ERROR, "ERROR: %s() session not from this pool\n",
+                   __func__);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+        // adopt a session opened outside the pool
+        p_entry = ni_session_pool_new_entry(p_pool);
+        if (p_entry)
+        {
+            p_entry->state = NI_SESSION_POOL_ENTRY_IN_USE;
+            p_entry->key = *p_key;
+            p_entry->key.hw_id = p_ctx->hw_id;
+            p_entry->p_ctx = p_ctx;
+            p_param = (ni_xcoder_params_t *)p_ctx->p_session_config;
+            p_entry->width = p_param ? p_param->source_width : 0;
+            p_entry->height = p_param ? p_param->source_height : 0;
+            p_pool->stats.nb_in_use++;
+        } else
+        {
+            key = *p_key;
+            ni_pthread_mutex_unlock(&p_pool->mutex);
+            ni_session_pool_close(p_pool, &key, p_ctx);
+            return NI_RETCODE_FAILURE;
+        }
+    }
+    key = p_entry->key;
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+
+    // get the session ready for its next job while it is still ours
+    if (NI_DEVICE_TYPE_ENCODER == key.device_type)
+    {
+        keep = ni_session_pool_encoder_keep(p_ctx);
+    } else if (NI_DEVICE_TYPE_DECODER == key.device_type)
+    {
+        keep = (NI_RETCODE_SUCCESS == ni_device_dec_session_flush(p_ctx));
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    p_pool->stats.nb_in_use--;
+    if (keep && p_pool->stats.nb_idle < p_pool->max_idle && !p_pool->stop)
+    {
+        p_entry->state = NI_SESSION_POOL_ENTRY_IDLE;
+        p_entry->idle_since = ni_gettime_ns();
+        p_pool->stats.nb_idle++;
+        p_pool->stats.released++;
+        ni_pthread_mutex_unlock(&p_pool->mutex);
+        return NI_RETCODE_SUCCESS;
+    }
+    p_entry->state = NI_SESSION_POOL_ENTRY_FREE;
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+
+    ni_log(NI_LOG_DEBUG, "%s: not keeping %s session %u, reusable %d\n",
+           __func__, GET_XCODER_DEVICE_TYPE_STR(key.device_type),
+           p_ctx->session_id, keep);
+    ni_session_pool_close(p_pool, &key, p_ctx);
+    return NI_RETCODE_FAILURE;
+}
+
+int ni_session_pool_reap(ni_session_pool_t *p_pool)
+{
+    ni_session_pool_key_t keys[NI_SESSION_POOL_MAX_SESSIONS];
+    ni_session_context_t *ctxs[NI_SESSION_POOL_MAX_SESSIONS];
+    uint64_t now = ni_gettime_ns();
+    int nb_expired = 0;
+    int i;
+
+    if (!p_pool)
+    {
+        return 0;
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    for (i = 0; i < NI_SESSION_POOL_MAX_SESSIONS; i++)
+    {
+        ni_session_pool_entry_t *p_entry = &p_pool->entries[i];
+        if (NI_SESSION_POOL_ENTRY_IDLE == p_entry->state &&
+            (p_pool->stop || now - p_entry->idle_since >= p_pool->ttl_ns))
+        {
+            keys[nb_expired] = p_entry->key;
+            ctxs[nb_expired] = p_entry->p_ctx;
+            nb_expired++;
+            p_entry->state = NI_SESSION_POOL_ENTRY_FREE;
+            p_pool->stats.nb_idle--;
+            if (!p_pool->stop)
+            {
+                p_pool->stats.expired++;
+            }
+        }
+    }
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+
+    for (i = 0; i < nb_expired; i++)
+    {
+        ni_session_pool_close(p_pool, &keys[i], ctxs[i]);
+    }
+    return nb_expired;
+}
+
+ni_retcode_t ni_session_pool_get_stats(ni_session_pool_t *p_pool,
+                                       ni_session_pool_stats_t *p_stats)
+{
+    if (!p_pool || !p_stats)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    *p_stats = p_pool->stats;
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+    return NI_RETCODE_SUCCESS;
+}
+
+void ni_session_pool_free(ni_session_pool_t *p_pool)
+{
+    if (!p_pool)
+    {
+        return;
+    }
+
+    ni_pthread_mutex_lock(&p_pool->mutex);
+    p_pool->stop = 1;
+    ni_pthread_cond_signal(&p_pool->cond);
+    ni_pthread_mutex_unlock(&p_pool->mutex);
+    if (p_pool->reaper_started)
+    {
+        ni_pthread_join(p_pool->reaper, NULL);
+    }
+
+    // stop makes every idle session expire
+    ni_session_pool_reap(p_pool);
+    if (p_pool->stats.nb_in_use)
+    {
+        ni_log(NI_LOG_INFO, "%s: %d sessions still in use are left to the "
+               "caller\n", __func__, p_pool->stats.nb_in_use);
+    }
+
+    ni_pthread_mutex_destroy(&p_pool->mutex);
+    ni_pthread_cond_destroy(&p_pool->cond);
+    free(p_pool);
+}
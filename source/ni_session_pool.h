@@ -0,0 +1,240 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_session_pool.h
+ *
+ *  \brief  Pool of warm decoder, encoder and scaler sessions that are reused
+ *          across short jobs instead of being opened and closed every time
+ *
+ *          Sessions are grouped by ni_session_pool_key_t. A session returned
+ *          to the pool stays open on its card, with its keep alive thread
+ *          running, until it is acquired again or it has been idle for longer
+ *          than the pool TTL. Acquiring a warm session only reconfigures it:
+ *          drained encoders are restarted with ni_device_session_restart() at
+ *          the new resolution, decoders were flushed with
+ *          ni_device_dec_session_flush() when they were released and scalers
+ *          are reused as they are.
+ ******************************************************************************/
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "ni_device_api.h"
+
+#ifdef _WIN32
+  #ifdef XCODER_DLL
+    #ifdef LIB_EXPORTS
+      #define LIB_API_SESSION_POOL __declspec(dllexport)
+    #else
+      #define LIB_API_SESSION_POOL __declspec(dllimport)
+    #endif
+  #else
+    #define LIB_API_SESSION_POOL
+  #endif
+#elif __linux__ || __APPLE__
+  #define LIB_API_SESSION_POOL
+#endif
+
+#define NI_SESSION_POOL_MAX_SESSIONS   64
+#define NI_SESSION_POOL_DEFAULT_TTL_MS 30000
+// the reaper wakes up this many times per TTL period
+#define NI_SESSION_POOL_REAP_DIVISOR   4
+
+/*!*****************************************************************************
+ *  \brief  Identifies interchangeable sessions. Only sessions with equal keys
+ *          are handed out for each other.
+ ******************************************************************************/
+typedef struct _ni_session_pool_key
+{
+    ni_device_type_t device_type; // DECODER, ENCODER or SCALER
+    int hw_id;                    // card of the session, -1 for any card
+    int codec_format;             // NI_CODEC_FORMAT_*, 0 for scaler
+    uint64_t config_tag;          // caller defined id of the open parameters,
+                                  // eg. a hash of ni_xcoder_params_t
+} ni_session_pool_key_t;
+
+/*!*****************************************************************************
+ *  \brief  Open a new session for p_key, called on a pool miss and by
+ *          ni_session_pool_prewarm(). The session must be fully opened and
+ *          configured, as the caller would do without the pool, with its
+ *          hw_id set to the card it was opened on.
+ *
+ *  \return NI_RETCODE_SUCCESS and the session in *pp_ctx, error otherwise
+ ******************************************************************************/
+typedef ni_retcode_t (*ni_session_pool_open_cb)(void *opaque,
+                                                const ni_session_pool_key_t *p_key,
+                                                int width, int height,
+                                                ni_session_context_t **pp_ctx);
+
+/*!*****************************************************************************
+ *  \brief  Close a session evicted from the pool. When NULL the pool calls
+ *          ni_device_session_close(), closes the device handles and frees the
+ *          context with ni_device_session_context_free().
+ ******************************************************************************/
+typedef void (*ni_session_pool_close_cb)(void *opaque,
+                                         const ni_session_pool_key_t *p_key,
+                                         ni_session_context_t *p_ctx);
+
+// pool counters, see ni_session_pool_get_stats()
+typedef struct _ni_session_pool_stats
+{
+    uint64_t hits;           // acquires served by a warm session
+    uint64_t misses;         // acquires that opened a new session
+    uint64_t hit_ns;         // total acquire time of hits
+    uint64_t miss_ns;        // total acquire time of misses
+    uint64_t reconfig_fail;  // warm sessions that failed to reconfigure
+    uint64_t released;       // sessions returned to the pool
+    uint64_t closed;         // sessions closed by the pool, any reason
+    uint64_t expired;        // sessions closed for idling past the TTL
+    int nb_idle;             // sessions currently idle in the pool
+    int nb_in_use;           // sessions currently handed out
+} ni_session_pool_stats_t;
+
+typedef enum _ni_session_pool_entry_state
+{
+    NI_SESSION_POOL_ENTRY_FREE = 0,
+    NI_SESSION_POOL_ENTRY_IDLE,
+    NI_SESSION_POOL_ENTRY_IN_USE,
+} ni_session_pool_entry_state_t;
+
+typedef struct _ni_session_pool_entry
+{
+    ni_session_pool_entry_state_t state;
+    ni_session_pool_key_t key;
+    ni_session_context_t *p_ctx;
+    int width;               // resolution the session is configured for
+    int height;
+    uint64_t idle_since;     // ni_gettime_ns() when it was released
+} ni_session_pool_entry_t;
+
+typedef struct _ni_session_pool
+{
+    ni_session_pool_entry_t entries[NI_SESSION_POOL_MAX_SESSIONS];
+    int max_idle;
+    uint64_t ttl_ns;
+
+    ni_session_pool_open_cb open_session;
+    ni_session_pool_close_cb close_session;
+    void *opaque;
+
+    ni_pthread_t reaper;
+    int reaper_started;
+    int stop;
+    ni_pthread_mutex_t mutex;
+    ni_pthread_cond_t cond;
+
+    ni_session_pool_stats_t stats;
+} ni_session_pool_t;
+
+/*!*****************************************************************************
+ *  \brief  Allocate a session pool and start its reaper thread
+ *
+ *  \param[in] max_idle       max number of idle sessions kept, 0 for
+ *                            NI_SESSION_POOL_MAX_SESSIONS
+ *  \param[in] idle_ttl_ms    idle sessions are closed after this long, 0 for
+ *                            NI_SESSION_POOL_DEFAULT_TTL_MS
+ *  \param[in] open_session   opens sessions on a miss, may be NULL if
+ *                            sessions are only added by
+ *                            ni_session_pool_release()
+ *  \param[in] close_session  closes evicted sessions, NULL for default
+ *  \param[in] opaque         passed to the callbacks
+ *
+ *  \return pointer to the pool on success, NULL otherwise
+ ******************************************************************************/
+LIB_API_SESSION_POOL ni_session_pool_t *ni_session_pool_alloc(
+    int max_idle, int idle_ttl_ms, ni_session_pool_open_cb open_session,
+    ni_session_pool_close_cb close_session, void *opaque);
+
+/*!*****************************************************************************
+ *  \brief  Open up to count sessions for p_key ahead of time and park them
+ *          in the pool
+ *
+ *  \return number of sessions added, negative ni_retcode_t on error
+ ******************************************************************************/
+LIB_API_SESSION_POOL int ni_session_pool_prewarm(ni_session_pool_t *p_pool,
+                                                 const ni_session_pool_key_t *p_key,
+                                                 int width, int height,
+                                                 int count);
+
+/*!*****************************************************************************
+ *  \brief  Get a ready session for p_key at width x height, reusing an idle
+ *          one when possible and opening a new one otherwise. A warm session
+ *          that fails to reconfigure is closed and the next one is tried.
+ *
+ *  \return NI_RETCODE_SUCCESS and the session in *pp_ctx,
+ *          NI_RETCODE_ERROR_RESOURCE_UNAVAILABLE if no session is idle and
+ *          the pool has no open callback, error of the open callback otherwise
+ ******************************************************************************/
+LIB_API_SESSION_POOL ni_retcode_t ni_session_pool_acquire(
+    ni_session_pool_t *p_pool, const ni_session_pool_key_t *p_key, int width,
+    int height, ni_session_context_t **pp_ctx);
+
+/*!*****************************************************************************
+ *  \brief  Return a session to the pool once its job is done.
+ *
+ *          p_key may be NULL for sessions obtained by
+ *          ni_session_pool_acquire(); a session opened outside the pool is
+ *          adopted with the given key. An encoder is kept only if it was
+ *          never fed, or if it is drained: its end of stream was sent with
+ *          ni_device_session_flush() or an end_of_stream frame and the end of
+ *          stream packet was read back, so the device reports it flushed.
+ *          A drained encoder is parked in SESSION_RUN_STATE_FLUSHING and
+ *          restarted by the next acquire. A decoder is kept if
+ *          ni_device_dec_session_flush() succeeds. Sessions that can not be
+ *          kept, or that exceed max_idle, are closed.
+ *
+ *  \return NI_RETCODE_SUCCESS if the session was kept, NI_RETCODE_FAILURE
+ *          if it was closed, NI_RETCODE_INVALID_PARAM otherwise
+ ******************************************************************************/
+LIB_API_SESSION_POOL ni_retcode_t ni_session_pool_release(
+    ni_session_pool_t *p_pool, const ni_session_pool_key_t *p_key,
+    ni_session_context_t *p_ctx);
+
+/*!*****************************************************************************
+ *  \brief  Close the sessions idle for longer than the TTL now. The reaper
+ *          thread does this periodically.
+ *
+ *  \return number of sessions closed
+ ******************************************************************************/
+LIB_API_SESSION_POOL int ni_session_pool_reap(ni_session_pool_t *p_pool);
+
+/*!*****************************************************************************
+ *  \brief  Snapshot the pool counters
+ *
+ *  \return NI_RETCODE_SUCCESS on success, NI_RETCODE_INVALID_PARAM otherwise
+ ******************************************************************************/
+LIB_API_SESSION_POOL ni_retcode_t ni_session_pool_get_stats(
+    ni_session_pool_t *p_pool, ni_session_pool_stats_t *p_stats);
+
+/*!*****************************************************************************
+ *  \brief  Stop the reaper, close all idle sessions and free the pool.
+ *          Sessions still handed out are not closed and remain owned by the
+ *          caller.
+ ******************************************************************************/
+LIB_API_SESSION_POOL void ni_session_pool_free(ni_session_pool_t *p_pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -40,8 +40,24 @@
 #include <linux/fs.h>
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NI_UTIL_SSE2
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define NI_UTIL_AVX2
+#define NI_UTIL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NI_UTIL_NEON
+#endif
+
 #include "ni_nvme.h"
 #include "ni_util.h"
+#include "ni_device_api_priv.h"
 
 typedef struct _ni_err_rc_txt_entry
 {
@@ -216,6 +232,411 @@ int ni_posix_memalign(void **memptr, size_t alignment, size_t size)
 #endif
 }
 
+// -1 until NI_XCODER_HUGE_PAGES has been read, see ni_set_huge_pages()
+static int g_huge_pages = -1;
+
+/*!*****************************************************************************
+ *  \brief  Enable or disable transparent huge page backing of large frame
+ *          and packet buffers for the process. When not set, the
+ *          NI_XCODER_HUGE_PAGES environment variable is used, "1" enables it;
+ *          it is disabled by default. Buffers allocated afterwards are
+ *          affected, buffers already in the buffer cache are kept as they are.
+ *
+ *  \param[in] enable  1 to back buffers of NI_HUGE_PAGE_SIZE or more with
+ *                     huge pages, 0 for regular pages
+ *
+ *  \return  None
+ ******************************************************************************/
+void ni_set_huge_pages(int enable)
+{
+    g_huge_pages = !!enable;
+}
+
+static int ni_huge_pages_enabled(void)
+{
+    const char *p_env;
+
+    if (g_huge_pages < 0)
+    {
+        p_env = getenv("NI_XCODER_HUGE_PAGES");
+        g_huge_pages = (p_env && atoi(p_env) > 0);
+    }
+    return g_huge_pages;
+}
+
+/*!*****************************************************************************
+ *  \brief  Allocate a page aligned frame or packet buffer. When huge pages
+ *          are enabled, see ni_set_huge_pages(), a buffer of at least
+ *          NI_HUGE_PAGE_SIZE is aligned to NI_HUGE_PAGE_SIZE and advised to
+ *          be backed by transparent huge pages, which cuts the TLB misses of
+ *          frame copies and the pages the driver pins for a transfer. If the
+ *          kernel does not support it, regular pages are used. The buffer is
+ *          freed with ni_aligned_free() either way.
+ *
+ *  \param[out] memptr  allocated buffer
+ *  \param[in]  size    buffer size
+ *
+ *  \return  0 for success, ENOMEM for error
+ ******************************************************************************/
+int ni_frame_memalign(void **memptr, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (size >= NI_HUGE_PAGE_SIZE && ni_huge_pages_enabled() &&
+        0 == posix_memalign(memptr, NI_HUGE_PAGE_SIZE, size))
+    {
+        // only fully covered huge pages can be huge, the tail stays in
+        // regular pages; failure (eg. THP disabled) is harmless
+        (void)madvise(*memptr, size & ~((size_t)NI_HUGE_PAGE_SIZE - 1),
+                      MADV_HUGEPAGE);
+        return 0;
+    }
+#endif
+    return ni_posix_memalign(memptr, NI_MEM_PAGE_ALIGNMENT, size);
+}
+
+/*!*****************************************************************************
+ *  Process wide cache of page aligned packet and frame buffers.
+ *
+ *  Buffer sizes are rounded up to a size class, four classes per power of
+ *  two from NI_MEM_CACHE_MIN_SIZE to NI_MEM_CACHE_MAX_SIZE. Each class keeps
+ *  up to NI_MEM_CACHE_CLASS_DEPTH idle buffers, handed out newest first.
+ *  The least recently returned buffers are freed when the idle buffers
+ *  exceed the byte limit or have been idle for NI_MEM_CACHE_IDLE_TTL_MS,
+ *  checked on every get and put and when a session is closed.
+ ******************************************************************************/
+typedef struct _ni_mem_cache_entry
+{
+    void *p_buf;
+    uint64_t put_time;     // ni_gettime_ns() when the buffer was returned
+} ni_mem_cache_entry_t;
+
+typedef struct _ni_mem_cache_class
+{
+    ni_mem_cache_entry_t entries[NI_MEM_CACHE_CLASS_DEPTH];
+    int oldest;            // ring index of the least recently returned
+    int count;
+} ni_mem_cache_class_t;
+
+static ni_mem_cache_class_t g_mem_cache[NI_MEM_CACHE_NB_CLASSES];
+static size_t g_mem_cache_idle_bytes = 0;
+static size_t g_mem_cache_max_idle_bytes = NI_MEM_CACHE_MAX_IDLE_BYTES;
+#ifdef _WIN32
+static ni_pthread_mutex_t g_mem_cache_mutex;
+static INIT_ONCE g_mem_cache_init_once = INIT_ONCE_STATIC_INIT;
+
+static BOOL CALLBACK ni_mem_cache_init_once_callback(PINIT_ONCE InitOnce,
+                                                     PVOID Parameter,
+                                                     PVOID *Context)
+{
+    ni_pthread_mutex_init(&g_mem_cache_mutex);
+    return true;
+}
+#else
+static ni_pthread_mutex_t g_mem_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static void ni_mem_cache_lock(void)
+{
+#ifdef _WIN32
+    InitOnceExecuteOnce(&g_mem_cache_init_once,
+                        ni_mem_cache_init_once_callback, NULL, NULL);
+#endif
+    ni_pthread_mutex_lock(&g_mem_cache_mutex);
+}
+
+// Get the class of a buffer size and the size of that class.
+// return class index, -1 if the size is not cached
+static int ni_mem_cache_class(size_t size, size_t *p_class_size)
+{
+    size_t step;
+    int log2_size = 0;
+
+    if (size <= NI_MEM_CACHE_MIN_SIZE)
+    {
+        *p_class_size = NI_MEM_CACHE_MIN_SIZE;
+        return 0;
+    }
+    if (size > NI_MEM_CACHE_MAX_SIZE)
+    {
+        return -1;
+    }
+    while (((size_t)1 << (log2_size + 1)) < size)
+    {
+        log2_size++;
+    }
+    // size is in (2^log2_size, 2^(log2_size + 1)], split in four classes
+    step = (size_t)1 << (log2_size - 2);
+    *p_class_size = (size + step - 1) / step * step;
+    return 1 + 4 * (log2_size - NI_MEM_CACHE_MIN_LOG2) +
+        (int)(*p_class_size / step) - 5;
+}
+
+// Get the size of the buffers of a class.
+static size_t ni_mem_cache_class_size(int idx)
+{
+    if (!idx)
+    {
+        return NI_MEM_CACHE_MIN_SIZE;
+    }
+    return ((size_t)1 << ((idx - 1) / 4 + NI_MEM_CACHE_MIN_LOG2 - 2)) *
+        ((idx - 1) % 4 + 5);
+}
+
+// Drop idle buffers from the least recently returned until the idle bytes
+// are within max_idle_bytes and none is older than the TTL. The buffers to
+// free are stored in pp_free, at most max_free of them.
+// return number of buffers stored in pp_free
+static int ni_mem_cache_evict_locked(size_t max_idle_bytes, uint64_t now,
+                                     void **pp_free, int max_free)
+{
+    ni_mem_cache_class_t *p_class, *p_lru;
+    size_t class_size;
+    int nb_free = 0;
+    int i;
+
+    while (nb_free < max_free)
+    {
+        p_lru = NULL;
+        for (i = 0; i < NI_MEM_CACHE_NB_CLASSES; i++)
+        {
+            p_class = &g_mem_cache[i];
+            if (p_class->count &&
+                (!p_lru ||
+                 p_class->entries[p_class->oldest].put_time <
+                     p_lru->entries[p_lru->oldest].put_time))
+            {
+                p_lru = p_class;
+            }
+        }
+        if (!p_lru ||
+            (g_mem_cache_idle_bytes <= max_idle_bytes &&
+             now - p_lru->entries[p_lru->oldest].put_time <
+                 (uint64_t)NI_MEM_CACHE_IDLE_TTL_MS * 1000000))
+        {
+            break;
+        }
+
+        class_size = ni_mem_cache_class_size((int)(p_lru - g_mem_cache));
+        pp_free[nb_free++] = p_lru->entries[p_lru->oldest].p_buf;
+        p_lru->oldest = (p_lru->oldest + 1) % NI_MEM_CACHE_CLASS_DEPTH;
+        p_lru->count--;
+        g_mem_cache_idle_bytes -= class_size;
+    }
+    return nb_free;
+}
+
+/*!*****************************************************************************
+ *  \brief  Get a page aligned buffer of at least *p_size bytes, reusing an
+ *          idle one of the same size class when available, or else an idle
+ *          one up to NI_MEM_CACHE_RECARVE_CLASSES classes larger, so that
+ *          buffers kept from a higher resolution serve a lower one
+ *
+ *  \param[in/out] p_size  requested size, set to the size of the buffer
+ *
+ *  \return  buffer, NULL if it could not be allocated
+ ******************************************************************************/
+void *ni_mem_cache_get(size_t *p_size)
+{
+    ni_mem_cache_class_t *p_class;
+    void *p_buf = NULL;
+    void *p_free[NI_MEM_CACHE_CLASS_DEPTH];
+    size_t class_size = *p_size;
+    int idx, i, nb_free = 0;
+
+    idx = ni_mem_cache_class(*p_size, &class_size);
+    if (idx >= 0)
+    {
+        uint64_t now = ni_gettime_ns();
+
+        ni_mem_cache_lock();
+        for (i = idx; i < NI_MEM_CACHE_NB_CLASSES &&
+             i <= idx + NI_MEM_CACHE_RECARVE_CLASSES; i++)
+        {
+            p_class = &g_mem_cache[i];
+            if (p_class->count)
+            {
+                if (i != idx)
+                {
+                    class_size = ni_mem_cache_class_size(i);
+                }
+                p_class->count--;
+                p_buf = p_class->entries[(p_class->oldest + p_class->count) %
+                                         NI_MEM_CACHE_CLASS_DEPTH].p_buf;
+                g_mem_cache_idle_bytes -= class_size;
+                break;
+            }
+        }
+        // a process that stopped returning buffers still ages out the rest
+        nb_free = ni_mem_cache_evict_locked(g_mem_cache_max_idle_bytes, now,
+                                            p_free, NI_MEM_CACHE_CLASS_DEPTH);
+        ni_pthread_mutex_unlock(&g_mem_cache_mutex);
+    }
+
+    while (nb_free--)
+    {
+        ni_aligned_free(p_free[nb_free]);
+    }
+    if (!p_buf && ni_frame_memalign(&p_buf, class_size))
+    {
+        return NULL;
+    }
+    *p_size = class_size;
+    return p_buf;
+}
+
+/*!*****************************************************************************
+ *  \brief  Return a buffer to the cache. Buffers that do not have the size
+ *          of a class or are not page aligned are freed.
+ *
+ *  \param[in] p_buf  buffer allocated with ni_posix_memalign(), may be NULL
+ *  \param[in] size   size of the buffer
+ *
+ *  \return  None
+ ******************************************************************************/
+void ni_mem_cache_put(void *p_buf, size_t size)
+{
+    ni_mem_cache_class_t *p_class;
+    void *p_free[NI_MEM_CACHE_CLASS_DEPTH + 1];
+    size_t class_size = 0;
+    uint64_t now;
+    int idx, nb_free;
+
+    if (!p_buf)
+    {
+        return;
+    }
+    idx = ni_mem_cache_class(size, &class_size);
+    if (idx < 0 || class_size != size ||
+        ((uintptr_t)p_buf % NI_MEM_PAGE_ALIGNMENT))
+    {
+        ni_aligned_free(p_buf);
+        return;
+    }
+
+    now = ni_gettime_ns();
+    ni_mem_cache_lock();
+    p_class = &g_mem_cache[idx];
+    if (p_class->count == NI_MEM_CACHE_CLASS_DEPTH)
+    {
+        // the class is full, replace its least recently returned buffer
+        p_free[0] = p_class->entries[p_class->oldest].p_buf;
+        p_class->entries[p_class->oldest].p_buf = p_buf;
+        p_class->entries[p_class->oldest].put_time = now;
+        p_class->oldest = (p_class->oldest + 1) % NI_MEM_CACHE_CLASS_DEPTH;
+        nb_free = 1;
+    } else
+    {
+        p_class->entries[(p_class->oldest + p_class->count) %
+                         NI_MEM_CACHE_CLASS_DEPTH].p_buf = p_buf;
+        p_class->entries[(p_class->oldest + p_class->count) %
+                         NI_MEM_CACHE_CLASS_DEPTH].put_time = now;
+        p_class->count++;
+        g_mem_cache_idle_bytes += class_size;
+        nb_free = 0;
+    }
+    nb_free += ni_mem_cache_evict_locked(g_mem_cache_max_idle_bytes, now,
+                                         &p_free[nb_free],
+                                         NI_MEM_CACHE_CLASS_DEPTH);
+    ni_pthread_mutex_unlock(&g_mem_cache_mutex);
+
+    while (nb_free--)
+    {
+        ni_aligned_free(p_free[nb_free]);
+    }
+}
+
+/*!*****************************************************************************
+ *  \brief  Allocate buffers of the size class of size until the cache holds
+ *          count idle ones of that class, and fault their pages in, so that
+ *          a following ni_mem_cache_get() of that size neither allocates nor
+ *          page faults. The count is capped to what the cache can keep.
+ *
+ *  \param[in] size   buffer size
+ *  \param[in] count  number of idle buffers wanted
+ *
+ *  \return  number of buffers added to the cache
+ ******************************************************************************/
+int ni_mem_cache_prewarm(size_t size, int count)
+{
+    void *p_buf;
+    size_t class_size, offset;
+    int idx, nb_idle, nb_added = 0;
+
+    idx = ni_mem_cache_class(size, &class_size);
+    if (idx < 0 || count <= 0)
+    {
+        return 0;
+    }
+
+    ni_mem_cache_lock();
+    nb_idle = g_mem_cache[idx].count;
+    if ((size_t)count > g_mem_cache_max_idle_bytes / class_size)
+    {
+        count = (int)(g_mem_cache_max_idle_bytes / class_size);
+    }
+    ni_pthread_mutex_unlock(&g_mem_cache_mutex);
+    count = ni_min(count, NI_MEM_CACHE_CLASS_DEPTH);
+
+    for (; nb_idle + nb_added < count; nb_added++)
+    {
+        if (ni_frame_memalign(&p_buf, class_size))
+        {
+            break;
+        }
+        for (offset = 0; offset < class_size; offset += NI_MEM_PAGE_ALIGNMENT)
+        {
+            ((volatile uint8_t *)p_buf)[offset] = 0;
+        }
+        ni_mem_cache_put(p_buf, class_size);
+    }
+    return nb_added;
+}
+
+/*!*****************************************************************************
+ *  \brief  Free idle buffers of the packet and frame buffer cache, from the
+ *          least recently used, until at most max_idle_bytes are kept. The
+ *          limit stays in effect for the buffers returned afterwards.
+ *
+ *  \param[in] max_idle_bytes  bytes of idle buffers to keep, 0 to free all
+ *                             and disable the cache
+ *
+ *  \return  None
+ ******************************************************************************/
+void ni_mem_cache_trim(size_t max_idle_bytes)
+{
+    ni_mem_cache_lock();
+    g_mem_cache_max_idle_bytes = max_idle_bytes;
+    ni_pthread_mutex_unlock(&g_mem_cache_mutex);
+
+    ni_mem_cache_expire();
+}
+
+/*!*****************************************************************************
+ *  \brief  Free the idle buffers of the packet and frame buffer cache that are
+ *          over the idle byte limit or older than NI_MEM_CACHE_IDLE_TTL_MS
+ *
+ *  \return  None
+ ******************************************************************************/
+void ni_mem_cache_expire(void)
+{
+    void *p_free[NI_MEM_CACHE_CLASS_DEPTH];
+    int nb_free, i;
+
+    do
+    {
+        ni_mem_cache_lock();
+        nb_free = ni_mem_cache_evict_locked(g_mem_cache_max_idle_bytes,
+                                            ni_gettime_ns(), p_free,
+                                            NI_MEM_CACHE_CLASS_DEPTH);
+        ni_pthread_mutex_unlock(&g_mem_cache_mutex);
+
+        for (i = 0; i < nb_free; i++)
+        {
+            ni_aligned_free(p_free[i]);
+        }
+    } while (nb_free == NI_MEM_CACHE_CLASS_DEPTH);
+}
+
 #ifdef __linux__
 /*!******************************************************************************
  *  \brief  Get max io transfer size from the kernel
@@ -1163,7 +1584,7 @@ void ni_buf_pool_return_buffer(ni_buf_t *buf, ni_buf_pool_t *p_buffer_pool)
   if (!p_buffer_pool)
   {
       ni_log(NI_LOG_DEBUG, "%s: pool already freed, self destroy\n", __func__);
-      ni_aligned_free(buf->buf);
+      ni_mem_cache_put(buf->buf, buf->buf_size);
       free(buf);
       return;
   }
@@ -1210,6 +1631,7 @@ ni_buf_t *ni_buf_pool_allocate_buffer(ni_buf_pool_t *p_buffer_pool,
 {
     ni_buf_t *p_buffer = NULL;
     void *p_buf = NULL;
+    size_t alloc_size = buffer_size;
 
     if (NULL != p_buffer_pool &&
         (p_buffer = (ni_buf_t *)malloc(sizeof(ni_buf_t))) != NULL)
@@ -1217,13 +1639,16 @@ ni_buf_t *ni_buf_pool_allocate_buffer(ni_buf_pool_t *p_buffer_pool,
         // init the struct
         memset(p_buffer, 0, sizeof(ni_buf_t));
 
-        if (ni_posix_memalign(&p_buf, sysconf(_SC_PAGESIZE), buffer_size))
+        // buffers of earlier resolutions are taken back from the cache
+        p_buf = ni_mem_cache_get(&alloc_size);
+        if (!p_buf)
         {
-            ni_aligned_free(p_buffer);
+            free(p_buffer);
             return NULL;
         }
         ni_log(NI_LOG_DEBUG, "%s ptr %p  buf %p\n", __func__, p_buf, p_buffer);
         p_buffer->buf = p_buf;
+        p_buffer->buf_size = alloc_size;
         p_buffer->pool = p_buffer_pool;
 
         // add buffer to the buf pool list
@@ -1245,18 +1670,13 @@ ni_buf_t *ni_buf_pool_allocate_buffer(ni_buf_pool_t *p_buffer_pool,
     return p_buffer;
 }
 
-// decoder frame buffer pool init & free
-int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx,
-                                          int32_t number_of_buffers,
-                                          int width, int height,
-                                          int height_align, int factor)
+// size of a decoder frame buffer pool entry for a resolution
+static uint32_t ni_dec_fme_buffer_size(int width, int height, int height_align,
+                                       int factor)
 {
-    int32_t i;
     int width_aligned;
     int height_aligned;
 
-    ni_log2(p_ctx, NI_LOG_TRACE,  "%s: enter\n", __func__);
-
     if (QUADRA)
     {
         width_aligned = ((((width * factor) + 127) / 128) * 128) / factor;
@@ -1295,6 +1715,21 @@ int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx,
         ((buffer_size + (NI_MEM_PAGE_ALIGNMENT - 1)) / NI_MEM_PAGE_ALIGNMENT) *
             NI_MEM_PAGE_ALIGNMENT +
         NI_MEM_PAGE_ALIGNMENT * 3;
+    return buffer_size;
+}
+
+// decoder frame buffer pool init & free
+int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx,
+                                          int32_t number_of_buffers,
+                                          int width, int height,
+                                          int height_align, int factor)
+{
+    int32_t i;
+    uint32_t buffer_size;
+
+    ni_log2(p_ctx, NI_LOG_TRACE,  "%s: enter\n", __func__);
+
+    buffer_size = ni_dec_fme_buffer_size(width, height, height_align, factor);
 
     if (p_ctx->dec_fme_buf_pool != NULL)
     {
@@ -1310,7 +1745,13 @@ int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx,
                    width, height, buffer_size,
                    p_ctx->dec_fme_buf_pool->buf_size);
 
+            // keep as many buffers as the pool had grown to, its buffers go
+            // back to the cache for the next switch to their resolution
+            number_of_buffers =
+                ni_max(number_of_buffers,
+                       (int)p_ctx->dec_fme_buf_pool->number_of_buffers);
             ni_dec_fme_buffer_pool_free(p_ctx->dec_fme_buf_pool);
+            p_ctx->dec_fme_buf_pool = NULL;
         } else
         {
             ni_log(NI_LOG_INFO,
@@ -1347,6 +1788,7 @@ int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx,
         {
             // release everything we have allocated so far and exit
             ni_dec_fme_buffer_pool_free(p_ctx->dec_fme_buf_pool);
+            p_ctx->dec_fme_buf_pool = NULL;
             return -1;
         }
     }
@@ -1363,6 +1805,11 @@ void ni_dec_fme_buffer_pool_free(ni_buf_pool_t *p_buffer_pool)
     {
         ni_log(NI_LOG_TRACE, "%s: enter.\n", __func__);
 
+        if (p_buffer_pool->prewarm_started)
+        {
+            ni_pthread_join(p_buffer_pool->prewarm_thread, NULL);
+        }
+
         // mark used buf not returned at pool free time by setting pool ptr in used
         // buf to NULL, so they will self-destroy when time is due eventually
         ni_pthread_mutex_lock(&p_buffer_pool->mutex);
@@ -1386,7 +1833,7 @@ void ni_dec_fme_buffer_pool_free(ni_buf_pool_t *p_buffer_pool)
         while (buf)
         {
             p_next = buf->p_next_buffer;
-            ni_aligned_free(buf->buf);
+            ni_mem_cache_put(buf->buf, buf->buf_size);
             free(buf);
             buf = p_next;
             count_free++;
@@ -1409,6 +1856,66 @@ void ni_dec_fme_buffer_pool_free(ni_buf_pool_t *p_buffer_pool)
     }
 }
 
+static void *ni_dec_fme_buffer_pool_prewarm_thread(void *arg)
+{
+    ni_buf_pool_t *p_buffer_pool = (ni_buf_pool_t *)arg;
+
+    ni_mem_cache_prewarm(p_buffer_pool->prewarm_size,
+                         p_buffer_pool->prewarm_count);
+    return NULL;
+}
+
+/*!*****************************************************************************
+ *  \brief  Start filling the buffer cache, on a separate thread, with the
+ *          buffers the decoder frame buffer pool will need at a new
+ *          resolution. Called when a sequence change is detected, so that
+ *          ni_dec_fme_buffer_pool_initialize() at the new resolution takes
+ *          allocated and faulted in buffers from the cache instead of
+ *          allocating them. Nothing is done if the current pool buffers are
+ *          large enough for the new resolution, as the pool is then kept.
+ *
+ *  \param[in] p_ctx         decoder session context
+ *  \param[in] width         new picture width
+ *  \param[in] height        new frame height
+ *  \param[in] height_align  as for ni_dec_fme_buffer_pool_initialize()
+ *  \param[in] factor        bit depth factor
+ *
+ *  \return  None
+ ******************************************************************************/
+void ni_dec_fme_buffer_pool_prewarm(ni_session_context_t* p_ctx, int width,
+                                    int height, int height_align, int factor)
+{
+    ni_buf_pool_t *p_buffer_pool = p_ctx->dec_fme_buf_pool;
+    uint32_t buffer_size;
+
+    if (!p_buffer_pool || width <= 0 || height <= 0 || factor <= 0)
+    {
+        return;
+    }
+    buffer_size = ni_dec_fme_buffer_size(width, height, height_align, factor);
+    if (buffer_size <= p_buffer_pool->buf_size)
+    {
+        return;
+    }
+
+    if (p_buffer_pool->prewarm_started)
+    {
+        ni_pthread_join(p_buffer_pool->prewarm_thread, NULL);
+        p_buffer_pool->prewarm_started = 0;
+    }
+    p_buffer_pool->prewarm_size = buffer_size;
+    p_buffer_pool->prewarm_count = (int)p_buffer_pool->number_of_buffers;
+    if (ni_pthread_create(&p_buffer_pool->prewarm_thread, NULL,
+                          ni_dec_fme_buffer_pool_prewarm_thread,
+                          p_buffer_pool) == 0)
+    {
+        p_buffer_pool->prewarm_started = 1;
+        ni_log2(p_ctx, NI_LOG_DEBUG, "%s: %d buffers of size %u for %dx%d\n",
+                __func__, p_buffer_pool->prewarm_count, buffer_size, width,
+                height);
+    }
+}
+
 void ni_buffer_pool_free(ni_queue_buffer_pool_t *p_buffer_pool)
 {
     ni_queue_node_t *buf, *p_next;
@@ -3074,637 +3581,2816 @@ void ni_copy_frame_data(uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS],
     }
 }
 
-/*!*****************************************************************************
- *  \brief  Copy yuv444p data to yuv420p frame layout to be sent
- *          to encoder for encoding. Data buffer (dst) is usually allocated by
- *          ni_encoder_frame_buffer_alloc.
- *
- *  \param[out]    p_dst0  pointers of Y/Cb/Cr as yuv420p output0
- *  \param[out]    p_dst1  pointers of Y/Cb/Cr as yuv420p output1
- *  \param[in]     p_src  pointers of Y/Cb/Cr as yuv444p intput
- *  \param[in]     width  source YUV frame width
- *  \param[in]     height source YUV frame height
- *  \param[in]     factor  1 for 8 bit, 2 for 10 bit
- *  \param[in]     mode 0 for
- *                 out0 is Y+1/2V, with the original input as the out0, 1/4V
- *                 copy to data[1] 1/4V copy to data[2]
- *                 out1 is U+1/2V, U copy to data[0], 1/4V copy to data[1], 1/4V
- *                 copy to data[2]
- *                 mode 1 for
- *                 out0 is Y+1/2u+1/2v, with the original input as the output0,
- *                 1/4U copy to data[1] 1/4V copy to data[2]
- *                 out1 is (1/2U+1/2V)+1/4U+1/4V, 1/2U & 1/2V copy to data[0],
- *                 1/4U copy to data[1], 1/4V copy to data[2]
- *
- *  \return Y/Cb/Cr data
- *
- ******************************************************************************/
-void ni_copy_yuv_444p_to_420p(uint8_t *p_dst0[NI_MAX_NUM_DATA_POINTERS],
-                              uint8_t *p_dst1[NI_MAX_NUM_DATA_POINTERS],
-                              uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
-                              int frame_width, int frame_height,
-                              int factor, int mode)
+/*
+ * Host side YUV conversion kernels
+ *
+ * Row kernels used by the 4:4:4 to 4:2:0 conversions. Samples are 1 byte for
+ * 8 bit formats and 2 bytes (little-endian, LSB aligned) for 10 bit formats.
+ * The _c kernels are the reference; the SSE2/AVX2/NEON variants produce
+ * bit-identical results and are selected once at runtime by
+ * ni_yuv_get_kernels(). Chroma downsample kernels compute outputs
+ * [x0, x0 + n) of a row pair and require input samples 2 * (x0 + n) - 1 to
+ * be inside the row; the caller handles the odd width edge.
+ */
+typedef void (*ni_yuv_deint_fn)(const uint8_t *src, uint8_t *even,
+                                uint8_t *odd, int n);
+typedef void (*ni_yuv_down_fn)(const uint8_t *r0, const uint8_t *r1,
+                               uint8_t *dst, int x0, int n);
+typedef void (*ni_yuv_interleave_fn)(const uint8_t *u, const uint8_t *v,
+                                     uint8_t *dst, int n, int shift);
+typedef void (*ni_yuv_shift_fn)(const uint8_t *src, uint8_t *dst, int n,
+                                int shift);
+
+typedef struct _ni_yuv_kernels
+{
+    const char *name;
+    ni_yuv_deint_fn deint8;
+    ni_yuv_deint_fn deint16;
+    // indexed by ni_chroma_filter_t
+    ni_yuv_down_fn down8[NI_CHROMA_FILTER_NUM];
+    ni_yuv_down_fn down16[NI_CHROMA_FILTER_NUM];
+    ni_yuv_interleave_fn interleave8;
+    ni_yuv_interleave_fn interleave16;
+    ni_yuv_shift_fn shl16;
+} ni_yuv_kernels_t;
+
+static void ni_yuv_deint8_c(const uint8_t *src, uint8_t *even, uint8_t *odd,
+                            int n)
 {
-    int i, j;
-    int y_444p_linesize = frame_width * factor;
-    int uv_444p_linesize = y_444p_linesize;
-    int y_420p_linesize = NI_VPU_ALIGN128(y_444p_linesize);
-    int uv_420p_linesize = NI_VPU_ALIGN128(uv_444p_linesize / 2);
+    int i;
 
-    // return to avoid self copy
-    if (p_dst0[0] == p_dst1[0] && p_dst0[1] == p_dst1[1] &&
-        p_dst0[2] == p_dst1[2])
+    for (i = 0; i < n; i++)
     {
-        ni_log(NI_LOG_DEBUG, "%s: src and dst identical, return\n", __func__);
-        return;
+        even[i] = src[2 * i];
+        odd[i] = src[2 * i + 1];
     }
+}
 
-    // Y component
-    for (i = 0; i < frame_height; i++)
+static void ni_yuv_deint16_c(const uint8_t *src, uint8_t *even, uint8_t *odd,
+                             int n)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    uint16_t *e = (uint16_t *)even;
+    uint16_t *o = (uint16_t *)odd;
+    int i;
+
+    for (i = 0; i < n; i++)
     {
-        memcpy(&p_dst0[0][i * y_420p_linesize], &p_src[0][i * y_444p_linesize],
-               y_444p_linesize);
+        e[i] = s[2 * i];
+        o[i] = s[2 * i + 1];
     }
+}
+
+static void ni_yuv_drop8_c(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                           int x0, int n)
+{
+    int i;
 
-    if (mode == 0)
+    (void)r1;
+    for (i = x0; i < x0 + n; i++)
     {
-        // out0 data[0]: Y  data[1]: 0.25V  data[2]: 0.25V
-        // out1 data[0]: U  data[1]: 0.25V  data[2]: 0.25V
-        // U component
-        for (i = 0; i < frame_height; i++)
-        {
-            memcpy(&p_dst1[0][i * y_420p_linesize],
-                   &p_src[1][i * y_444p_linesize], y_444p_linesize);
-        }
+        dst[i - x0] = r0[2 * i];
+    }
+}
 
-        for (i = 0; i < frame_height / 2; i++)
-        {
-            for (j = 0; j < frame_width * factor / 2; j += factor)
-            {
-                // V component
-                // even line
-                memcpy(&p_dst0[1][i * uv_420p_linesize + j],
-                       &p_src[2][2 * i * uv_444p_linesize + 2 * j],
-                       factor);
-                memcpy(&p_dst0[2][i * uv_420p_linesize + j],
-                       &p_src[2][2 * i * uv_444p_linesize + (2 * j + factor)],
-                       factor);
-                // odd line
-                memcpy(&p_dst1[1][i * uv_420p_linesize + j],
-                       &p_src[2][(2 * i + 1) * uv_444p_linesize + 2 * j],
-                       factor);
-                memcpy(&p_dst1[2][i * uv_420p_linesize + j],
-                       &p_src[2][(2 * i + 1) * uv_444p_linesize + (2 * j + factor)],
-                       factor);
-            }
-        }
-    } else
+static void ni_yuv_box8_c(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                          int x0, int n)
+{
+    int i;
+
+    for (i = x0; i < x0 + n; i++)
     {
-        // out0 data[0]:  Y           data[1]: 0.25U  data[2]: 0.25V
-        // out1 data[0]:  0.5U + 0.5V data[1]: 0.25U  data[2]: 0.25V
-        for (i = 0; i < frame_height / 2; i++)
-        {
-            for (j = 0; j < frame_width * factor / 2; j += factor)
-            {
-                // U component
-                // even line 0.25U
-                memcpy(&p_dst1[1][i * uv_420p_linesize + j],
-                       &p_src[1][2 * i * uv_444p_linesize + (2 * j + factor)],
-                       factor);
-                // odd line 0.5U
-                memcpy(&p_dst1[0][2 * i * uv_444p_linesize + 2 * j],
-                       &p_src[1][(2 * i + 1) * uv_444p_linesize + 2 * j],
-                       factor * 2);
-                // even line 0.25U
-                memcpy(&p_dst0[1][i * uv_420p_linesize + j],
-                       &p_src[1][2 * i * uv_444p_linesize + 2 * j],
-                       factor);
-
-                // V component
-                // even line 0.25V
-                memcpy(&p_dst1[2][i * uv_420p_linesize + j],
-                       &p_src[2][2 * i * uv_444p_linesize + (2 * j + factor)],
-                       factor);
-                // odd line 0.5V
-                memcpy(&p_dst1[0][(2 * i + 1) * uv_444p_linesize + 2 * j],
-                       &p_src[2][(2 * i + 1) * uv_444p_linesize + 2 * j],
-                       factor * 2);
-                // even line 0.25V
-                memcpy(&p_dst0[2][i * uv_420p_linesize + j],
-                       &p_src[2][2 * i * uv_444p_linesize + 2 * j],
-                       factor);
-            }
-        }
+        dst[i - x0] = (uint8_t)((r0[2 * i] + r0[2 * i + 1] + r1[2 * i] +
+                                 r1[2 * i + 1] + 2) >> 2);
     }
 }
 
-// NAL operations
-
-/*!*****************************************************************************
- *  \brief  Insert emulation prevention byte(s) as needed into the data buffer
- *
- *  \param  buf   data buffer to be worked on - new byte(s) will be inserted
- *          size  number of bytes starting from buf to check
- *
- *  \return the number of emulation prevention bytes inserted into buf, 0 if
- *          none.
- *
- *  Note: caller *MUST* ensure for newly inserted bytes, buf has enough free
- *        space starting from buf + size
- ******************************************************************************/
-int ni_insert_emulation_prevent_bytes(uint8_t *buf, int size)
+static void ni_yuv_left8_c(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                           int x0, int n)
 {
-    int insert_bytes = 0;
-    uint8_t *buf_curr = buf;
-    uint8_t *buf_end = buf + size - 1;
-    int zeros = 0, insert_ep3_byte;
-
-    ni_log(NI_LOG_TRACE, "%s: enter\n", __func__);
+    int i, xm;
 
-    for (; buf_curr <= buf_end; buf_curr++)
+    for (i = x0; i < x0 + n; i++)
     {
-        if (zeros == 2)
-        {
-            insert_ep3_byte = (*buf_curr <= 3);
-            if (insert_ep3_byte)
-            {
-                // move bytes from curr to end 1 position to make space for ep3
-                memmove(buf_curr + 1, buf_curr, buf_end - buf_curr + 1);
-                *buf_curr = 0x3;
-
-                buf_curr++;
-                buf_end++;
-                insert_bytes++;
-            }
+        xm = i ? 2 * i - 1 : 0;
+        dst[i - x0] = (uint8_t)((r0[xm] + r1[xm] +
+                                 2 * (r0[2 * i] + r1[2 * i]) +
+                                 r0[2 * i + 1] + r1[2 * i + 1] + 4) >> 3);
+    }
+}
 
-            zeros = 0;
-        }
+static void ni_yuv_drop16_c(const uint8_t *r0, const uint8_t *r1,
+                            uint8_t *dst, int x0, int n)
+{
+    const uint16_t *s0 = (const uint16_t *)r0;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
 
-        if (!*buf_curr)
-        {
-            zeros++;
-        } else
-        {
-            zeros = 0;
-        }
+    (void)r1;
+    for (i = x0; i < x0 + n; i++)
+    {
+        d[i - x0] = s0[2 * i];
     }
-
-    ni_log(NI_LOG_TRACE, "%s: %d, exit\n", __func__, insert_bytes);
-    return insert_bytes;
 }
 
-/*!*****************************************************************************
- *  \brief  Remove emulation prevention byte(s) as needed from the data buffer
- *
- *  \param  buf   data buffer to be worked on - emu prevent byte(s) will be
- *                removed from.
- *          size  number of bytes starting from buf to check
- *
- *  \return the number of emulation prevention bytes removed from buf, 0 if
- *          none.
- *
- *  Note: buf will be modified if emu prevent byte(s) found and removed.
- ******************************************************************************/
-int ni_remove_emulation_prevent_bytes(uint8_t *buf, int size)
+static void ni_yuv_box16_c(const uint8_t *r0, const uint8_t *r1, uint8_t *dst,
+                           int x0, int n)
 {
-    int remove_bytes = 0;
-    uint8_t *buf_curr = buf;
-    uint8_t *buf_end = buf + size - 1;
-    int zeros = 0, remove_ep3_byte;
-
-    ni_log(NI_LOG_TRACE, "%s: enter\n", __func__);
+    const uint16_t *s0 = (const uint16_t *)r0;
+    const uint16_t *s1 = (const uint16_t *)r1;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
 
-    for (; buf_curr < buf_end; buf_curr++)
+    for (i = x0; i < x0 + n; i++)
     {
-        if (zeros == 2)
-        {
-            remove_ep3_byte = (*buf_curr == 0x03 && *(buf_curr + 1) <= 3);
-            if (remove_ep3_byte)
-            {
-                // move bytes after curr to end, 1 position forward to overwrite ep3
-                memmove(buf_curr, buf_curr + 1, buf_end - buf_curr);
-
-                // buf_curr unchanged
-                buf_end--;
-                remove_bytes++;
-            }
+        d[i - x0] = (uint16_t)((s0[2 * i] + s0[2 * i + 1] + s1[2 * i] +
+                                s1[2 * i + 1] + 2) >> 2);
+    }
+}
 
-            zeros = 0;
-        }
+static void ni_yuv_left16_c(const uint8_t *r0, const uint8_t *r1,
+                            uint8_t *dst, int x0, int n)
+{
+    const uint16_t *s0 = (const uint16_t *)r0;
+    const uint16_t *s1 = (const uint16_t *)r1;
+    uint16_t *d = (uint16_t *)dst;
+    int i, xm;
 
-        if (!*buf_curr)
-        {
-            zeros++;
-        } else
-        {
-            zeros = 0;
-        }
+    for (i = x0; i < x0 + n; i++)
+    {
+        xm = i ? 2 * i - 1 : 0;
+        d[i - x0] = (uint16_t)((s0[xm] + s1[xm] +
+                                2 * (s0[2 * i] + s1[2 * i]) +
+                                s0[2 * i + 1] + s1[2 * i + 1] + 4) >> 3);
     }
-
-    ni_log(NI_LOG_TRACE, "%s: %d, exit\n", __func__, remove_bytes);
-    return remove_bytes;
 }
 
-/******************************************************************************
- *
- * Ai utils apis
- *
- ******************************************************************************/
-static uint32_t ni_ai_type_get_bytes(const uint32_t type)
+static void ni_yuv_interleave8_c(const uint8_t *u, const uint8_t *v,
+                                 uint8_t *dst, int n, int shift)
 {
-    switch (type)
-    {
-        case NI_AI_BUFFER_FORMAT_INT8:
-        case NI_AI_BUFFER_FORMAT_UINT8:
-            return 1;
-        case NI_AI_BUFFER_FORMAT_INT16:
-        case NI_AI_BUFFER_FORMAT_UINT16:
-        case NI_AI_BUFFER_FORMAT_FP16:
-        case NI_AI_BUFFER_FORMAT_BFP16:
-            return 2;
-        case NI_AI_BUFFER_FORMAT_FP32:
-        case NI_AI_BUFFER_FORMAT_INT32:
-        case NI_AI_BUFFER_FORMAT_UINT32:
-            return 4;
-        case NI_AI_BUFFER_FORMAT_FP64:
-        case NI_AI_BUFFER_FORMAT_INT64:
-        case NI_AI_BUFFER_FORMAT_UINT64:
-            return 8;
+    int i;
 
-        default:
-            return 0;
+    (void)shift;
+    for (i = 0; i < n; i++)
+    {
+        dst[2 * i] = u[i];
+        dst[2 * i + 1] = v[i];
     }
 }
 
-static void ni_ai_integer_convert(const void *src, void *dest,
-                                  ni_ai_buffer_format_e src_dtype,
-                                  ni_ai_buffer_format_e dst_dtype)
+static void ni_yuv_interleave16_c(const uint8_t *u, const uint8_t *v,
+                                  uint8_t *dst, int n, int shift)
 {
-    unsigned char all_zeros[] = {0x00, 0x00, 0x00, 0x00,
-                                 0x00, 0x00, 0x00, 0x00};
-    unsigned char all_ones[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
-    uint32_t src_sz = ni_ai_type_get_bytes(src_dtype);
-    uint32_t dest_sz = ni_ai_type_get_bytes(dst_dtype);
-    unsigned char *buffer = all_zeros;
+    const uint16_t *su = (const uint16_t *)u;
+    const uint16_t *sv = (const uint16_t *)v;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
 
-    if (((int8_t *)src)[src_sz - 1] & 0x80)
+    for (i = 0; i < n; i++)
     {
-        buffer = all_ones;
+        d[2 * i] = (uint16_t)(su[i] << shift);
+        d[2 * i + 1] = (uint16_t)(sv[i] << shift);
     }
-    memcpy(buffer, src, src_sz);
-    memcpy(dest, buffer, dest_sz);
 }
 
-static float ni_ai_int8_to_fp32(signed char val, signed char fixedPointPos)
+static void ni_yuv_shl16_c(const uint8_t *src, uint8_t *dst, int n, int shift)
 {
-    float result = 0.0f;
+    const uint16_t *s = (const uint16_t *)src;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
 
-    if (fixedPointPos > 0)
-    {
-        result = (float)val * (1.0f / ((float)(1 << fixedPointPos)));
-    } else
+    for (i = 0; i < n; i++)
     {
-        result = (float)val * ((float)(1 << -fixedPointPos));
+        d[i] = (uint16_t)(s[i] << shift);
     }
+}
+
+static const ni_yuv_kernels_t g_yuv_kernels_c = {
+    "c",
+    ni_yuv_deint8_c,
+    ni_yuv_deint16_c,
+    {ni_yuv_drop8_c, ni_yuv_box8_c, ni_yuv_left8_c},
+    {ni_yuv_drop16_c, ni_yuv_box16_c, ni_yuv_left16_c},
+    ni_yuv_interleave8_c,
+    ni_yuv_interleave16_c,
+    ni_yuv_shl16_c,
+};
 
-    return result;
+#ifdef NI_UTIL_SSE2
+// pack two vectors of 32 bit lanes holding 16 bit unsigned values
+static inline __m128i ni_yuv_pack_u32_sse2(__m128i a, __m128i b)
+{
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
 }
 
-static float ni_ai_int16_to_fp32(int16_t val, signed char fixedPointPos)
+static void ni_yuv_deint8_sse2(const uint8_t *src, uint8_t *even, uint8_t *odd,
+                               int n)
 {
-    float result = 0.0f;
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i;
 
-    if (fixedPointPos > 0)
-    {
-        result = (float)val * (1.0f / ((float)(1 << fixedPointPos)));
-    } else
+    for (i = 0; i + 16 <= n; i += 16)
     {
-        result = (float)val * ((float)(1 << -fixedPointPos));
-    }
+        __m128i a = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
 
-    return result;
+        _mm_storeu_si128((__m128i *)(even + i),
+                         _mm_packus_epi16(_mm_and_si128(a, mask),
+                                          _mm_and_si128(b, mask)));
+        _mm_storeu_si128((__m128i *)(odd + i),
+                         _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                          _mm_srli_epi16(b, 8)));
+    }
+    ni_yuv_deint8_c(src + 2 * i, even + i, odd + i, n - i);
 }
 
-static float ni_ai_uint8_to_fp32(uint8_t val, int32_t zeroPoint, float scale)
+static void ni_yuv_deint16_sse2(const uint8_t *src, uint8_t *even,
+                                uint8_t *odd, int n)
 {
-    float result = 0.0f;
+    const uint16_t *s = (const uint16_t *)src;
+    uint16_t *e = (uint16_t *)even;
+    uint16_t *o = (uint16_t *)odd;
+    int i;
 
-    result = (float)(val - (uint8_t)zeroPoint) * scale;
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(s + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + 2 * i + 8));
 
-    return result;
+        _mm_storeu_si128((__m128i *)(e + i), ni_yuv_pack_u32_sse2(a, b));
+        _mm_storeu_si128((__m128i *)(o + i),
+                         _mm_packs_epi32(_mm_srai_epi32(a, 16),
+                                         _mm_srai_epi32(b, 16)));
+    }
+    ni_yuv_deint16_c((const uint8_t *)(s + 2 * i), (uint8_t *)(e + i),
+                     (uint8_t *)(o + i), n - i);
 }
 
-static float ni_ai_fp16_to_fp32(const short in)
+static void ni_yuv_drop8_sse2(const uint8_t *r0, const uint8_t *r1,
+                              uint8_t *dst, int x0, int n)
 {
-    typedef union
-    {
-        unsigned int u;
-        float f;
-    } _fp32_t;
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    int i;
 
-    const _fp32_t magic = {(254 - 15) << 23};
-    const _fp32_t infnan = {(127 + 16) << 23};
-    _fp32_t o;
-    // Non-sign bits
-    o.u = (in & 0x7fff) << 13;
-    o.f *= magic.f;
-    if (o.f >= infnan.f)
+    for (i = x0; i + 16 <= x0 + n; i += 16)
     {
-        o.u |= 255 << 23;
+        __m128i a = _mm_loadu_si128((const __m128i *)(r0 + 2 * i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(r0 + 2 * i + 16));
+
+        _mm_storeu_si128((__m128i *)(dst + i - x0),
+                         _mm_packus_epi16(_mm_and_si128(a, mask),
+                                          _mm_and_si128(b, mask)));
     }
-    //Sign bit
-    o.u |= (in & 0x8000) << 16;
-    return o.f;
+    ni_yuv_drop8_c(r0, r1, dst + i - x0, i, x0 + n - i);
 }
 
-static float ni_ai_affine_to_fp32(int32_t val, int32_t zeroPoint, float scale)
+// sum of the horizontal sample pairs of two rows, 8 bit input
+static inline __m128i ni_yuv_pair_sum8_sse2(__m128i a, __m128i b)
 {
-    float result = 0.0f;
-    result = ((float)val - zeroPoint) * scale;
-    return result;
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+
+    return _mm_add_epi16(
+        _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8)),
+        _mm_add_epi16(_mm_and_si128(b, mask), _mm_srli_epi16(b, 8)));
 }
 
-static uint32_t ni_ai_get_tensor_size(int32_t *shape, uint32_t dim_num,
-                                      int32_t type)
+static void ni_yuv_box8_sse2(const uint8_t *r0, const uint8_t *r1,
+                             uint8_t *dst, int x0, int n)
 {
-    uint32_t sz;
-    uint32_t i;
-    sz = 0;
-    if (NULL == shape || 0 == dim_num)
-    {
-        return sz;
-    }
-    sz = 1;
-    for (i = 0; i < dim_num; i++)
+    const __m128i two = _mm_set1_epi16(2);
+    int i;
+
+    for (i = x0; i + 16 <= x0 + n; i += 16)
     {
-        sz *= shape[i];
+        __m128i s0 = ni_yuv_pair_sum8_sse2(
+            _mm_loadu_si128((const __m128i *)(r0 + 2 * i)),
+            _mm_loadu_si128((const __m128i *)(r1 + 2 * i)));
+        __m128i s1 = ni_yuv_pair_sum8_sse2(
+            _mm_loadu_si128((const __m128i *)(r0 + 2 * i + 16)),
+            _mm_loadu_si128((const __m128i *)(r1 + 2 * i + 16)));
+
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, two), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, two), 2);
+        _mm_storeu_si128((__m128i *)(dst + i - x0), _mm_packus_epi16(s0, s1));
     }
-    sz *= ni_ai_type_get_bytes(type);
+    ni_yuv_box8_c(r0, r1, dst + i - x0, i, x0 + n - i);
+}
 
-    return sz;
+// [1 2 1] / 8 filter over the vertical sums of 8 outputs starting at 2 * i
+static inline __m128i ni_yuv_left8x8_sse2(const uint8_t *r0, const uint8_t *r1,
+                                          int i)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    __m128i a = _mm_loadu_si128((const __m128i *)(r0 + 2 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(r1 + 2 * i));
+    __m128i pa = _mm_loadu_si128((const __m128i *)(r0 + 2 * i - 2));
+    __m128i pb = _mm_loadu_si128((const __m128i *)(r1 + 2 * i - 2));
+    __m128i ve = _mm_add_epi16(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    __m128i vo = _mm_add_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    __m128i vp = _mm_add_epi16(_mm_srli_epi16(pa, 8), _mm_srli_epi16(pb, 8));
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(vp, vo),
+                                _mm_add_epi16(_mm_slli_epi16(ve, 1),
+                                              _mm_set1_epi16(4)));
+
+    return _mm_srli_epi16(sum, 3);
 }
 
-static uint32_t ni_ai_get_element_num(int32_t *sizes, uint32_t num_of_dims,
-                                      int32_t data_format)
+static void ni_yuv_left8_sse2(const uint8_t *r0, const uint8_t *r1,
+                              uint8_t *dst, int x0, int n)
 {
-    uint32_t num;
-    uint32_t sz;
-    uint32_t dsize;
+    int i = x0;
 
-    sz = ni_ai_get_tensor_size(sizes, num_of_dims, data_format);
-    dsize = ni_ai_type_get_bytes(data_format);
-    if (dsize)
+    if (i == 0 && n > 0)
     {
-        num = (uint32_t)(sz / dsize);
-    } else
+        ni_yuv_left8_c(r0, r1, dst, 0, 1);
+        i = 1;
+    }
+    for (; i + 16 <= x0 + n; i += 16)
     {
-        num = 0;
+        _mm_storeu_si128((__m128i *)(dst + i - x0),
+                         _mm_packus_epi16(ni_yuv_left8x8_sse2(r0, r1, i),
+                                          ni_yuv_left8x8_sse2(r0, r1, i + 8)));
     }
-
-    return num;
+    ni_yuv_left8_c(r0, r1, dst + i - x0, i, x0 + n - i);
 }
 
-static int32_t ni_ai_type_is_integer(const int32_t type)
+static void ni_yuv_drop16_sse2(const uint8_t *r0, const uint8_t *r1,
+                               uint8_t *dst, int x0, int n)
 {
-    int32_t ret = 0;
-    switch (type)
+    const uint16_t *s0 = (const uint16_t *)r0;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = x0; i + 8 <= x0 + n; i += 8)
     {
-        case NI_AI_BUFFER_FORMAT_INT8:
-        case NI_AI_BUFFER_FORMAT_INT16:
-        case NI_AI_BUFFER_FORMAT_INT32:
-        case NI_AI_BUFFER_FORMAT_UINT8:
-        case NI_AI_BUFFER_FORMAT_UINT16:
-        case NI_AI_BUFFER_FORMAT_UINT32:
-            ret = 1;
-            break;
-        default:
-            break;
+        _mm_storeu_si128(
+            (__m128i *)(d + i - x0),
+            ni_yuv_pack_u32_sse2(
+                _mm_loadu_si128((const __m128i *)(s0 + 2 * i)),
+                _mm_loadu_si128((const __m128i *)(s0 + 2 * i + 8))));
     }
+    ni_yuv_drop16_c(r0, r1, (uint8_t *)(d + i - x0), i, x0 + n - i);
+}
 
-    return ret;
+// sum of the horizontal sample pairs of two rows, 16 bit input
+static inline __m128i ni_yuv_pair_sum16_sse2(const uint16_t *s0,
+                                             const uint16_t *s1)
+{
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    __m128i a = _mm_loadu_si128((const __m128i *)s0);
+    __m128i b = _mm_loadu_si128((const __m128i *)s1);
+
+    return _mm_add_epi32(
+        _mm_add_epi32(_mm_and_si128(a, mask), _mm_srli_epi32(a, 16)),
+        _mm_add_epi32(_mm_and_si128(b, mask), _mm_srli_epi32(b, 16)));
 }
 
-static int32_t ni_ai_type_is_signed(const int32_t type)
+static void ni_yuv_box16_sse2(const uint8_t *r0, const uint8_t *r1,
+                              uint8_t *dst, int x0, int n)
 {
-    int32_t ret = 0;
-    switch (type)
+    const uint16_t *s0 = (const uint16_t *)r0;
+    const uint16_t *s1 = (const uint16_t *)r1;
+    const __m128i two = _mm_set1_epi32(2);
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = x0; i + 8 <= x0 + n; i += 8)
     {
-        case NI_AI_BUFFER_FORMAT_INT8:
+        __m128i lo = ni_yuv_pair_sum16_sse2(s0 + 2 * i, s1 + 2 * i);
+        __m128i hi = ni_yuv_pair_sum16_sse2(s0 + 2 * i + 8, s1 + 2 * i + 8);
+
+        lo = _mm_srli_epi32(_mm_add_epi32(lo, two), 2);
+        hi = _mm_srli_epi32(_mm_add_epi32(hi, two), 2);
+        _mm_storeu_si128((__m128i *)(d + i - x0),
+                         ni_yuv_pack_u32_sse2(lo, hi));
+    }
+    ni_yuv_box16_c(r0, r1, (uint8_t *)(d + i - x0), i, x0 + n - i);
+}
+
+static inline __m128i ni_yuv_left16x4_sse2(const uint16_t *s0,
+                                           const uint16_t *s1, int i)
+{
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    __m128i a = _mm_loadu_si128((const __m128i *)(s0 + 2 * i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(s1 + 2 * i));
+    __m128i pa = _mm_loadu_si128((const __m128i *)(s0 + 2 * i - 2));
+    __m128i pb = _mm_loadu_si128((const __m128i *)(s1 + 2 * i - 2));
+    __m128i ve = _mm_add_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    __m128i vo = _mm_add_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+    __m128i vp = _mm_add_epi32(_mm_srli_epi32(pa, 16), _mm_srli_epi32(pb, 16));
+    __m128i sum = _mm_add_epi32(_mm_add_epi32(vp, vo),
+                                _mm_add_epi32(_mm_slli_epi32(ve, 1),
+                                              _mm_set1_epi32(4)));
+
+    return _mm_srli_epi32(sum, 3);
+}
+
+static void ni_yuv_left16_sse2(const uint8_t *r0, const uint8_t *r1,
+                               uint8_t *dst, int x0, int n)
+{
+    const uint16_t *s0 = (const uint16_t *)r0;
+    const uint16_t *s1 = (const uint16_t *)r1;
+    uint16_t *d = (uint16_t *)dst;
+    int i = x0;
+
+    if (i == 0 && n > 0)
+    {
+        ni_yuv_left16_c(r0, r1, dst, 0, 1);
+        i = 1;
+    }
+    for (; i + 8 <= x0 + n; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)(d + i - x0),
+                         ni_yuv_pack_u32_sse2(ni_yuv_left16x4_sse2(s0, s1, i),
+                                              ni_yuv_left16x4_sse2(s0, s1,
+                                                                   i + 4)));
+    }
+    ni_yuv_left16_c(r0, r1, (uint8_t *)(d + i - x0), i, x0 + n - i);
+}
+
+static void ni_yuv_interleave8_sse2(const uint8_t *u, const uint8_t *v,
+                                    uint8_t *dst, int n, int shift)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(u + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(v + i));
+
+        _mm_storeu_si128((__m128i *)(dst + 2 * i), _mm_unpacklo_epi8(a, b));
+        _mm_storeu_si128((__m128i *)(dst + 2 * i + 16),
+                         _mm_unpackhi_epi8(a, b));
+    }
+    ni_yuv_interleave8_c(u + i, v + i, dst + 2 * i, n - i, shift);
+}
+
+static void ni_yuv_interleave16_sse2(const uint8_t *u, const uint8_t *v,
+                                     uint8_t *dst, int n, int shift)
+{
+    const uint16_t *su = (const uint16_t *)u;
+    const uint16_t *sv = (const uint16_t *)v;
+    const __m128i cnt = _mm_cvtsi32_si128(shift);
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_sll_epi16(_mm_loadu_si128((const __m128i *)(su + i)),
+                                  cnt);
+        __m128i b = _mm_sll_epi16(_mm_loadu_si128((const __m128i *)(sv + i)),
+                                  cnt);
+
+        _mm_storeu_si128((__m128i *)(d + 2 * i), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128((__m128i *)(d + 2 * i + 8), _mm_unpackhi_epi16(a, b));
+    }
+    ni_yuv_interleave16_c((const uint8_t *)(su + i), (const uint8_t *)(sv + i),
+                          (uint8_t *)(d + 2 * i), n - i, shift);
+}
+
+static void ni_yuv_shl16_sse2(const uint8_t *src, uint8_t *dst, int n,
+                              int shift)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    const __m128i cnt = _mm_cvtsi32_si128(shift);
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        _mm_storeu_si128(
+            (__m128i *)(d + i),
+            _mm_sll_epi16(_mm_loadu_si128((const __m128i *)(s + i)), cnt));
+    }
+    ni_yuv_shl16_c((const uint8_t *)(s + i), (uint8_t *)(d + i), n - i, shift);
+}
+
+static const ni_yuv_kernels_t g_yuv_kernels_sse2 = {
+    "sse2",
+    ni_yuv_deint8_sse2,
+    ni_yuv_deint16_sse2,
+    {ni_yuv_drop8_sse2, ni_yuv_box8_sse2, ni_yuv_left8_sse2},
+    {ni_yuv_drop16_sse2, ni_yuv_box16_sse2, ni_yuv_left16_sse2},
+    ni_yuv_interleave8_sse2,
+    ni_yuv_interleave16_sse2,
+    ni_yuv_shl16_sse2,
+};
+#endif
+
+#ifdef NI_UTIL_AVX2
+// the 8 bit kernels gain most from the wider vectors, the 16 bit ones stay
+// on SSE2 which already saturates memory bandwidth for 10 bit frames
+NI_UTIL_TARGET_AVX2 static inline __m256i ni_yuv_packus_avx2(__m256i a,
+                                                              __m256i b)
+{
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_yuv_deint8_avx2(const uint8_t *src,
+                                                   uint8_t *even,
+                                                   uint8_t *odd, int n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i;
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+
+        _mm256_storeu_si256((__m256i *)(even + i),
+                            ni_yuv_packus_avx2(_mm256_and_si256(a, mask),
+                                               _mm256_and_si256(b, mask)));
+        _mm256_storeu_si256((__m256i *)(odd + i),
+                            ni_yuv_packus_avx2(_mm256_srli_epi16(a, 8),
+                                               _mm256_srli_epi16(b, 8)));
+    }
+    ni_yuv_deint8_sse2(src + 2 * i, even + i, odd + i, n - i);
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_yuv_drop8_avx2(const uint8_t *r0,
+                                                  const uint8_t *r1,
+                                                  uint8_t *dst, int x0, int n)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    int i;
+
+    for (i = x0; i + 32 <= x0 + n; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(r0 + 2 * i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(r0 + 2 * i + 32));
+
+        _mm256_storeu_si256((__m256i *)(dst + i - x0),
+                            ni_yuv_packus_avx2(_mm256_and_si256(a, mask),
+                                               _mm256_and_si256(b, mask)));
+    }
+    ni_yuv_drop8_sse2(r0, r1, dst + i - x0, i, x0 + n - i);
+}
+
+NI_UTIL_TARGET_AVX2 static inline __m256i ni_yuv_pair_sum8_avx2(__m256i a,
+                                                                 __m256i b)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+
+    return _mm256_add_epi16(
+        _mm256_add_epi16(_mm256_and_si256(a, mask), _mm256_srli_epi16(a, 8)),
+        _mm256_add_epi16(_mm256_and_si256(b, mask), _mm256_srli_epi16(b, 8)));
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_yuv_box8_avx2(const uint8_t *r0,
+                                                 const uint8_t *r1,
+                                                 uint8_t *dst, int x0, int n)
+{
+    const __m256i two = _mm256_set1_epi16(2);
+    int i;
+
+    for (i = x0; i + 32 <= x0 + n; i += 32)
+    {
+        __m256i s0 = ni_yuv_pair_sum8_avx2(
+            _mm256_loadu_si256((const __m256i *)(r0 + 2 * i)),
+            _mm256_loadu_si256((const __m256i *)(r1 + 2 * i)));
+        __m256i s1 = ni_yuv_pair_sum8_avx2(
+            _mm256_loadu_si256((const __m256i *)(r0 + 2 * i + 32)),
+            _mm256_loadu_si256((const __m256i *)(r1 + 2 * i + 32)));
+
+        s0 = _mm256_srli_epi16(_mm256_add_epi16(s0, two), 2);
+        s1 = _mm256_srli_epi16(_mm256_add_epi16(s1, two), 2);
+        _mm256_storeu_si256((__m256i *)(dst + i - x0),
+                            ni_yuv_packus_avx2(s0, s1));
+    }
+    ni_yuv_box8_sse2(r0, r1, dst + i - x0, i, x0 + n - i);
+}
+
+NI_UTIL_TARGET_AVX2 static inline __m256i
+ni_yuv_left8x16_avx2(const uint8_t *r0, const uint8_t *r1, int i)
+{
+    const __m256i mask = _mm256_set1_epi16(0x00ff);
+    __m256i a = _mm256_loadu_si256((const __m256i *)(r0 + 2 * i));
+    __m256i b = _mm256_loadu_si256((const __m256i *)(r1 + 2 * i));
+    __m256i pa = _mm256_loadu_si256((const __m256i *)(r0 + 2 * i - 2));
+    __m256i pb = _mm256_loadu_si256((const __m256i *)(r1 + 2 * i - 2));
+    __m256i ve = _mm256_add_epi16(_mm256_and_si256(a, mask),
+                                  _mm256_and_si256(b, mask));
+    __m256i vo = _mm256_add_epi16(_mm256_srli_epi16(a, 8),
+                                  _mm256_srli_epi16(b, 8));
+    __m256i vp = _mm256_add_epi16(_mm256_srli_epi16(pa, 8),
+                                  _mm256_srli_epi16(pb, 8));
+    __m256i sum = _mm256_add_epi16(_mm256_add_epi16(vp, vo),
+                                   _mm256_add_epi16(_mm256_slli_epi16(ve, 1),
+                                                    _mm256_set1_epi16(4)));
+
+    return _mm256_srli_epi16(sum, 3);
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_yuv_left8_avx2(const uint8_t *r0,
+                                                  const uint8_t *r1,
+                                                  uint8_t *dst, int x0, int n)
+{
+    int i = x0;
+
+    if (i == 0 && n > 0)
+    {
+        ni_yuv_left8_c(r0, r1, dst, 0, 1);
+        i = 1;
+    }
+    for (; i + 32 <= x0 + n; i += 32)
+    {
+        _mm256_storeu_si256(
+            (__m256i *)(dst + i - x0),
+            ni_yuv_packus_avx2(ni_yuv_left8x16_avx2(r0, r1, i),
+                               ni_yuv_left8x16_avx2(r0, r1, i + 16)));
+    }
+    ni_yuv_left8_sse2(r0, r1, dst + i - x0, i, x0 + n - i);
+}
+
+static const ni_yuv_kernels_t g_yuv_kernels_avx2 = {
+    "avx2",
+    ni_yuv_deint8_avx2,
+    ni_yuv_deint16_sse2,
+    {ni_yuv_drop8_avx2, ni_yuv_box8_avx2, ni_yuv_left8_avx2},
+    {ni_yuv_drop16_sse2, ni_yuv_box16_sse2, ni_yuv_left16_sse2},
+    ni_yuv_interleave8_sse2,
+    ni_yuv_interleave16_sse2,
+    ni_yuv_shl16_sse2,
+};
+#endif
+
+#ifdef NI_UTIL_NEON
+static void ni_yuv_deint8_neon(const uint8_t *src, uint8_t *even, uint8_t *odd,
+                               int n)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        uint8x16x2_t v = vld2q_u8(src + 2 * i);
+
+        vst1q_u8(even + i, v.val[0]);
+        vst1q_u8(odd + i, v.val[1]);
+    }
+    ni_yuv_deint8_c(src + 2 * i, even + i, odd + i, n - i);
+}
+
+static void ni_yuv_deint16_neon(const uint8_t *src, uint8_t *even,
+                                uint8_t *odd, int n)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    uint16_t *e = (uint16_t *)even;
+    uint16_t *o = (uint16_t *)odd;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        uint16x8x2_t v = vld2q_u16(s + 2 * i);
+
+        vst1q_u16(e + i, v.val[0]);
+        vst1q_u16(o + i, v.val[1]);
+    }
+    ni_yuv_deint16_c((const uint8_t *)(s + 2 * i), (uint8_t *)(e + i),
+                     (uint8_t *)(o + i), n - i);
+}
+
+static void ni_yuv_drop8_neon(const uint8_t *r0, const uint8_t *r1,
+                              uint8_t *dst, int x0, int n)
+{
+    int i;
+
+    for (i = x0; i + 16 <= x0 + n; i += 16)
+    {
+        vst1q_u8(dst + i - x0, vld2q_u8(r0 + 2 * i).val[0]);
+    }
+    ni_yuv_drop8_c(r0, r1, dst + i - x0, i, x0 + n - i);
+}
+
+static void ni_yuv_box8_neon(const uint8_t *r0, const uint8_t *r1,
+                             uint8_t *dst, int x0, int n)
+{
+    int i;
+
+    for (i = x0; i + 16 <= x0 + n; i += 16)
+    {
+        uint8x16x2_t a = vld2q_u8(r0 + 2 * i);
+        uint8x16x2_t b = vld2q_u8(r1 + 2 * i);
+        uint16x8_t lo = vaddq_u16(
+            vaddl_u8(vget_low_u8(a.val[0]), vget_low_u8(a.val[1])),
+            vaddl_u8(vget_low_u8(b.val[0]), vget_low_u8(b.val[1])));
+        uint16x8_t hi = vaddq_u16(
+            vaddl_u8(vget_high_u8(a.val[0]), vget_high_u8(a.val[1])),
+            vaddl_u8(vget_high_u8(b.val[0]), vget_high_u8(b.val[1])));
+
+        vst1q_u8(dst + i - x0,
+                 vcombine_u8(vrshrn_n_u16(lo, 2), vrshrn_n_u16(hi, 2)));
+    }
+    ni_yuv_box8_c(r0, r1, dst + i - x0, i, x0 + n - i);
+}
+
+static void ni_yuv_drop16_neon(const uint8_t *r0, const uint8_t *r1,
+                               uint8_t *dst, int x0, int n)
+{
+    const uint16_t *s0 = (const uint16_t *)r0;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = x0; i + 8 <= x0 + n; i += 8)
+    {
+        vst1q_u16(d + i - x0, vld2q_u16(s0 + 2 * i).val[0]);
+    }
+    ni_yuv_drop16_c(r0, r1, (uint8_t *)(d + i - x0), i, x0 + n - i);
+}
+
+static void ni_yuv_box16_neon(const uint8_t *r0, const uint8_t *r1,
+                              uint8_t *dst, int x0, int n)
+{
+    const uint16_t *s0 = (const uint16_t *)r0;
+    const uint16_t *s1 = (const uint16_t *)r1;
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = x0; i + 8 <= x0 + n; i += 8)
+    {
+        uint16x8x2_t a = vld2q_u16(s0 + 2 * i);
+        uint16x8x2_t b = vld2q_u16(s1 + 2 * i);
+        uint32x4_t lo = vaddq_u32(
+            vaddl_u16(vget_low_u16(a.val[0]), vget_low_u16(a.val[1])),
+            vaddl_u16(vget_low_u16(b.val[0]), vget_low_u16(b.val[1])));
+        uint32x4_t hi = vaddq_u32(
+            vaddl_u16(vget_high_u16(a.val[0]), vget_high_u16(a.val[1])),
+            vaddl_u16(vget_high_u16(b.val[0]), vget_high_u16(b.val[1])));
+
+        vst1q_u16(d + i - x0,
+                  vcombine_u16(vrshrn_n_u32(lo, 2), vrshrn_n_u32(hi, 2)));
+    }
+    ni_yuv_box16_c(r0, r1, (uint8_t *)(d + i - x0), i, x0 + n - i);
+}
+
+static void ni_yuv_interleave8_neon(const uint8_t *u, const uint8_t *v,
+                                    uint8_t *dst, int n, int shift)
+{
+    int i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        uint8x16x2_t uv;
+
+        uv.val[0] = vld1q_u8(u + i);
+        uv.val[1] = vld1q_u8(v + i);
+        vst2q_u8(dst + 2 * i, uv);
+    }
+    ni_yuv_interleave8_c(u + i, v + i, dst + 2 * i, n - i, shift);
+}
+
+static void ni_yuv_interleave16_neon(const uint8_t *u, const uint8_t *v,
+                                     uint8_t *dst, int n, int shift)
+{
+    const uint16_t *su = (const uint16_t *)u;
+    const uint16_t *sv = (const uint16_t *)v;
+    const int16x8_t cnt = vdupq_n_s16((int16_t)shift);
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        uint16x8x2_t uv;
+
+        uv.val[0] = vshlq_u16(vld1q_u16(su + i), cnt);
+        uv.val[1] = vshlq_u16(vld1q_u16(sv + i), cnt);
+        vst2q_u16(d + 2 * i, uv);
+    }
+    ni_yuv_interleave16_c((const uint8_t *)(su + i), (const uint8_t *)(sv + i),
+                          (uint8_t *)(d + 2 * i), n - i, shift);
+}
+
+static void ni_yuv_shl16_neon(const uint8_t *src, uint8_t *dst, int n,
+                              int shift)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    const int16x8_t cnt = vdupq_n_s16((int16_t)shift);
+    uint16_t *d = (uint16_t *)dst;
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8)
+    {
+        vst1q_u16(d + i, vshlq_u16(vld1q_u16(s + i), cnt));
+    }
+    ni_yuv_shl16_c((const uint8_t *)(s + i), (uint8_t *)(d + i), n - i, shift);
+}
+
+static const ni_yuv_kernels_t g_yuv_kernels_neon = {
+    "neon",
+    ni_yuv_deint8_neon,
+    ni_yuv_deint16_neon,
+    {ni_yuv_drop8_neon, ni_yuv_box8_neon, ni_yuv_left8_c},
+    {ni_yuv_drop16_neon, ni_yuv_box16_neon, ni_yuv_left16_c},
+    ni_yuv_interleave8_neon,
+    ni_yuv_interleave16_neon,
+    ni_yuv_shl16_neon,
+};
+#endif
+
+static const ni_yuv_kernels_t *volatile g_yuv_kernels = NULL;
+static volatile int g_yuv_conv_threads = 1;
+
+/*!*****************************************************************************
+ *  \brief  Pick the fastest YUV row kernels supported by the running CPU.
+ *          Selection is idempotent, so racing first callers are harmless.
+ ******************************************************************************/
+static const ni_yuv_kernels_t *ni_yuv_get_kernels(void)
+{
+    const ni_yuv_kernels_t *p_kernels = g_yuv_kernels;
+
+    if (p_kernels)
+    {
+        return p_kernels;
+    }
+
+    p_kernels = &g_yuv_kernels_c;
+#ifdef NI_UTIL_SSE2
+    p_kernels = &g_yuv_kernels_sse2;
+#endif
+#ifdef NI_UTIL_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        p_kernels = &g_yuv_kernels_avx2;
+    }
+#endif
+#ifdef NI_UTIL_NEON
+    p_kernels = &g_yuv_kernels_neon;
+#endif
+    ni_log(NI_LOG_DEBUG, "%s: using %s yuv conversion kernels\n", __func__,
+           p_kernels->name);
+    g_yuv_kernels = p_kernels;
+    return p_kernels;
+}
+
+typedef void (*ni_yuv_rows_fn)(const void *ctx, int start, int end);
+
+typedef struct _ni_yuv_conv_job
+{
+    ni_yuv_rows_fn fn;
+    const void *ctx;
+    int start;
+    int end;
+} ni_yuv_conv_job_t;
+
+static void *ni_yuv_conv_job_run(void *arg)
+{
+    ni_yuv_conv_job_t *job = (ni_yuv_conv_job_t *)arg;
+
+    job->fn(job->ctx, job->start, job->end);
+    return NULL;
+}
+
+/*!*****************************************************************************
+ *  \brief  Run a row conversion over nb_rows independent rows, splitting them
+ *          over up to ni_yuv_set_convert_threads() threads when the frame is
+ *          large enough to amortize thread creation.
+ ******************************************************************************/
+static void ni_yuv_convert_rows(ni_yuv_rows_fn fn, const void *ctx,
+                                int nb_rows, size_t row_bytes)
+{
+    ni_yuv_conv_job_t jobs[NI_YUV_CONVERT_MAX_THREADS];
+    ni_pthread_t threads[NI_YUV_CONVERT_MAX_THREADS];
+    int started[NI_YUV_CONVERT_MAX_THREADS];
+    size_t nb_threads = (size_t)g_yuv_conv_threads;
+    int chunk, i;
+
+    if (row_bytes * nb_rows / NI_YUV_CONVERT_MT_MIN_BYTES < nb_threads)
+    {
+        nb_threads = row_bytes * nb_rows / NI_YUV_CONVERT_MT_MIN_BYTES;
+    }
+    if (nb_threads > (size_t)nb_rows)
+    {
+        nb_threads = (size_t)nb_rows;
+    }
+
+    if (nb_threads <= 1)
+    {
+        fn(ctx, 0, nb_rows);
+        return;
+    }
+
+    chunk = (nb_rows + (int)nb_threads - 1) / (int)nb_threads;
+    for (i = 0; i < (int)nb_threads; i++)
+    {
+        jobs[i].fn = fn;
+        jobs[i].ctx = ctx;
+        jobs[i].start = ni_min(i * chunk, nb_rows);
+        jobs[i].end = ni_min((i + 1) * chunk, nb_rows);
+        started[i] = 0;
+    }
+
+    for (i = 1; i < (int)nb_threads; i++)
+    {
+        if (jobs[i].start < jobs[i].end &&
+            ni_pthread_create(&threads[i], NULL, ni_yuv_conv_job_run,
+                              &jobs[i]) == 0)
+        {
+            started[i] = 1;
+        }
+    }
+
+    ni_yuv_conv_job_run(&jobs[0]);
+
+    for (i = 1; i < (int)nb_threads; i++)
+    {
+        if (started[i])
+        {
+            ni_pthread_join(threads[i], NULL);
+        } else if (jobs[i].start < jobs[i].end)
+        {
+            ni_yuv_conv_job_run(&jobs[i]);
+        }
+    }
+}
+
+void ni_yuv_set_convert_threads(int nb_threads)
+{
+    if (nb_threads < 1)
+    {
+        nb_threads = 1;
+    } else if (nb_threads > NI_YUV_CONVERT_MAX_THREADS)
+    {
+        nb_threads = NI_YUV_CONVERT_MAX_THREADS;
+    }
+    g_yuv_conv_threads = nb_threads;
+}
+
+/*!*****************************************************************************
+ *  \brief  Replicate the last unit bytes of a line up to total bytes. The
+ *          copies double in size so wide paddings cost a handful of memcpy.
+ ******************************************************************************/
+static void ni_yuv_replicate_tail(uint8_t *p_line, int used, int unit,
+                                  int total)
+{
+    uint8_t *p_pattern = p_line + used - unit;
+    int have = unit;
+    int left = total - used;
+    int len;
+
+    while (left > 0)
+    {
+        len = have < left ? have : left;
+        memcpy(p_pattern + have, p_pattern, len);
+        have += len;
+        left -= len;
+    }
+}
+
+typedef struct _ni_yuv_444p_copy_ctx
+{
+    const ni_yuv_kernels_t *p_kernels;
+    uint8_t **p_dst0;
+    uint8_t **p_dst1;
+    uint8_t **p_src;
+    int frame_height;
+    int factor;
+    int mode;
+    int nb_pairs;             // chroma samples per output line
+    int y_444p_linesize;
+    int uv_444p_linesize;
+    int y_420p_linesize;
+    int uv_420p_linesize;
+} ni_yuv_444p_copy_ctx_t;
+
+// convert output chroma lines [start, end), ie. source lines [2 * start,
+// 2 * end) plus the odd last source line for the last slice
+static void ni_yuv_444p_to_420p_rows(const void *ctx, int start, int end)
+{
+    const ni_yuv_444p_copy_ctx_t *c = (const ni_yuv_444p_copy_ctx_t *)ctx;
+    ni_yuv_deint_fn deint = (c->factor == 1) ? c->p_kernels->deint8 :
+                                               c->p_kernels->deint16;
+    int line_end = (end == c->frame_height / 2) ? c->frame_height : 2 * end;
+    int i;
+
+    // Y component
+    for (i = 2 * start; i < line_end; i++)
+    {
+        memcpy(&c->p_dst0[0][i * c->y_420p_linesize],
+               &c->p_src[0][i * c->y_444p_linesize], c->y_444p_linesize);
+    }
+
+    if (c->mode == 0)
+    {
+        // out0 data[0]: Y  data[1]: 0.25V  data[2]: 0.25V
+        // out1 data[0]: U  data[1]: 0.25V  data[2]: 0.25V
+        // U component
+        for (i = 2 * start; i < line_end; i++)
+        {
+            memcpy(&c->p_dst1[0][i * c->y_420p_linesize],
+                   &c->p_src[1][i * c->y_444p_linesize], c->y_444p_linesize);
+        }
+
+        // V component, even line to out0 and odd line to out1
+        for (i = start; i < end; i++)
+        {
+            deint(&c->p_src[2][2 * i * c->uv_444p_linesize],
+                  &c->p_dst0[1][i * c->uv_420p_linesize],
+                  &c->p_dst0[2][i * c->uv_420p_linesize], c->nb_pairs);
+            deint(&c->p_src[2][(2 * i + 1) * c->uv_444p_linesize],
+                  &c->p_dst1[1][i * c->uv_420p_linesize],
+                  &c->p_dst1[2][i * c->uv_420p_linesize], c->nb_pairs);
+        }
+    } else
+    {
+        // out0 data[0]:  Y           data[1]: 0.25U  data[2]: 0.25V
+        // out1 data[0]:  0.5U + 0.5V data[1]: 0.25U  data[2]: 0.25V
+        for (i = start; i < end; i++)
+        {
+            // even line 0.25U
+            deint(&c->p_src[1][2 * i * c->uv_444p_linesize],
+                  &c->p_dst0[1][i * c->uv_420p_linesize],
+                  &c->p_dst1[1][i * c->uv_420p_linesize], c->nb_pairs);
+            // odd line 0.5U
+            memcpy(&c->p_dst1[0][2 * i * c->uv_444p_linesize],
+                   &c->p_src[1][(2 * i + 1) * c->uv_444p_linesize],
+                   c->uv_444p_linesize);
+
+            // even line 0.25V
+            deint(&c->p_src[2][2 * i * c->uv_444p_linesize],
+                  &c->p_dst0[2][i * c->uv_420p_linesize],
+                  &c->p_dst1[2][i * c->uv_420p_linesize], c->nb_pairs);
+            // odd line 0.5V
+            memcpy(&c->p_dst1[0][(2 * i + 1) * c->uv_444p_linesize],
+                   &c->p_src[2][(2 * i + 1) * c->uv_444p_linesize],
+                   c->uv_444p_linesize);
+        }
+    }
+}
+
+/*!*****************************************************************************
+ *  \brief  Copy yuv444p data to yuv420p frame layout to be sent
+ *          to encoder for encoding. Data buffer (dst) is usually allocated by
+ *          ni_encoder_frame_buffer_alloc.
+ *
+ *  \param[out]    p_dst0  pointers of Y/Cb/Cr as yuv420p output0
+ *  \param[out]    p_dst1  pointers of Y/Cb/Cr as yuv420p output1
+ *  \param[in]     p_src  pointers of Y/Cb/Cr as yuv444p intput
+ *  \param[in]     width  source YUV frame width
+ *  \param[in]     height source YUV frame height
+ *  \param[in]     factor  1 for 8 bit, 2 for 10 bit
+ *  \param[in]     mode 0 for
+ *                 out0 is Y+1/2V, with the original input as the out0, 1/4V
+ *                 copy to data[1] 1/4V copy to data[2]
+ *                 out1 is U+1/2V, U copy to data[0], 1/4V copy to data[1], 1/4V
+ *                 copy to data[2]
+ *                 mode 1 for
+ *                 out0 is Y+1/2u+1/2v, with the original input as the output0,
+ *                 1/4U copy to data[1] 1/4V copy to data[2]
+ *                 out1 is (1/2U+1/2V)+1/4U+1/4V, 1/2U & 1/2V copy to data[0],
+ *                 1/4U copy to data[1], 1/4V copy to data[2]
+ *
+ *  \return Y/Cb/Cr data
+ *
+ ******************************************************************************/
+void ni_copy_yuv_444p_to_420p(uint8_t *p_dst0[NI_MAX_NUM_DATA_POINTERS],
+                              uint8_t *p_dst1[NI_MAX_NUM_DATA_POINTERS],
+                              uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+                              int frame_width, int frame_height,
+                              int factor, int mode)
+{
+    ni_yuv_444p_copy_ctx_t ctx;
+
+    // return to avoid self copy
+    if (p_dst0[0] == p_dst1[0] && p_dst0[1] == p_dst1[1] &&
+        p_dst0[2] == p_dst1[2])
+    {
+        ni_log(NI_LOG_DEBUG, "%s: src and dst identical, return\n", __func__);
+        return;
+    }
+
+    ctx.p_kernels = ni_yuv_get_kernels();
+    ctx.p_dst0 = p_dst0;
+    ctx.p_dst1 = p_dst1;
+    ctx.p_src = p_src;
+    ctx.frame_height = frame_height;
+    ctx.factor = factor;
+    ctx.mode = mode;
+    ctx.y_444p_linesize = frame_width * factor;
+    ctx.uv_444p_linesize = ctx.y_444p_linesize;
+    ctx.y_420p_linesize = NI_VPU_ALIGN128(ctx.y_444p_linesize);
+    ctx.uv_420p_linesize = NI_VPU_ALIGN128(ctx.uv_444p_linesize / 2);
+    ctx.nb_pairs = (frame_width * factor / 2 + factor - 1) / factor;
+
+    ni_yuv_convert_rows(ni_yuv_444p_to_420p_rows, &ctx, frame_height / 2,
+                        (size_t)ctx.y_444p_linesize * 6);
+}
+
+typedef struct _ni_yuv_420_conv_ctx
+{
+    const ni_yuv_kernels_t *p_kernels;
+    uint8_t **p_dst;
+    const int *dst_stride;
+    uint8_t **p_src;
+    const int *src_stride;
+    int width;
+    int height;
+    int dst_width;
+    int dst_height;
+    int bps;                  // bytes per sample
+    int semiplanar;
+    int shift;                // 6 for P010, 0 otherwise
+    ni_chroma_filter_t filter;
+} ni_yuv_420_conv_ctx_t;
+
+#define NI_YUV_CHROMA_STRIP 512
+
+static void ni_yuv_420_luma_line(const ni_yuv_420_conv_ctx_t *c, uint8_t *dst,
+                                 const uint8_t *src)
+{
+    if (c->shift)
+    {
+        c->p_kernels->shl16(src, dst, c->width, c->shift);
+    } else
+    {
+        memcpy(dst, src, (size_t)c->width * c->bps);
+    }
+    ni_yuv_replicate_tail(dst, c->width * c->bps, c->bps,
+                          c->dst_width * c->bps);
+}
+
+// chroma sample at output position i, replicating the last source column
+static int ni_yuv_420_chroma_edge(const ni_yuv_420_conv_ctx_t *c,
+                                  const uint8_t *r0, const uint8_t *r1, int i)
+{
+    int x0 = ni_min(2 * i, c->width - 1);
+    int x1 = ni_min(2 * i + 1, c->width - 1);
+    int xm = ni_min(i ? 2 * i - 1 : 0, c->width - 1);
+#define NI_YUV_SAMPLE(r, x)                                                   \
+    ((c->bps == 1) ? (int)(r)[x] : (int)((const uint16_t *)(r))[x])
+
+    switch (c->filter)
+    {
+        case NI_CHROMA_FILTER_BOX:
+            return (NI_YUV_SAMPLE(r0, x0) + NI_YUV_SAMPLE(r0, x1) +
+                    NI_YUV_SAMPLE(r1, x0) + NI_YUV_SAMPLE(r1, x1) + 2) >> 2;
+        case NI_CHROMA_FILTER_LEFT:
+            return (NI_YUV_SAMPLE(r0, xm) + NI_YUV_SAMPLE(r1, xm) +
+                    2 * (NI_YUV_SAMPLE(r0, x0) + NI_YUV_SAMPLE(r1, x0)) +
+                    NI_YUV_SAMPLE(r0, x1) + NI_YUV_SAMPLE(r1, x1) + 4) >> 3;
+        case NI_CHROMA_FILTER_DROP:
+        default:
+            return NI_YUV_SAMPLE(r0, x0);
+    }
+#undef NI_YUV_SAMPLE
+}
+
+// downsample chroma outputs [x0, x0 + n) of one plane into dst
+static void ni_yuv_420_chroma(const ni_yuv_420_conv_ctx_t *c, int plane,
+                              int line, uint8_t *dst, int x0, int n)
+{
+    const uint8_t *r0 = c->p_src[plane] +
+        (size_t)ni_min(2 * line, c->height - 1) * c->src_stride[plane];
+    const uint8_t *r1 = c->p_src[plane] +
+        (size_t)ni_min(2 * line + 1, c->height - 1) * c->src_stride[plane];
+    ni_yuv_down_fn down = (c->bps == 1) ? c->p_kernels->down8[c->filter] :
+                                          c->p_kernels->down16[c->filter];
+    // outputs whose filter support lies inside the source line
+    int nb_inside = (c->filter == NI_CHROMA_FILTER_DROP) ? (c->width + 1) / 2 :
+                                                           c->width / 2;
+    int inside = ni_max(ni_min(nb_inside - x0, n), 0);
+    int i, v;
+
+    down(r0, r1, dst, x0, inside);
+    for (i = x0 + inside; i < x0 + n; i++)
+    {
+        v = ni_yuv_420_chroma_edge(c, r0, r1, i);
+        if (c->bps == 1)
+        {
+            dst[i - x0] = (uint8_t)v;
+        } else
+        {
+            ((uint16_t *)dst)[i - x0] = (uint16_t)v;
+        }
+    }
+}
+
+static void ni_yuv_444p_to_420_rows(const void *ctx, int start, int end)
+{
+    const ni_yuv_420_conv_ctx_t *c = (const ni_yuv_420_conv_ctx_t *)ctx;
+    int src_chroma_w = (c->width + 1) / 2;
+    int src_chroma_h = (c->height + 1) / 2;
+    int dst_chroma_w = (c->dst_width + 1) / 2;
+    uint16_t strip_u[NI_YUV_CHROMA_STRIP];
+    uint16_t strip_v[NI_YUV_CHROMA_STRIP];
+    uint8_t *dst;
+    int line, src_line, y, x0, n;
+
+    for (line = start; line < end; line++)
+    {
+        // luma lines below the source are copies of its last line
+        for (y = 2 * line; y < ni_min(2 * line + 2, c->dst_height); y++)
+        {
+            ni_yuv_420_luma_line(
+                c, c->p_dst[0] + (size_t)y * c->dst_stride[0],
+                c->p_src[0] +
+                    (size_t)ni_min(y, c->height - 1) * c->src_stride[0]);
+        }
+
+        src_line = ni_min(line, src_chroma_h - 1);
+        if (c->semiplanar)
+        {
+            dst = c->p_dst[1] + (size_t)line * c->dst_stride[1];
+            for (x0 = 0; x0 < src_chroma_w; x0 += NI_YUV_CHROMA_STRIP)
+            {
+                n = ni_min(NI_YUV_CHROMA_STRIP, src_chroma_w - x0);
+                ni_yuv_420_chroma(c, 1, src_line, (uint8_t *)strip_u, x0, n);
+                ni_yuv_420_chroma(c, 2, src_line, (uint8_t *)strip_v, x0, n);
+                if (c->bps == 1)
+                {
+                    c->p_kernels->interleave8((uint8_t *)strip_u,
+                                              (uint8_t *)strip_v,
+                                              dst + (size_t)x0 * 2, n, 0);
+                } else
+                {
+                    c->p_kernels->interleave16((uint8_t *)strip_u,
+                                               (uint8_t *)strip_v,
+                                               dst + (size_t)x0 * 4, n,
+                                               c->shift);
+                }
+            }
+            ni_yuv_replicate_tail(dst, src_chroma_w * 2 * c->bps, 2 * c->bps,
+                                  dst_chroma_w * 2 * c->bps);
+        } else
+        {
+            for (n = 1; n <= 2; n++)
+            {
+                dst = c->p_dst[n] + (size_t)line * c->dst_stride[n];
+                ni_yuv_420_chroma(c, n, src_line, dst, 0, src_chroma_w);
+                ni_yuv_replicate_tail(dst, src_chroma_w * c->bps, c->bps,
+                                      dst_chroma_w * c->bps);
+            }
+        }
+    }
+}
+
+ni_retcode_t ni_convert_yuv_444p_to_420p(
+    uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS],
+    const int dst_stride[NI_MAX_NUM_DATA_POINTERS], int dst_width,
+    int dst_height, ni_pix_fmt_t dst_fmt,
+    uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+    const int src_stride[NI_MAX_NUM_DATA_POINTERS], int width, int height,
+    ni_chroma_filter_t filter)
+{
+    ni_yuv_420_conv_ctx_t ctx;
+    int i;
+
+    if (!p_dst || !dst_stride || !p_src || !src_stride || width <= 0 ||
+        height <= 0 || dst_width < width || dst_height < height ||
+        filter < NI_CHROMA_FILTER_DROP || filter >= NI_CHROMA_FILTER_NUM)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid parameters\n", __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    memset(&ctx, 0, sizeof(ctx));
+    switch (dst_fmt)
+    {
+        case NI_PIX_FMT_YUV420P:
+            ctx.bps = 1;
+            break;
+        case NI_PIX_FMT_YUV420P10LE:
+            ctx.bps = 2;
+            break;
+        case NI_PIX_FMT_NV12:
+            ctx.bps = 1;
+            ctx.semiplanar = 1;
+            break;
+        case NI_PIX_FMT_P010LE:
+            ctx.bps = 2;
+            ctx.semiplanar = 1;
+            ctx.shift = 6;
+            break;
+        default:
+            ni_log(NI_LOG_ERROR, "ERROR: %s() unsupported pixel format %d\n",
+                   __func__, dst_fmt);
+            return NI_RETCODE_INVALID_PARAM;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        if (!p_src[i] || src_stride[i] < width * ctx.bps)
+        {
+            ni_log(NI_LOG_ERROR, "ERROR: %s() invalid source plane %d\n",
+                   __func__, i);
+            return NI_RETCODE_INVALID_PARAM;
+        }
+    }
+    if (!p_dst[0] || dst_stride[0] < dst_width * ctx.bps ||
+        !p_dst[1] ||
+        dst_stride[1] < (dst_width + 1) / 2 * ctx.bps * (ctx.semiplanar + 1) ||
+        (!ctx.semiplanar &&
+         (!p_dst[2] || dst_stride[2] < (dst_width + 1) / 2 * ctx.bps)))
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() invalid destination planes\n",
+               __func__);
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    ctx.p_kernels = ni_yuv_get_kernels();
+    ctx.p_dst = p_dst;
+    ctx.dst_stride = dst_stride;
+    ctx.p_src = p_src;
+    ctx.src_stride = src_stride;
+    ctx.width = width;
+    ctx.height = height;
+    ctx.dst_width = dst_width;
+    ctx.dst_height = dst_height;
+    ctx.filter = filter;
+
+    ni_yuv_convert_rows(ni_yuv_444p_to_420_rows, &ctx, (dst_height + 1) / 2,
+                        (size_t)dst_width * 3 * ctx.bps);
+    return NI_RETCODE_SUCCESS;
+}
+
+// NAL operations
+
+/*!*****************************************************************************
+ *  \brief  Insert emulation prevention byte(s) as needed into the data buffer
+ *
+ *  \param  buf   data buffer to be worked on - new byte(s) will be inserted
+ *          size  number of bytes starting from buf to check
+ *
+ *  \return the number of emulation prevention bytes inserted into buf, 0 if
+ *          none.
+ *
+ *  Note: caller *MUST* ensure for newly inserted bytes, buf has enough free
+ *        space starting from buf + size
+ ******************************************************************************/
+int ni_insert_emulation_prevent_bytes(uint8_t *buf, int size)
+{
+    int insert_bytes = 0;
+    uint8_t *buf_curr = buf;
+    uint8_t *buf_end = buf + size - 1;
+    int zeros = 0, insert_ep3_byte;
+
+    ni_log(NI_LOG_TRACE, "%s: enter\n", __func__);
+
+    for (; buf_curr <= buf_end; buf_curr++)
+    {
+        if (zeros == 2)
+        {
+            insert_ep3_byte = (*buf_curr <= 3);
+            if (insert_ep3_byte)
+            {
+                // move bytes from curr to end 1 position to make space for ep3
+                memmove(buf_curr + 1, buf_curr, buf_end - buf_curr + 1);
+                *buf_curr = 0x3;
+
+                buf_curr++;
+                buf_end++;
+                insert_bytes++;
+            }
+
+            zeros = 0;
+        }
+
+        if (!*buf_curr)
+        {
+            zeros++;
+        } else
+        {
+            zeros = 0;
+        }
+    }
+
+    ni_log(NI_LOG_TRACE, "%s: %d, exit\n", __func__, insert_bytes);
+    return insert_bytes;
+}
+
+/*!*****************************************************************************
+ *  \brief  Remove emulation prevention byte(s) as needed from the data buffer
+ *
+ *  \param  buf   data buffer to be worked on - emu prevent byte(s) will be
+ *                removed from.
+ *          size  number of bytes starting from buf to check
+ *
+ *  \return the number of emulation prevention bytes removed from buf, 0 if
+ *          none.
+ *
+ *  Note: buf will be modified if emu prevent byte(s) found and removed.
+ ******************************************************************************/
+int ni_remove_emulation_prevent_bytes(uint8_t *buf, int size)
+{
+    int remove_bytes = 0;
+    uint8_t *buf_curr = buf;
+    uint8_t *buf_end = buf + size - 1;
+    int zeros = 0, remove_ep3_byte;
+
+    ni_log(NI_LOG_TRACE, "%s: enter\n", __func__);
+
+    for (; buf_curr < buf_end; buf_curr++)
+    {
+        if (zeros == 2)
+        {
+            remove_ep3_byte = (*buf_curr == 0x03 && *(buf_curr + 1) <= 3);
+            if (remove_ep3_byte)
+            {
+                // move bytes after curr to end, 1 position forward to overwrite ep3
+                memmove(buf_curr, buf_curr + 1, buf_end - buf_curr);
+
+                // buf_curr unchanged
+                buf_end--;
+                remove_bytes++;
+            }
+
+            zeros = 0;
+        }
+
+        if (!*buf_curr)
+        {
+            zeros++;
+        } else
+        {
+            zeros = 0;
+        }
+    }
+
+    ni_log(NI_LOG_TRACE, "%s: %d, exit\n", __func__, remove_bytes);
+    return remove_bytes;
+}
+
+/******************************************************************************
+ *
+ * Ai utils apis
+ *
+ ******************************************************************************/
+static uint32_t ni_ai_type_get_bytes(const uint32_t type)
+{
+    switch (type)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+            return 1;
+        case NI_AI_BUFFER_FORMAT_INT16:
+        case NI_AI_BUFFER_FORMAT_UINT16:
+        case NI_AI_BUFFER_FORMAT_FP16:
+        case NI_AI_BUFFER_FORMAT_BFP16:
+            return 2;
+        case NI_AI_BUFFER_FORMAT_FP32:
+        case NI_AI_BUFFER_FORMAT_INT32:
+        case NI_AI_BUFFER_FORMAT_UINT32:
+            return 4;
+        case NI_AI_BUFFER_FORMAT_FP64:
+        case NI_AI_BUFFER_FORMAT_INT64:
+        case NI_AI_BUFFER_FORMAT_UINT64:
+            return 8;
+
+        default:
+            return 0;
+    }
+}
+
+static void ni_ai_integer_convert(const void *src, void *dest,
+                                  ni_ai_buffer_format_e src_dtype,
+                                  ni_ai_buffer_format_e dst_dtype)
+{
+    unsigned char all_zeros[] = {0x00, 0x00, 0x00, 0x00,
+                                 0x00, 0x00, 0x00, 0x00};
+    unsigned char all_ones[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    uint32_t src_sz = ni_ai_type_get_bytes(src_dtype);
+    uint32_t dest_sz = ni_ai_type_get_bytes(dst_dtype);
+    unsigned char *buffer = all_zeros;
+
+    if (((int8_t *)src)[src_sz - 1] & 0x80)
+    {
+        buffer = all_ones;
+    }
+    memcpy(buffer, src, src_sz);
+    memcpy(dest, buffer, dest_sz);
+}
+
+static float ni_ai_fp16_to_fp32(const short in)
+{
+    typedef union
+    {
+        unsigned int u;
+        float f;
+    } _fp32_t;
+
+    const _fp32_t magic = {(254 - 15) << 23};
+    const _fp32_t infnan = {(127 + 16) << 23};
+    _fp32_t o;
+    // Non-sign bits
+    o.u = (in & 0x7fff) << 13;
+    o.f *= magic.f;
+    if (o.f >= infnan.f)
+    {
+        o.u |= 255 << 23;
+    }
+    //Sign bit
+    o.u |= (in & 0x8000) << 16;
+    return o.f;
+}
+
+static uint32_t ni_ai_get_tensor_size(int32_t *shape, uint32_t dim_num,
+                                      int32_t type)
+{
+    uint32_t sz;
+    uint32_t i;
+    sz = 0;
+    if (NULL == shape || 0 == dim_num)
+    {
+        return sz;
+    }
+    sz = 1;
+    for (i = 0; i < dim_num; i++)
+    {
+        sz *= shape[i];
+    }
+    sz *= ni_ai_type_get_bytes(type);
+
+    return sz;
+}
+
+static uint32_t ni_ai_get_element_num(int32_t *sizes, uint32_t num_of_dims,
+                                      int32_t data_format)
+{
+    uint32_t num;
+    uint32_t sz;
+    uint32_t dsize;
+
+    sz = ni_ai_get_tensor_size(sizes, num_of_dims, data_format);
+    dsize = ni_ai_type_get_bytes(data_format);
+    if (dsize)
+    {
+        num = (uint32_t)(sz / dsize);
+    } else
+    {
+        num = 0;
+    }
+
+    return num;
+}
+
+static int32_t ni_ai_type_is_integer(const int32_t type)
+{
+    int32_t ret = 0;
+    switch (type)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_INT16:
+        case NI_AI_BUFFER_FORMAT_INT32:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+        case NI_AI_BUFFER_FORMAT_UINT16:
+        case NI_AI_BUFFER_FORMAT_UINT32:
+            ret = 1;
+            break;
+        default:
+            break;
+    }
+
+    return ret;
+}
+
+static int32_t ni_ai_type_is_signed(const int32_t type)
+{
+    int32_t ret = 0;
+    switch (type)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
         case NI_AI_BUFFER_FORMAT_INT16:
         case NI_AI_BUFFER_FORMAT_INT32:
         case NI_AI_BUFFER_FORMAT_BFP16:
         case NI_AI_BUFFER_FORMAT_FP16:
         case NI_AI_BUFFER_FORMAT_FP32:
-            ret = 1;
+            ret = 1;
+            break;
+        default:
+            break;
+    }
+
+    return ret;
+}
+
+static void ni_ai_type_get_range(int32_t type, double *max_range,
+                                 double *min_range)
+{
+    int32_t bits;
+    double from, to;
+    from = 0.0;
+    to = 0.0;
+    bits = ni_ai_type_get_bytes(type) * 8;
+    if (ni_ai_type_is_integer(type))
+    {
+        if (ni_ai_type_is_signed(type))
+        {
+            from = (double)(-(1L << (bits - 1)));
+            to = (double)((1UL << (bits - 1)) - 1);
+        } else
+        {
+            from = 0.0;
+            to = (double)((1UL << bits) - 1);
+        }
+    }
+    if (NULL != max_range)
+    {
+        *max_range = to;
+    }
+    if (NULL != min_range)
+    {
+        *min_range = from;
+    }
+}
+
+static inline double ni_abs(double x)
+{
+    return x < 0 ? -x : x;
+}
+
+static double ni_ai_copy_sign(double number, double sign)
+{
+    double value = ni_abs(number);
+    return (sign > 0) ? value : (-value);
+}
+
+static inline int ni_ai_math_floorf(double x)
+{
+    return x >= 0 ? (int)x : (int)x - 1;
+}
+
+static double ni_ai_rint(double x)
+{
+#define _EPSILON 1e-8
+    double decimal;
+    double inter;
+    int intpart;
+
+    intpart = (int)x;
+    decimal = x - intpart;
+    inter = (double)intpart;
+
+    if (ni_abs((ni_abs(decimal) - 0.5f)) < _EPSILON)
+    {
+        inter += (int32_t)(inter) % 2;
+    } else
+    {
+        return ni_ai_copy_sign(ni_ai_math_floorf(ni_abs(x) + 0.5f), x);
+    }
+
+    return inter;
+}
+
+static int32_t ni_ai_fp32_to_dfp(const float in, const signed char fl,
+                                 const int32_t type)
+{
+    int32_t data;
+    double max_range;
+    double min_range;
+    ni_ai_type_get_range(type, &max_range, &min_range);
+    if (fl > 0)
+    {
+        data = (int32_t)ni_ai_rint(in * (float)(1 << fl));
+    } else
+    {
+        data = (int32_t)ni_ai_rint(in * (1.0f / (float)(1 << -fl)));
+    }
+    data = ni_min(data, (int32_t)max_range);
+    data = ni_max(data, (int32_t)min_range);
+
+    return data;
+}
+
+static int32_t ni_ai_fp32_to_affine(const float in, const float scale,
+                                    const int zero_point, const int32_t type)
+{
+    int32_t data;
+    double max_range;
+    double min_range;
+    ni_ai_type_get_range(type, &max_range, &min_range);
+    data = (int32_t)(ni_ai_rint(in / scale) + zero_point);
+    data = ni_max((int32_t)min_range, ni_min((int32_t)max_range, data));
+    return data;
+}
+
+static unsigned short ni_ai_fp32_to_bfp16_rtne(float in)
+{
+    /*
+    Convert a float point to bfloat16, with round-nearest-to-even as rounding method.
+    */
+    unsigned short out;
+
+    uint32_t fp32;
+    memcpy(&fp32, &in, sizeof(uint32_t));
+
+    uint32_t lsb =
+        (fp32 >> 16) & 1; /* Least significant bit of resulting bfloat. */
+    uint32_t rounding_bias = 0x7fff + lsb;
+
+    if ((fp32 & 0x7fffffff) > 0x7f800000)
+    {
+        /* NaN: return a quiet NaN, the rounding bias could carry into the
+           sign bit */
+        out = 0x7fc0;
+    } else
+    {
+        fp32 += rounding_bias;
+        out = (unsigned short)(fp32 >> 16);
+    }
+
+    return out;
+}
+
+static unsigned short ni_ai_fp32_to_fp16(float in)
+{
+    uint32_t fp32 = 0;
+    uint32_t t1 = 0;
+    uint32_t t2 = 0;
+    uint32_t t3 = 0;
+    uint32_t fp16 = 0u;
+
+    memcpy((uint8_t *)&fp32, (uint8_t *)&in, sizeof(uint32_t));
+
+    t1 = (fp32 & 0x80000000u) >> 16; /* sign bit. */
+    t2 = (fp32 & 0x7F800000u) >> 13; /* Exponent bits */
+    t3 = (fp32 & 0x007FE000u) >> 13; /* Mantissa bits, no rounding */
+
+    if (t2 >= 0x023c00u)
+    {
+        fp16 = t1 | 0x7BFF; /* Don't round to infinity. */
+    } else if (t2 <= 0x01c000u)
+    {
+        fp16 = t1;
+    } else
+    {
+        t2 -= 0x01c000u;
+        fp16 = t1 | t2 | t3;
+    }
+
+    return (unsigned short)fp16;
+}
+
+static void ni_ai_float32_to_dtype(float src, unsigned char *dst,
+                                   const int32_t data_type,
+                                   const int32_t quant_format,
+                                   signed char fixed_point_pos, float tf_scale,
+                                   int32_t tf_zerop)
+{
+    switch (data_type)
+    {
+        case NI_AI_BUFFER_FORMAT_FP32:
+        memcpy(dst, &src, sizeof(float));
             break;
-        default:
+        case NI_AI_BUFFER_FORMAT_FP16:
+            *(int16_t *)dst = ni_ai_fp32_to_fp16(src);
+            break;
+        case NI_AI_BUFFER_FORMAT_BFP16:
+            *(int16_t *)dst = ni_ai_fp32_to_bfp16_rtne(src);
             break;
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+        case NI_AI_BUFFER_FORMAT_INT16:
+        {
+            int32_t dst_value = 0;
+            switch (quant_format)
+            {
+                case NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT:
+                    dst_value =
+                        ni_ai_fp32_to_dfp(src, fixed_point_pos, data_type);
+                    break;
+                case NI_AI_BUFFER_QUANTIZE_TF_ASYMM:
+                    dst_value = ni_ai_fp32_to_affine(src, tf_scale, tf_zerop,
+                                                     data_type);
+                    break;
+                case NI_AI_BUFFER_QUANTIZE_NONE:
+                    dst_value = (int32_t)src;
+                    break;
+                default:
+                    break;
+            }
+            ni_ai_integer_convert(&dst_value, dst, NI_AI_BUFFER_FORMAT_INT32,
+                                  data_type);
+        }
+        break;
+        default:;
+    }
+}
+
+/*
+ * Bulk tensor conversion kernels
+ *
+ * Each kernel converts a contiguous run of elements so that the format and
+ * quantization dispatch is paid once per tensor instead of once per element.
+ * The _c kernels are the reference implementation and also handle the tail
+ * of the vector kernels; the SSE2/AVX2/NEON variants produce bit-identical
+ * results and are selected once at runtime by ni_ai_get_conv_kernels().
+ */
+typedef struct _ni_ai_conv_param
+{
+    // dequantization: fp32 = ((float)q - zero_point) * scale
+    float scale;
+    float zero_point;
+    // quantization: q = rint(clamp(fp32 / divisor, lo, hi)) + zp
+    float divisor;
+    float lo;
+    float hi;
+    int32_t zp;
+} ni_ai_conv_param_t;
+
+typedef void (*ni_ai_conv_fn)(const void *src, void *dst, uint32_t num,
+                              const ni_ai_conv_param_t *p);
+
+typedef struct _ni_ai_conv_kernels
+{
+    const char *name;
+    ni_ai_conv_fn s8_to_fp32;
+    ni_ai_conv_fn u8_to_fp32;
+    ni_ai_conv_fn s16_to_fp32;
+    ni_ai_conv_fn fp16_to_fp32;
+    ni_ai_conv_fn bf16_to_fp32;
+    ni_ai_conv_fn fp32_to_s8;
+    ni_ai_conv_fn fp32_to_u8;
+    ni_ai_conv_fn fp32_to_s16;
+    ni_ai_conv_fn fp32_to_fp16;
+    ni_ai_conv_fn fp32_to_bf16;
+} ni_ai_conv_kernels_t;
+
+static float ni_ai_dfp_scale(signed char fixed_point_pos)
+{
+    if (fixed_point_pos > 0)
+    {
+        return 1.0f / ((float)(1 << fixed_point_pos));
+    }
+
+    return (float)(1 << -fixed_point_pos);
+}
+
+static inline int32_t ni_ai_quantize(float in, const ni_ai_conv_param_t *p)
+{
+    float v = in / p->divisor;
+
+    // NaN ends up at the low end of the range, same as the vector kernels
+    v = (v > p->lo) ? v : p->lo;
+    v = (v < p->hi) ? v : p->hi;
+    return (int32_t)ni_ai_rint(v) + p->zp;
+}
+
+static void ni_ai_s8_to_fp32_c(const void *src, void *dst, uint32_t num,
+                               const ni_ai_conv_param_t *p)
+{
+    const int8_t *s = (const int8_t *)src;
+    float *d = (float *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ((float)s[i] - p->zero_point) * p->scale;
+    }
+}
+
+static void ni_ai_u8_to_fp32_c(const void *src, void *dst, uint32_t num,
+                               const ni_ai_conv_param_t *p)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    float *d = (float *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ((float)s[i] - p->zero_point) * p->scale;
+    }
+}
+
+static void ni_ai_s16_to_fp32_c(const void *src, void *dst, uint32_t num,
+                                const ni_ai_conv_param_t *p)
+{
+    const int16_t *s = (const int16_t *)src;
+    float *d = (float *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ((float)s[i] - p->zero_point) * p->scale;
+    }
+}
+
+static void ni_ai_fp16_to_fp32_c(const void *src, void *dst, uint32_t num,
+                                 const ni_ai_conv_param_t *p)
+{
+    const int16_t *s = (const int16_t *)src;
+    float *d = (float *)dst;
+    uint32_t i;
+
+    (void)p;
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ni_ai_fp16_to_fp32(s[i]);
+    }
+}
+
+static void ni_ai_bf16_to_fp32_c(const void *src, void *dst, uint32_t num,
+                                 const ni_ai_conv_param_t *p)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    uint32_t *d = (uint32_t *)dst;
+    uint32_t i;
+
+    (void)p;
+    for (i = 0; i < num; i++)
+    {
+        d[i] = (uint32_t)s[i] << 16;
+    }
+}
+
+static void ni_ai_fp32_to_s8_c(const void *src, void *dst, uint32_t num,
+                               const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int8_t *d = (int8_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = (int8_t)ni_ai_quantize(s[i], p);
+    }
+}
+
+static void ni_ai_fp32_to_u8_c(const void *src, void *dst, uint32_t num,
+                               const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint8_t *d = (uint8_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = (uint8_t)ni_ai_quantize(s[i], p);
+    }
+}
+
+static void ni_ai_fp32_to_s16_c(const void *src, void *dst, uint32_t num,
+                                const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int16_t *d = (int16_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        d[i] = (int16_t)ni_ai_quantize(s[i], p);
+    }
+}
+
+static void ni_ai_fp32_to_fp16_c(const void *src, void *dst, uint32_t num,
+                                 const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
+
+    (void)p;
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ni_ai_fp32_to_fp16(s[i]);
+    }
+}
+
+static void ni_ai_fp32_to_bf16_c(const void *src, void *dst, uint32_t num,
+                                 const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
+
+    (void)p;
+    for (i = 0; i < num; i++)
+    {
+        d[i] = ni_ai_fp32_to_bfp16_rtne(s[i]);
+    }
+}
+
+static const ni_ai_conv_kernels_t g_ai_conv_kernels_c = {
+    "c",
+    ni_ai_s8_to_fp32_c,   ni_ai_u8_to_fp32_c,   ni_ai_s16_to_fp32_c,
+    ni_ai_fp16_to_fp32_c, ni_ai_bf16_to_fp32_c, ni_ai_fp32_to_s8_c,
+    ni_ai_fp32_to_u8_c,   ni_ai_fp32_to_s16_c,  ni_ai_fp32_to_fp16_c,
+    ni_ai_fp32_to_bf16_c,
+};
+
+#ifdef NI_UTIL_SSE2
+static inline void ni_ai_dequant_store_sse2(float *d, __m128i v, __m128 zp,
+                                            __m128 scale)
+{
+    _mm_storeu_ps(d, _mm_mul_ps(_mm_sub_ps(_mm_cvtepi32_ps(v), zp), scale));
+}
+
+static inline __m128i ni_ai_quant_sse2(const float *s, __m128 div, __m128 lo,
+                                       __m128 hi, __m128i zp)
+{
+    __m128 v = _mm_div_ps(_mm_loadu_ps(s), div);
+
+    // maxps returns its second operand for NaN, clamping it to lo
+    v = _mm_min_ps(_mm_max_ps(v, lo), hi);
+    return _mm_add_epi32(_mm_cvtps_epi32(v), zp);
+}
+
+// pack the low 16 bits of every 32 bit lane of a and b
+static inline __m128i ni_ai_pack_u16_sse2(__m128i a, __m128i b)
+{
+    a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+    b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+    return _mm_packs_epi32(a, b);
+}
+
+static void ni_ai_s8_to_fp32_sse2(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const int8_t *s = (const int8_t *)src;
+    float *d = (float *)dst;
+    const __m128 zp = _mm_set1_ps(p->zero_point);
+    const __m128 scale = _mm_set1_ps(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8);
+        __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8);
+
+        ni_ai_dequant_store_sse2(
+            d + i, _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16), zp, scale);
+        ni_ai_dequant_store_sse2(
+            d + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16), zp,
+            scale);
+        ni_ai_dequant_store_sse2(
+            d + i + 8, _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16), zp,
+            scale);
+        ni_ai_dequant_store_sse2(
+            d + i + 12, _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16), zp,
+            scale);
+    }
+    ni_ai_s8_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_u8_to_fp32_sse2(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    float *d = (float *)dst;
+    const __m128 zp = _mm_set1_ps(p->zero_point);
+    const __m128 scale = _mm_set1_ps(p->scale);
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i lo = _mm_unpacklo_epi8(b, zero);
+        __m128i hi = _mm_unpackhi_epi8(b, zero);
+
+        ni_ai_dequant_store_sse2(d + i, _mm_unpacklo_epi16(lo, zero), zp,
+                                 scale);
+        ni_ai_dequant_store_sse2(d + i + 4, _mm_unpackhi_epi16(lo, zero), zp,
+                                 scale);
+        ni_ai_dequant_store_sse2(d + i + 8, _mm_unpacklo_epi16(hi, zero), zp,
+                                 scale);
+        ni_ai_dequant_store_sse2(d + i + 12, _mm_unpackhi_epi16(hi, zero), zp,
+                                 scale);
+    }
+    ni_ai_u8_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_s16_to_fp32_sse2(const void *src, void *dst, uint32_t num,
+                                   const ni_ai_conv_param_t *p)
+{
+    const int16_t *s = (const int16_t *)src;
+    float *d = (float *)dst;
+    const __m128 zp = _mm_set1_ps(p->zero_point);
+    const __m128 scale = _mm_set1_ps(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        __m128i w = _mm_loadu_si128((const __m128i *)(s + i));
+
+        ni_ai_dequant_store_sse2(
+            d + i, _mm_srai_epi32(_mm_unpacklo_epi16(w, w), 16), zp, scale);
+        ni_ai_dequant_store_sse2(
+            d + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(w, w), 16), zp,
+            scale);
+    }
+    ni_ai_s16_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static inline __m128i ni_ai_fp16x4_to_fp32_sse2(__m128i h)
+{
+    const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+    const __m128 infnan = _mm_castsi128_ps(_mm_set1_epi32((127 + 16) << 23));
+    __m128i o = _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x7fff)), 13);
+    __m128 f = _mm_mul_ps(_mm_castsi128_ps(o), magic);
+    __m128i inf = _mm_castps_si128(_mm_cmpge_ps(f, infnan));
+
+    o = _mm_or_si128(_mm_castps_si128(f),
+                     _mm_and_si128(inf, _mm_set1_epi32(255 << 23)));
+    return _mm_or_si128(
+        o, _mm_slli_epi32(_mm_and_si128(h, _mm_set1_epi32(0x8000)), 16));
+}
+
+static void ni_ai_fp16_to_fp32_sse2(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    float *d = (float *)dst;
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        __m128i h = _mm_loadu_si128((const __m128i *)(s + i));
+
+        _mm_storeu_si128((__m128i *)(d + i),
+                         ni_ai_fp16x4_to_fp32_sse2(_mm_unpacklo_epi16(h, zero)));
+        _mm_storeu_si128((__m128i *)(d + i + 4),
+                         ni_ai_fp16x4_to_fp32_sse2(_mm_unpackhi_epi16(h, zero)));
+    }
+    ni_ai_fp16_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_bf16_to_fp32_sse2(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    float *d = (float *)dst;
+    const __m128i zero = _mm_setzero_si128();
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        __m128i h = _mm_loadu_si128((const __m128i *)(s + i));
+
+        _mm_storeu_si128((__m128i *)(d + i), _mm_unpacklo_epi16(zero, h));
+        _mm_storeu_si128((__m128i *)(d + i + 4), _mm_unpackhi_epi16(zero, h));
+    }
+    ni_ai_bf16_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_fp32_to_s8_sse2(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int8_t *d = (int8_t *)dst;
+    const __m128 div = _mm_set1_ps(p->divisor);
+    const __m128 lo = _mm_set1_ps(p->lo);
+    const __m128 hi = _mm_set1_ps(p->hi);
+    const __m128i zp = _mm_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i w0 = _mm_packs_epi32(ni_ai_quant_sse2(s + i, div, lo, hi, zp),
+                                     ni_ai_quant_sse2(s + i + 4, div, lo, hi, zp));
+        __m128i w1 = _mm_packs_epi32(ni_ai_quant_sse2(s + i + 8, div, lo, hi, zp),
+                                     ni_ai_quant_sse2(s + i + 12, div, lo, hi, zp));
+
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packs_epi16(w0, w1));
+    }
+    ni_ai_fp32_to_s8_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_fp32_to_u8_sse2(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint8_t *d = (uint8_t *)dst;
+    const __m128 div = _mm_set1_ps(p->divisor);
+    const __m128 lo = _mm_set1_ps(p->lo);
+    const __m128 hi = _mm_set1_ps(p->hi);
+    const __m128i zp = _mm_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i w0 = _mm_packs_epi32(ni_ai_quant_sse2(s + i, div, lo, hi, zp),
+                                     ni_ai_quant_sse2(s + i + 4, div, lo, hi, zp));
+        __m128i w1 = _mm_packs_epi32(ni_ai_quant_sse2(s + i + 8, div, lo, hi, zp),
+                                     ni_ai_quant_sse2(s + i + 12, div, lo, hi, zp));
+
+        _mm_storeu_si128((__m128i *)(d + i), _mm_packus_epi16(w0, w1));
+    }
+    ni_ai_fp32_to_u8_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_fp32_to_s16_sse2(const void *src, void *dst, uint32_t num,
+                                   const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int16_t *d = (int16_t *)dst;
+    const __m128 div = _mm_set1_ps(p->divisor);
+    const __m128 lo = _mm_set1_ps(p->lo);
+    const __m128 hi = _mm_set1_ps(p->hi);
+    const __m128i zp = _mm_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        _mm_storeu_si128(
+            (__m128i *)(d + i),
+            _mm_packs_epi32(ni_ai_quant_sse2(s + i, div, lo, hi, zp),
+                            ni_ai_quant_sse2(s + i + 4, div, lo, hi, zp)));
+    }
+    ni_ai_fp32_to_s16_c(s + i, d + i, num - i, p);
+}
+
+static inline __m128i ni_ai_fp32x4_to_fp16_sse2(const float *s)
+{
+    __m128i b = _mm_castps_si128(_mm_loadu_ps(s));
+    __m128i t1 = _mm_srli_epi32(
+        _mm_and_si128(b, _mm_set1_epi32((int)0x80000000u)), 16);
+    __m128i t2 = _mm_srli_epi32(_mm_and_si128(b, _mm_set1_epi32(0x7F800000)),
+                                13);
+    __m128i t3 = _mm_srli_epi32(_mm_and_si128(b, _mm_set1_epi32(0x007FE000)),
+                                13);
+    // t2 >= 0x023c00: saturate to max half instead of rounding to infinity
+    __m128i big = _mm_cmpgt_epi32(t2, _mm_set1_epi32(0x023bff));
+    // t2 <= 0x01c000: flush to signed zero
+    __m128i small = _mm_cmpgt_epi32(_mm_set1_epi32(0x01c001), t2);
+    __m128i norm =
+        _mm_or_si128(_mm_sub_epi32(t2, _mm_set1_epi32(0x01c000)), t3);
+
+    norm = _mm_andnot_si128(_mm_or_si128(big, small), norm);
+    norm = _mm_or_si128(norm, _mm_and_si128(big, _mm_set1_epi32(0x7BFF)));
+    return _mm_or_si128(t1, norm);
+}
+
+static void ni_ai_fp32_to_fp16_sse2(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)(d + i),
+                         ni_ai_pack_u16_sse2(ni_ai_fp32x4_to_fp16_sse2(s + i),
+                                             ni_ai_fp32x4_to_fp16_sse2(s + i + 4)));
+    }
+    ni_ai_fp32_to_fp16_c(s + i, d + i, num - i, p);
+}
+
+static inline __m128i ni_ai_fp32x4_to_bf16_sse2(const float *s)
+{
+    __m128i b = _mm_castps_si128(_mm_loadu_ps(s));
+    __m128i lsb = _mm_and_si128(_mm_srli_epi32(b, 16), _mm_set1_epi32(1));
+    __m128i r = _mm_srli_epi32(
+        _mm_add_epi32(b, _mm_add_epi32(lsb, _mm_set1_epi32(0x7fff))), 16);
+    __m128i nan = _mm_cmpgt_epi32(
+        _mm_and_si128(b, _mm_set1_epi32(0x7fffffff)),
+        _mm_set1_epi32(0x7f800000));
+
+    return _mm_or_si128(_mm_andnot_si128(nan, r),
+                        _mm_and_si128(nan, _mm_set1_epi32(0x7fc0)));
+}
+
+static void ni_ai_fp32_to_bf16_sse2(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)(d + i),
+                         ni_ai_pack_u16_sse2(ni_ai_fp32x4_to_bf16_sse2(s + i),
+                                             ni_ai_fp32x4_to_bf16_sse2(s + i + 4)));
+    }
+    ni_ai_fp32_to_bf16_c(s + i, d + i, num - i, p);
+}
+
+static const ni_ai_conv_kernels_t g_ai_conv_kernels_sse2 = {
+    "sse2",
+    ni_ai_s8_to_fp32_sse2,   ni_ai_u8_to_fp32_sse2,   ni_ai_s16_to_fp32_sse2,
+    ni_ai_fp16_to_fp32_sse2, ni_ai_bf16_to_fp32_sse2, ni_ai_fp32_to_s8_sse2,
+    ni_ai_fp32_to_u8_sse2,   ni_ai_fp32_to_s16_sse2,  ni_ai_fp32_to_fp16_sse2,
+    ni_ai_fp32_to_bf16_sse2,
+};
+#endif
+
+#ifdef NI_UTIL_AVX2
+NI_UTIL_TARGET_AVX2 static inline void
+ni_ai_dequant_store_avx2(float *d, __m256i v, __m256 zp, __m256 scale)
+{
+    _mm256_storeu_ps(
+        d, _mm256_mul_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(v), zp), scale));
+}
+
+NI_UTIL_TARGET_AVX2 static inline __m128i
+ni_ai_quant_avx2(const float *s, __m256 div, __m256 lo, __m256 hi, __m256i zp)
+{
+    __m256 v = _mm256_div_ps(_mm256_loadu_ps(s), div);
+    __m256i q;
+
+    v = _mm256_min_ps(_mm256_max_ps(v, lo), hi);
+    q = _mm256_add_epi32(_mm256_cvtps_epi32(v), zp);
+    return _mm_packs_epi32(_mm256_castsi256_si128(q),
+                           _mm256_extracti128_si256(q, 1));
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_ai_s8_to_fp32_avx2(const void *src,
+                                                    void *dst, uint32_t num,
+                                                    const ni_ai_conv_param_t *p)
+{
+    const int8_t *s = (const int8_t *)src;
+    float *d = (float *)dst;
+    const __m256 zp = _mm256_set1_ps(p->zero_point);
+    const __m256 scale = _mm256_set1_ps(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+
+        ni_ai_dequant_store_avx2(d + i, _mm256_cvtepi8_epi32(b), zp, scale);
+        ni_ai_dequant_store_avx2(d + i + 8,
+                                 _mm256_cvtepi8_epi32(_mm_srli_si128(b, 8)),
+                                 zp, scale);
     }
+    ni_ai_s8_to_fp32_c(s + i, d + i, num - i, p);
+}
 
-    return ret;
+NI_UTIL_TARGET_AVX2 static void ni_ai_u8_to_fp32_avx2(const void *src,
+                                                    void *dst, uint32_t num,
+                                                    const ni_ai_conv_param_t *p)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    float *d = (float *)dst;
+    const __m256 zp = _mm256_set1_ps(p->zero_point);
+    const __m256 scale = _mm256_set1_ps(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
+    {
+        __m128i b = _mm_loadu_si128((const __m128i *)(s + i));
+
+        ni_ai_dequant_store_avx2(d + i, _mm256_cvtepu8_epi32(b), zp, scale);
+        ni_ai_dequant_store_avx2(d + i + 8,
+                                 _mm256_cvtepu8_epi32(_mm_srli_si128(b, 8)),
+                                 zp, scale);
+    }
+    ni_ai_u8_to_fp32_c(s + i, d + i, num - i, p);
 }
 
-static void ni_ai_type_get_range(int32_t type, double *max_range,
-                                 double *min_range)
+NI_UTIL_TARGET_AVX2 static void
+ni_ai_s16_to_fp32_avx2(const void *src, void *dst, uint32_t num,
+                       const ni_ai_conv_param_t *p)
 {
-    int32_t bits;
-    double from, to;
-    from = 0.0;
-    to = 0.0;
-    bits = ni_ai_type_get_bytes(type) * 8;
-    if (ni_ai_type_is_integer(type))
+    const int16_t *s = (const int16_t *)src;
+    float *d = (float *)dst;
+    const __m256 zp = _mm256_set1_ps(p->zero_point);
+    const __m256 scale = _mm256_set1_ps(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
     {
-        if (ni_ai_type_is_signed(type))
-        {
-            from = (double)(-(1L << (bits - 1)));
-            to = (double)((1UL << (bits - 1)) - 1);
-        } else
-        {
-            from = 0.0;
-            to = (double)((1UL << bits) - 1);
-        }
+        __m128i w = _mm_loadu_si128((const __m128i *)(s + i));
+
+        ni_ai_dequant_store_avx2(d + i, _mm256_cvtepi16_epi32(w), zp, scale);
     }
-    if (NULL != max_range)
+    ni_ai_s16_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_ai_fp32_to_s8_avx2(const void *src,
+                                                    void *dst, uint32_t num,
+                                                    const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int8_t *d = (int8_t *)dst;
+    const __m256 div = _mm256_set1_ps(p->divisor);
+    const __m256 lo = _mm256_set1_ps(p->lo);
+    const __m256 hi = _mm256_set1_ps(p->hi);
+    const __m256i zp = _mm256_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
     {
-        *max_range = to;
+        _mm_storeu_si128(
+            (__m128i *)(d + i),
+            _mm_packs_epi16(ni_ai_quant_avx2(s + i, div, lo, hi, zp),
+                            ni_ai_quant_avx2(s + i + 8, div, lo, hi, zp)));
     }
-    if (NULL != min_range)
+    ni_ai_fp32_to_s8_c(s + i, d + i, num - i, p);
+}
+
+NI_UTIL_TARGET_AVX2 static void ni_ai_fp32_to_u8_avx2(const void *src,
+                                                    void *dst, uint32_t num,
+                                                    const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint8_t *d = (uint8_t *)dst;
+    const __m256 div = _mm256_set1_ps(p->divisor);
+    const __m256 lo = _mm256_set1_ps(p->lo);
+    const __m256 hi = _mm256_set1_ps(p->hi);
+    const __m256i zp = _mm256_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 16 <= num; i += 16)
     {
-        *min_range = from;
+        _mm_storeu_si128(
+            (__m128i *)(d + i),
+            _mm_packus_epi16(ni_ai_quant_avx2(s + i, div, lo, hi, zp),
+                             ni_ai_quant_avx2(s + i + 8, div, lo, hi, zp)));
     }
+    ni_ai_fp32_to_u8_c(s + i, d + i, num - i, p);
 }
 
-static inline double ni_abs(double x)
+NI_UTIL_TARGET_AVX2 static void
+ni_ai_fp32_to_s16_avx2(const void *src, void *dst, uint32_t num,
+                       const ni_ai_conv_param_t *p)
 {
-    return x < 0 ? -x : x;
+    const float *s = (const float *)src;
+    int16_t *d = (int16_t *)dst;
+    const __m256 div = _mm256_set1_ps(p->divisor);
+    const __m256 lo = _mm256_set1_ps(p->lo);
+    const __m256 hi = _mm256_set1_ps(p->hi);
+    const __m256i zp = _mm256_set1_epi32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        _mm_storeu_si128((__m128i *)(d + i),
+                         ni_ai_quant_avx2(s + i, div, lo, hi, zp));
+    }
+    ni_ai_fp32_to_s16_c(s + i, d + i, num - i, p);
 }
 
-static double ni_ai_copy_sign(double number, double sign)
+// half and bfloat conversions are bound by memory, SSE2 is kept for them
+static const ni_ai_conv_kernels_t g_ai_conv_kernels_avx2 = {
+    "avx2",
+    ni_ai_s8_to_fp32_avx2,   ni_ai_u8_to_fp32_avx2,   ni_ai_s16_to_fp32_avx2,
+    ni_ai_fp16_to_fp32_sse2, ni_ai_bf16_to_fp32_sse2, ni_ai_fp32_to_s8_avx2,
+    ni_ai_fp32_to_u8_avx2,   ni_ai_fp32_to_s16_avx2,  ni_ai_fp32_to_fp16_sse2,
+    ni_ai_fp32_to_bf16_sse2,
+};
+#endif
+
+#ifdef NI_UTIL_NEON
+static inline void ni_ai_dequant_store_neon(float *d, int32x4_t v,
+                                            float32x4_t zp, float32x4_t scale)
 {
-    double value = ni_abs(number);
-    return (sign > 0) ? value : (-value);
+    vst1q_f32(d, vmulq_f32(vsubq_f32(vcvtq_f32_s32(v), zp), scale));
 }
 
-static inline int ni_ai_math_floorf(double x)
+static inline int32x4_t ni_ai_quant_neon(const float *s, float32x4_t div,
+                                         float32x4_t lo, float32x4_t hi,
+                                         int32x4_t zp)
 {
-    return x >= 0 ? (int)x : (int)x - 1;
+    float32x4_t v = vdivq_f32(vld1q_f32(s), div);
+
+    // fmaxnm returns the number operand for NaN, clamping it to lo
+    v = vminnmq_f32(vmaxnmq_f32(v, lo), hi);
+    return vaddq_s32(vcvtnq_s32_f32(v), zp);
 }
 
-static double ni_ai_rint(double x)
+static void ni_ai_s8_to_fp32_neon(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
 {
-#define _EPSILON 1e-8
-    double decimal;
-    double inter;
-    int intpart;
+    const int8_t *s = (const int8_t *)src;
+    float *d = (float *)dst;
+    const float32x4_t zp = vdupq_n_f32(p->zero_point);
+    const float32x4_t scale = vdupq_n_f32(p->scale);
+    uint32_t i;
 
-    intpart = (int)x;
-    decimal = x - intpart;
-    inter = (double)intpart;
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        int16x8_t w = vmovl_s8(vld1_s8(s + i));
 
-    if (ni_abs((ni_abs(decimal) - 0.5f)) < _EPSILON)
+        ni_ai_dequant_store_neon(d + i, vmovl_s16(vget_low_s16(w)), zp, scale);
+        ni_ai_dequant_store_neon(d + i + 4, vmovl_s16(vget_high_s16(w)), zp,
+                                 scale);
+    }
+    ni_ai_s8_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_u8_to_fp32_neon(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const uint8_t *s = (const uint8_t *)src;
+    float *d = (float *)dst;
+    const float32x4_t zp = vdupq_n_f32(p->zero_point);
+    const float32x4_t scale = vdupq_n_f32(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
     {
-        inter += (int32_t)(inter) % 2;
-    } else
+        uint16x8_t w = vmovl_u8(vld1_u8(s + i));
+
+        ni_ai_dequant_store_neon(
+            d + i, vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(w))), zp,
+            scale);
+        ni_ai_dequant_store_neon(
+            d + i + 4, vreinterpretq_s32_u32(vmovl_u16(vget_high_u16(w))), zp,
+            scale);
+    }
+    ni_ai_u8_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_s16_to_fp32_neon(const void *src, void *dst, uint32_t num,
+                                   const ni_ai_conv_param_t *p)
+{
+    const int16_t *s = (const int16_t *)src;
+    float *d = (float *)dst;
+    const float32x4_t zp = vdupq_n_f32(p->zero_point);
+    const float32x4_t scale = vdupq_n_f32(p->scale);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
     {
-        return ni_ai_copy_sign(ni_ai_math_floorf(ni_abs(x) + 0.5f), x);
+        int16x8_t w = vld1q_s16(s + i);
+
+        ni_ai_dequant_store_neon(d + i, vmovl_s16(vget_low_s16(w)), zp, scale);
+        ni_ai_dequant_store_neon(d + i + 4, vmovl_s16(vget_high_s16(w)), zp,
+                                 scale);
     }
+    ni_ai_s16_to_fp32_c(s + i, d + i, num - i, p);
+}
 
-    return inter;
+static void ni_ai_fp16_to_fp32_neon(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const uint16_t *s = (const uint16_t *)src;
+    float *d = (float *)dst;
+    const float32x4_t magic = vreinterpretq_f32_u32(vdupq_n_u32((254 - 15) << 23));
+    const float32x4_t infnan = vreinterpretq_f32_u32(vdupq_n_u32((127 + 16) << 23));
+    uint32_t i;
+
+    // same bit manipulation as ni_ai_fp16_to_fp32() so NaN payloads match
+    for (i = 0; i + 4 <= num; i += 4)
+    {
+        uint32x4_t h = vmovl_u16(vld1_u16(s + i));
+        uint32x4_t o = vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x7fff)), 13);
+        float32x4_t f = vmulq_f32(vreinterpretq_f32_u32(o), magic);
+
+        o = vorrq_u32(vreinterpretq_u32_f32(f),
+                      vandq_u32(vcgeq_f32(f, infnan), vdupq_n_u32(255u << 23)));
+        o = vorrq_u32(o, vshlq_n_u32(vandq_u32(h, vdupq_n_u32(0x8000)), 16));
+        vst1q_u32((uint32_t *)(d + i), o);
+    }
+    ni_ai_fp16_to_fp32_c(s + i, d + i, num - i, p);
 }
 
-static int32_t ni_ai_fp32_to_dfp(const float in, const signed char fl,
-                                 const int32_t type)
+static void ni_ai_bf16_to_fp32_neon(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
 {
-    int32_t data;
-    double max_range;
-    double min_range;
-    ni_ai_type_get_range(type, &max_range, &min_range);
-    if (fl > 0)
+    const uint16_t *s = (const uint16_t *)src;
+    uint32_t *d = (uint32_t *)dst;
+    uint32_t i;
+
+    for (i = 0; i + 4 <= num; i += 4)
     {
-        data = (int32_t)ni_ai_rint(in * (float)(1 << fl));
-    } else
+        vst1q_u32(d + i, vshll_n_u16(vld1_u16(s + i), 16));
+    }
+    ni_ai_bf16_to_fp32_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_fp32_to_s8_neon(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    int8_t *d = (int8_t *)dst;
+    const float32x4_t div = vdupq_n_f32(p->divisor);
+    const float32x4_t lo = vdupq_n_f32(p->lo);
+    const float32x4_t hi = vdupq_n_f32(p->hi);
+    const int32x4_t zp = vdupq_n_s32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
     {
-        data = (int32_t)ni_ai_rint(in * (1.0f / (float)(1 << -fl)));
+        int16x8_t w =
+            vcombine_s16(vmovn_s32(ni_ai_quant_neon(s + i, div, lo, hi, zp)),
+                         vmovn_s32(ni_ai_quant_neon(s + i + 4, div, lo, hi, zp)));
+
+        vst1_s8(d + i, vmovn_s16(w));
     }
-    data = ni_min(data, (int32_t)max_range);
-    data = ni_max(data, (int32_t)min_range);
+    ni_ai_fp32_to_s8_c(s + i, d + i, num - i, p);
+}
 
-    return data;
+static void ni_ai_fp32_to_u8_neon(const void *src, void *dst, uint32_t num,
+                                  const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint8_t *d = (uint8_t *)dst;
+    const float32x4_t div = vdupq_n_f32(p->divisor);
+    const float32x4_t lo = vdupq_n_f32(p->lo);
+    const float32x4_t hi = vdupq_n_f32(p->hi);
+    const int32x4_t zp = vdupq_n_s32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 8 <= num; i += 8)
+    {
+        int16x8_t w =
+            vcombine_s16(vmovn_s32(ni_ai_quant_neon(s + i, div, lo, hi, zp)),
+                         vmovn_s32(ni_ai_quant_neon(s + i + 4, div, lo, hi, zp)));
+
+        vst1_u8(d + i, vmovn_u16(vreinterpretq_u16_s16(w)));
+    }
+    ni_ai_fp32_to_u8_c(s + i, d + i, num - i, p);
 }
 
-static int32_t ni_ai_fp32_to_affine(const float in, const float scale,
-                                    const int zero_point, const int32_t type)
+static void ni_ai_fp32_to_s16_neon(const void *src, void *dst, uint32_t num,
+                                   const ni_ai_conv_param_t *p)
 {
-    int32_t data;
-    double max_range;
-    double min_range;
-    ni_ai_type_get_range(type, &max_range, &min_range);
-    data = (int32_t)(ni_ai_rint(in / scale) + zero_point);
-    data = ni_max((int32_t)min_range, ni_min((int32_t)max_range, data));
-    return data;
+    const float *s = (const float *)src;
+    int16_t *d = (int16_t *)dst;
+    const float32x4_t div = vdupq_n_f32(p->divisor);
+    const float32x4_t lo = vdupq_n_f32(p->lo);
+    const float32x4_t hi = vdupq_n_f32(p->hi);
+    const int32x4_t zp = vdupq_n_s32(p->zp);
+    uint32_t i;
+
+    for (i = 0; i + 4 <= num; i += 4)
+    {
+        vst1_s16(d + i, vmovn_s32(ni_ai_quant_neon(s + i, div, lo, hi, zp)));
+    }
+    ni_ai_fp32_to_s16_c(s + i, d + i, num - i, p);
 }
 
-static unsigned short ni_ai_fp32_to_bfp16_rtne(float in)
+static void ni_ai_fp32_to_fp16_neon(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
 {
-    /*
-    Convert a float point to bfloat16, with round-nearest-to-even as rounding method.
-    */
-    unsigned short out;
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
 
-    uint32_t fp32;
-    memcpy(&fp32, &in, sizeof(uint32_t));
+    for (i = 0; i + 4 <= num; i += 4)
+    {
+        uint32x4_t b = vreinterpretq_u32_f32(vld1q_f32(s + i));
+        uint32x4_t t1 =
+            vshrq_n_u32(vandq_u32(b, vdupq_n_u32(0x80000000u)), 16);
+        uint32x4_t t2 = vshrq_n_u32(vandq_u32(b, vdupq_n_u32(0x7F800000)), 13);
+        uint32x4_t t3 = vshrq_n_u32(vandq_u32(b, vdupq_n_u32(0x007FE000)), 13);
+        uint32x4_t r = vorrq_u32(vsubq_u32(t2, vdupq_n_u32(0x01c000)), t3);
 
-    uint32_t lsb =
-        (fp32 >> 16) & 1; /* Least significant bit of resulting bfloat. */
-    uint32_t rounding_bias = 0x7fff + lsb;
+        r = vbslq_u32(vcleq_u32(t2, vdupq_n_u32(0x01c000)), vdupq_n_u32(0), r);
+        r = vbslq_u32(vcgeq_u32(t2, vdupq_n_u32(0x023c00)),
+                      vdupq_n_u32(0x7BFF), r);
+        vst1_u16(d + i, vmovn_u32(vorrq_u32(t1, r)));
+    }
+    ni_ai_fp32_to_fp16_c(s + i, d + i, num - i, p);
+}
+
+static void ni_ai_fp32_to_bf16_neon(const void *src, void *dst, uint32_t num,
+                                    const ni_ai_conv_param_t *p)
+{
+    const float *s = (const float *)src;
+    uint16_t *d = (uint16_t *)dst;
+    uint32_t i;
 
-    if ((float)0x7FC00000 == in)
+    for (i = 0; i + 4 <= num; i += 4)
     {
-        out = 0x7fc0;
-    } else
+        uint32x4_t b = vreinterpretq_u32_f32(vld1q_f32(s + i));
+        uint32x4_t lsb = vandq_u32(vshrq_n_u32(b, 16), vdupq_n_u32(1));
+        uint32x4_t r = vshrq_n_u32(
+            vaddq_u32(b, vaddq_u32(lsb, vdupq_n_u32(0x7fff))), 16);
+        uint32x4_t nan = vcgtq_u32(vandq_u32(b, vdupq_n_u32(0x7fffffff)),
+                                   vdupq_n_u32(0x7f800000));
+
+        r = vbslq_u32(nan, vdupq_n_u32(0x7fc0), r);
+        vst1_u16(d + i, vmovn_u32(r));
+    }
+    ni_ai_fp32_to_bf16_c(s + i, d + i, num - i, p);
+}
+
+static const ni_ai_conv_kernels_t g_ai_conv_kernels_neon = {
+    "neon",
+    ni_ai_s8_to_fp32_neon,   ni_ai_u8_to_fp32_neon,   ni_ai_s16_to_fp32_neon,
+    ni_ai_fp16_to_fp32_neon, ni_ai_bf16_to_fp32_neon, ni_ai_fp32_to_s8_neon,
+    ni_ai_fp32_to_u8_neon,   ni_ai_fp32_to_s16_neon,  ni_ai_fp32_to_fp16_neon,
+    ni_ai_fp32_to_bf16_neon,
+};
+#endif
+
+static const ni_ai_conv_kernels_t *volatile g_ai_conv_kernels = NULL;
+static volatile int g_ai_conv_threads = 1;
+
+/*!*****************************************************************************
+ *  \brief  Pick the fastest conversion kernels supported by the running CPU.
+ *          Selection is idempotent, so racing first callers are harmless.
+ ******************************************************************************/
+static const ni_ai_conv_kernels_t *ni_ai_get_conv_kernels(void)
+{
+    const ni_ai_conv_kernels_t *p_kernels = g_ai_conv_kernels;
+
+    if (p_kernels)
     {
-        fp32 += rounding_bias;
-        out = (unsigned short)(fp32 >> 16);
+        return p_kernels;
     }
 
-    return out;
+    p_kernels = &g_ai_conv_kernels_c;
+#ifdef NI_UTIL_SSE2
+    p_kernels = &g_ai_conv_kernels_sse2;
+#endif
+#ifdef NI_UTIL_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        p_kernels = &g_ai_conv_kernels_avx2;
+    }
+#endif
+#ifdef NI_UTIL_NEON
+    p_kernels = &g_ai_conv_kernels_neon;
+#endif
+    ni_log(NI_LOG_DEBUG, "%s: using %s tensor conversion kernels\n", __func__,
+           p_kernels->name);
+    g_ai_conv_kernels = p_kernels;
+    return p_kernels;
 }
 
-static unsigned short ni_ai_fp32_to_fp16(float in)
+typedef struct _ni_ai_conv_job
 {
-    uint32_t fp32 = 0;
-    uint32_t t1 = 0;
-    uint32_t t2 = 0;
-    uint32_t t3 = 0;
-    uint32_t fp16 = 0u;
+    ni_ai_conv_fn fn;
+    const uint8_t *src;
+    uint8_t *dst;
+    uint32_t num;
+    const ni_ai_conv_param_t *p;
+} ni_ai_conv_job_t;
 
-    memcpy((uint8_t *)&fp32, (uint8_t *)&in, sizeof(uint32_t));
+static void *ni_ai_conv_job_run(void *arg)
+{
+    ni_ai_conv_job_t *job = (ni_ai_conv_job_t *)arg;
 
-    t1 = (fp32 & 0x80000000u) >> 16; /* sign bit. */
-    t2 = (fp32 & 0x7F800000u) >> 13; /* Exponent bits */
-    t3 = (fp32 & 0x007FE000u) >> 13; /* Mantissa bits, no rounding */
+    job->fn(job->src, job->dst, job->num, job->p);
+    return NULL;
+}
 
-    if (t2 >= 0x023c00u)
+/*!*****************************************************************************
+ *  \brief  Run a conversion kernel over num elements, splitting the range
+ *          over up to ni_network_set_convert_threads() threads when the
+ *          tensor is large enough to amortize thread creation.
+ ******************************************************************************/
+static void ni_ai_convert(ni_ai_conv_fn fn, const void *src, uint32_t src_size,
+                          void *dst, uint32_t dst_size, uint32_t num,
+                          const ni_ai_conv_param_t *p)
+{
+    ni_ai_conv_job_t jobs[NI_AI_CONVERT_MAX_THREADS];
+    ni_pthread_t threads[NI_AI_CONVERT_MAX_THREADS];
+    int started[NI_AI_CONVERT_MAX_THREADS];
+    uint32_t nb_threads = (uint32_t)g_ai_conv_threads;
+    uint32_t chunk, offset;
+    uint32_t i;
+
+    if (num / NI_AI_CONVERT_MT_MIN_ELEMENTS < nb_threads)
     {
-        fp16 = t1 | 0x7BFF; /* Don't round to infinity. */
-    } else if (t2 <= 0x01c000u)
+        nb_threads = num / NI_AI_CONVERT_MT_MIN_ELEMENTS;
+    }
+
+    if (nb_threads <= 1)
     {
-        fp16 = t1;
-    } else
+        fn(src, dst, num, p);
+        return;
+    }
+
+    // keep every chunk a multiple of 64 elements so no thread shares a
+    // cache line of the destination with its neighbour
+    chunk = ((num + nb_threads - 1) / nb_threads + 63) & ~63u;
+    for (i = 0, offset = 0; i < nb_threads; i++, offset += chunk)
     {
-        t2 -= 0x01c000u;
-        fp16 = t1 | t2 | t3;
+        jobs[i].fn = fn;
+        jobs[i].src = (const uint8_t *)src + (size_t)offset * src_size;
+        jobs[i].dst = (uint8_t *)dst + (size_t)offset * dst_size;
+        jobs[i].num = (offset < num) ? ni_min(chunk, num - offset) : 0;
+        jobs[i].p = p;
+        started[i] = 0;
     }
 
-    return (unsigned short)fp16;
-}
+    for (i = 1; i < nb_threads; i++)
+    {
+        if (jobs[i].num &&
+            ni_pthread_create(&threads[i], NULL, ni_ai_conv_job_run,
+                              &jobs[i]) == 0)
+        {
+            started[i] = 1;
+        }
+    }
 
-static void ni_ai_float32_to_dtype(float src, unsigned char *dst,
-                                   const int32_t data_type,
-                                   const int32_t quant_format,
-                                   signed char fixed_point_pos, float tf_scale,
-                                   int32_t tf_zerop)
-{
-    switch (data_type)
+    ni_ai_conv_job_run(&jobs[0]);
+
+    for (i = 1; i < nb_threads; i++)
     {
-        case NI_AI_BUFFER_FORMAT_FP32:
-        memcpy(dst, &src, sizeof(float));
-            break;
-        case NI_AI_BUFFER_FORMAT_FP16:
-            *(int16_t *)dst = ni_ai_fp32_to_fp16(src);
-            break;
-        case NI_AI_BUFFER_FORMAT_BFP16:
-            *(int16_t *)dst = ni_ai_fp32_to_bfp16_rtne(src);
-            break;
-        case NI_AI_BUFFER_FORMAT_INT8:
-        case NI_AI_BUFFER_FORMAT_UINT8:
-        case NI_AI_BUFFER_FORMAT_INT16:
+        if (started[i])
         {
-            int32_t dst_value = 0;
-            switch (quant_format)
-            {
-                case NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT:
-                    dst_value =
-                        ni_ai_fp32_to_dfp(src, fixed_point_pos, data_type);
-                    break;
-                case NI_AI_BUFFER_QUANTIZE_TF_ASYMM:
-                    dst_value = ni_ai_fp32_to_affine(src, tf_scale, tf_zerop,
-                                                     data_type);
-                    break;
-                case NI_AI_BUFFER_QUANTIZE_NONE:
-                    dst_value = (int32_t)src;
-                    break;
-                default:
-                    break;
-            }
-            ni_ai_integer_convert(&dst_value, dst, NI_AI_BUFFER_FORMAT_INT32,
-                                  data_type);
+            ni_pthread_join(threads[i], NULL);
+        } else if (jobs[i].num)
+        {
+            ni_ai_conv_job_run(&jobs[i]);
         }
-        break;
-        default:;
     }
 }
 
+void ni_network_set_convert_threads(int nb_threads)
+{
+    if (nb_threads < 1)
+    {
+        nb_threads = 1;
+    } else if (nb_threads > NI_AI_CONVERT_MAX_THREADS)
+    {
+        nb_threads = NI_AI_CONVERT_MAX_THREADS;
+    }
+    g_ai_conv_threads = nb_threads;
+}
+
 ni_retcode_t ni_network_layer_convert_output(float *dst, uint32_t dst_len,
                                              ni_packet_t *p_packet,
                                              ni_network_data_t *p_network,
@@ -3731,92 +6417,190 @@ ni_retcode_t ni_network_layer_convert_output(float *dst, uint32_t dst_len,
                                              p_param);
 }
 
-struct tensor_rsrc
+// fp32 elements loaded from a tensor file
+typedef struct _ni_ai_tensor_src
 {
-    void *private;
-    uint32_t total_num;
-    uint32_t next_idx;
-};
+    const float *data;
+    uint32_t num;
+    void *buf;      // heap copy: text files, or no mmap on this platform
+    void *map;      // mapping of a binary tensor file
+    size_t map_len;
+} ni_ai_tensor_src_t;
 
-static int open_tensor_rsrc_file(struct tensor_rsrc *rsrc, void *data,
-                                 uint32_t num)
+static void ni_ai_tensor_file_close(ni_ai_tensor_src_t *t)
 {
-    FILE *f = NULL;
-    ni_fopen(&f, (const char *)data, "r");
-    rsrc->private = (void *)f;
-    return rsrc->private ? 0 : -1;
+#if __linux__ || __APPLE__
+    if (t->map)
+    {
+        munmap(t->map, t->map_len);
+    }
+#endif
+    free(t->buf);
+    memset(t, 0, sizeof(*t));
 }
 
-static int get_tensor_rsrc_from_file(struct tensor_rsrc *rsrc, float *value)
+static ni_retcode_t ni_ai_tensor_file_load_binary(ni_ai_tensor_src_t *t,
+                                                  FILE *fp, size_t file_len,
+                                                  const char *path)
 {
-    FILE *fp = (FILE *)rsrc->private;
-    float tensor;
+    ni_ai_tensor_file_header_t hdr;
+    uint64_t payload_end;
 
-    if (ni_fscanf(fp, "%f ", &tensor) == 1)
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1)
     {
-        *value = tensor;
-        return 0;
+        return NI_RETCODE_FAILURE;
     }
 
-    return -1;
-}
+    payload_end = (uint64_t)hdr.data_offset +
+        (uint64_t)hdr.num_elements * sizeof(float);
+    if (hdr.version != NI_AI_TENSOR_FILE_VERSION ||
+        hdr.data_format != NI_AI_BUFFER_FORMAT_FP32 ||
+        hdr.data_offset < sizeof(hdr) || (hdr.data_offset % sizeof(float)) ||
+        payload_end > file_len)
+    {
+        ni_log(NI_LOG_ERROR,
+               "ERROR: %s() %s: bad tensor file header, version %u format %u "
+               "offset %u num %u size %zu\n",
+               __func__, path, hdr.version, hdr.data_format, hdr.data_offset,
+               hdr.num_elements, file_len);
+        return NI_RETCODE_INVALID_PARAM;
+    }
 
-static void close_tensor_rsrc_file(struct tensor_rsrc *rsrc)
-{
-    FILE *fp = (FILE *)rsrc->private;
-    fclose(fp);
+#if __linux__ || __APPLE__
+    t->map_len = (size_t)payload_end;
+    t->map = mmap(NULL, t->map_len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (t->map == MAP_FAILED)
+    {
+        t->map = NULL;
+        ni_log(NI_LOG_ERROR, "ERROR: %s() mmap %s failed, errno %d\n",
+               __func__, path, NI_ERRNO);
+        return NI_RETCODE_FAILURE;
+    }
+    (void)madvise(t->map, t->map_len, MADV_SEQUENTIAL);
+    t->data = (const float *)((const uint8_t *)t->map + hdr.data_offset);
+#else
+    t->buf = malloc((size_t)hdr.num_elements * sizeof(float) + 1);
+    if (!t->buf)
+    {
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    if (fseek(fp, (long)hdr.data_offset, SEEK_SET) != 0 ||
+        fread(t->buf, sizeof(float), hdr.num_elements, fp) != hdr.num_elements)
+    {
+        return NI_RETCODE_FAILURE;
+    }
+    t->data = (const float *)t->buf;
+#endif
+    t->num = hdr.num_elements;
+    return NI_RETCODE_SUCCESS;
 }
 
-static int open_tensor_rsrc_rawdata(struct tensor_rsrc *rsrc, void *data,
-                                    uint32_t len)
+static ni_retcode_t ni_ai_tensor_file_load_text(ni_ai_tensor_src_t *t,
+                                                FILE *fp, size_t file_len,
+                                                uint32_t max_num)
 {
-    rsrc->private = (void *)data;
-    rsrc->total_num = len / sizeof(float);
-    rsrc->next_idx = 0;
-    return 0;
-}
+    char *text;
+    char *p;
+    char *end;
+    float *values;
+    uint32_t num = 0;
 
-static int get_tensor_rsrc_from_rawdata(struct tensor_rsrc *rsrc, float *value)
-{
-    float *tensors = (float *)rsrc->private;
+    // parse the whole file at once instead of one fscanf() per element
+    text = (char *)malloc(file_len + 1);
+    values = (float *)malloc(((size_t)max_num + 1) * sizeof(float));
+    if (!text || !values)
+    {
+        free(text);
+        free(values);
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+
+    file_len = fread(text, 1, file_len, fp);
+    text[file_len] = '\0';
 
-    if (rsrc->next_idx < rsrc->total_num)
+    for (p = text; num < max_num; p = end)
     {
-        *value = tensors[rsrc->next_idx];
-        rsrc->next_idx++;
-        return 0;
+        values[num] = strtof(p, &end);
+        if (end == p)
+        {
+            break;
+        }
+        num++;
     }
 
-    return -1;
+    free(text);
+    t->buf = values;
+    t->data = values;
+    t->num = num;
+    return NI_RETCODE_SUCCESS;
 }
 
-static void close_tensor_rsrc_rawdata(struct tensor_rsrc *rsrc)
+/*!*****************************************************************************
+ *  \brief  Load the fp32 elements of a tensor file. Binary tensor files
+ *          (see ni_ai_tensor_file_header_t) are mapped, anything else is
+ *          parsed as whitespace separated text, up to max_num elements.
+ ******************************************************************************/
+static ni_retcode_t ni_ai_tensor_file_open(ni_ai_tensor_src_t *t,
+                                           const char *path, uint32_t max_num)
 {
+    FILE *fp = NULL;
+    uint32_t magic = 0;
+    long file_len;
+    ni_retcode_t retval;
+
+    memset(t, 0, sizeof(*t));
+    ni_fopen(&fp, path, "rb");
+    if (!fp)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() failed to open %s\n", __func__,
+               path);
+        return NI_RETCODE_FAILURE;
+    }
+
+    if (fseek(fp, 0, SEEK_END) != 0 || (file_len = ftell(fp)) < 0 ||
+        fseek(fp, 0, SEEK_SET) != 0)
+    {
+        fclose(fp);
+        return NI_RETCODE_FAILURE;
+    }
+
+    if ((size_t)file_len >= sizeof(ni_ai_tensor_file_header_t) &&
+        fread(&magic, sizeof(magic), 1, fp) == 1 &&
+        magic == NI_AI_TENSOR_FILE_MAGIC)
+    {
+        rewind(fp);
+        retval = ni_ai_tensor_file_load_binary(t, fp, (size_t)file_len, path);
+    } else
+    {
+        rewind(fp);
+        retval = ni_ai_tensor_file_load_text(t, fp, (size_t)file_len, max_num);
+    }
+    fclose(fp);
+
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        ni_ai_tensor_file_close(t);
+    }
+    return retval;
 }
 
-static ni_retcode_t ni_network_tensor_to_data(
-    uint8_t *dst, uint32_t dst_len, void *tensor, uint32_t src_len,
-    ni_network_layer_params_t *p_param,
-    int (*open_tensor_rsrc)(struct tensor_rsrc *, void *, uint32_t),
-    int (*get_tensor_rsrc)(struct tensor_rsrc *, float *),
-    void (*close_tensor_rsrc)(struct tensor_rsrc *))
+static ni_retcode_t ni_network_tensor_to_data(uint8_t *dst, uint32_t dst_len,
+                                              const float *src,
+                                              uint32_t src_num,
+                                              ni_network_layer_params_t *p_param)
 {
-    uint8_t *tensor_data;
-    uint32_t i, sz;
+    const ni_ai_conv_kernels_t *p_kernels = ni_ai_get_conv_kernels();
+    ni_ai_conv_param_t param;
+    ni_ai_conv_fn fn = NULL;
+    uint32_t i, sz, num;
     uint32_t stride;
-    float fval;
     int32_t data_format;
     int32_t quant_format;
-    int32_t fixed_point_pos;
-    float tf_scale;
-    int32_t tf_zerop;
-    struct tensor_rsrc *rsrc;
+    double max_range;
+    double min_range;
 
     data_format = p_param->data_format;
     quant_format = p_param->quant_format;
-    fixed_point_pos = p_param->quant_data.dfp.fixed_point_pos;
-    tf_scale = p_param->quant_data.affine.scale;
-    tf_zerop = p_param->quant_data.affine.zeroPoint;
 
     sz = ni_ai_get_element_num((int32_t *)p_param->sizes, p_param->num_of_dims,
                                data_format);
@@ -3827,35 +6611,69 @@ static ni_retcode_t ni_network_tensor_to_data(
         return NI_RETCODE_INVALID_PARAM;
     }
 
-    rsrc = (struct tensor_rsrc *)calloc(1, sizeof(struct tensor_rsrc));
-    if (!rsrc)
+    memset(&param, 0, sizeof(param));
+    switch (data_format)
     {
-        return NI_RETCODE_FAILURE;
+        case NI_AI_BUFFER_FORMAT_FP32:
+            fn = NULL;
+            break;
+        case NI_AI_BUFFER_FORMAT_FP16:
+            fn = p_kernels->fp32_to_fp16;
+            break;
+        case NI_AI_BUFFER_FORMAT_BFP16:
+            fn = p_kernels->fp32_to_bf16;
+            break;
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+        case NI_AI_BUFFER_FORMAT_INT16:
+            if (quant_format == NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT)
+            {
+                // x * 2^fl is computed as x / 2^-fl, exact for powers of two
+                param.divisor = ni_ai_dfp_scale(
+                    (signed char)p_param->quant_data.dfp.fixed_point_pos);
+            } else if (quant_format == NI_AI_BUFFER_QUANTIZE_TF_ASYMM)
+            {
+                param.divisor = p_param->quant_data.affine.scale;
+                param.zp = p_param->quant_data.affine.zeroPoint;
+            } else
+            {
+                break;
+            }
+            ni_ai_type_get_range(data_format, &max_range, &min_range);
+            param.lo = (float)(min_range - param.zp);
+            param.hi = (float)(max_range - param.zp);
+            fn = (data_format == NI_AI_BUFFER_FORMAT_INT8) ?
+                p_kernels->fp32_to_s8 :
+                (data_format == NI_AI_BUFFER_FORMAT_UINT8) ?
+                p_kernels->fp32_to_u8 : p_kernels->fp32_to_s16;
+            break;
+        default:
+            break;
     }
 
-    if (open_tensor_rsrc(rsrc, tensor, src_len) != 0)
+    num = ni_min(sz, src_num);
+    if (data_format == NI_AI_BUFFER_FORMAT_FP32)
     {
-        free(rsrc);
-        return NI_RETCODE_FAILURE;
-    }
-
-    memset(dst, 0, sz * stride * sizeof(uint8_t));
-    tensor_data = dst;
-    for (i = 0; i < sz; i++)
+        memcpy(dst, src, (size_t)num * sizeof(float));
+    } else if (fn)
     {
-        if (get_tensor_rsrc(rsrc, &fval) == 0)
-        {
-            ni_ai_float32_to_dtype(fval, &tensor_data[stride * i], data_format,
-                                   quant_format, fixed_point_pos, tf_scale,
-                                   tf_zerop);
-        } else
+        ni_ai_convert(fn, src, sizeof(float), dst, stride, num, &param);
+    } else
+    {
+        // unquantized integer layers and formats without a bulk kernel
+        memset(dst, 0, (size_t)num * stride);
+        for (i = 0; i < num; i++)
         {
-            break;
+            ni_ai_float32_to_dtype(src[i], &dst[stride * i], data_format,
+                                   quant_format,
+                                   p_param->quant_data.dfp.fixed_point_pos,
+                                   p_param->quant_data.affine.scale,
+                                   p_param->quant_data.affine.zeroPoint);
         }
     }
 
-    close_tensor_rsrc(rsrc);
-    free(rsrc);
+    // elements missing from a short source are zero
+    memset(dst + (size_t)num * stride, 0, (size_t)(sz - num) * stride);
     return NI_RETCODE_SUCCESS;
 }
 
@@ -3863,9 +6681,68 @@ ni_retcode_t ni_network_layer_convert_tensor(uint8_t *dst, uint32_t dst_len,
                                              const char *tensor_file,
                                              ni_network_layer_params_t *p_param)
 {
-    return ni_network_tensor_to_data(
-        dst, dst_len, (void *)tensor_file, 0, p_param, open_tensor_rsrc_file,
-        get_tensor_rsrc_from_file, close_tensor_rsrc_file);
+    ni_ai_tensor_src_t tensor;
+    ni_retcode_t retval;
+
+    if (!tensor_file || !p_param ||
+        ni_ai_network_layer_size(p_param) != dst_len)
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    retval = ni_ai_tensor_file_open(&tensor, tensor_file,
+                                    ni_ai_network_layer_dims(p_param));
+    if (retval != NI_RETCODE_SUCCESS)
+    {
+        return NI_RETCODE_FAILURE;
+    }
+
+    retval = ni_network_tensor_to_data(dst, dst_len, tensor.data, tensor.num,
+                                       p_param);
+    ni_ai_tensor_file_close(&tensor);
+    return retval;
+}
+
+ni_retcode_t ni_network_write_tensor_file(const char *tensor_file,
+                                          const float *src, uint32_t num)
+{
+    ni_ai_tensor_file_header_t hdr;
+    FILE *fp = NULL;
+    ni_retcode_t retval = NI_RETCODE_SUCCESS;
+
+    if (!tensor_file || (!src && num))
+    {
+        return NI_RETCODE_INVALID_PARAM;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = NI_AI_TENSOR_FILE_MAGIC;
+    hdr.version = NI_AI_TENSOR_FILE_VERSION;
+    hdr.data_format = NI_AI_BUFFER_FORMAT_FP32;
+    hdr.num_elements = num;
+    hdr.data_offset = sizeof(hdr);
+
+    ni_fopen(&fp, tensor_file, "wb");
+    if (!fp)
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() failed to open %s\n", __func__,
+               tensor_file);
+        return NI_RETCODE_FAILURE;
+    }
+
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        (num && fwrite(src, sizeof(float), num, fp) != num))
+    {
+        ni_log(NI_LOG_ERROR, "ERROR: %s() failed to write %s\n", __func__,
+               tensor_file);
+        retval = NI_RETCODE_FAILURE;
+    }
+
+    if (fclose(fp) != 0)
+    {
+        retval = NI_RETCODE_FAILURE;
+    }
+    return retval;
 }
 
 ni_retcode_t
@@ -3873,9 +6750,8 @@ ni_network_convert_tensor_to_data(uint8_t *dst, uint32_t dst_len, float *src,
                                   uint32_t src_len,
                                   ni_network_layer_params_t *p_param)
 {
-    return ni_network_tensor_to_data(
-        dst, dst_len, src, src_len, p_param, open_tensor_rsrc_rawdata,
-        get_tensor_rsrc_from_rawdata, close_tensor_rsrc_rawdata);
+    return ni_network_tensor_to_data(dst, dst_len, src,
+                                     src_len / sizeof(float), p_param);
 }
 
 ni_retcode_t
@@ -3883,11 +6759,13 @@ ni_network_convert_data_to_tensor(float *dst, uint32_t dst_len, uint8_t *src,
                                   uint32_t src_len,
                                   ni_network_layer_params_t *p_param)
 {
+    const ni_ai_conv_kernels_t *p_kernels;
+    ni_ai_conv_param_t param;
+    ni_ai_conv_fn fn;
     uint32_t i = 0;
-    uint8_t *data;
     uint32_t ele_size;
-    float *dst_float = dst;
     uint32_t type_size;
+    int32_t quant_format;
 
     if (!src || src_len == 0 || !dst || dst_len == 0 || !p_param)
     {
@@ -3896,8 +6774,6 @@ ni_network_convert_data_to_tensor(float *dst, uint32_t dst_len, uint8_t *src,
 
     type_size = ni_ai_type_get_bytes(p_param->data_format);
 
-    data = src;
-
     ele_size = 1;
     for (i = 0; i < p_param->num_of_dims; i++)
     {
@@ -3914,75 +6790,61 @@ ni_network_convert_data_to_tensor(float *dst, uint32_t dst_len, uint8_t *src,
         return NI_RETCODE_INVALID_PARAM;
     }
 
-    if (p_param->data_format == NI_AI_BUFFER_FORMAT_INT8)
-    {
-        int32_t quant_format = p_param->quant_format;
-
-        if (quant_format == NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT)
-        {
-            uint8_t fix_pos = (uint8_t)p_param->quant_data.dfp.fixed_point_pos;
+    p_kernels = ni_ai_get_conv_kernels();
+    quant_format = p_param->quant_format;
+    memset(&param, 0, sizeof(param));
+    param.scale = 1.0f;
 
-            for (i = 0; i < ele_size; i++, data += type_size)
+    switch (p_param->data_format)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
+            if (quant_format == NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT)
             {
-                dst_float[i] = ni_ai_int8_to_fp32(*data, fix_pos);
-            }
-        } else if (quant_format == NI_AI_BUFFER_QUANTIZE_TF_ASYMM)
-        {
-            int32_t zero_point = p_param->quant_data.affine.zeroPoint;
-            float scale = p_param->quant_data.affine.scale;
-
-            for (i = 0; i < ele_size; i++, data += type_size)
+                param.scale = ni_ai_dfp_scale(
+                    (signed char)p_param->quant_data.dfp.fixed_point_pos);
+            } else if (quant_format == NI_AI_BUFFER_QUANTIZE_TF_ASYMM)
             {
-                int32_t src_value = 0;
-                ni_ai_integer_convert(data, &src_value,
-                                      NI_AI_BUFFER_FORMAT_INT8,
-                                      NI_AI_BUFFER_FORMAT_INT32);
-                dst_float[i] =
-                    ni_ai_affine_to_fp32(src_value, zero_point, scale);
-            }
-        } else
-        {
-            for (i = 0; i < ele_size; i++, data += type_size)
+                param.zero_point =
+                    (float)p_param->quant_data.affine.zeroPoint;
+                param.scale = p_param->quant_data.affine.scale;
+            } else
             {
-                void *float_data = (void *)data;
-                dst_float[i] = *((float *)float_data);
-            }
-        }
-    } else if (p_param->data_format == NI_AI_BUFFER_FORMAT_FP16)
-    {
-        for (i = 0; i < ele_size; i++, data += type_size)
-        {
-            dst_float[i] = ni_ai_fp16_to_fp32(*((short *)data));
-        }
-    } else if (p_param->data_format == NI_AI_BUFFER_FORMAT_UINT8)
-    {
-        int32_t zero_point = p_param->quant_data.affine.zeroPoint;
-        float scale = p_param->quant_data.affine.scale;
-
-        for (i = 0; i < ele_size; i++, data += type_size)
-        {
-            dst_float[i] = ni_ai_uint8_to_fp32(*data, zero_point, scale);
-        }
-    } else if (p_param->data_format == NI_AI_BUFFER_FORMAT_INT16)
-    {
-        uint8_t fix_pos = p_param->quant_data.dfp.fixed_point_pos;
+                uint8_t *data = src;
 
-        for (i = 0; i < ele_size; i++, data += type_size)
-        {
-            dst_float[i] = ni_ai_int16_to_fp32(*((short *)data), fix_pos);
-        }
-    } else if (p_param->data_format == NI_AI_BUFFER_FORMAT_FP32)
-    {
-        for (i = 0; i < ele_size; i++, data += type_size)
-        {
-            void *float_data = (void *)data;
-            dst_float[i] = *((float *)float_data);
-        }
-    } else
-    {
-        return NI_RETCODE_INVALID_PARAM;
+                for (i = 0; i < ele_size; i++, data += type_size)
+                {
+                    void *float_data = (void *)data;
+                    dst[i] = *((float *)float_data);
+                }
+                return NI_RETCODE_SUCCESS;
+            }
+            fn = p_kernels->s8_to_fp32;
+            break;
+        case NI_AI_BUFFER_FORMAT_UINT8:
+            param.zero_point =
+                (float)(uint8_t)p_param->quant_data.affine.zeroPoint;
+            param.scale = p_param->quant_data.affine.scale;
+            fn = p_kernels->u8_to_fp32;
+            break;
+        case NI_AI_BUFFER_FORMAT_INT16:
+            param.scale = ni_ai_dfp_scale(
+                (signed char)p_param->quant_data.dfp.fixed_point_pos);
+            fn = p_kernels->s16_to_fp32;
+            break;
+        case NI_AI_BUFFER_FORMAT_FP16:
+            fn = p_kernels->fp16_to_fp32;
+            break;
+        case NI_AI_BUFFER_FORMAT_BFP16:
+            fn = p_kernels->bf16_to_fp32;
+            break;
+        case NI_AI_BUFFER_FORMAT_FP32:
+            memcpy(dst, src, (size_t)ele_size * sizeof(float));
+            return NI_RETCODE_SUCCESS;
+        default:
+            return NI_RETCODE_INVALID_PARAM;
     }
 
+    ni_ai_convert(fn, src, type_size, dst, sizeof(float), ele_size, &param);
     return NI_RETCODE_SUCCESS;
 }
 
@@ -4085,6 +6947,182 @@ void ni_SHA256Transform(SHA256CTX *psCtx, const uint8_t aui8Data[])
     psCtx->aui32State[7] += ui32h;
 }
 
+#if defined(__GNUC__) && defined(__x86_64__)
+#define NI_SHA256_X86
+#endif
+#if defined(__aarch64__) &&                                                    \
+    (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#include <arm_neon.h>
+#define NI_SHA256_ARM
+#endif
+
+typedef void (*ni_sha256_blocks_fn)(uint32_t aui32State[8],
+                                    const uint8_t *pui8Data, size_t nblocks);
+
+static void ni_sha256_blocks_c(uint32_t aui32State[8], const uint8_t *pui8Data,
+                               size_t nblocks)
+{
+    SHA256CTX sCtx;
+
+    memcpy(sCtx.aui32State, aui32State, sizeof(sCtx.aui32State));
+    for (; nblocks; nblocks--, pui8Data += 64)
+    {
+        ni_SHA256Transform(&sCtx, pui8Data);
+    }
+    memcpy(aui32State, sCtx.aui32State, sizeof(sCtx.aui32State));
+}
+
+#ifdef NI_SHA256_X86
+// SHA extensions: the state is kept as ABEF/CDGH halves, see Intel's
+// "New Instructions Supporting the Secure Hash Algorithm on Intel
+// Architecture Processors"
+__attribute__((target("sha,sse4.1,ssse3"))) static void
+ni_sha256_blocks_shani(uint32_t aui32State[8], const uint8_t *pui8Data,
+                       size_t nblocks)
+{
+    const __m128i mask =
+        _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i state0, state1, msg, tmp;
+    __m128i abef_save, cdgh_save;
+    __m128i m[4];
+    int g;
+
+    tmp = _mm_loadu_si128((const __m128i *)&aui32State[0]);
+    state1 = _mm_loadu_si128((const __m128i *)&aui32State[4]);
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);            // CDAB
+    state1 = _mm_shuffle_epi32(state1, 0x1B);      // EFGH
+    state0 = _mm_alignr_epi8(tmp, state1, 8);      // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);   // CDGH
+
+    for (; nblocks; nblocks--, pui8Data += 64)
+    {
+        abef_save = state0;
+        cdgh_save = state1;
+
+        for (g = 0; g < 16; g++)
+        {
+            if (g < 4)
+            {
+                m[g] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)(pui8Data + 16 * g)),
+                    mask);
+            }
+            msg = _mm_add_epi32(m[g & 3],
+                                _mm_loadu_si128((const __m128i *)&ui32k[4 * g]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            if (g >= 3 && g < 15)
+            {
+                // finish the schedule of the next group of 4 words
+                tmp = _mm_alignr_epi8(m[g & 3], m[(g - 1) & 3], 4);
+                m[(g + 1) & 3] = _mm_add_epi32(m[(g + 1) & 3], tmp);
+                m[(g + 1) & 3] = _mm_sha256msg2_epu32(m[(g + 1) & 3], m[g & 3]);
+            }
+            msg = _mm_shuffle_epi32(msg, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+            if (g >= 1 && g < 13)
+            {
+                // start the schedule of the group used 3 steps later
+                m[(g - 1) & 3] = _mm_sha256msg1_epu32(m[(g - 1) & 3], m[g & 3]);
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);         // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);      // DCHG
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);   // DCBA
+    state1 = _mm_alignr_epi8(state1, tmp, 8);      // ABEF
+    _mm_storeu_si128((__m128i *)&aui32State[0], state0);
+    _mm_storeu_si128((__m128i *)&aui32State[4], state1);
+}
+
+static int ni_sha256_cpu_has_shani(void)
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+        !(ecx & bit_SSE4_1) || !(ecx & bit_SSSE3))
+    {
+        return 0;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+    {
+        return 0;
+    }
+    return (ebx & (1u << 29)) != 0;
+}
+#endif
+
+#ifdef NI_SHA256_ARM
+static void ni_sha256_blocks_armv8(uint32_t aui32State[8],
+                                   const uint8_t *pui8Data, size_t nblocks)
+{
+    uint32x4_t state0 = vld1q_u32(&aui32State[0]);
+    uint32x4_t state1 = vld1q_u32(&aui32State[4]);
+    uint32x4_t abcd_save, efgh_save, wk, abcd;
+    uint32x4_t m[4];
+    int g;
+
+    for (; nblocks; nblocks--, pui8Data += 64)
+    {
+        abcd_save = state0;
+        efgh_save = state1;
+
+        for (g = 0; g < 4; g++)
+        {
+            m[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(pui8Data + 16 * g)));
+        }
+
+        for (g = 0; g < 16; g++)
+        {
+            wk = vaddq_u32(m[g & 3], vld1q_u32(&ui32k[4 * g]));
+            if (g < 12)
+            {
+                m[g & 3] = vsha256su1q_u32(vsha256su0q_u32(m[g & 3],
+                                                           m[(g + 1) & 3]),
+                                           m[(g + 2) & 3], m[(g + 3) & 3]);
+            }
+            abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, wk);
+            state1 = vsha256h2q_u32(state1, abcd, wk);
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(&aui32State[0], state0);
+    vst1q_u32(&aui32State[4], state1);
+}
+#endif
+
+static ni_sha256_blocks_fn volatile g_sha256_blocks = NULL;
+
+static ni_sha256_blocks_fn ni_sha256_get_blocks_fn(void)
+{
+    ni_sha256_blocks_fn fn = g_sha256_blocks;
+
+    if (fn)
+    {
+        return fn;
+    }
+
+    fn = ni_sha256_blocks_c;
+#ifdef NI_SHA256_X86
+    if (ni_sha256_cpu_has_shani())
+    {
+        fn = ni_sha256_blocks_shani;
+    }
+#endif
+#ifdef NI_SHA256_ARM
+    fn = ni_sha256_blocks_armv8;
+#endif
+    g_sha256_blocks = fn;
+    return fn;
+}
+
 void ni_SHA256Init(SHA256CTX *psCtx)
 {
     psCtx->ui32DataLength = 0;
@@ -4102,19 +7140,43 @@ void ni_SHA256Init(SHA256CTX *psCtx)
 void ni_SHA256Update(SHA256CTX *psCtx, const uint8_t aui8Data[],
                      size_t ui32Length)
 {
-    uint32_t ui32i;
+    ni_sha256_blocks_fn blocks = ni_sha256_get_blocks_fn();
+    size_t nblocks;
+    size_t fill;
 
-    for (ui32i = 0; ui32i < ui32Length; ++ui32i)
+    // complete a pending partial block first
+    if (psCtx->ui32DataLength)
     {
-        psCtx->aui8Data[psCtx->ui32DataLength] = aui8Data[ui32i];
-        psCtx->ui32DataLength++;
-        if (psCtx->ui32DataLength == 64)
+        fill = 64 - psCtx->ui32DataLength;
+        if (fill > ui32Length)
+        {
+            fill = ui32Length;
+        }
+        memcpy(psCtx->aui8Data + psCtx->ui32DataLength, aui8Data, fill);
+        psCtx->ui32DataLength += (uint32_t)fill;
+        aui8Data += fill;
+        ui32Length -= fill;
+        if (psCtx->ui32DataLength < 64)
         {
-            ni_SHA256Transform(psCtx, psCtx->aui8Data);
-            psCtx->ui64BitLength += 512;
-            psCtx->ui32DataLength = 0;
+            return;
         }
+        blocks(psCtx->aui32State, psCtx->aui8Data, 1);
+        psCtx->ui64BitLength += 512;
+        psCtx->ui32DataLength = 0;
+    }
+
+    // hash whole blocks straight from the input
+    nblocks = ui32Length / 64;
+    if (nblocks)
+    {
+        blocks(psCtx->aui32State, aui8Data, nblocks);
+        psCtx->ui64BitLength += (uint64_t)nblocks * 512;
+        aui8Data += nblocks * 64;
+        ui32Length -= nblocks * 64;
     }
+
+    memcpy(psCtx->aui8Data, aui8Data, ui32Length);
+    psCtx->ui32DataLength = (uint32_t)ui32Length;
 }
 
 void ni_SHA256Final(SHA256CTX *psCtx, uint8_t aui8Hash[])
@@ -5196,7 +8258,7 @@ static int ni_device_vendor_id_precheck(const char *p_dev)
                 }
                 else
                 {
-                    ni_log2(NULL, NI_LOG_DEBUG, "%s() vendor check failed. vendor id: %s", vendor_id);
+                    ni_log2(NULL, NI_LOG_DEBUG, "%s() vendor check failed. vendor id: %s", __func__, vendor_id);
                     ret = -1;
                 }
             }
@@ -5403,3 +8465,22 @@ ni_retcode_t ni_quadra_card_identify_precheck(const char *p_dev)
 
 #endif
 }
+
+/*!******************************************************************************
+ *  \brief   precheck the PCI vendor ID of a device through sysfs, without
+ *           opening the device
+ *           INFO OR ERROR logs will not be printed in this function
+ *  \param[in]   p_dev device path string. eg: "/dev/nvme1n2"
+ *
+ *  \return
+ *           returns NI_RETCODE_FAILURE
+ *           when sysfs reports a vendor other than NETINT
+ *
+ *           returns NI_RETCODE_SUCCESS when the vendor is NETINT or can not be
+ *           determined, eg. the device is not PCI attached
+ *******************************************************************************/
+ni_retcode_t ni_quadra_card_vendor_precheck(const char *p_dev)
+{
+    return (ni_device_vendor_id_precheck(p_dev) < 0) ? NI_RETCODE_FAILURE :
+                                                       NI_RETCODE_SUCCESS;
+}
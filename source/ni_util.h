@@ -125,9 +125,10 @@ void ni_buf_pool_return_buffer(ni_buf_t *buf, ni_buf_pool_t *p_buffer_pool);
 
 ni_buf_t *ni_buf_pool_allocate_buffer(ni_buf_pool_t *p_buffer_pool, int buffer_size);
 
-// decoder frame buffer pool init & free
+// decoder frame buffer pool init, free & pre-warm
 int32_t ni_dec_fme_buffer_pool_initialize(ni_session_context_t* p_ctx, int32_t number_of_buffers, int width, int height, int height_align, int factor);
 void ni_dec_fme_buffer_pool_free(ni_buf_pool_t *p_buffer_pool);
+void ni_dec_fme_buffer_pool_prewarm(ni_session_context_t* p_ctx, int width, int height, int height_align, int factor);
 
 // timestamp buffer pool operations
 void ni_buffer_pool_free(ni_queue_buffer_pool_t *p_buffer_pool);
@@ -175,6 +176,21 @@ uint32_t ni_decode_power_measurement(uint32_t power_value, const uint8_t *serial
  *******************************************************************************/
 ni_retcode_t ni_quadra_card_identify_precheck(const char *p_dev);
 
+/*!******************************************************************************
+ *  \brief   precheck the PCI vendor ID of a device through sysfs, without
+ *           opening the device
+ *           INFO OR ERROR logs will not be printed in this function
+ *  \param[in]   p_dev device path string. eg: "/dev/nvme1n2"
+ *
+ *  \return
+ *           returns NI_RETCODE_FAILURE
+ *           when sysfs reports a vendor other than NETINT
+ *
+ *           returns NI_RETCODE_SUCCESS when the vendor is NETINT or can not be
+ *           determined, eg. the device is not PCI attached
+ *******************************************************************************/
+ni_retcode_t ni_quadra_card_vendor_precheck(const char *p_dev);
+
 // Netint HW YUV420p data layout related utility functions
 
 /*!*****************************************************************************
@@ -332,6 +348,58 @@ LIB_API void ni_copy_yuv_444p_to_420p(uint8_t *p_dst0[NI_MAX_NUM_DATA_POINTERS],
                                       int width, int height, int factor,
                                       int mode);
 
+#define NI_YUV_CONVERT_MAX_THREADS  8
+#define NI_YUV_CONVERT_MT_MIN_BYTES (512 * 1024)
+
+// chroma siting of ni_convert_yuv_444p_to_420p
+typedef enum _ni_chroma_filter
+{
+    NI_CHROMA_FILTER_DROP = 0,  // top-left sample, no filtering
+    NI_CHROMA_FILTER_BOX,       // 2x2 average, center sited (JPEG/MPEG-1)
+    NI_CHROMA_FILTER_LEFT,      // [1 2 1] x [1 1], left sited (MPEG-2/H.264)
+    NI_CHROMA_FILTER_NUM,
+} ni_chroma_filter_t;
+
+/*!*****************************************************************************
+ *  \brief  Downsample a yuv444p or yuv444p10le frame to a 4:2:0 frame.
+ *          dst_fmt selects the output layout and the source bit depth:
+ *          NI_PIX_FMT_YUV420P and NI_PIX_FMT_NV12 take 8 bit input,
+ *          NI_PIX_FMT_YUV420P10LE and NI_PIX_FMT_P010LE take 10 bit input
+ *          (P010 samples are shifted to the MSBs). Odd source dimensions and
+ *          any padding up to dst_width x dst_height are filled by replicating
+ *          the right column and bottom line.
+ *
+ *  \param[out] p_dst       output planes, Y and UV (NV12/P010) or Y/U/V
+ *  \param[in]  dst_stride  output plane strides in bytes
+ *  \param[in]  dst_width   output width, >= width
+ *  \param[in]  dst_height  output height, >= height
+ *  \param[in]  dst_fmt     output pixel format
+ *  \param[in]  p_src       Y/U/V planes of the 4:4:4 input
+ *  \param[in]  src_stride  input plane strides in bytes
+ *  \param[in]  width       input width
+ *  \param[in]  height      input height
+ *  \param[in]  filter      chroma downsampling filter
+ *
+ *  \return NI_RETCODE_SUCCESS on success, NI_RETCODE_INVALID_PARAM otherwise
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_convert_yuv_444p_to_420p(
+    uint8_t *p_dst[NI_MAX_NUM_DATA_POINTERS],
+    const int dst_stride[NI_MAX_NUM_DATA_POINTERS], int dst_width,
+    int dst_height, ni_pix_fmt_t dst_fmt,
+    uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+    const int src_stride[NI_MAX_NUM_DATA_POINTERS], int width, int height,
+    ni_chroma_filter_t filter);
+
+/*!*****************************************************************************
+ *  \brief  Set the number of threads used to convert a single frame by
+ *          ni_copy_yuv_444p_to_420p() and ni_convert_yuv_444p_to_420p().
+ *          Frames with less than NI_YUV_CONVERT_MT_MIN_BYTES per thread use
+ *          fewer threads. Default 1.
+ *
+ *  \param[in] nb_threads  1 to NI_YUV_CONVERT_MAX_THREADS
+ ******************************************************************************/
+LIB_API void ni_yuv_set_convert_threads(int nb_threads);
+
 // NAL operations
 
 /*!*****************************************************************************
@@ -418,6 +486,26 @@ uint32_t ni_round_up(uint32_t number_to_round, uint32_t multiple);
 uint32_t ni_get_kernel_max_io_size(const char * p_dev);
 #endif
 
+// process wide cache of page aligned packet and frame buffers
+#define NI_MEM_CACHE_MIN_LOG2       12
+#define NI_MEM_CACHE_MIN_SIZE       (1 << NI_MEM_CACHE_MIN_LOG2)
+#define NI_MEM_CACHE_MAX_SIZE       ((size_t)1 << 28)
+// one class up to MIN_SIZE, four per power of two up to MAX_SIZE
+#define NI_MEM_CACHE_NB_CLASSES     65
+// deep enough to keep a whole decoder frame buffer pool of a resolution
+#define NI_MEM_CACHE_CLASS_DEPTH    40
+// a request may be served by an idle buffer up to this many classes larger
+// (up to 4x the size) rather than allocating
+#define NI_MEM_CACHE_RECARVE_CLASSES 8
+#define NI_MEM_CACHE_MAX_IDLE_BYTES ((size_t)256 << 20)
+#define NI_MEM_CACHE_IDLE_TTL_MS    10000
+
+// buffers of at least this size may be backed by huge pages
+#define NI_HUGE_PAGE_SIZE           (2 << 20)
+
+LIB_API void ni_set_huge_pages(int enable);
+LIB_API void ni_mem_cache_trim(size_t max_idle_bytes);
+
 LIB_API uint64_t ni_gettime_ns(void);
 LIB_API void ni_usleep(int64_t usec);
 LIB_API char *ni_strtok(char *s, const char *delim, char **saveptr);
@@ -433,6 +521,23 @@ LIB_API int ni_fscanf(FILE *stream, const char *fmt, ...);
 LIB_API int ni_vsprintf(char *dest, const size_t dmax, const char *fmt, va_list args);
 LIB_API int ni_sprintf(char *dest, size_t dmax, const char *fmt, ...);
 
+#define NI_AI_CONVERT_MAX_THREADS     8
+#define NI_AI_CONVERT_MT_MIN_ELEMENTS (256 * 1024)
+
+// binary tensor file, "NITS" followed by fp32 payload at data_offset
+#define NI_AI_TENSOR_FILE_MAGIC   0x5354494E
+#define NI_AI_TENSOR_FILE_VERSION 1
+
+typedef struct _ni_ai_tensor_file_header
+{
+    uint32_t magic;         // NI_AI_TENSOR_FILE_MAGIC
+    uint32_t version;       // NI_AI_TENSOR_FILE_VERSION
+    uint32_t data_format;   // ni_ai_buffer_format_e, only FP32 supported
+    uint32_t num_elements;
+    uint32_t data_offset;   // payload offset from start of file
+    uint32_t reserved[3];
+} ni_ai_tensor_file_header_t;
+
 LIB_API ni_retcode_t
 ni_network_layer_convert_output(float *dst, uint32_t num, ni_packet_t *p_packet,
                                 ni_network_data_t *p_network, uint32_t layer);
@@ -448,6 +553,32 @@ LIB_API ni_retcode_t ni_network_convert_data_to_tensor(
     float *dst, uint32_t dst_len, uint8_t *src, uint32_t src_len,
     ni_network_layer_params_t *p_param);
 
+/*!*****************************************************************************
+ *  \brief  Write fp32 elements to a binary tensor file. Such files are mapped
+ *          by ni_network_layer_convert_tensor() instead of being parsed as
+ *          text. Host (little-endian) byte order.
+ *
+ *  \param[in] tensor_file  path of the file to create
+ *  \param[in] src          fp32 elements
+ *  \param[in] num          number of elements
+ *
+ *  \return NI_RETCODE_SUCCESS on success, NI_RETCODE_INVALID_PARAM or
+ *          NI_RETCODE_FAILURE otherwise
+ ******************************************************************************/
+LIB_API ni_retcode_t ni_network_write_tensor_file(const char *tensor_file,
+                                                  const float *src,
+                                                  uint32_t num);
+
+/*!*****************************************************************************
+ *  \brief  Set the number of threads used to convert a single tensor by the
+ *          ni_network_*convert* functions. Tensors with fewer than
+ *          NI_AI_CONVERT_MT_MIN_ELEMENTS elements per thread use fewer
+ *          threads. Default 1.
+ *
+ *  \param[in] nb_threads  1 to NI_AI_CONVERT_MAX_THREADS
+ ******************************************************************************/
+LIB_API void ni_network_set_convert_threads(int nb_threads);
+
 LIB_API void ni_calculate_sha256(const uint8_t aui8Data[],
                                  size_t ui32DataLength, uint8_t aui8Hash[]);
 /*!*****************************************************************************
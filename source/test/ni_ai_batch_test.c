@@ -0,0 +1,322 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_ai_batch_test.c
+ *
+ *  \brief  Test of the AI session batch writes without a card: the NVMe
+ *          read and write commands are replaced at link time (-Wl,--wrap)
+ *          by a model of the AI instance LBAs that takes a fixed time per
+ *          command. Checks the frames reach the device in order with the
+ *          expected number of commands, and prints frames/s and commands per
+ *          frame of the batches against the one frame per call APIs.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_nvme.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SESSION_ID      3
+#define NB_FRAMES       512
+#define FRAME_SIZE      (3 * 224 * 224)
+#define WR_BUF_FRAMES   16      // device input buffer, in frames
+#define CMD_LATENCY_NS  20000   // modelled round trip of one NVMe command
+
+static int failures;
+
+static struct
+{
+    int queries;                // status / stats reads
+    int writes;                 // tensor writes
+    int configs;                // hw frame configs
+    uint32_t order[NB_FRAMES];  // frame tags in device arrival order
+    int nb_order;
+} mock;
+
+static void mock_latency(void)
+{
+    uint64_t end = ni_gettime_ns() + CMD_LATENCY_NS;
+    while (ni_gettime_ns() < end)
+        ;
+}
+
+static void mock_record(uint32_t tag)
+{
+    if (mock.nb_order < NB_FRAMES)
+    {
+        mock.order[mock.nb_order] = tag;
+    }
+    mock.nb_order++;
+}
+
+// the device drains its input buffer between commands, so every status
+// query finds it empty
+int32_t __wrap_ni_nvme_send_read_cmd(ni_device_handle_t handle,
+                                     ni_event_handle_t event_handle,
+                                     void *p_data, uint32_t data_len,
+                                     uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    mock_latency();
+    memset(p_data, 0, data_len);
+    if (lba == QUERY_INSTANCE_CUR_STATUS_INFO_R(SESSION_ID, NI_DEVICE_TYPE_AI))
+    {
+        ni_session_statistic_t *p_stat = (ni_session_statistic_t *)p_data;
+        p_stat->ui16SessionId = ni_htons(SESSION_ID);
+        p_stat->ui32WrBufAvailSize = ni_htonl(WR_BUF_FRAMES * FRAME_SIZE);
+        mock.queries++;
+        return 0;
+    }
+    if (lba == QUERY_SESSION_STATS_R(SESSION_ID, NI_DEVICE_TYPE_AI))
+    {
+        ((ni_session_stats_t *)p_data)->ui16SessionId = ni_htons(SESSION_ID);
+        mock.queries++;
+        return 0;
+    }
+    fprintf(stderr, "unexpected read of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+int32_t __wrap_ni_nvme_send_write_cmd(ni_device_handle_t handle,
+                                      ni_event_handle_t event_handle,
+                                      void *p_data, uint32_t data_len,
+                                      uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    mock_latency();
+    if (lba == WRITE_INSTANCE_W(SESSION_ID, NI_DEVICE_TYPE_AI))
+    {
+        CHECK(data_len >= FRAME_SIZE);
+        mock_record(*(uint32_t *)p_data);
+        mock.writes++;
+        return 0;
+    }
+    if (lba == CONFIG_INSTANCE_SetAiFrm_W(SESSION_ID, NI_DEVICE_TYPE_AI))
+    {
+        mock_record(((ni_network_buffer_info_t *)p_data)->ui16FrameIdx[0]);
+        mock.configs++;
+        return 0;
+    }
+    fprintf(stderr, "unexpected write of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+static void open_ctx(ni_session_context_t *p_ctx, const char *fw_api_ver)
+{
+    ni_device_session_context_init(p_ctx);
+    p_ctx->device_type = NI_DEVICE_TYPE_AI;
+    p_ctx->session_id = SESSION_ID;
+    p_ctx->session_timestamp = 0;
+    memcpy(&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], fw_api_ver,
+           2);
+    memset(&mock, 0, sizeof(mock));
+}
+
+static void check_order(const char *what)
+{
+    int i;
+
+    CHECK(mock.nb_order == NB_FRAMES);
+    for (i = 0; i < NB_FRAMES && i < mock.nb_order; i++)
+    {
+        if (mock.order[i] != (uint32_t)i)
+        {
+            fprintf(stderr, "%s: frame %u arrived as %d\n", what, mock.order[i],
+                    i);
+            failures++;
+            break;
+        }
+    }
+}
+
+static void report(const char *what, int batch, uint64_t ns)
+{
+    printf("  %-10s batch %2d: %8.0f frames/s, %.3f cmds/frame\n", what, batch,
+           NB_FRAMES * 1e9 / (double)ns,
+           (double)(mock.queries + mock.writes + mock.configs) / NB_FRAMES);
+}
+
+static void test_tensor(ni_frame_t *frames, ni_frame_t **p_frames)
+{
+    static const int batches[] = {1, 2, 4, 8, 16};
+    ni_session_context_t ctx;
+    ni_session_data_io_t io;
+    uint64_t t0;
+    size_t b;
+    int i;
+
+    // one frame per call
+    open_ctx(&ctx, "6K");
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_FRAMES; i++)
+    {
+        memset(&io, 0, sizeof(io));
+        io.data.frame = frames[i];
+        CHECK(ni_device_session_write(&ctx, &io, NI_DEVICE_TYPE_AI) ==
+              FRAME_SIZE);
+    }
+    report("write", 1, ni_gettime_ns() - t0);
+    check_order("write");
+    // first query, then a write and a statistics refresh per frame
+    CHECK(mock.writes == NB_FRAMES);
+    CHECK(mock.queries == NB_FRAMES + 1);
+    ni_device_session_context_clear(&ctx);
+
+    for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+    {
+        int n = batches[b];
+
+        open_ctx(&ctx, "6K");
+        t0 = ni_gettime_ns();
+        for (i = 0; i < NB_FRAMES; i += n)
+        {
+            CHECK(ni_ai_session_write_batch(&ctx, &p_frames[i], n) == n);
+        }
+        report("batch", n, ni_gettime_ns() - t0);
+        check_order("batch");
+        // first query, then one statistics refresh per batch
+        CHECK(mock.writes == NB_FRAMES);
+        CHECK(mock.queries == NB_FRAMES / n + 1);
+        ni_device_session_context_clear(&ctx);
+    }
+}
+
+static void test_hwframe(niFrameSurface1_t **p_surfaces)
+{
+    static const int batches[] = {1, 2, 4, 8, 16};
+    ni_session_context_t ctx;
+    uint64_t t0;
+    size_t b;
+    int i;
+
+    open_ctx(&ctx, "6K");
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_FRAMES; i++)
+    {
+        CHECK(ni_device_alloc_frame(&ctx, p_surfaces[i]->ui16width,
+                                    p_surfaces[i]->ui16height, 0, 0, 0, 0, 0,
+                                    0, 0, p_surfaces[i]->ui16FrameIdx,
+                                    NI_DEVICE_TYPE_AI) == NI_RETCODE_SUCCESS);
+    }
+    report("alloc", 1, ni_gettime_ns() - t0);
+    check_order("alloc");
+    // first query, then a config and a session stats check per frame
+    CHECK(mock.configs == NB_FRAMES);
+    CHECK(mock.queries == NB_FRAMES + 1);
+    ni_device_session_context_clear(&ctx);
+
+    for (b = 0; b < sizeof(batches) / sizeof(batches[0]); b++)
+    {
+        int n = batches[b];
+
+        open_ctx(&ctx, "6K");
+        t0 = ni_gettime_ns();
+        for (i = 0; i < NB_FRAMES; i += n)
+        {
+            CHECK(ni_ai_session_write_hwframe_batch(&ctx, &p_surfaces[i], n) ==
+                  n);
+        }
+        report("hw batch", n, ni_gettime_ns() - t0);
+        check_order("hw batch");
+        CHECK(mock.configs == NB_FRAMES);
+        CHECK(mock.queries == NB_FRAMES / n + 1);
+        ni_device_session_context_clear(&ctx);
+    }
+
+    // before 6K every config is checked on its own, as by the single call
+    open_ctx(&ctx, "6J");
+    for (i = 0; i < NB_FRAMES; i += 8)
+    {
+        CHECK(ni_ai_session_write_hwframe_batch(&ctx, &p_surfaces[i], 8) == 8);
+    }
+    check_order("hw batch 6J");
+    CHECK(mock.queries == NB_FRAMES + 1);
+    ni_device_session_context_clear(&ctx);
+
+    open_ctx(&ctx, "6K");
+    p_surfaces[1] = NULL;
+    CHECK(ni_ai_session_write_hwframe_batch(&ctx, p_surfaces, 2) ==
+          NI_RETCODE_INVALID_PARAM);
+    CHECK(mock.configs == 0);
+    ni_device_session_context_clear(&ctx);
+}
+
+int main(void)
+{
+    static niFrameSurface1_t surfaces[NB_FRAMES];
+    static niFrameSurface1_t *p_surfaces[NB_FRAMES];
+    static ni_frame_t frames[NB_FRAMES];
+    static ni_frame_t *p_frames[NB_FRAMES];
+    void *p_data = NULL;
+    int i;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    if (ni_posix_memalign(&p_data, NI_MEM_PAGE_ALIGNMENT,
+                          (size_t)NB_FRAMES * NI_MEM_PAGE_ALIGNMENT))
+    {
+        fprintf(stderr, "ni_ai_batch_test: out of memory\n");
+        return 1;
+    }
+    // frames share pages, the mock only reads the tag at their start
+    for (i = 0; i < NB_FRAMES; i++)
+    {
+        frames[i].p_buffer = (uint8_t *)p_data + i * NI_MEM_PAGE_ALIGNMENT;
+        frames[i].data_len[0] = FRAME_SIZE;
+        *(uint32_t *)frames[i].p_buffer = (uint32_t)i;
+        p_frames[i] = &frames[i];
+
+        surfaces[i].ui16FrameIdx = (uint16_t)i;
+        surfaces[i].ui16width = 224;
+        surfaces[i].ui16height = 224;
+        p_surfaces[i] = &surfaces[i];
+    }
+
+    printf("ni_ai_batch_test: %d frames, %d us per NVMe command\n", NB_FRAMES,
+           CMD_LATENCY_NS / 1000);
+    test_tensor(frames, p_frames);
+    test_hwframe(p_surfaces);
+
+    ni_aligned_free(p_data);
+
+    printf("ni_ai_batch_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,543 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_ai_convert_test.c
+ *
+ *  \brief  Differential test of the network tensor conversions of ni_util.c.
+ *          The bulk kernels picked for the running CPU, single and multi
+ *          threaded, are compared bit for bit against the per element scalar
+ *          conversion they replaced, which is kept here as the reference.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+// not a multiple of any vector width, so the scalar tails are covered
+#define NB_SMALL  999
+// large enough for ni_network_set_convert_threads(4) to use 3 threads
+#define NB_LARGE  (3 * NI_AI_CONVERT_MT_MIN_ELEMENTS + 17)
+// keeps quantized values inside int32 where the old path did not overflow
+#define MAX_ABS   1000.0f
+
+static int failures;
+
+/*
+ * Reference: the per element conversions of ni_util.c before the bulk
+ * kernels, unchanged apart from the ref_ prefix.
+ */
+static uint32_t ref_type_get_bytes(const uint32_t type)
+{
+    switch (type)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+            return 1;
+        case NI_AI_BUFFER_FORMAT_INT16:
+        case NI_AI_BUFFER_FORMAT_UINT16:
+        case NI_AI_BUFFER_FORMAT_FP16:
+        case NI_AI_BUFFER_FORMAT_BFP16:
+            return 2;
+        case NI_AI_BUFFER_FORMAT_FP32:
+        case NI_AI_BUFFER_FORMAT_INT32:
+        case NI_AI_BUFFER_FORMAT_UINT32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+static void ref_integer_convert(const void *src, void *dest,
+                                ni_ai_buffer_format_e src_dtype,
+                                ni_ai_buffer_format_e dst_dtype)
+{
+    unsigned char all_zeros[] = {0x00, 0x00, 0x00, 0x00,
+                                 0x00, 0x00, 0x00, 0x00};
+    unsigned char all_ones[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    uint32_t src_sz = ref_type_get_bytes(src_dtype);
+    uint32_t dest_sz = ref_type_get_bytes(dst_dtype);
+    unsigned char *buffer = all_zeros;
+
+    if (((int8_t *)src)[src_sz - 1] & 0x80)
+    {
+        buffer = all_ones;
+    }
+    memcpy(buffer, src, src_sz);
+    memcpy(dest, buffer, dest_sz);
+}
+
+static float ref_int8_to_fp32(signed char val, signed char fixedPointPos)
+{
+    if (fixedPointPos > 0)
+    {
+        return (float)val * (1.0f / ((float)(1 << fixedPointPos)));
+    }
+    return (float)val * ((float)(1 << -fixedPointPos));
+}
+
+static float ref_int16_to_fp32(int16_t val, signed char fixedPointPos)
+{
+    if (fixedPointPos > 0)
+    {
+        return (float)val * (1.0f / ((float)(1 << fixedPointPos)));
+    }
+    return (float)val * ((float)(1 << -fixedPointPos));
+}
+
+static float ref_uint8_to_fp32(uint8_t val, int32_t zeroPoint, float scale)
+{
+    return (float)(val - (uint8_t)zeroPoint) * scale;
+}
+
+static float ref_fp16_to_fp32(const short in)
+{
+    typedef union
+    {
+        unsigned int u;
+        float f;
+    } _fp32_t;
+
+    const _fp32_t magic = {(254 - 15) << 23};
+    const _fp32_t infnan = {(127 + 16) << 23};
+    _fp32_t o;
+
+    o.u = (in & 0x7fff) << 13;
+    o.f *= magic.f;
+    if (o.f >= infnan.f)
+    {
+        o.u |= 255 << 23;
+    }
+    o.u |= (in & 0x8000) << 16;
+    return o.f;
+}
+
+static float ref_affine_to_fp32(int32_t val, int32_t zeroPoint, float scale)
+{
+    return ((float)val - zeroPoint) * scale;
+}
+
+static void ref_type_get_range(int32_t type, double *max_range,
+                               double *min_range)
+{
+    int32_t bits = ref_type_get_bytes(type) * 8;
+
+    if (type == NI_AI_BUFFER_FORMAT_UINT8)
+    {
+        *min_range = 0.0;
+        *max_range = (double)((1UL << bits) - 1);
+    } else
+    {
+        *min_range = (double)(-(1L << (bits - 1)));
+        *max_range = (double)((1UL << (bits - 1)) - 1);
+    }
+}
+
+static double ref_abs(double x)
+{
+    return x < 0 ? -x : x;
+}
+
+static double ref_copy_sign(double number, double sign)
+{
+    double value = ref_abs(number);
+    return (sign > 0) ? value : (-value);
+}
+
+static int ref_math_floorf(double x)
+{
+    return x >= 0 ? (int)x : (int)x - 1;
+}
+
+static double ref_rint(double x)
+{
+    double decimal;
+    double inter;
+    int intpart;
+
+    intpart = (int)x;
+    decimal = x - intpart;
+    inter = (double)intpart;
+
+    if (ref_abs((ref_abs(decimal) - 0.5f)) < 1e-8)
+    {
+        inter += (int32_t)(inter) % 2;
+    } else
+    {
+        return ref_copy_sign(ref_math_floorf(ref_abs(x) + 0.5f), x);
+    }
+
+    return inter;
+}
+
+static int32_t ref_fp32_to_dfp(const float in, const signed char fl,
+                               const int32_t type)
+{
+    int32_t data;
+    double max_range;
+    double min_range;
+
+    ref_type_get_range(type, &max_range, &min_range);
+    if (fl > 0)
+    {
+        data = (int32_t)ref_rint(in * (float)(1 << fl));
+    } else
+    {
+        data = (int32_t)ref_rint(in * (1.0f / (float)(1 << -fl)));
+    }
+    data = ni_min(data, (int32_t)max_range);
+    data = ni_max(data, (int32_t)min_range);
+    return data;
+}
+
+static int32_t ref_fp32_to_affine(const float in, const float scale,
+                                  const int zero_point, const int32_t type)
+{
+    int32_t data;
+    double max_range;
+    double min_range;
+
+    ref_type_get_range(type, &max_range, &min_range);
+    data = (int32_t)(ref_rint(in / scale) + zero_point);
+    data = ni_max((int32_t)min_range, ni_min((int32_t)max_range, data));
+    return data;
+}
+
+static unsigned short ref_fp32_to_fp16(float in)
+{
+    uint32_t fp32 = 0;
+    uint32_t t1, t2, t3;
+    uint32_t fp16 = 0u;
+
+    memcpy(&fp32, &in, sizeof(uint32_t));
+
+    t1 = (fp32 & 0x80000000u) >> 16;
+    t2 = (fp32 & 0x7F800000u) >> 13;
+    t3 = (fp32 & 0x007FE000u) >> 13;
+
+    if (t2 >= 0x023c00u)
+    {
+        fp16 = t1 | 0x7BFF;
+    } else if (t2 <= 0x01c000u)
+    {
+        fp16 = t1;
+    } else
+    {
+        t2 -= 0x01c000u;
+        fp16 = t1 | t2 | t3;
+    }
+
+    return (unsigned short)fp16;
+}
+
+static void ref_float32_to_dtype(float src, unsigned char *dst,
+                                 const ni_network_layer_params_t *p_param)
+{
+    int32_t dst_value = 0;
+
+    switch (p_param->data_format)
+    {
+        case NI_AI_BUFFER_FORMAT_FP16:
+            *(uint16_t *)dst = ref_fp32_to_fp16(src);
+            break;
+        case NI_AI_BUFFER_FORMAT_INT8:
+        case NI_AI_BUFFER_FORMAT_UINT8:
+        case NI_AI_BUFFER_FORMAT_INT16:
+            if (p_param->quant_format == NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT)
+            {
+                dst_value = ref_fp32_to_dfp(
+                    src, (signed char)p_param->quant_data.dfp.fixed_point_pos,
+                    p_param->data_format);
+            } else
+            {
+                dst_value = ref_fp32_to_affine(
+                    src, p_param->quant_data.affine.scale,
+                    p_param->quant_data.affine.zeroPoint, p_param->data_format);
+            }
+            ref_integer_convert(&dst_value, dst, NI_AI_BUFFER_FORMAT_INT32,
+                                p_param->data_format);
+            break;
+        default:
+            break;
+    }
+}
+
+static float ref_dtype_to_float32(const uint8_t *data,
+                                  const ni_network_layer_params_t *p_param)
+{
+    int32_t src_value = 0;
+
+    switch (p_param->data_format)
+    {
+        case NI_AI_BUFFER_FORMAT_INT8:
+            if (p_param->quant_format == NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT)
+            {
+                return ref_int8_to_fp32(
+                    *data, (uint8_t)p_param->quant_data.dfp.fixed_point_pos);
+            }
+            ref_integer_convert(data, &src_value, NI_AI_BUFFER_FORMAT_INT8,
+                                NI_AI_BUFFER_FORMAT_INT32);
+            return ref_affine_to_fp32(src_value,
+                                      p_param->quant_data.affine.zeroPoint,
+                                      p_param->quant_data.affine.scale);
+        case NI_AI_BUFFER_FORMAT_UINT8:
+            return ref_uint8_to_fp32(*data, p_param->quant_data.affine.zeroPoint,
+                                     p_param->quant_data.affine.scale);
+        case NI_AI_BUFFER_FORMAT_INT16:
+            return ref_int16_to_fp32(
+                *((const short *)data),
+                (uint8_t)p_param->quant_data.dfp.fixed_point_pos);
+        case NI_AI_BUFFER_FORMAT_FP16:
+            return ref_fp16_to_fp32(*((const short *)data));
+        default:
+            return 0.0f;
+    }
+}
+
+/*
+ * Test driver
+ */
+typedef struct
+{
+    const char *name;
+    int32_t data_format;
+    int32_t quant_format;
+    int32_t fixed_point_pos;
+    float scale;
+    int32_t zero_point;
+} layer_case_t;
+
+static const layer_case_t cases[] = {
+    {"int8 dfp", NI_AI_BUFFER_FORMAT_INT8,
+     NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT, 4, 0.0f, 0},
+    {"int8 dfp neg", NI_AI_BUFFER_FORMAT_INT8,
+     NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT, -2, 0.0f, 0},
+    {"int8 affine", NI_AI_BUFFER_FORMAT_INT8, NI_AI_BUFFER_QUANTIZE_TF_ASYMM,
+     0, 0.0625f, -3},
+    {"uint8 affine", NI_AI_BUFFER_FORMAT_UINT8, NI_AI_BUFFER_QUANTIZE_TF_ASYMM,
+     0, 0.03125f, 128},
+    {"uint8 affine odd", NI_AI_BUFFER_FORMAT_UINT8,
+     NI_AI_BUFFER_QUANTIZE_TF_ASYMM, 0, 0.0173f, 37},
+    {"int16 dfp", NI_AI_BUFFER_FORMAT_INT16,
+     NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT, 8, 0.0f, 0},
+    {"int16 dfp neg", NI_AI_BUFFER_FORMAT_INT16,
+     NI_AI_BUFFER_QUANTIZE_DYNAMIC_FIXED_POINT, -1, 0.0f, 0},
+    {"fp16", NI_AI_BUFFER_FORMAT_FP16, NI_AI_BUFFER_QUANTIZE_NONE, 0, 0.0f, 0},
+};
+
+static uint32_t rand_state = 0x12345678;
+
+static uint32_t next_rand(void)
+{
+    rand_state = rand_state * 1664525u + 1013904223u;
+    return rand_state;
+}
+
+static void init_layer(ni_network_layer_params_t *p_param,
+                       const layer_case_t *p_case, uint32_t num)
+{
+    memset(p_param, 0, sizeof(*p_param));
+    p_param->num_of_dims = 1;
+    p_param->sizes[0] = num;
+    p_param->data_format = p_case->data_format;
+    p_param->quant_format = p_case->quant_format;
+    if (p_case->quant_format == NI_AI_BUFFER_QUANTIZE_TF_ASYMM)
+    {
+        p_param->quant_data.affine.scale = p_case->scale;
+        p_param->quant_data.affine.zeroPoint = p_case->zero_point;
+    } else
+    {
+        p_param->quant_data.dfp.fixed_point_pos = p_case->fixed_point_pos;
+    }
+}
+
+// fp32 input: exact halves around every rounding step, then random values
+// well inside and outside the quantized range
+static void fill_tensor(float *p_tensor, uint32_t num)
+{
+    uint32_t i;
+
+    for (i = 0; i < num; i++)
+    {
+        if (i < 512)
+        {
+            p_tensor[i] = ((float)i - 256.0f) / 64.0f;
+        } else
+        {
+            p_tensor[i] = ((float)(next_rand() >> 8) / (float)(1 << 24) -
+                           0.5f) * 2.0f * ((i & 1) ? MAX_ABS : 8.0f);
+        }
+    }
+}
+
+static void fill_data(uint8_t *p_data, uint32_t size)
+{
+    uint32_t i;
+
+    for (i = 0; i < size; i++)
+    {
+        p_data[i] = (uint8_t)(next_rand() >> 24);
+    }
+}
+
+static void test_case(const layer_case_t *p_case, uint32_t num)
+{
+    ni_network_layer_params_t param;
+    uint32_t type_size = ref_type_get_bytes(p_case->data_format);
+    uint32_t data_len = num * type_size;
+    float *p_tensor = malloc(num * sizeof(float));
+    float *p_out = malloc(num * sizeof(float));
+    uint8_t *p_data = malloc(data_len);
+    uint8_t *p_ref = malloc(data_len);
+    uint32_t i, mismatches;
+    float ref;
+
+    if (!p_tensor || !p_out || !p_data || !p_ref)
+    {
+        CHECK(0);
+        goto end;
+    }
+
+    init_layer(&param, p_case, num);
+
+    // quantization
+    fill_tensor(p_tensor, num);
+    memset(p_ref, 0, data_len);
+    for (i = 0; i < num; i++)
+    {
+        ref_float32_to_dtype(p_tensor[i], p_ref + i * type_size, &param);
+    }
+    CHECK(NI_RETCODE_SUCCESS ==
+          ni_network_convert_tensor_to_data(p_data, data_len, p_tensor,
+                                            num * sizeof(float), &param));
+    if (memcmp(p_data, p_ref, data_len) != 0)
+    {
+        fprintf(stderr, "%s x%u: quantization differs from scalar path\n",
+                p_case->name, num);
+        CHECK(0);
+    }
+
+    // dequantization, compared by bits so that NaN payloads count too
+    fill_data(p_data, data_len);
+    CHECK(NI_RETCODE_SUCCESS ==
+          ni_network_convert_data_to_tensor(p_out, num * sizeof(float), p_data,
+                                            data_len, &param));
+    for (i = 0, mismatches = 0; i < num; i++)
+    {
+        ref = ref_dtype_to_float32(p_data + i * type_size, &param);
+        if (memcmp(&ref, &p_out[i], sizeof(float)) != 0 && !mismatches++)
+        {
+            fprintf(stderr, "%s x%u: element %u dequantized %g, scalar %g\n",
+                    p_case->name, num, i, p_out[i], ref);
+        }
+    }
+    CHECK(0 == mismatches);
+
+end:
+    free(p_tensor);
+    free(p_out);
+    free(p_data);
+    free(p_ref);
+}
+
+// text tensor files went through fscanf("%f ") one element at a time
+static void test_tensor_file(void)
+{
+    const layer_case_t *p_case = &cases[0];
+    ni_network_layer_params_t param;
+    char path[] = "/tmp/ni_ai_convert_test_XXXXXX";
+    float tensor[NB_SMALL];
+    uint8_t data[NB_SMALL];
+    uint8_t ref[NB_SMALL];
+    FILE *fp;
+    float val;
+    int fd;
+    uint32_t i;
+
+    init_layer(&param, p_case, NB_SMALL);
+    fill_tensor(tensor, NB_SMALL);
+
+    fd = mkstemp(path);
+    CHECK(fd >= 0);
+    fp = fd >= 0 ? fdopen(fd, "w+") : NULL;
+    if (!fp)
+    {
+        CHECK(0);
+        return;
+    }
+    for (i = 0; i < NB_SMALL; i++)
+    {
+        fprintf(fp, "%s%.7g", (i % 8) ? " " : "\n", tensor[i]);
+    }
+    fflush(fp);
+    rewind(fp);
+
+    memset(ref, 0, sizeof(ref));
+    for (i = 0; i < NB_SMALL && fscanf(fp, "%f ", &val) == 1; i++)
+    {
+        ref_float32_to_dtype(val, &ref[i], &param);
+    }
+    CHECK(NB_SMALL == i);
+    fclose(fp);
+
+    CHECK(NI_RETCODE_SUCCESS ==
+          ni_network_layer_convert_tensor(data, sizeof(data), path, &param));
+    CHECK(0 == memcmp(data, ref, sizeof(data)));
+    remove(path);
+}
+
+int main(void)
+{
+    uint32_t i;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        test_case(&cases[i], NB_SMALL);
+    }
+
+    ni_network_set_convert_threads(4);
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        test_case(&cases[i], NB_LARGE);
+    }
+    ni_network_set_convert_threads(1);
+
+    test_tensor_file();
+
+    printf("ni_ai_convert_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,228 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_ai_nb_cache_test.c
+ *
+ *  \brief  Test of the network binary registry behind
+ *          ni_ai_config_network_binary() without a card: the instance config
+ *          and layer query are replaced at link time (-Wl,--wrap) by checks
+ *          of the uploaded buffer and hash. Covers files changed between
+ *          loads and truncated while uploading, and prints the load latency
+ *          of a binary hashed for the first time against a cached one.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_SIZE     (16 * 1024 * 1024 + 123)
+#define NB_LOADS    8
+
+static int failures;
+
+static struct
+{
+    const uint8_t *data;        // content the upload must carry
+    uint32_t size;
+    uint8_t sha256[32];
+    const char *truncate_path;  // truncated during the upload when set
+    int configs;
+} expect;
+
+ni_retcode_t __wrap_ni_config_instance_network_binary_hashed(
+    ni_session_context_t *p_ctx, void *nb_data, uint32_t nb_size,
+    const uint8_t *nb_sha256)
+{
+    uint32_t aligned = (nb_size + NI_MEM_PAGE_ALIGNMENT - 1) &
+        ~(NI_MEM_PAGE_ALIGNMENT - 1);
+    uint32_t i;
+    (void)p_ctx;
+
+    expect.configs++;
+    if (expect.truncate_path)
+    {
+        CHECK(truncate(expect.truncate_path, 0) == 0);
+    }
+    CHECK(((uintptr_t)nb_data & (NI_MEM_PAGE_ALIGNMENT - 1)) == 0);
+    CHECK(nb_size == expect.size);
+    CHECK(memcmp(nb_sha256, expect.sha256, 32) == 0);
+    if (nb_size == expect.size)
+    {
+        // every byte is read so a buffer backed by the file would fault here
+        CHECK(memcmp(nb_data, expect.data, nb_size) == 0);
+        for (i = nb_size; i < aligned; i++)
+        {
+            if (((uint8_t *)nb_data)[i])
+            {
+                CHECK(!"padding not zero");
+                break;
+            }
+        }
+    }
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t __wrap_ni_config_read_inout_layers(ni_session_context_t *p_ctx,
+                                                ni_network_data_t *p_network)
+{
+    (void)p_ctx;
+    (void)p_network;
+    return NI_RETCODE_SUCCESS;
+}
+
+static void write_file(const char *path, const uint8_t *data, uint32_t size)
+{
+    FILE *fp = fopen(path, "wb");
+
+    CHECK(fp != NULL);
+    if (fp)
+    {
+        CHECK(fwrite(data, size, 1, fp) == 1);
+        fclose(fp);
+    }
+}
+
+static void set_mtime(const char *path, time_t sec)
+{
+    struct timespec times[2];
+
+    times[0].tv_sec = times[1].tv_sec = sec;
+    times[0].tv_nsec = times[1].tv_nsec = 0;
+    CHECK(utimensat(AT_FDCWD, path, times, 0) == 0);
+}
+
+static void expect_content(const uint8_t *data, uint32_t size)
+{
+    expect.data = data;
+    expect.size = size;
+    ni_calculate_sha256(data, size, expect.sha256);
+}
+
+static uint64_t load(ni_session_context_t *p_ctx, const char *path)
+{
+    ni_network_data_t network;
+    uint64_t t0 = ni_gettime_ns();
+
+    memset(&network, 0, sizeof(network));
+    CHECK(ni_ai_config_network_binary(p_ctx, &network, path) ==
+          NI_RETCODE_SUCCESS);
+    return ni_gettime_ns() - t0;
+}
+
+int main(void)
+{
+    char path[] = "/tmp/ni_ai_nb_cache_test_XXXXXX";
+    char path_new[sizeof(path) + 4];
+    ni_session_context_t ctx;
+    uint8_t *data;
+    uint64_t cold = 0, warm = 0;
+    uint32_t seed = 1;
+    int fd;
+    int i;
+
+    ni_log_set_level(NI_LOG_NONE);
+    ni_device_session_context_init(&ctx);
+
+    data = (uint8_t *)malloc(NB_SIZE);
+    fd = mkstemp(path);
+    if (!data || fd < 0)
+    {
+        fprintf(stderr, "ni_ai_nb_cache_test: setup failed\n");
+        return 1;
+    }
+    close(fd);
+    snprintf(path_new, sizeof(path_new), "%s.new", path);
+    for (i = 0; i < NB_SIZE; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+
+    // load latency: a new file version is read and hashed, a known one
+    // is only read
+    write_file(path, data, NB_SIZE);
+    expect_content(data, NB_SIZE);
+    for (i = 0; i < NB_LOADS; i++)
+    {
+        set_mtime(path, 1000000 + i);
+        cold += load(&ctx, path);
+        warm += load(&ctx, path);
+    }
+    CHECK(expect.configs == 2 * NB_LOADS);
+    printf("ni_ai_nb_cache_test: %u byte binary, first load %.2f ms, "
+           "cached hash %.2f ms\n", NB_SIZE,
+           cold / 1e6 / NB_LOADS, warm / 1e6 / NB_LOADS);
+
+    // rewritten in place with new content, size and mtime
+    data[0] ^= 0xff;
+    write_file(path, data, NB_SIZE - 100);
+    set_mtime(path, 2000000);
+    expect_content(data, NB_SIZE - 100);
+    load(&ctx, path);
+
+    // replaced by rename, same size and mtime but a new inode
+    data[1] ^= 0xff;
+    write_file(path_new, data, NB_SIZE - 100);
+    set_mtime(path_new, 2000000);
+    CHECK(rename(path_new, path) == 0);
+    expect_content(data, NB_SIZE - 100);
+    load(&ctx, path);
+
+    // truncated while the copy is being uploaded
+    set_mtime(path, 3000000);
+    expect.truncate_path = path;
+    load(&ctx, path);
+    expect.truncate_path = NULL;
+
+    // the truncated file is a new version, too short to upload
+    {
+        ni_network_data_t network;
+        memset(&network, 0, sizeof(network));
+        CHECK(ni_ai_config_network_binary(&ctx, &network, path) !=
+              NI_RETCODE_SUCCESS);
+    }
+
+    unlink(path);
+    free(data);
+    ni_device_session_context_clear(&ctx);
+
+    printf("ni_ai_nb_cache_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
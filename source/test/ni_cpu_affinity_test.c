@@ -0,0 +1,251 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_cpu_affinity_test.c
+ *
+ *  \brief  Test of the placement of session threads on the CPUs local to a
+ *          card, without a card: ni_rsrc_get_local_cpus() is replaced at
+ *          link time (-Wl,--wrap) by a fixed local CPU list. Checks the
+ *          send and receive threads of a session are suggested different
+ *          local CPUs, spread over the sessions of the card, and prints the
+ *          send to receive handoff rate of two threads placed by
+ *          ni_device_session_pin_thread() on distinct CPUs, on one CPU and
+ *          left unpinned.
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_rsrc_api.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_HANDOFFS    20000
+
+static int failures;
+
+// local CPU list of the fake card
+static const int *g_local_cpus;
+static int g_nb_local_cpus;
+
+int __wrap_ni_rsrc_get_local_cpus(char *device_name, uint64_t *p_cpu_mask,
+                                  int mask_words)
+{
+    int i;
+
+    (void)device_name;
+    memset(p_cpu_mask, 0, sizeof(uint64_t) * mask_words);
+    for (i = 0; i < g_nb_local_cpus; i++)
+    {
+        p_cpu_mask[g_local_cpus[i] / 64] |= 1ULL << (g_local_cpus[i] % 64);
+    }
+    return g_nb_local_cpus;
+}
+
+static void open_ctx(ni_session_context_t *p_ctx)
+{
+    ni_device_session_context_init(p_ctx);
+    strcpy(p_ctx->blk_xcoder_name, "/dev/nvme0n1");
+    p_ctx->keep_alive_thread = pthread_self();
+}
+
+static void test_placement(void)
+{
+    // CPUs absent here, so pinning the keep alive thread has no effect
+    static const int cpus[] = {900, 901, 903};
+    static const int one_cpu[] = {950};
+    cpu_set_t before, after;
+    ni_session_context_t ctx[3];
+    int i;
+
+    sched_getaffinity(0, sizeof(before), &before);
+
+    // no local CPUs known: no suggestion, nothing pinned
+    g_nb_local_cpus = 0;
+    open_ctx(&ctx[0]);
+    ni_session_cpu_placement_init(&ctx[0]);
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_SEND) == -1);
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_RECV) == -1);
+    CHECK(ni_device_session_pin_thread(&ctx[0], NI_SESSION_THREAD_SEND) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(ni_device_session_pin_thread(&ctx[0], NI_SESSION_THREAD_NB) ==
+          NI_RETCODE_INVALID_PARAM);
+    sched_getaffinity(0, sizeof(after), &after);
+    CHECK(CPU_EQUAL(&before, &after));
+    ni_device_session_context_clear(&ctx[0]);
+
+    // the threads of a session go to different CPUs, sessions take turns
+    g_local_cpus = cpus;
+    g_nb_local_cpus = 3;
+    for (i = 0; i < 3; i++)
+    {
+        open_ctx(&ctx[i]);
+        ni_session_cpu_placement_init(&ctx[i]);
+        CHECK(ctx[i].nb_local_cpus == 3);
+        CHECK(ni_device_session_cpu_hint(&ctx[i], NI_SESSION_THREAD_SEND) !=
+              ni_device_session_cpu_hint(&ctx[i], NI_SESSION_THREAD_RECV));
+    }
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_SEND) == 900);
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_RECV) == 901);
+    CHECK(ni_device_session_cpu_hint(&ctx[1], NI_SESSION_THREAD_SEND) == 903);
+    CHECK(ni_device_session_cpu_hint(&ctx[1], NI_SESSION_THREAD_RECV) == 900);
+    CHECK(ni_device_session_cpu_hint(&ctx[2], NI_SESSION_THREAD_SEND) == 901);
+    CHECK(ni_device_session_cpu_hint(&ctx[2], NI_SESSION_THREAD_RECV) == 903);
+    for (i = 0; i < 3; i++)
+    {
+        ni_device_session_context_clear(&ctx[i]);
+    }
+
+    // a single local CPU is shared
+    g_local_cpus = one_cpu;
+    g_nb_local_cpus = 1;
+    open_ctx(&ctx[0]);
+    ni_session_cpu_placement_init(&ctx[0]);
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_SEND) == 950);
+    CHECK(ni_device_session_cpu_hint(&ctx[0], NI_SESSION_THREAD_RECV) == 950);
+    ni_device_session_context_clear(&ctx[0]);
+
+    sched_setaffinity(0, sizeof(before), &before);
+}
+
+// a send thread handing frames one at a time to a receive thread, as the
+// example send and receive threads of a low delay session do
+static struct
+{
+    ni_session_context_t *p_ctx;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int sent;
+    int received;
+    int pin_failed;
+} handoff;
+
+static void *recv_thread(void *arg)
+{
+    (void)arg;
+    if (ni_device_session_pin_thread(handoff.p_ctx, NI_SESSION_THREAD_RECV) !=
+        NI_RETCODE_SUCCESS)
+    {
+        handoff.pin_failed = 1;
+    }
+    pthread_mutex_lock(&handoff.mutex);
+    while (handoff.received < NB_HANDOFFS)
+    {
+        while (handoff.sent == handoff.received)
+        {
+            pthread_cond_wait(&handoff.cond, &handoff.mutex);
+        }
+        handoff.received++;
+        pthread_cond_signal(&handoff.cond);
+    }
+    pthread_mutex_unlock(&handoff.mutex);
+    return NULL;
+}
+
+static void bench(const char *what, int send_cpu, int recv_cpu)
+{
+    ni_session_context_t ctx;
+    cpu_set_t before;
+    pthread_t thread;
+    uint64_t t0, t1;
+
+    sched_getaffinity(0, sizeof(before), &before);
+    ni_device_session_context_init(&ctx);
+    if (send_cpu >= 0)
+    {
+        ctx.nb_local_cpus = 2;
+        ctx.thread_cpus[NI_SESSION_THREAD_SEND] = send_cpu;
+        ctx.thread_cpus[NI_SESSION_THREAD_RECV] = recv_cpu;
+    }
+    memset(&handoff, 0, sizeof(handoff));
+    handoff.p_ctx = &ctx;
+    pthread_mutex_init(&handoff.mutex, NULL);
+    pthread_cond_init(&handoff.cond, NULL);
+
+    CHECK(ni_device_session_pin_thread(&ctx, NI_SESSION_THREAD_SEND) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(pthread_create(&thread, NULL, recv_thread, NULL) == 0);
+    t0 = ni_gettime_ns();
+    pthread_mutex_lock(&handoff.mutex);
+    while (handoff.sent < NB_HANDOFFS)
+    {
+        handoff.sent++;
+        pthread_cond_signal(&handoff.cond);
+        while (handoff.received != handoff.sent)
+        {
+            pthread_cond_wait(&handoff.cond, &handoff.mutex);
+        }
+    }
+    pthread_mutex_unlock(&handoff.mutex);
+    t1 = ni_gettime_ns();
+    pthread_join(thread, NULL);
+    CHECK(!handoff.pin_failed);
+
+    printf("  %-13s %8.0f handoffs/s\n", what,
+           NB_HANDOFFS * 1e9 / (double)(t1 - t0));
+    pthread_cond_destroy(&handoff.cond);
+    pthread_mutex_destroy(&handoff.mutex);
+    ni_device_session_context_clear(&ctx);
+    sched_setaffinity(0, sizeof(before), &before);
+}
+
+int main(void)
+{
+    long nb_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    test_placement();
+
+    printf("ni_cpu_affinity_test: %d handoffs, %ld CPUs online\n",
+           NB_HANDOFFS, nb_cpus);
+    bench("unpinned", -1, -1);
+    bench("one CPU", 0, 0);
+    if (nb_cpus >= 2)
+    {
+        bench("distinct CPUs", 0, 1);
+    } else
+    {
+        printf("  %-13s skipped, needs 2 CPUs\n", "distinct CPUs");
+    }
+
+    printf("ni_cpu_affinity_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
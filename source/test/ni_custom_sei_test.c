@@ -0,0 +1,311 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_custom_sei_test.c
+ *
+ *  \brief  Differential test of the emulation prevention removal of
+ *          ni_extract_custom_sei() against the byte by byte loop it replaced,
+ *          kept here as the reference: escapes at the payload start, adjacent
+ *          escapes, an escape at the sei_size boundary, truncated packets and
+ *          random escape dense payloads. Also checks that
+ *          ni_custom_sei_set_dup() copies every entry in use.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_av_codec.h"
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_RANDOM   4000    // random packets
+#define SEI_TYPE    5       // user data unregistered
+#define PREFIX      6       // bytes before the payload size, see build_pkt()
+
+static int failures;
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int rnd_range(int lo, int hi)
+{
+    return lo + (int)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+// the payload extraction of ni_extract_custom_sei() before the run copies
+static int ref_extract_custom_sei(uint8_t *pkt_data, int pkt_size, long index,
+                                  ni_custom_sei_set_t *p_set, uint8_t sei_type,
+                                  int vcl_found)
+{
+    int i, len;
+    uint8_t *udata;
+    uint8_t *sei_data;
+    int sei_size;
+    ni_custom_sei_t *p_custom_sei;
+
+    if (p_set->count >= NI_MAX_CUSTOM_SEI_CNT)
+    {
+        return 0;
+    }
+    p_custom_sei = &p_set->custom_sei[p_set->count];
+    sei_data = &p_custom_sei->data[0];
+
+    sei_size = 0;
+    while (index < pkt_size && pkt_data[index] == 0xff)
+    {
+        sei_size += pkt_data[index++];
+    }
+    if (index >= pkt_size)
+    {
+        return NI_RETCODE_FAILURE;
+    }
+    sei_size += pkt_data[index++];
+    if (sei_size > NI_MAX_CUSTOM_SEI_DATA)
+    {
+        return 0;
+    }
+
+    udata = &pkt_data[index];
+    sei_data[0] = sei_type;
+    for (i = 0, len = 0; (i < pkt_size - index) && len < sei_size; i++, len++)
+    {
+        if (i >= 2 && udata[i - 2] == 0 && udata[i - 1] == 0 && udata[i] == 3)
+        {
+            len--;
+            continue;
+        }
+        sei_data[len] = udata[i];
+    }
+    if (len != sei_size)
+    {
+        return NI_RETCODE_FAILURE;
+    }
+
+    p_custom_sei->type = sei_type;
+    p_custom_sei->size = sei_size;
+    p_custom_sei->location =
+        vcl_found ? NI_CUSTOM_SEI_LOC_AFTER_VCL : NI_CUSTOM_SEI_LOC_BEFORE_VCL;
+    p_set->count++;
+    return 0;
+}
+
+// start code, NAL header and SEI type, then the payload size coded in 0xff
+// steps and the escaped payload; returns the packet size
+static int build_pkt(uint8_t *p_pkt, int sei_size, const uint8_t *p_ebsp,
+                     int ebsp_size)
+{
+    static const uint8_t prefix[PREFIX] = {0, 0, 0, 1, 0x06, SEI_TYPE};
+    int size = PREFIX;
+
+    memcpy(p_pkt, prefix, PREFIX);
+    for (; sei_size >= 0xff; sei_size -= 0xff)
+    {
+        p_pkt[size++] = 0xff;
+    }
+    p_pkt[size++] = (uint8_t)sei_size;
+    memcpy(p_pkt + size, p_ebsp, ebsp_size);
+    return size + ebsp_size;
+}
+
+// extract with both and compare results; returns the library's result
+static int check_extract(uint8_t *p_pkt, int pkt_size, const char *what)
+{
+    static ni_custom_sei_set_t ref_set;
+    ni_packet_t packet;
+    const ni_custom_sei_t *p_sei, *p_ref;
+    int ret, ref_ret;
+
+    memset(&packet, 0, sizeof(packet));
+    ref_set.count = 0;
+    ret = ni_extract_custom_sei(p_pkt, pkt_size, PREFIX, &packet, SEI_TYPE, 1);
+    ref_ret = ref_extract_custom_sei(p_pkt, pkt_size, PREFIX, &ref_set,
+                                     SEI_TYPE, 1);
+    CHECK(ret == ref_ret);
+    CHECK(packet.p_custom_sei_set != NULL);
+    if (!packet.p_custom_sei_set)
+    {
+        return ret;
+    }
+    CHECK(packet.p_custom_sei_set->count == ref_set.count);
+    if (packet.p_custom_sei_set->count == 1 && ref_set.count == 1)
+    {
+        p_sei = &packet.p_custom_sei_set->custom_sei[0];
+        p_ref = &ref_set.custom_sei[0];
+        CHECK(p_sei->type == p_ref->type && p_sei->size == p_ref->size &&
+              p_sei->location == p_ref->location);
+        CHECK(!memcmp(p_sei->data, p_ref->data, p_ref->size));
+    }
+    if (ret != ref_ret || packet.p_custom_sei_set->count != ref_set.count)
+    {
+        fprintf(stderr, "ni_custom_sei_test: %s differs\n", what);
+    }
+    free(packet.p_custom_sei_set);
+    return ret;
+}
+
+static void test_cases(void)
+{
+    static uint8_t pkt[64];
+    // 00 00 03 right at the payload start
+    static const uint8_t start[] = {0, 0, 3, 1, 2, 3, 4};
+    // a 03 in the first two bytes is never an escape
+    static const uint8_t early[] = {3, 0, 3, 0, 0, 3, 0, 9};
+    // adjacent escapes
+    static const uint8_t adjacent[] = {0, 0, 3, 0, 0, 3, 0, 0, 3, 1};
+    // 00 00 03 03: only the first 03 is an escape
+    static const uint8_t double03[] = {0, 0, 3, 3, 7};
+    // an escape right after the 4th payload byte, then a 5th byte
+    static const uint8_t boundary[] = {1, 2, 0, 0, 3, 9};
+    int size;
+
+    size = build_pkt(pkt, 6, start, sizeof(start));
+    CHECK(check_extract(pkt, size, "escape at start") == 0);
+    size = build_pkt(pkt, 7, early, sizeof(early));
+    CHECK(check_extract(pkt, size, "03 in the first bytes") == 0);
+    size = build_pkt(pkt, 7, adjacent, sizeof(adjacent));
+    CHECK(check_extract(pkt, size, "adjacent escapes") == 0);
+    size = build_pkt(pkt, 4, double03, sizeof(double03));
+    CHECK(check_extract(pkt, size, "00 00 03 03") == 0);
+    // sei_size 4 ends right before the escape, sei_size 5 reads past it
+    size = build_pkt(pkt, 4, boundary, sizeof(boundary));
+    CHECK(check_extract(pkt, size, "escape after sei_size") == 0);
+    size = build_pkt(pkt, 5, boundary, sizeof(boundary));
+    CHECK(check_extract(pkt, size, "escape at sei_size") == 0);
+    size = build_pkt(pkt, 5, boundary, 5);
+    CHECK(check_extract(pkt, size, "escape at sei_size, truncated") != 0);
+
+    // the payload ends early, right after an escape and inside the size
+    size = build_pkt(pkt, 7, adjacent, 6);
+    CHECK(check_extract(pkt, size, "truncated after escape") != 0);
+    size = build_pkt(pkt, 7, adjacent, 5);
+    CHECK(check_extract(pkt, size, "truncated before escape") != 0);
+    size = build_pkt(pkt, 300, start, 0);
+    CHECK(check_extract(pkt, size - 1, "truncated size") != 0);
+}
+
+static void test_random(void)
+{
+    static uint8_t ebsp[NI_MAX_CUSTOM_SEI_DATA + 64];
+    static uint8_t pkt[NI_MAX_CUSTOM_SEI_DATA + 128];
+    int n, i, sei_size, ebsp_size, pkt_size;
+
+    for (n = 0; n < NB_RANDOM; n++)
+    {
+        sei_size = rnd() % 4 ? rnd_range(0, 600) :
+                               rnd_range(0, NI_MAX_CUSTOM_SEI_DATA);
+        // a bit more than the payload, which escapes make longer
+        ebsp_size = sei_size + rnd_range(0, 32);
+        for (i = 0; i < ebsp_size; i++)
+        {
+            // mostly zeros and threes so that escapes are frequent
+            switch (rnd() % 5)
+            {
+                case 0:
+                case 1: ebsp[i] = 0; break;
+                case 2: ebsp[i] = 3; break;
+                default: ebsp[i] = (uint8_t)rnd(); break;
+            }
+        }
+        pkt_size = build_pkt(pkt, sei_size, ebsp, ebsp_size);
+        // now and then cut the packet anywhere
+        if (rnd() % 4 == 0)
+        {
+            pkt_size = rnd_range(PREFIX, pkt_size);
+        }
+        check_extract(pkt, pkt_size, "random packet");
+    }
+}
+
+static void test_set_dup(void)
+{
+    static const uint8_t payload[] = {0, 0, 3, 1, 0, 0, 3, 2, 9, 8, 7};
+    static uint8_t pkt[NI_MAX_CUSTOM_SEI_DATA + 128];
+    static uint8_t big[NI_MAX_CUSTOM_SEI_DATA];
+    ni_custom_sei_set_t *p_dup;
+    ni_packet_t packet;
+    int size, i;
+
+    memset(&packet, 0, sizeof(packet));
+    size = build_pkt(pkt, 9, payload, sizeof(payload));
+    CHECK(ni_extract_custom_sei(pkt, size, PREFIX, &packet, SEI_TYPE, 0) == 0);
+    for (i = 0; i < (int)sizeof(big); i++)
+    {
+        big[i] = (uint8_t)(i * 7 + 1);
+    }
+    size = build_pkt(pkt, sizeof(big), big, sizeof(big));
+    CHECK(ni_extract_custom_sei(pkt, size, PREFIX, &packet, 0x64, 1) == 0);
+    size = build_pkt(pkt, 0, big, 0);
+    CHECK(ni_extract_custom_sei(pkt, size, PREFIX, &packet, SEI_TYPE, 1) == 0);
+    CHECK(packet.p_custom_sei_set && packet.p_custom_sei_set->count == 3);
+    if (!packet.p_custom_sei_set)
+    {
+        return;
+    }
+
+    p_dup = ni_custom_sei_set_dup(packet.p_custom_sei_set);
+    CHECK(p_dup != NULL);
+    if (p_dup)
+    {
+        CHECK(p_dup->count == packet.p_custom_sei_set->count);
+        for (i = 0; i < p_dup->count; i++)
+        {
+            const ni_custom_sei_t *p_src =
+                &packet.p_custom_sei_set->custom_sei[i];
+            CHECK(p_dup->custom_sei[i].type == p_src->type);
+            CHECK(p_dup->custom_sei[i].location == p_src->location);
+            CHECK(p_dup->custom_sei[i].size == p_src->size);
+            CHECK(!memcmp(p_dup->custom_sei[i].data, p_src->data,
+                          p_src->size));
+        }
+        free(p_dup);
+    }
+    free(packet.p_custom_sei_set);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+
+    test_cases();
+    test_random();
+    test_set_dup();
+
+    printf("ni_custom_sei_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
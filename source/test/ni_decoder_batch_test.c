@@ -0,0 +1,389 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_decoder_batch_test.c
+ *
+ *  \brief  Test of ni_device_session_read_batch() on the decoder without a
+ *          card: the NVMe read and write commands are replaced at link time
+ *          (-Wl,--wrap) by a model of a decoder instance with a scripted
+ *          output resolution and a fixed service time per command. Checks
+ *          that a resolution change anywhere in a batch is re-read and that
+ *          the frames read after it are freed, and prints frames/s and
+ *          commands/frame of batch reads against single reads.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_nvme.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SESSION_ID     5
+#define WIDTH          160
+#define HEIGHT         90
+#define NEW_WIDTH      320
+#define NEW_HEIGHT     180
+#define NB_IO          16
+#define FRAMES_PER_DRAIN 4
+#define NB_DRAINS      500
+#define DEV_LATENCY_NS 20000
+
+static int failures;
+
+static struct
+{
+    ni_session_context_t *p_ctx; // session under test
+    int pending;            // frames ready in the instance
+    int frames_read;        // frames transferred so far
+    int change_at;          // first frame at the new resolution, -1 for none
+    int latency;            // model the device service time
+    long nb_cmds;           // commands sent
+} mock;
+
+static int metadata_hdr_size = NI_FW_META_DATA_SZ -
+    NI_MAX_NUM_OF_DECODER_OUTPUTS * sizeof(niFrameSurface1_t);
+
+static int new_resolution(void)
+{
+    return mock.change_at >= 0 && mock.frames_read >= mock.change_at;
+}
+
+static uint32_t yuv_size(int width, int height)
+{
+    ni_frame_t frame;
+
+    memset(&frame, 0, sizeof(frame));
+    ni_decoder_frame_buffer_alloc(NULL, &frame, 0, width, height, 1, 1, 1);
+    return frame.data_len[0] + frame.data_len[1] + frame.data_len[2];
+}
+
+// the instance transfers a frame in the layout the session last queried,
+// or in the stream's own once the session has reset it for a re-query
+static uint32_t transfer_yuv_size(void)
+{
+    if (mock.p_ctx->actual_video_width && mock.p_ctx->active_video_height)
+    {
+        return yuv_size(mock.p_ctx->actual_video_width,
+                        mock.p_ctx->active_video_height);
+    }
+    return new_resolution() ? yuv_size(NEW_WIDTH, NEW_HEIGHT) :
+                              yuv_size(WIDTH, HEIGHT);
+}
+
+int32_t __wrap_ni_nvme_send_read_cmd(ni_device_handle_t handle,
+                                     ni_event_handle_t event_handle,
+                                     void *p_data, uint32_t data_len,
+                                     uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    mock.nb_cmds++;
+    if (mock.latency)
+    {
+        struct timespec ts = {0, DEV_LATENCY_NS};
+        nanosleep(&ts, NULL);
+    }
+    if (lba ==
+        QUERY_INSTANCE_CUR_STATUS_INFO_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_session_statistic_t *p_stat = (ni_session_statistic_t *)p_data;
+
+        memset(p_data, 0, data_len);
+        p_stat->ui16SessionId = ni_htons(SESSION_ID);
+        p_stat->ui32RdBufAvailSize = ni_htonl(
+            mock.pending ? transfer_yuv_size() + metadata_hdr_size : 0);
+        return 0;
+    }
+    if (lba == QUERY_SESSION_STATS_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        memset(p_data, 0, data_len);
+        ((ni_session_stats_t *)p_data)->ui16SessionId = ni_htons(SESSION_ID);
+        return 0;
+    }
+    if (lba ==
+        QUERY_INSTANCE_STREAM_INFO_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_instance_mgr_stream_info_t *p_info =
+            (ni_instance_mgr_stream_info_t *)p_data;
+        int width = new_resolution() ? NEW_WIDTH : WIDTH;
+        int height = new_resolution() ? NEW_HEIGHT : HEIGHT;
+
+        memset(p_data, 0, data_len);
+        p_info->picture_width = ni_htons(width);
+        p_info->picture_height = ni_htons(height);
+        p_info->transfer_frame_stride = ni_htons(((width + 127) / 128) * 128);
+        p_info->transfer_frame_height = height;
+        p_info->pix_format = NI_PIX_FMT_YUV420P;
+        return 0;
+    }
+    if (lba == READ_INSTANCE_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_metadata_dec_frame_t *p_meta = (ni_metadata_dec_frame_t *)(
+            (uint8_t *)p_data + transfer_yuv_size());
+
+        if (!mock.pending)
+        {
+            fprintf(stderr, "frame read with none pending\n");
+            failures++;
+            return -1;
+        }
+        memset(p_meta, 0, metadata_hdr_size);
+        p_meta->metadata_common.frame_width =
+            new_resolution() ? NEW_WIDTH : WIDTH;
+        p_meta->metadata_common.frame_height =
+            new_resolution() ? NEW_HEIGHT : HEIGHT;
+        p_meta->metadata_common.frame_type = 1;
+        mock.pending--;
+        mock.frames_read++;
+        return 0;
+    }
+    fprintf(stderr, "unexpected read of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+int32_t __wrap_ni_nvme_send_write_cmd(ni_device_handle_t handle,
+                                      ni_event_handle_t event_handle,
+                                      void *p_data, uint32_t data_len,
+                                      uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    (void)p_data;
+    (void)data_len;
+    fprintf(stderr, "unexpected write of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+static void open_ctx(ni_session_context_t *p_ctx, ni_xcoder_params_t *p_param,
+                     int async_mode)
+{
+    ni_device_session_context_init(p_ctx);
+    memset(p_param, 0, sizeof(*p_param));
+    p_ctx->p_session_config = p_param;
+    p_ctx->device_type = NI_DEVICE_TYPE_DECODER;
+    p_ctx->session_id = SESSION_ID;
+    p_ctx->session_timestamp = 0;
+    p_ctx->codec_format = NI_CODEC_FORMAT_H264;
+    p_ctx->async_mode = async_mode;
+    p_ctx->last_access_time = ni_gettime_ns();
+    memcpy(&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6K", 2);
+    ni_timestamp_init(p_ctx, &p_ctx->pts_table, "dec_pts");
+    ni_timestamp_init(p_ctx, &p_ctx->dts_queue, "dec_dts");
+
+    // as after the first frame of the stream was read
+    p_ctx->active_video_width = ((WIDTH + 127) / 128) * 128;
+    p_ctx->active_video_height = HEIGHT;
+    p_ctx->actual_video_width = WIDTH;
+    p_ctx->pixel_format = NI_PIX_FMT_YUV420P;
+    p_ctx->bit_depth_factor = 1;
+    p_ctx->frame_num = 1;
+    p_ctx->pkt_num = 1;
+    ni_dec_fme_buffer_pool_initialize(p_ctx, NI_DEC_FRAME_BUF_POOL_SIZE_INIT,
+                                      WIDTH, HEIGHT, 1, 1);
+
+    memset(&mock, 0, sizeof(mock));
+    mock.p_ctx = p_ctx;
+    mock.change_at = -1;
+}
+
+static void close_ctx(ni_session_context_t *p_ctx)
+{
+    ni_queue_free(&p_ctx->pts_table->list, p_ctx->buffer_pool);
+    ni_memfree(p_ctx->pts_table);
+    ni_queue_free(&p_ctx->dts_queue->list, p_ctx->buffer_pool);
+    ni_memfree(p_ctx->dts_queue);
+    ni_buffer_pool_free(p_ctx->buffer_pool);
+    p_ctx->buffer_pool = NULL;
+    ni_dec_fme_buffer_pool_free(p_ctx->dec_fme_buf_pool);
+    p_ctx->dec_fme_buf_pool = NULL;
+    ni_device_session_context_clear(p_ctx);
+}
+
+// frames decoded by the instance, each with the dts of its packet
+static void decode(ni_session_context_t *p_ctx, int nb_frames)
+{
+    int i;
+
+    for (i = 0; i < nb_frames; i++)
+    {
+        ni_timestamp_register(p_ctx->buffer_pool, p_ctx->dts_queue,
+                              p_ctx->pkt_num * 100, 0);
+        p_ctx->pkt_num++;
+    }
+    mock.pending += nb_frames;
+}
+
+static void free_io(ni_session_data_io_t *p_io, int nb_io)
+{
+    int i;
+
+    for (i = 0; i < nb_io; i++)
+    {
+        ni_decoder_frame_buffer_free(&p_io[i].data.frame);
+    }
+}
+
+static void alloc_first(ni_session_context_t *p_ctx, ni_session_data_io_t *p_io)
+{
+    CHECK(ni_decoder_frame_buffer_alloc(
+              p_ctx->dec_fme_buf_pool, &p_io->data.frame, 1,
+              p_ctx->actual_video_width, p_ctx->active_video_height, 1,
+              p_ctx->bit_depth_factor, 1) == NI_RETCODE_SUCCESS);
+}
+
+// a frame at a new resolution is re-read wherever it is in the batch, and
+// the frames after it, laid out for the old resolution, are freed
+static void test_resolution_change(int change_at)
+{
+    ni_session_context_t ctx;
+    ni_xcoder_params_t param;
+    ni_session_data_io_t io[NB_IO];
+    int n, i;
+
+    open_ctx(&ctx, &param, 0);
+    memset(io, 0, sizeof(io));
+    alloc_first(&ctx, &io[0]);
+    decode(&ctx, FRAMES_PER_DRAIN + 1);
+    mock.change_at = change_at;
+
+    // the frame after the batch is there for the re-read
+    n = ni_device_session_read_batch(&ctx, io, FRAMES_PER_DRAIN,
+                                     NI_DEVICE_TYPE_DECODER);
+    CHECK(n == change_at + 1);
+    for (i = 0; i < n && i < NB_IO; i++)
+    {
+        CHECK(io[i].data.frame.p_buffer != NULL);
+        CHECK(io[i].data.frame.video_width == (i < change_at ? WIDTH :
+                                                               NEW_WIDTH));
+    }
+    for (; i < NB_IO; i++)
+    {
+        CHECK(io[i].data.frame.p_buffer == NULL);
+        CHECK(io[i].data.frame.dec_buf == NULL);
+    }
+    CHECK(ctx.actual_video_width == NEW_WIDTH);
+    CHECK(ctx.active_video_height == NEW_HEIGHT);
+    // the frame at the new resolution and the ones dropped were all taken
+    CHECK(mock.frames_read == FRAMES_PER_DRAIN + 1);
+    free_io(io, NB_IO);
+
+    // and the stream goes on at the new resolution
+    alloc_first(&ctx, &io[0]);
+    decode(&ctx, FRAMES_PER_DRAIN);
+    n = ni_device_session_read_batch(&ctx, io, NB_IO, NI_DEVICE_TYPE_DECODER);
+    CHECK(n == FRAMES_PER_DRAIN);
+    for (i = 0; i < n && i < NB_IO; i++)
+    {
+        CHECK(io[i].data.frame.video_width == NEW_WIDTH);
+    }
+    free_io(io, NB_IO);
+    close_ctx(&ctx);
+}
+
+static void bench(int batch, int async_mode)
+{
+    ni_session_context_t ctx;
+    ni_xcoder_params_t param;
+    ni_session_data_io_t io[NB_IO];
+    long frames = 0;
+    uint64_t t0, t1;
+    int r, n;
+
+    open_ctx(&ctx, &param, async_mode);
+    mock.latency = 1;
+    memset(io, 0, sizeof(io));
+    t0 = ni_gettime_ns();
+    for (r = 0; r < NB_DRAINS; r++)
+    {
+        decode(&ctx, FRAMES_PER_DRAIN);
+        if (batch)
+        {
+            alloc_first(&ctx, &io[0]);
+            n = ni_device_session_read_batch(&ctx, io, NB_IO,
+                                             NI_DEVICE_TYPE_DECODER);
+            CHECK(n >= 0);
+            frames += n > 0 ? n : 0;
+            free_io(io, NB_IO);
+        } else
+        {
+            do
+            {
+                alloc_first(&ctx, &io[0]);
+                n = ni_device_session_read(&ctx, &io[0],
+                                           NI_DEVICE_TYPE_DECODER);
+                CHECK(n >= 0);
+                frames += n > 0;
+                free_io(io, 1);
+            } while (n > 0);
+        }
+        CHECK(mock.pending == 0);
+        if (mock.pending)
+        {
+            break;
+        }
+    }
+    t1 = ni_gettime_ns();
+    CHECK(frames == (long)NB_DRAINS * FRAMES_PER_DRAIN);
+    printf("  %s %s: %6.0f frames/s, %.2f commands/frame\n",
+           batch ? "batch " : "single", async_mode ? "async" : "sync ",
+           frames * 1e9 / (double)(t1 - t0),
+           frames ? (double)mock.nb_cmds / frames : 0.0);
+    close_ctx(&ctx);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+
+    test_resolution_change(0);
+    test_resolution_change(1);
+    test_resolution_change(FRAMES_PER_DRAIN - 1);
+
+    printf("ni_decoder_batch_test: %dx%d, %d frames per drain, %d us per "
+           "command\n", WIDTH, HEIGHT, FRAMES_PER_DRAIN,
+           DEV_LATENCY_NS / 1000);
+    bench(0, 0);
+    bench(1, 0);
+    bench(0, 1);
+    bench(1, 1);
+
+    printf("ni_decoder_batch_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
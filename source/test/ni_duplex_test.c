@@ -0,0 +1,335 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_duplex_test.c
+ *
+ *  \brief  Stress test of the send and receive halves of a decoder session
+ *          without a card: the NVMe read and write commands are replaced at
+ *          link time (-Wl,--wrap) by a model of a decoder instance whose
+ *          queries and data transfers take a fixed time. A send thread
+ *          writes packets with ni_device_session_write(), a receive thread
+ *          reads hw frames with ni_device_session_read_hwdesc() and a third
+ *          thread keeps calling ni_device_dec_session_flush(). Checks every
+ *          frame arrives, that the flush never runs while a transfer is in
+ *          flight and, in async mode, that the transfers of the two
+ *          directions overlap. Prints frames/s of async mode against sync
+ *          mode, where one mutex serializes the whole session.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_nvme.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SESSION_ID        7
+#define NB_FRAMES         1000
+#define PACKET_SIZE       NI_MEM_PAGE_ALIGNMENT
+#define DEV_QUEUE_FRAMES  8         // device input buffer, in packets
+#define QUERY_NS          30000     // modelled query round trip
+#define TRANSFER_NS       400000    // modelled packet or frame transfer
+#define FLUSH_INTERVAL_US 20000
+
+static int failures;
+
+static struct
+{
+    ni_pthread_mutex_t mutex;
+    int pending;            // packets written and not read back as frames
+    int writes;
+    int reads;
+    int flushes;
+    int in_transfer;        // data transfers in flight
+    int overlaps;           // transfers started while another was in flight
+    int flush_violations;   // flushes issued while a transfer was in flight
+} mock;
+
+static volatile int stop;
+
+static void mock_sleep(long ns)
+{
+    struct timespec ts = {0, ns};
+    nanosleep(&ts, NULL);
+}
+
+static void transfer_begin(void)
+{
+    ni_pthread_mutex_lock(&mock.mutex);
+    if (mock.in_transfer++)
+    {
+        mock.overlaps++;
+    }
+    ni_pthread_mutex_unlock(&mock.mutex);
+}
+
+static void transfer_end(int pending_delta)
+{
+    ni_pthread_mutex_lock(&mock.mutex);
+    mock.in_transfer--;
+    mock.pending += pending_delta;
+    if (pending_delta > 0)
+    {
+        mock.writes++;
+    } else
+    {
+        mock.reads++;
+    }
+    ni_pthread_mutex_unlock(&mock.mutex);
+}
+
+int32_t __wrap_ni_nvme_send_read_cmd(ni_device_handle_t handle,
+                                     ni_event_handle_t event_handle,
+                                     void *p_data, uint32_t data_len,
+                                     uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    memset(p_data, 0, data_len);
+    if (lba == READ_INSTANCE_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        transfer_begin();
+        mock_sleep(TRANSFER_NS);
+        transfer_end(-1);
+        return 0;
+    }
+    mock_sleep(QUERY_NS);
+    if (lba ==
+        QUERY_INSTANCE_CUR_STATUS_INFO_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_session_statistic_t *p_stat = (ni_session_statistic_t *)p_data;
+        int pending;
+
+        ni_pthread_mutex_lock(&mock.mutex);
+        pending = mock.pending;
+        ni_pthread_mutex_unlock(&mock.mutex);
+        p_stat->ui16SessionId = ni_htons(SESSION_ID);
+        p_stat->ui32WrBufAvailSize =
+            ni_htonl(pending < DEV_QUEUE_FRAMES ? 1024 * 1024 : 0);
+        // a frame is read back as its hw descriptors and metadata
+        p_stat->ui32RdBufAvailSize = ni_htonl(pending ? NI_FW_META_DATA_SZ : 0);
+        return 0;
+    }
+    if (lba == QUERY_SESSION_STATS_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ((ni_session_stats_t *)p_data)->ui16SessionId = ni_htons(SESSION_ID);
+        return 0;
+    }
+    fprintf(stderr, "unexpected read of lba 0x%x\n", lba);
+    return -1;
+}
+
+int32_t __wrap_ni_nvme_send_write_cmd(ni_device_handle_t handle,
+                                      ni_event_handle_t event_handle,
+                                      void *p_data, uint32_t data_len,
+                                      uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    (void)p_data;
+    (void)data_len;
+    if (lba == WRITE_INSTANCE_W(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        transfer_begin();
+        mock_sleep(TRANSFER_NS);
+        transfer_end(1);
+        return 0;
+    }
+    if (lba == CONFIG_INSTANCE_Flush_W(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_pthread_mutex_lock(&mock.mutex);
+        mock.flushes++;
+        if (mock.in_transfer)
+        {
+            mock.flush_violations++;
+        }
+        ni_pthread_mutex_unlock(&mock.mutex);
+    }
+    mock_sleep(QUERY_NS);
+    return 0;
+}
+
+static void *send_thread(void *arg)
+{
+    ni_session_context_t *p_ctx = (ni_session_context_t *)arg;
+    ni_session_data_io_t io;
+    int sent = 0;
+    int ret;
+
+    memset(&io, 0, sizeof(io));
+    if (ni_packet_buffer_alloc(&io.data.packet, PACKET_SIZE))
+    {
+        stop = 1;
+        return NULL;
+    }
+    while (!stop && sent < NB_FRAMES)
+    {
+        io.data.packet.data_len = PACKET_SIZE;
+        ret = ni_device_session_write(p_ctx, &io, NI_DEVICE_TYPE_DECODER);
+        if (ret < 0)
+        {
+            fprintf(stderr, "send failed %d\n", ret);
+            stop = 1;
+        } else if (ret > 0)
+        {
+            sent++;
+        }
+    }
+    ni_packet_buffer_free(&io.data.packet);
+    return NULL;
+}
+
+static void *recv_thread(void *arg)
+{
+    ni_session_context_t *p_ctx = (ni_session_context_t *)arg;
+    ni_session_data_io_t io;
+    int ret;
+
+    memset(&io, 0, sizeof(io));
+    if (ni_frame_buffer_alloc(&io.data.frame, 1920, 1080, 0, 1, 1, 3, 0))
+    {
+        stop = 1;
+        return NULL;
+    }
+    while (!stop)
+    {
+        ret = ni_device_session_read_hwdesc(p_ctx, &io,
+                                            NI_DEVICE_TYPE_DECODER);
+        if (ret < 0)
+        {
+            fprintf(stderr, "recv failed %d\n", ret);
+            stop = 1;
+        }
+        ni_pthread_mutex_lock(&mock.mutex);
+        if (mock.reads >= NB_FRAMES)
+        {
+            stop = 1;
+        }
+        ni_pthread_mutex_unlock(&mock.mutex);
+    }
+    ni_frame_buffer_free(&io.data.frame);
+    return NULL;
+}
+
+static void *flush_thread(void *arg)
+{
+    ni_session_context_t *p_ctx = (ni_session_context_t *)arg;
+
+    while (!stop)
+    {
+        ni_usleep(FLUSH_INTERVAL_US);
+        ni_device_dec_session_flush(p_ctx);
+    }
+    return NULL;
+}
+
+static void run(int async_mode)
+{
+    ni_session_context_t ctx;
+    ni_xcoder_params_t param;
+    pthread_t threads[3];
+    uint64_t t0, ns;
+
+    ni_device_session_context_init(&ctx);
+    memset(&param, 0, sizeof(param));
+    ctx.p_session_config = &param;
+    ctx.device_type = NI_DEVICE_TYPE_DECODER;
+    ctx.session_id = SESSION_ID;
+    ctx.session_timestamp = 0;
+    ctx.async_mode = async_mode;
+    ctx.active_video_width = 1920;
+    ctx.active_video_height = 1080;
+    memcpy(&ctx.fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6r3", 3);
+    ni_timestamp_init(&ctx, &ctx.pts_table, "dec_pts");
+    ni_timestamp_init(&ctx, &ctx.dts_queue, "dec_dts");
+
+    ni_pthread_mutex_lock(&mock.mutex);
+    mock.pending = mock.writes = mock.reads = mock.flushes = 0;
+    mock.in_transfer = mock.overlaps = mock.flush_violations = 0;
+    ni_pthread_mutex_unlock(&mock.mutex);
+    stop = 0;
+
+    t0 = ni_gettime_ns();
+    CHECK(pthread_create(&threads[0], NULL, send_thread, &ctx) == 0);
+    CHECK(pthread_create(&threads[1], NULL, recv_thread, &ctx) == 0);
+    CHECK(pthread_create(&threads[2], NULL, flush_thread, &ctx) == 0);
+    pthread_join(threads[0], NULL);
+    pthread_join(threads[1], NULL);
+    ns = ni_gettime_ns() - t0;
+    stop = 1;
+    pthread_join(threads[2], NULL);
+
+    printf("  %-5s mode: %6.0f frames/s, %d flushes, %d overlapped "
+           "transfers\n", async_mode ? "async" : "sync",
+           mock.reads * 1e9 / (double)ns, mock.flushes, mock.overlaps);
+    CHECK(mock.writes == NB_FRAMES);
+    CHECK(mock.reads == NB_FRAMES);
+    CHECK(mock.flushes > 0);
+    CHECK(mock.flush_violations == 0);
+    if (async_mode)
+    {
+        // the receive transfers overlap the send transfers
+        CHECK(mock.overlaps > NB_FRAMES / 4);
+    } else
+    {
+        CHECK(mock.overlaps == 0);
+    }
+
+    ni_queue_free(&ctx.pts_table->list, ctx.buffer_pool);
+    ni_memfree(ctx.pts_table);
+    ni_queue_free(&ctx.dts_queue->list, ctx.buffer_pool);
+    ni_memfree(ctx.dts_queue);
+    ni_buffer_pool_free(ctx.buffer_pool);
+    ctx.buffer_pool = NULL;
+    ni_device_session_context_clear(&ctx);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+    ni_pthread_mutex_init(&mock.mutex);
+
+    printf("ni_duplex_test: %d frames, %d us per query, %d us per transfer\n",
+           NB_FRAMES, QUERY_NS / 1000, TRANSFER_NS / 1000);
+    run(0);
+    run(1);
+
+    ni_pthread_mutex_destroy(&mock.mutex);
+    printf("ni_duplex_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
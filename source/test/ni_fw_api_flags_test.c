@@ -0,0 +1,302 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_fw_api_flags_test.c
+ *
+ *  \brief  Test of the firmware API feature flags of a session. Each feature
+ *          is listed with the version string its call sites compared fw_rev
+ *          against before NI_FW_API_FEATURES, and for fw_rev values around
+ *          every one of those versions ni_fw_api_supports() must agree with
+ *          ni_cmp_fw_api_ver(), both from the flags evaluated at open and
+ *          from the compare fallback. Also checks that a decoder context
+ *          copied by ni_decoder_session_copy_internal() keeps the flags.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define MAX_REVS 1024
+
+typedef struct
+{
+    ni_fw_api_feature_t feature;
+    const char *ver;
+} feature_ver_t;
+
+// the versions of the ni_cmp_fw_api_ver() calls the features replaced
+static const feature_ver_t feature_vers[] = {
+    {NI_FW_API_SEQ_CHANGE_RESTART, "54"},
+    {NI_FW_API_SW_VERSION_SSIM, "62"},
+    {NI_FW_API_STACK_FILTER, "64"},
+    {NI_FW_API_SESSION_STATISTIC, "65"},
+    {NI_FW_API_DEC_WRITE_LEN, "66"},
+    {NI_FW_API_ROTATE_FILTER, "67"},
+    {NI_FW_API_TILED4X4_INPUT, "68"},
+    {NI_FW_API_AI_NETWORK_LAYER_V2, "6J"},
+    {NI_FW_API_AI_SESSION_STATISTIC, "6K"},
+    {NI_FW_API_INPLACE_OVERLAY, "6L"},
+    {NI_FW_API_AI_PERF_METRICS, "6N"},
+    {NI_FW_API_NVME_STATUS, "6O"},
+    {NI_FW_API_ENC_ZEROCOPY, "6Q"},
+    {NI_FW_API_UPLOADER_ZEROCOPY, "6S"},
+    {NI_FW_API_CRF_ANY_LOOKAHEAD, "6X"},
+    {NI_FW_API_RGBA_INPUT, "6Y"},
+    {NI_FW_API_DDR_PRIORITY, "6e"},
+    {NI_FW_API_VF_NS_ID, "6m"},
+    {NI_FW_API_ENC_META_6P, "6p"},
+    {NI_FW_API_SEMIPLANAR_ZEROCOPY, "6q"},
+    {NI_FW_API_ADAPTIVE_GOP_SIZE, "6r2"},
+    {NI_FW_API_LOW_DELAY_FRAMEPOOL, "6r3"},
+    {NI_FW_API_HWDL_SESSION_MUTEX, "6r8"},
+    {NI_FW_API_MAX_EXTRA_HW_FRAME, "6rB"},
+    {NI_FW_API_DDR_CONFIG_6RD, "6rD"},
+    {NI_FW_API_DEC_FIRST_METADATA, "6rE"},
+    {NI_FW_API_DDR_CONFIG_6RJ, "6rJ"},
+    {NI_FW_API_CLONE_HWFRAME, "6rL"},
+    {NI_FW_API_ADVANCED_EC_2, "6rO"},
+    {NI_FW_API_DEC_LOAD_BALANCE, "6rT"},
+    {NI_FW_API_ENC_ADDITIONAL_DELAY, "6rX"},
+    {NI_FW_API_ENC_META_6RC, "6rc"},
+    {NI_FW_API_HWDL_BY_FRAME_IDX, "6rd"},
+    {NI_FW_API_P2P, "6re"},
+    {NI_FW_API_UPLOADER_MODEL_LOAD, "6rf"},
+    {NI_FW_API_DEC_COMPLETE_INFO, "6rg"},
+    {NI_FW_API_ROI_QP_MAP_EXT, "6rh"},
+    {NI_FW_API_EC_LIMITED_ERROR, "6ri"},
+    {NI_FW_API_SURVIVE_STREAM_ERR, "6rl"},
+    {NI_FW_API_STILL_IMAGE_DETECT, "6rm"},
+    {NI_FW_API_HVSPLUS, "6ro"},
+    {NI_FW_API_REDUCE_DPB_DELAY, "6rs"},
+    {NI_FW_API_QUERY_BUFFER_AVAIL, "6rt"},
+    {NI_FW_API_COMPENSATE_QP, "6ru"},
+    {NI_FW_API_SPATIAL_LAYERS, "6rw"},
+    {NI_FW_API_PPU_RECONFIG, "6rx"},
+    {NI_FW_API_SPATIAL_LAYERS_REF_BASE, "6s0"},
+    {NI_FW_API_EC_BEST_EFFORT_OUT_DC, "6s1"},
+    {NI_FW_API_SCALER_PARAMS_BC, "6s2"},
+    {NI_FW_API_AI_IOVEC, "6s6"},
+    {NI_FW_API_PASS1_COST, "6sC"},
+    {NI_FW_API_MULTICORE_LAYER_BITRATE, "6sD"},
+    {NI_FW_API_DEC_PPU_RECONFIG, "6sF"},
+    {NI_FW_API_AI_ALIGN_FILTER, "6sI"},
+    {NI_FW_API_FILTERBLIT_5, "6sL"},
+    {NI_FW_API_ENC_META_6SM, "6sM"},
+    {NI_FW_API_DEC_FRAME_DROPPED, "6sP"},
+};
+
+#define NB_FEATURE_VERS ((int)(sizeof(feature_vers) / sizeof(feature_vers[0])))
+
+static int failures;
+static char revs[MAX_REVS][4];
+static int nb_revs;
+
+static void add_rev(char c0, char c1, char c2)
+{
+    if (nb_revs < MAX_REVS)
+    {
+        revs[nb_revs][0] = c0;
+        revs[nb_revs][1] = c1;
+        revs[nb_revs][2] = c2;
+        revs[nb_revs][3] = '\0';
+        nb_revs++;
+    }
+}
+
+// each version, its neighbours on the last character and other third
+// characters, as space filled fw_rev API versions
+static void make_revs(void)
+{
+    const char thirds[] = {' ', '0', '9', 'A', 'Z', 'a', 'z'};
+    int i, j;
+
+    nb_revs = 0;
+    for (i = 0; i < NB_FEATURE_VERS; i++)
+    {
+        const char *ver = feature_vers[i].ver;
+        char c2 = ver[2] ? ver[2] : ' ';
+
+        add_rev(ver[0], ver[1], c2);
+        add_rev(ver[0] - 1, ver[1], c2);
+        add_rev(ver[0] + 1, ver[1], c2);
+        add_rev(ver[0], ver[1] - 1, c2);
+        add_rev(ver[0], ver[1] + 1, c2);
+        if (ver[2])
+        {
+            add_rev(ver[0], ver[1], ver[2] - 1);
+            add_rev(ver[0], ver[1], ver[2] + 1);
+        }
+        for (j = 0; j < (int)sizeof(thirds); j++)
+        {
+            add_rev(ver[0], ver[1], thirds[j]);
+        }
+    }
+}
+
+static void set_fw_rev(ni_session_context_t *p_ctx, const char *rev)
+{
+    memcpy(p_ctx->fw_rev, "000     ", sizeof(p_ctx->fw_rev));
+    memcpy(&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], rev, 3);
+}
+
+static void test_table(void)
+{
+    int seen[NI_FW_API_FEATURE_NUM] = {0};
+    int i;
+
+    for (i = 0; i < NB_FEATURE_VERS; i++)
+    {
+        CHECK(feature_vers[i].feature > NI_FW_API_FLAGS_VALID &&
+              feature_vers[i].feature < NI_FW_API_FEATURE_NUM);
+        if (feature_vers[i].feature < NI_FW_API_FEATURE_NUM)
+        {
+            seen[feature_vers[i].feature]++;
+        }
+    }
+    // every feature is listed once
+    for (i = NI_FW_API_FLAGS_VALID + 1; i < NI_FW_API_FEATURE_NUM; i++)
+    {
+        CHECK(seen[i] == 1);
+    }
+}
+
+static void test_supports(void)
+{
+    ni_session_context_t *p_ctx;
+    int i, j, expected, mismatches = 0;
+
+    p_ctx = (ni_session_context_t *)calloc(1, sizeof(ni_session_context_t));
+    if (!p_ctx)
+    {
+        failures++;
+        return;
+    }
+
+    for (j = 0; j < nb_revs; j++)
+    {
+        set_fw_rev(p_ctx, revs[j]);
+        // compare fallback of a context whose fw_rev was set by the caller
+        memset(p_ctx->fw_api_flags, 0, sizeof(p_ctx->fw_api_flags));
+        for (i = 0; i < NB_FEATURE_VERS; i++)
+        {
+            expected = ni_cmp_fw_api_ver(
+                (char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
+                (char *)feature_vers[i].ver) >= 0;
+            if (ni_fw_api_supports(p_ctx, feature_vers[i].feature) != expected)
+            {
+                fprintf(stderr, "fw_rev %s %s: compare fallback %d, expected "
+                        "%d\n", revs[j], feature_vers[i].ver, !expected,
+                        expected);
+                mismatches++;
+            }
+        }
+
+        ni_fw_api_update_flags(p_ctx);
+        CHECK(p_ctx->fw_api_flags[0] & (1ULL << NI_FW_API_FLAGS_VALID));
+        for (i = 0; i < NB_FEATURE_VERS; i++)
+        {
+            expected = ni_cmp_fw_api_ver(
+                (char *)&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX],
+                (char *)feature_vers[i].ver) >= 0;
+            if (ni_fw_api_supports(p_ctx, feature_vers[i].feature) != expected)
+            {
+                fprintf(stderr, "fw_rev %s %s: flag %d, expected %d\n",
+                        revs[j], feature_vers[i].ver, !expected, expected);
+                mismatches++;
+            }
+        }
+    }
+    CHECK(mismatches == 0);
+
+    free(p_ctx);
+}
+
+static void test_copy(void)
+{
+    ni_session_context_t *p_src, *p_dst;
+    int i, j;
+
+    p_src = ni_device_session_context_alloc_init();
+    p_dst = ni_device_session_context_alloc_init();
+    CHECK(p_src && p_dst);
+    if (!p_src || !p_dst)
+    {
+        ni_device_session_context_free(p_src);
+        ni_device_session_context_free(p_dst);
+        return;
+    }
+
+    for (j = 0; j < nb_revs; j++)
+    {
+        set_fw_rev(p_src, revs[j]);
+        ni_fw_api_update_flags(p_src);
+        // stale flags of another firmware must not survive the copy
+        set_fw_rev(p_dst, j & 1 ? "6sP" : "540");
+        ni_fw_api_update_flags(p_dst);
+
+        CHECK(ni_decoder_session_copy_internal(p_src, p_dst) ==
+              NI_RETCODE_SUCCESS);
+        CHECK(memcmp(p_dst->fw_rev, p_src->fw_rev, sizeof(p_src->fw_rev)) ==
+              0);
+        CHECK(memcmp(p_dst->fw_api_flags, p_src->fw_api_flags,
+                     sizeof(p_src->fw_api_flags)) == 0);
+        for (i = 0; i < NB_FEATURE_VERS; i++)
+        {
+            CHECK(ni_fw_api_supports(p_dst, feature_vers[i].feature) ==
+                  ni_fw_api_supports(p_src, feature_vers[i].feature));
+        }
+    }
+
+    ni_device_session_context_free(p_src);
+    ni_device_session_context_free(p_dst);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+
+    make_revs();
+    test_table();
+    test_supports();
+    test_copy();
+
+    printf("ni_fw_api_flags_test: %d features, %d fw_rev values\n",
+           NB_FEATURE_VERS, nb_revs);
+    printf("ni_fw_api_flags_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,165 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_mem_cache_test.c
+ *
+ *  \brief  Test of the idle time limit of the packet and frame buffer cache.
+ *          clock_gettime() and posix_memalign() are replaced at link time
+ *          (-Wl,--wrap) to move the clock forward and to count the buffers
+ *          the cache allocates. Checks a recently returned buffer is reused,
+ *          and that one idle for longer than NI_MEM_CACHE_IDLE_TTL_MS is
+ *          freed by the next ni_mem_cache_get() of any size, or by
+ *          ni_mem_cache_expire() as called on session close, even when no
+ *          buffer is returned to the cache in between.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SMALL_SIZE  (64 * 1024)
+#define LARGE_SIZE  (1024 * 1024)
+#define TTL_NS      ((int64_t)NI_MEM_CACHE_IDLE_TTL_MS * 1000000)
+
+static int failures;
+static int64_t clock_offset_ns;
+static int nb_allocs;
+
+int __real_clock_gettime(clockid_t clk_id, struct timespec *tp);
+int __real_posix_memalign(void **memptr, size_t alignment, size_t size);
+
+int __wrap_clock_gettime(clockid_t clk_id, struct timespec *tp)
+{
+    int ret = __real_clock_gettime(clk_id, tp);
+    int64_t ns = (int64_t)tp->tv_sec * 1000000000 + tp->tv_nsec +
+        clock_offset_ns;
+
+    tp->tv_sec = (time_t)(ns / 1000000000);
+    tp->tv_nsec = (long)(ns % 1000000000);
+    return ret;
+}
+
+int __wrap_posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    nb_allocs++;
+    return __real_posix_memalign(memptr, alignment, size);
+}
+
+// get a buffer, and whether the cache had to allocate it
+static void *get(size_t size, int *p_allocated)
+{
+    int allocs = nb_allocs;
+    void *p_buf = ni_mem_cache_get(&size);
+
+    *p_allocated = nb_allocs != allocs;
+    return p_buf;
+}
+
+static void test_reuse(void)
+{
+    void *p_buf, *p_again;
+    int allocated;
+
+    p_buf = get(SMALL_SIZE, &allocated);
+    CHECK(p_buf && allocated);
+    ni_mem_cache_put(p_buf, SMALL_SIZE);
+
+    clock_offset_ns += TTL_NS / 2;
+    p_again = get(SMALL_SIZE, &allocated);
+    CHECK(p_again == p_buf && !allocated);
+    ni_mem_cache_put(p_again, SMALL_SIZE);
+}
+
+static void test_expire_on_get(void)
+{
+    void *p_small, *p_large;
+    int allocated;
+
+    p_small = get(SMALL_SIZE, &allocated);
+    ni_mem_cache_put(p_small, SMALL_SIZE);
+
+    // nothing is returned meanwhile, a get of another size ages it out
+    clock_offset_ns += TTL_NS + 1000000;
+    p_large = get(LARGE_SIZE, &allocated);
+    CHECK(p_large && allocated);
+    p_small = get(SMALL_SIZE, &allocated);
+    CHECK(p_small && allocated);
+
+    ni_mem_cache_put(p_small, SMALL_SIZE);
+    ni_mem_cache_put(p_large, LARGE_SIZE);
+}
+
+static void test_expire(void)
+{
+    void *p_buf;
+    int allocated;
+
+    p_buf = get(SMALL_SIZE, &allocated);
+    ni_mem_cache_put(p_buf, SMALL_SIZE);
+
+    clock_offset_ns += TTL_NS - 1000000;
+    ni_mem_cache_expire();
+    p_buf = get(SMALL_SIZE, &allocated);
+    CHECK(!allocated);
+    ni_mem_cache_put(p_buf, SMALL_SIZE);
+
+    clock_offset_ns += TTL_NS + 1000000;
+    ni_mem_cache_expire();
+    p_buf = get(SMALL_SIZE, &allocated);
+    CHECK(allocated);
+    ni_mem_cache_put(p_buf, SMALL_SIZE);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+    ni_set_huge_pages(0);
+
+    // start from an empty cache
+    ni_mem_cache_trim(0);
+    ni_mem_cache_trim(NI_MEM_CACHE_MAX_IDLE_BYTES);
+
+    test_reuse();
+    test_expire_on_get();
+    test_expire();
+
+    ni_mem_cache_trim(0);
+    printf("ni_mem_cache_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
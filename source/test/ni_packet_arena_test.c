@@ -0,0 +1,324 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_packet_arena_test.c
+ *
+ *  \brief  Test of the decoder input packet arena without a card: the NVMe
+ *          read and write commands are replaced at link time (-Wl,--wrap)
+ *          by a model of a decoder instance that always has room. Checks
+ *          ni_decoder_session_write() sends an arena slot in place with its
+ *          tail zero padded, that slots are recycled and shared by reference
+ *          and that a freed arena lives until its last packet is freed, and
+ *          prints packets/s of an arena slot against the
+ *          ni_packet_buffer_alloc() + ni_packet_copy() path it replaces.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_nvme.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SESSION_ID     5
+#define SLOT_SIZE      (1024 * 1024)
+#define NB_SLOTS       2
+#define WR_BUF_AVAIL   (16 * 1024 * 1024)
+#define NB_PACKETS     2000
+
+static int failures;
+
+static struct
+{
+    int writes;             // packet writes
+    const void *p_data;     // buffer of the last packet write
+    uint32_t data_len;      // length of the last packet write
+    int tail_zero;          // the last write was zero padded
+    uint32_t payload;       // payload bytes of the next write
+} mock;
+
+int32_t __wrap_ni_nvme_send_read_cmd(ni_device_handle_t handle,
+                                     ni_event_handle_t event_handle,
+                                     void *p_data, uint32_t data_len,
+                                     uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    memset(p_data, 0, data_len);
+    if (lba ==
+        QUERY_INSTANCE_CUR_STATUS_INFO_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ni_session_statistic_t *p_stat = (ni_session_statistic_t *)p_data;
+        p_stat->ui16SessionId = ni_htons(SESSION_ID);
+        p_stat->ui32WrBufAvailSize = ni_htonl(WR_BUF_AVAIL);
+        return 0;
+    }
+    if (lba == QUERY_SESSION_STATS_R(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        ((ni_session_stats_t *)p_data)->ui16SessionId = ni_htons(SESSION_ID);
+        return 0;
+    }
+    fprintf(stderr, "unexpected read of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+int32_t __wrap_ni_nvme_send_write_cmd(ni_device_handle_t handle,
+                                      ni_event_handle_t event_handle,
+                                      void *p_data, uint32_t data_len,
+                                      uint32_t lba)
+{
+    uint32_t i;
+
+    (void)handle;
+    (void)event_handle;
+    if (lba == WRITE_INSTANCE_W(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        mock.writes++;
+        mock.p_data = p_data;
+        mock.data_len = data_len;
+        mock.tail_zero = 1;
+        for (i = mock.payload; i < data_len; i++)
+        {
+            if (((const uint8_t *)p_data)[i])
+            {
+                mock.tail_zero = 0;
+                break;
+            }
+        }
+        return 0;
+    }
+    if (lba == CONFIG_INSTANCE_SetPktSize_W(SESSION_ID, NI_DEVICE_TYPE_DECODER))
+    {
+        return 0;
+    }
+    fprintf(stderr, "unexpected write of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+static void open_ctx(ni_session_context_t *p_ctx, ni_xcoder_params_t *p_param)
+{
+    ni_device_session_context_init(p_ctx);
+    memset(p_param, 0, sizeof(*p_param));
+    p_ctx->p_session_config = p_param;
+    p_ctx->device_type = NI_DEVICE_TYPE_DECODER;
+    p_ctx->session_id = SESSION_ID;
+    p_ctx->session_timestamp = 0;
+    memcpy(&p_ctx->fw_rev[NI_XCODER_REVISION_API_MAJOR_VER_IDX], "6K", 2);
+    ni_timestamp_init(p_ctx, &p_ctx->dts_queue, "dec_dts");
+    memset(&mock, 0, sizeof(mock));
+}
+
+static void close_ctx(ni_session_context_t *p_ctx)
+{
+    ni_queue_free(&p_ctx->dts_queue->list, p_ctx->buffer_pool);
+    ni_memfree(p_ctx->dts_queue);
+    ni_buffer_pool_free(p_ctx->buffer_pool);
+    p_ctx->buffer_pool = NULL;
+    ni_device_session_context_clear(p_ctx);
+}
+
+static int send_packet(ni_session_context_t *p_ctx, ni_packet_t *p_packet,
+                       int size)
+{
+    ni_session_data_io_t io;
+    int ret;
+
+    memset(&io, 0, sizeof(io));
+    io.data.packet = *p_packet;
+    io.data.packet.data_len = size;
+    mock.payload = size;
+    ret = ni_device_session_write(p_ctx, &io, NI_DEVICE_TYPE_DECODER);
+    p_packet->data_len = io.data.packet.data_len;
+    return ret;
+}
+
+static void test_in_place(void)
+{
+    ni_session_context_t ctx;
+    ni_xcoder_params_t param;
+    ni_packet_arena_t *p_arena;
+    ni_packet_t pkt, pkt2, pkt3;
+    void *p_slot0;
+
+    open_ctx(&ctx, &param);
+    p_arena = ni_packet_arena_alloc(SLOT_SIZE - 100, NB_SLOTS);
+    CHECK(p_arena != NULL);
+    if (!p_arena)
+    {
+        close_ctx(&ctx);
+        return;
+    }
+    CHECK(p_arena->slot_size == SLOT_SIZE);
+
+    memset(&pkt, 0, sizeof(pkt));
+    memset(&pkt2, 0, sizeof(pkt2));
+    memset(&pkt3, 0, sizeof(pkt3));
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt, SLOT_SIZE + 1) ==
+          NI_RETCODE_ERROR_MEM_ALOC);
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt, 1000) ==
+          NI_RETCODE_SUCCESS);
+    p_slot0 = pkt.p_data;
+    CHECK(((uintptr_t)p_slot0 % NI_MEM_PAGE_ALIGNMENT) == 0);
+
+    // the slot is sent in place, its sub-page tail zeroed over stale bytes
+    memset(pkt.p_data, 0xa5, SLOT_SIZE);
+    CHECK(send_packet(&ctx, &pkt, 1000) == 1000);
+    CHECK(mock.writes == 1);
+    CHECK(mock.p_data == p_slot0);
+    CHECK(mock.data_len == NI_MEM_PAGE_ALIGNMENT);
+    CHECK(mock.tail_zero);
+    CHECK(pkt.data_len == 0);
+
+    // a page multiple is sent as is
+    CHECK(send_packet(&ctx, &pkt, 2 * NI_MEM_PAGE_ALIGNMENT) ==
+          2 * NI_MEM_PAGE_ALIGNMENT);
+    CHECK(mock.p_data == p_slot0);
+    CHECK(mock.data_len == 2 * NI_MEM_PAGE_ALIGNMENT);
+
+    // the second slot, then the arena is exhausted
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt2, 1000) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(pkt2.p_data != p_slot0);
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt3, 1000) ==
+          NI_RETCODE_ERROR_MEM_ALOC);
+
+    // a shared slot is recycled when its last reference goes
+    CHECK(ni_packet_arena_ref(&pkt, &pkt3) == NI_RETCODE_SUCCESS);
+    CHECK(pkt3.p_data == p_slot0);
+    ni_packet_buffer_free(&pkt);
+    CHECK(p_arena->nb_free == 0);
+    ni_packet_buffer_free(&pkt3);
+    CHECK(p_arena->nb_free == 1);
+    CHECK(pkt3.p_arena == NULL && pkt3.p_buffer == NULL);
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt, 1000) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(pkt.p_data == p_slot0);
+
+    // a freed arena hands out no slot and goes with its last packet
+    ni_packet_arena_free(p_arena);
+    CHECK(ni_packet_arena_get_buffer(p_arena, &pkt3, 1000) ==
+          NI_RETCODE_ERROR_MEM_ALOC);
+    memset(pkt2.p_data, 0x5a, 1000);
+    CHECK(send_packet(&ctx, &pkt2, 1000) == 1000);
+    CHECK(mock.p_data == pkt2.p_data);
+    ni_packet_buffer_free(&pkt);
+    ni_packet_buffer_free(&pkt2);
+
+    close_ctx(&ctx);
+}
+
+static void report(const char *what, int size, uint64_t ns)
+{
+    printf("  %-6s %7d bytes: %9.0f packets/s\n", what, size,
+           NB_PACKETS * 1e9 / (double)ns);
+}
+
+// the example parses a packet into a scratch buffer and copies it into a
+// packet buffer allocated per packet; with an arena it parses into the slot
+static void bench(int size)
+{
+    ni_session_context_t ctx;
+    ni_xcoder_params_t param;
+    ni_packet_arena_t *p_arena;
+    ni_packet_t pkt;
+    uint8_t *p_src, *p_tmp, *p_leftover;
+    int prev_size;
+    uint64_t t0;
+    int i;
+
+    p_src = malloc(size);
+    p_tmp = malloc(size);
+    p_leftover = malloc(NI_MEM_PAGE_ALIGNMENT);
+    p_arena = ni_packet_arena_alloc(SLOT_SIZE, NB_SLOTS);
+    CHECK(p_src && p_tmp && p_leftover && p_arena);
+    if (!p_src || !p_tmp || !p_leftover || !p_arena)
+    {
+        goto end;
+    }
+    memset(p_src, 0x11, size);
+    memset(&pkt, 0, sizeof(pkt));
+
+    open_ctx(&ctx, &param);
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_PACKETS; i++)
+    {
+        memcpy(p_tmp, p_src, size);
+        prev_size = 0;
+        CHECK(ni_packet_buffer_alloc(&pkt, size) == NI_RETCODE_SUCCESS);
+        ni_packet_copy(pkt.p_data, p_tmp, size, p_leftover, &prev_size);
+        CHECK(send_packet(&ctx, &pkt, size) == size);
+        ni_packet_buffer_free(&pkt);
+    }
+    report("copy", size, ni_gettime_ns() - t0);
+    close_ctx(&ctx);
+
+    open_ctx(&ctx, &param);
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_PACKETS; i++)
+    {
+        CHECK(ni_packet_arena_get_buffer(p_arena, &pkt, size) ==
+              NI_RETCODE_SUCCESS);
+        memcpy(pkt.p_data, p_src, size);
+        CHECK(send_packet(&ctx, &pkt, size) == size);
+        ni_packet_buffer_free(&pkt);
+    }
+    report("arena", size, ni_gettime_ns() - t0);
+    CHECK(mock.writes == NB_PACKETS);
+    CHECK(p_arena->nb_free == NB_SLOTS);
+    close_ctx(&ctx);
+
+end:
+    ni_packet_arena_free(p_arena);
+    free(p_src);
+    free(p_tmp);
+    free(p_leftover);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+
+    test_in_place();
+    printf("ni_packet_arena_test: %d packets per size\n", NB_PACKETS);
+    bench(16 * 1024 + 100);
+    bench(256 * 1024 + 100);
+    bench(SLOT_SIZE - 100);
+
+    printf("ni_packet_arena_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
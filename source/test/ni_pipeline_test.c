@@ -0,0 +1,432 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_pipeline_test.c
+ *
+ *  \brief  Test of ni_pipeline.h without a card: the device calls made by the
+ *          pipeline are replaced at link time (-Wl,--wrap) by a model of a
+ *          decoder, a scaler and encoders that hand out hw frames from small
+ *          per-session pools and check every recycle against them
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_log.h"
+#include "ni_pipeline.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_PACKETS      200
+#define POOL_SIZE       8
+#define DEVICE_HANDLE   7
+#define DEC_SESSION_ID  1
+#define SCA_SESSION_ID  2
+#define META_SIZE       64
+#define ENC_DELAY       3    // frames an encoder holds before handing back
+#define SRC_WIDTH       1280
+#define SRC_HEIGHT      720
+#define SCA_WIDTH       640
+#define SCA_HEIGHT      360
+
+static int failures;
+static ni_pthread_mutex_t mock_mutex;
+
+// frames of one producer session, index 1..POOL_SIZE
+typedef struct
+{
+    uint16_t session_id;
+    int in_use[POOL_SIZE + 1];
+    int recycled;
+} mock_pool_t;
+
+static mock_pool_t dec_pool = {DEC_SESSION_ID};
+static mock_pool_t sca_pool = {SCA_SESSION_ID};
+
+typedef struct
+{
+    uint16_t fifo[NB_PACKETS + 1];
+    int head, tail;
+    int eos_sent;
+    int eos_width, eos_height;
+    int packets, eos;
+} mock_encoder_t;
+
+static ni_session_context_t dec_ctx, sca_ctx, enc_ctx[2];
+static mock_encoder_t mock_enc[2];
+static ni_xcoder_params_t enc_params;
+static int dec_packets_sent, dec_frames_out, dec_eos_sent;
+static int packets_read;
+static int opened_on_frame;
+
+static int mock_pool_get(mock_pool_t *p_pool)
+{
+    int i;
+    for (i = 1; i <= POOL_SIZE; i++)
+    {
+        if (!p_pool->in_use[i])
+        {
+            p_pool->in_use[i] = 1;
+            return i;
+        }
+    }
+    return 0;
+}
+
+static mock_pool_t *mock_pool_of(const niFrameSurface1_t *p_surface)
+{
+    CHECK(p_surface->device_handle == DEVICE_HANDLE);
+    return p_surface->ui16session_ID == DEC_SESSION_ID ? &dec_pool : &sca_pool;
+}
+
+static void mock_surface(niFrameSurface1_t *p_surface, uint16_t session_id,
+                         uint16_t idx, int width, int height)
+{
+    memset(p_surface, 0, sizeof(*p_surface));
+    p_surface->ui16FrameIdx = idx;
+    p_surface->ui16session_ID = session_id;
+    p_surface->device_handle = DEVICE_HANDLE;
+    p_surface->ui16width = width;
+    p_surface->ui16height = height;
+}
+
+static mock_encoder_t *mock_encoder_of(ni_session_context_t *p_ctx)
+{
+    return p_ctx == &enc_ctx[0] ? &mock_enc[0] : &mock_enc[1];
+}
+
+ni_retcode_t __wrap_ni_hwframe_buffer_recycle2(niFrameSurface1_t *surface)
+{
+    mock_pool_t *p_pool;
+
+    ni_pthread_mutex_lock(&mock_mutex);
+    p_pool = mock_pool_of(surface);
+    CHECK(surface->ui16FrameIdx >= 1 && surface->ui16FrameIdx <= POOL_SIZE);
+    CHECK(p_pool->in_use[surface->ui16FrameIdx]);
+    p_pool->in_use[surface->ui16FrameIdx] = 0;
+    p_pool->recycled++;
+    ni_pthread_mutex_unlock(&mock_mutex);
+    return NI_RETCODE_SUCCESS;
+}
+
+int __wrap_ni_device_session_write(ni_session_context_t *p_ctx,
+                                   ni_session_data_io_t *p_data,
+                                   ni_device_type_t device_type)
+{
+    int ret = 0;
+
+    ni_pthread_mutex_lock(&mock_mutex);
+    if (NI_DEVICE_TYPE_DECODER == device_type)
+    {
+        ni_packet_t *p_packet = &p_data->data.packet;
+        CHECK(p_packet->start_of_stream == (0 == dec_packets_sent));
+        if (p_packet->end_of_stream)
+        {
+            dec_eos_sent = 1;
+            p_ctx->ready_to_close = 1;
+        } else
+        {
+            dec_packets_sent++;
+            ret = (int)p_packet->data_len;
+        }
+    } else
+    {
+        ni_frame_t *p_frame = &p_data->data.frame;
+        mock_encoder_t *p_enc = mock_encoder_of(p_ctx);
+        CHECK(p_ctx->hw_action);
+        if (p_frame->end_of_stream)
+        {
+            p_enc->eos_sent = 1;
+            p_enc->eos_width = (int)p_frame->video_width;
+            p_enc->eos_height = (int)p_frame->video_height;
+            p_ctx->ready_to_close = 1;
+        } else
+        {
+            niFrameSurface1_t *p_surface = (niFrameSurface1_t *)p_frame->p_data[3];
+            CHECK(p_surface->ui16session_ID ==
+                  (p_enc == &mock_enc[0] ? DEC_SESSION_ID : SCA_SESSION_ID));
+            p_enc->fifo[p_enc->tail++] = p_surface->ui16FrameIdx;
+            ret = (int)sizeof(niFrameSurface1_t);
+        }
+    }
+    ni_pthread_mutex_unlock(&mock_mutex);
+    return ret;
+}
+
+int __wrap_ni_device_session_read_hwdesc(ni_session_context_t *p_ctx,
+                                         ni_session_data_io_t *p_data,
+                                         ni_device_type_t device_type)
+{
+    ni_frame_t *p_frame = &p_data->data.frame;
+    niFrameSurface1_t *p_surface = (niFrameSurface1_t *)p_frame->p_data[3];
+    int idx, ret = 0;
+
+    ni_pthread_mutex_lock(&mock_mutex);
+    if (NI_DEVICE_TYPE_DECODER == device_type)
+    {
+        p_frame->end_of_stream = 0;
+        if (dec_frames_out < dec_packets_sent)
+        {
+            // a full pool stalls the decoder like the device does
+            idx = mock_pool_get(&dec_pool);
+            if (idx)
+            {
+                mock_surface(p_surface, DEC_SESSION_ID, idx, SRC_WIDTH,
+                             SRC_HEIGHT);
+                p_frame->pts = dec_frames_out++;
+                ret = (int)sizeof(niFrameSurface1_t);
+            }
+        } else if (dec_eos_sent)
+        {
+            p_frame->end_of_stream = 1;
+        }
+    } else
+    {
+        CHECK(p_ctx == &sca_ctx);
+        idx = mock_pool_get(&sca_pool);
+        CHECK(idx);
+        mock_surface(p_surface, SCA_SESSION_ID, idx, SCA_WIDTH, SCA_HEIGHT);
+        ret = (int)sizeof(niFrameSurface1_t);
+    }
+    ni_pthread_mutex_unlock(&mock_mutex);
+    return ret;
+}
+
+int __wrap_ni_device_session_read(ni_session_context_t *p_ctx,
+                                  ni_session_data_io_t *p_data,
+                                  ni_device_type_t device_type)
+{
+    ni_packet_t *p_packet = &p_data->data.packet;
+    mock_encoder_t *p_enc = mock_encoder_of(p_ctx);
+    int ret = 0;
+
+    CHECK(NI_DEVICE_TYPE_ENCODER == device_type);
+    ni_pthread_mutex_lock(&mock_mutex);
+    p_packet->recycle_index = 0;
+    p_packet->end_of_stream = 0;
+    if (p_enc->tail - p_enc->head > ENC_DELAY ||
+        (p_enc->eos_sent && p_enc->head < p_enc->tail))
+    {
+        p_packet->recycle_index = p_enc->fifo[p_enc->head++];
+        p_packet->data_len = META_SIZE + 100;
+        ret = META_SIZE + 100;
+    } else if (p_enc->eos_sent)
+    {
+        p_packet->end_of_stream = 1;
+    }
+    ni_pthread_mutex_unlock(&mock_mutex);
+    return ret;
+}
+
+ni_retcode_t __wrap_ni_scaler_input_frame_alloc(ni_session_context_t *p_ctx,
+                                                ni_scaler_input_params_t params,
+                                                niFrameSurface1_t *p_src_surface)
+{
+    CHECK(p_ctx == &sca_ctx);
+    CHECK(p_src_surface->ui16session_ID == DEC_SESSION_ID);
+    CHECK(params.input_width == SRC_WIDTH && params.input_height == SRC_HEIGHT);
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t __wrap_ni_scaler_dest_frame_alloc(ni_session_context_t *p_ctx,
+                                               ni_scaler_input_params_t params,
+                                               niFrameSurface1_t *p_surface)
+{
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t __wrap_ni_scaler_frame_pool_alloc(ni_session_context_t *p_ctx,
+                                               ni_scaler_input_params_t params)
+{
+    return NI_RETCODE_SUCCESS;
+}
+
+static int read_packet(void *opaque, ni_packet_t *p_packet)
+{
+    if (packets_read == NB_PACKETS)
+    {
+        p_packet->end_of_stream = 1;
+        return 1;
+    }
+    if (ni_packet_buffer_alloc(p_packet, 1000))
+    {
+        return -1;
+    }
+    p_packet->data_len = 1000;
+    packets_read++;
+    return 1;
+}
+
+static int write_packet(void *opaque, int node_id, ni_packet_t *p_packet,
+                        int meta_size)
+{
+    mock_encoder_t *p_enc = (mock_encoder_t *)opaque;
+
+    CHECK(meta_size == META_SIZE);
+    if (p_packet->end_of_stream)
+    {
+        p_enc->eos++;
+    } else
+    {
+        CHECK((int)p_packet->data_len == META_SIZE + 100);
+        p_enc->packets++;
+    }
+    return 0;
+}
+
+// deferred open of the encoder behind the scaler, on its first frame
+static int open_encoder(void *opaque, int node_id,
+                        ni_session_context_t *p_enc_ctx,
+                        const niFrameSurface1_t *p_surface)
+{
+    CHECK(p_surface->ui16session_ID == SCA_SESSION_ID);
+    opened_on_frame = p_surface->ui16FrameIdx;
+    enc_params.source_width = p_surface->ui16width;
+    enc_params.source_height = p_surface->ui16height;
+    p_enc_ctx->p_session_config = &enc_params;
+    p_enc_ctx->hw_action = NI_CODEC_HW_ENABLE;
+    p_enc_ctx->meta_size = META_SIZE;
+    p_enc_ctx->ddr_config = 2;
+    return 0;
+}
+
+static void test_graph_errors(void)
+{
+    ni_pipeline_t *p_pipeline = ni_pipeline_alloc(1, 2);
+    ni_session_context_t sw_ctx;
+    int dec;
+
+    CHECK(p_pipeline);
+    memset(&sw_ctx, 0, sizeof(sw_ctx));
+    CHECK(ni_pipeline_add_decoder(p_pipeline, &sw_ctx, read_packet, NULL) < 0);
+    dec = ni_pipeline_add_decoder(p_pipeline, &dec_ctx, read_packet, NULL);
+    CHECK(0 == dec);
+    CHECK(ni_pipeline_add_decoder(p_pipeline, &dec_ctx, read_packet, NULL) < 0);
+    CHECK(ni_pipeline_add_encoder(p_pipeline, dec, &sw_ctx, write_packet,
+                                  NULL) < 0);
+    CHECK(1 == ni_pipeline_add_encoder(p_pipeline, dec, &enc_ctx[0],
+                                       write_packet, NULL));
+    // an encoder can not feed anything
+    CHECK(ni_pipeline_add_scaler(p_pipeline, 1, &sca_ctx,
+                                 &(ni_scaler_input_params_t){0}) < 0);
+    CHECK(ni_pipeline_add_encoder(p_pipeline, 5, &enc_ctx[1], write_packet,
+                                  NULL) < 0);
+    CHECK(NULL == ni_pipeline_alloc(NI_PIPELINE_MAX_WORKERS + 1, 0));
+    ni_pipeline_free(p_pipeline);
+}
+
+/*!*****************************************************************************
+ *  \brief  decoder -> encoder 0
+ *                  -> scaler -> encoder 1 (opened on its first frame)
+ *
+ *          Both producers hand out frame indices 1..POOL_SIZE on the same
+ *          device, so a reference keyed by frame index alone would mix them up.
+ ******************************************************************************/
+static void test_transcode(void)
+{
+    ni_scaler_input_params_t scale = {0};
+    ni_pipeline_stats_t stats;
+    ni_pipeline_t *p_pipeline;
+    int dec, sca, enc0, enc1;
+
+    p_pipeline = ni_pipeline_alloc(2, 2);
+    CHECK(p_pipeline);
+    scale.output_width = SCA_WIDTH;
+    scale.output_height = SCA_HEIGHT;
+    scale.op = NI_SCALER_OPCODE_SCALE;
+
+    dec = ni_pipeline_add_decoder(p_pipeline, &dec_ctx, read_packet, NULL);
+    enc0 = ni_pipeline_add_encoder(p_pipeline, dec, &enc_ctx[0], write_packet,
+                                   &mock_enc[0]);
+    sca = ni_pipeline_add_scaler(p_pipeline, dec, &sca_ctx, &scale);
+    enc1 = ni_pipeline_add_encoder2(p_pipeline, sca, &enc_ctx[1], open_encoder,
+                                    write_packet, &mock_enc[1]);
+    CHECK(dec >= 0 && enc0 >= 0 && sca >= 0 && enc1 >= 0);
+
+    CHECK(NI_RETCODE_SUCCESS == ni_pipeline_start(p_pipeline));
+    CHECK(NI_RETCODE_SUCCESS == ni_pipeline_wait(p_pipeline));
+
+    CHECK(NB_PACKETS == dec_frames_out);
+    CHECK(NB_PACKETS == mock_enc[0].packets && 1 == mock_enc[0].eos);
+    CHECK(NB_PACKETS == mock_enc[1].packets && 1 == mock_enc[1].eos);
+    CHECK(opened_on_frame > 0);
+    // end of stream frames carry the resolution the encoders were opened with
+    CHECK(SRC_WIDTH == mock_enc[0].eos_width &&
+          SRC_HEIGHT == mock_enc[0].eos_height);
+    CHECK(SCA_WIDTH == mock_enc[1].eos_width &&
+          SCA_HEIGHT == mock_enc[1].eos_height);
+    // every frame went back to its own pool exactly once
+    CHECK(NB_PACKETS == dec_pool.recycled && NB_PACKETS == sca_pool.recycled);
+    for (int i = 1; i <= POOL_SIZE; i++)
+    {
+        CHECK(!dec_pool.in_use[i] && !sca_pool.in_use[i]);
+    }
+
+    CHECK(NI_RETCODE_SUCCESS == ni_pipeline_get_stats(p_pipeline, dec, &stats));
+    CHECK(NB_PACKETS == stats.frames_in && NB_PACKETS == stats.frames_out);
+    CHECK(NB_PACKETS * 1000 == stats.bytes_in);
+    CHECK(NI_RETCODE_SUCCESS == ni_pipeline_get_stats(p_pipeline, sca, &stats));
+    CHECK(NB_PACKETS == stats.frames_in && NB_PACKETS == stats.frames_out);
+    CHECK(NI_RETCODE_SUCCESS == ni_pipeline_get_stats(p_pipeline, enc1, &stats));
+    CHECK(NB_PACKETS == stats.frames_in && NB_PACKETS == stats.frames_out);
+    CHECK(NB_PACKETS * 100 == stats.bytes_out);
+    CHECK(NI_RETCODE_INVALID_PARAM ==
+          ni_pipeline_get_stats(p_pipeline, 4, &stats));
+
+    ni_pipeline_free(p_pipeline);
+}
+
+int main(void)
+{
+    // the error cases below log errors on purpose
+    ni_log_set_level(NI_LOG_NONE);
+    ni_pthread_mutex_init(&mock_mutex);
+
+    ni_device_session_context_init(&dec_ctx);
+    ni_device_session_context_init(&sca_ctx);
+    ni_device_session_context_init(&enc_ctx[0]);
+    ni_device_session_context_init(&enc_ctx[1]);
+    dec_ctx.hw_action = NI_CODEC_HW_ENABLE;
+    dec_ctx.bit_depth_factor = 1;
+    enc_ctx[0].hw_action = NI_CODEC_HW_ENABLE;
+    enc_ctx[0].meta_size = META_SIZE;
+    enc_ctx[0].ddr_config = 2;
+    enc_ctx[0].p_session_config = &(ni_xcoder_params_t){
+        .source_width = SRC_WIDTH, .source_height = SRC_HEIGHT};
+
+    test_graph_errors();
+    test_transcode();
+
+    printf("ni_pipeline_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_quadraprobe_test.c
+ *
+ *  \brief  Test of the firmware log tailer without a card: BAR4 is a sparse
+ *          file of the same layout, written by the test as the firmware
+ *          would. Checks new log data is reported once, in order, across
+ *          the end of a ring and past the poll window, that a core that
+ *          starts writing anywhere is found, and prints the cost of a poll
+ *          with the default window against a whole ring scan.
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "ni_log.h"
+#include "ni_util.h"
+#include "ni_quadraprobe.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define BAR_SIZE          0x10000000
+#define LOG_OFFSET_TABLE  0xf8f5000
+#define LOG_RING_SIZE     (1024 * 1024)
+#define NB_CORES          5
+#define RING(core)        (0x01000000u + (core) * 0x200000u)
+#define NB_POLLS          20
+
+static int failures;
+static uint8_t *g_bar;
+
+// what the tailer reported for each core, in order
+static struct
+{
+    uint8_t data[4 * LOG_RING_SIZE];
+    uint32_t len;
+    int records;
+    int bad_window;
+} reported[NB_CORES];
+
+static void on_record(void *opaque, const ni_fw_log_record_t *p_record)
+{
+    (void)opaque;
+    if (p_record->core < 0 || p_record->core >= NB_CORES)
+    {
+        failures++;
+        return;
+    }
+    if (reported[p_record->core].len + p_record->len <=
+        sizeof(reported[p_record->core].data))
+    {
+        memcpy(reported[p_record->core].data + reported[p_record->core].len,
+               p_record->data, p_record->len);
+        reported[p_record->core].len += p_record->len;
+    }
+    reported[p_record->core].records++;
+    reported[p_record->core].bad_window +=
+        !(p_record->seen_after_ns < p_record->seen_before_ns);
+}
+
+static void reset_reported(void)
+{
+    memset(reported, 0, sizeof(reported));
+}
+
+static int poll(ni_fw_log_tail_t *p_tail)
+{
+    return ni_fw_log_tail_poll(p_tail, on_record, NULL);
+}
+
+static void fw_write(int core, uint32_t offset, const void *p_data,
+                     uint32_t len)
+{
+    memcpy(g_bar + RING(core) + offset, p_data, len);
+}
+
+static void set_ring(int core, uint32_t ring_offset)
+{
+    ((uint32_t *)(g_bar + LOG_OFFSET_TABLE))[core] = ring_offset | 0x10000000u;
+}
+
+// log lines of 8 byte multiples, as the records are reported by whole words
+static void make_log(uint8_t *p_log, uint32_t len, int seed)
+{
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        p_log[i] = (uint8_t)('a' + (i * 7 + seed) % 26);
+    }
+}
+
+// the firmware appends len bytes at *p_pos, wrapping around the ring
+static void fw_append(int core, uint32_t *p_pos, const uint8_t *p_log,
+                      uint32_t len)
+{
+    while (len)
+    {
+        uint32_t chunk = LOG_RING_SIZE - *p_pos;
+        if (chunk > len)
+        {
+            chunk = len;
+        }
+        fw_write(core, *p_pos, p_log, chunk);
+        *p_pos = (*p_pos + chunk) % LOG_RING_SIZE;
+        p_log += chunk;
+        len -= chunk;
+    }
+}
+
+static void test_tail(const char *path)
+{
+    static uint8_t log[LOG_RING_SIZE + 4096];
+    ni_fw_log_tail_t *p_tail;
+    uint32_t pos, total;
+    int i;
+
+    fw_write(1, 0, "old history", 11);
+    p_tail = ni_fw_log_tail_open(path, false);
+    CHECK(p_tail != NULL);
+    if (!p_tail)
+    {
+        return;
+    }
+
+    // the history is not reported, only what comes after it
+    reset_reported();
+    CHECK(poll(p_tail) == 0);
+    for (i = 0; i < 16; i++)
+    {
+        CHECK(poll(p_tail) == 0);
+    }
+    fw_write(1, 16, "dp: frame 1 decoded.....", 24);
+    fw_write(2, 96, "ep: rc update...", 16);
+    CHECK(poll(p_tail) == 2);
+    CHECK(reported[1].len == 24 &&
+          !memcmp(reported[1].data, "dp: frame 1 decoded.....", 24));
+    CHECK(reported[2].len == 16 &&
+          !memcmp(reported[2].data, "ep: rc update...", 16));
+    CHECK(!reported[1].bad_window && !reported[2].bad_window);
+    CHECK(poll(p_tail) == 0);
+
+    // a core appending through the end of its ring, at most a window per
+    // poll, is reported in order and once
+    reset_reported();
+    make_log(log, sizeof(log), 1);
+    pos = 40;
+    total = 0;
+    while (total < LOG_RING_SIZE)
+    {
+        fw_append(1, &pos, log + total, 8192);
+        total += 8192;
+        poll(p_tail);
+    }
+    CHECK(reported[1].len == total);
+    CHECK(!memcmp(reported[1].data, log, total));
+
+    // more than a window at once is caught up by the next polls
+    reset_reported();
+    make_log(log, 4 * NI_FW_LOG_TAIL_DEFAULT_WINDOW, 2);
+    fw_append(1, &pos, log, 4 * NI_FW_LOG_TAIL_DEFAULT_WINDOW);
+    for (i = 0; i < 8; i++)
+    {
+        poll(p_tail);
+    }
+    CHECK(reported[1].len == 4 * NI_FW_LOG_TAIL_DEFAULT_WINDOW);
+    CHECK(!memcmp(reported[1].data, log, reported[1].len));
+
+    // data away from the last data seen, eg. from a ring that had wrapped
+    // around, is found once the patrol reaches it
+    reset_reported();
+    fw_write(3, 500000, "tp: first line..", 16);
+    for (i = 0; i < 8 * LOG_RING_SIZE / NI_FW_LOG_TAIL_DEFAULT_WINDOW; i++)
+    {
+        poll(p_tail);
+    }
+    CHECK(reported[3].records == 1);
+    CHECK(reported[3].len == 16 &&
+          !memcmp(reported[3].data, "tp: first line..", 16));
+    fw_write(3, 500016, "tp: second line.", 16);
+    CHECK(poll(p_tail) == 1);
+
+    // a moved ring is taken as new, a ring outside the BAR is skipped
+    reset_reported();
+    set_ring(3, RING(4) + 0x100000);
+    fw_write(4, 0x100000, "moved...", 8);
+    CHECK(poll(p_tail) == 0);
+    set_ring(0, 0x0FFFFFF0);
+    CHECK(poll(p_tail) == 0);
+    set_ring(0, RING(0));
+    set_ring(3, RING(3));
+
+    ni_fw_log_tail_close(p_tail);
+    CHECK(ni_fw_log_tail_set_window(NULL, 0) == -1);
+}
+
+static void bench(const char *path)
+{
+    ni_fw_log_tail_t *p_tail = ni_fw_log_tail_open(path, false);
+    uint64_t t0, t_window, t_ring;
+    int i;
+
+    CHECK(p_tail != NULL);
+    if (!p_tail)
+    {
+        return;
+    }
+    poll(p_tail);
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_POLLS; i++)
+    {
+        ni_fw_log_tail_poll(p_tail, NULL, NULL);
+    }
+    t_window = ni_gettime_ns() - t0;
+
+    CHECK(ni_fw_log_tail_set_window(p_tail, 0) == 0);
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_POLLS; i++)
+    {
+        ni_fw_log_tail_poll(p_tail, NULL, NULL);
+    }
+    t_ring = ni_gettime_ns() - t0;
+    ni_fw_log_tail_close(p_tail);
+
+    printf("ni_quadraprobe_test: poll of %d rings of %d KiB, page cache\n",
+           NB_CORES, LOG_RING_SIZE / 1024);
+    printf("  window %3d KiB: %7.3f ms\n", NI_FW_LOG_TAIL_DEFAULT_WINDOW / 1024,
+           t_window / (NB_POLLS * 1e6));
+    printf("  whole ring    : %7.3f ms\n", t_ring / (NB_POLLS * 1e6));
+}
+
+int main(void)
+{
+    char path[] = "/tmp/ni_quadraprobe_test_XXXXXX";
+    char small_path[] = "/tmp/ni_quadraprobe_test_XXXXXX";
+    int fd, small_fd, core;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    fd = mkstemp(path);
+    small_fd = mkstemp(small_path);
+    CHECK(fd >= 0 && small_fd >= 0);
+    if (fd < 0 || small_fd < 0 || ftruncate(fd, BAR_SIZE) != 0 ||
+        ftruncate(small_fd, 4096) != 0)
+    {
+        printf("ni_quadraprobe_test: FAILED\n");
+        return 1;
+    }
+    g_bar = mmap(NULL, BAR_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    CHECK(g_bar != MAP_FAILED);
+    if (g_bar != MAP_FAILED)
+    {
+        for (core = 0; core < NB_CORES; core++)
+        {
+            set_ring(core, RING(core));
+        }
+        test_tail(path);
+        bench(path);
+        munmap(g_bar, BAR_SIZE);
+    }
+
+    CHECK(ni_fw_log_tail_open("/nonexistent/resource4", false) == NULL);
+    CHECK(ni_fw_log_tail_open(small_path, false) == NULL);
+
+    close(fd);
+    close(small_fd);
+    unlink(path);
+    unlink(small_path);
+
+    printf("ni_quadraprobe_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
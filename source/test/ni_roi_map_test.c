@@ -0,0 +1,405 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_roi_map_test.c
+ *
+ *  \brief  Differential test of the ROI QP map built by ni_enc_prep_aux_data()
+ *          from ROI side data. Random ROI lists are edited frame after frame
+ *          on H.264, HEVC and AV1 in both customize_roi_qp_level modes. The
+ *          map bytes and roi_avg_qp of a session updated incrementally are
+ *          compared with a session that rebuilds its map on every frame and
+ *          with the per block loop the rasterizer replaced, kept here as the
+ *          reference.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "ni_av_codec.h"
+#include "ni_device_api.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_SEQUENCES    40      // random ROI sequences per codec and mode
+#define NB_EDITS        24      // frames per sequence
+#define MAX_ROIS        12
+
+static int failures;
+static uint32_t seed = 1;
+static int nb_repainted;        // frames updated without a rebuild
+static int nb_frames;
+
+static const struct
+{
+    int width;
+    int height;
+} sizes[] = {
+    {8, 8}, {33, 17}, {176, 144}, {640, 360}, {1280, 720}, {1918, 1080},
+    {1920, 1080}, {3840, 2160},
+};
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int rnd_range(int lo, int hi)
+{
+    return lo + (int)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+// counts the frames set_roi_map() updated in place
+static void log_cb(int level, const char *fmt, va_list vl)
+{
+    char line[256];
+
+    (void)level;
+    if (strstr(fmt, "dirty rects"))
+    {
+        vsnprintf(line, sizeof(line), fmt, vl);
+        nb_repainted += strstr(line, "repainted") != NULL;
+    }
+}
+
+// the per block loop of set_roi_map() before the rasterizer
+static uint32_t ref_roi_map(uint8_t *p_map, uint32_t *p_map_size,
+                            ni_codec_format_t codec_format,
+                            const ni_region_of_interest_t *p_rois, int nb_roi,
+                            int width, int height, int roi_qp_level)
+{
+    uint32_t i, j, k, m;
+    int r;
+    int32_t set_qp = 0;
+    uint32_t sumQp = 0;
+    uint8_t isAbsQp_flag = 0;
+    ni_enc_quad_roi_custom_map *roi_map = (ni_enc_quad_roi_custom_map *)p_map;
+    uint32_t max_cu_size = (codec_format == NI_CODEC_FORMAT_H264) ? 16 : 64;
+
+    if (NI_CODEC_FORMAT_AV1 == codec_format)
+    {
+        width = (width / 8) * 8;
+        height = (height / 8) * 8;
+    }
+
+    uint32_t unit = (codec_format == NI_CODEC_FORMAT_H264) ? 16 : 64;
+    uint32_t mbWidth = ((width + max_cu_size - 1) & (~(max_cu_size - 1))) / unit;
+    uint32_t mbHeight =
+        ((height + max_cu_size - 1) & (~(max_cu_size - 1))) / unit;
+    uint32_t numMbs = mbWidth * mbHeight;
+    uint32_t subNumMbs = (unit / 8) * (unit / 8);
+    uint32_t block_size = ((width + max_cu_size - 1) & (~(max_cu_size - 1))) *
+        ((height + max_cu_size - 1) & (~(max_cu_size - 1))) / (8 * 8);
+
+    *p_map_size = ((block_size + 63) & (~63));
+    memset(p_map, 0, *p_map_size);
+
+    for (r = nb_roi - 1; r >= 0; r--)
+    {
+        const ni_region_of_interest_t *roi = &p_rois[r];
+        if (!roi->qoffset.den)
+        {
+            continue;
+        }
+        if (roi_qp_level == NI_CUS_ROI_MAPFILE)
+        {
+            set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
+                               (float)roi->qoffset.den *
+                               NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL);
+            if (set_qp > 0 && set_qp <= NI_CUSTOMIZE_ROI_QPOFFSET_LEVEL)
+            {
+                isAbsQp_flag = roi_qp_level;
+            } else
+            {
+                continue;
+            }
+        } else
+        {
+            set_qp = (int32_t)((float)roi->qoffset.num * 1.0f /
+                               (float)roi->qoffset.den * NI_INTRA_QP_RANGE);
+            set_qp = clip3(NI_MIN_QP_DELTA, NI_MAX_QP_DELTA, set_qp);
+            set_qp = (NI_MAX_QP_INFO + 1 - set_qp) % (NI_MAX_QP_INFO + 1);
+        }
+
+        for (j = 0; j < mbHeight; j++)
+        {
+            for (i = 0; i < mbWidth; i++)
+            {
+                k = j * mbWidth + i;
+                for (m = 0; m < subNumMbs; m++)
+                {
+                    if ((int)i >= (int)((roi->left + unit - 1) / unit) - 1 &&
+                        (int)i <= (int)((roi->right + unit - 1) / unit) - 1 &&
+                        (int)j >= (int)((roi->top + unit - 1) / unit) - 1 &&
+                        (int)j <= (int)((roi->bottom + unit - 1) / unit) - 1)
+                    {
+                        roi_map[k * subNumMbs + m].field.ipcm_flag = 0;
+                        roi_map[k * subNumMbs + m].field.roiAbsQp_flag =
+                            isAbsQp_flag;
+                        roi_map[k * subNumMbs + m].field.qp_info = set_qp;
+                    }
+                }
+                sumQp += roi_map[k * subNumMbs].field.qp_info;
+            }
+        }
+    }
+
+    return (numMbs != 0 ? (sumQp + (numMbs >> 1)) / numMbs : 0) +
+        NI_DEFAULT_INTRA_QP;
+}
+
+static void random_rect(ni_region_of_interest_t *roi, int width, int height)
+{
+    int x = rnd_range(-32, width + 32);
+    int y = rnd_range(-32, height + 32);
+
+    roi->left = x;
+    roi->right = x + rnd_range(-8, width / 2 + 16);
+    roi->top = y;
+    roi->bottom = y + rnd_range(-8, height / 2 + 16);
+}
+
+static void random_qoffset(ni_region_of_interest_t *roi)
+{
+    // a zero denominator or a mapfile level out of range skips the ROI
+    roi->qoffset.den = rnd() % 16 ? rnd_range(1, 10) : 0;
+    roi->qoffset.num = rnd_range(-roi->qoffset.den, roi->qoffset.den);
+}
+
+static void random_roi(ni_region_of_interest_t *roi, int width, int height)
+{
+    memset(roi, 0, sizeof(*roi));
+    roi->self_size = sizeof(ni_region_of_interest_t);
+    random_rect(roi, width, height);
+    random_qoffset(roi);
+}
+
+// the next frame's ROI list, mostly small edits that keep its layout
+static void edit_rois(ni_region_of_interest_t *p_rois, int *p_nb_roi,
+                      int width, int height)
+{
+    ni_region_of_interest_t tmp;
+    int op = rnd_range(0, 99);
+    int n, i, a, b;
+
+    if (op < 60)
+    {
+        // move or resize a few ROIs
+        for (n = rnd_range(1, 3); n > 0; n--)
+        {
+            ni_region_of_interest_t *roi = &p_rois[rnd() % *p_nb_roi];
+            if (rnd() % 2)
+            {
+                int dx = rnd_range(-40, 40), dy = rnd_range(-40, 40);
+                roi->left += dx;
+                roi->right += dx;
+                roi->top += dy;
+                roi->bottom += dy;
+            } else
+            {
+                random_rect(roi, width, height);
+            }
+        }
+    } else if (op < 75)
+    {
+        random_qoffset(&p_rois[rnd() % *p_nb_roi]);
+    } else if (op < 85)
+    {
+        a = (int)(rnd() % *p_nb_roi);
+        b = (int)(rnd() % *p_nb_roi);
+        tmp = p_rois[a];
+        p_rois[a] = p_rois[b];
+        p_rois[b] = tmp;
+    } else if (op < 95)
+    {
+        if (*p_nb_roi < MAX_ROIS && rnd() % 2)
+        {
+            random_roi(&p_rois[(*p_nb_roi)++], width, height);
+        } else if (*p_nb_roi > 1)
+        {
+            i = (int)(rnd() % *p_nb_roi);
+            memmove(&p_rois[i], &p_rois[i + 1],
+                    sizeof(tmp) * (size_t)(*p_nb_roi - i - 1));
+            (*p_nb_roi)--;
+        }
+    }
+    // else the same list again
+}
+
+static void prep_frame(ni_session_context_t *p_ctx,
+                       ni_codec_format_t codec_format,
+                       const ni_region_of_interest_t *p_rois, int nb_roi)
+{
+    ni_frame_t dec_frame, enc_frame;
+    ni_aux_data_t *p_aux;
+
+    memset(&dec_frame, 0, sizeof(dec_frame));
+    memset(&enc_frame, 0, sizeof(enc_frame));
+    p_aux = ni_frame_new_aux_data(&dec_frame,
+                                  NI_FRAME_AUX_DATA_REGIONS_OF_INTEREST,
+                                  (int)sizeof(ni_region_of_interest_t) * nb_roi);
+    CHECK(p_aux != NULL);
+    if (!p_aux)
+    {
+        return;
+    }
+    memcpy(p_aux->data, p_rois, sizeof(ni_region_of_interest_t) * nb_roi);
+    ni_enc_prep_aux_data(p_ctx, &enc_frame, &dec_frame, codec_format, 0, NULL,
+                         NULL, NULL, NULL, NULL);
+    ni_frame_wipe_aux_data(&dec_frame);
+}
+
+static void init_session(ni_session_context_t *p_ctx,
+                         ni_xcoder_params_t *p_params, int width, int height,
+                         int roi_qp_level)
+{
+    ni_device_session_context_init(p_ctx);
+    // as set by ni_device_session_open() for an encoder
+    p_ctx->enc_change_params = calloc(1, sizeof(ni_encoder_change_params_t));
+    p_ctx->target_bitrate = -1;
+    p_ctx->reconfig_crf = -1;
+    p_ctx->reconfig_intra_period = -1;
+    memset(p_params, 0, sizeof(*p_params));
+    p_params->cfg_enc_params.roi_enable = 1;
+    p_params->cfg_enc_params.customize_roi_qp_level = roi_qp_level;
+    p_params->source_width = width;
+    p_params->source_height = height;
+    p_ctx->p_session_config = p_params;
+}
+
+static void clear_session(ni_session_context_t *p_ctx)
+{
+    ni_memfree(p_ctx->av_rois);
+    ni_memfree(p_ctx->roi_map);
+    ni_memfree(p_ctx->p_roi_map_state);
+    ni_memfree(p_ctx->enc_change_params);
+    ni_device_session_context_clear(p_ctx);
+}
+
+static void run_sequence(ni_codec_format_t codec_format, int roi_qp_level)
+{
+    static uint8_t ref_map[3840 * 2176 / 64 + 64];
+    ni_region_of_interest_t rois[MAX_ROIS];
+    ni_session_context_t inc_ctx, full_ctx;
+    ni_xcoder_params_t inc_params, full_params;
+    uint32_t ref_size, ref_avg_qp;
+    int width, height, nb_roi, edit, i, size;
+
+    size = rnd_range(0, (int)(sizeof(sizes) / sizeof(sizes[0])) - 1);
+    // 4K only now and then, the reference loop is slow
+    if (size == (int)(sizeof(sizes) / sizeof(sizes[0])) - 1 && rnd() % 4)
+    {
+        size = 4;
+    }
+    width = sizes[size].width;
+    height = sizes[size].height;
+
+    init_session(&inc_ctx, &inc_params, width, height, roi_qp_level);
+    init_session(&full_ctx, &full_params, width, height, roi_qp_level);
+
+    nb_roi = rnd_range(1, 8);
+    for (i = 0; i < nb_roi; i++)
+    {
+        random_roi(&rois[i], width, height);
+    }
+
+    for (edit = 0; edit < NB_EDITS; edit++)
+    {
+        if (edit)
+        {
+            edit_rois(rois, &nb_roi, width, height);
+        }
+
+        prep_frame(&inc_ctx, codec_format, rois, nb_roi);
+        // forget the previous list so that the whole map is rebuilt
+        ni_memfree(full_ctx.av_rois);
+        full_ctx.nb_rois = 0;
+        prep_frame(&full_ctx, codec_format, rois, nb_roi);
+        ref_avg_qp = ref_roi_map(ref_map, &ref_size, codec_format, rois,
+                                 nb_roi, width, height, roi_qp_level);
+        nb_frames++;
+
+        CHECK(inc_ctx.roi_map && full_ctx.roi_map);
+        if (!inc_ctx.roi_map || !full_ctx.roi_map)
+        {
+            break;
+        }
+        CHECK(inc_ctx.roi_len == ref_size && full_ctx.roi_len == ref_size);
+        CHECK(!memcmp(inc_ctx.roi_map, ref_map, ref_size));
+        CHECK(!memcmp(full_ctx.roi_map, ref_map, ref_size));
+        CHECK(inc_ctx.roi_avg_qp == ref_avg_qp);
+        CHECK(full_ctx.roi_avg_qp == ref_avg_qp);
+        if (failures)
+        {
+            fprintf(stderr, "codec %d level %d %dx%d edit %d: %d ROIs\n",
+                    codec_format, roi_qp_level, width, height, edit, nb_roi);
+            break;
+        }
+    }
+
+    clear_session(&inc_ctx);
+    clear_session(&full_ctx);
+}
+
+int main(void)
+{
+    static const ni_codec_format_t codecs[] = {
+        NI_CODEC_FORMAT_H264, NI_CODEC_FORMAT_H265, NI_CODEC_FORMAT_AV1};
+    int c, level, n;
+
+    // debug level reaches the callback only, which counts in place updates
+    ni_log_set_callback(log_cb);
+    ni_log_set_level(NI_LOG_DEBUG);
+
+    for (c = 0; c < 3 && !failures; c++)
+    {
+        for (level = NI_CUS_ROI_DISABLE; level <= NI_CUS_ROI_MAPFILE; level++)
+        {
+            for (n = 0; n < NB_SEQUENCES && !failures; n++)
+            {
+                run_sequence(codecs[c], level);
+            }
+        }
+    }
+
+    ni_log_set_level(NI_LOG_NONE);
+    ni_log_set_callback(ni_log_default_callback);
+
+    // most edits keep the layout, make sure they take the in place path
+    CHECK(nb_repainted > nb_frames / 4);
+    printf("ni_roi_map_test: %d frames, %d updated in place\n", nb_frames,
+           nb_repainted);
+    printf("ni_roi_map_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,411 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_rsrc_cache_test.c
+ *
+ *  \brief  Test of the per-process device context cache without a card. The
+ *          device queue, device info segments and lock files are redirected
+ *          at link time (-Wl,--wrap=shm_open,shm_unlink,open,unlink) to
+ *          private names so the resource pool of the host is not touched.
+ *          Devices are added and removed by child processes while the parent
+ *          checks that its cached lookups follow each generation bump, that
+ *          a context still held across an invalidation stays usable until it
+ *          is freed, and that a device queue of the older layout is grown
+ *          and cached again.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ni_device_api.h"
+#include "ni_rsrc_api.h"
+#include "ni_rsrc_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+static int failures;
+static char name_prefix[64];
+
+int __real_shm_open(const char *name, int oflag, mode_t mode);
+int __real_shm_unlink(const char *name);
+int __real_open(const char *path, int flags, ...);
+int __real_unlink(const char *path);
+
+// NI_* names of the resource pool get the private prefix, others are kept
+static const char *private_name(const char *name, char *buf, size_t size)
+{
+    const char *base = name;
+
+    if (strncmp(base, LOCK_DIR "/", strlen(LOCK_DIR "/")) == 0)
+    {
+        base += strlen(LOCK_DIR "/");
+    } else if (base[0] == '/')
+    {
+        base++;
+    }
+    if (strncmp(base, "NI_", 3) != 0)
+    {
+        return name;
+    }
+    snprintf(buf, size, "%.*s%s%s", (int)(base - name), name, name_prefix,
+             base);
+    return buf;
+}
+
+int __wrap_shm_open(const char *name, int oflag, mode_t mode)
+{
+    char buf[PATH_MAX];
+
+    return __real_shm_open(private_name(name, buf, sizeof(buf)), oflag, mode);
+}
+
+int __wrap_shm_unlink(const char *name)
+{
+    char buf[PATH_MAX];
+
+    return __real_shm_unlink(private_name(name, buf, sizeof(buf)));
+}
+
+int __wrap_open(const char *path, int flags, ...)
+{
+    char buf[PATH_MAX];
+    mode_t mode = 0;
+    va_list ap;
+
+    if (flags & O_CREAT)
+    {
+        va_start(ap, flags);
+        mode = (mode_t)va_arg(ap, int);
+        va_end(ap);
+    }
+    return __real_open(private_name(path, buf, sizeof(buf)), flags, mode);
+}
+
+int __wrap_unlink(const char *path)
+{
+    char buf[PATH_MAX];
+
+    return __real_unlink(private_name(path, buf, sizeof(buf)));
+}
+
+static void dev_name_of(int index, char *p_name)
+{
+    snprintf(p_name, NI_MAX_DEVICE_NAME_LEN, "/dev/nvme%dn1", index);
+}
+
+// what add_to_shared_memory() does for a probed card, for one decoder
+static void add_decoder(int guid, int index)
+{
+    ni_device_pool_t *p_device_pool;
+    ni_device_queue_t *p_device_queue;
+    ni_device_info_t info;
+
+    memset(&info, 0, sizeof(info));
+    info.device_type = NI_DEVICE_TYPE_DECODER;
+    info.module_id = guid;
+    info.load = index;
+    dev_name_of(index, info.dev_name);
+    ni_rsrc_get_one_device_info(&info);
+
+    p_device_pool = ni_rsrc_get_device_pool();
+    if (!p_device_pool)
+    {
+        return;
+    }
+    ni_rsrc_lock_fd(p_device_pool->lock, -1);
+    p_device_queue = p_device_pool->p_device_queue;
+    p_device_queue->xcoders[NI_DEVICE_TYPE_DECODER]
+                           [p_device_queue->xcoder_cnt[NI_DEVICE_TYPE_DECODER]++] =
+        guid;
+    p_device_queue->generation++;
+    ni_rsrc_unlock_fd(p_device_pool->lock);
+    ni_rsrc_free_device_pool(p_device_pool);
+}
+
+static void remove_device(int index)
+{
+    char dev_name[NI_MAX_DEVICE_NAME_LEN];
+
+    dev_name_of(index, dev_name);
+    CHECK(ni_rsrc_remove_device(dev_name) == NI_RETCODE_SUCCESS);
+}
+
+// run the queue change in another process so only the shared state links it
+// to the cache of this one
+static void in_child(void (*change)(int, int), int guid, int index)
+{
+    pid_t pid = fork();
+
+    if (pid == 0)
+    {
+        change(guid, index);
+        _exit(failures ? 1 : 0);
+    }
+    CHECK(pid > 0);
+    if (pid > 0)
+    {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+}
+
+static void child_add(int guid, int index)
+{
+    add_decoder(guid, index);
+}
+
+static void child_remove(int guid, int index)
+{
+    (void)guid;
+    remove_device(index);
+}
+
+// the same guid comes back as another card
+static void child_replace(int guid, int index)
+{
+    remove_device(index);
+    add_decoder(guid, index + 2);
+}
+
+static bool fd_is_open(int fd)
+{
+    return fcntl(fd, F_GETFD) >= 0;
+}
+
+// name of the card behind a lookup, "" if there is none
+static void lookup(int guid, char *p_name)
+{
+    ni_device_context_t *p_ctx;
+
+    p_name[0] = '\0';
+    p_ctx = ni_rsrc_get_device_context(NI_DEVICE_TYPE_DECODER, guid);
+    if (p_ctx)
+    {
+        ni_strncpy(p_name, NI_MAX_DEVICE_NAME_LEN, p_ctx->p_device_info->dev_name,
+                   NI_MAX_DEVICE_NAME_LEN - 1);
+        ni_rsrc_free_device_context(p_ctx);
+    }
+}
+
+static bool is_cached(int guid)
+{
+    ni_device_context_t *p_a, *p_b;
+    bool cached;
+
+    p_a = ni_rsrc_get_device_context(NI_DEVICE_TYPE_DECODER, guid);
+    p_b = ni_rsrc_get_device_context(NI_DEVICE_TYPE_DECODER, guid);
+    if (!p_a || !p_b)
+    {
+        cached = false;
+    } else
+    {
+        // both handed out from one mapping and lock
+        cached = p_a->p_device_info == p_b->p_device_info &&
+            p_a->lock == p_b->lock;
+    }
+    ni_rsrc_free_device_context(p_a);
+    ni_rsrc_free_device_context(p_b);
+    return cached;
+}
+
+static void test_generation(void)
+{
+    char name[NI_MAX_DEVICE_NAME_LEN];
+    ni_device_context_t *p_held, *p_ctx;
+    int held_lock, cached_lock;
+
+    in_child(child_add, 0, 0);
+    lookup(0, name);
+    CHECK(strcmp(name, "/dev/nvme0n1") == 0);
+    CHECK(is_cached(0));
+    lookup(1, name);
+    CHECK(name[0] == '\0');
+
+    // a device added elsewhere is found
+    in_child(child_add, 1, 1);
+    lookup(1, name);
+    CHECK(strcmp(name, "/dev/nvme1n1") == 0);
+    CHECK(is_cached(1));
+
+    // guid 0 stays handed out across the removal, guid 1 is only cached
+    p_held = ni_rsrc_get_device_context(NI_DEVICE_TYPE_DECODER, 0);
+    p_ctx = ni_rsrc_get_device_context(NI_DEVICE_TYPE_DECODER, 1);
+    CHECK(p_held && p_ctx);
+    if (!p_held || !p_ctx)
+    {
+        ni_rsrc_free_device_context(p_held);
+        ni_rsrc_free_device_context(p_ctx);
+        return;
+    }
+    held_lock = p_held->lock;
+    cached_lock = p_ctx->lock;
+    ni_rsrc_free_device_context(p_ctx);
+
+    in_child(child_remove, 0, 0);
+    lookup(0, name);
+    CHECK(name[0] == '\0');
+    // the unused context was closed by the invalidation, the held one not
+    CHECK(!fd_is_open(cached_lock));
+    CHECK(fd_is_open(held_lock));
+    CHECK(strcmp(p_held->p_device_info->dev_name, "/dev/nvme0n1") == 0);
+    lookup(1, name);
+    CHECK(strcmp(name, "/dev/nvme1n1") == 0);
+
+    // the last release of a dropped context closes it
+    ni_rsrc_free_device_context(p_held);
+    CHECK(!fd_is_open(held_lock));
+
+    // a guid removed and added again in one process is not served from the
+    // mapping of the removed card
+    CHECK(is_cached(1));
+    in_child(child_replace, 1, 1);
+    lookup(1, name);
+    CHECK(strcmp(name, "/dev/nvme3n1") == 0);
+    CHECK(is_cached(1));
+}
+
+static void test_old_layout(void)
+{
+    const off_t old_size = offsetof(ni_device_queue_t, generation);
+    ni_device_pool_t *p_device_pool;
+    struct stat shm_stat;
+    void *p_old;
+    int shm_fd;
+
+    // the queue is recreated by an older version, which bumps the generation
+    // of the old segment first
+    p_device_pool = ni_rsrc_get_device_pool();
+    CHECK(p_device_pool != NULL);
+    if (!p_device_pool)
+    {
+        return;
+    }
+    p_device_pool->p_device_queue->generation++;
+    shm_unlink(CODERS_SHM_NAME);
+    shm_fd = shm_open(CODERS_SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0660);
+    CHECK(shm_fd >= 0);
+    if (shm_fd < 0)
+    {
+        ni_rsrc_free_device_pool(p_device_pool);
+        return;
+    }
+    CHECK(ftruncate(shm_fd, old_size) == 0);
+    p_old = mmap(NULL, old_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    CHECK(p_old != MAP_FAILED);
+    if (p_old != MAP_FAILED)
+    {
+        memcpy(p_old, p_device_pool->p_device_queue, old_size);
+        munmap(p_old, old_size);
+    }
+    ni_rsrc_free_device_pool(p_device_pool);
+
+    // no generation to check, lookups work but are not cached
+    CHECK(!is_cached(1));
+
+    // opening the pool grows the segment to the current layout
+    p_device_pool = ni_rsrc_get_device_pool();
+    CHECK(p_device_pool != NULL);
+    CHECK(fstat(shm_fd, &shm_stat) == 0 &&
+          shm_stat.st_size == (off_t)sizeof(ni_device_queue_t));
+    close(shm_fd);
+    if (p_device_pool)
+    {
+        CHECK(p_device_pool->p_device_queue->xcoder_cnt[NI_DEVICE_TYPE_DECODER] ==
+              1);
+        ni_rsrc_free_device_pool(p_device_pool);
+    }
+    CHECK(is_cached(1));
+}
+
+static void remove_private_files(void)
+{
+    char path[PATH_MAX];
+    struct dirent *p_entry;
+    DIR *p_dir = opendir(LOCK_DIR);
+
+    if (!p_dir)
+    {
+        return;
+    }
+    while ((p_entry = readdir(p_dir)) != NULL)
+    {
+        if (strncmp(p_entry->d_name, name_prefix, strlen(name_prefix)) == 0)
+        {
+            snprintf(path, sizeof(path), "%s/%s", LOCK_DIR, p_entry->d_name);
+            __real_unlink(path);
+        }
+    }
+    closedir(p_dir);
+}
+
+int main(void)
+{
+    ni_device_pool_t *p_device_pool;
+    int lck_fd;
+
+    ni_log_set_level(NI_LOG_NONE);
+    snprintf(name_prefix, sizeof(name_prefix), "ni_rsrc_cache_test_%d_",
+             (int)getpid());
+
+    // an empty resource pool, as left by ni_rsrc_init() without cards
+    lck_fd = open(CODERS_LCK_NAME, O_CREAT | O_RDWR | O_CLOEXEC, 0660);
+    CHECK(lck_fd >= 0);
+    close(lck_fd);
+    p_device_pool = ni_rsrc_get_device_pool();
+    CHECK(p_device_pool != NULL);
+    if (p_device_pool)
+    {
+        memset(p_device_pool->p_device_queue, 0, sizeof(ni_device_queue_t));
+        memset(p_device_pool->p_device_queue->xcoders, -1,
+               sizeof(p_device_pool->p_device_queue->xcoders));
+        ni_rsrc_free_device_pool(p_device_pool);
+
+        test_generation();
+        test_old_layout();
+    }
+
+    remove_private_files();
+
+    printf("ni_rsrc_cache_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
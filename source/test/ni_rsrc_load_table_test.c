@@ -0,0 +1,219 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_rsrc_load_table_test.c
+ *
+ *  \brief  Test of the shared memory device load table without a card. The
+ *          table segment is redirected at link time (-Wl,--wrap=shm_open) to
+ *          a private name so the resource pool of the host is not touched.
+ *          Checks the device picked by ni_rsrc_get_least_loaded() and by
+ *          ni_rsrc_pick_least_loaded() over a candidate list, that snapshots
+ *          stay consistent while another process publishes, and prints
+ *          decisions per second with and without that writer.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ni_device_api.h"
+#include "ni_rsrc_api.h"
+#include "ni_rsrc_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_DEVICES      8
+#define NB_DECISIONS    200000
+#define WRITER_GUID     (NB_DEVICES + 1)
+
+static int failures;
+static char shm_name[64];
+
+int __real_shm_open(const char *name, int oflag, mode_t mode);
+
+int __wrap_shm_open(const char *name, int oflag, mode_t mode)
+{
+    if (strcmp(name, LOAD_SHM_NAME) == 0)
+    {
+        name = shm_name;
+    }
+    return __real_shm_open(name, oflag, mode);
+}
+
+static void publish(ni_device_type_t type, int guid, int load, int model_load,
+                    uint32_t inst)
+{
+    ni_device_info_t info;
+
+    memset(&info, 0, sizeof(info));
+    info.device_type = type;
+    info.module_id = guid;
+    info.load = load;
+    info.model_load = model_load;
+    info.active_num_inst = inst;
+    info.max_instance_cnt = 32;
+    info.xcode_load_pixel = (uint64_t)load * 1000;
+    ni_rsrc_publish_device_load(&info);
+}
+
+static void test_pick(void)
+{
+    const int enc_list[] = {5, 3, 1};
+    const int dec_list[] = {6, 2, 4};
+
+    //                              guid  load  mload  inst
+    publish(NI_DEVICE_TYPE_DECODER,    2,   40,    10,    3);
+    publish(NI_DEVICE_TYPE_DECODER,    4,   20,    30,    5);
+    publish(NI_DEVICE_TYPE_DECODER,    6,   20,    30,    1);
+    publish(NI_DEVICE_TYPE_ENCODER,    1,   10,    50,    2);
+    publish(NI_DEVICE_TYPE_ENCODER,    3,   90,    20,    4);
+    publish(NI_DEVICE_TYPE_ENCODER,    5,   90,    20,    1);
+
+    // ni_rsrc_allocate_auto() rule, first guid wins a tie
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_DECODER,
+                                   EN_ALLOC_LEAST_LOAD) == 4);
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_DECODER,
+                                   EN_ALLOC_LEAST_INSTANCE) == 6);
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_ENCODER,
+                                   EN_ALLOC_LEAST_LOAD) == 3);
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_ENCODER,
+                                   EN_ALLOC_LEAST_INSTANCE) == 5);
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_SCALER,
+                                   EN_ALLOC_LEAST_LOAD) == -1);
+
+    // candidate lists: queue order breaks ties, unless the session open
+    // rule prefers fewer instances
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_ENCODER,
+                                    NI_LOAD_KEY_MODEL_LOAD, false, enc_list,
+                                    3) == 5);
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_DECODER, NI_LOAD_KEY_LOAD,
+                                    false, dec_list, 3) == 6);
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_DECODER, NI_LOAD_KEY_LOAD,
+                                    false, dec_list + 1, 2) == 4);
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_DECODER, NI_LOAD_KEY_LOAD,
+                                    true, dec_list + 1, 2) == 4);
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_DECODER,
+                                    NI_LOAD_KEY_MODEL_LOAD, true, dec_list + 1,
+                                    2) == 2);
+    // a candidate without a record is skipped
+    CHECK(ni_rsrc_pick_least_loaded(NI_DEVICE_TYPE_ENCODER, NI_LOAD_KEY_LOAD,
+                                    false, dec_list, 3) == -1);
+
+    // removed devices are not picked
+    ni_rsrc_clear_device_load(NI_DEVICE_TYPE_DECODER, 4);
+    CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_DECODER,
+                                   EN_ALLOC_LEAST_LOAD) == 6);
+    publish(NI_DEVICE_TYPE_DECODER, 4, 20, 30, 5);
+}
+
+// publishes load == model_load == active_num_inst so torn reads show up
+static void writer(void)
+{
+    int v = 0;
+
+    for (;;)
+    {
+        v = (v + 1) & 0xffff;
+        publish(NI_DEVICE_TYPE_DECODER, WRITER_GUID, v, v, (uint32_t)v);
+    }
+}
+
+static double run_decisions(int *p_torn)
+{
+    const ni_device_load_record_t *p_records;
+    ni_device_load_record_t record;
+    uint64_t t0 = ni_gettime_ns();
+    int i;
+
+    for (i = 0; i < NB_DECISIONS; i++)
+    {
+        CHECK(ni_rsrc_get_least_loaded(NI_DEVICE_TYPE_DECODER,
+                                       EN_ALLOC_LEAST_LOAD) >= 0);
+        p_records = ni_rsrc_get_load_table(NI_DEVICE_TYPE_DECODER);
+        if (p_records &&
+            ni_rsrc_read_device_load(&p_records[WRITER_GUID], &record) ==
+                NI_RETCODE_SUCCESS &&
+            (record.model_load != record.load ||
+             record.active_num_inst != (uint32_t)record.load ||
+             record.xcode_load_pixel != (uint64_t)record.load * 1000))
+        {
+            (*p_torn)++;
+        }
+    }
+    return NB_DECISIONS / ((ni_gettime_ns() - t0) / 1e9);
+}
+
+int main(void)
+{
+    double idle, busy;
+    pid_t pid;
+    int torn = 0;
+    int i;
+
+    ni_log_set_level(NI_LOG_NONE);
+    snprintf(shm_name, sizeof(shm_name), "/ni_rsrc_load_table_test_%d",
+             (int)getpid());
+
+    CHECK(ni_rsrc_get_load_table(NI_DEVICE_TYPE_DECODER) != NULL);
+    test_pick();
+
+    for (i = 0; i < NB_DEVICES; i++)
+    {
+        publish(NI_DEVICE_TYPE_DECODER, i, 50 + i, 50 + i, 1);
+    }
+    publish(NI_DEVICE_TYPE_DECODER, WRITER_GUID, 0, 0, 0);
+    idle = run_decisions(&torn);
+
+    pid = fork();
+    if (pid == 0)
+    {
+        writer();
+    }
+    busy = run_decisions(&torn);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    CHECK(torn == 0);
+
+    printf("ni_rsrc_load_table_test: %d devices, %.2f M decisions/s idle, "
+           "%.2f M/s with a publishing process\n", NB_DEVICES + 1, idle / 1e6,
+           busy / 1e6);
+
+    shm_unlink(shm_name);
+
+    printf("ni_rsrc_load_table_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,415 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_rsrc_lock_test.c
+ *
+ *  \brief  Test of the resource lock file helpers ni_rsrc_lock_fd() and
+ *          ni_rsrc_unlock_fd() on a temporary lock file, without a card.
+ *          Forked processes contend for the lock and keep a shared counter
+ *          exact; a lock left by a dead process or thread is recovered; the
+ *          lock belongs to its thread; and a bounded wait stays within its
+ *          budget when both the mutex and the lockf() region are contended,
+ *          including on the first use of a file, without stalling others.
+ *          Prints the worst wait under contention against the polling
+ *          lockf(F_TLOCK) loop the helpers replaced.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "ni_device_api.h"
+#include "ni_rsrc_priv.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_PROCS        8
+#define NB_ITERS        200
+#define HOLD_US         200     // work done while holding the lock
+#define TIMEOUT_MS      300
+
+static int failures;
+static char lock_path[] = "/tmp/ni_rsrc_lock_test_XXXXXX";
+
+typedef struct
+{
+    volatile uint64_t counter;
+    volatile uint64_t max_wait_ns[NB_PROCS];
+} shared_t;
+
+static int open_lock(void)
+{
+    return open(lock_path, O_RDWR | O_CLOEXEC);
+}
+
+// the loop ni_rsrc_try_get_shm_lock() used before the robust mutex
+static void legacy_lock(int fd)
+{
+    while (lockf(fd, F_TLOCK, 0) != 0)
+    {
+        ni_usleep(LOCK_WAIT);
+    }
+}
+
+static void contend(shared_t *p_shared, int idx, int legacy)
+{
+    int fd = open_lock();
+    uint64_t t0, wait;
+    uint64_t v;
+    int i;
+
+    for (i = 0; i < NB_ITERS; i++)
+    {
+        t0 = ni_gettime_ns();
+        if (legacy)
+        {
+            legacy_lock(fd);
+        } else if (ni_rsrc_lock_fd(fd, -1) != NI_RETCODE_SUCCESS)
+        {
+            _exit(1);
+        }
+        wait = ni_gettime_ns() - t0;
+        if (wait > p_shared->max_wait_ns[idx])
+        {
+            p_shared->max_wait_ns[idx] = wait;
+        }
+        // non atomic update, only exact under mutual exclusion
+        v = p_shared->counter;
+        ni_usleep(HOLD_US);
+        p_shared->counter = v + 1;
+        if (legacy)
+        {
+            lockf(fd, F_ULOCK, 0);
+        } else
+        {
+            ni_rsrc_unlock_fd(fd);
+        }
+    }
+    close(fd);
+    _exit(0);
+}
+
+static void run_contention(shared_t *p_shared, int legacy)
+{
+    uint64_t t0, worst = 0;
+    pid_t pids[NB_PROCS];
+    int status;
+    int i;
+
+    memset((void *)p_shared, 0, sizeof(*p_shared));
+    t0 = ni_gettime_ns();
+    for (i = 0; i < NB_PROCS; i++)
+    {
+        pids[i] = fork();
+        if (pids[i] == 0)
+        {
+            contend(p_shared, i, legacy);
+        }
+    }
+    for (i = 0; i < NB_PROCS; i++)
+    {
+        CHECK(waitpid(pids[i], &status, 0) == pids[i] &&
+              WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        if (p_shared->max_wait_ns[i] > worst)
+        {
+            worst = p_shared->max_wait_ns[i];
+        }
+    }
+    CHECK(p_shared->counter == (uint64_t)NB_PROCS * NB_ITERS);
+    printf("ni_rsrc_lock_test: %s, %d procs x %d locks: %.1f ms total, "
+           "worst wait %.2f ms\n", legacy ? "lockf poll  " : "robust mutex",
+           NB_PROCS, NB_ITERS, (ni_gettime_ns() - t0) / 1e6, worst / 1e6);
+}
+
+static void *hold_and_exit(void *arg)
+{
+    CHECK(ni_rsrc_lock_fd(*(int *)arg, -1) == NI_RETCODE_SUCCESS);
+    return NULL;
+}
+
+static void test_dead_owner(void)
+{
+    pthread_t thread;
+    uint64_t t0;
+    pid_t pid;
+    int status;
+    int fd = open_lock();
+
+    // a process exiting with the lock held
+    pid = fork();
+    if (pid == 0)
+    {
+        int child_fd = open_lock();
+        _exit(ni_rsrc_lock_fd(child_fd, -1) == NI_RETCODE_SUCCESS ? 0 : 1);
+    }
+    CHECK(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+          WEXITSTATUS(status) == 0);
+    t0 = ni_gettime_ns();
+    CHECK(ni_rsrc_lock_fd(fd, 1000) == NI_RETCODE_SUCCESS);
+    printf("ni_rsrc_lock_test: lock of a dead process recovered in %.1f us\n",
+           (ni_gettime_ns() - t0) / 1e3);
+    CHECK(ni_rsrc_unlock_fd(fd) == NI_RETCODE_SUCCESS);
+
+    // a thread of this process exiting with the lock held
+    CHECK(pthread_create(&thread, NULL, hold_and_exit, &fd) == 0);
+    pthread_join(thread, NULL);
+    CHECK(ni_rsrc_lock_fd(fd, 1000) == NI_RETCODE_SUCCESS);
+    CHECK(ni_rsrc_unlock_fd(fd) == NI_RETCODE_SUCCESS);
+    close(fd);
+}
+
+static struct
+{
+    int fd;
+    int locked[2];      // holder -> main: lock taken
+    int release[2];     // main -> holder: unlock now
+} owner;
+
+static void *hold_until_released(void *arg)
+{
+    char c = 0;
+    (void)arg;
+
+    CHECK(ni_rsrc_lock_fd(owner.fd, -1) == NI_RETCODE_SUCCESS);
+    CHECK(write(owner.locked[1], &c, 1) == 1);
+    CHECK(read(owner.release[0], &c, 1) == 1);
+    CHECK(ni_rsrc_unlock_fd(owner.fd) == NI_RETCODE_SUCCESS);
+    return NULL;
+}
+
+static void test_thread_owner(void)
+{
+    pthread_t thread;
+    char c = 0;
+
+    owner.fd = open_lock();
+    CHECK(pipe(owner.locked) == 0 && pipe(owner.release) == 0);
+    CHECK(pthread_create(&thread, NULL, hold_until_released, NULL) == 0);
+    CHECK(read(owner.locked[0], &c, 1) == 1);
+
+    // other threads of the holding process are excluded and can not unlock
+    CHECK(ni_rsrc_lock_fd(owner.fd, 20) == NI_RETCODE_FAILURE);
+    CHECK(ni_rsrc_unlock_fd(owner.fd) == NI_RETCODE_FAILURE);
+
+    CHECK(write(owner.release[1], &c, 1) == 1);
+    pthread_join(thread, NULL);
+
+    // nesting on the owner thread keeps lockf() until the outermost unlock
+    CHECK(ni_rsrc_lock_fd(owner.fd, -1) == NI_RETCODE_SUCCESS);
+    CHECK(ni_rsrc_lock_fd(owner.fd, -1) == NI_RETCODE_SUCCESS);
+    CHECK(ni_rsrc_unlock_fd(owner.fd) == NI_RETCODE_SUCCESS);
+    if (fork() == 0)
+    {
+        int child_fd = open_lock();
+        _exit(lockf(child_fd, F_TEST, 0) == 0 ? 1 : 0);
+    }
+    CHECK(wait(NULL) > 0);
+    CHECK(ni_rsrc_unlock_fd(owner.fd) == NI_RETCODE_SUCCESS);
+    CHECK(ni_rsrc_unlock_fd(owner.fd) == NI_RETCODE_FAILURE);
+
+    close(owner.locked[0]);
+    close(owner.locked[1]);
+    close(owner.release[0]);
+    close(owner.release[1]);
+    close(owner.fd);
+}
+
+static void test_timeout_budget(void)
+{
+    int sync_pipe[2];
+    uint64_t t0, elapsed_ms;
+    pid_t mutex_holder, lockf_holder;
+    char c = 0;
+    int fd = open_lock();
+
+    CHECK(pipe(sync_pipe) == 0);
+
+    // the first child keeps the mutex for half the budget but hands the
+    // lockf() region over to a second child that uses lockf() alone
+    mutex_holder = fork();
+    if (mutex_holder == 0)
+    {
+        int child_fd = open_lock();
+        if (ni_rsrc_lock_fd(child_fd, -1) != NI_RETCODE_SUCCESS)
+        {
+            _exit(1);
+        }
+        lockf(child_fd, F_ULOCK, 0);
+        if (write(sync_pipe[1], &c, 1) != 1)
+        {
+            _exit(1);
+        }
+        ni_usleep(TIMEOUT_MS / 2 * 1000);
+        _exit(ni_rsrc_unlock_fd(child_fd) == NI_RETCODE_SUCCESS ? 0 : 1);
+    }
+    CHECK(read(sync_pipe[0], &c, 1) == 1);
+    lockf_holder = fork();
+    if (lockf_holder == 0)
+    {
+        int child_fd = open_lock();
+        if (lockf(child_fd, F_LOCK, 0) != 0 || write(sync_pipe[1], &c, 1) != 1)
+        {
+            _exit(1);
+        }
+        pause();
+        _exit(0);
+    }
+    CHECK(read(sync_pipe[0], &c, 1) == 1);
+
+    t0 = ni_gettime_ns();
+    CHECK(ni_rsrc_lock_fd(fd, TIMEOUT_MS) == NI_RETCODE_FAILURE);
+    elapsed_ms = (ni_gettime_ns() - t0) / 1000000;
+    printf("ni_rsrc_lock_test: %d ms bounded wait gave up after %d ms\n",
+           TIMEOUT_MS, (int)elapsed_ms);
+    CHECK(elapsed_ms >= TIMEOUT_MS - 1);
+    CHECK(elapsed_ms < TIMEOUT_MS + 2 * LOCK_WAIT / 1000);
+
+    kill(lockf_holder, SIGKILL);
+    waitpid(lockf_holder, NULL, 0);
+    waitpid(mutex_holder, NULL, 0);
+    close(sync_pipe[0]);
+    close(sync_pipe[1]);
+    close(fd);
+}
+
+typedef struct
+{
+    int fd;
+    ni_retcode_t ret;
+    uint64_t elapsed_ms;
+} first_lock_t;
+
+static void *first_lock(void *arg)
+{
+    first_lock_t *p_first = (first_lock_t *)arg;
+    uint64_t t0 = ni_gettime_ns();
+
+    p_first->ret = ni_rsrc_lock_fd(p_first->fd, TIMEOUT_MS);
+    p_first->elapsed_ms = (ni_gettime_ns() - t0) / 1000000;
+    return NULL;
+}
+
+// the first use of a lock file held by a lockf() only process keeps to the
+// budget, and other lock files of the process are not stalled meanwhile
+static void test_first_use_budget(void)
+{
+    char new_path[] = "/tmp/ni_rsrc_lock_test_XXXXXX";
+    int sync_pipe[2];
+    first_lock_t first;
+    pthread_t thread;
+    pid_t lockf_holder;
+    uint64_t t0, other_ms;
+    char c = 0;
+    int fd = open_lock();
+    int i;
+
+    first.fd = mkstemp(new_path);
+    CHECK(first.fd >= 0 && pipe(sync_pipe) == 0);
+    lockf_holder = fork();
+    if (lockf_holder == 0)
+    {
+        if (lockf(first.fd, F_LOCK, 0) != 0 || write(sync_pipe[1], &c, 1) != 1)
+        {
+            _exit(1);
+        }
+        pause();
+        _exit(0);
+    }
+    CHECK(read(sync_pipe[0], &c, 1) == 1);
+
+    CHECK(pthread_create(&thread, NULL, first_lock, &first) == 0);
+    ni_usleep(TIMEOUT_MS / 3 * 1000);
+    t0 = ni_gettime_ns();
+    for (i = 0; i < 10; i++)
+    {
+        CHECK(ni_rsrc_lock_fd(fd, TIMEOUT_MS) == NI_RETCODE_SUCCESS);
+        CHECK(ni_rsrc_unlock_fd(fd) == NI_RETCODE_SUCCESS);
+    }
+    other_ms = (ni_gettime_ns() - t0) / 1000000;
+    pthread_join(thread, NULL);
+    printf("ni_rsrc_lock_test: first use gave up after %d ms, 10 locks of "
+           "another file meanwhile took %d ms\n", (int)first.elapsed_ms,
+           (int)other_ms);
+    CHECK(first.ret == NI_RETCODE_FAILURE);
+    CHECK(first.elapsed_ms >= TIMEOUT_MS - 1);
+    CHECK(first.elapsed_ms < TIMEOUT_MS + 2 * LOCK_WAIT / 1000);
+    CHECK(other_ms < TIMEOUT_MS / 3);
+
+    // once the holder is gone the file is set up on the next lock
+    kill(lockf_holder, SIGKILL);
+    waitpid(lockf_holder, NULL, 0);
+    CHECK(ni_rsrc_lock_fd(first.fd, TIMEOUT_MS) == NI_RETCODE_SUCCESS);
+    CHECK(ni_rsrc_unlock_fd(first.fd) == NI_RETCODE_SUCCESS);
+
+    close(sync_pipe[0]);
+    close(sync_pipe[1]);
+    close(first.fd);
+    close(fd);
+    unlink(new_path);
+}
+
+int main(void)
+{
+    shared_t *p_shared;
+    int fd;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    fd = mkstemp(lock_path);
+    p_shared = (shared_t *)mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (fd < 0 || p_shared == MAP_FAILED)
+    {
+        fprintf(stderr, "ni_rsrc_lock_test: setup failed\n");
+        return 1;
+    }
+    close(fd);
+
+    run_contention(p_shared, 1);
+    run_contention(p_shared, 0);
+    test_dead_owner();
+    test_thread_owner();
+    test_timeout_budget();
+    test_first_use_budget();
+
+    munmap(p_shared, sizeof(shared_t));
+    unlink(lock_path);
+
+    printf("ni_rsrc_lock_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+
+/*!*****************************************************************************
+ *  \file   ni_scaler_batch_test.c
+ *
+ *  \brief  Test of ni_device_scaler_batch_submit() without a card: the NVMe
+ *          read and write commands are replaced at link time (-Wl,--wrap) by
+ *          a model of a scaler instance that can fail a given job. Checks
+ *          that the completion of each job is checked before its output is
+ *          queried, that the batch stops at the first failed job and that a
+ *          job with an output needs a hw descriptor to return it in.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_nvme.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define SESSION_ID     3
+#define NB_JOBS        3
+#define FRAME_IDX_BASE 100
+
+static int failures;
+
+static struct
+{
+    int writes;             // job configs sent
+    int status_reads;       // completion checks
+    int hwdesc_reads;       // output frame index queries
+    int checked;            // the last config sent was checked
+    int unchecked_reads;    // output queries of an unchecked config
+    int fail_job;           // job whose config fails, -1 for none
+} mock;
+
+int32_t __wrap_ni_nvme_send_read_cmd(ni_device_handle_t handle,
+                                     ni_event_handle_t event_handle,
+                                     void *p_data, uint32_t data_len,
+                                     uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    memset(p_data, 0, data_len);
+    if (lba == QUERY_SESSION_STATS_R(SESSION_ID, NI_DEVICE_TYPE_SCALER))
+    {
+        ni_session_stats_t *p_stats = (ni_session_stats_t *)p_data;
+        mock.status_reads++;
+        mock.checked = 1;
+        p_stats->ui16SessionId = ni_htons(SESSION_ID);
+        if (mock.writes - 1 == mock.fail_job)
+        {
+            p_stats->ui32LastTransactionCompletionStatus =
+                ni_htonl(NI_RETCODE_NVME_SC_INVALID_PARAMETER);
+        }
+        return 0;
+    }
+    if (lba == QUERY_INSTANCE_UPLOAD_ID_R(SESSION_ID, NI_DEVICE_TYPE_SCALER))
+    {
+        ni_instance_buf_info_t *p_info = (ni_instance_buf_info_t *)p_data;
+        mock.hwdesc_reads++;
+        mock.unchecked_reads += !mock.checked;
+        p_info->hw_inst_ind.buffer_avail = 1;
+        p_info->hw_inst_ind.frame_index = FRAME_IDX_BASE + mock.writes - 1;
+        return 0;
+    }
+    fprintf(stderr, "unexpected read of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+int32_t __wrap_ni_nvme_send_write_cmd(ni_device_handle_t handle,
+                                      ni_event_handle_t event_handle,
+                                      void *p_data, uint32_t data_len,
+                                      uint32_t lba)
+{
+    (void)handle;
+    (void)event_handle;
+    (void)p_data;
+    (void)data_len;
+    if (lba ==
+        CONFIG_INSTANCE_SetScalerAlloc_W(SESSION_ID, NI_DEVICE_TYPE_SCALER))
+    {
+        mock.writes++;
+        mock.checked = 0;
+        return 0;
+    }
+    fprintf(stderr, "unexpected write of lba 0x%x\n", lba);
+    failures++;
+    return -1;
+}
+
+static void open_ctx(ni_session_context_t *p_ctx)
+{
+    ni_device_session_context_init(p_ctx);
+    p_ctx->device_type = NI_DEVICE_TYPE_SCALER;
+    p_ctx->session_id = SESSION_ID;
+    p_ctx->session_timestamp = 0;
+}
+
+// NB_JOBS jobs scaling frame i into a new frame, with an output or not
+static ni_scaler_batch_t *queue_jobs(ni_session_context_t *p_ctx, int has_out)
+{
+    ni_scaler_batch_t *p_batch = ni_scaler_batch_alloc(NB_JOBS);
+    ni_frame_config_t in, out;
+    int i;
+
+    CHECK(p_batch != NULL);
+    if (!p_batch)
+    {
+        return NULL;
+    }
+    memset(&mock, 0, sizeof(mock));
+    mock.fail_job = -1;
+    memset(&in, 0, sizeof(in));
+    memset(&out, 0, sizeof(out));
+    in.picture_width = in.rectangle_width = 1280;
+    in.picture_height = in.rectangle_height = 720;
+    in.picture_format = GC620_I420;
+    in.session_id = SESSION_ID;
+    out.picture_width = out.rectangle_width = 640;
+    out.picture_height = out.rectangle_height = 360;
+    out.picture_format = GC620_I420;
+    for (i = 0; i < NB_JOBS; i++)
+    {
+        in.frame_index = 10 + i;
+        CHECK(ni_scaler_batch_add(p_ctx, p_batch, &in, 1,
+                                  has_out ? &out : NULL) ==
+              NI_RETCODE_SUCCESS);
+    }
+    return p_batch;
+}
+
+static void test_submit(void)
+{
+    ni_session_context_t ctx;
+    ni_scaler_batch_t *p_batch;
+    niFrameSurface1_t out[NB_JOBS];
+    int i;
+
+    // every job is checked, then its output queried
+    open_ctx(&ctx);
+    p_batch = queue_jobs(&ctx, 1);
+    CHECK(ni_device_scaler_batch_submit(&ctx, p_batch, out) == NB_JOBS);
+    CHECK(mock.writes == NB_JOBS);
+    CHECK(mock.hwdesc_reads == NB_JOBS);
+    CHECK(mock.unchecked_reads == 0);
+    for (i = 0; i < NB_JOBS; i++)
+    {
+        CHECK(out[i].ui16FrameIdx == FRAME_IDX_BASE + i);
+        CHECK(out[i].ui16session_ID == SESSION_ID);
+    }
+    CHECK(p_batch->nb_jobs == 0);
+
+    // a failed job hands out no frame and ends the batch
+    ni_scaler_batch_free(p_batch);
+    p_batch = queue_jobs(&ctx, 1);
+    mock.fail_job = 1;
+    CHECK(ni_device_scaler_batch_submit(&ctx, p_batch, out) == 1);
+    CHECK(mock.writes == 2);
+    CHECK(mock.hwdesc_reads == 1);
+    CHECK(out[0].ui16FrameIdx == FRAME_IDX_BASE);
+
+    // the first job failing fails the batch
+    ni_scaler_batch_free(p_batch);
+    p_batch = queue_jobs(&ctx, 1);
+    mock.fail_job = 0;
+    CHECK(ni_device_scaler_batch_submit(&ctx, p_batch, out) < 0);
+    CHECK(mock.writes == 1);
+    CHECK(mock.hwdesc_reads == 0);
+
+    // outputs need somewhere to go
+    ni_scaler_batch_free(p_batch);
+    p_batch = queue_jobs(&ctx, 1);
+    CHECK(ni_device_scaler_batch_submit(&ctx, p_batch, NULL) ==
+          NI_RETCODE_INVALID_PARAM);
+    CHECK(mock.writes == 0);
+    ni_scaler_batch_free(p_batch);
+
+    // unless there are none
+    p_batch = queue_jobs(&ctx, 0);
+    CHECK(ni_device_scaler_batch_submit(&ctx, p_batch, NULL) == NB_JOBS);
+    CHECK(mock.writes == NB_JOBS);
+    CHECK(mock.status_reads == NB_JOBS);
+    CHECK(mock.hwdesc_reads == 0);
+    ni_scaler_batch_free(p_batch);
+
+    ni_device_session_context_clear(&ctx);
+}
+
+int main(void)
+{
+    ni_log_set_level(NI_LOG_NONE);
+
+    test_submit();
+
+    printf("ni_scaler_batch_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,264 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_session_pool_test.c
+ *
+ *  \brief  Test of the warm session pool without a card: the stream info
+ *          query, encoder restart and decoder flush are replaced at link time
+ *          (-Wl,--wrap) and sessions are opened and closed by mock
+ *          callbacks. Checks which released encoders are kept and that a
+ *          drained one is restarted on the supported path, and prints the
+ *          per-job startup latency of a warm acquire against a cold open.
+ *          The cold open is modelled as OPEN_CMDS NVMe commands of
+ *          CMD_LATENCY_US each on top of the context allocation, the restart
+ *          as one command.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_device_api.h"
+#include "ni_device_api_priv.h"
+#include "ni_log.h"
+#include "ni_session_pool.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define OPEN_CMDS       12      // open, query, config and buffer setup
+#define CMD_LATENCY_US  20      // modelled round trip of one NVMe command
+#define NB_JOBS         200
+
+static int failures;
+
+static struct
+{
+    int is_flushed;     // what the device reports for the encoder stream
+    int opens;
+    int closes;
+    int restarts;
+    int restart_width;
+    int restart_height;
+    uint32_t next_session_id;
+} mock;
+
+ni_retcode_t __wrap_ni_query_stream_info(ni_session_context_t *p_ctx,
+                                         ni_device_type_t device_type,
+                                         ni_instance_mgr_stream_info_t *p_info)
+{
+    (void)p_ctx;
+    CHECK(NI_DEVICE_TYPE_ENCODER == device_type);
+    memset(p_info, 0, sizeof(*p_info));
+    p_info->is_flushed = (uint16_t)mock.is_flushed;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t __wrap_ni_device_session_restart(ni_session_context_t *p_ctx,
+                                              int video_width, int video_height,
+                                              ni_device_type_t device_type)
+{
+    // the state checked by the real restart
+    CHECK(SESSION_RUN_STATE_FLUSHING == p_ctx->session_run_state);
+    CHECK(NI_DEVICE_TYPE_ENCODER == device_type);
+    ni_usleep(CMD_LATENCY_US);
+    mock.restarts++;
+    mock.restart_width = video_width;
+    mock.restart_height = video_height;
+    p_ctx->ready_to_close = 0;
+    p_ctx->frame_num = 0;
+    p_ctx->pkt_num = 0;
+    return NI_RETCODE_SUCCESS;
+}
+
+ni_retcode_t __wrap_ni_device_dec_session_flush(ni_session_context_t *p_ctx)
+{
+    (void)p_ctx;
+    return NI_RETCODE_SUCCESS;
+}
+
+static ni_retcode_t open_session(void *opaque, const ni_session_pool_key_t *p_key,
+                                 int width, int height,
+                                 ni_session_context_t **pp_ctx)
+{
+    ni_session_context_t *p_ctx = ni_device_session_context_alloc_init();
+    (void)opaque;
+    (void)width;
+    (void)height;
+
+    if (!p_ctx)
+    {
+        return NI_RETCODE_ERROR_MEM_ALOC;
+    }
+    ni_usleep(OPEN_CMDS * CMD_LATENCY_US);
+    p_ctx->device_type = p_key->device_type;
+    p_ctx->hw_id = 0;
+    p_ctx->session_id = mock.next_session_id++;
+    mock.opens++;
+    *pp_ctx = p_ctx;
+    return NI_RETCODE_SUCCESS;
+}
+
+static void close_session(void *opaque, const ni_session_pool_key_t *p_key,
+                          ni_session_context_t *p_ctx)
+{
+    (void)opaque;
+    (void)p_key;
+    mock.closes++;
+    ni_device_session_context_free(p_ctx);
+}
+
+// what a job leaves behind in the encoder context
+static void run_job(ni_session_context_t *p_ctx, int frames, int eos_sent)
+{
+    p_ctx->frame_num += frames;
+    p_ctx->pkt_num += frames;
+    p_ctx->ready_to_close = eos_sent;
+}
+
+static void test_encoder_reuse(ni_session_pool_t *p_pool,
+                               const ni_session_pool_key_t *p_key)
+{
+    ni_session_context_t *p_ctx, *p_ctx2;
+    int opens = mock.opens;
+    int closes = mock.closes;
+
+    // never fed: kept, reused only at the same resolution
+    CHECK(ni_session_pool_acquire(p_pool, p_key, 1280, 720, &p_ctx) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) == NI_RETCODE_SUCCESS);
+    CHECK(ni_session_pool_acquire(p_pool, p_key, 1280, 720, &p_ctx2) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(p_ctx2 == p_ctx);
+    CHECK(mock.restarts == 0);
+
+    // end of stream sent and read back: parked flushing, restarted at the
+    // resolution of the next job
+    run_job(p_ctx, 30, 1);
+    mock.is_flushed = 1;
+    CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) == NI_RETCODE_SUCCESS);
+    CHECK(SESSION_RUN_STATE_FLUSHING == p_ctx->session_run_state);
+    CHECK(ni_session_pool_acquire(p_pool, p_key, 640, 360, &p_ctx2) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(p_ctx2 == p_ctx);
+    CHECK(mock.restarts == 1);
+    CHECK(mock.restart_width == 640 && mock.restart_height == 360);
+    CHECK(SESSION_RUN_STATE_NORMAL == p_ctx->session_run_state);
+    CHECK(p_ctx->ready_to_close == 0);
+
+    // the caller may have flagged the flush itself
+    run_job(p_ctx, 30, 1);
+    p_ctx->session_run_state = SESSION_RUN_STATE_FLUSHING;
+    CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) == NI_RETCODE_SUCCESS);
+    CHECK(ni_session_pool_acquire(p_pool, p_key, 640, 360, &p_ctx2) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(p_ctx2 == p_ctx);
+    CHECK(mock.restarts == 2);
+    CHECK(mock.opens == opens + 1);
+
+    // end of stream sent but packets still pending: closed
+    run_job(p_ctx, 30, 1);
+    mock.is_flushed = 0;
+    CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) == NI_RETCODE_FAILURE);
+    CHECK(mock.closes == closes + 1);
+
+    // fed without end of stream: closed
+    CHECK(ni_session_pool_acquire(p_pool, p_key, 640, 360, &p_ctx) ==
+          NI_RETCODE_SUCCESS);
+    CHECK(mock.opens == opens + 2);
+    run_job(p_ctx, 30, 0);
+    CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) == NI_RETCODE_FAILURE);
+    CHECK(mock.closes == closes + 2);
+}
+
+static void measure_startup(ni_session_pool_t *p_pool,
+                            const ni_session_pool_key_t *p_key)
+{
+    ni_session_pool_stats_t before, after;
+    ni_session_context_t *p_ctx;
+    uint64_t cold_ns = 0, t0;
+    int i;
+
+    // without the pool every job opens and closes its session
+    for (i = 0; i < NB_JOBS; i++)
+    {
+        t0 = ni_gettime_ns();
+        CHECK(open_session(NULL, p_key, 1920, 1080, &p_ctx) ==
+              NI_RETCODE_SUCCESS);
+        cold_ns += ni_gettime_ns() - t0;
+        close_session(NULL, p_key, p_ctx);
+    }
+
+    // with the pool every job after the first gets a drained warm encoder
+    mock.is_flushed = 1;
+    CHECK(ni_session_pool_get_stats(p_pool, &before) == NI_RETCODE_SUCCESS);
+    for (i = 0; i < NB_JOBS; i++)
+    {
+        CHECK(ni_session_pool_acquire(p_pool, p_key, 1920, 1080, &p_ctx) ==
+              NI_RETCODE_SUCCESS);
+        run_job(p_ctx, 10, 1);
+        CHECK(ni_session_pool_release(p_pool, NULL, p_ctx) ==
+              NI_RETCODE_SUCCESS);
+    }
+    CHECK(ni_session_pool_get_stats(p_pool, &after) == NI_RETCODE_SUCCESS);
+    CHECK(after.hits - before.hits >= NB_JOBS - 1);
+
+    printf("ni_session_pool_test: encoder job startup, cold open %.1f us, "
+           "warm acquire with restart %.1f us (%" PRIu64 " hits, %" PRIu64
+           " misses)\n", cold_ns / 1e3 / NB_JOBS,
+           (after.hit_ns - before.hit_ns) / 1e3 /
+               (double)(after.hits - before.hits),
+           after.hits - before.hits, after.misses - before.misses);
+}
+
+int main(void)
+{
+    ni_session_pool_key_t key = {NI_DEVICE_TYPE_ENCODER, -1,
+                                 NI_CODEC_FORMAT_H264, 0x1234};
+    ni_session_pool_t *p_pool;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    p_pool = ni_session_pool_alloc(4, 0, open_session, close_session, NULL);
+    if (!p_pool)
+    {
+        fprintf(stderr, "ni_session_pool_test: setup failed\n");
+        return 1;
+    }
+
+    test_encoder_reuse(p_pool, &key);
+    measure_startup(p_pool, &key);
+
+    ni_session_pool_free(p_pool);
+    CHECK(mock.opens == mock.closes);
+
+    printf("ni_session_pool_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
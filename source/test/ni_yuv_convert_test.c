@@ -0,0 +1,676 @@
+/*******************************************************************************
+ *
+ * Copyright (C) 2022 NETINT Technologies
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ ******************************************************************************/
+
+/*!*****************************************************************************
+ *  \file   ni_yuv_convert_test.c
+ *
+ *  \brief  Differential test of the 4:4:4 to 4:2:0 conversions of ni_util.c
+ *          and of the edge padding of ni_expand_frame(). The row kernels
+ *          picked for the running CPU, single and multi threaded, are
+ *          compared byte for byte, including the bytes they must not touch,
+ *          against the per sample loops they replaced, kept here as the
+ *          reference, and against a per sample model of
+ *          ni_convert_yuv_444p_to_420p().
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ni_av_codec.h"
+#include "ni_device_api.h"
+#include "ni_log.h"
+#include "ni_util.h"
+
+#define CHECK(cond)                                                            \
+    do                                                                         \
+    {                                                                          \
+        if (!(cond))                                                           \
+        {                                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,  \
+                    #cond);                                                    \
+            failures++;                                                        \
+        }                                                                      \
+    } while (0)
+
+#define NB_RANDOM   60      // random sizes per case
+#define POISON      0xa5    // destination fill, must survive outside outputs
+
+static int failures;
+static uint32_t seed = 1;
+
+static uint32_t rnd(void)
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static int rnd_range(int lo, int hi)
+{
+    return lo + (int)(rnd() % (uint32_t)(hi - lo + 1));
+}
+
+// random samples, 10 bit when bps is 2
+static void fill_plane(uint8_t *p, size_t size, int bps)
+{
+    size_t i;
+
+    if (bps == 1)
+    {
+        for (i = 0; i < size; i++)
+        {
+            p[i] = (uint8_t)rnd();
+        }
+    } else
+    {
+        for (i = 0; i + 1 < size; i += 2)
+        {
+            ((uint16_t *)p)[i / 2] = (uint16_t)(rnd() & 0x3ff);
+        }
+    }
+}
+
+/*
+ * Reference: ni_copy_yuv_444p_to_420p() before the row kernels, unchanged
+ * apart from the ref_ prefix. For mode 1 with odd widths it wrote past the
+ * half lines it was given, so that combination is not compared.
+ */
+static void ref_copy_yuv_444p_to_420p(uint8_t *p_dst0[NI_MAX_NUM_DATA_POINTERS],
+                                      uint8_t *p_dst1[NI_MAX_NUM_DATA_POINTERS],
+                                      uint8_t *p_src[NI_MAX_NUM_DATA_POINTERS],
+                                      int frame_width, int frame_height,
+                                      int factor, int mode)
+{
+    int i, j;
+    int y_444p_linesize = frame_width * factor;
+    int uv_444p_linesize = y_444p_linesize;
+    int y_420p_linesize = NI_VPU_ALIGN128(y_444p_linesize);
+    int uv_420p_linesize = NI_VPU_ALIGN128(uv_444p_linesize / 2);
+
+    // return to avoid self copy
+    if (p_dst0[0] == p_dst1[0] && p_dst0[1] == p_dst1[1] &&
+        p_dst0[2] == p_dst1[2])
+    {
+        return;
+    }
+
+    // Y component
+    for (i = 0; i < frame_height; i++)
+    {
+        memcpy(&p_dst0[0][i * y_420p_linesize], &p_src[0][i * y_444p_linesize],
+               y_444p_linesize);
+    }
+
+    if (mode == 0)
+    {
+        // U component
+        for (i = 0; i < frame_height; i++)
+        {
+            memcpy(&p_dst1[0][i * y_420p_linesize],
+                   &p_src[1][i * y_444p_linesize], y_444p_linesize);
+        }
+
+        for (i = 0; i < frame_height / 2; i++)
+        {
+            for (j = 0; j < frame_width * factor / 2; j += factor)
+            {
+                // V component
+                // even line
+                memcpy(&p_dst0[1][i * uv_420p_linesize + j],
+                       &p_src[2][2 * i * uv_444p_linesize + 2 * j],
+                       factor);
+                memcpy(&p_dst0[2][i * uv_420p_linesize + j],
+                       &p_src[2][2 * i * uv_444p_linesize + (2 * j + factor)],
+                       factor);
+                // odd line
+                memcpy(&p_dst1[1][i * uv_420p_linesize + j],
+                       &p_src[2][(2 * i + 1) * uv_444p_linesize + 2 * j],
+                       factor);
+                memcpy(&p_dst1[2][i * uv_420p_linesize + j],
+                       &p_src[2][(2 * i + 1) * uv_444p_linesize + (2 * j + factor)],
+                       factor);
+            }
+        }
+    } else
+    {
+        for (i = 0; i < frame_height / 2; i++)
+        {
+            for (j = 0; j < frame_width * factor / 2; j += factor)
+            {
+                // U component
+                // even line 0.25U
+                memcpy(&p_dst1[1][i * uv_420p_linesize + j],
+                       &p_src[1][2 * i * uv_444p_linesize + (2 * j + factor)],
+                       factor);
+                // odd line 0.5U
+                memcpy(&p_dst1[0][2 * i * uv_444p_linesize + 2 * j],
+                       &p_src[1][(2 * i + 1) * uv_444p_linesize + 2 * j],
+                       factor * 2);
+                // even line 0.25U
+                memcpy(&p_dst0[1][i * uv_420p_linesize + j],
+                       &p_src[1][2 * i * uv_444p_linesize + 2 * j],
+                       factor);
+
+                // V component
+                // even line 0.25V
+                memcpy(&p_dst1[2][i * uv_420p_linesize + j],
+                       &p_src[2][2 * i * uv_444p_linesize + (2 * j + factor)],
+                       factor);
+                // odd line 0.5V
+                memcpy(&p_dst1[0][(2 * i + 1) * uv_444p_linesize + 2 * j],
+                       &p_src[2][(2 * i + 1) * uv_444p_linesize + 2 * j],
+                       factor * 2);
+                // even line 0.25V
+                memcpy(&p_dst0[2][i * uv_420p_linesize + j],
+                       &p_src[2][2 * i * uv_444p_linesize + 2 * j],
+                       factor);
+            }
+        }
+    }
+}
+
+/*
+ * Reference: ni_expand_frame() before the doubling copies, unchanged apart
+ * from the ref_ prefix and the error log.
+ */
+static int ref_expand_frame(ni_frame_t *dst, ni_frame_t *src, int dst_stride[],
+                            int raw_width, int raw_height, int ni_fmt,
+                            int nb_planes)
+{
+    int i, j, h, tenBit = 0;
+    int vpad[3], hpad[3], src_height[3], src_width[3], src_stride[3];
+    uint8_t *src_line, *dst_line, *sample, *dest, YUVsample;
+    uint16_t lastidx;
+
+    switch (ni_fmt)
+    {
+        case NI_PIX_FMT_YUV420P:
+            src_width[0] = NIALIGN(raw_width, 2);
+            src_width[1] = NIALIGN(raw_width, 2) / 2;
+            src_width[2] = NIALIGN(raw_width, 2) / 2;
+            src_height[0] = NIALIGN(raw_height, 2);
+            src_height[1] = NIALIGN(raw_height, 2) / 2;
+            src_height[2] = NIALIGN(raw_height, 2) / 2;
+            src_stride[0] = NIALIGN(src_width[0], 128);
+            src_stride[1] = NIALIGN(src_width[1], 128);
+            src_stride[2] = NIALIGN(src_width[2], 128);
+            tenBit = 0;
+            hpad[0] = dst_stride[0] - src_width[0];
+            hpad[1] = dst_stride[1] - src_width[1];
+            hpad[2] = dst_stride[2] - src_width[2];
+            vpad[0] = NI_MIN_HEIGHT - src_height[0];
+            vpad[1] = NI_MIN_HEIGHT / 2 - src_height[1];
+            vpad[2] = NI_MIN_HEIGHT / 2 - src_height[2];
+            break;
+
+        case NI_PIX_FMT_YUV420P10LE:
+            src_width[0] = NIALIGN(raw_width, 2);
+            src_width[1] = NIALIGN(raw_width, 2) / 2;
+            src_width[2] = NIALIGN(raw_width, 2) / 2;
+            src_height[0] = NIALIGN(raw_height, 2);
+            src_height[1] = NIALIGN(raw_height, 2) / 2;
+            src_height[2] = NIALIGN(raw_height, 2) / 2;
+            src_stride[0] = NIALIGN(src_width[0] * 2, 128);
+            src_stride[1] = NIALIGN(src_width[1] * 2, 128);
+            src_stride[2] = NIALIGN(src_width[2] * 2, 128);
+            tenBit = 1;
+            hpad[0] = dst_stride[0] - src_width[0] * 2;
+            hpad[1] = dst_stride[1] - src_width[1] * 2;
+            hpad[2] = dst_stride[2] - src_width[2] * 2;
+            vpad[0] = NI_MIN_HEIGHT - src_height[0];
+            vpad[1] = NI_MIN_HEIGHT / 2 - src_height[1];
+            vpad[2] = NI_MIN_HEIGHT / 2 - src_height[2];
+            break;
+
+        case NI_PIX_FMT_NV12:
+            src_width[0] = NIALIGN(raw_width, 2);
+            src_width[1] = NIALIGN(raw_width, 2);
+            src_width[2] = 0;
+            src_height[0] = NIALIGN(raw_height, 2);
+            src_height[1] = NIALIGN(raw_height, 2) / 2;
+            src_height[2] = 0;
+            src_stride[0] = NIALIGN(src_width[0], 128);
+            src_stride[1] = NIALIGN(src_width[1], 128);
+            src_stride[2] = 0;
+            tenBit = 0;
+            hpad[0] = dst_stride[0] - src_width[0];
+            hpad[1] = dst_stride[1] - src_width[1];
+            hpad[2] = 0;
+            vpad[0] = NI_MIN_HEIGHT - src_height[0];
+            vpad[1] = NI_MIN_HEIGHT / 2 - src_height[1];
+            vpad[2] = 0;
+            break;
+
+        case NI_PIX_FMT_P010LE:
+            src_width[0] = NIALIGN(raw_width, 2);
+            src_width[1] = NIALIGN(raw_width, 2);
+            src_width[2] = 0;
+            src_height[0] = NIALIGN(raw_height, 2);
+            src_height[1] = NIALIGN(raw_height, 2) / 2;
+            src_height[2] = 0;
+            src_stride[0] = NIALIGN(src_width[0] * 2, 128);
+            src_stride[1] = NIALIGN(src_width[1] * 2, 128);
+            src_stride[2] = 0;
+            tenBit = 1;
+            hpad[0] = dst_stride[0] - src_width[0] * 2;
+            hpad[1] = dst_stride[1] - src_width[1] * 2;
+            hpad[2] = 0;
+            vpad[0] = NI_MIN_HEIGHT - src_height[0];
+            vpad[1] = NI_MIN_HEIGHT / 2 - src_height[1];
+            vpad[2] = 0;
+            break;
+
+        default:
+            return NI_RETCODE_FAILURE;
+    }
+
+    for (i = 0; i < nb_planes && nb_planes < NI_MAX_NUM_DATA_POINTERS; i++)
+    {
+        dst_line = dst->p_data[i];
+        src_line = src->p_data[i];
+
+        for (h = 0; i < 3 && h < src_height[i]; h++)
+        {
+            memcpy(dst_line, src_line, src_width[i] * (tenBit + 1));
+
+            /* Add horizontal padding */
+            if (hpad[i])
+            {
+                lastidx = src_width[i];
+
+                if (tenBit)
+                {
+                    sample = &src_line[(lastidx - 1) * 2];
+                    dest = &dst_line[lastidx * 2];
+
+                    /* two bytes per sample */
+                    for (j = 0; j < hpad[i] / 2; j++)
+                    {
+                        memcpy(dest, sample, 2);
+                        dest += 2;
+                    }
+                } else
+                {
+                    YUVsample = dst_line[lastidx - 1];
+                    memset(&dst_line[lastidx], YUVsample, hpad[i]);
+                }
+            }
+
+            src_line += src_stride[i];
+            dst_line += dst_stride[i];
+        }
+
+        /* Pad the height by duplicating the last line */
+        src_line = dst_line - dst_stride[i];
+
+        for (h = 0; h < vpad[i]; h++)
+        {
+            memcpy(dst_line, src_line, dst_stride[i]);
+            dst_line += dst_stride[i];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Model of ni_convert_yuv_444p_to_420p() one output sample at a time, from
+ * its documented behaviour: edges replicated, box center sited, [1 2 1]
+ * left sited, P010 shifted to the MSBs.
+ */
+static int sample_at(uint8_t *p_src[], const int src_stride[], int plane,
+                     int bps, int x, int y)
+{
+    const uint8_t *line = p_src[plane] + (size_t)y * src_stride[plane];
+    return (bps == 1) ? line[x] : ((const uint16_t *)line)[x];
+}
+
+static void put_sample(uint8_t *p, int bps, int idx, int v)
+{
+    if (bps == 1)
+    {
+        p[idx] = (uint8_t)v;
+    } else
+    {
+        ((uint16_t *)p)[idx] = (uint16_t)v;
+    }
+}
+
+static void model_convert(uint8_t *p_dst[], const int dst_stride[],
+                          int dst_width, int dst_height, int bps,
+                          int semiplanar, int shift, uint8_t *p_src[],
+                          const int src_stride[], int width, int height,
+                          ni_chroma_filter_t filter)
+{
+    int x, y, plane;
+
+    for (y = 0; y < dst_height; y++)
+    {
+        for (x = 0; x < dst_width; x++)
+        {
+            put_sample(p_dst[0] + (size_t)y * dst_stride[0], bps, x,
+                       sample_at(p_src, src_stride, 0, bps,
+                                 ni_min(x, width - 1),
+                                 ni_min(y, height - 1)) << shift);
+        }
+    }
+
+    for (y = 0; y < (dst_height + 1) / 2; y++)
+    {
+        int sy = ni_min(y, (height + 1) / 2 - 1);
+        int y0 = ni_min(2 * sy, height - 1);
+        int y1 = ni_min(2 * sy + 1, height - 1);
+
+        for (x = 0; x < (dst_width + 1) / 2; x++)
+        {
+            int sx = ni_min(x, (width + 1) / 2 - 1);
+            int x0 = ni_min(2 * sx, width - 1);
+            int x1 = ni_min(2 * sx + 1, width - 1);
+            int xm = ni_min(sx ? 2 * sx - 1 : 0, width - 1);
+
+            for (plane = 1; plane <= 2; plane++)
+            {
+                int v;
+#define S(xx, yy) sample_at(p_src, src_stride, plane, bps, xx, yy)
+                if (filter == NI_CHROMA_FILTER_BOX)
+                {
+                    v = (S(x0, y0) + S(x1, y0) + S(x0, y1) + S(x1, y1) + 2) >>
+                        2;
+                } else if (filter == NI_CHROMA_FILTER_LEFT)
+                {
+                    v = (S(xm, y0) + S(xm, y1) + 2 * (S(x0, y0) + S(x0, y1)) +
+                         S(x1, y0) + S(x1, y1) + 4) >> 3;
+                } else
+                {
+                    v = S(x0, y0);
+                }
+#undef S
+                if (semiplanar)
+                {
+                    put_sample(p_dst[1] + (size_t)y * dst_stride[1], bps,
+                               2 * x + plane - 1, v << shift);
+                } else
+                {
+                    put_sample(p_dst[plane] + (size_t)y * dst_stride[plane],
+                               bps, x, v);
+                }
+            }
+        }
+    }
+}
+
+static void test_copy_444p_to_420p(int width, int height, int factor,
+                                   int mode)
+{
+    int y_size = NI_VPU_ALIGN128(width * factor) * height;
+    int src_size = width * factor * height;
+    uint8_t *src[NI_MAX_NUM_DATA_POINTERS] = {0};
+    uint8_t *out[2][NI_MAX_NUM_DATA_POINTERS] = {{0}};
+    uint8_t *ref[2][NI_MAX_NUM_DATA_POINTERS] = {{0}};
+    int i, k;
+
+    for (i = 0; i < 3; i++)
+    {
+        src[i] = (uint8_t *)malloc(src_size);
+        fill_plane(src[i], src_size, factor);
+        for (k = 0; k < 2; k++)
+        {
+            out[k][i] = (uint8_t *)malloc(y_size);
+            ref[k][i] = (uint8_t *)malloc(y_size);
+            memset(out[k][i], POISON, y_size);
+            memset(ref[k][i], POISON, y_size);
+        }
+    }
+
+    ni_copy_yuv_444p_to_420p(out[0], out[1], src, width, height, factor,
+                             mode);
+    ref_copy_yuv_444p_to_420p(ref[0], ref[1], src, width, height, factor,
+                              mode);
+
+    for (k = 0; k < 2; k++)
+    {
+        for (i = 0; i < 3; i++)
+        {
+            if (memcmp(out[k][i], ref[k][i], y_size) != 0)
+            {
+                fprintf(stderr,
+                        "copy 444p->420p %dx%d factor %d mode %d: output %d "
+                        "plane %d differs\n",
+                        width, height, factor, mode, k, i);
+                failures++;
+            }
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        free(src[i]);
+        for (k = 0; k < 2; k++)
+        {
+            free(out[k][i]);
+            free(ref[k][i]);
+        }
+    }
+}
+
+static void test_convert(int width, int height, int dst_width, int dst_height,
+                         ni_pix_fmt_t fmt, ni_chroma_filter_t filter)
+{
+    int bps = (fmt == NI_PIX_FMT_YUV420P10LE || fmt == NI_PIX_FMT_P010LE) ? 2 :
+                                                                             1;
+    int semiplanar = (fmt == NI_PIX_FMT_NV12 || fmt == NI_PIX_FMT_P010LE);
+    int shift = (fmt == NI_PIX_FMT_P010LE) ? 6 : 0;
+    int src_stride[NI_MAX_NUM_DATA_POINTERS] = {0};
+    int dst_stride[NI_MAX_NUM_DATA_POINTERS] = {0};
+    uint8_t *src[NI_MAX_NUM_DATA_POINTERS] = {0};
+    uint8_t *out[NI_MAX_NUM_DATA_POINTERS] = {0};
+    uint8_t *ref[NI_MAX_NUM_DATA_POINTERS] = {0};
+    size_t size[3];
+    int nb_planes = semiplanar ? 2 : 3;
+    int i;
+
+    for (i = 0; i < 3; i++)
+    {
+        // odd padding so that rows do not start aligned
+        src_stride[i] = width * bps + rnd_range(0, 5) * bps;
+        src[i] = (uint8_t *)malloc((size_t)src_stride[i] * height);
+        fill_plane(src[i], (size_t)src_stride[i] * height, bps);
+    }
+    dst_stride[0] = dst_width * bps + rnd_range(0, 7) * bps;
+    size[0] = (size_t)dst_stride[0] * dst_height;
+    for (i = 1; i < nb_planes; i++)
+    {
+        dst_stride[i] = (dst_width + 1) / 2 * bps * (semiplanar + 1) +
+            rnd_range(0, 7) * bps;
+        size[i] = (size_t)dst_stride[i] * ((dst_height + 1) / 2);
+    }
+    for (i = 0; i < nb_planes; i++)
+    {
+        out[i] = (uint8_t *)malloc(size[i]);
+        ref[i] = (uint8_t *)malloc(size[i]);
+        memset(out[i], POISON, size[i]);
+        memset(ref[i], POISON, size[i]);
+    }
+
+    CHECK(ni_convert_yuv_444p_to_420p(out, dst_stride, dst_width, dst_height,
+                                      fmt, src, src_stride, width, height,
+                                      filter) == NI_RETCODE_SUCCESS);
+    model_convert(ref, dst_stride, dst_width, dst_height, bps, semiplanar,
+                  shift, src, src_stride, width, height, filter);
+
+    for (i = 0; i < nb_planes; i++)
+    {
+        if (memcmp(out[i], ref[i], size[i]) != 0)
+        {
+            fprintf(stderr,
+                    "convert 444p->420 %dx%d to %dx%d fmt %d filter %d: "
+                    "plane %d differs\n",
+                    width, height, dst_width, dst_height, fmt, filter, i);
+            failures++;
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        free(src[i]);
+        free(out[i]);
+        free(ref[i]);
+    }
+}
+
+static void test_expand_frame(int raw_width, int raw_height, int fmt)
+{
+    int bps = (fmt == NI_PIX_FMT_YUV420P10LE || fmt == NI_PIX_FMT_P010LE) ? 2 :
+                                                                             1;
+    int semiplanar = (fmt == NI_PIX_FMT_NV12 || fmt == NI_PIX_FMT_P010LE);
+    int nb_planes = semiplanar ? 2 : 3;
+    int width = NIALIGN(raw_width, 2);
+    int height = NIALIGN(raw_height, 2);
+    int dst_stride[NI_MAX_NUM_DATA_POINTERS] = {0};
+    ni_frame_t src, out, ref;
+    size_t src_size[3], dst_size[3];
+    int i;
+
+    memset(&src, 0, sizeof(src));
+    memset(&out, 0, sizeof(out));
+    memset(&ref, 0, sizeof(ref));
+    for (i = 0; i < nb_planes; i++)
+    {
+        int w = (i == 0 || semiplanar) ? width : width / 2;
+        int h = i ? height / 2 : height;
+        int min_h = i ? NI_MIN_HEIGHT / 2 : NI_MIN_HEIGHT;
+
+        src_size[i] = (size_t)NIALIGN(w * bps, 128) * h;
+        dst_stride[i] = w * bps + rnd_range(0, 40) * bps;
+        dst_size[i] = (size_t)dst_stride[i] * (h > min_h ? h : min_h);
+
+        src.p_data[i] = (uint8_t *)malloc(src_size[i]);
+        out.p_data[i] = (uint8_t *)malloc(dst_size[i]);
+        ref.p_data[i] = (uint8_t *)malloc(dst_size[i]);
+        fill_plane(src.p_data[i], src_size[i], bps);
+        memset(out.p_data[i], POISON, dst_size[i]);
+        memset(ref.p_data[i], POISON, dst_size[i]);
+    }
+
+    CHECK(ni_expand_frame(&out, &src, dst_stride, raw_width, raw_height, fmt,
+                          nb_planes) == 0);
+    ref_expand_frame(&ref, &src, dst_stride, raw_width, raw_height, fmt,
+                     nb_planes);
+
+    for (i = 0; i < nb_planes; i++)
+    {
+        if (memcmp(out.p_data[i], ref.p_data[i], dst_size[i]) != 0)
+        {
+            fprintf(stderr, "expand %dx%d fmt %d: plane %d differs\n",
+                    raw_width, raw_height, fmt, i);
+            failures++;
+        }
+        free(src.p_data[i]);
+        free(out.p_data[i]);
+        free(ref.p_data[i]);
+    }
+}
+
+static void run_copy_cases(void)
+{
+    int factor, mode, n;
+
+    for (factor = 1; factor <= 2; factor++)
+    {
+        for (mode = 0; mode <= 1; mode++)
+        {
+            for (n = 0; n < NB_RANDOM; n++)
+            {
+                int width = rnd_range(2, 700);
+                if (mode == 1)
+                {
+                    width &= ~1;
+                }
+                test_copy_444p_to_420p(width, rnd_range(1, 90), factor,
+                                       mode);
+            }
+            // enough rows for every thread of ni_yuv_set_convert_threads(4)
+            test_copy_444p_to_420p(1920, 1080, factor, mode);
+        }
+    }
+}
+
+static void run_convert_cases(void)
+{
+    static const ni_pix_fmt_t fmts[] = {NI_PIX_FMT_YUV420P, NI_PIX_FMT_NV12,
+                                        NI_PIX_FMT_YUV420P10LE,
+                                        NI_PIX_FMT_P010LE};
+    size_t f;
+    int filter, n;
+
+    for (f = 0; f < sizeof(fmts) / sizeof(fmts[0]); f++)
+    {
+        for (filter = 0; filter < NI_CHROMA_FILTER_NUM; filter++)
+        {
+            for (n = 0; n < NB_RANDOM; n++)
+            {
+                int width = rnd_range(1, 700);
+                int height = rnd_range(1, 40);
+                int pad = (n & 1) ? rnd_range(0, 9) : 0;
+                test_convert(width, height, width + pad,
+                             height + ((n & 2) ? rnd_range(0, 5) : 0),
+                             fmts[f], (ni_chroma_filter_t)filter);
+            }
+            test_convert(1920, 1080, 1920, 1088, fmts[f],
+                         (ni_chroma_filter_t)filter);
+        }
+    }
+}
+
+static void run_expand_cases(void)
+{
+    static const int fmts[] = {NI_PIX_FMT_YUV420P, NI_PIX_FMT_NV12,
+                               NI_PIX_FMT_YUV420P10LE, NI_PIX_FMT_P010LE};
+    size_t f;
+    int n;
+
+    for (f = 0; f < sizeof(fmts) / sizeof(fmts[0]); f++)
+    {
+        for (n = 0; n < NB_RANDOM; n++)
+        {
+            test_expand_frame(rnd_range(1, 400),
+                              rnd_range(1, NI_MIN_HEIGHT + 16), fmts[f]);
+        }
+    }
+}
+
+int main(void)
+{
+    int nb_threads;
+
+    ni_log_set_level(NI_LOG_NONE);
+
+    for (nb_threads = 1; nb_threads <= 4; nb_threads += 3)
+    {
+        ni_yuv_set_convert_threads(nb_threads);
+        run_copy_cases();
+        run_convert_cases();
+    }
+    ni_yuv_set_convert_threads(1);
+    run_expand_cases();
+
+    printf("ni_yuv_convert_test: %s\n", failures ? "FAILED" : "passed");
+    return failures ? 1 : 0;
+}
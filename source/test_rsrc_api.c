@@ -192,12 +192,9 @@ static void listModuleId(void)
       return;
     }
 #elif __linux__
-    if (lockf(p_device_pool->lock, F_LOCK, 0))
+    if (ni_rsrc_lock_fd(p_device_pool->lock, -1) != NI_RETCODE_SUCCESS)
     {
-        char errmsg[NI_ERRNO_LEN] = {0};
-        ni_strerror(errmsg, NI_ERRNO_LEN, NI_ERRNO);
-        fprintf(stderr, "ERROR: %s() lockf() failed: %s\n", __func__,
-                errmsg);
+        fprintf(stderr, "ERROR: %s() ni_rsrc_lock_fd() failed\n", __func__);
     }
 #endif
 
@@ -222,9 +219,9 @@ static void listModuleId(void)
 #ifdef _WIN32
     ReleaseMutex(p_device_pool->lock);
 #elif __linux__
-    if (lockf(p_device_pool->lock, F_ULOCK, 0))
+    if (ni_rsrc_unlock_fd(p_device_pool->lock) != NI_RETCODE_SUCCESS)
     {
-      fprintf(stderr, "Error lockf() failed\n");
+      fprintf(stderr, "Error ni_rsrc_unlock_fd() failed\n");
     }
 #endif
     ni_rsrc_free_device_pool(p_device_pool);